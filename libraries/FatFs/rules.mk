@@ -1,5 +1,6 @@
 $(T)_DEPS := ms-common ms-helper
 
 ifeq (x86,$(PLATFORM))
-$(T)_EXCLUDE_TESTS := sd
+# The test formats an emulated card image instead of using a real card
+$(T)_CFLAGS += -DX86
 endif
@@ -10,6 +10,7 @@
 #include "ff.h"			/* Obtains integer types */
 #include "diskio.h"		/* Declarations of disk functions */
 #include "sd_binary.h"
+#include "sd_cache.h"
 
 
 /*-----------------------------------------------------------------------*/
@@ -37,6 +38,8 @@ DSTATUS disk_initialize (
 	BYTE pdrv				/* Physical drive number to identify the drive */
 )
 {
+	/* A different card may have been inserted */
+	sd_cache_clear((SpiPort) pdrv);
 	if (status_ok(sd_card_init((SpiPort) pdrv))) {
     return 0;
   }
@@ -58,7 +61,7 @@ DRESULT disk_read (
 )
 {
 	// https://community.st.com/thread/13977
-  if (status_ok(sd_read_blocks((SpiPort) pdrv, buff, (uint64_t)(sector)*SD_BLOCK_SIZE, count))) {
+  if (status_ok(sd_cache_read_blocks((SpiPort) pdrv, buff, sector, count))) {
     return RES_OK;
   }
 
@@ -80,7 +83,7 @@ DRESULT disk_write (
 	UINT count			/* Number of sectors to write */
 )
 {
-	if (status_ok(sd_write_blocks((SpiPort) pdrv, buff, (uint64_t)(sector)*SD_BLOCK_SIZE, count))) {
+	if (status_ok(sd_cache_write_blocks((SpiPort) pdrv, (BYTE *)buff, sector, count))) {
     return RES_OK;
   }
   return RES_ERROR;
@@ -107,6 +110,12 @@ if (!status_ok(sd_is_initialized((SpiPort) pdrv))) {
     /* Make sure that no pending write process */
     case CTRL_SYNC:
       return RES_OK;
+    /* Needed by f_mkfs */
+    case GET_SECTOR_COUNT:
+      if (status_ok(sd_get_num_blocks((SpiPort) pdrv, (uint32_t *)buff))) {
+        return RES_OK;
+      }
+      return RES_ERROR;
     default:
       return RES_PARERR;
   }
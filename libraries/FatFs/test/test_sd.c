@@ -1,4 +1,5 @@
 #include <string.h>
+#include <unistd.h>
 #include "delay.h"
 #include "ff.h"
 #include "interrupt.h"
@@ -7,7 +8,13 @@
 #include "soft_timer.h"
 #include "spi.h"
 #include "status.h"
+#include "test_helpers.h"
 #include "unity.h"
+#ifdef X86
+#include "x86_sd_binary.h"
+
+#define TEST_IMAGE_FILE "test_sd.img"
+#endif
 
 #define READ_BUF_SIZE 25
 
@@ -44,9 +51,22 @@ void setup_test(void) {
     LOG_CRITICAL("Failed to initialize the Spi module\n");
     TEST_FAIL();
   }
+
+#ifdef X86
+  // Format a fresh card image
+  unlink(TEST_IMAGE_FILE);
+  setenv(X86_SD_IMAGE_VAR, TEST_IMAGE_FILE, 1);
+  TEST_ASSERT_OK(sd_card_init(SPI_PORT_2));
+  uint8_t work[FF_MAX_SS];
+  TEST_ASSERT_EQUAL(FR_OK, f_mkfs("1:", FM_ANY, 0, work, sizeof(work)));
+#endif
 }
 
-void teardown_test(void) {}
+void teardown_test(void) {
+#ifdef X86
+  unlink(TEST_IMAGE_FILE);
+#endif
+}
 
 void test_read_write(void) {
   //
@@ -1,81 +1,288 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
 #include "FreeRTOS.h"
 #include "task.h"
+#include "x86_interrupt.h"
+
+#ifdef X86_INTERRUPT_QUEUE
+#error "The Linux port relies on signal-based x86 interrupts"
+#endif
 
-// This provides a stubbed out minimal implementation of a FreeRTOS Linux port
-// in order to get it compiling.
+// Linux port of FreeRTOS.
 //
-// Note: This will not actually run FreeRTOS on Linux at the moment.
-
-StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters) {
-  // This is called when each Task is created
-
-  // TODO: Implement this
-  //
-  // This probably will be something like:
-  // 1. Create pthread + block it until it is time to run
-  // 2. Update total Tasks
-  //
-  // Notes:
-  // I'm not sure how pre-emption is going to occur, since we can't necessarily
-  // guarantee that signals will be sent during valid cancellation points...
-  // Ideally, we have a single thread perform all the signal processing...
-  //
-  // Unfortunately, Linux doesn't implement the POSIX pthread_suspend and
-  // pthread_resume_np APIs, so there isn't an equivalent to the Windows
-  // SuspendThread. This means that in order to "suspend" a thread, things are
-  // much more complicated.
-  //
-  // The main question is:
-  //
-  // What happens when you call pthread_yield inside your signal handler? What
-  // happens to the Thread context when it is woken up again?
-  //
-  // I would assume that because signal handlers run in the context of your
-  // thread, that you could pthread_yield indefinitely until the FreeRTOS
-  // scheduler decides for you to run.
-  //
-  // If this is the case, then you could simply direct SIG_SUSPEND at a
-  // particular thread, and then wake the thread you wish to run via a
-  // SIG_RESUME.
-  //
-  // However, I'm not sure how this approach will work with external
-  // interrupts, since this inherently assumes that the SysTick handler is the
-  // only one that can suspend/resume a Task (unless a Task yields its
-  // time-slice). Maybe this works if we only handle interrupts in the main
-  // loop?
-  //
-  // The alternative is that each Task is a forked as a separate process.
-  // However, this isn't great either, as then you don't necessarily have the
-  // same address space, and so you would need to implement FreeRTOS data
-  // structures using IPC. It also doesn't necessarily solve the problem with
-  // external interrupts.
-  //
-  // IMO, the simplest is to make use of co-operative scheduling, and assume
-  // that your Tasks will yield via taskYIELD, or call vTaskDelay. This way,
-  // you can have defined cancellation points (at the end of each tick), and a
-  // signal handler in the main() thread can defer work. Then interrupts can be
-  // delivered either before the Task runs, or after the Task runs.
-  return 0;
+// Every task is backed by a pthread that is created blocked. A thread only runs while its task is
+// the running task: switching tasks wakes the next thread and then parks the current one until it
+// is switched back in, so only one thread ever executes FreeRTOS or application code at a time.
+//
+// Interrupts are signals delivered to the running thread:
+// - ms-common interrupts (soft timers, CAN, etc.) are the SIGRTMIN-based signals in x86_interrupt.
+// - A tick thread counts ticks and kicks the running thread with X86_INTERRUPT_RTOS_SIGNAL.
+// - Yields raise X86_INTERRUPT_RTOS_SIGNAL on the running thread.
+// X86_INTERRUPT_RTOS_SIGNAL is the PendSV of this port. It is blocked by FreeRTOS critical sections
+// and ms-common interrupt handlers, and deferred by ms-common critical sections, so a context
+// switch never happens while a task holds a critical section or in the middle of an interrupt. Its
+// handler processes pending ticks and performs the context switch.
+
+// Parks and wakes a task thread.
+typedef struct PortThread {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool run;
+  TaskFunction_t code;
+  void *params;
+} PortThread;
+
+// Interrupt state is per thread, since each task has its own
+static __thread bool s_interrupts_masked = false;
+static __thread sigset_t s_saved_mask;
+static __thread UBaseType_t s_critical_nesting = 0;
+
+// Thread of the running task - only valid once the scheduler is started
+static PortThread *volatile s_running = NULL;
+static volatile bool s_yield_pending = false;
+static volatile uint32_t s_pending_ticks = 0;
+
+static pthread_t s_tick_thread;
+static volatile bool s_scheduler_ended = false;
+static pthread_mutex_t s_end_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_end_cond = PTHREAD_COND_INITIALIZER;
+
+// The handle of a task points to its TCB, whose first member is the top of stack that we
+// returned from pxPortInitialiseStack.
+static PortThread *prv_thread_from_task(void *task) {
+  return (PortThread *)*(StackType_t **)task;
+}
+
+static PortThread *prv_current_thread(void) {
+  return prv_thread_from_task(xTaskGetCurrentTaskHandle());
+}
+
+static void prv_thread_wake(PortThread *thread) {
+  pthread_mutex_lock(&thread->mutex);
+  thread->run = true;
+  pthread_cond_signal(&thread->cond);
+  pthread_mutex_unlock(&thread->mutex);
+}
+
+static void prv_thread_park(PortThread *thread) {
+  pthread_mutex_lock(&thread->mutex);
+  while (!thread->run) {
+    pthread_cond_wait(&thread->cond, &thread->mutex);
+  }
+  thread->run = false;
+  pthread_mutex_unlock(&thread->mutex);
+}
+
+// Must be called with all signals blocked. Returns once |from| is switched back in.
+static void prv_switch_thread(PortThread *from, PortThread *to) {
+  if (from == to) {
+    return;
+  }
+  s_running = to;
+  prv_thread_wake(to);
+  prv_thread_park(from);
+}
+
+static void prv_mask_interrupts(void) {
+  sigset_t all;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &s_saved_mask);
+  s_interrupts_masked = true;
+}
+
+static void prv_unmask_interrupts(void) {
+  s_interrupts_masked = false;
+  pthread_sigmask(SIG_SETMASK, &s_saved_mask, NULL);
+}
+
+// Handler for X86_INTERRUPT_RTOS_SIGNAL. Runs with all signals blocked.
+static void prv_rtos_signal_handler(int signum) {
+  (void)signum;
+  // ms-common critical sections don't block the signal, so it comes back once they end
+  if (x86_interrupt_defer_rtos_signal()) {
+    return;
+  }
+
+  bool switch_required = s_yield_pending;
+  s_yield_pending = false;
+
+  uint32_t ticks = __atomic_exchange_n(&s_pending_ticks, 0, __ATOMIC_SEQ_CST);
+  while (ticks-- > 0) {
+    if (xTaskIncrementTick() != pdFALSE) {
+      switch_required = true;
+    }
+  }
+
+  if (switch_required) {
+    PortThread *from = prv_current_thread();
+    vTaskSwitchContext();
+    prv_switch_thread(from, prv_current_thread());
+  }
+}
+
+static void *prv_tick_thread(void *arg) {
+  (void)arg;
+  struct timespec next = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!s_scheduler_ended) {
+    next.tv_nsec += portTICK_PERIOD_MS * 1000000L;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+    // Ticks are counted here so that none are lost while the running task has interrupts masked
+    __atomic_add_fetch(&s_pending_ticks, 1, __ATOMIC_SEQ_CST);
+    pthread_kill(s_running->thread, X86_INTERRUPT_RTOS_SIGNAL);
+  }
+  return NULL;
+}
+
+static void *prv_task_thread(void *arg) {
+  PortThread *thread = arg;
+  prv_thread_park(thread);
+
+  // Makes the task easy to find in a debugger
+  pthread_setname_np(pthread_self(), pcTaskGetName(NULL));
+
+  // Tasks start with interrupts enabled
+  sigset_t none;
+  sigemptyset(&none);
+  pthread_sigmask(SIG_SETMASK, &none, NULL);
+
+  thread->code(thread->params);
+
+  // Tasks should never return
+  vTaskDelete(NULL);
+  return NULL;
+}
+
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode,
+                                   void *pvParameters) {
+  // The task stack is unused since the thread has its own, so the thread state lives at its top
+  uintptr_t top = (uintptr_t)(pxTopOfStack + 1) - sizeof(PortThread);
+  PortThread *thread = (PortThread *)(top & ~(uintptr_t)(__alignof__(PortThread) - 1));
+
+  thread->run = false;
+  thread->code = pxCode;
+  thread->params = pvParameters;
+  pthread_mutex_init(&thread->mutex, NULL);
+  pthread_cond_init(&thread->cond, NULL);
+
+  // New threads inherit our signal mask - they must not handle any signals until they run
+  sigset_t all;
+  sigset_t old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  pthread_create(&thread->thread, NULL, prv_task_thread, thread);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  return (StackType_t *)thread;
+}
+
+void vPortCleanUpTask(void *pxTCB) {
+  // The deleted task's thread is parked, so it is safe to cancel
+  PortThread *thread = prv_thread_from_task(pxTCB);
+  pthread_cancel(thread->thread);
+  pthread_join(thread->thread, NULL);
 }
 
 BaseType_t xPortStartScheduler(void) {
-  // TODO: Implement this
-  //
-  // This will probably be something like:
-  // 1. Set up tick interrupt via a timer
-  // 2. Set up tick interrupt handler
-  // 3. Start the first Task
-  // 4. Event loop while vPortEndScheduler flag isn't raised
+  // The main thread only waits for the scheduler to end from here on
+  sigset_t all;
+  sigset_t old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+
+  struct sigaction act = { 0 };
+  act.sa_handler = prv_rtos_signal_handler;
+  act.sa_flags = SA_RESTART;
+  sigfillset(&act.sa_mask);
+  sigaction(X86_INTERRUPT_RTOS_SIGNAL, &act, NULL);
+
+  s_scheduler_ended = false;
+  s_yield_pending = false;
+  s_pending_ticks = 0;
+  s_running = prv_current_thread();
+  pthread_create(&s_tick_thread, NULL, prv_tick_thread, NULL);
+  prv_thread_wake(s_running);
+
+  pthread_mutex_lock(&s_end_mutex);
+  while (!s_scheduler_ended) {
+    pthread_cond_wait(&s_end_cond, &s_end_mutex);
+  }
+  pthread_mutex_unlock(&s_end_mutex);
+
+  pthread_join(s_tick_thread, NULL);
+  s_running = NULL;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
   return 0;
 }
 
 void vPortEndScheduler(void) {
-  // TODO: Implement this
-  //
-  // This will probably be something like:
-  // 1. Raise vPortEndScheduler flag
-  //
-  // Not sure, but I don't think we can do anything else here, since vPortEndScheduler can be called from any task,
-  // and so it is up to xPortStartScheduler to perform all the cleanup?
-  return;
+  // Called from a task with interrupts disabled
+  pthread_mutex_lock(&s_end_mutex);
+  s_scheduler_ended = true;
+  pthread_cond_signal(&s_end_cond);
+  pthread_mutex_unlock(&s_end_mutex);
+
+  // Nothing may run on the task threads once the scheduler has stopped
+  PortThread *thread = prv_current_thread();
+  for (;;) {
+    prv_thread_park(thread);
+  }
+}
+
+void vPortYield(void) {
+  if (s_running == NULL) {
+    // The scheduler will pick the highest priority task once it starts
+    return;
+  }
+  s_yield_pending = true;
+  // Runs immediately unless interrupts are masked, in which case it runs once they are unmasked
+  pthread_kill(pthread_self(), X86_INTERRUPT_RTOS_SIGNAL);
+}
+
+void vPortDisableInterrupts(void) {
+  if (!s_interrupts_masked) {
+    prv_mask_interrupts();
+  }
+}
+
+void vPortEnableInterrupts(void) {
+  if (s_interrupts_masked) {
+    prv_unmask_interrupts();
+  }
+}
+
+UBaseType_t xPortSetInterruptMask(void) {
+  UBaseType_t was_masked = s_interrupts_masked;
+  vPortDisableInterrupts();
+  return was_masked;
+}
+
+void vPortClearInterruptMask(UBaseType_t xMask) {
+  if (!xMask) {
+    vPortEnableInterrupts();
+  }
+}
+
+void vPortEnterCritical(void) {
+  vPortDisableInterrupts();
+  s_critical_nesting++;
+}
+
+void vPortExitCritical(void) {
+  configASSERT(s_critical_nesting > 0);
+  s_critical_nesting--;
+  if (s_critical_nesting == 0) {
+    vPortEnableInterrupts();
+  }
 }
@@ -1,6 +1,12 @@
 #pragma once
 
 // This provides port-specific macros for the Linux FreeRTOS port
+//
+// Each task runs on its own pthread, but only the thread of the running task is ever allowed to
+// make progress. Interrupts are signals, so disabling interrupts blocks signals on the calling
+// thread. Context switches are requested by raising a dedicated signal on the running thread,
+// which plays the role of PendSV on the Cortex-M ports: it is held off by critical sections and
+// by ms-common interrupts, and switches tasks once they are done.
 #include <stdint.h>
 
 typedef long BaseType_t;
@@ -8,29 +14,57 @@ typedef unsigned long UBaseType_t;
 typedef unsigned long StackType_t;
 
 #if (configUSE_16_BIT_TICKS == 1)
-  typedef uint16_t TickType_t;
-	#define portMAX_DELAY ((uint16_t)0xffff)
+typedef uint16_t TickType_t;
+#define portMAX_DELAY ((uint16_t)0xffff)
 #else
-  typedef uint32_t TickType_t;
-	#define portMAX_DELAY ((uint32_t)0xffffffff)
+typedef uint32_t TickType_t;
+#define portMAX_DELAY ((uint32_t)0xffffffff)
+// 32-bit loads and stores are atomic on x86
+#define portTICK_TYPE_IS_ATOMIC 1
 #endif
 
-// TODO: Check this alignment setting?
-#define portBYTE_ALIGNMENT 8
+// Pointers are 64 bits wide on the host
+#define portPOINTER_SIZE_TYPE uintptr_t
+#define portBYTE_ALIGNMENT 16
+
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
 
 // Critical sections
-#define portENTER_CRITICAL()
-#define portEXIT_CRITICAL()
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+#define portENTER_CRITICAL() vPortEnterCritical()
+#define portEXIT_CRITICAL() vPortExitCritical()
 
 // Interrupts
-#define portDISABLE_INTERRUPTS()
-#define portENABLE_INTERRUPTS()
-#define portYIELD()
+void vPortDisableInterrupts(void);
+void vPortEnableInterrupts(void);
+#define portDISABLE_INTERRUPTS() vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS() vPortEnableInterrupts()
+
+UBaseType_t xPortSetInterruptMask(void);
+void vPortClearInterruptMask(UBaseType_t xMask);
+#define portSET_INTERRUPT_MASK_FROM_ISR() xPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x) vPortClearInterruptMask(x)
+
+// Yields are pended and run as soon as interrupts are unmasked, like PendSV
+void vPortYield(void);
+#define portYIELD() vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired) \
+  if (xSwitchRequired) {                       \
+    vPortYield();                              \
+  }
+#define portYIELD_FROM_ISR(x) portEND_SWITCHING_ISR(x)
+
+// Stops the pthread backing a deleted task
+void vPortCleanUpTask(void *pxTCB);
+#define portCLEAN_UP_TCB(pxTCB) vPortCleanUpTask(pxTCB)
 
 #define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void *pvParameters)
 #define portTASK_FUNCTION(vFunction, pvParameters) void vFunction(void *pvParameters)
 
+#define portNOP()
+
 // Architecture specific defines
 
 // On x86, the stack grows downwards (ie. from higher addresses to lower)
-#define portSTACK_GROWTH			(-1)
+#define portSTACK_GROWTH (-1)
@@ -18,7 +18,7 @@ $(T)_INC_DIRS := $($(T)_DIR) \
 $(T)_SRC := $(wildcard $($(T)_SRC_ROOT)/*.c) \
             $(wildcard $($(T)_SRC_ROOT)/*.s)
 
-# TODO: Integrate the Linux simulator
+# On x86, tasks run as pthreads scheduled by the Linux port - see portable/GCC/Linux/port.c
 ifeq (stm32f0xx,$(PLATFORM))
     $(T)_INC_DIRS += $($(T)_DIR)/portable/GCC/ARM_CM0
     $(T)_SRC += $(wildcard $($(T)_SRC_ROOT)/portable/GCC/ARM_CM0/*.c)
@@ -63,6 +63,7 @@ typedef enum {
   SYSTEM_CAN_MESSAGE_AUX_DCDC_VC = 43,
   SYSTEM_CAN_MESSAGE_DCDC_TEMPS = 44,
   SYSTEM_CAN_MESSAGE_UV_CUTOFF_NOTIFICATION = 45,
+  SYSTEM_CAN_MESSAGE_CURRENT_STATS = 46,
   SYSTEM_CAN_MESSAGE_CHARGER_INFO = 47,
   SYSTEM_CAN_MESSAGE_REQUEST_TO_CHARGE = 48,
   SYSTEM_CAN_MESSAGE_ALLOW_CHARGING = 49,
@@ -80,5 +81,5 @@ typedef enum {
   SYSTEM_CAN_MESSAGE_REAR_FAN_FAULT = 61,
   SYSTEM_CAN_MESSAGE_FRONT_FAN_FAULT = 62,
   SYSTEM_CAN_MESSAGE_BABYDRIVER = 63,
-  NUM_SYSTEM_CAN_MESSAGES = 56
+  NUM_SYSTEM_CAN_MESSAGES = 57
 } SystemCanMessage;
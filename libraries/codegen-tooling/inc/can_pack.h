@@ -200,6 +200,11 @@
   can_pack_impl_empty((msg_ptr), SYSTEM_CAN_DEVICE_POWER_DISTRIBUTION_FRONT, \
                       SYSTEM_CAN_MESSAGE_UV_CUTOFF_NOTIFICATION)
 
+#define CAN_PACK_CURRENT_STATS(msg_ptr, state_of_charge_u16, rms_current_u16, min_current_u16,     \
+                               max_current_u16)                                                    \
+  can_pack_impl_u16((msg_ptr), SYSTEM_CAN_DEVICE_BMS_CARRIER, SYSTEM_CAN_MESSAGE_CURRENT_STATS, 8, \
+                    (state_of_charge_u16), (rms_current_u16), (min_current_u16), (max_current_u16))
+
 #define CAN_PACK_CHARGER_INFO(msg_ptr, current_u16, voltage_u16, status_bitset_u16)           \
   can_pack_impl_u16((msg_ptr), SYSTEM_CAN_DEVICE_CHARGER, SYSTEM_CAN_MESSAGE_CHARGER_INFO, 6, \
                     (current_u16), (voltage_u16), (status_bitset_u16), CAN_PACK_IMPL_EMPTY)
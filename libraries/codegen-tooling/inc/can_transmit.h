@@ -325,6 +325,16 @@
     status;                                       \
   })
 
+#define CAN_TRANSMIT_CURRENT_STATS(state_of_charge_u16, rms_current_u16, min_current_u16,     \
+                                   max_current_u16)                                           \
+  ({                                                                                          \
+    CanMessage msg = { 0 };                                                                   \
+    CAN_PACK_CURRENT_STATS(&msg, (state_of_charge_u16), (rms_current_u16), (min_current_u16), \
+                           (max_current_u16));                                                \
+    StatusCode status = can_transmit(&msg, NULL);                                             \
+    status;                                                                                   \
+  })
+
 #define CAN_TRANSMIT_CHARGER_INFO(current_u16, voltage_u16, status_bitset_u16)      \
   ({                                                                                \
     CanMessage msg = { 0 };                                                         \
@@ -157,6 +157,11 @@
 
 #define CAN_UNPACK_UV_CUTOFF_NOTIFICATION(msg_ptr) can_unpack_impl_empty((msg_ptr), 0)
 
+#define CAN_UNPACK_CURRENT_STATS(msg_ptr, state_of_charge_u16_ptr, rms_current_u16_ptr, \
+                                 min_current_u16_ptr, max_current_u16_ptr)              \
+  can_unpack_impl_u16((msg_ptr), 8, (state_of_charge_u16_ptr), (rms_current_u16_ptr),   \
+                      (min_current_u16_ptr), (max_current_u16_ptr))
+
 #define CAN_UNPACK_CHARGER_INFO(msg_ptr, current_u16_ptr, voltage_u16_ptr, status_bitset_u16_ptr)  \
   can_unpack_impl_u16((msg_ptr), 6, (current_u16_ptr), (voltage_u16_ptr), (status_bitset_u16_ptr), \
                       CAN_UNPACK_IMPL_EMPTY)
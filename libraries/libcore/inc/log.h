@@ -4,6 +4,22 @@
 //
 // Best practice is to use log level WARNING for recoverable faults and CRITICAL
 // for irrecoverable faults. DEBUG can be used for anything.
+//
+// Defining LOG_DEFERRED (i.e. DEFINE=LOG_DEFERRED) makes LOG only format the
+// record into a ring buffer instead, which is drained in the background: by the
+// UART's TXE interrupt on stm32f0xx, or by a writer thread on x86. printf blocks
+// on the UART with interrupts disabled, so this keeps logging out of the way of
+// interrupts. Records that don't fit are dropped and counted rather than making
+// the caller wait.
+//
+// Defining LOG_TOKENIZED sends a compact binary record for each LOG instead of
+// text: the log site's token, the level, a timestamp and the raw arguments.
+// The file, line and format string of every site go into the log_sites
+// section, which isn't loaded into flash. The build dumps it next to the
+// binary as <project>.log_sites, and libcore/scripts/log_decode.py turns the
+// records back into text with it. This can be combined with LOG_DEFERRED.
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef enum {
@@ -19,13 +35,155 @@ typedef enum {
 #define LOG_LEVEL_VERBOSITY LOG_LEVEL_DEBUG
 #endif
 
+// Size of the deferred record buffer in bytes - must be a power of 2
+#ifndef LOG_DEFERRED_BUFFER_SIZE
+#define LOG_DEFERRED_BUFFER_SIZE 1024
+#endif
+
+// Longer records are truncated
+#define LOG_DEFERRED_MAX_RECORD_LEN 128
+
+typedef struct LogDeferredStats {
+  uint32_t records;       // records buffered
+  uint32_t dropped;       // records dropped since the buffer was full
+  uint32_t max_buffered;  // most bytes ever waiting in the buffer
+} LogDeferredStats;
+
+// Called after a record is buffered, from the context that logged it
+typedef void (*LogDeferredReadyCallback)(void);
+
+// Tokenized records are framed as LOG_TOKENIZED_SYNC, then the length of the rest. The rest is
+// varints of (token << 2 | level) and the timestamp in microseconds, then each argument: integers
+// as zigzag varints, floating point as a 4 byte float and strings as a length and their bytes.
+#define LOG_TOKENIZED_SYNC 0xA5
+#define LOG_TOKENIZED_SECTION "log_sites"
+// Longer strings are truncated
+#define LOG_TOKENIZED_MAX_STRING_LEN 20
+#define LOG_TOKENIZED_MAX_ARGS 10
+
+// How each argument is passed, packed 3 bits per argument into the type signature
+typedef enum {
+  LOG_ARG_END = 0,
+  LOG_ARG_INT32,
+  LOG_ARG_UINT32,
+  LOG_ARG_INT64,
+  LOG_ARG_UINT64,
+  LOG_ARG_DOUBLE,
+  LOG_ARG_STRING,
+  NUM_LOG_ARGS,
+} LogArg;
+
+#define LOG_ARG_BITS 3
+
+// Returns the time in microseconds for tokenized record timestamps
+typedef uint32_t (*LogClock)(void);
+
+// Sends a finished tokenized record somewhere other than the default output
+typedef void (*LogWriter)(const uint8_t *record, size_t len);
+
 #define LOG_DEBUG(fmt, ...) LOG(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
 #define LOG_WARN(fmt, ...) LOG(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
 #define LOG_CRITICAL(fmt, ...) LOG(LOG_LEVEL_CRITICAL, fmt, ##__VA_ARGS__)
 
-#define LOG(level, fmt, ...)                                                  \
-  do {                                                                        \
-    if ((level) >= LOG_LEVEL_VERBOSITY) {                                     \
-      printf("[%u] %s:%u: " fmt, (level), __FILE__, __LINE__, ##__VA_ARGS__); \
-    }                                                                         \
+#ifdef LOG_DEFERRED
+#define LOG_PRINTF log_deferred_printf
+#else
+#define LOG_PRINTF printf
+#endif
+
+#ifdef LOG_TOKENIZED
+// The site is only ever used for its address, and printf is never called - it's just there so the
+// compiler still checks the arguments against the format.
+#define LOG(level, fmt, ...)                                                                \
+  do {                                                                                      \
+    if ((level) >= LOG_LEVEL_VERBOSITY) {                                                   \
+      static const char _log_site[] __attribute__((section(LOG_TOKENIZED_SECTION), used)) = \
+          __FILE__ ":" LOG_STRINGIFY(__LINE__) "\0" fmt;                                    \
+      log_tokenized_write(_log_site, (level), LOG_ARG_TYPES(fmt, ##__VA_ARGS__),            \
+                          ##__VA_ARGS__);                                                   \
+      if (0) {                                                                              \
+        printf(fmt, ##__VA_ARGS__);                                                         \
+      }                                                                                     \
+    }                                                                                       \
+  } while (0)
+#else
+#define LOG(level, fmt, ...)                                                      \
+  do {                                                                            \
+    if ((level) >= LOG_LEVEL_VERBOSITY) {                                         \
+      LOG_PRINTF("[%u] %s:%u: " fmt, (level), __FILE__, __LINE__, ##__VA_ARGS__); \
+    }                                                                             \
   } while (0)
+#endif
+
+#define LOG_STRINGIFY(x) LOG_STRINGIFY_IMPL(x)
+#define LOG_STRINGIFY_IMPL(x) #x
+#define LOG_CONCAT(a, b) LOG_CONCAT_IMPL(a, b)
+#define LOG_CONCAT_IMPL(a, b) a##b
+
+// Picks how an argument is passed from its type. Arguments aren't evaluated.
+#define LOG_ARG_TYPE(arg)                                                        \
+  _Generic((arg),                                                                \
+           _Bool: LOG_ARG_INT32,                                                 \
+           char: LOG_ARG_INT32,                                                  \
+           signed char: LOG_ARG_INT32,                                           \
+           unsigned char: LOG_ARG_INT32,                                         \
+           short: LOG_ARG_INT32,                                                 \
+           unsigned short: LOG_ARG_INT32,                                        \
+           int: LOG_ARG_INT32,                                                   \
+           unsigned int: LOG_ARG_UINT32,                                         \
+           long: (sizeof(long) == 8 ? LOG_ARG_INT64 : LOG_ARG_INT32),            \
+           unsigned long: (sizeof(long) == 8 ? LOG_ARG_UINT64 : LOG_ARG_UINT32), \
+           long long: LOG_ARG_INT64,                                             \
+           unsigned long long: LOG_ARG_UINT64,                                   \
+           float: LOG_ARG_DOUBLE,                                                \
+           double: LOG_ARG_DOUBLE,                                               \
+           char *: LOG_ARG_STRING,                                               \
+           const char *: LOG_ARG_STRING,                                         \
+           unsigned char *: LOG_ARG_STRING,                                      \
+           const unsigned char *: LOG_ARG_STRING,                                \
+           default: (sizeof(void *) == 8 ? LOG_ARG_UINT64 : LOG_ARG_UINT32))
+
+// Packs the types of up to LOG_TOKENIZED_MAX_ARGS arguments after the format into a compile time
+// constant. The format is only there so the comma before no arguments is dropped in ISO C modes,
+// and the arguments go through LOG_APPLY so any macros in them are expanded before being counted.
+#define LOG_APPLY(macro, args) macro args
+#define LOG_NUM_ARGS(fmt, ...) \
+  LOG_APPLY(LOG_NUM_ARGS_IMPL, (fmt, ##__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0))
+#define LOG_NUM_ARGS_IMPL(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, n, ...) n
+#define LOG_ARG_TYPES(fmt, ...) \
+  LOG_CONCAT(LOG_ARG_TYPES_, LOG_NUM_ARGS(fmt, ##__VA_ARGS__))(__VA_ARGS__)
+#define LOG_ARG_TYPES_0() 0u
+#define LOG_ARG_TYPES_1(a) ((uint32_t)LOG_ARG_TYPE(a))
+#define LOG_ARG_PUSH(a, rest) (LOG_ARG_TYPES_1(a) | ((rest) << LOG_ARG_BITS))
+#define LOG_ARG_TYPES_2(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_1(__VA_ARGS__))
+#define LOG_ARG_TYPES_3(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_2(__VA_ARGS__))
+#define LOG_ARG_TYPES_4(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_3(__VA_ARGS__))
+#define LOG_ARG_TYPES_5(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_4(__VA_ARGS__))
+#define LOG_ARG_TYPES_6(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_5(__VA_ARGS__))
+#define LOG_ARG_TYPES_7(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_6(__VA_ARGS__))
+#define LOG_ARG_TYPES_8(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_7(__VA_ARGS__))
+#define LOG_ARG_TYPES_9(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_8(__VA_ARGS__))
+#define LOG_ARG_TYPES_10(a, ...) LOG_ARG_PUSH(a, LOG_ARG_TYPES_9(__VA_ARGS__))
+
+// Formats a record into the deferred buffer, or drops it if it doesn't fit.
+// Safe to call from interrupts.
+void log_deferred_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Takes up to |max_len| buffered bytes, returning how many were taken. There should only be one
+// reader, i.e. the UART's TXE interrupt or the main loop.
+size_t log_deferred_read(uint8_t *data, size_t max_len);
+
+// Registers a callback to start the reader. Pass NULL to stop being notified.
+void log_deferred_set_ready_callback(LogDeferredReadyCallback callback);
+
+// Encodes a tokenized record for |site| and sends it to the writer, or the deferred buffer with
+// LOG_DEFERRED, or stdout. |arg_types| is from LOG_ARG_TYPES. Use the LOG macros instead.
+void log_tokenized_write(const char *site, LogLevel level, uint32_t arg_types, ...);
+
+// Sets where tokenized record timestamps come from. They're 0 until this is called.
+void log_tokenized_set_clock(LogClock clock);
+
+// Overrides where tokenized records are sent. Pass NULL to go back to the default.
+void log_tokenized_set_writer(LogWriter writer);
+
+void log_deferred_get_stats(LogDeferredStats *stats);
@@ -0,0 +1,8 @@
+#pragma once
+// Platform specific parts of the deferred log backend - see log.h
+
+// Keeps everything else that could log or read out of the buffer, including interrupts.
+// Not reentrant.
+void log_impl_lock(void);
+
+void log_impl_unlock(void);
@@ -8,3 +8,8 @@
 $(T)_DEPS :=
 
 $(T)_test_mock_MOCKS := status_impl_update
+
+ifneq (x86,$(PLATFORM))
+# Times themselves with the host's clock, and decode records with the host's python
+$(T)_EXCLUDE_TESTS := log log_tokenized
+endif
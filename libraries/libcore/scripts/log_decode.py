@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Decodes tokenized log records (see libcore/inc/log.h) back into text."""
+import argparse
+import re
+import struct
+import sys
+
+LOG_TOKENIZED_SYNC = 0xA5
+
+# A printf conversion: flags, width, precision, length modifier and conversion
+CONVERSION = re.compile(
+    r'%(?P<flags>[-+ #0]*)(?P<width>\*|\d+)?(?:\.(?P<precision>\*|\d*))?'
+    r'(?P<length>hh|h|ll|l|j|z|t|L)?(?P<conv>[diouxXeEfFgGaAcspn%])')
+
+# Integer widths in bits for each length modifier, assuming a 32-bit target. Arguments are sent
+# sign-extended, so this only matters for unsigned conversions.
+LENGTH_BITS = {None: 32, 'hh': 8, 'h': 16, 'l': 32, 'll': 64, 'j': 64, 'z': 32, 't': 32}
+
+
+class Record:
+    """A record's varints, floats and strings, read in order."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def varint(self):
+        """Reads an unsigned varint."""
+        value = 0
+        shift = 0
+        while True:
+            byte = self.data[self.pos]
+            self.pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+
+    def signed(self):
+        """Reads a zigzag encoded varint."""
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def float(self):
+        """Reads a 4 byte little endian float."""
+        value, = struct.unpack_from('<f', self.data, self.pos)
+        self.pos += 4
+        return value
+
+    def string(self):
+        """Reads a length prefixed string."""
+        length = self.data[self.pos]
+        value = self.data[self.pos + 1:self.pos + 1 + length]
+        self.pos += 1 + length
+        return value.decode('utf-8', errors='replace')
+
+
+def load_sites(table):
+    """Maps each token to the file:line and format of its site in a dump of the log_sites
+    section."""
+    sites = {}
+    pos = 0
+    while pos < len(table):
+        # Sites are aligned by the compiler, so skip any padding
+        if table[pos] == 0:
+            pos += 1
+            continue
+        location_end = table.index(b'\0', pos)
+        fmt_end = table.index(b'\0', location_end + 1)
+        sites[pos] = (table[pos:location_end].decode(),
+                      table[location_end + 1:fmt_end].decode())
+        pos = fmt_end + 1
+    return sites
+
+
+def format_record(fmt, record):
+    """Substitutes the arguments in |record| into |fmt|."""
+    def substitute(match):
+        conv = match.group('conv')
+        if conv == '%':
+            return '%'
+
+        spec = '%' + match.group('flags')
+        for part, prefix in (('width', ''), ('precision', '.')):
+            value = match.group(part)
+            if value == '*':
+                value = str(record.signed())
+            if value is not None:
+                spec += prefix + value
+
+        if conv == 's':
+            return (spec + 's') % record.string()
+        if conv in 'eEfFgGaA':
+            return (spec + ('f' if conv in 'aA' else conv)) % record.float()
+
+        value = record.signed()
+        if conv == 'c':
+            return (spec + 'c') % chr(value & 0xFF)
+        if conv == 'p':
+            return '0x%x' % (value & 0xFFFFFFFFFFFFFFFF)
+        if conv in 'di':
+            return (spec + 'd') % value
+        value &= (1 << LENGTH_BITS[match.group('length')]) - 1
+        return (spec + ('d' if conv == 'u' else conv)) % value
+
+    return CONVERSION.sub(substitute, fmt)
+
+
+def decode(stream, sites, timestamps=False):
+    """Yields the text of each record in |stream|, skipping anything that isn't one."""
+    pos = 0
+    while pos + 2 <= len(stream):
+        if stream[pos] != LOG_TOKENIZED_SYNC:
+            pos += 1
+            continue
+        length = stream[pos + 1]
+        record = Record(stream[pos + 2:pos + 2 + length])
+        try:
+            header = record.varint()
+            timestamp_us = record.varint()
+            location, fmt = sites[header >> 2]
+            text = '[{}] {}: {}'.format(header & 0x3, location, format_record(fmt, record))
+        except (IndexError, KeyError, struct.error):
+            # Not a record after all - look for the next sync byte
+            pos += 1
+            continue
+        if timestamps:
+            text = '{:.6f} {}'.format(timestamp_us / 1e6, text)
+        yield text
+        pos += 2 + length
+
+
+def main():
+    """Decodes records from stdin or a file."""
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('sites', help='log_sites section dumped by the build')
+    parser.add_argument('input', nargs='?', help='records to decode, stdin by default')
+    parser.add_argument('--timestamps', action='store_true', help='prefix records with seconds')
+    args = parser.parse_args()
+
+    with open(args.sites, 'rb') as table:
+        sites = load_sites(table.read())
+    if args.input is None:
+        stream = sys.stdin.buffer.read()
+    else:
+        with open(args.input, 'rb') as records:
+            stream = records.read()
+
+    for text in decode(stream, sites, args.timestamps):
+        sys.stdout.write(text)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,211 @@
+#include "log.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "log_impl.h"
+
+#define LOG_DEFERRED_BUFFER_MASK (LOG_DEFERRED_BUFFER_SIZE - 1)
+
+_Static_assert((LOG_DEFERRED_BUFFER_SIZE & LOG_DEFERRED_BUFFER_MASK) == 0,
+               "LOG_DEFERRED_BUFFER_SIZE must be a power of 2");
+
+// Sync and length, then the token, level and timestamp take at most 2 + 5 + 5 bytes. Each
+// argument takes at most 10 bytes, or 1 + LOG_TOKENIZED_MAX_STRING_LEN for strings.
+#define LOG_TOKENIZED_MAX_RECORD_LEN \
+  (12 + LOG_TOKENIZED_MAX_ARGS * (1 + LOG_TOKENIZED_MAX_STRING_LEN))
+
+_Static_assert(LOG_TOKENIZED_MAX_RECORD_LEN - 2 <= UINT8_MAX,
+               "Tokenized record lengths must fit in a byte");
+
+// Free-running indices - only their difference is masked
+static uint8_t s_buffer[LOG_DEFERRED_BUFFER_SIZE];
+static uint32_t s_head;
+static uint32_t s_tail;
+
+static LogDeferredStats s_stats;
+static volatile LogDeferredReadyCallback s_ready_callback;
+
+static volatile LogClock s_clock;
+static volatile LogWriter s_writer;
+
+// Defined by the linker at the start of the section the sites are in. Weak since there's no such
+// section unless LOG_TOKENIZED is defined.
+extern const char __start_log_sites[] __attribute__((weak));
+
+// Copies a whole record into the buffer, or drops it if it doesn't fit
+static void prv_buffer(const uint8_t *record, size_t len) {
+  log_impl_lock();
+  uint32_t used = s_head - s_tail;
+  if (len > LOG_DEFERRED_BUFFER_SIZE - used) {
+    s_stats.dropped++;
+    log_impl_unlock();
+    return;
+  }
+
+  size_t start = s_head & LOG_DEFERRED_BUFFER_MASK;
+  size_t first = LOG_DEFERRED_BUFFER_SIZE - start;
+  if (first > len) {
+    first = len;
+  }
+  memcpy(&s_buffer[start], record, first);
+  memcpy(s_buffer, &record[first], len - first);
+  s_head += len;
+
+  s_stats.records++;
+  if (used + len > s_stats.max_buffered) {
+    s_stats.max_buffered = used + len;
+  }
+  log_impl_unlock();
+
+  LogDeferredReadyCallback callback = s_ready_callback;
+  if (callback != NULL) {
+    callback();
+  }
+}
+
+void log_deferred_printf(const char *fmt, ...) {
+  // Format outside the lock, so only the copy holds off interrupts
+  char record[LOG_DEFERRED_MAX_RECORD_LEN];
+  va_list args;
+  va_start(args, fmt);
+  int formatted = vsnprintf(record, sizeof(record), fmt, args);
+  va_end(args);
+  if (formatted <= 0) {
+    return;
+  }
+
+  size_t len = (size_t)formatted;
+  if (len >= sizeof(record)) {
+    // Keep truncated records on their own line
+    len = sizeof(record) - 1;
+    record[len - 1] = '\n';
+  }
+
+  prv_buffer((const uint8_t *)record, len);
+}
+
+size_t log_deferred_read(uint8_t *data, size_t max_len) {
+  if (data == NULL) {
+    return 0;
+  }
+
+  log_impl_lock();
+  size_t len = s_head - s_tail;
+  if (len > max_len) {
+    len = max_len;
+  }
+
+  size_t start = s_tail & LOG_DEFERRED_BUFFER_MASK;
+  size_t first = LOG_DEFERRED_BUFFER_SIZE - start;
+  if (first > len) {
+    first = len;
+  }
+  memcpy(data, &s_buffer[start], first);
+  memcpy(&data[first], s_buffer, len - first);
+  s_tail += len;
+  log_impl_unlock();
+
+  return len;
+}
+
+void log_deferred_set_ready_callback(LogDeferredReadyCallback callback) {
+  s_ready_callback = callback;
+}
+
+void log_deferred_get_stats(LogDeferredStats *stats) {
+  if (stats == NULL) {
+    return;
+  }
+  log_impl_lock();
+  *stats = s_stats;
+  log_impl_unlock();
+}
+
+static size_t prv_put_varint(uint8_t *record, size_t len, uint64_t value) {
+  while (value >= 0x80) {
+    record[len++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  record[len++] = (uint8_t)value;
+  return len;
+}
+
+// Small magnitudes of either sign stay short
+static size_t prv_put_signed(uint8_t *record, size_t len, int64_t value) {
+  return prv_put_varint(record, len, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void log_tokenized_write(const char *site, LogLevel level, uint32_t arg_types, ...) {
+  uint8_t record[LOG_TOKENIZED_MAX_RECORD_LEN];
+  size_t len = 2;
+  record[0] = LOG_TOKENIZED_SYNC;
+
+  uint32_t token = (uint32_t)(site - __start_log_sites);
+  len = prv_put_varint(record, len, ((uint64_t)token << 2) | ((uint32_t)level & 0x3));
+  LogClock clock = s_clock;
+  len = prv_put_varint(record, len, clock != NULL ? clock() : 0);
+
+  va_list args;
+  va_start(args, arg_types);
+  for (; arg_types != LOG_ARG_END; arg_types >>= LOG_ARG_BITS) {
+    switch (arg_types & ((1 << LOG_ARG_BITS) - 1)) {
+      case LOG_ARG_INT32:
+        len = prv_put_signed(record, len, va_arg(args, int32_t));
+        break;
+      case LOG_ARG_UINT32:
+        len = prv_put_signed(record, len, va_arg(args, uint32_t));
+        break;
+      case LOG_ARG_INT64:
+        len = prv_put_signed(record, len, va_arg(args, int64_t));
+        break;
+      case LOG_ARG_UINT64:
+        len = prv_put_signed(record, len, (int64_t)va_arg(args, uint64_t));
+        break;
+      case LOG_ARG_DOUBLE: {
+        float value = (float)va_arg(args, double);
+        memcpy(&record[len], &value, sizeof(value));
+        len += sizeof(value);
+        break;
+      }
+      case LOG_ARG_STRING: {
+        const char *value = va_arg(args, const char *);
+        if (value == NULL) {
+          value = "(null)";
+        }
+        size_t str_len = 0;
+        while (str_len < LOG_TOKENIZED_MAX_STRING_LEN && value[str_len] != '\0') {
+          str_len++;
+        }
+        record[len++] = (uint8_t)str_len;
+        memcpy(&record[len], value, str_len);
+        len += str_len;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  va_end(args);
+  record[1] = (uint8_t)(len - 2);
+
+  LogWriter writer = s_writer;
+  if (writer != NULL) {
+    writer(record, len);
+    return;
+  }
+#ifdef LOG_DEFERRED
+  prv_buffer(record, len);
+#else
+  fwrite(record, 1, len, stdout);
+  fflush(stdout);
+#endif
+}
+
+void log_tokenized_set_clock(LogClock clock) {
+  s_clock = clock;
+}
+
+void log_tokenized_set_writer(LogWriter writer) {
+  s_writer = writer;
+}
@@ -0,0 +1,19 @@
+#include "log_impl.h"
+
+#include <stdint.h>
+
+// Only read back by the holder of the lock, with interrupts disabled
+static uint32_t s_primask;
+
+void log_impl_lock(void) {
+  uint32_t primask = 0;
+  __asm volatile("mrs %0, primask" : "=r"(primask));
+  __asm volatile("cpsid i" ::: "memory");
+  s_primask = primask;
+}
+
+void log_impl_unlock(void) {
+  if (!s_primask) {
+    __asm volatile("cpsie i" ::: "memory");
+  }
+}
@@ -0,0 +1,78 @@
+#include "log_impl.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "log.h"
+
+// Both interrupt backends run handlers from signals, so block signals and then take a mutex.
+// Neither is reentrant, which is fine since the lock isn't either.
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread sigset_t s_prev_mask;
+
+void log_impl_lock(void) {
+  sigset_t all;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &s_prev_mask);
+  pthread_mutex_lock(&s_mutex);
+}
+
+void log_impl_unlock(void) {
+  pthread_mutex_unlock(&s_mutex);
+  pthread_sigmask(SIG_SETMASK, &s_prev_mask, NULL);
+}
+
+#ifdef LOG_DEFERRED
+// With the deferred backend, a writer thread plays the part of the UART
+
+#define LOG_WRITER_CHUNK_LEN 256
+
+static sem_t s_ready;
+static pthread_mutex_t s_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void prv_drain(void) {
+  uint8_t chunk[LOG_WRITER_CHUNK_LEN];
+  pthread_mutex_lock(&s_writer_mutex);
+  size_t len = 0;
+  while ((len = log_deferred_read(chunk, sizeof(chunk))) > 0) {
+    fwrite(chunk, 1, len, stdout);
+  }
+  fflush(stdout);
+  pthread_mutex_unlock(&s_writer_mutex);
+}
+
+static void *prv_writer(void *arg) {
+  while (true) {
+    sem_wait(&s_ready);
+    prv_drain();
+  }
+  return NULL;
+}
+
+// sem_post is safe to call from signal handlers
+static void prv_ready(void) {
+  sem_post(&s_ready);
+}
+
+__attribute__((constructor)) static void prv_start_writer(void) {
+  sem_init(&s_ready, 0, 0);
+
+  // The writer should never run emulated interrupts
+  sigset_t all;
+  sigset_t prev;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &prev);
+  pthread_t writer;
+  pthread_create(&writer, NULL, prv_writer, NULL);
+  pthread_detach(writer);
+  pthread_sigmask(SIG_SETMASK, &prev, NULL);
+
+  log_deferred_set_ready_callback(prv_ready);
+  // Anything still buffered at exit goes out before the process does
+  atexit(prv_drain);
+}
+#endif
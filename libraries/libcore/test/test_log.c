@@ -0,0 +1,175 @@
+// Route LOG through the deferred backend whether or not it was picked for the build
+#ifndef LOG_DEFERRED
+#define LOG_DEFERRED
+#endif
+#include "log.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+#define TEST_BENCHMARK_RUNS 2000
+// Records the main loop logs before the reader gets a turn
+#define TEST_BENCHMARK_BURST 8
+#define TEST_UART_BAUDRATE 115200
+// 8N1
+#define TEST_UART_BITS_PER_BYTE 10
+
+// A typical 60-ish byte debug line
+#define TEST_BENCHMARK_LOG(run)                                              \
+  LOG_DEBUG("Cell %lu: %lu mV, temp %lu dC\n", (unsigned long)((run) % 36), \
+            (unsigned long)(36000 + (run)), (unsigned long)(250 + (run) % 100))
+
+// "record a\n"
+#define TEST_RECORD_LEN 9
+
+static uint8_t s_read_buffer[LOG_DEFERRED_BUFFER_SIZE + 1];
+static uint32_t s_num_ready;
+
+static void prv_ready(void) {
+  s_num_ready++;
+}
+
+static size_t prv_read_all(void) {
+  size_t len = log_deferred_read(s_read_buffer, LOG_DEFERRED_BUFFER_SIZE);
+  s_read_buffer[len] = '\0';
+  return len;
+}
+
+static uint32_t prv_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec);
+}
+
+void setup_test(void) {
+  // Keep any writer thread from reading before the tests do
+  log_deferred_set_ready_callback(NULL);
+  prv_read_all();
+  s_num_ready = 0;
+}
+
+void teardown_test(void) {}
+
+void test_log_deferred_record(void) {
+  LOG_DEBUG("hello %d\n", 5);
+  size_t len = prv_read_all();
+  TEST_ASSERT_EQUAL_STRING_LEN("[0] ", s_read_buffer, 4);
+  TEST_ASSERT_NOT_NULL(strstr((char *)s_read_buffer, "test_log.c:"));
+  TEST_ASSERT_EQUAL_STRING("hello 5\n", &s_read_buffer[len - strlen("hello 5\n")]);
+
+  // Nothing left
+  TEST_ASSERT_EQUAL(0, prv_read_all());
+}
+
+void test_log_deferred_partial_reads(void) {
+  log_deferred_printf("abcdef");
+  uint8_t data[4] = { 0 };
+  TEST_ASSERT_EQUAL(4, log_deferred_read(data, sizeof(data)));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY("abcd", data, 4);
+  TEST_ASSERT_EQUAL(2, log_deferred_read(data, sizeof(data)));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY("ef", data, 2);
+  TEST_ASSERT_EQUAL(0, log_deferred_read(NULL, 1));
+}
+
+void test_log_deferred_drops_when_full(void) {
+  LogDeferredStats before = { 0 };
+  log_deferred_get_stats(&before);
+
+  // Records wrap around the buffer a few times over
+  uint32_t logged = 0;
+  for (uint32_t i = 0; i < LOG_DEFERRED_BUFFER_SIZE / 4; i++) {
+    log_deferred_printf("record %c\n", 'a' + (int)(i % 26));
+    logged++;
+  }
+
+  LogDeferredStats after = { 0 };
+  log_deferred_get_stats(&after);
+  uint32_t buffered = after.records - before.records;
+  uint32_t dropped = after.dropped - before.dropped;
+  TEST_ASSERT_EQUAL(logged, buffered + dropped);
+  TEST_ASSERT_EQUAL(LOG_DEFERRED_BUFFER_SIZE / TEST_RECORD_LEN, buffered);
+  TEST_ASSERT_TRUE(after.max_buffered >= buffered * TEST_RECORD_LEN);
+
+  // Only whole records are kept, oldest first
+  TEST_ASSERT_EQUAL(buffered * TEST_RECORD_LEN, prv_read_all());
+  for (uint32_t i = 0; i < buffered; i++) {
+    TEST_ASSERT_EQUAL('a' + (int)(i % 26), s_read_buffer[i * TEST_RECORD_LEN + 7]);
+    TEST_ASSERT_EQUAL('\n', s_read_buffer[i * TEST_RECORD_LEN + 8]);
+  }
+
+  // There's room again once read
+  log_deferred_printf("record z\n");
+  log_deferred_get_stats(&before);
+  TEST_ASSERT_EQUAL(after.records + 1, before.records);
+}
+
+void test_log_deferred_truncates(void) {
+  char long_line[LOG_DEFERRED_MAX_RECORD_LEN * 2];
+  memset(long_line, 'x', sizeof(long_line) - 1);
+  long_line[sizeof(long_line) - 1] = '\0';
+
+  log_deferred_printf("%s\n", long_line);
+  TEST_ASSERT_EQUAL(LOG_DEFERRED_MAX_RECORD_LEN - 1, prv_read_all());
+  TEST_ASSERT_EQUAL('x', s_read_buffer[LOG_DEFERRED_MAX_RECORD_LEN - 3]);
+  TEST_ASSERT_EQUAL('\n', s_read_buffer[LOG_DEFERRED_MAX_RECORD_LEN - 2]);
+}
+
+void test_log_deferred_ready_callback(void) {
+  log_deferred_set_ready_callback(prv_ready);
+  LOG_WARN("one\n");
+  LOG_CRITICAL("two\n");
+  log_deferred_set_ready_callback(NULL);
+  LOG_WARN("three\n");
+  TEST_ASSERT_EQUAL(2, s_num_ready);
+  prv_read_all();
+}
+
+// Measures the worst case time LOG_DEBUG holds up its caller, both while records fit and once the
+// reader falls behind and they're dropped. Timing on the host is only indicative, so this just
+// logs the results.
+void test_log_deferred_benchmark(void) {
+  TEST_BENCHMARK_LOG(0);
+  size_t line_len = prv_read_all();
+
+  uint32_t max_ns[2] = { 0 };
+  uint64_t total_ns[2] = { 0 };
+  LogDeferredStats before = { 0 };
+  log_deferred_get_stats(&before);
+
+  for (size_t full = 0; full < 2; full++) {
+    for (uint32_t run = 0; run < TEST_BENCHMARK_RUNS; run++) {
+      uint32_t start_ns = prv_now_ns();
+      TEST_BENCHMARK_LOG(run);
+      uint32_t elapsed_ns = prv_now_ns() - start_ns;
+
+      total_ns[full] += elapsed_ns;
+      if (elapsed_ns > max_ns[full]) {
+        max_ns[full] = elapsed_ns;
+      }
+      // Only read during the first half, so the second half fills the buffer
+      if (!full && run % TEST_BENCHMARK_BURST == 0) {
+        prv_read_all();
+      }
+    }
+  }
+
+  LogDeferredStats after = { 0 };
+  log_deferred_get_stats(&after);
+  prv_read_all();
+  TEST_ASSERT_TRUE(after.dropped - before.dropped > 0);
+  TEST_ASSERT_EQUAL(2 * TEST_BENCHMARK_RUNS,
+                    after.records - before.records + after.dropped - before.dropped);
+
+  // printf on stm32f0xx waits for every byte to go out at the baudrate
+  uint32_t blocking_ns = (uint32_t)((uint64_t)line_len * TEST_UART_BITS_PER_BYTE * 1000000000 /
+                                    TEST_UART_BAUDRATE);
+  printf("LOG_DEBUG of %lu bytes: blocking UART %lu ns, deferred max %lu ns (avg %lu ns), "
+         "dropping max %lu ns (avg %lu ns), %lu dropped\n",
+         (unsigned long)line_len, (unsigned long)blocking_ns, (unsigned long)max_ns[0],
+         (unsigned long)(total_ns[0] / TEST_BENCHMARK_RUNS), (unsigned long)max_ns[1],
+         (unsigned long)(total_ns[1] / TEST_BENCHMARK_RUNS),
+         (unsigned long)(after.dropped - before.dropped));
+}
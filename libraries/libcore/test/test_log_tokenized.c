@@ -0,0 +1,193 @@
+// Send tokenized records whether or not they were picked for the build
+#ifndef LOG_TOKENIZED
+#define LOG_TOKENIZED
+#endif
+#include "log.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+// Run from the repository root like the rest of the tests
+#define TEST_DECODER "python3 libraries/libcore/scripts/log_decode.py"
+#define TEST_SITES_FILE "/tmp/test_log_tokenized.log_sites"
+#define TEST_RECORDS_FILE "/tmp/test_log_tokenized.records"
+
+#define TEST_BUFFER_SIZE 4096
+#define TEST_BENCHMARK_RUNS 2000
+#define TEST_TIMESTAMP_US 1234567
+
+// Logs a record and formats the text LOG would have printed alongside it
+#define TEST_LOG(level, fmt, ...)                                                                \
+  do {                                                                                           \
+    LOG((level), fmt, ##__VA_ARGS__);                                                            \
+    prv_expect("[%u] %s:%u: " fmt, (level), __FILE__, __LINE__, ##__VA_ARGS__);                 \
+  } while (0)
+
+// The same typical debug line as test_log
+#define TEST_BENCHMARK_ARGS(run) \
+  (unsigned long)((run) % 36), (unsigned long)(36000 + (run)), (unsigned long)(250 + (run) % 100)
+#define TEST_BENCHMARK_FMT "Cell %lu: %lu mV, temp %lu dC\n"
+
+// Bounds of the log_sites section
+extern const char __start_log_sites[];
+extern const char __stop_log_sites[];
+
+static uint8_t s_records[TEST_BUFFER_SIZE];
+static size_t s_records_len;
+static size_t s_total_len;
+static uint32_t s_num_records;
+
+static char s_expected[TEST_BUFFER_SIZE];
+static size_t s_expected_len;
+
+static char s_decoded[TEST_BUFFER_SIZE];
+
+static void prv_writer(const uint8_t *record, size_t len) {
+  // Only the benchmark fills the buffer, and it doesn't look at the records
+  if (s_records_len + len > sizeof(s_records)) {
+    s_records_len = 0;
+  }
+  memcpy(&s_records[s_records_len], record, len);
+  s_records_len += len;
+  s_total_len += len;
+  s_num_records++;
+}
+
+static uint32_t prv_clock(void) {
+  return TEST_TIMESTAMP_US;
+}
+
+static void prv_expect(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(&s_expected[s_expected_len], sizeof(s_expected) - s_expected_len, fmt, args);
+  va_end(args);
+  TEST_ASSERT_TRUE(len >= 0);
+  s_expected_len += (size_t)len;
+}
+
+static void prv_write_file(const char *path, const void *data, size_t len) {
+  FILE *file = fopen(path, "wb");
+  TEST_ASSERT_NOT_NULL(file);
+  TEST_ASSERT_EQUAL(len, fwrite(data, 1, len, file));
+  fclose(file);
+}
+
+// Runs the decoder over the captured records with the sites the test binary was built with
+static void prv_decode(const char *options) {
+  size_t sites_len = (size_t)(__stop_log_sites - __start_log_sites);
+  prv_write_file(TEST_SITES_FILE, __start_log_sites, sites_len);
+  prv_write_file(TEST_RECORDS_FILE, s_records, s_records_len);
+
+  char command[256];
+  snprintf(command, sizeof(command), TEST_DECODER " %s " TEST_SITES_FILE " " TEST_RECORDS_FILE,
+           options);
+  FILE *decoder = popen(command, "r");
+  TEST_ASSERT_NOT_NULL(decoder);
+  size_t len = fread(s_decoded, 1, sizeof(s_decoded) - 1, decoder);
+  s_decoded[len] = '\0';
+  TEST_ASSERT_EQUAL(0, pclose(decoder));
+}
+
+static uint32_t prv_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec);
+}
+
+void setup_test(void) {
+  log_tokenized_set_writer(prv_writer);
+  log_tokenized_set_clock(NULL);
+  s_records_len = 0;
+  s_total_len = 0;
+  s_num_records = 0;
+  s_expected_len = 0;
+  s_expected[0] = '\0';
+}
+
+void teardown_test(void) {
+  log_tokenized_set_writer(NULL);
+}
+
+void test_log_tokenized_record(void) {
+  LOG_WARN("hello %d\n", 5);
+  TEST_ASSERT_EQUAL(1, s_num_records);
+  TEST_ASSERT_EQUAL_HEX8(LOG_TOKENIZED_SYNC, s_records[0]);
+  TEST_ASSERT_EQUAL(s_records_len - 2, s_records[1]);
+  // Token and level, no timestamp, then 5 zigzagged
+  TEST_ASSERT_EQUAL(LOG_LEVEL_WARN, s_records[2] & 0x3);
+  TEST_ASSERT_EQUAL(0, s_records[s_records_len - 2]);
+  TEST_ASSERT_EQUAL(10, s_records[s_records_len - 1]);
+}
+
+void test_log_tokenized_arg_types(void) {
+  TEST_ASSERT_EQUAL(0, LOG_ARG_TYPES(""));
+  TEST_ASSERT_EQUAL(LOG_ARG_INT32, LOG_ARG_TYPES("", (uint8_t)1));
+  TEST_ASSERT_EQUAL(LOG_ARG_UINT32, LOG_ARG_TYPES("", 1u));
+  TEST_ASSERT_EQUAL(LOG_ARG_INT64, LOG_ARG_TYPES("", 1ll));
+  TEST_ASSERT_EQUAL(LOG_ARG_DOUBLE, LOG_ARG_TYPES("", 1.0f));
+  TEST_ASSERT_EQUAL(LOG_ARG_STRING, LOG_ARG_TYPES("", "a"));
+  TEST_ASSERT_EQUAL(LOG_ARG_INT32 | LOG_ARG_STRING << LOG_ARG_BITS |
+                        LOG_ARG_UINT64 << (2 * LOG_ARG_BITS),
+                    LOG_ARG_TYPES("", 1, "a", 1ull));
+}
+
+void test_log_tokenized_decode(void) {
+  char name[] = "bms";
+  // Junk between records is skipped
+  prv_writer((const uint8_t *)"\x01\x02", 2);
+  TEST_LOG(LOG_LEVEL_DEBUG, "no args\n");
+  TEST_LOG(LOG_LEVEL_WARN, "ints %d %d %u %ld %lld\n", -1, 300, 4000000000u, -70000l, 1ll << 40);
+  TEST_LOG(LOG_LEVEL_CRITICAL, "hex %x %04X %hhu %c %%\n", 0xbeefu, 0x1fu, (unsigned char)200,
+           'z');
+  TEST_LOG(LOG_LEVEL_DEBUG, "floats %.2f %f\n", 1.5, -0.25f);
+  TEST_LOG(LOG_LEVEL_DEBUG, "strings %s %5s|\n", "hello", name);
+  TEST_LOG(LOG_LEVEL_DEBUG, "width %*d|\n", 4, 7);
+  prv_writer((const uint8_t *)"\xA5", 1);
+
+  prv_decode("");
+  TEST_ASSERT_EQUAL_STRING(s_expected, s_decoded);
+}
+
+void test_log_tokenized_long_string(void) {
+  LOG_DEBUG("%s\n", "this string is longer than the limit");
+  prv_decode("");
+  TEST_ASSERT_NOT_NULL(strstr(s_decoded, ": this string is longe\n"));
+}
+
+void test_log_tokenized_timestamps(void) {
+  log_tokenized_set_clock(prv_clock);
+  LOG_DEBUG("tick\n");
+  prv_decode("--timestamps");
+  TEST_ASSERT_EQUAL_STRING_LEN("1.234567 [0] ", s_decoded, 13);
+}
+
+// Compares the bytes sent and time taken against formatting the same record as text
+void test_log_tokenized_benchmark(void) {
+  char text[LOG_DEFERRED_MAX_RECORD_LEN];
+  size_t text_bytes = 0;
+  uint32_t start_ns = prv_now_ns();
+  for (uint32_t run = 0; run < TEST_BENCHMARK_RUNS; run++) {
+    int len = snprintf(text, sizeof(text), "[%u] %s:%u: " TEST_BENCHMARK_FMT, LOG_LEVEL_DEBUG,
+                       __FILE__, __LINE__, TEST_BENCHMARK_ARGS(run));
+    text_bytes += (size_t)len;
+  }
+  uint32_t text_ns = prv_now_ns() - start_ns;
+
+  start_ns = prv_now_ns();
+  for (uint32_t run = 0; run < TEST_BENCHMARK_RUNS; run++) {
+    LOG_DEBUG(TEST_BENCHMARK_FMT, TEST_BENCHMARK_ARGS(run));
+  }
+  uint32_t tokenized_ns = prv_now_ns() - start_ns;
+
+  size_t tokenized_bytes = s_total_len;
+  printf("%d records: text %lu bytes in %lu ns, tokenized %lu bytes in %lu ns\n",
+         TEST_BENCHMARK_RUNS, (unsigned long)text_bytes, (unsigned long)text_ns,
+         (unsigned long)tokenized_bytes, (unsigned long)tokenized_ns);
+  TEST_ASSERT_EQUAL(TEST_BENCHMARK_RUNS, s_num_records);
+  TEST_ASSERT_TRUE(tokenized_bytes * 4 <= text_bytes);
+}
@@ -1,6 +1,15 @@
 #pragma once
 // Analog to Digital Converter HAL Inteface
 // Requires GPIO and interrupts to be initialized.
+//
+// Every conversion runs the whole sequence of enabled channels, in channel order. In single mode
+// each read starts a sequence and waits for it, and in continuous mode sequences run back to back.
+// In scan mode, sequences are only started by adc_scan_start() and are transferred by DMA, so
+// there's one interrupt per sequence rather than one per channel, and reads return the latest
+// results without waiting.
+//
+// Once a sequence is done, its results are published as a snapshot which can be taken with
+// adc_get_snapshot() or passed to a sequence callback, in every mode.
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -10,6 +19,7 @@
 typedef enum {
   ADC_MODE_SINGLE = 0,
   ADC_MODE_CONTINUOUS,
+  ADC_MODE_SCAN,
   NUM_ADC_MODES,
 } AdcMode;
 
@@ -42,12 +52,28 @@ typedef enum {
 // Following typedef deprecated in favour of GpioAddress Version
 typedef void (*AdcCallback)(AdcChannel adc_channel, void *context);
 
+// The results of one conversion sequence
+typedef struct AdcSnapshot {
+  // Raw 12-bit readings by channel - only those in |channels| are valid
+  uint16_t raw[NUM_ADC_CHANNELS];
+  // Bitset of the channels converted
+  uint32_t channels;
+  // Vdda in mV, or 0 if the reference wasn't converted
+  uint16_t vdda_mv;
+  // When the sequence finished (see soft_timer_now_us())
+  uint32_t timestamp_us;
+} AdcSnapshot;
+
+// Called from the ADC's interrupt once each sequence is done
+typedef void (*AdcSequenceCallback)(const AdcSnapshot *snapshot, void *context);
+
 // Initialize the ADC to the desired conversion mode
 void adc_init(AdcMode adc_mode);
 
 // Enable or disable a given pin.
 // A race condition may occur when setting a pin during a conversion.
 // However, it should not cause issues given the intended use cases
+// In scan mode, returns STATUS_CODE_RESOURCE_EXHAUSTED while a scan is running.
 // To set adc channels REF/TEMP/BAT, you must use adc_set_channel() below
 StatusCode adc_set_channel_pin(GpioAddress address, bool new_state);
 
@@ -64,12 +90,37 @@ StatusCode adc_read_raw_pin(GpioAddress address, uint16_t *reading);
 // Obtain the converted value at the specified pin, in mV
 StatusCode adc_read_converted_pin(GpioAddress address, uint16_t *reading);
 
+// Obtain Vdda in mV, as measured with the internal reference at the end of the last conversion
+// sequence, and when that was in microseconds (see soft_timer_now_us()). |timestamp_us| may be
+// NULL. The reference is enabled by adc_init() and converted in the same sequence as every other
+// channel, so converted reads don't need a sequence of their own for it.
+// Returns STATUS_CODE_EMPTY if the reference hasn't been converted yet.
+StatusCode adc_get_vdda(uint16_t *vdda_mv, uint32_t *timestamp_us);
+
+// Register a callback to be called with the snapshot of every sequence. Pass NULL to remove it.
+void adc_register_sequence_callback(AdcSequenceCallback callback, void *context);
+
+// Start converting the enabled channels in scan mode. Doesn't wait for the results.
+// Returns STATUS_CODE_UNINITIALIZED outside of scan mode, STATUS_CODE_RESOURCE_EXHAUSTED if a scan
+// is still running and STATUS_CODE_EMPTY if no channels are enabled.
+StatusCode adc_scan_start(void);
+
+// Copy the snapshot of the latest sequence.
+// Returns STATUS_CODE_EMPTY if no sequence has finished since adc_init().
+StatusCode adc_get_snapshot(AdcSnapshot *snapshot);
+
+// Obtain the converted value of a channel in a snapshot, like adc_read_converted().
+// Returns STATUS_CODE_EMPTY if the channel, or the reference it needs, wasn't converted.
+StatusCode adc_get_snapshot_converted(const AdcSnapshot *snapshot, AdcChannel adc_channel,
+                                      uint16_t *reading);
+
 // Following code and functions use adc channels as seen below
 // but are now deprecated; they are still used in the current code base
 
 // Enable or disable a given channel - must be used for channels TEMP/REF/BAT
 // A race condition may occur when setting a channel during a conversion.
 // However, it should not cause issues given the intended use cases
+// In scan mode, returns STATUS_CODE_RESOURCE_EXHAUSTED while a scan is running.
 StatusCode adc_set_channel(AdcChannel adc_channel, bool new_state);
 
 // Deprecated in favour of GpioAddress version
@@ -14,9 +14,12 @@
 #include "can_ack.h"
 #include "can_fifo.h"
 #include "can_hw.h"
+#include "can_queue.h"
 #include "can_rx.h"
+#include "can_stats.h"
 #include "fsm.h"
 #include "gpio.h"
+#include "soft_timer.h"
 
 #define CAN_NUM_RX_HANDLERS 10
 
@@ -33,7 +36,7 @@ typedef struct CanSettings {
 
 typedef struct CanStorage {
   Fsm fsm;
-  volatile CanFifo tx_fifo;
+  CanQueue tx_queue;
   volatile CanFifo rx_fifo;
   CanAckRequests ack_requests;
   CanRxHandlers rx_handlers;
@@ -42,23 +45,51 @@ typedef struct CanStorage {
   EventId tx_event;
   EventId fault_event;
   uint16_t device_id;
+  // Message IDs we've waited on an ACK for, which the hardware filters let through
+  uint64_t ack_filter_ids;
+  // An ACK ID was added since the filters were built - they're rebuilt before the next TX
+  volatile bool ack_filters_stale;
+  // Set by can_add_filter(), which turns off automatic filters
+  bool manual_filters;
+  bool loopback;
+  CanStats stats;
+  CanMessageId stats_msg_id;
+  CanMessageId stats_reported_id;
+  uint32_t stats_period_ms;
+  SoftTimerId stats_timer_id;
 } CanStorage;
 
 // Initializes the specified CAN configuration.
 StatusCode can_init(CanStorage *storage, const CanSettings *settings);
 
-// Adds a hardware filter for the specified message ID.
+// Adds a hardware filter for the specified message ID. Once one is added, the filters are no longer
+// generated from the registered handlers.
 StatusCode can_add_filter(CanMessageId msg_id);
 
-// Registers a default RX handler for messages without specific RX handlers.
+// Registers a default RX handler for messages without specific RX handlers. The hardware then
+// accepts every frame.
 StatusCode can_register_rx_default_handler(CanRxHandlerCb handler, void *context);
 
-// Registers an RX handler for a specific message ID.
+// Registers an RX handler for a specific message ID. Until a default handler is registered, the
+// hardware only accepts frames with a handler or an ACK we're waiting on.
 StatusCode can_register_rx_handler(CanMessageId msg_id, CanRxHandlerCb handler, void *context);
 
-// Attempts to transmit the CAN message as soon as possible.
+// Attempts to transmit the CAN message as soon as possible. Queued messages go out lowest ID first,
+// so critical messages don't wait behind telemetry.
 StatusCode can_transmit(const CanMessage *msg, const CanAckRequest *ack_request);
 
+// Copies the traffic counters for a message ID since can_init().
+StatusCode can_get_stats(CanMessageId msg_id, CanStatsCounters *counters);
+
+// Returns the estimated bus load over the last CAN_STATS_WINDOW_MS in permille of the bitrate.
+// This counts the frames this node sends and receives, so it only sees what passes the filters.
+StatusCode can_get_bus_load(uint16_t *load_permille);
+
+// Transmits a diagnostic message as |diag_msg_id| every |period_ms|, reporting the bus load and the
+// counters of one message ID with traffic, taking turns. See can_stats_pack() for the layout.
+// A period of 0 stops publishing.
+StatusCode can_publish_stats(CanMessageId diag_msg_id, uint32_t period_ms);
+
 // Processes the registered events. This must be called for the CAN network
 // layer to work.
 bool can_process_event(const Event *e);
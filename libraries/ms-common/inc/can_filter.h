@@ -0,0 +1,48 @@
+#pragma once
+// CAN acceptance filter generation
+// Compiles a set of standard IDs into the bxCAN's filter banks, so frames nobody handles are
+// dropped by the hardware instead of costing an interrupt. Banks are used in 16-bit scale: each
+// one holds either two ID/mask pairs or a list of four exact IDs.
+//
+// Patterns that differ in a single bit are merged wherever that doesn't accept anything extra. If
+// they still don't fit, the pairs that add the fewest unwanted IDs are merged until they do - the
+// software handlers drop whatever gets through.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "status.h"
+
+#define CAN_FILTER_NUM_BANKS 14
+#define CAN_FILTER_STANDARD_ID_MASK 0x7FF
+// Most patterns can_filter_build() takes at once
+#define CAN_FILTER_MAX_PATTERNS 128
+
+// Standard IDs that match |id| in every bit set in |mask|
+typedef struct CanFilter {
+  uint16_t id;
+  uint16_t mask;
+} CanFilter;
+
+typedef enum {
+  CAN_FILTER_BANK_MODE_MASK = 0,
+  CAN_FILTER_BANK_MODE_LIST,
+  NUM_CAN_FILTER_BANK_MODES,
+} CanFilterBankMode;
+
+// Unused slots repeat one of the others
+typedef struct CanFilterBank {
+  CanFilterBankMode mode;
+  union {
+    CanFilter filters[2];
+    uint16_t ids[4];
+  };
+} CanFilterBank;
+
+// Builds as few banks as it can, at most |max_banks|, that accept every ID matching one of
+// |patterns|. The number used is returned in |num_banks| - no patterns need no banks.
+StatusCode can_filter_build(const CanFilter *patterns, size_t num_patterns, CanFilterBank *banks,
+                            size_t max_banks, size_t *num_banks);
+
+// Returns whether a standard ID passes any of |banks|. No banks accept every ID, like hardware
+// that was never configured.
+bool can_filter_match(const CanFilterBank *banks, size_t num_banks, uint16_t id);
@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "can_filter.h"
 #include "gpio.h"
 #include "status.h"
 
@@ -50,6 +51,10 @@ StatusCode can_hw_register_callback(CanHwEvent event, CanHwEventHandlerCb callba
 
 StatusCode can_hw_add_filter(uint32_t mask, uint32_t filter, bool extended);
 
+// Replaces every filter, including any from can_hw_add_filter(), with |banks| built by
+// can_filter_build(). Extended frames are rejected. No banks accept every frame.
+StatusCode can_hw_set_filters(const CanFilterBank *banks, size_t num_banks);
+
 CanHwBusStatus can_hw_bus_status(void);
 
 StatusCode can_hw_transmit(uint32_t id, bool extended, const uint8_t *data, size_t len);
@@ -1,13 +1,18 @@
 #pragma once
+// Priority queue of CAN messages
+// Messages come out in arbitration order, lowest CAN ID first, so critical messages go ahead of
+// any backlog of telemetry. Messages with the same ID come out in the order they were pushed.
 #include "can_msg.h"
 #include "pqueue_backed.h"
 
-#define CAN_QUEUE_SIZE 10
+#define CAN_QUEUE_SIZE 32
 
 typedef struct CanQueue {
   PQueueBacked pqueue;
   PQueueNode queue_nodes[CAN_QUEUE_SIZE + 1];
   CanMessage msg_nodes[CAN_QUEUE_SIZE];
+  // Breaks ties between messages with the same ID
+  uint32_t seq;
 } CanQueue;
 
 StatusCode can_queue_init(CanQueue *can_queue);
@@ -0,0 +1,70 @@
+#pragma once
+// CAN traffic statistics
+// Counts frames per message ID and estimates the bus load from the frames this node sees. The
+// network layer keeps one in its CanStorage - see can_get_stats() and can_get_bus_load().
+//
+// RX counters are written from the CAN RX interrupt and TX dropped from can_transmit(), which can
+// run in any context, so the network layer counts those in a critical section. Everything else is
+// only written from the main loop.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "can_hw.h"
+#include "can_msg.h"
+#include "status.h"
+
+// How long the bus load is averaged over
+#define CAN_STATS_WINDOW_MS 1000
+
+// Nominal frame lengths, including the interframe space but ignoring bit stuffing
+#define CAN_STATS_STANDARD_FRAME_BITS 47
+#define CAN_STATS_EXTENDED_FRAME_BITS 67
+
+typedef enum {
+  // Handed to the hardware to transmit
+  CAN_STATS_COUNTER_TX = 0,
+  // Received, whether or not it could be queued
+  CAN_STATS_COUNTER_RX,
+  // Dropped because the TX queue was full
+  CAN_STATS_COUNTER_TX_DROPPED,
+  // Dropped because the RX FIFO was full
+  CAN_STATS_COUNTER_RX_DROPPED,
+  // Transmit attempts the hardware rejected. The frame stays queued and is retried.
+  CAN_STATS_COUNTER_TX_FAILED,
+  NUM_CAN_STATS_COUNTERS
+} CanStatsCounter;
+
+// Counters wrap
+typedef struct CanStatsCounters {
+  uint16_t counts[NUM_CAN_STATS_COUNTERS];
+} CanStatsCounters;
+
+typedef struct CanStats {
+  CanStatsCounters ids[CAN_MSG_MAX_IDS];
+  // Running totals of bus time in bits, kept apart since they have different writers
+  volatile uint32_t tx_bits;
+  volatile uint32_t rx_bits;
+  uint32_t bitrate;
+  uint32_t window_start_us;
+  uint32_t window_start_bits;
+  uint16_t bus_load_permille;
+} CanStats;
+
+StatusCode can_stats_init(CanStats *stats, CanHwBitrate bitrate);
+
+// Counts a frame for |msg_id|. IDs out of range are ignored.
+void can_stats_count(CanStats *stats, CanMessageId msg_id, CanStatsCounter counter);
+
+// Adds a frame's bus time to the load estimate
+void can_stats_add_frame(CanStats *stats, bool tx, bool extended, size_t dlc);
+
+// Returns the bus load over the last complete window in permille of the bitrate, starting a new
+// window if this one is over. Not reentrant.
+uint16_t can_stats_get_bus_load(CanStats *stats);
+
+// Packs a diagnostic message for |msg_id|'s counters:
+// - u16 0: |msg_id| in the top 6 bits, bus load in permille in the bottom 10
+// - u16 1: TX
+// - u16 2: RX
+// - u16 3: TX dropped, RX dropped and TX failed, saturating
+void can_stats_pack(CanStats *stats, CanMessageId msg_id, CanMessage *msg);
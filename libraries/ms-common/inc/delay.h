@@ -8,9 +8,20 @@
 // Max allowable time is UINT32_MAX in microseconds (4294.967295 seconds).
 // If a longer duration is needed, check the condition you are waiting on in a
 // loop and then call this function again if the condition is not met.
+//
+// Delays shorter than DELAY_SPIN_MAX_US busy-wait on a free-running counter,
+// since starting a soft timer and sleeping until it fires costs more than the
+// delay itself. Longer delays sleep until a soft timer expires.
 
 #include <stdint.h>
 
+#include "event_queue.h"
+
+#define DELAY_SPIN_MAX_US 1000
+
+// Called with each event processed during delay_sleep_us()
+typedef void (*DelayEventHandler)(const Event *e, void *context);
+
 // Delay for a period in microseconds.
 void delay_us(uint32_t t);
 
@@ -19,3 +30,12 @@ void delay_us(uint32_t t);
 
 // Delay for a period in seconds.
 #define delay_s(time) delay_us((time)*1000000)
+
+// Busy-waits for a period in microseconds without touching the soft timers.
+// Meant for short, accurate delays such as bus wake-up pulses.
+void delay_spin_us(uint32_t t);
+
+// Sleeps for a period in microseconds, passing any events raised in the
+// meantime to |handler| so the rest of the application keeps running. If
+// |handler| is NULL, events stay queued.
+void delay_sleep_us(uint32_t t, DelayEventHandler handler, void *context);
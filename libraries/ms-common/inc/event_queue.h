@@ -38,9 +38,17 @@ typedef struct Event {
   uint16_t data;
 } Event;
 
-// Initializes the event queue.
+// Called after an event is successfully raised. Used to wake up a consumer that blocks on the
+// queue, such as an RTOS task, instead of polling it. May be called from interrupt context.
+typedef void (*EventQueueRaiseCallback)(void *context);
+
+// Initializes the event queue. Clears the raise callback.
 void event_queue_init(void);
 
+// Sets the callback run after every raised event. Only one callback is supported - pass NULL to
+// clear it.
+void event_queue_set_raise_callback(EventQueueRaiseCallback callback, void *context);
+
 // Raises an event in the global event queue at the default priority.
 StatusCode event_raise_priority(EventPriority priority, EventId id, uint16_t data);
 
@@ -0,0 +1,46 @@
+#pragma once
+// Deferred GPIO interrupt handlers
+// Requires GPIO, GPIO interrupts, soft timers and the event queue to be initialized.
+//
+// Handlers registered here run from the main loop instead of the EXTI interrupt, so they can do
+// blocking I2C or SPI transfers without holding off every other interrupt. The interrupt only
+// latches the edge's timestamp and raises an event - call gpio_it_deferred_process_event(&e) in
+// the main loop to run the handler.
+//
+// Edges that arrive before the handler runs are coalesced into a single call, so the handler
+// should read the current state rather than count edges. The delay from the first edge to the
+// handler is bounded by the longest main loop iteration, and the worst seen is kept in the stats.
+// If the event queue is full, the edge stays pending and its event is raised again later.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event_queue.h"
+#include "gpio.h"
+#include "gpio_it.h"
+#include "interrupt_def.h"
+#include "status.h"
+
+// Deferred handlers preempt most ms-common and ms-helper events
+#define GPIO_IT_DEFERRED_EVENT_PRIORITY EVENT_PRIORITY_HIGH
+
+typedef struct GpioItDeferredStats {
+  // Edges latched, including the ones that were coalesced
+  uint32_t edges;
+  // Edges whose event was delayed because the event queue was full
+  uint32_t delayed;
+  // Times the handler ran
+  uint32_t runs;
+  // Longest time from an edge to the start of its handler
+  uint32_t max_latency_us;
+} GpioItDeferredStats;
+
+// Registers |callback| to run from the main loop after an edge on |address|. |event| is raised
+// with the pin as its data. Clears the pin's stats.
+StatusCode gpio_it_deferred_register(const GpioAddress *address,
+                                     const InterruptSettings *settings, InterruptEdge edge,
+                                     EventId event, GpioItCallback callback, void *context);
+
+// Runs the handler for a deferred edge. Returns whether the event was one.
+bool gpio_it_deferred_process_event(const Event *e);
+
+StatusCode gpio_it_deferred_get_stats(const GpioAddress *address, GpioItDeferredStats *stats);
@@ -46,3 +46,7 @@ bool soft_timer_inuse(void);
 // expired and is no longer in use, or if timer_id is invalid. Note that since timer ids are re-used
 // this could return false values once the timer has expired or if it is cancelled.
 uint32_t soft_timer_remaining_time(SoftTimerId timer_id);
+
+// Returns the free-running microsecond counter behind the soft timers. It wraps every ~71 minutes,
+// so compare timestamps by unsigned subtraction.
+uint32_t soft_timer_now_us(void);
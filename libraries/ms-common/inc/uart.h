@@ -1,35 +1,75 @@
 #pragma once
 // Non-blocking UART driver
-// Requires GPIO and interrupts to be initialized.
-
-// Uses internal FIFOs to buffer RX and TX.
+// Requires GPIO, interrupts, soft timers and the event queue to be initialized.
+//
+// TX is buffered in a FIFO. RX never does per-line work in interrupt context: the hardware writes
+// received bytes into a ring buffer, through circular DMA where the port has a channel, and the
+// interrupts only raise |rx_event| when a delimiter arrives, the line goes idle or the ring is half
+// full. Call uart_process_event(&e) in the main loop - it splits the new bytes into lines and runs
+// the RX handler on each one.
+//
+// Lines are handed out in place: one that's contiguous in the ring points straight into it, and
+// one that wraps around is copied into a line buffer first. Either way the line is only valid
+// during the handler and isn't null terminated. If the main loop falls a whole ring behind, the
+// partial line is dropped and counted as an overrun.
+#include <stdbool.h>
 #include <stdint.h>
+#include "event_queue.h"
 #include "fifo.h"
 #include "gpio.h"
 #include "status.h"
 #include "uart_mcu.h"
 
 #define UART_MAX_BUFFER_LEN 512
+// Twice the longest line, so the hardware can receive a whole line while the handler is still
+// reading the previous one in place. Must be a power of 2.
+#define UART_RX_RING_LEN (UART_MAX_BUFFER_LEN * 2)
 
 typedef void (*UartRxHandler)(const uint8_t *rx_arr, size_t len, void *context);
 
+typedef struct {
+  uint32_t rx_bytes;
+  uint32_t rx_lines;
+  // Lines lost or overwritten while being handled because the main loop fell behind
+  uint32_t rx_overruns;
+  // RX interrupts taken, counted in interrupt context
+  uint32_t rx_interrupts;
+  // Times the RX event couldn't be raised because the event queue was full
+  uint32_t rx_delayed;
+} UartStats;
+
 typedef struct {
   UartRxHandler rx_handler;
   void *context;
+  EventId rx_event;
 
   volatile Fifo tx_fifo;
   volatile uint8_t tx_buf[UART_MAX_BUFFER_LEN];
-  volatile Fifo rx_fifo;
-  volatile uint8_t rx_buf[UART_MAX_BUFFER_LEN];
 
-  uint8_t rx_line_buf[UART_MAX_BUFFER_LEN + 1];
+  // Written by the hardware. |rx_written| counts every byte received and wraps.
+  volatile uint8_t rx_ring[UART_RX_RING_LEN];
+  volatile uint32_t rx_written;
+  // An RX event is waiting for the main loop
+  volatile bool rx_pending;
+  // Pending, but the event couldn't be raised yet
+  volatile bool rx_unraised;
+  volatile bool rx_retry_scheduled;
+  UartPort rx_port;
+  // Main loop only: the next byte to check for the delimiter, and where the current line starts
+  uint32_t rx_read;
+  uint32_t rx_line_start;
+
+  uint8_t rx_line_buf[UART_MAX_BUFFER_LEN];
   char delimiter;
+  UartStats stats;
 } UartStorage;
 
 typedef struct {
   uint32_t baudrate;
   UartRxHandler rx_handler;
   void *context;
+  // Raised with the port as its data when there's RX data to process
+  EventId rx_event;
 
   GpioAddress tx;
   GpioAddress rx;
@@ -37,8 +77,9 @@ typedef struct {
 } UartSettings;
 
 // Assumes standard 8 N 1
-// Registers a handler to be called when a newline is encountered or the buffer
-// is full. Storage should be persistent through the program.
+// Registers a handler to be called from uart_process_event() when the delimiter is encountered or
+// a line fills the buffer. The line includes the delimiter. Storage should be persistent through
+// the program.
 StatusCode uart_init(UartPort uart, UartSettings *settings, UartStorage *storage);
 
 // Overrides any currently set handler
@@ -50,3 +91,9 @@ StatusCode uart_set_delimiter(UartPort uart, uint8_t delimiter);
 
 // Non-blocking TX
 StatusCode uart_tx(UartPort uart, uint8_t *tx_data, size_t len);
+
+// Runs the RX handler on every complete line received. Returns whether the event was an RX event.
+// Pass it every event, since it also re-raises RX events that found the event queue full.
+bool uart_process_event(const Event *e);
+
+StatusCode uart_get_stats(UartPort uart, UartStats *stats);
@@ -0,0 +1,17 @@
+#pragma once
+// UART RX ring buffer
+// Shared by the platform UART drivers. The hardware writes received bytes into a storage's ring
+// and calls uart_rx_notify() from interrupt context, then uart_process_event() calls
+// uart_rx_process() from the main loop to split them into lines.
+#include "uart.h"
+
+// Wakes the main loop to process |storage|'s ring, unless an event is already waiting. Only called
+// from interrupt context.
+void uart_rx_notify(UartStorage *storage, UartPort uart);
+
+// Raises the RX event again if the event queue was full when it was first raised. Called from
+// uart_process_event() for every port.
+void uart_rx_retry(UartStorage *storage);
+
+// Runs the RX handler on every complete line in the ring
+void uart_rx_process(UartStorage *storage);
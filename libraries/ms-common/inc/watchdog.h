@@ -1,16 +1,32 @@
 #pragma once
+// Software watchdogs that call back if they aren't kicked within their timeout.
+// Requires soft timers and interrupts to be initialized.
+//
+// Kicking only records the time, so it is cheap enough for every message on a hot path. A single
+// soft timer is set for the earliest deadline of all running watchdogs. When it fires, watchdogs
+// that have been kicked since are skipped and the timer is set again for the next deadline.
+//
+// Each watchdog also keeps the longest time it went between kicks, so timeouts can be tuned
+// against how close they actually came to expiring.
+#include <stdbool.h>
+#include <stdint.h>
 
 #include "soft_timer.h"
 #include "status.h"
 
+#define WATCHDOG_MAX_WATCHDOGS 16
+
 typedef uint32_t WatchdogTimeout;
 typedef void (*WatchdogExpiryCallback)(void *context);
 
 typedef struct WatchdogStorage {
-  SoftTimerId timer_id;
   WatchdogTimeout timeout_ms;
   WatchdogExpiryCallback callback;
   void *callback_context;
+  // From soft_timer_now_us()
+  volatile uint32_t last_kick_us;
+  volatile uint32_t max_kick_interval_us;
+  volatile bool running;
 } WatchdogStorage;
 
 typedef struct WatchdogSettings {
@@ -19,7 +35,18 @@ typedef struct WatchdogSettings {
   void *callback_context;
 } WatchdogSettings;
 
-void watchdog_start(WatchdogStorage *storage, WatchdogTimeout timeout_ms,
-                    WatchdogExpiryCallback callback, void *context);
+// Starts or restarts the watchdog. The storage must stay valid until the watchdog expires or is
+// stopped. Restarting clears the kick interval stats. At most WATCHDOG_MAX_WATCHDOGS can run at
+// once.
+StatusCode watchdog_start(WatchdogStorage *storage, WatchdogTimeout timeout_ms,
+                          WatchdogExpiryCallback callback, void *context);
 
+// Resets the watchdog's timeout. Kicking a watchdog that has expired starts it again.
 void watchdog_kick(WatchdogStorage *storage);
+
+// Stops the watchdog without calling back.
+void watchdog_stop(WatchdogStorage *storage);
+
+// Returns how close the watchdog has come to expiring since it was started, in microseconds: its
+// timeout minus the longest time between kicks. Returns 0 if it isn't running.
+uint32_t watchdog_get_min_slack_us(const WatchdogStorage *storage);
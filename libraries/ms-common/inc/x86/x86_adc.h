@@ -0,0 +1,20 @@
+#pragma once
+// x86-only extensions to the ADC
+#include <stdint.h>
+
+#include "adc.h"
+#include "status.h"
+
+typedef struct X86AdcStats {
+  // Conversion sequences - one per read in single mode, or one per scan in scan mode
+  uint32_t sequences;
+  // Channel conversions, i.e. the enabled channels in each sequence
+  uint32_t conversions;
+} X86AdcStats;
+
+// Counters since adc_init()
+void x86_adc_get_stats(X86AdcStats *stats);
+
+// Sets the raw reading a channel converts to from the next sequence on, until adc_init().
+// Channels read 2500 by default.
+StatusCode x86_adc_set_reading(AdcChannel adc_channel, uint16_t reading);
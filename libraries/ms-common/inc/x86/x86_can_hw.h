@@ -0,0 +1,30 @@
+#pragma once
+// x86-only extensions to CAN HW
+//
+// Frames go through the SocketCAN interface named by the MIDSUN_X86_CAN_DEVICE environment
+// variable, or vcan0 if it isn't set. TX is paced at the configured bitrate, and waiting frames go
+// out lowest ID first.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define X86_CAN_HW_DEVICE_VAR "MIDSUN_X86_CAN_DEVICE"
+
+typedef struct X86CanHwStats {
+  uint32_t tx_frames;
+  // Frames rejected because the TX queue was full
+  uint32_t tx_dropped;
+  uint32_t rx_frames;
+  // Frames lost because the RX handler didn't keep up
+  uint32_t rx_dropped;
+  // Frames the acceptance filters rejected
+  uint32_t rx_filtered;
+  // Time since can_hw_init()
+  uint32_t elapsed_us;
+} X86CanHwStats;
+
+// Counters since can_hw_init()
+void x86_can_hw_get_stats(X86CanHwStats *stats);
+
+// Frames per second at 100% bus load for frames with |dlc| data bytes
+uint32_t x86_can_hw_max_frame_rate(size_t dlc, bool extended);
@@ -0,0 +1,10 @@
+#pragma once
+// x86-only extensions to UART
+//
+// Each port is the master side of a pseudo-terminal. Open the device returned by
+// x86_uart_get_device() to talk to it, ex. with screen or from a test. The line is raw and the
+// baudrate is ignored.
+#include "uart_mcu.h"
+
+// Path of the port's pseudo-terminal, or NULL if it hasn't been initialized
+const char *x86_uart_get_device(UartPort uart);
@@ -11,5 +11,5 @@ ifeq (x86,$(PLATFORM))
 $(T)_EXCLUDE_TESTS := pwm pwm_input
 $(T)_CFLAGS += -DX86
 else 
-$(T)_EXCLUDE_TESTS := wait
+$(T)_EXCLUDE_TESTS := wait x86_adc x86_can_hw x86_critical_section x86_delay x86_uart
 endif
@@ -3,7 +3,7 @@
 // It hooks into the CAN HW callbacks:
 // - TX ready: Used to re-raise potentially discarded TX events. We assume that
 // if there are
-//             elements in the TX FIFO, we have a backlog that has resulted in
+//             elements in the TX queue, we have a backlog that has resulted in
 //             discarded events.
 // - Message RX: When the message RX callback runs, we just push the message
 // into a queue and
@@ -14,10 +14,18 @@
 // - Bus error: In case of a bus error, we set a timer and wait to see if the
 // bus has recovered
 //              after the timeout. If it's still down, we raise an event.
+//
+// The hardware filters are rebuilt whenever a handler is registered, so frames nothing here would
+// handle never raise an interrupt. The first time we wait on an ACK for a message ID, they're
+// rebuilt from the main loop when the message is about to go out, since can_transmit() can be
+// called from an interrupt.
 #include "can.h"
 #include <string.h>
+#include "can_filter.h"
 #include "can_fsm.h"
 #include "can_hw.h"
+#include "can_stats.h"
+#include "critical_section.h"
 #include "log.h"
 #include "soft_timer.h"
 
@@ -43,6 +51,10 @@ void prv_tx_handler(void *context);
 // to be processed.
 void prv_rx_handler(void *context);
 
+// Stats timer callback
+// Transmits the diagnostic message for the next message ID with traffic
+void prv_publish_stats(SoftTimerId timer_id, void *context);
+
 // Bus error timer callback
 // Checks if the bus has recovered, raising the fault event if still off
 void prv_bus_error_timeout_handler(SoftTimerId timer_id, void *context);
@@ -53,6 +65,60 @@ void prv_bus_error_handler(void *context);
 
 static CanStorage *s_can_storage;
 
+// Accepts data frames with a handler and ACKs we're waiting on, from any source. In loopback our
+// own frames all come back too, like they did before there were filters. A default handler wants
+// everything, and filters added with can_add_filter() are left alone.
+static StatusCode prv_update_filters(CanStorage *storage) {
+  // Transmitting from an interrupt can add ACK IDs at any time
+  bool disabled = critical_section_start();
+  uint64_t ack_filter_ids = storage->ack_filter_ids;
+  storage->ack_filters_stale = false;
+  critical_section_end(disabled);
+
+  if (storage->manual_filters) {
+    return STATUS_CODE_OK;
+  } else if (storage->rx_handlers.default_handler != NULL) {
+    return can_hw_set_filters(NULL, 0);
+  }
+
+  CanId mask = { .type = 1, .msg_id = CAN_MSG_MAX_IDS - 1 };
+  CanFilter patterns[CAN_NUM_RX_HANDLERS + CAN_MSG_MAX_IDS + 1];
+  size_t num_patterns = 0;
+  if (storage->loopback) {
+    CanId id = { .source_id = storage->device_id };
+    CanId source_mask = { .source_id = CAN_MSG_MAX_DEVICES - 1 };
+    patterns[num_patterns++] = (CanFilter){ .id = id.raw, .mask = source_mask.raw };
+  }
+  for (size_t i = 0; i < storage->rx_handlers.num_handlers; i++) {
+    CanId id = { .type = CAN_MSG_TYPE_DATA, .msg_id = storage->rx_handlers.storage[i].msg_id };
+    patterns[num_patterns++] = (CanFilter){ .id = id.raw, .mask = mask.raw };
+  }
+  for (CanMessageId msg_id = 0; msg_id < CAN_MSG_MAX_IDS; msg_id++) {
+    if (ack_filter_ids & ((uint64_t)1 << msg_id)) {
+      CanId id = { .type = CAN_MSG_TYPE_ACK, .msg_id = msg_id };
+      patterns[num_patterns++] = (CanFilter){ .id = id.raw, .mask = mask.raw };
+    }
+  }
+
+  CanFilterBank banks[CAN_FILTER_NUM_BANKS];
+  size_t num_banks = 0;
+  status_ok_or_return(
+      can_filter_build(patterns, num_patterns, banks, SIZEOF_ARRAY(banks), &num_banks));
+  return can_hw_set_filters(banks, num_banks);
+}
+
+// Filters that don't cover every ACK we're waiting on would drop them, so fall back to accepting
+// everything rather than failing the TX
+static void prv_update_ack_filters(CanStorage *storage) {
+  if (!storage->ack_filters_stale) {
+    return;
+  }
+  if (!status_ok(prv_update_filters(storage))) {
+    LOG_WARN("CAN: Failed to add ACK filters, accepting everything\n");
+    can_hw_set_filters(NULL, 0);
+  }
+}
+
 StatusCode can_init(CanStorage *storage, const CanSettings *settings) {
   if (settings->device_id >= CAN_MSG_MAX_DEVICES) {
     return status_msg(STATUS_CODE_INVALID_ARGS, "CAN: Invalid device ID");
@@ -63,13 +129,17 @@ StatusCode can_init(CanStorage *storage, const CanSettings *settings) {
   storage->tx_event = settings->tx_event;
   storage->fault_event = settings->fault_event;
   storage->device_id = settings->device_id;
+  storage->loopback = settings->loopback;
+
+  storage->stats_timer_id = SOFT_TIMER_INVALID_TIMER;
 
   s_can_storage = storage;
 
   status_ok_or_return(can_fsm_init(&s_can_storage->fsm, s_can_storage));
-  status_ok_or_return(can_fifo_init(&s_can_storage->tx_fifo));
+  status_ok_or_return(can_queue_init(&s_can_storage->tx_queue));
   status_ok_or_return(can_fifo_init(&s_can_storage->rx_fifo));
   status_ok_or_return(can_ack_init(&s_can_storage->ack_requests));
+  status_ok_or_return(can_stats_init(&s_can_storage->stats, settings->bitrate));
   status_ok_or_return(can_rx_init(&s_can_storage->rx_handlers, s_can_storage->rx_handler_storage,
                                   SIZEOF_ARRAY(s_can_storage->rx_handler_storage)));
 
@@ -99,7 +169,9 @@ StatusCode can_add_filter(CanMessageId msg_id) {
   CanId mask = { 0 };
   mask.msg_id = ~mask.msg_id;
 
-  return can_hw_add_filter(can_id.raw, mask.raw, false);
+  // Handlers registered from now on don't touch the filters
+  s_can_storage->manual_filters = true;
+  return can_hw_add_filter(mask.raw, can_id.raw, false);
 }
 
 StatusCode can_register_rx_default_handler(CanRxHandlerCb handler, void *context) {
@@ -107,7 +179,9 @@ StatusCode can_register_rx_default_handler(CanRxHandlerCb handler, void *context
     return status_code(STATUS_CODE_UNINITIALIZED);
   }
 
-  return can_rx_register_default_handler(&s_can_storage->rx_handlers, handler, context);
+  status_ok_or_return(
+      can_rx_register_default_handler(&s_can_storage->rx_handlers, handler, context));
+  return prv_update_filters(s_can_storage);
 }
 
 StatusCode can_register_rx_handler(CanMessageId msg_id, CanRxHandlerCb handler, void *context) {
@@ -115,7 +189,9 @@ StatusCode can_register_rx_handler(CanMessageId msg_id, CanRxHandlerCb handler,
     return status_code(STATUS_CODE_UNINITIALIZED);
   }
 
-  return can_rx_register_handler(&s_can_storage->rx_handlers, msg_id, handler, context);
+  status_ok_or_return(
+      can_rx_register_handler(&s_can_storage->rx_handlers, msg_id, handler, context));
+  return prv_update_filters(s_can_storage);
 }
 
 StatusCode can_transmit(const CanMessage *msg, const CanAckRequest *ack_request) {
@@ -132,6 +208,14 @@ StatusCode can_transmit(const CanMessage *msg, const CanAckRequest *ack_request)
 
     StatusCode ret = can_ack_add_request(&s_can_storage->ack_requests, msg->msg_id, ack_request);
     status_ok_or_return(ret);
+
+    uint64_t ack_bit = (uint64_t)1 << msg->msg_id;
+    bool disabled = critical_section_start();
+    if (!(s_can_storage->ack_filter_ids & ack_bit)) {
+      s_can_storage->ack_filter_ids |= ack_bit;
+      s_can_storage->ack_filters_stale = true;
+    }
+    critical_section_end(disabled);
   }
 
   // Basically, the idea is that all the TX and RX should be happening in the
@@ -139,7 +223,60 @@ StatusCode can_transmit(const CanMessage *msg, const CanAckRequest *ack_request)
   // postponed until the main event loop.
   event_raise(s_can_storage->tx_event, 1);
 
-  return can_fifo_push(&s_can_storage->tx_fifo, msg);
+  StatusCode ret = can_queue_push(&s_can_storage->tx_queue, msg);
+  if (ret != STATUS_CODE_OK) {
+    // We may be transmitting from an ISR that preempted a transmit from the main loop
+    bool disabled = critical_section_start();
+    can_stats_count(&s_can_storage->stats, msg->msg_id, CAN_STATS_COUNTER_TX_DROPPED);
+    critical_section_end(disabled);
+  }
+  return ret;
+}
+
+StatusCode can_get_stats(CanMessageId msg_id, CanStatsCounters *counters) {
+  if (s_can_storage == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  } else if (msg_id >= CAN_MSG_MAX_IDS || counters == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  *counters = s_can_storage->stats.ids[msg_id];
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_get_bus_load(uint16_t *load_permille) {
+  if (s_can_storage == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  } else if (load_permille == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  // The publish timer updates the window too
+  bool disabled = critical_section_start();
+  *load_permille = can_stats_get_bus_load(&s_can_storage->stats);
+  critical_section_end(disabled);
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_publish_stats(CanMessageId diag_msg_id, uint32_t period_ms) {
+  if (s_can_storage == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  } else if (diag_msg_id >= CAN_MSG_MAX_IDS) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "CAN: Invalid message ID");
+  }
+
+  if (s_can_storage->stats_timer_id != SOFT_TIMER_INVALID_TIMER) {
+    soft_timer_cancel(s_can_storage->stats_timer_id);
+    s_can_storage->stats_timer_id = SOFT_TIMER_INVALID_TIMER;
+  }
+
+  s_can_storage->stats_msg_id = diag_msg_id;
+  s_can_storage->stats_period_ms = period_ms;
+  if (period_ms == 0) {
+    return STATUS_CODE_OK;
+  }
+  return soft_timer_start_millis(period_ms, prv_publish_stats, s_can_storage,
+                                 &s_can_storage->stats_timer_id);
 }
 
 bool can_process_event(const Event *e) {
@@ -148,6 +285,9 @@ bool can_process_event(const Event *e) {
     return false;
   }
 
+  if (e->id == s_can_storage->tx_event) {
+    prv_update_ack_filters(s_can_storage);
+  }
   return fsm_process_event(&s_can_storage->fsm, e);
 }
 
@@ -160,7 +300,7 @@ void prv_tx_handler(void *context) {
     // If we failed to TX some messages or aren't transmitting fast enough, those
     // events were discarded. Raise a TX event to trigger a transmit attempt. We
     // only raise one event since TX ready interrupts are 1-to-1.
-    if (can_fifo_size(&can_storage->tx_fifo) > 0) {
+    if (can_queue_size(&can_storage->tx_queue) > 0) {
       event_raise(can_storage->tx_event, 0);
     }
   }
@@ -178,13 +318,20 @@ void prv_rx_handler(void *context) {
   while (can_hw_receive(&rx_id, &extended, &rx_msg.data, &rx_msg.dlc)) {
     if (extended) {
       // We don't handle extended messages in the network layer
+      can_stats_add_frame(&can_storage->stats, false, true, rx_msg.dlc);
       continue;
     }
     CAN_MSG_SET_RAW_ID(&rx_msg, rx_id);
+    can_stats_count(&can_storage->stats, rx_msg.msg_id, CAN_STATS_COUNTER_RX);
+    // In loopback we get our own frames back, and they've already been counted as TX
+    if (rx_msg.source_id != can_storage->device_id) {
+      can_stats_add_frame(&can_storage->stats, false, false, rx_msg.dlc);
+    }
 
     StatusCode result = can_fifo_push(&can_storage->rx_fifo, &rx_msg);
     // TODO(ELEC-251): add error handling for FSMs
     if (result != STATUS_CODE_OK) {
+      can_stats_count(&can_storage->stats, rx_msg.msg_id, CAN_STATS_COUNTER_RX_DROPPED);
       return;
     }
 
@@ -192,6 +339,39 @@ void prv_rx_handler(void *context) {
   }
 }
 
+// Next message ID after |msg_id| with any traffic, or |msg_id| if there's none
+static CanMessageId prv_next_stats_id(const CanStats *stats, CanMessageId msg_id) {
+  for (size_t i = 1; i <= CAN_MSG_MAX_IDS; i++) {
+    CanMessageId next_id = (CanMessageId)((msg_id + i) % CAN_MSG_MAX_IDS);
+    for (size_t counter = 0; counter < NUM_CAN_STATS_COUNTERS; counter++) {
+      if (stats->ids[next_id].counts[counter] != 0) {
+        return next_id;
+      }
+    }
+  }
+  return msg_id;
+}
+
+void prv_publish_stats(SoftTimerId timer_id, void *context) {
+  CanStorage *can_storage = context;
+  // A timer left over from before can_init()
+  if (timer_id != can_storage->stats_timer_id) {
+    return;
+  }
+
+  can_storage->stats_reported_id =
+      prv_next_stats_id(&can_storage->stats, can_storage->stats_reported_id);
+  CanMessage msg = {
+    .msg_id = can_storage->stats_msg_id,  //
+    .type = CAN_MSG_TYPE_DATA,            //
+  };
+  can_stats_pack(&can_storage->stats, can_storage->stats_reported_id, &msg);
+  can_transmit(&msg, NULL);
+
+  soft_timer_start_millis(can_storage->stats_period_ms, prv_publish_stats, can_storage,
+                          &can_storage->stats_timer_id);
+}
+
 void prv_bus_error_timeout_handler(SoftTimerId timer_id, void *context) {
   CanStorage *can_storage = context;
 
@@ -0,0 +1,210 @@
+#include "can_filter.h"
+#include <limits.h>
+
+#define CAN_FILTER_IDS_PER_LIST 4
+#define CAN_FILTER_PAIRS_PER_MASK 2
+
+static bool prv_is_exact(const CanFilter *pattern) {
+  return pattern->mask == CAN_FILTER_STANDARD_ID_MASK;
+}
+
+// Number of IDs a pattern accepts
+static int32_t prv_num_ids(const CanFilter *pattern) {
+  return 1 << __builtin_popcount(~pattern->mask & CAN_FILTER_STANDARD_ID_MASK);
+}
+
+// Whether |outer| accepts every ID |inner| does
+static bool prv_covers(const CanFilter *outer, const CanFilter *inner) {
+  return (outer->mask & ~inner->mask) == 0 && (inner->id & outer->mask) == outer->id;
+}
+
+// Smallest pattern that accepts both
+static CanFilter prv_merge(const CanFilter *a, const CanFilter *b) {
+  uint16_t mask = a->mask & b->mask & ~(a->id ^ b->id);
+  return (CanFilter){ .id = a->id & mask, .mask = mask };
+}
+
+// Drops patterns that another one already covers. Returns how many are left.
+static size_t prv_remove_covered(CanFilter *patterns, size_t num_patterns) {
+  size_t i = 0;
+  while (i < num_patterns) {
+    bool covered = false;
+    for (size_t j = 0; j < num_patterns && !covered; j++) {
+      covered = (j != i) && prv_covers(&patterns[j], &patterns[i]);
+    }
+
+    if (covered) {
+      patterns[i] = patterns[--num_patterns];
+    } else {
+      i++;
+    }
+  }
+
+  return num_patterns;
+}
+
+// Merges pairs with the same mask that differ in a single bit, which accepts nothing extra
+static size_t prv_merge_exact(CanFilter *patterns, size_t num_patterns) {
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < num_patterns && !merged; i++) {
+      for (size_t j = i + 1; j < num_patterns && !merged; j++) {
+        uint16_t diff = patterns[i].id ^ patterns[j].id;
+        if (patterns[i].mask == patterns[j].mask && (diff & (diff - 1)) == 0) {
+          patterns[i] = prv_merge(&patterns[i], &patterns[j]);
+          patterns[j] = patterns[--num_patterns];
+          num_patterns = prv_remove_covered(patterns, num_patterns);
+          merged = true;
+        }
+      }
+    }
+  }
+
+  return num_patterns;
+}
+
+// Merges the pair that adds the fewest unwanted IDs
+static size_t prv_merge_closest(CanFilter *patterns, size_t num_patterns) {
+  size_t best_i = 0;
+  size_t best_j = 1;
+  int32_t best_cost = INT32_MAX;
+  for (size_t i = 0; i < num_patterns; i++) {
+    for (size_t j = i + 1; j < num_patterns; j++) {
+      CanFilter merged = prv_merge(&patterns[i], &patterns[j]);
+      int32_t cost =
+          prv_num_ids(&merged) - prv_num_ids(&patterns[i]) - prv_num_ids(&patterns[j]);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_i = i;
+        best_j = j;
+      }
+    }
+  }
+
+  patterns[best_i] = prv_merge(&patterns[best_i], &patterns[best_j]);
+  patterns[best_j] = patterns[--num_patterns];
+  return prv_remove_covered(patterns, num_patterns);
+}
+
+// Exact IDs fill list banks four at a time and everything else fills mask banks two at a time,
+// but a leftover exact ID can take a spare mask slot. Returns the fewest banks the patterns fit
+// in, and how many exact IDs go in mask banks for that in |exact_in_mask|.
+static size_t prv_num_banks(const CanFilter *patterns, size_t num_patterns,
+                            size_t *exact_in_mask) {
+  size_t num_exact = 0;
+  for (size_t i = 0; i < num_patterns; i++) {
+    if (prv_is_exact(&patterns[i])) {
+      num_exact++;
+    }
+  }
+
+  size_t best = SIZE_MAX;
+  for (size_t in_mask = 0; in_mask <= num_exact; in_mask++) {
+    size_t in_list = num_exact - in_mask;
+    size_t num_masks = num_patterns - in_list;
+    size_t banks = (in_list + CAN_FILTER_IDS_PER_LIST - 1) / CAN_FILTER_IDS_PER_LIST +
+                   (num_masks + CAN_FILTER_PAIRS_PER_MASK - 1) / CAN_FILTER_PAIRS_PER_MASK;
+    if (banks < best) {
+      best = banks;
+      *exact_in_mask = in_mask;
+    }
+  }
+
+  return best;
+}
+
+static size_t prv_pack(const CanFilter *patterns, size_t num_patterns, size_t exact_in_mask,
+                       CanFilterBank *banks) {
+  size_t num_banks = 0;
+  size_t list_bank = 0;
+  size_t list_slot = CAN_FILTER_IDS_PER_LIST;
+  size_t mask_bank = 0;
+  size_t mask_slot = CAN_FILTER_PAIRS_PER_MASK;
+
+  for (size_t i = 0; i < num_patterns; i++) {
+    const CanFilter *pattern = &patterns[i];
+    bool exact = prv_is_exact(pattern);
+    if (exact && exact_in_mask == 0) {
+      if (list_slot == CAN_FILTER_IDS_PER_LIST) {
+        list_bank = num_banks++;
+        list_slot = 0;
+        banks[list_bank] = (CanFilterBank){
+          .mode = CAN_FILTER_BANK_MODE_LIST,
+          .ids = { pattern->id, pattern->id, pattern->id, pattern->id },
+        };
+      }
+      banks[list_bank].ids[list_slot++] = pattern->id;
+    } else {
+      if (exact) {
+        exact_in_mask--;
+      }
+      if (mask_slot == CAN_FILTER_PAIRS_PER_MASK) {
+        mask_bank = num_banks++;
+        mask_slot = 0;
+        banks[mask_bank] = (CanFilterBank){
+          .mode = CAN_FILTER_BANK_MODE_MASK,
+          .filters = { *pattern, *pattern },
+        };
+      }
+      banks[mask_bank].filters[mask_slot++] = *pattern;
+    }
+  }
+
+  return num_banks;
+}
+
+StatusCode can_filter_build(const CanFilter *patterns, size_t num_patterns, CanFilterBank *banks,
+                            size_t max_banks, size_t *num_banks) {
+  if ((patterns == NULL && num_patterns > 0) || banks == NULL || num_banks == NULL ||
+      num_patterns > CAN_FILTER_MAX_PATTERNS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  } else if (num_patterns > 0 && max_banks == 0) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "CAN filter: no banks");
+  }
+
+  CanFilter work[CAN_FILTER_MAX_PATTERNS];
+  for (size_t i = 0; i < num_patterns; i++) {
+    work[i].mask = patterns[i].mask & CAN_FILTER_STANDARD_ID_MASK;
+    work[i].id = patterns[i].id & work[i].mask;
+  }
+
+  size_t num_work = prv_remove_covered(work, num_patterns);
+  num_work = prv_merge_exact(work, num_work);
+
+  // A single pattern always fits, so this ends
+  size_t exact_in_mask = 0;
+  while (prv_num_banks(work, num_work, &exact_in_mask) > max_banks) {
+    num_work = prv_merge_closest(work, num_work);
+    num_work = prv_merge_exact(work, num_work);
+  }
+
+  *num_banks = prv_pack(work, num_work, exact_in_mask, banks);
+  return STATUS_CODE_OK;
+}
+
+bool can_filter_match(const CanFilterBank *banks, size_t num_banks, uint16_t id) {
+  if (num_banks == 0) {
+    return true;
+  }
+
+  id &= CAN_FILTER_STANDARD_ID_MASK;
+  for (size_t i = 0; i < num_banks; i++) {
+    if (banks[i].mode == CAN_FILTER_BANK_MODE_LIST) {
+      for (size_t slot = 0; slot < CAN_FILTER_IDS_PER_LIST; slot++) {
+        if (banks[i].ids[slot] == id) {
+          return true;
+        }
+      }
+    } else {
+      for (size_t slot = 0; slot < CAN_FILTER_PAIRS_PER_MASK; slot++) {
+        const CanFilter *filter = &banks[i].filters[slot];
+        if ((id & filter->mask) == (filter->id & filter->mask)) {
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
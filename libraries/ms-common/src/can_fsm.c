@@ -2,6 +2,8 @@
 #include "can.h"
 #include "can_hw.h"
 #include "can_rx.h"
+#include "can_stats.h"
+#include "critical_section.h"
 
 FSM_DECLARE_STATE(can_rx_fsm_handle);
 FSM_DECLARE_STATE(can_tx_fsm_handle);
@@ -79,9 +81,13 @@ static void prv_handle_tx(Fsm *fsm, const Event *e, void *context) {
   CanStorage *can_storage = context;
   CanMessage tx_msg = { 0 };
 
-  StatusCode result = can_fifo_peek(&can_storage->tx_fifo, &tx_msg);
+  // Timers can queue a more urgent message at any time, so the message popped has to be the one
+  // handed to the mailbox
+  bool disabled = critical_section_start();
+  StatusCode result = can_queue_peek(&can_storage->tx_queue, &tx_msg);
   if (result != STATUS_CODE_OK) {
     // Mismatch
+    critical_section_end(disabled);
     return;
   }
 
@@ -94,7 +100,15 @@ static void prv_handle_tx(Fsm *fsm, const Event *e, void *context) {
   // If added to mailbox, pop message from the TX queue
   StatusCode ret = can_hw_transmit(msg_id.raw, false, tx_msg.data_u8, tx_msg.dlc);
   if (ret == STATUS_CODE_OK) {
-    can_fifo_pop(&can_storage->tx_fifo, NULL);
+    can_queue_pop(&can_storage->tx_queue, NULL);
+  }
+  critical_section_end(disabled);
+
+  if (ret == STATUS_CODE_OK) {
+    can_stats_count(&can_storage->stats, tx_msg.msg_id, CAN_STATS_COUNTER_TX);
+    can_stats_add_frame(&can_storage->stats, true, false, tx_msg.dlc);
+  } else {
+    can_stats_count(&can_storage->stats, tx_msg.msg_id, CAN_STATS_COUNTER_TX_FAILED);
   }
 }
 
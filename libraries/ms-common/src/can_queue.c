@@ -0,0 +1,54 @@
+#include "can_queue.h"
+#include "critical_section.h"
+
+// Priorities are the arbitration ID above a sequence number
+#define CAN_QUEUE_SEQ_BITS 21
+#define CAN_QUEUE_SEQ_MASK ((1 << CAN_QUEUE_SEQ_BITS) - 1)
+
+StatusCode can_queue_init(CanQueue *can_queue) {
+  can_queue->seq = 0;
+  return pqueue_backed_init(&can_queue->pqueue, can_queue->queue_nodes, can_queue->msg_nodes);
+}
+
+StatusCode can_queue_push(CanQueue *can_queue, const CanMessage *msg) {
+  // Every message we send has our source ID, so only the rest of the ID decides arbitration
+  CanId id = {
+    .type = msg->type,      //
+    .msg_id = msg->msg_id,  //
+  };
+
+  bool disabled = critical_section_start();
+  // Start counting again whenever the queue drains. The count only wraps if it never does for
+  // millions of messages, and then only messages with the same ID could be reordered.
+  if (pqueue_backed_size(&can_queue->pqueue) == 0) {
+    can_queue->seq = 0;
+  }
+  uint32_t prio = (uint32_t)id.raw << CAN_QUEUE_SEQ_BITS | (can_queue->seq & CAN_QUEUE_SEQ_MASK);
+  StatusCode ret = pqueue_backed_push(&can_queue->pqueue, msg, prio);
+  if (ret == STATUS_CODE_OK) {
+    can_queue->seq++;
+  }
+  critical_section_end(disabled);
+
+  return ret;
+}
+
+StatusCode can_queue_pop(CanQueue *can_queue, CanMessage *msg) {
+  bool disabled = critical_section_start();
+  StatusCode ret = pqueue_backed_pop(&can_queue->pqueue, msg);
+  critical_section_end(disabled);
+
+  return ret;
+}
+
+StatusCode can_queue_peek(CanQueue *can_queue, CanMessage *msg) {
+  bool disabled = critical_section_start();
+  StatusCode ret = pqueue_backed_peek(&can_queue->pqueue, msg);
+  critical_section_end(disabled);
+
+  return ret;
+}
+
+size_t can_queue_size(CanQueue *can_queue) {
+  return pqueue_backed_size(&can_queue->pqueue);
+}
@@ -0,0 +1,79 @@
+#include "can_stats.h"
+#include <string.h>
+#include "soft_timer.h"
+
+#define CAN_STATS_LOAD_BITS 10
+#define CAN_STATS_MAX_LOAD_PERMILLE ((1 << CAN_STATS_LOAD_BITS) - 1)
+
+static const uint32_t s_bitrates[NUM_CAN_HW_BITRATES] = {
+  [CAN_HW_BITRATE_125KBPS] = 125000,
+  [CAN_HW_BITRATE_250KBPS] = 250000,
+  [CAN_HW_BITRATE_500KBPS] = 500000,
+  [CAN_HW_BITRATE_1000KBPS] = 1000000,
+};
+
+static uint32_t prv_total_bits(CanStats *stats) {
+  return stats->tx_bits + stats->rx_bits;
+}
+
+StatusCode can_stats_init(CanStats *stats, CanHwBitrate bitrate) {
+  if (stats == NULL || bitrate >= NUM_CAN_HW_BITRATES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  stats->bitrate = s_bitrates[bitrate];
+  stats->window_start_us = soft_timer_now_us();
+
+  return STATUS_CODE_OK;
+}
+
+void can_stats_count(CanStats *stats, CanMessageId msg_id, CanStatsCounter counter) {
+  if (msg_id < CAN_MSG_MAX_IDS && counter < NUM_CAN_STATS_COUNTERS) {
+    stats->ids[msg_id].counts[counter]++;
+  }
+}
+
+void can_stats_add_frame(CanStats *stats, bool tx, bool extended, size_t dlc) {
+  uint32_t bits = (extended ? CAN_STATS_EXTENDED_FRAME_BITS : CAN_STATS_STANDARD_FRAME_BITS) +
+                  8 * (uint32_t)dlc;
+  if (tx) {
+    stats->tx_bits += bits;
+  } else {
+    stats->rx_bits += bits;
+  }
+}
+
+uint16_t can_stats_get_bus_load(CanStats *stats) {
+  uint32_t now_us = soft_timer_now_us();
+  uint32_t window_us = now_us - stats->window_start_us;
+  if (window_us >= CAN_STATS_WINDOW_MS * 1000) {
+    // Totals wrap, so the difference is still right
+    uint32_t total_bits = prv_total_bits(stats);
+    uint64_t bits = total_bits - stats->window_start_bits;
+    uint64_t load = bits * 1000 * 1000000 / ((uint64_t)stats->bitrate * window_us);
+    stats->bus_load_permille = (uint16_t)(load > 1000 ? 1000 : load);
+    stats->window_start_us = now_us;
+    stats->window_start_bits = total_bits;
+  }
+
+  return stats->bus_load_permille;
+}
+
+void can_stats_pack(CanStats *stats, CanMessageId msg_id, CanMessage *msg) {
+  CanStatsCounters counters = { 0 };
+  if (msg_id < CAN_MSG_MAX_IDS) {
+    counters = stats->ids[msg_id];
+  }
+
+  uint32_t errors = (uint32_t)counters.counts[CAN_STATS_COUNTER_TX_DROPPED] +
+                    counters.counts[CAN_STATS_COUNTER_RX_DROPPED] +
+                    counters.counts[CAN_STATS_COUNTER_TX_FAILED];
+
+  msg->dlc = 8;
+  msg->data_u16[0] = (uint16_t)((msg_id & (CAN_MSG_MAX_IDS - 1)) << CAN_STATS_LOAD_BITS) |
+                     (can_stats_get_bus_load(stats) & CAN_STATS_MAX_LOAD_PERMILLE);
+  msg->data_u16[1] = counters.counts[CAN_STATS_COUNTER_TX];
+  msg->data_u16[2] = counters.counts[CAN_STATS_COUNTER_RX];
+  msg->data_u16[3] = (uint16_t)(errors > UINT16_MAX ? UINT16_MAX : errors);
+}
@@ -4,6 +4,7 @@
 #include <stddef.h>
 
 #include "soft_timer.h"
+#include "status.h"
 #include "wait.h"
 
 static void prv_delay_it(SoftTimerId timer_id, void *context) {
@@ -12,9 +13,27 @@ static void prv_delay_it(SoftTimerId timer_id, void *context) {
 }
 
 void delay_us(uint32_t t) {
+  if (t < DELAY_SPIN_MAX_US) {
+    delay_spin_us(t);
+    return;
+  }
+  delay_sleep_us(t, NULL, NULL);
+}
+
+void delay_sleep_us(uint32_t t, DelayEventHandler handler, void *context) {
   volatile bool block = true;
-  soft_timer_start(t, prv_delay_it, (void *)&block, NULL);
+  if (soft_timer_start(t, prv_delay_it, (void *)&block, NULL) != STATUS_CODE_OK) {
+    // Too short for a soft timer or out of timers - spinning still gets the delay right
+    delay_spin_us(t);
+    return;
+  }
+
+  Event e = { 0 };
   while (block) {
-    wait();
+    if (handler != NULL && event_process(&e) == STATUS_CODE_OK) {
+      handler(&e, context);
+    } else {
+      wait();
+    }
   }
 }
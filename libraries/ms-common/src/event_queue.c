@@ -13,11 +13,20 @@ typedef struct EventQueue {
 } EventQueue;
 
 static EventQueue s_queue;
+static EventQueueRaiseCallback s_raise_callback = NULL;
+static void *s_raise_context = NULL;
 
 void event_queue_init(void) {
   for (size_t i = 0; i < NUM_EVENT_PRIORITIES; i++) {
     fifo_init(&s_queue.fifos[i], s_queue.event_nodes[i]);
   }
+  s_raise_callback = NULL;
+  s_raise_context = NULL;
+}
+
+void event_queue_set_raise_callback(EventQueueRaiseCallback callback, void *context) {
+  s_raise_callback = callback;
+  s_raise_context = context;
 }
 
 StatusCode event_raise_priority(EventPriority priority, EventId id, uint16_t data) {
@@ -29,7 +38,12 @@ StatusCode event_raise_priority(EventPriority priority, EventId id, uint16_t dat
     .data = data,  //
   };
 
-  return fifo_push(&s_queue.fifos[priority], &e);
+  status_ok_or_return(fifo_push(&s_queue.fifos[priority], &e));
+
+  if (s_raise_callback != NULL) {
+    s_raise_callback(s_raise_context);
+  }
+  return STATUS_CODE_OK;
 }
 
 StatusCode event_process(Event *e) {
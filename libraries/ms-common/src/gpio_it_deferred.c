@@ -0,0 +1,134 @@
+#include "gpio_it_deferred.h"
+#include <string.h>
+#include "critical_section.h"
+#include "soft_timer.h"
+
+// How long to wait before raising an event again after the queue was full
+#define GPIO_IT_DEFERRED_RETRY_US 1000
+
+typedef struct GpioItDeferred {
+  GpioAddress address;
+  EventId event;
+  GpioItCallback callback;
+  void *context;
+  // Set by the interrupt and cleared by the main loop
+  volatile bool pending;
+  // Pending, but the event couldn't be raised yet
+  volatile bool unraised;
+  volatile bool retry_scheduled;
+  volatile uint32_t edge_us;
+  GpioItDeferredStats stats;
+} GpioItDeferred;
+
+static GpioItDeferred s_deferred[GPIO_PINS_PER_PORT];
+
+static void prv_retry_timeout(SoftTimerId timer_id, void *context);
+
+// Raises the event for a pending edge. If the queue is full, the edge stays pending and the raise
+// is retried from a soft timer and the next processed event - a level-triggered source like an
+// I/O expander holds its line until it's serviced, so there may never be another edge.
+static void prv_raise(GpioItDeferred *deferred) {
+  bool disabled = critical_section_start();
+  if (status_ok(event_raise_priority(GPIO_IT_DEFERRED_EVENT_PRIORITY, deferred->event,
+                                     deferred->address.pin))) {
+    deferred->unraised = false;
+  } else {
+    if (!deferred->unraised) {
+      deferred->stats.delayed++;
+    }
+    deferred->unraised = true;
+    if (!deferred->retry_scheduled &&
+        status_ok(soft_timer_start(GPIO_IT_DEFERRED_RETRY_US, prv_retry_timeout, deferred, NULL))) {
+      deferred->retry_scheduled = true;
+    }
+  }
+  critical_section_end(disabled);
+}
+
+static void prv_retry_timeout(SoftTimerId timer_id, void *context) {
+  GpioItDeferred *deferred = context;
+  deferred->retry_scheduled = false;
+  if (deferred->unraised) {
+    prv_raise(deferred);
+  }
+}
+
+// Runs in the interrupt, so it only latches the edge
+static void prv_latch(const GpioAddress *address, void *context) {
+  GpioItDeferred *deferred = context;
+  deferred->stats.edges++;
+  if (deferred->pending) {
+    return;
+  }
+
+  deferred->edge_us = soft_timer_now_us();
+  deferred->pending = true;
+  prv_raise(deferred);
+}
+
+StatusCode gpio_it_deferred_register(const GpioAddress *address,
+                                     const InterruptSettings *settings, InterruptEdge edge,
+                                     EventId event, GpioItCallback callback, void *context) {
+  if (address->port >= NUM_GPIO_PORTS || address->pin >= GPIO_PINS_PER_PORT ||
+      callback == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  // Keep the old entry in case the pin is still in use
+  GpioItDeferred *deferred = &s_deferred[address->pin];
+  GpioItDeferred prev = *deferred;
+  memset(deferred, 0, sizeof(*deferred));
+  deferred->address = *address;
+  deferred->event = event;
+  deferred->callback = callback;
+  deferred->context = context;
+
+  StatusCode status = gpio_it_register_interrupt(address, settings, edge, prv_latch, deferred);
+  if (!status_ok(status)) {
+    *deferred = prev;
+  }
+  return status;
+}
+
+bool gpio_it_deferred_process_event(const Event *e) {
+  for (size_t pin = 0; pin < GPIO_PINS_PER_PORT; pin++) {
+    if (s_deferred[pin].unraised) {
+      prv_raise(&s_deferred[pin]);
+    }
+  }
+
+  if (e->data >= GPIO_PINS_PER_PORT) {
+    return false;
+  }
+
+  GpioItDeferred *deferred = &s_deferred[e->data];
+  if (deferred->callback == NULL || deferred->event != e->id || !deferred->pending) {
+    return false;
+  }
+
+  // Cleared before the handler runs so an edge during it runs it again
+  bool disabled = critical_section_start();
+  uint32_t latency_us = soft_timer_now_us() - deferred->edge_us;
+  deferred->pending = false;
+  critical_section_end(disabled);
+
+  if (latency_us > deferred->stats.max_latency_us) {
+    deferred->stats.max_latency_us = latency_us;
+  }
+  deferred->stats.runs++;
+  deferred->callback(&deferred->address, deferred->context);
+
+  return true;
+}
+
+StatusCode gpio_it_deferred_get_stats(const GpioAddress *address, GpioItDeferredStats *stats) {
+  if (address->port >= NUM_GPIO_PORTS || address->pin >= GPIO_PINS_PER_PORT || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  bool disabled = critical_section_start();
+  *stats = s_deferred[address->pin].stats;
+  critical_section_end(disabled);
+
+  return STATUS_CODE_OK;
+}
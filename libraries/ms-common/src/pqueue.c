@@ -17,7 +17,7 @@ void pqueue_init(PQueue *queue, PQueueNode *nodes, size_t num_nodes) {
   critical_section_end(disabled);
 }
 
-StatusCode pqueue_push(PQueue *queue, void *data, uint16_t prio) {
+StatusCode pqueue_push(PQueue *queue, void *data, uint32_t prio) {
   bool disabled = critical_section_start();
 
   if (queue->size == queue->max_nodes) {
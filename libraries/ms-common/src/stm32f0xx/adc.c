@@ -2,8 +2,11 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
+#include "critical_section.h"
 #include "log.h"
+#include "soft_timer.h"
 #include "stm32f0xx.h"
 
 // TS_CAL addresses obtained from section 3.10.1 of the specific device
@@ -15,10 +18,23 @@
 // datasheet
 #define ADC_VREFINT_CAL 0x1FFFF7ba
 
+// DMA1 channel 1 is hardwired to the ADC's requests
+#define ADC_DMA_CHANNEL DMA1_Channel1
+#define ADC_DMA_IRQ DMA1_Channel1_IRQn
+#define ADC_DMA_IT_TC DMA1_IT_TC1
+
 typedef struct AdcStatus {
   uint32_t sequence;
+  AdcMode mode;
   bool continuous;
   volatile bool converting;
+  // Channels in the scan the DMA is transferring
+  uint32_t scan_channels;
+  volatile bool scanning;
+  // Vdda from the last sequence the reference was converted in
+  volatile bool vdda_valid;
+  volatile uint16_t vdda_mv;
+  volatile uint32_t vdda_timestamp_us;
 } AdcStatus;
 
 static AdcStatus s_adc_status;
@@ -33,6 +49,17 @@ typedef struct AdcInterrupt {
 
 static AdcInterrupt s_adc_interrupts[NUM_ADC_CHANNELS];
 
+// Scan results land here in channel order
+static uint16_t s_dma_buffer[NUM_ADC_CHANNELS];
+
+// The interrupt fills one snapshot while the other is the latest
+static AdcSnapshot s_snapshots[2];
+static volatile uint8_t s_latest_snapshot;
+static volatile bool s_snapshot_valid;
+
+static AdcSequenceCallback s_sequence_callback;
+static void *s_sequence_context;
+
 // Formula obtained from section 13.9 of the reference manual. Returns reading
 // in kelvin
 static uint16_t prv_get_temp(uint16_t reading) {
@@ -79,6 +106,96 @@ static GpioAddress prv_channel_to_gpio(uint8_t adc_channel) {
   return address;
 }
 
+// Converts a raw reading given Vdda, which the temperature sensor and reference don't need
+static StatusCode prv_convert(AdcChannel adc_channel, uint16_t raw, uint16_t vdda,
+                              uint16_t *reading) {
+  switch (adc_channel) {
+    case ADC_CHANNEL_TEMP:
+      *reading = prv_get_temp(raw);
+      return STATUS_CODE_OK;
+
+    case ADC_CHANNEL_REF:
+      *reading = prv_get_vdda(raw);
+      return STATUS_CODE_OK;
+
+    case ADC_CHANNEL_BAT:
+      raw *= 2;
+      break;
+
+    default:
+      break;
+  }
+
+  if (vdda == 0) {
+    return status_code(STATUS_CODE_EMPTY);
+  }
+  *reading = (raw * vdda) / 4095;
+  return STATUS_CODE_OK;
+}
+
+static void prv_run_channel_callback(AdcChannel channel) {
+  if (s_adc_interrupts[channel].callback != NULL) {
+    s_adc_interrupts[channel].callback(channel, s_adc_interrupts[channel].context);
+  } else if (s_adc_interrupts[channel].pin_callback != NULL) {
+    s_adc_interrupts[channel].pin_callback(prv_channel_to_gpio(channel),
+                                           s_adc_interrupts[channel].context);
+  }
+}
+
+// Publishes the readings of a finished sequence. Only called from the ADC and DMA interrupts.
+static void prv_finish_sequence(uint32_t channels) {
+  uint8_t next = !s_latest_snapshot;
+  AdcSnapshot *snapshot = &s_snapshots[next];
+  snapshot->channels = channels;
+  for (uint32_t remaining = channels; remaining != 0; remaining &= remaining - 1) {
+    AdcChannel channel = __builtin_ctz(remaining);
+    snapshot->raw[channel] = s_adc_interrupts[channel].reading;
+  }
+  snapshot->vdda_mv = 0;
+  snapshot->timestamp_us = soft_timer_now_us();
+
+  if (channels & ((uint32_t)1 << ADC_CHANNEL_REF)) {
+    snapshot->vdda_mv = prv_get_vdda(snapshot->raw[ADC_CHANNEL_REF]);
+    s_adc_status.vdda_mv = snapshot->vdda_mv;
+    s_adc_status.vdda_timestamp_us = snapshot->timestamp_us;
+    s_adc_status.vdda_valid = true;
+  }
+
+  s_latest_snapshot = next;
+  s_snapshot_valid = true;
+  if (s_sequence_callback != NULL) {
+    s_sequence_callback(snapshot, s_sequence_context);
+  }
+}
+
+// Moves a sequence's worth of readings from the ADC's data register into s_dma_buffer
+static void prv_init_dma(void) {
+  RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, true);
+  DMA_DeInit(ADC_DMA_CHANNEL);
+
+  DMA_InitTypeDef dma_settings = {
+    .DMA_PeripheralBaseAddr = (uint32_t)&ADC1->DR,
+    .DMA_MemoryBaseAddr = (uint32_t)s_dma_buffer,
+    .DMA_DIR = DMA_DIR_PeripheralSRC,
+    .DMA_BufferSize = NUM_ADC_CHANNELS,
+    .DMA_PeripheralInc = DMA_PeripheralInc_Disable,
+    .DMA_MemoryInc = DMA_MemoryInc_Enable,
+    .DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord,
+    .DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord,
+    .DMA_Mode = DMA_Mode_Circular,
+    .DMA_Priority = DMA_Priority_High,
+    .DMA_M2M = DMA_M2M_Disable,
+  };
+  DMA_Init(ADC_DMA_CHANNEL, &dma_settings);
+  DMA_ITConfig(ADC_DMA_CHANNEL, DMA_IT_TC, true);
+
+  // Nothing waits on scans, so their callbacks don't need to preempt anything
+  stm32f0xx_interrupt_nvic_enable(ADC_DMA_IRQ, INTERRUPT_PRIORITY_NORMAL);
+
+  ADC_DMARequestModeConfig(ADC1, ADC_DMAMode_Circular);
+  ADC_DMACmd(ADC1, true);
+}
+
 static StatusCode prv_check_channel_valid_and_enabled(AdcChannel adc_channel) {
   if (adc_channel >= NUM_ADC_CHANNELS) {
     return status_code(STATUS_CODE_INVALID_ARGS);
@@ -95,9 +212,10 @@ void adc_init(AdcMode adc_mode) {
   // Once the ADC has been reset, enable it with the given settings
   RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, true);
 
+  bool continuous = (adc_mode == ADC_MODE_CONTINUOUS);
   ADC_InitTypeDef adc_settings = {
     .ADC_Resolution = ADC_Resolution_12b,
-    .ADC_ContinuousConvMode = adc_mode,
+    .ADC_ContinuousConvMode = continuous,
     .ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_None,
     .ADC_ExternalTrigConv = ADC_ExternalTrigConv_T1_TRGO,
     .ADC_DataAlign = ADC_DataAlign_Right,
@@ -109,7 +227,7 @@ void adc_init(AdcMode adc_mode) {
   // Calculate the ADC calibration factor
   ADC_GetCalibrationFactor(ADC1);
 
-  ADC_ContinuousModeCmd(ADC1, adc_mode);
+  ADC_ContinuousModeCmd(ADC1, continuous);
   while (ADC_GetFlagStatus(ADC1, ADC_FLAG_ADCAL)) {
   }
 
@@ -119,19 +237,30 @@ void adc_init(AdcMode adc_mode) {
   }
 
   ADC_WaitModeCmd(ADC1, true);
-  ADC_AutoPowerOffCmd(ADC1, !adc_mode);
-
-  // Enable interrupts for the end of each conversion
-  stm32f0xx_interrupt_nvic_enable(ADC1_COMP_IRQn, INTERRUPT_PRIORITY_HIGH);
-  ADC_ITConfig(ADC1, ADC_IER_EOCIE, true);
-  ADC_ITConfig(ADC1, ADC_IER_EOSEQIE, true);
+  ADC_AutoPowerOffCmd(ADC1, !continuous);
 
   // Initialize static variables
-  s_adc_status.continuous = adc_mode;
+  s_adc_status.mode = adc_mode;
+  s_adc_status.continuous = continuous;
   s_adc_status.sequence = 0;
   s_adc_status.converting = false;
+  s_adc_status.scanning = false;
+  s_adc_status.vdda_valid = false;
+  s_snapshot_valid = false;
+  s_sequence_callback = NULL;
+  s_sequence_context = NULL;
+
+  if (adc_mode == ADC_MODE_SCAN) {
+    // Only the DMA transfer finishing interrupts
+    prv_init_dma();
+  } else {
+    // Enable interrupts for the end of each conversion
+    stm32f0xx_interrupt_nvic_enable(ADC1_COMP_IRQn, INTERRUPT_PRIORITY_HIGH);
+    ADC_ITConfig(ADC1, ADC_IER_EOCIE, true);
+    ADC_ITConfig(ADC1, ADC_IER_EOSEQIE, true);
+  }
 
-  if (adc_mode) {
+  if (continuous) {
     ADC_StartOfConversion(ADC1);
   }
 
@@ -149,6 +278,14 @@ StatusCode adc_set_channel(AdcChannel adc_channel, bool new_state) {
     return status_code(STATUS_CODE_INVALID_ARGS);
   }
 
+  // CHSELR can't be written while a scan converts, and the DMA interrupt assigns its readings by
+  // the channels it started with
+  bool disabled = critical_section_start();
+  if (s_adc_status.scanning) {
+    critical_section_end(disabled);
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+
   if (new_state) {
     ADC_ChannelConfig(ADC1, ((uint32_t)1 << adc_channel), ADC_SampleTime_239_5Cycles);
   } else {
@@ -163,6 +300,9 @@ StatusCode adc_set_channel(AdcChannel adc_channel, bool new_state) {
 
     case ADC_CHANNEL_REF:
       ADC_VrefintCmd(new_state);
+      if (!new_state) {
+        s_adc_status.vdda_valid = false;
+      }
       break;
 
     case ADC_CHANNEL_TEMP:
@@ -174,6 +314,7 @@ StatusCode adc_set_channel(AdcChannel adc_channel, bool new_state) {
   }
 
   s_adc_status.sequence = ADC1->CHSELR;
+  critical_section_end(disabled);
   return STATUS_CODE_OK;
 }
 
@@ -218,12 +359,14 @@ StatusCode adc_register_callback(AdcChannel adc_channel, AdcCallback callback, v
 StatusCode adc_read_raw(AdcChannel adc_channel, uint16_t *reading) {
   status_ok_or_return(prv_check_channel_valid_and_enabled(adc_channel));
 
-  if (!s_adc_status.continuous) {
+  // Scans are started separately, so this is just the latest
+  if (s_adc_status.mode == ADC_MODE_SINGLE) {
     // SOFT-347: We previously waited while |ADC_GetFlagStatus(ADC1, ADC_FLAG_EOSEQ)| was true.
     // But the EOSEQ flag is normally 0 and is set to 1 at the end of conversion, but reset by
     // |ADC1_COMP_IRQHandler| before the interrupt finishes. So this loop always sees it as 0. Thus
     // we weren't waiting at all and just returning the old s_adc_interrupts[adc_channel].reading.
-    // Fix: track whether we're converting with a volatile bool which is reset in the IRQHandler.
+    // Fix: track whether we're converting with a volatile bool which is reset in the IRQHandler
+    // once the whole sequence is done, so the reference read with it is fresh too.
     // The ADC interrupt has INTERRUPT_PRIORITY_HIGH so it can interrupt soft timer callbacks and
     // other INTERRUPT_PRIORITY_NORMAL interrupts, but if this is called from another interrupt with
     // INTERRUPT_PRIORITY_HIGH, the NVIC will queue the ADC interrupt until the calling interrupt
@@ -242,55 +385,135 @@ StatusCode adc_read_raw(AdcChannel adc_channel, uint16_t *reading) {
 StatusCode adc_read_converted(AdcChannel adc_channel, uint16_t *reading) {
   status_ok_or_return(prv_check_channel_valid_and_enabled(adc_channel));
   uint16_t adc_reading = 0;
-  adc_read_raw(adc_channel, &adc_reading);
+  status_ok_or_return(adc_read_raw(adc_channel, &adc_reading));
 
-  switch (adc_channel) {
-    case ADC_CHANNEL_TEMP:
-      *reading = prv_get_temp(adc_reading);
-      return STATUS_CODE_OK;
+  // The reference was converted in the same sequence, so there's no need to start another
+  uint16_t vdda = 0;
+  if (adc_channel != ADC_CHANNEL_TEMP && adc_channel != ADC_CHANNEL_REF) {
+    status_ok_or_return(adc_get_vdda(&vdda, NULL));
+  }
+  return prv_convert(adc_channel, adc_reading, vdda, reading);
+}
 
-    case ADC_CHANNEL_REF:
-      *reading = prv_get_vdda(adc_reading);
-      return STATUS_CODE_OK;
+StatusCode adc_get_vdda(uint16_t *vdda_mv, uint32_t *timestamp_us) {
+  if (vdda_mv == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
 
-    case ADC_CHANNEL_BAT:
-      adc_reading *= 2;
-      break;
+  // Keep the value and timestamp from the same sequence
+  bool disabled = critical_section_start();
+  bool valid = s_adc_status.vdda_valid;
+  *vdda_mv = s_adc_status.vdda_mv;
+  if (timestamp_us != NULL) {
+    *timestamp_us = s_adc_status.vdda_timestamp_us;
+  }
+  critical_section_end(disabled);
 
-    default:
-      break;
+  if (!valid) {
+    return status_code(STATUS_CODE_EMPTY);
   }
+  return STATUS_CODE_OK;
+}
 
-  uint16_t vdda;
-  adc_read_converted(ADC_CHANNEL_REF, &vdda);
-  *reading = (adc_reading * vdda) / 4095;
+void adc_register_sequence_callback(AdcSequenceCallback callback, void *context) {
+  bool disabled = critical_section_start();
+  s_sequence_callback = callback;
+  s_sequence_context = context;
+  critical_section_end(disabled);
+}
 
+StatusCode adc_scan_start(void) {
+  if (s_adc_status.mode != ADC_MODE_SCAN) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  // Channels can't change between being read here and the scan being marked as running
+  bool disabled = critical_section_start();
+  if (s_adc_status.scanning) {
+    critical_section_end(disabled);
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  uint32_t channels = ADC1->CHSELR;
+  if (channels == 0) {
+    critical_section_end(disabled);
+    return status_code(STATUS_CODE_EMPTY);
+  }
+  s_adc_status.scan_channels = channels;
+  s_adc_status.scanning = true;
+  critical_section_end(disabled);
+
+  // Channels may have changed since the last scan, so transfer exactly this many from the start
+  DMA_Cmd(ADC_DMA_CHANNEL, false);
+  DMA_SetCurrDataCounter(ADC_DMA_CHANNEL, (uint16_t)__builtin_popcount(channels));
+  DMA_Cmd(ADC_DMA_CHANNEL, true);
+  ADC_StartOfConversion(ADC1);
   return STATUS_CODE_OK;
 }
 
+StatusCode adc_get_snapshot(AdcSnapshot *snapshot) {
+  if (snapshot == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  // The interrupt could publish another while this copies
+  bool disabled = critical_section_start();
+  bool valid = s_snapshot_valid;
+  memcpy(snapshot, &s_snapshots[s_latest_snapshot], sizeof(*snapshot));
+  critical_section_end(disabled);
+
+  if (!valid) {
+    return status_code(STATUS_CODE_EMPTY);
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode adc_get_snapshot_converted(const AdcSnapshot *snapshot, AdcChannel adc_channel,
+                                      uint16_t *reading) {
+  if (snapshot == NULL || reading == NULL || adc_channel >= NUM_ADC_CHANNELS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  if (!(snapshot->channels & ((uint32_t)1 << adc_channel))) {
+    return status_code(STATUS_CODE_EMPTY);
+  }
+  return prv_convert(adc_channel, snapshot->raw[adc_channel], snapshot->vdda_mv, reading);
+}
+
 void ADC1_COMP_IRQHandler() {
   if (ADC_GetITStatus(ADC1, ADC_IT_EOC)) {
     uint16_t reading = ADC_GetConversionValue(ADC1);
     if (s_adc_status.sequence != 0) {
       AdcChannel current_channel = __builtin_ctz(s_adc_status.sequence);
-      if (s_adc_interrupts[current_channel].callback != NULL) {
-        s_adc_interrupts[current_channel].callback(current_channel,
-                                                   s_adc_interrupts[current_channel].context);
-      } else if (s_adc_interrupts[current_channel].pin_callback != NULL) {
-        s_adc_interrupts[current_channel].pin_callback(prv_channel_to_gpio(current_channel),
-                                                       s_adc_interrupts[current_channel].context);
-      }
+      prv_run_channel_callback(current_channel);
       s_adc_interrupts[current_channel].reading = reading;
       s_adc_status.sequence &= ~((uint32_t)1 << current_channel);
     }
   }
 
   if (ADC_GetITStatus(ADC1, ADC_IT_EOSEQ)) {
+    prv_finish_sequence(ADC1->CHSELR);
     s_adc_status.sequence = ADC1->CHSELR;
     ADC_ClearITPendingBit(ADC1, ADC_IT_EOSEQ);
+    s_adc_status.converting = false;
   }
+}
 
-  s_adc_status.converting = false;
+// Runs once per scan, when the DMA has transferred the whole sequence
+void DMA1_Channel1_IRQHandler(void) {
+  if (DMA_GetITStatus(ADC_DMA_IT_TC)) {
+    DMA_ClearITPendingBit(ADC_DMA_IT_TC);
+
+    // The sequence is converted in channel order
+    uint32_t channels = s_adc_status.scan_channels;
+    size_t index = 0;
+    for (uint32_t remaining = channels; remaining != 0; remaining &= remaining - 1) {
+      AdcChannel channel = __builtin_ctz(remaining);
+      s_adc_interrupts[channel].reading = s_dma_buffer[index++];
+      prv_run_channel_callback(channel);
+    }
+
+    prv_finish_sequence(channels);
+    s_adc_status.scanning = false;
+  }
 }
 
 // the following functions are wrappers over the legacy AdcChannel API dealing with GpioAddresses
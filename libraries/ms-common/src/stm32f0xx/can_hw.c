@@ -48,6 +48,53 @@ static void prv_add_filter(uint8_t filter_num, uint32_t mask, uint32_t filter) {
   CAN_FilterInit(&filter_cfg);
 }
 
+// 16-bit filter: STID[10:0] [RTR] [IDE] EXID[17:15]. The IDE bit is always in the mask, so
+// only standard frames match.
+static uint16_t prv_filter_16(uint16_t id) {
+  return (uint16_t)((id & CAN_FILTER_STANDARD_ID_MASK) << 5);
+}
+
+static uint16_t prv_mask_16(uint16_t mask) {
+  return (uint16_t)(((mask & CAN_FILTER_STANDARD_ID_MASK) << 5) | (1 << 3));
+}
+
+static void prv_set_bank(uint8_t filter_num, const CanFilterBank *bank) {
+  CAN_FilterInitTypeDef filter_cfg = {
+    .CAN_FilterNumber = filter_num,
+    .CAN_FilterScale = CAN_FilterScale_16bit,
+    .CAN_FilterFIFOAssignment = (filter_num % 2),
+    .CAN_FilterActivation = ENABLE,
+  };
+
+  // FR1 holds the low halves and FR2 the high halves
+  if (bank->mode == CAN_FILTER_BANK_MODE_LIST) {
+    filter_cfg.CAN_FilterMode = CAN_FilterMode_IdList;
+    filter_cfg.CAN_FilterIdLow = prv_filter_16(bank->ids[0]);
+    filter_cfg.CAN_FilterMaskIdLow = prv_filter_16(bank->ids[1]);
+    filter_cfg.CAN_FilterIdHigh = prv_filter_16(bank->ids[2]);
+    filter_cfg.CAN_FilterMaskIdHigh = prv_filter_16(bank->ids[3]);
+  } else {
+    filter_cfg.CAN_FilterMode = CAN_FilterMode_IdMask;
+    filter_cfg.CAN_FilterIdLow = prv_filter_16(bank->filters[0].id);
+    filter_cfg.CAN_FilterMaskIdLow = prv_mask_16(bank->filters[0].mask);
+    filter_cfg.CAN_FilterIdHigh = prv_filter_16(bank->filters[1].id);
+    filter_cfg.CAN_FilterMaskIdHigh = prv_mask_16(bank->filters[1].mask);
+  }
+
+  CAN_FilterInit(&filter_cfg);
+}
+
+static void prv_disable_bank(uint8_t filter_num) {
+  CAN_FilterInitTypeDef filter_cfg = {
+    .CAN_FilterNumber = filter_num,
+    .CAN_FilterMode = CAN_FilterMode_IdMask,
+    .CAN_FilterScale = CAN_FilterScale_32bit,
+    .CAN_FilterActivation = DISABLE,
+  };
+
+  CAN_FilterInit(&filter_cfg);
+}
+
 StatusCode can_hw_init(const CanHwSettings *settings) {
   memset(s_handlers, 0, sizeof(s_handlers));
   s_num_filters = 0;
@@ -120,6 +167,28 @@ StatusCode can_hw_add_filter(uint32_t mask, uint32_t filter, bool extended) {
   return STATUS_CODE_OK;
 }
 
+StatusCode can_hw_set_filters(const CanFilterBank *banks, size_t num_banks) {
+  if (num_banks > CAN_HW_NUM_FILTER_BANKS || (banks == NULL && num_banks > 0)) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "CAN HW: Too many filter banks.");
+  }
+
+  // Each bank is rewritten in filter init mode, so a frame arriving while they change can see a mix
+  // of old and new banks. Filters only grow while running, so that's rare.
+  if (num_banks == 0) {
+    prv_add_filter(0, 0, 0);
+  }
+  for (size_t i = 0; i < num_banks; i++) {
+    prv_set_bank((uint8_t)i, &banks[i]);
+  }
+  for (size_t i = (num_banks == 0) ? 1 : num_banks; i < CAN_HW_NUM_FILTER_BANKS; i++) {
+    prv_disable_bank((uint8_t)i);
+  }
+
+  // Like can_hw_init(), accepting everything leaves room for can_hw_add_filter()
+  s_num_filters = (uint8_t)num_banks;
+  return STATUS_CODE_OK;
+}
+
 CanHwBusStatus can_hw_bus_status(void) {
   if (CAN_GetFlagStatus(CAN_HW_BASE, CAN_FLAG_BOF) == SET) {
     return CAN_HW_BUS_STATUS_OFF;
@@ -0,0 +1,11 @@
+#include "delay.h"
+
+#include "stm32f0xx.h"
+
+// The Cortex-M0 has no cycle counter and SysTick belongs to the RTOS, so this spins on TIM2, the
+// free-running 1MHz counter behind the soft timers. Unsigned subtraction handles rollover.
+void delay_spin_us(uint32_t t) {
+  const uint32_t start = TIM_GetCounter(TIM2);
+  while (TIM_GetCounter(TIM2) - start < t) {
+  }
+}
@@ -7,6 +7,7 @@
 #include "soft_timer.h"
 #include <string.h>
 #include "critical_section.h"
+#include "log.h"
 #include "misc.h"
 #include "objpool.h"
 #include "stm32f0xx.h"
@@ -49,6 +50,11 @@ void soft_timer_init(void) {
   objpool_init(&s_timers.pool, s_storage, NULL, NULL);
 
   prv_init_periph();
+
+#ifdef LOG_TOKENIZED
+  // Timestamp log records from here on
+  log_tokenized_set_clock(soft_timer_now_us);
+#endif
 }
 
 // Seems to take around 5us to start a timer
@@ -254,3 +260,7 @@ void TIM2_IRQHandler(void) {
     TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
   }
 }
+
+uint32_t soft_timer_now_us(void) {
+  return TIM_GetCounter(TIM2);
+}
@@ -1,24 +1,30 @@
-// The basic idea is that we have two FIFOs, one for TX and one for TX.
+// The basic idea is that TX goes through a FIFO and RX goes into a ring buffer.
 // When a transmit is requested, we copy the data into the TX FIFO and use the
 // TXE interrupt to clock the data out. Note that we only enable the interrupt
 // when a transfer is currently in progress, as otherwise it seems to
-// continuously trigger. When we receive data through the RX interrupt, we copy
-// it into a buffer until we encounter a newline or the buffer is full. Once
-// that occurs, we pop the data into another buffer and call the registered RX
-// handler.
+// continuously trigger. Received data is written into the ring by circular DMA,
+// so there's no interrupt per byte. The character match interrupt fires on the
+// delimiter, the idle line interrupt at the end of a burst and the DMA's half
+// and full transfer interrupts on long ones. Each of them only counts what the
+// DMA has written and raises the RX event - the lines are split and handled in
+// the main loop by uart_process_event().
 #include "uart.h"
 #include <string.h>
 #include "critical_section.h"
 #include "stm32f0xx.h"
-
-// basic idea: tx is stored in a buffer, interrupt-driven
-// rx is buffered, once a newline is hit or the buffer is full, call rx_handler
+#include "uart_rx.h"
 
 typedef struct {
   void (*rcc_cmd)(uint32_t periph, FunctionalState state);
   uint32_t periph;
   uint32_t irq;
   USART_TypeDef *base;
+  // RX DMA channel and its interrupt flags, or NULL to take an RXNE interrupt per byte
+  DMA_Channel_TypeDef *dma_channel;
+  uint32_t dma_irq;
+  uint32_t dma_it_ht;
+  uint32_t dma_it_tc;
+  uint32_t dma_it_gl;
   UartStorage *storage;
 } UartPortData;
 
@@ -26,15 +32,31 @@ static UartPortData s_port[] = {
   [UART_PORT_1] = { .rcc_cmd = RCC_APB2PeriphClockCmd,
                     .periph = RCC_APB2Periph_USART1,
                     .irq = USART1_IRQn,
-                    .base = USART1 },
+                    .base = USART1,
+                    .dma_channel = DMA1_Channel3,
+                    .dma_irq = DMA1_Channel2_3_IRQn,
+                    .dma_it_ht = DMA1_IT_HT3,
+                    .dma_it_tc = DMA1_IT_TC3,
+                    .dma_it_gl = DMA1_IT_GL3 },
   [UART_PORT_2] = { .rcc_cmd = RCC_APB1PeriphClockCmd,
                     .periph = RCC_APB1Periph_USART2,
                     .irq = USART2_IRQn,
-                    .base = USART2 },
+                    .base = USART2,
+                    .dma_channel = DMA1_Channel5,
+                    .dma_irq = DMA1_Channel4_5_6_7_IRQn,
+                    .dma_it_ht = DMA1_IT_HT5,
+                    .dma_it_tc = DMA1_IT_TC5,
+                    .dma_it_gl = DMA1_IT_GL5 },
   [UART_PORT_3] = { .rcc_cmd = RCC_APB1PeriphClockCmd,
                     .periph = RCC_APB1Periph_USART3,
                     .irq = USART3_4_IRQn,
-                    .base = USART3 },
+                    .base = USART3,
+                    .dma_channel = DMA1_Channel6,
+                    .dma_irq = DMA1_Channel4_5_6_7_IRQn,
+                    .dma_it_ht = DMA1_IT_HT6,
+                    .dma_it_tc = DMA1_IT_TC6,
+                    .dma_it_gl = DMA1_IT_GL6 },
+  // No spare RX DMA channel
   [UART_PORT_4] = { .rcc_cmd = RCC_APB1PeriphClockCmd,
                     .periph = RCC_APB1Periph_USART4,
                     .irq = USART3_4_IRQn,
@@ -46,7 +68,39 @@ static void prv_rx_push(UartPort uart);
 
 static void prv_handle_irq(UartPort uart);
 
+// Writes received bytes into the ring, wrapping around at the end
+static void prv_init_dma(UartPort uart) {
+  RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+  DMA_DeInit(s_port[uart].dma_channel);
+
+  DMA_InitTypeDef dma_settings = {
+    .DMA_PeripheralBaseAddr = (uint32_t)&s_port[uart].base->RDR,
+    .DMA_MemoryBaseAddr = (uint32_t)s_port[uart].storage->rx_ring,
+    .DMA_DIR = DMA_DIR_PeripheralSRC,
+    .DMA_BufferSize = UART_RX_RING_LEN,
+    .DMA_PeripheralInc = DMA_PeripheralInc_Disable,
+    .DMA_MemoryInc = DMA_MemoryInc_Enable,
+    .DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte,
+    .DMA_MemoryDataSize = DMA_MemoryDataSize_Byte,
+    .DMA_Mode = DMA_Mode_Circular,
+    .DMA_Priority = DMA_Priority_Medium,
+    .DMA_M2M = DMA_M2M_Disable,
+  };
+  DMA_Init(s_port[uart].dma_channel, &dma_settings);
+  DMA_ITConfig(s_port[uart].dma_channel, DMA_IT_HT | DMA_IT_TC, ENABLE);
+  stm32f0xx_interrupt_nvic_enable(s_port[uart].dma_irq, INTERRUPT_PRIORITY_NORMAL);
+
+  USART_DMACmd(s_port[uart].base, USART_DMAReq_Rx, ENABLE);
+  DMA_Cmd(s_port[uart].dma_channel, ENABLE);
+}
+
 StatusCode uart_init(UartPort uart, UartSettings *settings, UartStorage *storage) {
+#ifdef LOG_DEFERRED
+  // Retarget drains deferred logs from USART1's interrupt
+  if (s_port[uart].base == USART1) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "USART1 is used for deferred logging");
+  }
+#endif
   s_port[uart].rcc_cmd(s_port[uart].periph, ENABLE);
 
   s_port[uart].storage = storage;
@@ -54,9 +108,9 @@ StatusCode uart_init(UartPort uart, UartSettings *settings, UartStorage *storage
 
   s_port[uart].storage->rx_handler = settings->rx_handler;
   s_port[uart].storage->context = settings->context;
+  s_port[uart].storage->rx_event = settings->rx_event;
   s_port[uart].storage->delimiter = '\n';
   fifo_init(&s_port[uart].storage->tx_fifo, s_port[uart].storage->tx_buf);
-  fifo_init(&s_port[uart].storage->rx_fifo, s_port[uart].storage->rx_buf);
 
   GpioSettings gpio_settings = {
     .alt_function = settings->alt_fn,  //
@@ -71,9 +125,19 @@ StatusCode uart_init(UartPort uart, UartSettings *settings, UartStorage *storage
   usart_init.USART_BaudRate = settings->baudrate;
   USART_Init(s_port[uart].base, &usart_init);
 
+  // The match character can only be set while the USART is disabled
+  USART_AddressDetectionConfig(s_port[uart].base, USART_AddressLength_7b);
+  USART_SetAddress(s_port[uart].base, (uint8_t)s_port[uart].storage->delimiter);
+
   USART_ClearITPendingBit(s_port[uart].base, USART_FLAG_TXE);
   USART_ITConfig(s_port[uart].base, USART_IT_TXE, DISABLE);
-  USART_ITConfig(s_port[uart].base, USART_IT_RXNE, ENABLE);
+  USART_ITConfig(s_port[uart].base, USART_IT_CM, ENABLE);
+  USART_ITConfig(s_port[uart].base, USART_IT_IDLE, ENABLE);
+  if (s_port[uart].dma_channel != NULL) {
+    prv_init_dma(uart);
+  } else {
+    USART_ITConfig(s_port[uart].base, USART_IT_RXNE, ENABLE);
+  }
 
   stm32f0xx_interrupt_nvic_enable(s_port[uart].irq, INTERRUPT_PRIORITY_NORMAL);
 
@@ -94,6 +158,10 @@ StatusCode uart_set_rx_handler(UartPort uart, UartRxHandler rx_handler, void *co
 StatusCode uart_set_delimiter(UartPort uart, uint8_t delimiter) {
   s_port[uart].storage->delimiter = delimiter;
 
+  USART_Cmd(s_port[uart].base, DISABLE);
+  USART_SetAddress(s_port[uart].base, delimiter);
+  USART_Cmd(s_port[uart].base, ENABLE);
+
   return STATUS_CODE_OK;
 }
 
@@ -108,6 +176,34 @@ StatusCode uart_tx(UartPort uart, uint8_t *tx_data, size_t len) {
   return STATUS_CODE_OK;
 }
 
+bool uart_process_event(const Event *e) {
+  for (UartPort uart = 0; uart < NUM_UART_PORTS; uart++) {
+    if (s_port[uart].storage != NULL) {
+      uart_rx_retry(s_port[uart].storage);
+    }
+  }
+
+  if (e->data >= NUM_UART_PORTS || s_port[e->data].storage == NULL ||
+      s_port[e->data].storage->rx_event != e->id) {
+    return false;
+  }
+
+  uart_rx_process(s_port[e->data].storage);
+  return true;
+}
+
+StatusCode uart_get_stats(UartPort uart, UartStats *stats) {
+  if (uart >= NUM_UART_PORTS || s_port[uart].storage == NULL || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  bool disabled = critical_section_start();
+  *stats = s_port[uart].storage->stats;
+  critical_section_end(disabled);
+
+  return STATUS_CODE_OK;
+}
+
 static void prv_tx_pop(UartPort uart) {
   if (fifo_size(&s_port[uart].storage->tx_fifo) == 0) {
     USART_ITConfig(s_port[uart].base, USART_IT_TXE, DISABLE);
@@ -120,24 +216,32 @@ static void prv_tx_pop(UartPort uart) {
   USART_SendData(s_port[uart].base, tx_data);
 }
 
+// Only for ports without DMA - stores the byte without looking at it
 static void prv_rx_push(UartPort uart) {
   UartStorage *storage = s_port[uart].storage;
 
   uint8_t rx_data = USART_ReceiveData(s_port[uart].base);
-  fifo_push(&storage->rx_fifo, &rx_data);
-
-  size_t num_bytes = fifo_size(&storage->rx_fifo);
-  if (rx_data == storage->delimiter || num_bytes == UART_MAX_BUFFER_LEN) {
-    storage->rx_line_buf[num_bytes] = '\0';
-    fifo_pop_arr(&storage->rx_fifo, storage->rx_line_buf, num_bytes);
+  storage->rx_ring[storage->rx_written & (UART_RX_RING_LEN - 1)] = rx_data;
+  storage->rx_written++;
+}
 
-    if (storage->rx_handler != NULL) {
-      storage->rx_handler(storage->rx_line_buf, num_bytes, storage->context);
-    }
+// Counts what the DMA has written since the last interrupt. The half and full transfer interrupts
+// make sure it never gets a whole ring ahead.
+static void prv_rx_update(UartPort uart) {
+  UartStorage *storage = s_port[uart].storage;
+  if (s_port[uart].dma_channel != NULL) {
+    uint32_t pos = UART_RX_RING_LEN - DMA_GetCurrDataCounter(s_port[uart].dma_channel);
+    storage->rx_written += (pos - storage->rx_written) & (UART_RX_RING_LEN - 1);
   }
+
+  uart_rx_notify(storage, uart);
 }
 
 static void prv_handle_irq(UartPort uart) {
+  if (s_port[uart].storage == NULL) {
+    return;
+  }
+
   if (USART_GetITStatus(s_port[uart].base, USART_IT_TXE) == SET) {
     prv_tx_pop(uart);
     USART_ClearITPendingBit(s_port[uart].base, USART_IT_TXE);
@@ -147,13 +251,34 @@ static void prv_handle_irq(UartPort uart) {
     prv_rx_push(uart);
   }
 
+  bool matched = USART_GetITStatus(s_port[uart].base, USART_IT_CM) == SET;
+  bool idle = USART_GetITStatus(s_port[uart].base, USART_IT_IDLE) == SET;
+  if (matched || idle) {
+    USART_ClearITPendingBit(s_port[uart].base, USART_IT_CM);
+    USART_ClearITPendingBit(s_port[uart].base, USART_IT_IDLE);
+    prv_rx_update(uart);
+  }
+
   // Clear overrun flag
   USART_ClearITPendingBit(s_port[uart].base, USART_IT_ORE);
 }
 
+static void prv_handle_dma_irq(UartPort uart) {
+  if (s_port[uart].storage == NULL || s_port[uart].dma_channel == NULL) {
+    return;
+  }
+
+  if (DMA_GetITStatus(s_port[uart].dma_it_ht) || DMA_GetITStatus(s_port[uart].dma_it_tc)) {
+    DMA_ClearITPendingBit(s_port[uart].dma_it_gl);
+    prv_rx_update(uart);
+  }
+}
+
+#ifndef LOG_DEFERRED
 void USART1_IRQHandler(void) {
   prv_handle_irq(UART_PORT_1);
 }
+#endif
 
 void USART2_IRQHandler(void) {
   prv_handle_irq(UART_PORT_2);
@@ -163,3 +288,12 @@ void USART3_4_IRQHandler(void) {
   prv_handle_irq(UART_PORT_3);
   prv_handle_irq(UART_PORT_4);
 }
+
+void DMA1_Channel2_3_IRQHandler(void) {
+  prv_handle_dma_irq(UART_PORT_1);
+}
+
+void DMA1_Channel4_5_6_7_IRQHandler(void) {
+  prv_handle_dma_irq(UART_PORT_2);
+  prv_handle_dma_irq(UART_PORT_3);
+}
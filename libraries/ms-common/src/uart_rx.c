@@ -0,0 +1,118 @@
+#include "uart_rx.h"
+#include <assert.h>
+#include <string.h>
+#include "critical_section.h"
+#include "soft_timer.h"
+
+#define UART_RX_RING_MASK (UART_RX_RING_LEN - 1)
+// How long to wait before raising an RX event again after the queue was full
+#define UART_RX_RETRY_US 1000
+
+static_assert((UART_RX_RING_LEN & UART_RX_RING_MASK) == 0, "UART RX ring must be a power of 2");
+
+static void prv_retry_timeout(SoftTimerId timer_id, void *context);
+
+// Raises the RX event. If the queue is full, it stays pending and the raise is retried from a soft
+// timer and the next uart_process_event() - the line may have been the last one for a while, so
+// there may never be another interrupt.
+static void prv_raise(UartStorage *storage) {
+  bool disabled = critical_section_start();
+  if (status_ok(event_raise(storage->rx_event, storage->rx_port))) {
+    storage->rx_unraised = false;
+  } else {
+    if (!storage->rx_unraised) {
+      storage->stats.rx_delayed++;
+    }
+    storage->rx_unraised = true;
+    if (!storage->rx_retry_scheduled &&
+        status_ok(soft_timer_start(UART_RX_RETRY_US, prv_retry_timeout, storage, NULL))) {
+      storage->rx_retry_scheduled = true;
+    }
+  }
+  critical_section_end(disabled);
+}
+
+static void prv_retry_timeout(SoftTimerId timer_id, void *context) {
+  UartStorage *storage = context;
+  storage->rx_retry_scheduled = false;
+  if (storage->rx_unraised) {
+    prv_raise(storage);
+  }
+}
+
+void uart_rx_notify(UartStorage *storage, UartPort uart) {
+  storage->stats.rx_interrupts++;
+  if (!storage->rx_pending) {
+    storage->rx_pending = true;
+    storage->rx_port = uart;
+    prv_raise(storage);
+  }
+}
+
+void uart_rx_retry(UartStorage *storage) {
+  if (storage->rx_unraised) {
+    prv_raise(storage);
+  }
+}
+
+// Hands the line in place if it doesn't wrap around the ring
+static void prv_deliver(UartStorage *storage, uint32_t start, size_t len) {
+  storage->stats.rx_lines++;
+  if (storage->rx_handler == NULL) {
+    return;
+  }
+
+  size_t offset = start & UART_RX_RING_MASK;
+  const uint8_t *line = (const uint8_t *)&storage->rx_ring[offset];
+  if (offset + len > UART_RX_RING_LEN) {
+    size_t first = UART_RX_RING_LEN - offset;
+    memcpy(storage->rx_line_buf, line, first);
+    memcpy(storage->rx_line_buf + first, (const uint8_t *)storage->rx_ring, len - first);
+    line = storage->rx_line_buf;
+  }
+
+  storage->rx_handler(line, len, storage->context);
+}
+
+// Whether the hardware has written over the start of the line at |start|
+static bool prv_lapped(uint32_t start, uint32_t written) {
+  return written - start > UART_RX_RING_LEN;
+}
+
+// Drops everything up to |written|, which has already been counted
+static void prv_overrun(UartStorage *storage, uint32_t written) {
+  storage->stats.rx_overruns++;
+  storage->rx_read = written;
+  storage->rx_line_start = written;
+}
+
+void uart_rx_process(UartStorage *storage) {
+  // Cleared first so anything arriving from here on raises another event
+  storage->rx_pending = false;
+  uint32_t written = storage->rx_written;
+  storage->stats.rx_bytes += written - storage->rx_read;
+
+  if (prv_lapped(storage->rx_line_start, written)) {
+    // The hardware lapped the current line
+    prv_overrun(storage, written);
+    return;
+  }
+
+  for (; storage->rx_read != written; storage->rx_read++) {
+    uint8_t rx_data = storage->rx_ring[storage->rx_read & UART_RX_RING_MASK];
+    uint32_t start = storage->rx_line_start;
+    size_t len = storage->rx_read - start + 1;
+    if (rx_data == (uint8_t)storage->delimiter || len == UART_MAX_BUFFER_LEN) {
+      prv_deliver(storage, start, len);
+      storage->rx_line_start = storage->rx_read + 1;
+
+      // The handler may have been reading the line while the hardware overwrote it
+      uint32_t now = storage->rx_written;
+      if (prv_lapped(start, now)) {
+        storage->stats.rx_bytes += now - written;
+        prv_overrun(storage, now);
+        return;
+      }
+    }
+  }
+}
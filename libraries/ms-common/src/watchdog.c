@@ -1,19 +1,153 @@
 #include "watchdog.h"
 
-void prv_expiry_callback(SoftTimerId timer_id, void *context) {
-  WatchdogStorage *storage = (WatchdogStorage *)context;
-  storage->callback(storage->callback_context);
+#include <stddef.h>
+
+#include "critical_section.h"
+
+#define WATCHDOG_US_PER_MS 1000
+
+// Running watchdogs, and the soft timer set for the earliest of their deadlines. Storages are
+// found by address, so re-initializing one that is still running doesn't register it twice.
+static WatchdogStorage *s_watchdogs[WATCHDOG_MAX_WATCHDOGS];
+static SoftTimerId s_check_timer = SOFT_TIMER_INVALID_TIMER;
+
+typedef struct WatchdogExpiry {
+  WatchdogExpiryCallback callback;
+  void *context;
+} WatchdogExpiry;
+
+static uint32_t prv_timeout_us(const WatchdogStorage *storage) {
+  return storage->timeout_ms * WATCHDOG_US_PER_MS;
 }
 
-void watchdog_start(WatchdogStorage *storage, WatchdogTimeout timeout_ms,
-                    WatchdogExpiryCallback callback, void *context) {
+static void prv_check(SoftTimerId timer_id, void *context);
+
+// Must be called in a critical section
+static void prv_set_check_timer(uint32_t now_us) {
+  if (s_check_timer != SOFT_TIMER_INVALID_TIMER) {
+    soft_timer_cancel(s_check_timer);
+    s_check_timer = SOFT_TIMER_INVALID_TIMER;
+  }
+
+  bool found = false;
+  uint32_t next_check_us = 0;
+  for (size_t i = 0; i < WATCHDOG_MAX_WATCHDOGS; i++) {
+    const WatchdogStorage *storage = s_watchdogs[i];
+    if (storage == NULL || !storage->running) {
+      continue;
+    }
+    uint32_t elapsed_us = now_us - storage->last_kick_us;
+    uint32_t remaining_us =
+        elapsed_us < prv_timeout_us(storage) ? prv_timeout_us(storage) - elapsed_us : 0;
+    if (!found || remaining_us < next_check_us) {
+      next_check_us = remaining_us;
+      found = true;
+    }
+  }
+
+  if (found) {
+    if (next_check_us < SOFT_TIMER_MIN_TIME_US) {
+      next_check_us = SOFT_TIMER_MIN_TIME_US;
+    }
+    soft_timer_start(next_check_us, prv_check, NULL, &s_check_timer);
+  }
+}
+
+static void prv_check(SoftTimerId timer_id, void *context) {
+  // Expired watchdogs are collected under the critical section, but called back outside it
+  WatchdogExpiry expired[WATCHDOG_MAX_WATCHDOGS];
+  size_t num_expired = 0;
+
+  const bool critical = critical_section_start();
+  s_check_timer = SOFT_TIMER_INVALID_TIMER;
+  uint32_t now_us = soft_timer_now_us();
+  for (size_t i = 0; i < WATCHDOG_MAX_WATCHDOGS; i++) {
+    WatchdogStorage *storage = s_watchdogs[i];
+    if (storage == NULL) {
+      continue;
+    }
+    if (!storage->running) {
+      s_watchdogs[i] = NULL;
+    } else if (now_us - storage->last_kick_us >= prv_timeout_us(storage)) {
+      storage->running = false;
+      s_watchdogs[i] = NULL;
+      expired[num_expired].callback = storage->callback;
+      expired[num_expired].context = storage->callback_context;
+      num_expired++;
+    }
+  }
+  prv_set_check_timer(now_us);
+  critical_section_end(critical);
+
+  // Callbacks may start their watchdog again
+  for (size_t i = 0; i < num_expired; i++) {
+    expired[i].callback(expired[i].context);
+  }
+}
+
+StatusCode watchdog_start(WatchdogStorage *storage, WatchdogTimeout timeout_ms,
+                          WatchdogExpiryCallback callback, void *context) {
+  const bool critical = critical_section_start();
+  size_t slot = WATCHDOG_MAX_WATCHDOGS;
+  for (size_t i = 0; i < WATCHDOG_MAX_WATCHDOGS; i++) {
+    if (s_watchdogs[i] == storage) {
+      slot = i;
+      break;
+    }
+    if (s_watchdogs[i] == NULL && slot == WATCHDOG_MAX_WATCHDOGS) {
+      slot = i;
+    }
+  }
+  if (slot == WATCHDOG_MAX_WATCHDOGS) {
+    critical_section_end(critical);
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "Out of watchdogs.");
+  }
+
+  uint32_t now_us = soft_timer_now_us();
   storage->timeout_ms = timeout_ms;
   storage->callback = callback;
   storage->callback_context = context;
-  watchdog_kick(storage);
+  storage->last_kick_us = now_us;
+  storage->max_kick_interval_us = 0;
+  storage->running = true;
+  s_watchdogs[slot] = storage;
+
+  prv_set_check_timer(now_us);
+  critical_section_end(critical);
+  return STATUS_CODE_OK;
 }
 
 void watchdog_kick(WatchdogStorage *storage) {
-  soft_timer_cancel(storage->timer_id);
-  soft_timer_start_millis(storage->timeout_ms, prv_expiry_callback, storage, &storage->timer_id);
+  if (!storage->running) {
+    if (storage->callback != NULL) {
+      watchdog_start(storage, storage->timeout_ms, storage->callback, storage->callback_context);
+    }
+    return;
+  }
+
+  uint32_t now_us = soft_timer_now_us();
+  uint32_t interval_us = now_us - storage->last_kick_us;
+  if (interval_us > storage->max_kick_interval_us) {
+    storage->max_kick_interval_us = interval_us;
+  }
+  storage->last_kick_us = now_us;
+}
+
+void watchdog_stop(WatchdogStorage *storage) {
+  const bool critical = critical_section_start();
+  storage->running = false;
+  for (size_t i = 0; i < WATCHDOG_MAX_WATCHDOGS; i++) {
+    if (s_watchdogs[i] == storage) {
+      s_watchdogs[i] = NULL;
+    }
+  }
+  prv_set_check_timer(soft_timer_now_us());
+  critical_section_end(critical);
+}
+
+uint32_t watchdog_get_min_slack_us(const WatchdogStorage *storage) {
+  if (!storage->running || storage->max_kick_interval_us >= prv_timeout_us(storage)) {
+    return 0;
+  }
+  return prv_timeout_us(storage) - storage->max_kick_interval_us;
 }
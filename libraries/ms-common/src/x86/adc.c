@@ -1,17 +1,25 @@
 #include <stddef.h>
+#include <string.h>
 #include "log.h"
 
 #include "adc.h"
 #include "interrupt.h"
 #include "soft_timer.h"
+#include "x86_adc.h"
 // x86 implementation very similar to STM32F0 implementation.
 // adc_read_raw should always return 2500.
 // Vdda locked at 3300 mV.
 // adc_read_converted should always return close to 2V
 // temperature reading always returns 293 kelvin.
+// Like the STM32F0, every read in single mode converts the whole sequence of enabled channels, and
+// continuous mode converts a sequence every ADC_CONTINUOUS_CB_FREQ_MS. In scan mode, a soft timer
+// stands in for the DMA finishing a scan ADC_SCAN_CHANNEL_US per channel after it's started.
+// Sequences are counted so tests can see how many conversions a read costs.
 
 #define ADC_RETURNED_VOLTAGE_RAW 2500
 #define ADC_CONTINUOUS_CB_FREQ_MS 50
+// 239.5 sampling + 12.5 conversion cycles at 14 MHz
+#define ADC_SCAN_CHANNEL_US 18
 #define ADC_TEMP_RETURN 293
 #define ADC_VDDA_RETURN 3300
 
@@ -25,6 +33,21 @@ typedef struct AdcInterrupt {
 static AdcInterrupt s_adc_interrupts[NUM_ADC_CHANNELS];
 
 static bool s_active_channels[NUM_ADC_CHANNELS];
+static uint16_t s_raw_readings[NUM_ADC_CHANNELS];
+
+static AdcMode s_mode;
+static bool s_scanning;
+static X86AdcStats s_stats;
+
+static AdcSnapshot s_snapshot;
+static bool s_snapshot_valid;
+static AdcSequenceCallback s_sequence_callback;
+static void *s_sequence_context;
+
+// Vdda from the last sequence the reference was converted in
+static bool s_vdda_valid;
+static uint16_t s_vdda_mv;
+static uint32_t s_vdda_timestamp_us;
 
 static uint16_t prv_get_temp(uint16_t reading) {
   return ADC_TEMP_RETURN;
@@ -51,6 +74,32 @@ static StatusCode prv_check_channel_valid_and_enabled(AdcChannel adc_channel) {
   return STATUS_CODE_OK;
 }
 
+static StatusCode prv_convert(AdcChannel adc_channel, uint16_t raw, uint16_t vdda,
+                              uint16_t *reading) {
+  switch (adc_channel) {
+    case ADC_CHANNEL_TEMP:
+      *reading = prv_get_temp(raw);
+      return STATUS_CODE_OK;
+
+    case ADC_CHANNEL_REF:
+      *reading = prv_get_vdda(raw);
+      return STATUS_CODE_OK;
+
+    case ADC_CHANNEL_BAT:
+      raw *= 2;
+      break;
+
+    default:
+      break;
+  }
+
+  if (vdda == 0) {
+    return status_code(STATUS_CODE_EMPTY);
+  }
+  *reading = (raw * vdda) / 4095;
+  return STATUS_CODE_OK;
+}
+
 static GpioAddress prv_channel_to_gpio(uint8_t adc_channel) {
   GpioAddress address;
   if (adc_channel >= 8 && adc_channel < 10) {
@@ -66,7 +115,7 @@ static GpioAddress prv_channel_to_gpio(uint8_t adc_channel) {
   return address;
 }
 
-static void prv_periodic_continous_cb(SoftTimerId id, void *context) {
+static void prv_run_channel_callbacks(void) {
   for (AdcChannel i = 0; i < NUM_ADC_CHANNELS; i++) {
     if (s_adc_interrupts[i].callback != NULL) {
       s_adc_interrupts[i].callback(i, s_adc_interrupts[i].context);
@@ -74,12 +123,61 @@ static void prv_periodic_continous_cb(SoftTimerId id, void *context) {
       s_adc_interrupts[i].pin_callback(prv_channel_to_gpio(i), s_adc_interrupts[i].context);
     }
   }
+}
+
+// Converts every enabled channel and publishes the results like the STM32F0's end of sequence
+// interrupt does
+static void prv_convert_sequence(void) {
+  s_stats.sequences++;
+  s_snapshot.channels = 0;
+  for (AdcChannel i = 0; i < NUM_ADC_CHANNELS; i++) {
+    if (s_active_channels[i]) {
+      s_stats.conversions++;
+      s_adc_interrupts[i].reading = s_raw_readings[i];
+      s_snapshot.raw[i] = s_raw_readings[i];
+      s_snapshot.channels |= (uint32_t)1 << i;
+    }
+  }
+  s_snapshot.timestamp_us = soft_timer_now_us();
+  s_snapshot.vdda_mv = 0;
+  if (s_active_channels[ADC_CHANNEL_REF]) {
+    s_snapshot.vdda_mv = prv_get_vdda(s_raw_readings[ADC_CHANNEL_REF]);
+    s_vdda_mv = s_snapshot.vdda_mv;
+    s_vdda_timestamp_us = s_snapshot.timestamp_us;
+    s_vdda_valid = true;
+  }
+  s_snapshot_valid = true;
+
+  if (s_sequence_callback != NULL) {
+    s_sequence_callback(&s_snapshot, s_sequence_context);
+  }
+}
+
+static void prv_periodic_continous_cb(SoftTimerId id, void *context) {
+  prv_convert_sequence();
+  prv_run_channel_callbacks();
   soft_timer_start_millis(ADC_CONTINUOUS_CB_FREQ_MS, prv_periodic_continous_cb, NULL, NULL);
 }
 
+static void prv_scan_done(SoftTimerId id, void *context) {
+  prv_convert_sequence();
+  prv_run_channel_callbacks();
+  s_scanning = false;
+}
+
 void adc_init(AdcMode adc_mode) {
   interrupt_init();
   soft_timer_init();
+  s_mode = adc_mode;
+  s_scanning = false;
+  s_stats = (X86AdcStats){ 0 };
+  s_vdda_valid = false;
+  s_snapshot_valid = false;
+  s_sequence_callback = NULL;
+  s_sequence_context = NULL;
+  for (size_t i = 0; i < NUM_ADC_CHANNELS; ++i) {
+    s_raw_readings[i] = ADC_RETURNED_VOLTAGE_RAW;
+  }
   if (adc_mode == ADC_MODE_CONTINUOUS) {
     soft_timer_start_millis(ADC_CONTINUOUS_CB_FREQ_MS, prv_periodic_continous_cb, NULL, NULL);
   }
@@ -93,7 +191,14 @@ StatusCode adc_set_channel(AdcChannel adc_channel, bool new_state) {
   if (adc_channel >= NUM_ADC_CHANNELS) {
     return status_code(STATUS_CODE_INVALID_ARGS);
   }
+  // Like the STM32F0, the sequence can't change while a scan converts it
+  if (s_scanning) {
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
   s_active_channels[adc_channel] = new_state;
+  if (adc_channel == ADC_CHANNEL_REF && !new_state) {
+    s_vdda_valid = false;
+  }
   return STATUS_CODE_OK;
 }
 
@@ -134,7 +239,13 @@ StatusCode adc_register_callback(AdcChannel adc_channel, AdcCallback callback, v
 
 StatusCode adc_read_raw(AdcChannel adc_channel, uint16_t *reading) {
   status_ok_or_return(prv_check_channel_valid_and_enabled(adc_channel));
-  s_adc_interrupts[adc_channel].reading = ADC_RETURNED_VOLTAGE_RAW;
+  if (s_mode != ADC_MODE_SINGLE) {
+    // Just the latest, like the STM32F0
+    *reading = s_adc_interrupts[adc_channel].reading;
+    return STATUS_CODE_OK;
+  }
+
+  prv_convert_sequence();
   *reading = s_adc_interrupts[adc_channel].reading;
 
   // this section mimics the IRQ handler
@@ -151,28 +262,90 @@ StatusCode adc_read_raw(AdcChannel adc_channel, uint16_t *reading) {
 StatusCode adc_read_converted(AdcChannel adc_channel, uint16_t *reading) {
   status_ok_or_return(prv_check_channel_valid_and_enabled(adc_channel));
   uint16_t adc_reading = 0;
-  adc_read_raw(adc_channel, &adc_reading);
-  switch (adc_channel) {
-    case ADC_CHANNEL_TEMP:
-      *reading = prv_get_temp(adc_reading);
-      return STATUS_CODE_OK;
+  status_ok_or_return(adc_read_raw(adc_channel, &adc_reading));
 
-    case ADC_CHANNEL_REF:
-      *reading = prv_get_vdda(adc_reading);
-      return STATUS_CODE_OK;
+  // The reference was converted in the same sequence, so there's no need to start another
+  uint16_t vdda = 0;
+  if (adc_channel != ADC_CHANNEL_TEMP && adc_channel != ADC_CHANNEL_REF) {
+    status_ok_or_return(adc_get_vdda(&vdda, NULL));
+  }
+  return prv_convert(adc_channel, adc_reading, vdda, reading);
+}
 
-    case ADC_CHANNEL_BAT:
-      adc_reading *= 2;
-      break;
+StatusCode adc_get_vdda(uint16_t *vdda_mv, uint32_t *timestamp_us) {
+  if (vdda_mv == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  if (!s_vdda_valid) {
+    return status_code(STATUS_CODE_EMPTY);
+  }
+  *vdda_mv = s_vdda_mv;
+  if (timestamp_us != NULL) {
+    *timestamp_us = s_vdda_timestamp_us;
+  }
+  return STATUS_CODE_OK;
+}
 
-    default:
-      break;
+void adc_register_sequence_callback(AdcSequenceCallback callback, void *context) {
+  s_sequence_callback = callback;
+  s_sequence_context = context;
+}
+
+StatusCode adc_scan_start(void) {
+  if (s_mode != ADC_MODE_SCAN) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+  if (s_scanning) {
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  uint32_t num_channels = 0;
+  for (AdcChannel i = 0; i < NUM_ADC_CHANNELS; i++) {
+    num_channels += s_active_channels[i];
+  }
+  if (num_channels == 0) {
+    return status_code(STATUS_CODE_EMPTY);
+  }
+
+  uint32_t scan_us = num_channels * ADC_SCAN_CHANNEL_US;
+  if (scan_us < SOFT_TIMER_MIN_TIME_US) {
+    scan_us = SOFT_TIMER_MIN_TIME_US;
+  }
+  status_ok_or_return(soft_timer_start(scan_us, prv_scan_done, NULL, NULL));
+  s_scanning = true;
+  return STATUS_CODE_OK;
+}
+
+StatusCode adc_get_snapshot(AdcSnapshot *snapshot) {
+  if (snapshot == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  if (!s_snapshot_valid) {
+    return status_code(STATUS_CODE_EMPTY);
+  }
+  memcpy(snapshot, &s_snapshot, sizeof(*snapshot));
+  return STATUS_CODE_OK;
+}
+
+StatusCode adc_get_snapshot_converted(const AdcSnapshot *snapshot, AdcChannel adc_channel,
+                                      uint16_t *reading) {
+  if (snapshot == NULL || reading == NULL || adc_channel >= NUM_ADC_CHANNELS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  if (!(snapshot->channels & ((uint32_t)1 << adc_channel))) {
+    return status_code(STATUS_CODE_EMPTY);
   }
+  return prv_convert(adc_channel, snapshot->raw[adc_channel], snapshot->vdda_mv, reading);
+}
 
-  uint16_t vdda;
-  adc_read_converted(ADC_CHANNEL_REF, &vdda);
-  *reading = (adc_reading * vdda) / 4095;
+void x86_adc_get_stats(X86AdcStats *stats) {
+  *stats = s_stats;
+}
 
+StatusCode x86_adc_set_reading(AdcChannel adc_channel, uint16_t reading) {
+  if (adc_channel >= NUM_ADC_CHANNELS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  s_raw_readings[adc_channel] = reading;
   return STATUS_CODE_OK;
 }
 
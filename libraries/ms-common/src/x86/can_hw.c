@@ -4,26 +4,46 @@
 #include <linux/can.h>
 #include <linux/can/raw.h>
 #include <net/if.h>
-#include <poll.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "critical_section.h"
 #include "fifo.h"
 #include "interrupt_def.h"
 #include "log.h"
+#include "misc.h"
+#include "x86_can_hw.h"
 #include "x86_interrupt.h"
 
-#define CAN_HW_DEV_INTERFACE "vcan0"
+// A single thread services the socket through epoll:
+// - RX drains the socket in batches with recvmmsg and hands every batch to the RX handler.
+// - TX sends queued frames in batches with sendmmsg. Frames wait in arbitration order, lowest ID
+//   first, like the mailboxes on the STM32F0. The bus bitrate is modelled with a token bucket:
+//   each frame costs its length in bits and tokens refill at the bitrate while frames are
+//   waiting, so a frame only goes out once it would have finished transmitting. Once the bucket
+//   runs dry, a timerfd wakes the thread when there are enough tokens for the next frame.
+// - Acceptance filters are applied on the IO thread like the MCU's, so a batch with nothing that
+//   passes never raises the RX interrupt.
+
+#define CAN_HW_DEFAULT_DEVICE "vcan0"
 #define CAN_HW_MAX_FILTERS 14
-#define CAN_HW_TX_FIFO_LEN 8
-// Check for thread exit once every 10ms
-#define CAN_HW_THREAD_EXIT_PERIOD_US 10000
+#define CAN_HW_TX_QUEUE_LEN 32
+#define CAN_HW_RX_FIFO_LEN 32
+#define CAN_HW_BATCH_SIZE 16
+// Longest frame: extended ID, 8 data bytes - see prv_frame_bits()
+#define CAN_HW_MAX_FRAME_BITS (67 + 8 * 8)
+
+#define CAN_HW_NS_PER_S 1000000000LL
 
 typedef struct CanHwEventHandler {
   CanHwEventHandlerCb callback;
@@ -32,132 +52,311 @@ typedef struct CanHwEventHandler {
 
 typedef struct CanHwSocketData {
   int can_fd;
-  struct can_frame rx_frame;
-  Fifo tx_fifo;
-  struct can_frame tx_frames[CAN_HW_TX_FIFO_LEN];
+  int epoll_fd;
+  int kick_fd;
+  int timer_fd;
+  Fifo rx_fifo;
+  struct can_frame rx_frames[CAN_HW_RX_FIFO_LEN];
+  // Sorted by prv_arbitration_key(), and shared with the IO thread under |tx_lock|
+  struct can_frame tx_queue[CAN_HW_TX_QUEUE_LEN];
+  size_t tx_queue_len;
+  pthread_mutex_t tx_lock;
+  // Filters from can_hw_add_filter() and banks from can_hw_set_filters(), which share the MCU's
+  // filter banks. Shared with the IO thread under |filter_lock|.
   struct can_filter filters[CAN_HW_MAX_FILTERS];
   size_t num_filters;
+  CanFilterBank banks[CAN_FILTER_NUM_BANKS];
+  size_t num_banks;
+  pthread_mutex_t filter_lock;
   CanHwEventHandler handlers[NUM_CAN_HW_EVENTS];
-  uint32_t delay_us;
+  uint32_t bitrate;
+  // Token bucket, in bits scaled by CAN_HW_NS_PER_S so refills are exact
+  int64_t tokens;
+  int64_t last_refill_ns;
+  // No frames were waiting as of the last refill
+  bool tx_idle;
+  // Frames taken from the TX queue that the socket couldn't take yet
+  struct can_frame tx_batch[CAN_HW_BATCH_SIZE];
+  size_t tx_batch_len;
+  size_t tx_batch_sent;
+  X86CanHwStats stats;
+  int64_t init_ns;
 } CanHwSocketData;
 
-static pthread_t s_rx_pthread_id;
-static pthread_t s_tx_pthread_id;
-static pthread_barrier_t s_barrier;
-// Producer/Consumer semaphore
-static sem_t s_tx_sem;
-
-// Locked if the TX/RX threads should be alive, unlocked on exit
-static pthread_mutex_t s_keep_alive = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t s_io_pthread_id;
+static volatile bool s_exit = false;
 
 static CanHwSocketData s_socket_data = { .can_fd = -1 };
 
-static uint32_t prv_get_delay(CanHwBitrate bitrate) {
-  const uint32_t delay_us[NUM_CAN_HW_BITRATES] = {
-    1000,  // 125 kbps
-    500,   // 250 kbps
-    250,   // 500 kbps
-    125,   // 1 mbps
+static uint32_t prv_get_bitrate(CanHwBitrate bitrate) {
+  const uint32_t bitrates[NUM_CAN_HW_BITRATES] = {
+    125000,   // 125 kbps
+    250000,   // 250 kbps
+    500000,   // 500 kbps
+    1000000,  // 1 mbps
   };
 
-  return delay_us[bitrate];
+  return bitrates[bitrate];
 }
 
-static void *prv_rx_thread(void *arg) {
-  x86_interrupt_pthread_init();
-  LOG_DEBUG("CAN HW RX thread started\n");
-
-  pthread_barrier_wait(&s_barrier);
+static int64_t prv_now_ns(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * CAN_HW_NS_PER_S + now.tv_nsec;
+}
 
-  struct timeval timeout = { .tv_usec = CAN_HW_THREAD_EXIT_PERIOD_US };
+// Nominal frame length including the interframe space, ignoring bit stuffing
+static int64_t prv_frame_bits(const struct can_frame *frame) {
+  int64_t header_bits = (frame->can_id & CAN_EFF_FLAG) ? 67 : 47;
+  return header_bits + 8 * frame->can_dlc;
+}
 
-  // Mutex is unlocked when the thread should exit
-  while (pthread_mutex_trylock(&s_keep_alive) != 0) {
-    // Select timeout is used to poll every now and then
-    fd_set input_fds;
-    FD_ZERO(&input_fds);
-    FD_SET(s_socket_data.can_fd, &input_fds);
+// Orders frames the way the bus arbitrates: by base ID, then a standard frame ahead of an extended
+// frame with the same base ID
+static uint32_t prv_arbitration_key(const struct can_frame *frame) {
+  if (frame->can_id & CAN_EFF_FLAG) {
+    uint32_t id = frame->can_id & CAN_EFF_MASK;
+    return (id >> 18) << 19 | 1 << 18 | (id & 0x3FFFF);
+  }
+  return (frame->can_id & CAN_SFF_MASK) << 19;
+}
 
-    select(s_socket_data.can_fd + 1, &input_fds, NULL, NULL, &timeout);
+// Queues behind any frames that would win arbitration or tie, so equal IDs stay in order.
+// Interrupts are held off while the lock is taken: a handler that transmits while the main thread
+// holds it would never get it.
+static StatusCode prv_tx_queue_push(const struct can_frame *frame) {
+  bool disabled = critical_section_start();
+  pthread_mutex_lock(&s_socket_data.tx_lock);
+  if (s_socket_data.tx_queue_len == CAN_HW_TX_QUEUE_LEN) {
+    pthread_mutex_unlock(&s_socket_data.tx_lock);
+    critical_section_end(disabled);
+    return STATUS_CODE_RESOURCE_EXHAUSTED;
+  }
 
-    if (FD_ISSET(s_socket_data.can_fd, &input_fds)) {
-      int bytes =
-          read(s_socket_data.can_fd, &s_socket_data.rx_frame, sizeof(s_socket_data.rx_frame));
+  uint32_t key = prv_arbitration_key(frame);
+  size_t i = s_socket_data.tx_queue_len;
+  while (i > 0 && prv_arbitration_key(&s_socket_data.tx_queue[i - 1]) > key) {
+    s_socket_data.tx_queue[i] = s_socket_data.tx_queue[i - 1];
+    i--;
+  }
+  s_socket_data.tx_queue[i] = *frame;
+  s_socket_data.tx_queue_len++;
+  pthread_mutex_unlock(&s_socket_data.tx_lock);
+  critical_section_end(disabled);
 
-      if (s_socket_data.handlers[CAN_HW_EVENT_MSG_RX].callback != NULL) {
-        s_socket_data.handlers[CAN_HW_EVENT_MSG_RX].callback(
-            s_socket_data.handlers[CAN_HW_EVENT_TX_READY].context);
-      }
+  return STATUS_CODE_OK;
+}
 
-      // Wakes the main thread
-      x86_interrupt_wake();
-      // Limit how often we can receive messages to simulate bus speed
-      usleep(s_socket_data.delay_us);
-    }
+static void prv_refill_tokens(int64_t now_ns) {
+  // Bus time missed while the IO thread was descheduled is caught up on with a batch
+  const int64_t max_tokens = CAN_HW_BATCH_SIZE * CAN_HW_MAX_FRAME_BITS * CAN_HW_NS_PER_S;
+  if (s_socket_data.tx_idle) {
+    // An idle bus doesn't bank time - the next frame starts transmitting now
+    s_socket_data.tokens = 0;
+  } else {
+    s_socket_data.tokens += (now_ns - s_socket_data.last_refill_ns) * s_socket_data.bitrate;
+  }
+  if (s_socket_data.tokens > max_tokens) {
+    s_socket_data.tokens = max_tokens;
   }
+  s_socket_data.last_refill_ns = now_ns;
+}
 
-  pthread_mutex_unlock(&s_keep_alive);
+static void prv_arm_timer(int64_t delay_ns) {
+  struct itimerspec spec = {
+    .it_value = { .tv_sec = delay_ns / CAN_HW_NS_PER_S, .tv_nsec = delay_ns % CAN_HW_NS_PER_S },
+  };
+  timerfd_settime(s_socket_data.timer_fd, 0, &spec, NULL);
+}
 
-  return NULL;
+static bool prv_accept(const struct can_frame *frame) {
+  pthread_mutex_lock(&s_socket_data.filter_lock);
+  bool accept = (s_socket_data.num_filters == 0 && s_socket_data.num_banks == 0);
+  for (size_t i = 0; i < s_socket_data.num_filters && !accept; i++) {
+    const struct can_filter *filter = &s_socket_data.filters[i];
+    accept = ((frame->can_id & filter->can_mask) == (filter->can_id & filter->can_mask));
+  }
+  if (!accept && s_socket_data.num_banks > 0 && !(frame->can_id & CAN_EFF_FLAG)) {
+    accept = can_filter_match(s_socket_data.banks, s_socket_data.num_banks,
+                              (uint16_t)(frame->can_id & CAN_SFF_MASK));
+  }
+  pthread_mutex_unlock(&s_socket_data.filter_lock);
+
+  return accept;
 }
 
-static void *prv_tx_thread(void *arg) {
-  x86_interrupt_pthread_init();
-  LOG_DEBUG("CAN HW TX thread started\n");
-  struct can_frame frame = { 0 };
+static void prv_handle_rx(void) {
+  struct can_frame frames[CAN_HW_BATCH_SIZE];
+  struct iovec iovecs[CAN_HW_BATCH_SIZE];
+  struct mmsghdr msgs[CAN_HW_BATCH_SIZE];
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < CAN_HW_BATCH_SIZE; i++) {
+    iovecs[i] = (struct iovec){ .iov_base = &frames[i], .iov_len = sizeof(frames[i]) };
+    msgs[i].msg_hdr.msg_iov = &iovecs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int received = 0;
+  while ((received = recvmmsg(s_socket_data.can_fd, msgs, CAN_HW_BATCH_SIZE, MSG_DONTWAIT,
+                              NULL)) > 0) {
+    int accepted = 0;
+    for (int i = 0; i < received; i++) {
+      if (!prv_accept(&frames[i])) {
+        __atomic_add_fetch(&s_socket_data.stats.rx_filtered, 1, __ATOMIC_RELAXED);
+      } else if (fifo_push(&s_socket_data.rx_fifo, &frames[i]) == STATUS_CODE_OK) {
+        __atomic_add_fetch(&s_socket_data.stats.rx_frames, 1, __ATOMIC_RELAXED);
+        accepted++;
+      } else {
+        __atomic_add_fetch(&s_socket_data.stats.rx_dropped, 1, __ATOMIC_RELAXED);
+      }
+    }
+    if (accepted == 0) {
+      continue;
+    }
 
-  pthread_barrier_wait(&s_barrier);
+    if (s_socket_data.handlers[CAN_HW_EVENT_MSG_RX].callback != NULL) {
+      s_socket_data.handlers[CAN_HW_EVENT_MSG_RX].callback(
+          s_socket_data.handlers[CAN_HW_EVENT_MSG_RX].context);
+    }
 
-  // Mutex is unlocked when the thread should exit
-  while (pthread_mutex_trylock(&s_keep_alive) != 0) {
-    // Wait until the producer has created an item
-    sem_wait(&s_tx_sem);
+    // Wakes the main thread
     x86_interrupt_wake();
-    fifo_pop(&s_socket_data.tx_fifo, &frame);
-    int bytes = write(s_socket_data.can_fd, &frame, sizeof(frame));
+  }
+}
 
-    // Delay to simulate bus speed
-    usleep(s_socket_data.delay_us);
+static void prv_handle_tx(void) {
+  int64_t now_ns = prv_now_ns();
+  prv_refill_tokens(now_ns);
+
+  // Only take new frames once the last batch is out
+  if (s_socket_data.tx_batch_sent == s_socket_data.tx_batch_len) {
+    s_socket_data.tx_batch_len = 0;
+    s_socket_data.tx_batch_sent = 0;
+
+    pthread_mutex_lock(&s_socket_data.tx_lock);
+    size_t taken = 0;
+    while (s_socket_data.tx_batch_len < CAN_HW_BATCH_SIZE && taken < s_socket_data.tx_queue_len) {
+      const struct can_frame *frame = &s_socket_data.tx_queue[taken];
+      int64_t cost = prv_frame_bits(frame) * CAN_HW_NS_PER_S;
+      if (s_socket_data.tokens < cost) {
+        // Wait until the bus would be free for this frame
+        prv_arm_timer((cost - s_socket_data.tokens) / s_socket_data.bitrate + 1);
+        break;
+      }
+      s_socket_data.tokens -= cost;
+      s_socket_data.tx_batch[s_socket_data.tx_batch_len++] = *frame;
+      taken++;
+    }
+    s_socket_data.tx_queue_len -= taken;
+    memmove(s_socket_data.tx_queue, &s_socket_data.tx_queue[taken],
+            s_socket_data.tx_queue_len * sizeof(s_socket_data.tx_queue[0]));
+    s_socket_data.tx_idle = (s_socket_data.tx_batch_len == 0 && s_socket_data.tx_queue_len == 0);
+    pthread_mutex_unlock(&s_socket_data.tx_lock);
+  }
 
+  size_t pending = s_socket_data.tx_batch_len - s_socket_data.tx_batch_sent;
+  if (pending == 0) {
+    return;
+  }
+
+  struct iovec iovecs[CAN_HW_BATCH_SIZE];
+  struct mmsghdr msgs[CAN_HW_BATCH_SIZE];
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < pending; i++) {
+    struct can_frame *frame = &s_socket_data.tx_batch[s_socket_data.tx_batch_sent + i];
+    iovecs[i] = (struct iovec){ .iov_base = frame, .iov_len = sizeof(*frame) };
+    msgs[i].msg_hdr.msg_iov = &iovecs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int sent = sendmmsg(s_socket_data.can_fd, msgs, (unsigned int)pending, MSG_DONTWAIT);
+  if (sent < (int)pending) {
+    // The socket buffer is full - retry the rest once the interface has drained it
+    prv_arm_timer(CAN_HW_MAX_FRAME_BITS * CAN_HW_NS_PER_S / s_socket_data.bitrate);
+  }
+  if (sent <= 0) {
+    return;
+  }
+
+  s_socket_data.tx_batch_sent += (size_t)sent;
+  __atomic_add_fetch(&s_socket_data.stats.tx_frames, (uint32_t)sent, __ATOMIC_RELAXED);
+
+  // TX ready fires once per transmitted frame, like the mailbox interrupt
+  for (int i = 0; i < sent; i++) {
     if (s_socket_data.handlers[CAN_HW_EVENT_TX_READY].callback != NULL) {
       s_socket_data.handlers[CAN_HW_EVENT_TX_READY].callback(
           s_socket_data.handlers[CAN_HW_EVENT_TX_READY].context);
     }
   }
+  x86_interrupt_wake();
+}
+
+static void *prv_io_thread(void *arg) {
+  x86_interrupt_pthread_init();
+  LOG_DEBUG("CAN HW IO thread started\n");
+
+  struct epoll_event events[3];
+  while (!s_exit) {
+    int num_events = epoll_wait(s_socket_data.epoll_fd, events, 3, -1);
+
+    for (int i = 0; i < num_events; i++) {
+      uint64_t count = 0;
+      if (events[i].data.fd == s_socket_data.can_fd) {
+        prv_handle_rx();
+      } else if (read(events[i].data.fd, &count, sizeof(count)) < 0) {
+        // Kick or timer - only needs to be cleared
+        LOG_DEBUG("CAN HW: failed to clear fd %d\n", events[i].data.fd);
+      }
+    }
 
-  pthread_mutex_unlock(&s_keep_alive);
+    prv_handle_tx();
+  }
 
   return NULL;
 }
 
-StatusCode can_hw_init(const CanHwSettings *settings) {
-  if (s_socket_data.can_fd != -1) {
-    LOG_DEBUG("Exiting CAN HW\n");
+static void prv_kick_io_thread(void) {
+  uint64_t kick = 1;
+  if (write(s_socket_data.kick_fd, &kick, sizeof(kick)) < 0) {
+    LOG_DEBUG("CAN HW: failed to kick IO thread\n");
+  }
+}
 
-    // Request threads to exit
-    close(s_socket_data.can_fd);
+// Closes whatever has been opened and destroys the locks
+static void prv_cleanup(void) {
+  int *fds[] = { &s_socket_data.timer_fd, &s_socket_data.kick_fd, &s_socket_data.epoll_fd,
+                 &s_socket_data.can_fd };
+  for (size_t i = 0; i < SIZEOF_ARRAY(fds); i++) {
+    if (*fds[i] >= 0) {
+      close(*fds[i]);
+    }
+    *fds[i] = -1;
+  }
+  pthread_mutex_destroy(&s_socket_data.tx_lock);
+  pthread_mutex_destroy(&s_socket_data.filter_lock);
+}
 
-    pthread_mutex_unlock(&s_keep_alive);
+static void prv_deinit(void) {
+  LOG_DEBUG("Exiting CAN HW\n");
 
-    pthread_join(s_rx_pthread_id, NULL);
+  // Request the thread to exit
+  s_exit = true;
+  prv_kick_io_thread();
+  pthread_join(s_io_pthread_id, NULL);
 
-    // Allow the TX thread to continue
-    sem_post(&s_tx_sem);
+  prv_cleanup();
+}
 
-    sem_destroy(&s_tx_sem);
-    pthread_join(s_tx_pthread_id, NULL);
+static StatusCode prv_epoll_add(int fd) {
+  struct epoll_event event = { .events = EPOLLIN, .data.fd = fd };
+  if (epoll_ctl(s_socket_data.epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to set up epoll");
   }
+  return STATUS_CODE_OK;
+}
 
-  pthread_mutex_init(&s_keep_alive, NULL);
-  // Init semaphore to thread-shared and locked
-  sem_init(&s_tx_sem, 0, 0);
-
-  pthread_mutex_lock(&s_keep_alive);
-
-  memset(&s_socket_data, 0, sizeof(s_socket_data));
-  s_socket_data.delay_us = prv_get_delay(settings->bitrate);
-  fifo_init(&s_socket_data.tx_fifo, s_socket_data.tx_frames);
-
+// Opens a non-blocking SocketCAN socket bound to |device|
+static StatusCode prv_open_socket(const char *device, bool loopback) {
   s_socket_data.can_fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
   if (s_socket_data.can_fd == -1) {
     LOG_CRITICAL("CAN HW: Failed to open SocketCAN socket\n");
@@ -165,22 +364,24 @@ StatusCode can_hw_init(const CanHwSettings *settings) {
   }
 
   // Loopback - expects to receive its own messages
-  int loopback = settings->loopback;
-  if (setsockopt(s_socket_data.can_fd, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &loopback,
-                 sizeof(loopback)) < 0) {
+  int recv_own = loopback;
+  if (setsockopt(s_socket_data.can_fd, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &recv_own,
+                 sizeof(recv_own)) < 0) {
     LOG_CRITICAL("CAN HW: Failed to set loopback mode on socket\n");
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to set loopback mode on socket");
   }
 
   struct ifreq ifr = { 0 };
-  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", CAN_HW_DEV_INTERFACE);
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", device);
   if (ioctl(s_socket_data.can_fd, SIOCGIFINDEX, &ifr) < 0) {
-    LOG_CRITICAL("CAN HW: Device %s not found\n", CAN_HW_DEV_INTERFACE);
+    LOG_CRITICAL("CAN HW: Device %s not found\n", device);
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Device not found");
   }
 
   // Set non-blocking
-  fcntl(s_socket_data.can_fd, F_SETFL, O_NONBLOCK);
+  if (fcntl(s_socket_data.can_fd, F_SETFL, O_NONBLOCK) < 0) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to set socket non-blocking");
+  }
 
   struct sockaddr_can addr = {
     .can_family = AF_CAN,
@@ -191,16 +392,62 @@ StatusCode can_hw_init(const CanHwSettings *settings) {
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to bind socket");
   }
 
-  LOG_DEBUG("CAN HW initialized on %s\n", CAN_HW_DEV_INTERFACE);
+  return STATUS_CODE_OK;
+}
+
+// Opens the socket and everything the IO thread waits on
+static StatusCode prv_open(const char *device, bool loopback) {
+  status_ok_or_return(prv_open_socket(device, loopback));
+
+  s_socket_data.epoll_fd = epoll_create1(0);
+  s_socket_data.kick_fd = eventfd(0, EFD_NONBLOCK);
+  s_socket_data.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (s_socket_data.epoll_fd < 0 || s_socket_data.kick_fd < 0 || s_socket_data.timer_fd < 0) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to create IO thread fds");
+  }
+
+  status_ok_or_return(prv_epoll_add(s_socket_data.can_fd));
+  status_ok_or_return(prv_epoll_add(s_socket_data.kick_fd));
+  return prv_epoll_add(s_socket_data.timer_fd);
+}
+
+StatusCode can_hw_init(const CanHwSettings *settings) {
+  if (s_socket_data.can_fd != -1) {
+    prv_deinit();
+  }
+
+  memset(&s_socket_data, 0, sizeof(s_socket_data));
+  s_socket_data.can_fd = -1;
+  s_socket_data.epoll_fd = -1;
+  s_socket_data.kick_fd = -1;
+  s_socket_data.timer_fd = -1;
+  s_socket_data.bitrate = prv_get_bitrate(settings->bitrate);
+  fifo_init(&s_socket_data.rx_fifo, s_socket_data.rx_frames);
+  pthread_mutex_init(&s_socket_data.tx_lock, NULL);
+  pthread_mutex_init(&s_socket_data.filter_lock, NULL);
+
+  // The interface can be picked at runtime, ex. to put simulated boards on separate buses
+  const char *device = getenv(X86_CAN_HW_DEVICE_VAR);
+  if (device == NULL || device[0] == '\0') {
+    device = CAN_HW_DEFAULT_DEVICE;
+  }
 
-  // 3 threads total: main, TX, RX
-  pthread_barrier_init(&s_barrier, NULL, 3);
+  StatusCode ret = prv_open(device, settings->loopback);
+  if (ret != STATUS_CODE_OK) {
+    prv_cleanup();
+    return ret;
+  }
 
-  pthread_create(&s_rx_pthread_id, NULL, prv_rx_thread, NULL);
-  pthread_create(&s_tx_pthread_id, NULL, prv_tx_thread, NULL);
+  LOG_DEBUG("CAN HW initialized on %s\n", device);
 
-  pthread_barrier_wait(&s_barrier);
-  pthread_barrier_destroy(&s_barrier);
+  s_socket_data.init_ns = prv_now_ns();
+  s_socket_data.last_refill_ns = s_socket_data.init_ns;
+  s_socket_data.tx_idle = true;
+  s_exit = false;
+  if (pthread_create(&s_io_pthread_id, NULL, prv_io_thread, NULL) != 0) {
+    prv_cleanup();
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to start IO thread");
+  }
 
   return STATUS_CODE_OK;
 }
@@ -220,7 +467,9 @@ StatusCode can_hw_register_callback(CanHwEvent event, CanHwEventHandlerCb callba
 }
 
 StatusCode can_hw_add_filter(uint32_t mask, uint32_t filter, bool extended) {
-  if (s_socket_data.num_filters >= CAN_HW_MAX_FILTERS) {
+  pthread_mutex_lock(&s_socket_data.filter_lock);
+  if (s_socket_data.num_filters + s_socket_data.num_banks >= CAN_HW_MAX_FILTERS) {
+    pthread_mutex_unlock(&s_socket_data.filter_lock);
     return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "CAN HW: Ran out of filters.");
   }
 
@@ -229,12 +478,24 @@ StatusCode can_hw_add_filter(uint32_t mask, uint32_t filter, bool extended) {
   s_socket_data.filters[s_socket_data.num_filters].can_id = (filter & reg_mask) | ide;
   s_socket_data.filters[s_socket_data.num_filters].can_mask = (mask & reg_mask) | CAN_EFF_FLAG;
   s_socket_data.num_filters++;
+  pthread_mutex_unlock(&s_socket_data.filter_lock);
 
-  if (setsockopt(s_socket_data.can_fd, SOL_CAN_RAW, CAN_RAW_FILTER, s_socket_data.filters,
-                 sizeof(s_socket_data.filters[0]) * s_socket_data.num_filters) < 0) {
-    return status_msg(STATUS_CODE_INTERNAL_ERROR, "CAN HW: Failed to set raw filters");
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_hw_set_filters(const CanFilterBank *banks, size_t num_banks) {
+  if (num_banks > CAN_FILTER_NUM_BANKS || (banks == NULL && num_banks > 0)) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "CAN HW: Too many filter banks.");
   }
 
+  pthread_mutex_lock(&s_socket_data.filter_lock);
+  if (num_banks > 0) {
+    memcpy(s_socket_data.banks, banks, sizeof(banks[0]) * num_banks);
+  }
+  s_socket_data.num_banks = num_banks;
+  s_socket_data.num_filters = 0;
+  pthread_mutex_unlock(&s_socket_data.filter_lock);
+
   return STATUS_CODE_OK;
 }
 
@@ -248,30 +509,44 @@ StatusCode can_hw_transmit(uint32_t id, bool extended, const uint8_t *data, size
   struct can_frame frame = { .can_id = (id & mask) | extended_bit, .can_dlc = len };
   memcpy(&frame.data, data, len);
 
-  StatusCode ret = fifo_push(&s_socket_data.tx_fifo, &frame);
+  StatusCode ret = prv_tx_queue_push(&frame);
   if (ret != STATUS_CODE_OK) {
-    // Fifo is full
+    // Queue is full
+    __atomic_add_fetch(&s_socket_data.stats.tx_dropped, 1, __ATOMIC_RELAXED);
     return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "CAN HW TX failed");
   }
-  // Unblock TX thread
-  sem_post(&s_tx_sem);
+
+  prv_kick_io_thread();
 
   return STATUS_CODE_OK;
 }
 
 // Must be called within the RX handler, returns whether a message was processed
 bool can_hw_receive(uint32_t *id, bool *extended, uint64_t *data, size_t *len) {
-  if (s_socket_data.rx_frame.can_id == 0) {
-    // Assumes that we'll never transmit something with a CAN ID of all 0s
+  struct can_frame frame = { 0 };
+  if (fifo_pop(&s_socket_data.rx_fifo, &frame) != STATUS_CODE_OK) {
     return false;
   }
 
-  *extended = !!(s_socket_data.rx_frame.can_id & CAN_EFF_FLAG);
+  *extended = !!(frame.can_id & CAN_EFF_FLAG);
   uint32_t mask = *extended ? CAN_EFF_MASK : CAN_SFF_MASK;
-  *id = s_socket_data.rx_frame.can_id & mask;
-  memcpy(data, s_socket_data.rx_frame.data, sizeof(*data));
-  *len = s_socket_data.rx_frame.can_dlc;
+  *id = frame.can_id & mask;
+  memcpy(data, frame.data, sizeof(*data));
+  *len = frame.can_dlc;
 
-  memset(&s_socket_data.rx_frame, 0, sizeof(s_socket_data.rx_frame));
   return true;
 }
+
+void x86_can_hw_get_stats(X86CanHwStats *stats) {
+  __atomic_load(&s_socket_data.stats.tx_frames, &stats->tx_frames, __ATOMIC_RELAXED);
+  __atomic_load(&s_socket_data.stats.tx_dropped, &stats->tx_dropped, __ATOMIC_RELAXED);
+  __atomic_load(&s_socket_data.stats.rx_frames, &stats->rx_frames, __ATOMIC_RELAXED);
+  __atomic_load(&s_socket_data.stats.rx_dropped, &stats->rx_dropped, __ATOMIC_RELAXED);
+  __atomic_load(&s_socket_data.stats.rx_filtered, &stats->rx_filtered, __ATOMIC_RELAXED);
+  stats->elapsed_us = (uint32_t)((prv_now_ns() - s_socket_data.init_ns) / 1000);
+}
+
+uint32_t x86_can_hw_max_frame_rate(size_t dlc, bool extended) {
+  struct can_frame frame = { .can_id = extended ? CAN_EFF_FLAG : 0, .can_dlc = dlc };
+  return (uint32_t)(s_socket_data.bitrate / prv_frame_bits(&frame));
+}
@@ -9,7 +9,8 @@
 #include "interrupt_def.h"
 #include "x86_interrupt.h"
 
-static bool s_interrupts_disabled = false;
+// Per thread since threads other than the one taking interrupts use critical sections too
+static __thread bool s_interrupts_disabled = false;
 static pthread_mutex_t s_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
 
 // WARNING: due to skipping the pthread_mutex lock in a signal_handler it is
@@ -24,9 +25,9 @@ bool critical_section_start(void) {
     pthread_mutex_lock(&s_mutex);
   }
   if (!s_interrupts_disabled) {
-    // Update the signal mask to prevent interrupts from being executed on the
-    // signal handler thread. Note that they can still queue like on an embedded
-    // device.
+    // Interrupts that arrive from now on are held until the critical section
+    // ends, like they would stay pending on an embedded device. This doesn't
+    // make a system call, and neither does the mutex unless it is contended.
     x86_interrupt_mask();
     s_interrupts_disabled = true;
     // Interrupts got disabled.
@@ -41,8 +42,7 @@ void critical_section_end(bool disabled_in_scope) {
     pthread_mutex_unlock(&s_mutex);
   }
   if (s_interrupts_disabled && disabled_in_scope) {
-    // Clear the block mask for this process to allow signals to be processed.
-    // (They will queue when disabled).
+    // Runs any interrupts that were held while disabled.
     s_interrupts_disabled = false;
     x86_interrupt_unmask();
   }
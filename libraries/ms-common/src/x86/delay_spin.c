@@ -0,0 +1,57 @@
+#include "delay.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+// Spins on CLOCK_MONOTONIC, which is read from the TSC without a system call. Anything longer than
+// the kernel's sleep overshoot sleeps until that long before the deadline, then spins the rest, so
+// long spins don't hog the CPU but still end on time. The overshoot is measured on first use.
+
+#define DELAY_SPIN_CALIBRATION_RUNS 8
+#define DELAY_SPIN_CALIBRATION_SLEEP_NS 50000
+
+static int64_t s_sleep_overshoot_ns = -1;
+
+static int64_t prv_now_ns(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Sleeps until |deadline_ns| even if interrupts arrive in the meantime
+static void prv_sleep_until(int64_t deadline_ns) {
+  struct timespec deadline = {
+    .tv_sec = deadline_ns / 1000000000,
+    .tv_nsec = deadline_ns % 1000000000,
+  };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+  }
+}
+
+static void prv_calibrate(void) {
+  int64_t overshoot_ns = 0;
+  for (int i = 0; i < DELAY_SPIN_CALIBRATION_RUNS; i++) {
+    int64_t deadline_ns = prv_now_ns() + DELAY_SPIN_CALIBRATION_SLEEP_NS;
+    prv_sleep_until(deadline_ns);
+    int64_t late_ns = prv_now_ns() - deadline_ns;
+    if (late_ns > overshoot_ns) {
+      overshoot_ns = late_ns;
+    }
+  }
+  s_sleep_overshoot_ns = overshoot_ns;
+}
+
+void delay_spin_us(uint32_t t) {
+  if (s_sleep_overshoot_ns < 0) {
+    prv_calibrate();
+  }
+
+  const int64_t deadline_ns = prv_now_ns() + (int64_t)t * 1000;
+  // Only worth a system call if it saves more spinning than the sleep could overshoot by
+  if (deadline_ns - prv_now_ns() > 2 * s_sleep_overshoot_ns) {
+    prv_sleep_until(deadline_ns - s_sleep_overshoot_ns);
+  }
+  while (prv_now_ns() < deadline_ns) {
+  }
+}
@@ -9,6 +9,7 @@
 
 #include "critical_section.h"
 #include "interrupt_def.h"
+#include "log.h"
 #include "status.h"
 #include "x86_interrupt.h"
 
@@ -65,9 +66,7 @@ void soft_timer_init(void) {
   x86_interrupt_register_interrupt(handler_id, &it_settings, &interrupt_id);
 
   // Create the event to trigger on.
-  s_event.sigev_value.sival_int = interrupt_id;
-  s_event.sigev_notify = SIGEV_SIGNAL;
-  s_event.sigev_signo = SIGRTMIN + INTERRUPT_PRIORITY_NORMAL;
+  x86_interrupt_init_sigevent(interrupt_id, &s_event);
 
   // Clear all the statics and reset all the clocks.
   s_active_timers = 0;
@@ -79,6 +78,11 @@ void soft_timer_init(void) {
     timer_create(CLOCK_MONOTONIC, &s_event, &s_posix_timers[i].timer_id);
     s_posix_timers[i].created = true;
   }
+
+#ifdef LOG_TOKENIZED
+  // Timestamp log records from here on
+  log_tokenized_set_clock(soft_timer_now_us);
+#endif
 }
 
 StatusCode soft_timer_start(uint32_t duration_us, SoftTimerCallback callback, void *context,
@@ -144,3 +148,9 @@ uint32_t soft_timer_remaining_time(SoftTimerId timer_id) {
   timer_gettime(s_posix_timers[timer_id].timer_id, &spec);
   return spec.it_value.tv_sec * 1000000 + spec.it_value.tv_nsec / 1000;
 }
+
+uint32_t soft_timer_now_us(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000);
+}
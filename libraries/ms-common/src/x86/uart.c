@@ -1,17 +1,240 @@
 #include "uart.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "critical_section.h"
+#include "interrupt_def.h"
+#include "log.h"
+#include "misc.h"
+#include "uart_rx.h"
+#include "x86_interrupt.h"
+#include "x86_uart.h"
+
+// Each port is a pseudo-terminal with an RX thread standing in for the DMA: it reads whatever has
+// arrived straight into the ring, without waiting for the main loop, then raises the port's
+// interrupt like the idle line interrupt at the end of a burst. The interrupt only wakes the main
+// loop, which splits the lines the same way as on the MCU. TX writes to the pseudo-terminal
+// directly.
+
+#define UART_DEVICE_LEN 64
+
+typedef struct {
+  UartStorage *storage;
+  int master_fd;
+  // Held open so the master never sees a hangup when a client closes the device
+  int slave_fd;
+  int kick_fd;
+  char device[UART_DEVICE_LEN];
+  pthread_t rx_pthread_id;
+  uint8_t interrupt_id;
+  volatile bool exit;
+  // The interrupt was raised but hasn't run yet
+  volatile bool irq_pending;
+} UartPortData;
+
+static UartPortData s_port[NUM_UART_PORTS];
+static uint8_t s_handler_id;
+
+static void prv_handle_irq(uint8_t interrupt_id) {
+  for (UartPort uart = 0; uart < NUM_UART_PORTS; uart++) {
+    if (s_port[uart].storage != NULL && s_port[uart].interrupt_id == interrupt_id) {
+      __atomic_store_n(&s_port[uart].irq_pending, false, __ATOMIC_SEQ_CST);
+      uart_rx_notify(s_port[uart].storage, uart);
+    }
+  }
+}
+
+static void *prv_rx_thread(void *arg) {
+  UartPortData *port = arg;
+  x86_interrupt_pthread_init();
+
+  struct pollfd fds[] = {
+    { .fd = port->master_fd, .events = POLLIN },
+    { .fd = port->kick_fd, .events = POLLIN },
+  };
+  while (!port->exit) {
+    if (poll(fds, SIZEOF_ARRAY(fds), -1) <= 0 || !(fds[0].revents & POLLIN)) {
+      continue;
+    }
+
+    // Only fills up to the end of the ring, like a DMA transfer - the rest is read next time
+    UartStorage *storage = port->storage;
+    uint32_t written = storage->rx_written;
+    size_t offset = written & (UART_RX_RING_LEN - 1);
+    ssize_t len = read(port->master_fd, (uint8_t *)&storage->rx_ring[offset],
+                       UART_RX_RING_LEN - offset);
+    if (len <= 0) {
+      continue;
+    }
+    __atomic_store_n(&storage->rx_written, written + (uint32_t)len, __ATOMIC_SEQ_CST);
+
+    if (!__atomic_exchange_n(&port->irq_pending, true, __ATOMIC_SEQ_CST)) {
+      x86_interrupt_trigger(port->interrupt_id);
+    }
+  }
+
+  return NULL;
+}
+
+static void prv_close(UartPortData *port) {
+  if (port->master_fd >= 0) {
+    close(port->master_fd);
+  }
+  if (port->slave_fd >= 0) {
+    close(port->slave_fd);
+  }
+  if (port->kick_fd >= 0) {
+    close(port->kick_fd);
+  }
+}
+
+static void prv_deinit(UartPortData *port) {
+  port->exit = true;
+  uint64_t kick = 1;
+  if (write(port->kick_fd, &kick, sizeof(kick)) < 0) {
+    LOG_DEBUG("UART: failed to kick RX thread\n");
+  }
+  pthread_join(port->rx_pthread_id, NULL);
+
+  prv_close(port);
+  memset(port, 0, sizeof(*port));
+}
+
+// Opens a raw pseudo-terminal for |port|
+static StatusCode prv_open_pty(UartPortData *port) {
+  port->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  port->slave_fd = -1;
+  port->kick_fd = eventfd(0, EFD_NONBLOCK);
+  if (port->master_fd < 0 || grantpt(port->master_fd) < 0 || unlockpt(port->master_fd) < 0 ||
+      ptsname_r(port->master_fd, port->device, sizeof(port->device)) != 0) {
+    prv_close(port);
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "UART: Failed to open pseudo-terminal");
+  }
+
+  // No echo or line editing, so bytes go through untouched both ways
+  struct termios settings = { 0 };
+  port->slave_fd = open(port->device, O_RDWR | O_NOCTTY);
+  if (port->slave_fd < 0 || tcgetattr(port->slave_fd, &settings) < 0) {
+    prv_close(port);
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "UART: Failed to open pseudo-terminal");
+  }
+  cfmakeraw(&settings);
+  tcsetattr(port->slave_fd, TCSANOW, &settings);
+
+  fcntl(port->master_fd, F_SETFL, O_NONBLOCK);
+  return STATUS_CODE_OK;
+}
+
 StatusCode uart_init(UartPort uart, UartSettings *settings, UartStorage *storage) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+  if (uart >= NUM_UART_PORTS || settings == NULL || storage == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  UartPortData *port = &s_port[uart];
+  if (port->storage != NULL) {
+    prv_deinit(port);
+  }
+
+  memset(storage, 0, sizeof(*storage));
+  storage->rx_handler = settings->rx_handler;
+  storage->context = settings->context;
+  storage->rx_event = settings->rx_event;
+  storage->delimiter = '\n';
+  fifo_init(&storage->tx_fifo, storage->tx_buf);
+
+  InterruptSettings it_settings = {
+    .type = INTERRUPT_TYPE_INTERRUPT,       //
+    .priority = INTERRUPT_PRIORITY_NORMAL,  //
+  };
+  status_ok_or_return(x86_interrupt_register_handler(prv_handle_irq, &s_handler_id));
+  status_ok_or_return(
+      x86_interrupt_register_interrupt(s_handler_id, &it_settings, &port->interrupt_id));
+  status_ok_or_return(prv_open_pty(port));
+
+  port->storage = storage;
+  port->exit = false;
+  pthread_create(&port->rx_pthread_id, NULL, prv_rx_thread, port);
+  LOG_DEBUG("UART %d on %s\n", uart, port->device);
+
+  return STATUS_CODE_OK;
 }
 
 StatusCode uart_set_rx_handler(UartPort uart, UartRxHandler rx_handler, void *context) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+  if (uart >= NUM_UART_PORTS || s_port[uart].storage == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  bool disabled = critical_section_start();
+  s_port[uart].storage->rx_handler = rx_handler;
+  s_port[uart].storage->context = context;
+  critical_section_end(disabled);
+
+  return STATUS_CODE_OK;
 }
 
 StatusCode uart_set_delimiter(UartPort uart, uint8_t delimiter) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+  if (uart >= NUM_UART_PORTS || s_port[uart].storage == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  s_port[uart].storage->delimiter = (char)delimiter;
+
+  return STATUS_CODE_OK;
 }
 
 StatusCode uart_tx(UartPort uart, uint8_t *tx_data, size_t len) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+  if (uart >= NUM_UART_PORTS || s_port[uart].storage == NULL) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  ssize_t written = write(s_port[uart].master_fd, tx_data, len);
+  if (written < 0 || (size_t)written != len) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "UART: TX buffer full");
+  }
+
+  return STATUS_CODE_OK;
+}
+
+bool uart_process_event(const Event *e) {
+  for (UartPort uart = 0; uart < NUM_UART_PORTS; uart++) {
+    if (s_port[uart].storage != NULL) {
+      uart_rx_retry(s_port[uart].storage);
+    }
+  }
+
+  if (e->data >= NUM_UART_PORTS || s_port[e->data].storage == NULL ||
+      s_port[e->data].storage->rx_event != e->id) {
+    return false;
+  }
+
+  uart_rx_process(s_port[e->data].storage);
+  return true;
+}
+
+StatusCode uart_get_stats(UartPort uart, UartStats *stats) {
+  if (uart >= NUM_UART_PORTS || s_port[uart].storage == NULL || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  bool disabled = critical_section_start();
+  *stats = s_port[uart].storage->stats;
+  critical_section_end(disabled);
+
+  return STATUS_CODE_OK;
+}
+
+const char *x86_uart_get_device(UartPort uart) {
+  if (uart >= NUM_UART_PORTS || s_port[uart].storage == NULL) {
+    return NULL;
+  }
+  return s_port[uart].device;
 }
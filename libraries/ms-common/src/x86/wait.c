@@ -1,10 +1,7 @@
 #include "wait.h"
 
-#include <signal.h>
+#include "x86_interrupt.h"
 
 void wait(void) {
-  sigset_t s_wait_sigset;
-
-  sigemptyset(&s_wait_sigset);
-  sigsuspend(&s_wait_sigset);
+  x86_interrupt_wait();
 }
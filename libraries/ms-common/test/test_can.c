@@ -188,6 +188,35 @@ void test_can_ack(void) {
   TEST_ASSERT_EQUAL(TEST_CAN_DEVICE_ID, device_acked);
 }
 
+void test_can_ack_filters_deferred(void) {
+  // Outlives the test in case the requests expire before the next one resets the timers
+  static volatile CanAckStatus ack_status = NUM_CAN_ACK_STATUSES;
+  CanMessage msg = {
+    .msg_id = 0x1,              //
+    .type = CAN_MSG_TYPE_DATA,  //
+    .dlc = 0,                   //
+  };
+  CanAckRequest ack_req = {
+    .callback = prv_ack_callback_status,                              //
+    .context = (void *)&ack_status,                                   //
+    .expected_bitset = CAN_ACK_EXPECTED_DEVICES(TEST_CAN_DEVICE_ID),  //
+  };
+
+  // Waiting on an ACK only marks the filters, since this could be an interrupt
+  TEST_ASSERT_OK(can_transmit(&msg, &ack_req));
+  TEST_ASSERT_TRUE(s_can_storage.ack_filter_ids & ((uint64_t)1 << msg.msg_id));
+  TEST_ASSERT_TRUE(s_can_storage.ack_filters_stale);
+
+  // They're rebuilt before the message goes out
+  prv_clock_tx();
+  TEST_ASSERT_FALSE(s_can_storage.ack_filters_stale);
+
+  // Only once per message ID
+  TEST_ASSERT_OK(can_transmit(&msg, &ack_req));
+  TEST_ASSERT_FALSE(s_can_storage.ack_filters_stale);
+  prv_clock_tx();
+}
+
 void test_can_ack_expire(void) {
   volatile CanAckStatus ack_status = NUM_CAN_ACK_STATUSES;
   CanMessage msg = {
@@ -0,0 +1,194 @@
+#include "can_filter.h"
+
+#include "can.h"
+#include "event_queue.h"
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TEST_CAN_DEVICE_ID 0x1
+#define TEST_CAN_OTHER_DEVICE_ID 0x2
+#define TEST_CAN_HANDLED_MSG_ID 0x15
+#define TEST_CAN_UNHANDLED_MSG_ID 0x16
+#define TEST_CAN_NUM_MSGS 5
+#define TEST_CAN_TIMEOUT_MS 100
+
+// Any source
+#define TEST_FILTER_MSG_MASK 0x7F0
+
+typedef enum {
+  TEST_CAN_EVENT_RX = 10,
+  TEST_CAN_EVENT_TX,
+  TEST_CAN_EVENT_FAULT,
+} TestCanEvent;
+
+static CanFilter s_patterns[CAN_FILTER_MAX_PATTERNS];
+static size_t s_num_patterns;
+static CanFilterBank s_banks[CAN_FILTER_NUM_BANKS];
+static size_t s_num_banks;
+
+static CanStorage s_can_storage;
+static volatile uint32_t s_rx_count;
+
+static StatusCode prv_rx_callback(const CanMessage *msg, void *context, CanAckStatus *ack_reply) {
+  s_rx_count++;
+  return STATUS_CODE_OK;
+}
+
+static void prv_add_pattern(uint16_t id, uint16_t mask) {
+  s_patterns[s_num_patterns++] = (CanFilter){ .id = id, .mask = mask };
+}
+
+static bool prv_wanted(uint16_t id) {
+  for (size_t i = 0; i < s_num_patterns; i++) {
+    if ((id & s_patterns[i].mask) == (s_patterns[i].id & s_patterns[i].mask)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// No two message IDs with an even number of bits set differ in a single bit
+static bool prv_even_parity(uint16_t msg_id) {
+  return __builtin_popcount(msg_id) % 2 == 0;
+}
+
+// Builds the banks and checks every standard ID against them. Returns how many were accepted
+// without being wanted.
+static size_t prv_build_and_check(void) {
+  TEST_ASSERT_OK(can_filter_build(s_patterns, s_num_patterns, s_banks, CAN_FILTER_NUM_BANKS,
+                                  &s_num_banks));
+  TEST_ASSERT_TRUE(s_num_banks <= CAN_FILTER_NUM_BANKS);
+
+  size_t extra = 0;
+  for (uint16_t id = 0; id <= CAN_FILTER_STANDARD_ID_MASK; id++) {
+    bool accepted = can_filter_match(s_banks, s_num_banks, id);
+    if (prv_wanted(id)) {
+      TEST_ASSERT_TRUE(accepted);
+    } else if (accepted) {
+      extra++;
+    }
+  }
+  return extra;
+}
+
+void setup_test(void) {
+  event_queue_init();
+  interrupt_init();
+  soft_timer_init();
+
+  s_num_patterns = 0;
+  s_num_banks = 0;
+  s_rx_count = 0;
+}
+
+void teardown_test(void) {}
+
+void test_can_filter_empty(void) {
+  TEST_ASSERT_OK(can_filter_build(NULL, 0, s_banks, CAN_FILTER_NUM_BANKS, &s_num_banks));
+  TEST_ASSERT_EQUAL(0, s_num_banks);
+  TEST_ASSERT_TRUE(can_filter_match(s_banks, 0, 0x123));
+
+  prv_add_pattern(0x10, TEST_FILTER_MSG_MASK);
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED,
+                    can_filter_build(s_patterns, s_num_patterns, s_banks, 0, &s_num_banks));
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
+                    can_filter_build(s_patterns, CAN_FILTER_MAX_PATTERNS + 1, s_banks,
+                                     CAN_FILTER_NUM_BANKS, &s_num_banks));
+}
+
+void test_can_filter_exact_ids(void) {
+  // Four exact IDs fit in one list bank
+  prv_add_pattern(0x123, CAN_FILTER_STANDARD_ID_MASK);
+  prv_add_pattern(0x456, CAN_FILTER_STANDARD_ID_MASK);
+  prv_add_pattern(0x001, CAN_FILTER_STANDARD_ID_MASK);
+  prv_add_pattern(0x7FF, CAN_FILTER_STANDARD_ID_MASK);
+  TEST_ASSERT_EQUAL(0, prv_build_and_check());
+  TEST_ASSERT_EQUAL(1, s_num_banks);
+  TEST_ASSERT_EQUAL(CAN_FILTER_BANK_MODE_LIST, s_banks[0].mode);
+
+  // A fifth goes in a mask slot, and a duplicate changes nothing
+  prv_add_pattern(0x300, CAN_FILTER_STANDARD_ID_MASK);
+  prv_add_pattern(0x123, CAN_FILTER_STANDARD_ID_MASK);
+  TEST_ASSERT_EQUAL(0, prv_build_and_check());
+  TEST_ASSERT_EQUAL(2, s_num_banks);
+}
+
+void test_can_filter_merges_exactly(void) {
+  // Sixteen consecutive message IDs from any source are a single pattern
+  for (uint16_t msg_id = 16; msg_id < 32; msg_id++) {
+    prv_add_pattern((uint16_t)(msg_id << 5), TEST_FILTER_MSG_MASK);
+  }
+  TEST_ASSERT_EQUAL(0, prv_build_and_check());
+  TEST_ASSERT_EQUAL(1, s_num_banks);
+  TEST_ASSERT_EQUAL(CAN_FILTER_BANK_MODE_MASK, s_banks[0].mode);
+}
+
+void test_can_filter_fits_two_per_bank(void) {
+  for (uint16_t msg_id = 0; s_num_patterns < 2 * CAN_FILTER_NUM_BANKS; msg_id++) {
+    if (prv_even_parity(msg_id)) {
+      prv_add_pattern((uint16_t)(msg_id << 5), TEST_FILTER_MSG_MASK);
+    }
+  }
+  TEST_ASSERT_EQUAL(0, prv_build_and_check());
+  TEST_ASSERT_EQUAL(CAN_FILTER_NUM_BANKS, s_num_banks);
+}
+
+void test_can_filter_overflow(void) {
+  for (uint16_t msg_id = 0; msg_id < CAN_MSG_MAX_IDS; msg_id++) {
+    if (prv_even_parity(msg_id)) {
+      prv_add_pattern((uint16_t)(msg_id << 5), TEST_FILTER_MSG_MASK);
+    }
+  }
+  size_t extra = prv_build_and_check();
+  LOG_DEBUG("%u patterns in %u banks, accepting %u extra IDs\n", (unsigned)s_num_patterns,
+            (unsigned)s_num_banks, (unsigned)extra);
+
+  // Still much better than accepting everything
+  size_t wanted = s_num_patterns * 16;
+  TEST_ASSERT_EQUAL(CAN_FILTER_NUM_BANKS, s_num_banks);
+  TEST_ASSERT_TRUE(extra > 0);
+  TEST_ASSERT_TRUE(extra < (CAN_FILTER_STANDARD_ID_MASK + 1 - wanted) / 2);
+}
+
+void test_can_filter_handlers(void) {
+  CanSettings can_settings = {
+    .device_id = TEST_CAN_DEVICE_ID,
+    .bitrate = CAN_HW_BITRATE_500KBPS,
+    .rx_event = TEST_CAN_EVENT_RX,
+    .tx_event = TEST_CAN_EVENT_TX,
+    .fault_event = TEST_CAN_EVENT_FAULT,
+    .tx = { GPIO_PORT_A, 12 },
+    .rx = { GPIO_PORT_A, 11 },
+    .loopback = true,
+  };
+  TEST_ASSERT_OK(can_init(&s_can_storage, &can_settings));
+  TEST_ASSERT_OK(can_register_rx_handler(TEST_CAN_HANDLED_MSG_ID, prv_rx_callback, NULL));
+
+  // Our own frames all come back in loopback, so pretend to be another node
+  CanId handled = { .source_id = TEST_CAN_OTHER_DEVICE_ID, .msg_id = TEST_CAN_HANDLED_MSG_ID };
+  CanId unhandled = { .source_id = TEST_CAN_OTHER_DEVICE_ID, .msg_id = TEST_CAN_UNHANDLED_MSG_ID };
+  uint8_t data = 0;
+  for (size_t i = 0; i < TEST_CAN_NUM_MSGS; i++) {
+    TEST_ASSERT_OK(can_hw_transmit(unhandled.raw, false, &data, sizeof(data)));
+    TEST_ASSERT_OK(can_hw_transmit(handled.raw, false, &data, sizeof(data)));
+  }
+
+  uint32_t start_us = soft_timer_now_us();
+  while (soft_timer_now_us() - start_us < TEST_CAN_TIMEOUT_MS * 1000) {
+    Event e = { 0 };
+    if (event_process(&e) == STATUS_CODE_OK) {
+      can_process_event(&e);
+    }
+  }
+
+  // The unhandled frames never made it out of the hardware
+  CanStatsCounters counters = { 0 };
+  TEST_ASSERT_EQUAL(TEST_CAN_NUM_MSGS, s_rx_count);
+  TEST_ASSERT_OK(can_get_stats(TEST_CAN_HANDLED_MSG_ID, &counters));
+  TEST_ASSERT_EQUAL(TEST_CAN_NUM_MSGS, counters.counts[CAN_STATS_COUNTER_RX]);
+  TEST_ASSERT_OK(can_get_stats(TEST_CAN_UNHANDLED_MSG_ID, &counters));
+  TEST_ASSERT_EQUAL(0, counters.counts[CAN_STATS_COUNTER_RX]);
+}
@@ -0,0 +1,289 @@
+#include "can_queue.h"
+
+#include "can.h"
+#include "event_queue.h"
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TEST_CAN_DEVICE_ID 0x1
+#define TEST_CAN_CRITICAL_MSG_ID 0x1
+#define TEST_CAN_TELEMETRY_MSG_ID 0x28
+#define TEST_CAN_BACKGROUND_MSG_ID 0x30
+// Different IDs from the latency test, whose last frames may still be on the bus
+#define TEST_CAN_TIMER_CRITICAL_MSG_ID 0x2
+#define TEST_CAN_TIMER_TELEMETRY_MSG_ID 0x29
+#define TEST_CAN_CRITICAL_PERIOD_US 10000
+#define TEST_CAN_DURATION_US 300000
+#define TEST_CAN_TIMER_PERIOD_US 500
+#define TEST_CAN_TIMER_RUNS 1000
+#define TEST_CAN_TIMER_BACKLOG 4
+#define TEST_CAN_DRAIN_US 500000
+
+typedef enum {
+  TEST_CAN_EVENT_RX = 10,
+  TEST_CAN_EVENT_TX,
+  TEST_CAN_EVENT_FAULT,
+} TestCanEvent;
+
+static CanQueue s_queue;
+static CanStorage s_can_storage;
+
+static volatile uint32_t s_critical_tx_us;
+static volatile uint32_t s_critical_rx;
+static volatile uint32_t s_worst_latency_us;
+
+// Each message carries the next number in its sequence
+typedef struct TestCanSequence {
+  volatile uint64_t next;
+  volatile uint32_t errors;
+} TestCanSequence;
+
+static TestCanSequence s_critical_seq;
+static TestCanSequence s_telemetry_seq;
+static volatile uint64_t s_critical_pushed;
+static volatile uint32_t s_timer_runs;
+
+static StatusCode prv_critical_callback(const CanMessage *msg, void *context,
+                                        CanAckStatus *ack_reply) {
+  // Telemetry sharing the ID is longer
+  if (msg->dlc != 1) {
+    return STATUS_CODE_OK;
+  }
+  uint32_t latency_us = soft_timer_now_us() - s_critical_tx_us;
+  if (latency_us > s_worst_latency_us) {
+    s_worst_latency_us = latency_us;
+  }
+  s_critical_rx++;
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_sequence_callback(const CanMessage *msg, void *context,
+                                        CanAckStatus *ack_reply) {
+  TestCanSequence *seq = context;
+  if (msg->data != seq->next) {
+    seq->errors++;
+  }
+  seq->next = msg->data + 1;
+  return STATUS_CODE_OK;
+}
+
+static void prv_timer_push(SoftTimerId timer_id, void *context) {
+  CanMessage critical = {
+    .msg_id = TEST_CAN_TIMER_CRITICAL_MSG_ID,  //
+    .type = CAN_MSG_TYPE_DATA,                 //
+    .data = s_critical_pushed,                 //
+    .dlc = 2,                                  //
+  };
+  if (status_ok(can_transmit(&critical, NULL))) {
+    s_critical_pushed++;
+  }
+
+  if (++s_timer_runs < TEST_CAN_TIMER_RUNS) {
+    soft_timer_start(TEST_CAN_TIMER_PERIOD_US, prv_timer_push, NULL, NULL);
+  }
+}
+
+static void prv_push(CanMessageId msg_id, uint64_t data) {
+  CanMessage msg = {
+    .msg_id = msg_id,           //
+    .type = CAN_MSG_TYPE_DATA,  //
+    .data = data,               //
+    .dlc = 8,                   //
+  };
+  TEST_ASSERT_OK(can_queue_push(&s_queue, &msg));
+}
+
+// Keeps the TX queue full of telemetry and sends |critical_msg_id| every period, waiting for each
+// one to come back before the next. Returns the worst time from the first attempt to send it, which
+// includes waiting for room in the queue, to the RX handler.
+static uint32_t prv_worst_latency_us(CanMessageId critical_msg_id) {
+  TEST_ASSERT_OK(can_register_rx_handler(critical_msg_id, prv_critical_callback, NULL));
+  s_critical_rx = 0;
+  s_worst_latency_us = 0;
+
+  CanMessage telemetry = {
+    .msg_id = TEST_CAN_TELEMETRY_MSG_ID,  //
+    .type = CAN_MSG_TYPE_DATA,            //
+    .data = 0x1122334455667788,           //
+    .dlc = 8,                             //
+  };
+  CanMessage critical = {
+    .msg_id = critical_msg_id,  //
+    .type = CAN_MSG_TYPE_DATA,  //
+    .dlc = 1,                   //
+  };
+
+  uint32_t num_sent = 0;
+  bool pending = false;
+  uint32_t start_us = soft_timer_now_us();
+  uint32_t next_critical_us = start_us + TEST_CAN_CRITICAL_PERIOD_US;
+  while (soft_timer_now_us() - start_us < TEST_CAN_DURATION_US) {
+    uint32_t now_us = soft_timer_now_us();
+    if (!pending && (int32_t)(now_us - next_critical_us) >= 0 && s_critical_rx == num_sent) {
+      s_critical_tx_us = now_us;
+      next_critical_us = now_us + TEST_CAN_CRITICAL_PERIOD_US;
+      pending = true;
+    }
+    if (pending && status_ok(can_transmit(&critical, NULL))) {
+      num_sent++;
+      pending = false;
+    }
+
+    // Drops are expected - the point is to keep the queue full
+    can_transmit(&telemetry, NULL);
+
+    Event e = { 0 };
+    while (event_process(&e) == STATUS_CODE_OK) {
+      can_process_event(&e);
+    }
+  }
+
+  TEST_ASSERT_TRUE(s_critical_rx > 0);
+  return s_worst_latency_us;
+}
+
+static void prv_init_can(void) {
+  CanSettings can_settings = {
+    .device_id = TEST_CAN_DEVICE_ID,
+    .bitrate = CAN_HW_BITRATE_500KBPS,
+    .rx_event = TEST_CAN_EVENT_RX,
+    .tx_event = TEST_CAN_EVENT_TX,
+    .fault_event = TEST_CAN_EVENT_FAULT,
+    .tx = { GPIO_PORT_A, 12 },
+    .rx = { GPIO_PORT_A, 11 },
+    .loopback = true,
+  };
+  TEST_ASSERT_OK(can_init(&s_can_storage, &can_settings));
+}
+
+void setup_test(void) {
+  event_queue_init();
+  interrupt_init();
+  soft_timer_init();
+
+  TEST_ASSERT_OK(can_queue_init(&s_queue));
+}
+
+void teardown_test(void) {}
+
+void test_can_queue_order(void) {
+  prv_push(TEST_CAN_BACKGROUND_MSG_ID, 0);
+  prv_push(TEST_CAN_TELEMETRY_MSG_ID, 0);
+  prv_push(TEST_CAN_BACKGROUND_MSG_ID, 1);
+  prv_push(TEST_CAN_CRITICAL_MSG_ID, 0);
+  prv_push(TEST_CAN_TELEMETRY_MSG_ID, 1);
+  prv_push(TEST_CAN_BACKGROUND_MSG_ID, 2);
+  TEST_ASSERT_EQUAL(6, can_queue_size(&s_queue));
+
+  // Lowest ID first, and pushed order within an ID
+  const struct {
+    CanMessageId msg_id;
+    uint64_t data;
+  } expected[] = {
+    { TEST_CAN_CRITICAL_MSG_ID, 0 },   { TEST_CAN_TELEMETRY_MSG_ID, 0 },
+    { TEST_CAN_TELEMETRY_MSG_ID, 1 },  { TEST_CAN_BACKGROUND_MSG_ID, 0 },
+    { TEST_CAN_BACKGROUND_MSG_ID, 1 }, { TEST_CAN_BACKGROUND_MSG_ID, 2 },
+  };
+  for (size_t i = 0; i < SIZEOF_ARRAY(expected); i++) {
+    CanMessage msg = { 0 };
+    TEST_ASSERT_OK(can_queue_peek(&s_queue, &msg));
+    TEST_ASSERT_EQUAL(expected[i].msg_id, msg.msg_id);
+    TEST_ASSERT_OK(can_queue_pop(&s_queue, &msg));
+    TEST_ASSERT_EQUAL(expected[i].msg_id, msg.msg_id);
+    TEST_ASSERT_EQUAL(expected[i].data, msg.data);
+  }
+  TEST_ASSERT_EQUAL(0, can_queue_size(&s_queue));
+  TEST_ASSERT_NOT_OK(can_queue_pop(&s_queue, NULL));
+}
+
+void test_can_queue_full(void) {
+  for (size_t i = 0; i < CAN_QUEUE_SIZE; i++) {
+    prv_push(TEST_CAN_TELEMETRY_MSG_ID, i);
+  }
+  CanMessage msg = { .msg_id = TEST_CAN_CRITICAL_MSG_ID };
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, can_queue_push(&s_queue, &msg));
+
+  // Same ID, so still in order
+  for (size_t i = 0; i < CAN_QUEUE_SIZE; i++) {
+    TEST_ASSERT_OK(can_queue_pop(&s_queue, &msg));
+    TEST_ASSERT_EQUAL(i, msg.data);
+  }
+}
+
+// Compares a critical message against one that has to wait its turn behind the telemetry
+void test_can_queue_worst_case_latency(void) {
+  prv_init_can();
+
+  uint32_t critical_us = prv_worst_latency_us(TEST_CAN_CRITICAL_MSG_ID);
+  uint32_t telemetry_us = prv_worst_latency_us(TEST_CAN_TELEMETRY_MSG_ID);
+  LOG_DEBUG("Worst case latency under load: %lu us for a critical message, %lu us behind the "
+            "telemetry\n",
+            (unsigned long)critical_us, (unsigned long)telemetry_us);
+
+  // A frame with 8 bytes takes about 220 us at 500 kbps, so waiting behind full TX queues in the
+  // network layer and the hardware takes about 14 ms. Leave plenty of room for scheduling jitter.
+  TEST_ASSERT_TRUE(critical_us * 2 < telemetry_us);
+}
+
+// A timer queues critical messages while the main loop drains telemetry. Whenever one lands ahead
+// of the telemetry being sent, each message must still go out exactly once.
+void test_can_queue_timer_push(void) {
+  prv_init_can();
+  s_critical_seq = (TestCanSequence){ 0 };
+  s_telemetry_seq = (TestCanSequence){ 0 };
+  s_critical_pushed = 0;
+  s_timer_runs = 0;
+  TEST_ASSERT_OK(can_register_rx_handler(TEST_CAN_TIMER_CRITICAL_MSG_ID, prv_sequence_callback,
+                                         &s_critical_seq));
+  TEST_ASSERT_OK(can_register_rx_handler(TEST_CAN_TIMER_TELEMETRY_MSG_ID, prv_sequence_callback,
+                                         &s_telemetry_seq));
+
+  CanMessage telemetry = {
+    .msg_id = TEST_CAN_TIMER_TELEMETRY_MSG_ID,  //
+    .type = CAN_MSG_TYPE_DATA,                  //
+    .dlc = 8,                                   //
+  };
+  uint64_t telemetry_pushed = 0;
+  TEST_ASSERT_OK(soft_timer_start(TEST_CAN_TIMER_PERIOD_US, prv_timer_push, NULL, NULL));
+  uint32_t drain_start_us = 0;
+  while (s_critical_seq.next != s_critical_pushed || s_telemetry_seq.next != telemetry_pushed ||
+         s_timer_runs < TEST_CAN_TIMER_RUNS) {
+    if (s_timer_runs < TEST_CAN_TIMER_RUNS) {
+      drain_start_us = soft_timer_now_us();
+      if (can_queue_size(&s_can_storage.tx_queue) < TEST_CAN_TIMER_BACKLOG) {
+        telemetry.data = telemetry_pushed;
+        if (status_ok(can_transmit(&telemetry, NULL))) {
+          telemetry_pushed++;
+        }
+      }
+    } else if (soft_timer_now_us() - drain_start_us > TEST_CAN_DRAIN_US) {
+      break;
+    }
+
+    // Events are dropped when the event queue is full, and TX ready doesn't raise TX events on
+    // x86, so raise them again for anything left behind
+    Event e = { 0 };
+    bool idle = true;
+    while (event_process(&e) == STATUS_CODE_OK) {
+      can_process_event(&e);
+      idle = false;
+    }
+    if (idle && can_queue_size(&s_can_storage.tx_queue) > 0) {
+      event_raise(TEST_CAN_EVENT_TX, 0);
+    }
+    if (idle && can_fifo_size(&s_can_storage.rx_fifo) > 0) {
+      event_raise(TEST_CAN_EVENT_RX, 0);
+    }
+  }
+
+  LOG_DEBUG("%lu critical and %lu telemetry messages\n", (unsigned long)s_critical_pushed,
+            (unsigned long)telemetry_pushed);
+  TEST_ASSERT_TRUE(s_critical_pushed > 0);
+  TEST_ASSERT_EQUAL(0, s_critical_seq.errors);
+  TEST_ASSERT_EQUAL(0, s_telemetry_seq.errors);
+  TEST_ASSERT_EQUAL(s_critical_pushed, s_critical_seq.next);
+  TEST_ASSERT_EQUAL(telemetry_pushed, s_telemetry_seq.next);
+}
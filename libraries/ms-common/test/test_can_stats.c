@@ -0,0 +1,200 @@
+#include "can_stats.h"
+
+#include "can.h"
+#include "delay.h"
+#include "event_queue.h"
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TEST_CAN_DEVICE_ID 0x1
+#define TEST_CAN_LONG_MSG_ID 0x20
+#define TEST_CAN_SHORT_MSG_ID 0x21
+#define TEST_CAN_DIAG_MSG_ID 0x3F
+#define TEST_CAN_NUM_LONG 10
+#define TEST_CAN_NUM_SHORT 5
+#define TEST_CAN_OVERFLOW 8
+#define TEST_CAN_PUBLISH_PERIOD_MS 10
+#define TEST_CAN_TIMEOUT_MS 500
+
+#define TEST_LOAD_FRAMES 1000
+
+typedef enum {
+  TEST_CAN_EVENT_RX = 10,
+  TEST_CAN_EVENT_TX,
+  TEST_CAN_EVENT_FAULT,
+} TestCanEvent;
+
+static CanStorage s_can_storage;
+
+static volatile uint32_t s_diag_count;
+static volatile CanMessage s_diag_msg;
+
+static StatusCode prv_diag_callback(const CanMessage *msg, void *context, CanAckStatus *ack_reply) {
+  s_diag_msg = *msg;
+  s_diag_count++;
+  return STATUS_CODE_OK;
+}
+
+// Runs the CAN FSM until |num_rx| frames of |msg_id| have come back, or it times out
+static void prv_process_until_rx(CanMessageId msg_id, uint16_t num_rx) {
+  CanStatsCounters counters = { 0 };
+  uint32_t start_us = soft_timer_now_us();
+  do {
+    Event e = { 0 };
+    if (event_process(&e) == STATUS_CODE_OK) {
+      can_process_event(&e);
+    }
+    TEST_ASSERT_OK(can_get_stats(msg_id, &counters));
+  } while (counters.counts[CAN_STATS_COUNTER_RX] < num_rx &&
+           soft_timer_now_us() - start_us < TEST_CAN_TIMEOUT_MS * 1000);
+}
+
+static void prv_transmit(CanMessageId msg_id, size_t dlc, size_t num_msgs) {
+  CanMessage msg = {
+    .msg_id = msg_id,            //
+    .type = CAN_MSG_TYPE_DATA,   //
+    .data = 0x1122334455667788,  //
+    .dlc = dlc,                  //
+  };
+  for (size_t i = 0; i < num_msgs; i++) {
+    TEST_ASSERT_OK(can_transmit(&msg, NULL));
+    Event e = { 0 };
+    TEST_ASSERT_OK(event_process(&e));
+    TEST_ASSERT_TRUE(can_process_event(&e));
+  }
+}
+
+void setup_test(void) {
+  event_queue_init();
+  interrupt_init();
+  soft_timer_init();
+
+  CanSettings can_settings = {
+    .device_id = TEST_CAN_DEVICE_ID,
+    .bitrate = CAN_HW_BITRATE_500KBPS,
+    .rx_event = TEST_CAN_EVENT_RX,
+    .tx_event = TEST_CAN_EVENT_TX,
+    .fault_event = TEST_CAN_EVENT_FAULT,
+    .tx = { GPIO_PORT_A, 12 },
+    .rx = { GPIO_PORT_A, 11 },
+    .loopback = true,
+  };
+  TEST_ASSERT_OK(can_init(&s_can_storage, &can_settings));
+  s_diag_count = 0;
+}
+
+void teardown_test(void) {
+  can_publish_stats(TEST_CAN_DIAG_MSG_ID, 0);
+}
+
+void test_can_stats_traffic_pattern(void) {
+  prv_transmit(TEST_CAN_LONG_MSG_ID, 8, TEST_CAN_NUM_LONG);
+  prv_transmit(TEST_CAN_SHORT_MSG_ID, 2, TEST_CAN_NUM_SHORT);
+  prv_process_until_rx(TEST_CAN_LONG_MSG_ID, TEST_CAN_NUM_LONG);
+  prv_process_until_rx(TEST_CAN_SHORT_MSG_ID, TEST_CAN_NUM_SHORT);
+
+  CanStatsCounters counters = { 0 };
+  TEST_ASSERT_OK(can_get_stats(TEST_CAN_LONG_MSG_ID, &counters));
+  TEST_ASSERT_EQUAL(TEST_CAN_NUM_LONG, counters.counts[CAN_STATS_COUNTER_TX]);
+  TEST_ASSERT_EQUAL(TEST_CAN_NUM_LONG, counters.counts[CAN_STATS_COUNTER_RX]);
+  TEST_ASSERT_EQUAL(0, counters.counts[CAN_STATS_COUNTER_TX_DROPPED]);
+  TEST_ASSERT_EQUAL(0, counters.counts[CAN_STATS_COUNTER_RX_DROPPED]);
+  TEST_ASSERT_EQUAL(0, counters.counts[CAN_STATS_COUNTER_TX_FAILED]);
+
+  TEST_ASSERT_OK(can_get_stats(TEST_CAN_SHORT_MSG_ID, &counters));
+  TEST_ASSERT_EQUAL(TEST_CAN_NUM_SHORT, counters.counts[CAN_STATS_COUNTER_TX]);
+  TEST_ASSERT_EQUAL(TEST_CAN_NUM_SHORT, counters.counts[CAN_STATS_COUNTER_RX]);
+
+  TEST_ASSERT_OK(can_get_stats(TEST_CAN_DIAG_MSG_ID, &counters));
+  TEST_ASSERT_EQUAL(0, counters.counts[CAN_STATS_COUNTER_TX]);
+  TEST_ASSERT_EQUAL(0, counters.counts[CAN_STATS_COUNTER_RX]);
+
+  // Our own frames coming back in loopback aren't counted twice
+  TEST_ASSERT_EQUAL(TEST_CAN_NUM_LONG * (CAN_STATS_STANDARD_FRAME_BITS + 8 * 8) +
+                        TEST_CAN_NUM_SHORT * (CAN_STATS_STANDARD_FRAME_BITS + 2 * 8),
+                    s_can_storage.stats.tx_bits);
+  TEST_ASSERT_EQUAL(0, s_can_storage.stats.rx_bits);
+
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, can_get_stats(CAN_MSG_MAX_IDS, &counters));
+}
+
+void test_can_stats_tx_dropped(void) {
+  // Nothing is sent until the FSM runs, so the TX queue fills up
+  CanMessage msg = {
+    .msg_id = TEST_CAN_LONG_MSG_ID,  //
+    .type = CAN_MSG_TYPE_DATA,       //
+    .dlc = 1,                        //
+  };
+  for (size_t i = 0; i < CAN_QUEUE_SIZE; i++) {
+    TEST_ASSERT_OK(can_transmit(&msg, NULL));
+  }
+  for (size_t i = 0; i < TEST_CAN_OVERFLOW; i++) {
+    TEST_ASSERT_NOT_OK(can_transmit(&msg, NULL));
+  }
+
+  CanStatsCounters counters = { 0 };
+  TEST_ASSERT_OK(can_get_stats(TEST_CAN_LONG_MSG_ID, &counters));
+  TEST_ASSERT_EQUAL(TEST_CAN_OVERFLOW, counters.counts[CAN_STATS_COUNTER_TX_DROPPED]);
+  TEST_ASSERT_EQUAL(0, counters.counts[CAN_STATS_COUNTER_TX]);
+}
+
+void test_can_stats_bus_load(void) {
+  CanStats stats;
+  TEST_ASSERT_OK(can_stats_init(&stats, CAN_HW_BITRATE_500KBPS));
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, can_stats_init(&stats, NUM_CAN_HW_BITRATES));
+
+  for (size_t i = 0; i < TEST_LOAD_FRAMES; i++) {
+    can_stats_add_frame(&stats, i % 2 == 0, false, 8);
+  }
+  // Nothing until the first window is over
+  TEST_ASSERT_EQUAL(0, can_stats_get_bus_load(&stats));
+
+  delay_ms(CAN_STATS_WINDOW_MS);
+  uint32_t bits = TEST_LOAD_FRAMES * (CAN_STATS_STANDARD_FRAME_BITS + 8 * 8);
+  uint16_t expected = (uint16_t)(bits * 1000 / 500000);
+  uint16_t load = can_stats_get_bus_load(&stats);
+  LOG_DEBUG("%lu bits over a window: %u permille, %u expected\n", (unsigned long)bits, load,
+            expected);
+  TEST_ASSERT_TRUE(load <= expected);
+  TEST_ASSERT_TRUE(load >= expected * 9 / 10);
+
+  // The next window starts empty
+  delay_ms(CAN_STATS_WINDOW_MS);
+  TEST_ASSERT_EQUAL(0, can_stats_get_bus_load(&stats));
+}
+
+void test_can_stats_publish(void) {
+  TEST_ASSERT_OK(can_register_rx_handler(TEST_CAN_DIAG_MSG_ID, prv_diag_callback, NULL));
+  prv_transmit(TEST_CAN_LONG_MSG_ID, 8, 3);
+  prv_process_until_rx(TEST_CAN_LONG_MSG_ID, 3);
+
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, can_publish_stats(CAN_MSG_MAX_IDS, 1));
+  TEST_ASSERT_OK(can_publish_stats(TEST_CAN_DIAG_MSG_ID, TEST_CAN_PUBLISH_PERIOD_MS));
+  uint32_t start_us = soft_timer_now_us();
+  while (s_diag_count == 0 && soft_timer_now_us() - start_us < TEST_CAN_TIMEOUT_MS * 1000) {
+    Event e = { 0 };
+    if (event_process(&e) == STATUS_CODE_OK) {
+      can_process_event(&e);
+    }
+  }
+
+  // The first report is for the only ID with traffic so far
+  TEST_ASSERT_EQUAL(1, s_diag_count);
+  TEST_ASSERT_EQUAL(8, s_diag_msg.dlc);
+  TEST_ASSERT_EQUAL(TEST_CAN_LONG_MSG_ID, s_diag_msg.data_u16[0] >> 10);
+  TEST_ASSERT_EQUAL(3, s_diag_msg.data_u16[1]);
+  TEST_ASSERT_EQUAL(3, s_diag_msg.data_u16[2]);
+  TEST_ASSERT_EQUAL(0, s_diag_msg.data_u16[3]);
+
+  // Stopped
+  TEST_ASSERT_OK(can_publish_stats(TEST_CAN_DIAG_MSG_ID, 0));
+  delay_ms(3 * TEST_CAN_PUBLISH_PERIOD_MS);
+  Event e = { 0 };
+  while (event_process(&e) == STATUS_CODE_OK) {
+    can_process_event(&e);
+  }
+  TEST_ASSERT_EQUAL(1, s_diag_count);
+}
@@ -1,15 +1,44 @@
 #include "delay.h"
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event_queue.h"
 #include "interrupt.h"
 #include "soft_timer.h"
+#include "test_helpers.h"
 #include "unity.h"
 
 // These tests serve a dual purpose as they also implicitly test the wait
 // module.
 
+#define TEST_DELAY_EVENT_ID 5
+#define TEST_DELAY_EVENT_DATA 0x1234
+
+static volatile bool s_timer_fired = false;
+static uint32_t s_num_events = 0;
+static Event s_last_event = { 0 };
+
+static void prv_raise_event(SoftTimerId timer_id, void *context) {
+  event_raise(TEST_DELAY_EVENT_ID, TEST_DELAY_EVENT_DATA);
+}
+
+static void prv_set_fired(SoftTimerId timer_id, void *context) {
+  s_timer_fired = true;
+}
+
+static void prv_handle_event(const Event *e, void *context) {
+  uint32_t *num_events = context;
+  (*num_events)++;
+  s_last_event = *e;
+}
+
 void setup_test(void) {
   interrupt_init();
   soft_timer_init();
+  event_queue_init();
+  s_timer_fired = false;
+  s_num_events = 0;
 }
 
 void teardown_test(void) {}
@@ -17,3 +46,28 @@ void teardown_test(void) {}
 void test_delay_us(void) {
   delay_us(10000);
 }
+
+void test_delay_spin_us(void) {
+  // Runs past a timer that expires during the spin
+  TEST_ASSERT_OK(soft_timer_start(500, prv_set_fired, NULL, NULL));
+  delay_spin_us(900);
+  TEST_ASSERT_TRUE(s_timer_fired);
+}
+
+void test_delay_sleep_us_processes_events(void) {
+  TEST_ASSERT_OK(soft_timer_start(2000, prv_raise_event, NULL, NULL));
+  delay_sleep_us(10000, prv_handle_event, &s_num_events);
+
+  TEST_ASSERT_EQUAL(1, s_num_events);
+  TEST_ASSERT_EQUAL(TEST_DELAY_EVENT_ID, s_last_event.id);
+  TEST_ASSERT_EQUAL(TEST_DELAY_EVENT_DATA, s_last_event.data);
+}
+
+void test_delay_sleep_us_leaves_events_queued(void) {
+  TEST_ASSERT_OK(soft_timer_start(2000, prv_raise_event, NULL, NULL));
+  delay_sleep_us(10000, NULL, NULL);
+
+  Event e = { 0 };
+  TEST_ASSERT_OK(event_process(&e));
+  TEST_ASSERT_EQUAL(TEST_DELAY_EVENT_ID, e.id);
+}
@@ -3,7 +3,15 @@
 #include "test_helpers.h"
 #include "unity.h"
 
+static uint8_t s_num_raise_callbacks;
+
+static void prv_raise_callback(void *context) {
+  uint8_t *num_callbacks = context;
+  (*num_callbacks)++;
+}
+
 void setup_test(void) {
+  s_num_raise_callbacks = 0;
   event_queue_init();
 }
 
@@ -70,3 +78,29 @@ void test_event_queue_raise_priority(void) {
 
   TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, event_process(&e));
 }
+
+// The raise callback runs once per successfully raised event and is cleared on init.
+void test_event_queue_raise_callback(void) {
+  event_queue_set_raise_callback(prv_raise_callback, &s_num_raise_callbacks);
+
+  for (int i = 0; i < EVENT_QUEUE_SIZE; i++) {
+    TEST_ASSERT_OK(event_raise(i, 0));
+  }
+  TEST_ASSERT_EQUAL(EVENT_QUEUE_SIZE, s_num_raise_callbacks);
+
+  // Failed raises don't wake the consumer
+  TEST_ASSERT_NOT_OK(event_raise(0, 0));
+  TEST_ASSERT_NOT_OK(event_raise_priority(NUM_EVENT_PRIORITIES, 0, 0));
+  TEST_ASSERT_EQUAL(EVENT_QUEUE_SIZE, s_num_raise_callbacks);
+
+  event_queue_set_raise_callback(NULL, NULL);
+  Event e = { 0 };
+  TEST_ASSERT_OK(event_process(&e));
+  TEST_ASSERT_OK(event_raise(0, 0));
+  TEST_ASSERT_EQUAL(EVENT_QUEUE_SIZE, s_num_raise_callbacks);
+
+  event_queue_set_raise_callback(prv_raise_callback, &s_num_raise_callbacks);
+  event_queue_init();
+  TEST_ASSERT_OK(event_raise(0, 0));
+  TEST_ASSERT_EQUAL(EVENT_QUEUE_SIZE, s_num_raise_callbacks);
+}
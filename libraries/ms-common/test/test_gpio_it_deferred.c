@@ -0,0 +1,192 @@
+#include "gpio_it_deferred.h"
+
+#include <stdint.h>
+
+#include "critical_section.h"
+#include "event_queue.h"
+#include "gpio.h"
+#include "gpio_it.h"
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+// About two register reads from an I2C expander at 100 kHz
+#define TEST_GPIO_IT_DEFERRED_TRANSFER_US 2000
+#define TEST_GPIO_IT_DEFERRED_WAIT_US 1000
+
+typedef enum {
+  TEST_GPIO_IT_DEFERRED_EVENT_OTHER = 0,
+  TEST_GPIO_IT_DEFERRED_EVENT_PIN,
+} TestGpioItDeferredEvent;
+
+static GpioAddress s_direct_address = { GPIO_PORT_B, 0 };
+static GpioAddress s_deferred_address = { GPIO_PORT_B, 1 };
+static InterruptSettings s_interrupt_settings = {
+  .type = INTERRUPT_TYPE_INTERRUPT,       //
+  .priority = INTERRUPT_PRIORITY_NORMAL,  //
+};
+
+static volatile uint32_t s_num_runs;
+static volatile bool s_correct_context;
+
+static void prv_busy_wait_us(uint32_t duration_us) {
+  uint32_t start_us = soft_timer_now_us();
+  while (soft_timer_now_us() - start_us < duration_us) {
+  }
+}
+
+// Stands in for a blocking bus transfer
+static void prv_slow_callback(const GpioAddress *address, void *context) {
+  prv_busy_wait_us(TEST_GPIO_IT_DEFERRED_TRANSFER_US);
+  s_correct_context = (context == &s_num_runs);
+  s_num_runs++;
+}
+
+// Returns how long the interrupt for |address| held off the caller
+static uint32_t prv_isr_hold_us(const GpioAddress *address) {
+  uint32_t start_us = soft_timer_now_us();
+  TEST_ASSERT_OK(gpio_it_trigger_interrupt(address));
+  return soft_timer_now_us() - start_us;
+}
+
+// Processes every queued event, returning how many ran a deferred handler
+static uint32_t prv_process_events(void) {
+  uint32_t handled = 0;
+  Event e = { 0 };
+  while (event_process(&e) == STATUS_CODE_OK) {
+    if (gpio_it_deferred_process_event(&e)) {
+      handled++;
+    }
+  }
+  return handled;
+}
+
+void setup_test(void) {
+  interrupt_init();
+  soft_timer_init();
+  event_queue_init();
+  gpio_init();
+  gpio_it_init();
+
+  s_num_runs = 0;
+  s_correct_context = false;
+}
+
+void teardown_test(void) {
+  critical_section_end(true);
+}
+
+void test_gpio_it_deferred_isr_hold_time(void) {
+  TEST_ASSERT_OK(gpio_it_register_interrupt(&s_direct_address, &s_interrupt_settings,
+                                            INTERRUPT_EDGE_FALLING, prv_slow_callback,
+                                            (void *)&s_num_runs));
+  TEST_ASSERT_OK(gpio_it_deferred_register(&s_deferred_address, &s_interrupt_settings,
+                                           INTERRUPT_EDGE_FALLING, TEST_GPIO_IT_DEFERRED_EVENT_PIN,
+                                           prv_slow_callback, (void *)&s_num_runs));
+
+  // The transfer runs in the interrupt
+  uint32_t direct_us = prv_isr_hold_us(&s_direct_address);
+  TEST_ASSERT_EQUAL(1, s_num_runs);
+
+  // Only the latch runs in the interrupt, and the transfer waits for the main loop
+  uint32_t deferred_us = prv_isr_hold_us(&s_deferred_address);
+  TEST_ASSERT_EQUAL(1, s_num_runs);
+  TEST_ASSERT_EQUAL(1, prv_process_events());
+  TEST_ASSERT_EQUAL(2, s_num_runs);
+  TEST_ASSERT_TRUE(s_correct_context);
+
+  LOG_DEBUG("ISR hold time: %lu us with the transfer, %lu us deferred\n",
+            (unsigned long)direct_us, (unsigned long)deferred_us);
+  TEST_ASSERT_TRUE(direct_us >= TEST_GPIO_IT_DEFERRED_TRANSFER_US);
+  TEST_ASSERT_TRUE(deferred_us * 4 < TEST_GPIO_IT_DEFERRED_TRANSFER_US);
+}
+
+void test_gpio_it_deferred_coalesces(void) {
+  TEST_ASSERT_OK(gpio_it_deferred_register(&s_deferred_address, &s_interrupt_settings,
+                                           INTERRUPT_EDGE_FALLING, TEST_GPIO_IT_DEFERRED_EVENT_PIN,
+                                           prv_slow_callback, (void *)&s_num_runs));
+
+  // Edges before the main loop gets to it are a single run
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_OK(gpio_it_trigger_interrupt(&s_deferred_address));
+  }
+  prv_busy_wait_us(TEST_GPIO_IT_DEFERRED_WAIT_US);
+  TEST_ASSERT_EQUAL(1, prv_process_events());
+  TEST_ASSERT_EQUAL(1, s_num_runs);
+
+  GpioItDeferredStats stats = { 0 };
+  TEST_ASSERT_OK(gpio_it_deferred_get_stats(&s_deferred_address, &stats));
+  TEST_ASSERT_EQUAL(3, stats.edges);
+  TEST_ASSERT_EQUAL(0, stats.delayed);
+  TEST_ASSERT_EQUAL(1, stats.runs);
+  TEST_ASSERT_TRUE(stats.max_latency_us >= TEST_GPIO_IT_DEFERRED_WAIT_US);
+
+  // Then the next edge runs it again
+  TEST_ASSERT_OK(gpio_it_trigger_interrupt(&s_deferred_address));
+  TEST_ASSERT_EQUAL(1, prv_process_events());
+  TEST_ASSERT_EQUAL(2, s_num_runs);
+}
+
+static void prv_fill_event_queue(void) {
+  while (status_ok(event_raise_priority(GPIO_IT_DEFERRED_EVENT_PRIORITY,
+                                        TEST_GPIO_IT_DEFERRED_EVENT_OTHER, 0))) {
+  }
+}
+
+// An edge that finds the queue full isn't lost, even though no other edge follows it, like an I/O
+// expander holding its interrupt line until it's read
+void test_gpio_it_deferred_queue_full(void) {
+  TEST_ASSERT_OK(gpio_it_deferred_register(&s_deferred_address, &s_interrupt_settings,
+                                           INTERRUPT_EDGE_FALLING, TEST_GPIO_IT_DEFERRED_EVENT_PIN,
+                                           prv_slow_callback, (void *)&s_num_runs));
+
+  // Retried when the main loop processes the next event
+  prv_fill_event_queue();
+  TEST_ASSERT_OK(gpio_it_trigger_interrupt(&s_deferred_address));
+  TEST_ASSERT_EQUAL(1, prv_process_events());
+  TEST_ASSERT_EQUAL(1, s_num_runs);
+
+  // Retried from a soft timer when the main loop doesn't hand it any events
+  prv_fill_event_queue();
+  TEST_ASSERT_OK(gpio_it_trigger_interrupt(&s_deferred_address));
+  Event e = { 0 };
+  while (event_process(&e) == STATUS_CODE_OK) {
+  }
+  prv_busy_wait_us(TEST_GPIO_IT_DEFERRED_WAIT_US * 3);
+  TEST_ASSERT_EQUAL(1, prv_process_events());
+  TEST_ASSERT_EQUAL(2, s_num_runs);
+
+  GpioItDeferredStats stats = { 0 };
+  TEST_ASSERT_OK(gpio_it_deferred_get_stats(&s_deferred_address, &stats));
+  TEST_ASSERT_EQUAL(2, stats.edges);
+  TEST_ASSERT_EQUAL(2, stats.delayed);
+  TEST_ASSERT_EQUAL(2, stats.runs);
+}
+
+void test_gpio_it_deferred_other_events(void) {
+  TEST_ASSERT_OK(gpio_it_deferred_register(&s_deferred_address, &s_interrupt_settings,
+                                           INTERRUPT_EDGE_FALLING, TEST_GPIO_IT_DEFERRED_EVENT_PIN,
+                                           prv_slow_callback, (void *)&s_num_runs));
+
+  // Nothing latched, or not ours
+  Event e = { .id = TEST_GPIO_IT_DEFERRED_EVENT_PIN, .data = s_deferred_address.pin };
+  TEST_ASSERT_FALSE(gpio_it_deferred_process_event(&e));
+  TEST_ASSERT_OK(gpio_it_trigger_interrupt(&s_deferred_address));
+  e.id = TEST_GPIO_IT_DEFERRED_EVENT_OTHER;
+  TEST_ASSERT_FALSE(gpio_it_deferred_process_event(&e));
+  e.data = GPIO_PINS_PER_PORT;
+  TEST_ASSERT_FALSE(gpio_it_deferred_process_event(&e));
+  TEST_ASSERT_EQUAL(0, s_num_runs);
+
+  // The pin is already taken
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED,
+                    gpio_it_deferred_register(&s_deferred_address, &s_interrupt_settings,
+                                              INTERRUPT_EDGE_FALLING,
+                                              TEST_GPIO_IT_DEFERRED_EVENT_OTHER,
+                                              prv_slow_callback, NULL));
+  TEST_ASSERT_EQUAL(1, prv_process_events());
+  TEST_ASSERT_EQUAL(1, s_num_runs);
+  TEST_ASSERT_TRUE(s_correct_context);
+}
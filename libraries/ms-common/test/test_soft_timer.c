@@ -211,3 +211,12 @@ void test_soft_timer_too_short(void) {
   TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
                     soft_timer_start(SOFT_TIMER_MIN_TIME_US - 1, prv_timeout_cb, NULL, NULL));
 }
+
+void test_soft_timer_now_us(void) {
+  uint32_t start_us = soft_timer_now_us();
+  volatile SoftTimerId cb_id = SOFT_TIMER_INVALID_TIMER;
+  TEST_ASSERT_OK(soft_timer_start(1000, prv_timeout_cb, (void *)&cb_id, NULL));
+  while (cb_id == SOFT_TIMER_INVALID_TIMER) {
+  }
+  TEST_ASSERT_TRUE(soft_timer_now_us() - start_us >= 1000);
+}
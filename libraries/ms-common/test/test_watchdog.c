@@ -1,5 +1,6 @@
 #include "delay.h"
 #include "interrupt.h"
+#include "misc.h"
 #include "soft_timer.h"
 #include "test_helpers.h"
 #include "unity.h"
@@ -102,3 +103,81 @@ void test_watchdog_expired_can_start_again() {
   TEST_ASSERT_TRUE(s_expiry_called);
   TEST_ASSERT_EQUAL(&context_data, s_passed_context);
 }
+
+void test_watchdog_multiple_expire_independently() {
+  WatchdogStorage short_watchdog = { 0 };
+  WatchdogStorage long_watchdog = { 0 };
+  uint32_t short_context = 1;
+  uint32_t long_context = 2;
+  watchdog_start(&long_watchdog, 2 * TIMEOUT_MS, prv_expiry_callback, &long_context);
+  watchdog_start(&short_watchdog, TIMEOUT_MS, prv_expiry_callback, &short_context);
+
+  delay_ms(TIMEOUT_MS + 5);
+  TEST_ASSERT_TRUE(s_expiry_called);
+  TEST_ASSERT_EQUAL(&short_context, s_passed_context);
+  prv_reset_callback();
+
+  // Kicking the long one keeps it alive past its original deadline
+  watchdog_kick(&long_watchdog);
+  delay_ms(TIMEOUT_MS + 5);
+  TEST_ASSERT_FALSE(s_expiry_called);
+
+  delay_ms(TIMEOUT_MS);
+  TEST_ASSERT_TRUE(s_expiry_called);
+  TEST_ASSERT_EQUAL(&long_context, s_passed_context);
+  TEST_ASSERT_FALSE(soft_timer_inuse());
+}
+
+void test_watchdog_many_kicks_use_one_timer() {
+  WatchdogStorage watchdogs[3] = { 0 };
+  for (size_t i = 0; i < SIZEOF_ARRAY(watchdogs); i++) {
+    watchdog_start(&watchdogs[i], TIMEOUT_MS, prv_expiry_callback, NULL);
+  }
+
+  // Kicks don't touch the soft timers, so the watchdogs can be kicked far more often than timers
+  // could be started
+  for (uint32_t i = 0; i < 100000; i++) {
+    watchdog_kick(&watchdogs[i % SIZEOF_ARRAY(watchdogs)]);
+  }
+  TEST_ASSERT_FALSE(s_expiry_called);
+
+  for (size_t i = 0; i < SIZEOF_ARRAY(watchdogs); i++) {
+    watchdog_stop(&watchdogs[i]);
+  }
+  TEST_ASSERT_FALSE(soft_timer_inuse());
+  delay_ms(TIMEOUT_MS + 5);
+  TEST_ASSERT_FALSE(s_expiry_called);
+}
+
+void test_watchdog_kick_after_expiry_restarts() {
+  watchdog_start(&s_watchdog, TIMEOUT_MS, prv_expiry_callback, NULL);
+  delay_ms(TIMEOUT_MS + 5);
+  TEST_ASSERT_TRUE(s_expiry_called);
+  prv_reset_callback();
+
+  watchdog_kick(&s_watchdog);
+  delay_ms(TIMEOUT_MS - 5);
+  TEST_ASSERT_FALSE(s_expiry_called);
+  delay_ms(10);
+  TEST_ASSERT_TRUE(s_expiry_called);
+}
+
+void test_watchdog_min_slack() {
+  watchdog_start(&s_watchdog, TIMEOUT_MS, prv_expiry_callback, NULL);
+  TEST_ASSERT_EQUAL(TIMEOUT_MS * 1000, watchdog_get_min_slack_us(&s_watchdog));
+
+  delay_ms(10);
+  watchdog_kick(&s_watchdog);
+  delay_ms(30);
+  watchdog_kick(&s_watchdog);
+  delay_ms(20);
+  watchdog_kick(&s_watchdog);
+
+  // The 30ms gap came closest to the timeout
+  uint32_t slack_us = watchdog_get_min_slack_us(&s_watchdog);
+  TEST_ASSERT_UINT32_WITHIN(5000, (TIMEOUT_MS - 30) * 1000, slack_us);
+  TEST_ASSERT_TRUE(slack_us <= (TIMEOUT_MS - 30) * 1000);
+
+  watchdog_stop(&s_watchdog);
+  TEST_ASSERT_EQUAL(0, watchdog_get_min_slack_us(&s_watchdog));
+}
@@ -0,0 +1,195 @@
+#include "x86_adc.h"
+
+#include "adc.h"
+#include "delay.h"
+#include "gpio.h"
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+// Checks how many conversions reads cost with the x86 model
+
+#define TEST_VDDA_MV 3300
+#define TEST_READS 10
+#define TEST_RAW_READING 1000
+
+static const GpioAddress s_address[] = {
+  { GPIO_PORT_A, 0 },
+  { GPIO_PORT_A, 1 },
+};
+
+// How adc_read_converted used to get Vdda - with a read of its own
+static StatusCode prv_read_converted_separately(GpioAddress address, uint16_t *reading) {
+  uint16_t raw = 0;
+  uint16_t vdda = 0;
+  status_ok_or_return(adc_read_raw_pin(address, &raw));
+  status_ok_or_return(adc_read_converted(ADC_CHANNEL_REF, &vdda));
+  *reading = (uint16_t)((raw * vdda) / 4095);
+  return STATUS_CODE_OK;
+}
+
+static AdcSnapshot s_callback_snapshot;
+static volatile uint32_t s_callback_count;
+
+static void prv_sequence_callback(const AdcSnapshot *snapshot, void *context) {
+  s_callback_snapshot = *snapshot;
+  s_callback_count++;
+}
+
+void setup_test(void) {
+  s_callback_count = 0;
+  gpio_init();
+  interrupt_init();
+  soft_timer_init();
+
+  GpioSettings settings = {
+    GPIO_DIR_IN,        //
+    GPIO_STATE_LOW,     //
+    GPIO_RES_NONE,      //
+    GPIO_ALTFN_ANALOG,  //
+  };
+  for (size_t i = 0; i < SIZEOF_ARRAY(s_address); i++) {
+    gpio_init_pin(&s_address[i], &settings);
+  }
+
+  adc_init(ADC_MODE_SINGLE);
+  for (size_t i = 0; i < SIZEOF_ARRAY(s_address); i++) {
+    adc_set_channel_pin(s_address[i], true);
+  }
+}
+
+void teardown_test(void) {}
+
+void test_x86_adc_converted_read_is_one_sequence(void) {
+  X86AdcStats stats = { 0 };
+  uint16_t reading = 0;
+  uint16_t separate_reading = 0;
+
+  for (size_t i = 0; i < TEST_READS; i++) {
+    TEST_ASSERT_OK(prv_read_converted_separately(s_address[0], &separate_reading));
+  }
+  x86_adc_get_stats(&stats);
+  uint32_t separate_conversions = stats.conversions;
+  TEST_ASSERT_EQUAL(2 * TEST_READS, stats.sequences);
+
+  adc_init(ADC_MODE_SINGLE);
+  for (size_t i = 0; i < TEST_READS; i++) {
+    TEST_ASSERT_OK(adc_read_converted_pin(s_address[0], &reading));
+  }
+  x86_adc_get_stats(&stats);
+  LOG_DEBUG("%d converted reads: %lu conversions separately, %lu with the sequence's Vdda\n",
+            TEST_READS, (unsigned long)separate_conversions, (unsigned long)stats.conversions);
+
+  TEST_ASSERT_EQUAL(separate_reading, reading);
+  TEST_ASSERT_EQUAL(TEST_READS, stats.sequences);
+  // Both pins and the reference each sequence
+  TEST_ASSERT_EQUAL(3 * TEST_READS, stats.conversions);
+  TEST_ASSERT_EQUAL(2 * stats.conversions, separate_conversions);
+}
+
+void test_x86_adc_vdda(void) {
+  uint16_t vdda = 0;
+  uint32_t timestamp_us = 0;
+  uint16_t reading = 0;
+
+  // Nothing has been converted since adc_init()
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, adc_get_vdda(&vdda, &timestamp_us));
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, adc_get_vdda(NULL, &timestamp_us));
+
+  uint32_t start_us = soft_timer_now_us();
+  TEST_ASSERT_OK(adc_read_raw_pin(s_address[1], &reading));
+  TEST_ASSERT_OK(adc_get_vdda(&vdda, &timestamp_us));
+  TEST_ASSERT_EQUAL(TEST_VDDA_MV, vdda);
+  TEST_ASSERT_TRUE(timestamp_us - start_us <= soft_timer_now_us() - start_us);
+  TEST_ASSERT_OK(adc_get_vdda(&vdda, NULL));
+
+  // Each sequence updates the timestamp
+  uint32_t first_us = timestamp_us;
+  delay_us(1000);
+  TEST_ASSERT_OK(adc_read_raw_pin(s_address[1], &reading));
+  TEST_ASSERT_OK(adc_get_vdda(&vdda, &timestamp_us));
+  TEST_ASSERT_TRUE(timestamp_us - first_us >= 1000);
+
+  // Without the reference there's nothing to convert with
+  adc_set_channel(ADC_CHANNEL_REF, false);
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, adc_get_vdda(&vdda, &timestamp_us));
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, adc_read_converted_pin(s_address[0], &reading));
+}
+
+void test_x86_adc_continuous(void) {
+  X86AdcStats stats = { 0 };
+  uint16_t reading = 0;
+
+  // Reads take the latest results rather than converting
+  adc_init(ADC_MODE_CONTINUOUS);
+  adc_set_channel_pin(s_address[0], true);
+  while (adc_get_vdda(&reading, NULL) != STATUS_CODE_OK) {
+  }
+  x86_adc_get_stats(&stats);
+  uint32_t sequences = stats.sequences;
+
+  TEST_ASSERT_OK(adc_read_converted_pin(s_address[0], &reading));
+  x86_adc_get_stats(&stats);
+  TEST_ASSERT_EQUAL(sequences, stats.sequences);
+}
+
+void test_x86_adc_scan(void) {
+  X86AdcStats stats = { 0 };
+  AdcSnapshot snapshot = { 0 };
+  uint16_t reading = 0;
+
+  // Scans need scan mode
+  TEST_ASSERT_EQUAL(STATUS_CODE_UNINITIALIZED, adc_scan_start());
+
+  adc_init(ADC_MODE_SCAN);
+  adc_register_sequence_callback(prv_sequence_callback, NULL);
+  for (size_t i = 0; i < SIZEOF_ARRAY(s_address); i++) {
+    adc_set_channel_pin(s_address[i], false);
+  }
+  adc_set_channel(ADC_CHANNEL_REF, false);
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, adc_scan_start());
+
+  adc_set_channel(ADC_CHANNEL_REF, true);
+  for (size_t i = 0; i < SIZEOF_ARRAY(s_address); i++) {
+    adc_set_channel_pin(s_address[i], true);
+  }
+  AdcChannel channel = NUM_ADC_CHANNELS;
+  TEST_ASSERT_OK(adc_get_channel(s_address[0], &channel));
+  TEST_ASSERT_OK(x86_adc_set_reading(channel, TEST_RAW_READING));
+
+  // Nothing until the first scan finishes, and reads don't convert
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY, adc_get_snapshot(&snapshot));
+  TEST_ASSERT_OK(adc_scan_start());
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, adc_scan_start());
+  // Nor can the sequence change under it
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, adc_set_channel(ADC_CHANNEL_TEMP, true));
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, adc_set_channel_pin(s_address[0], false));
+  TEST_ASSERT_OK(adc_read_raw(channel, &reading));
+  x86_adc_get_stats(&stats);
+  TEST_ASSERT_EQUAL(0, stats.sequences);
+
+  while (s_callback_count == 0) {
+  }
+  x86_adc_get_stats(&stats);
+  TEST_ASSERT_EQUAL(1, stats.sequences);
+  TEST_ASSERT_EQUAL(3, stats.conversions);
+
+  // The callback and adc_get_snapshot() see the same sequence
+  TEST_ASSERT_OK(adc_get_snapshot(&snapshot));
+  TEST_ASSERT_EQUAL_MEMORY(&s_callback_snapshot, &snapshot, sizeof(snapshot));
+  TEST_ASSERT_EQUAL(TEST_RAW_READING, snapshot.raw[channel]);
+  TEST_ASSERT_EQUAL(TEST_VDDA_MV, snapshot.vdda_mv);
+  TEST_ASSERT_TRUE(snapshot.channels & ((uint32_t)1 << ADC_CHANNEL_REF));
+
+  TEST_ASSERT_OK(adc_get_snapshot_converted(&snapshot, channel, &reading));
+  TEST_ASSERT_EQUAL(TEST_RAW_READING * TEST_VDDA_MV / 4095, reading);
+  TEST_ASSERT_OK(adc_read_raw(channel, &reading));
+  TEST_ASSERT_EQUAL(TEST_RAW_READING, reading);
+  TEST_ASSERT_EQUAL(STATUS_CODE_EMPTY,
+                    adc_get_snapshot_converted(&snapshot, ADC_CHANNEL_TEMP, &reading));
+
+  // Another scan can start once the last one is done
+  TEST_ASSERT_OK(adc_scan_start());
+}
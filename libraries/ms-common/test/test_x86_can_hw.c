@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "can_hw.h"
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+#include "x86_can_hw.h"
+
+#define TEST_X86_CAN_HW_WARMUP_US 20000
+#define TEST_X86_CAN_HW_DURATION_US 300000
+#define TEST_X86_CAN_HW_SETTLE_US 50000
+
+static volatile uint32_t s_msg_rx;
+
+static void prv_handle_rx(void *context) {
+  uint32_t id = 0;
+  bool extended = false;
+  uint64_t data = 0;
+  size_t len = 0;
+  while (can_hw_receive(&id, &extended, &data, &len)) {
+    s_msg_rx++;
+  }
+}
+
+static uint32_t prv_now_us(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)now.tv_sec * 1000000 + (uint32_t)now.tv_nsec / 1000;
+}
+
+// Signals from the RX interrupt cut usleep() short
+static void prv_wait_us(uint32_t duration_us) {
+  uint32_t end_us = prv_now_us() + duration_us;
+  while ((int32_t)(end_us - prv_now_us()) > 0) {
+    usleep(1000);
+  }
+}
+
+// Keeps the TX FIFO full until |end_us|
+static void prv_saturate_bus(uint32_t end_us) {
+  uint64_t data = 0x1122334455667788;
+  while ((int32_t)(end_us - prv_now_us()) > 0) {
+    if (!status_ok(can_hw_transmit(0x1, false, (uint8_t *)&data, sizeof(data)))) {
+      usleep(100);
+    }
+  }
+}
+
+void setup_test(void) {
+  interrupt_init();
+  soft_timer_init();
+
+  CanHwSettings can_settings = {
+    .bitrate = CAN_HW_BITRATE_500KBPS,
+    .loopback = true,
+    .tx = { GPIO_PORT_A, 12 },
+    .rx = { GPIO_PORT_A, 11 },
+  };
+  TEST_ASSERT_OK(can_hw_init(&can_settings));
+  TEST_ASSERT_OK(can_hw_register_callback(CAN_HW_EVENT_MSG_RX, prv_handle_rx, NULL));
+  s_msg_rx = 0;
+}
+
+void teardown_test(void) {}
+
+void test_x86_can_hw_full_bus_load(void) {
+  // Let the initial burst drain so only the sustained rate is measured
+  prv_saturate_bus(prv_now_us() + TEST_X86_CAN_HW_WARMUP_US);
+
+  X86CanHwStats start = { 0 };
+  x86_can_hw_get_stats(&start);
+  prv_saturate_bus(prv_now_us() + TEST_X86_CAN_HW_DURATION_US);
+  X86CanHwStats end = { 0 };
+  x86_can_hw_get_stats(&end);
+
+  uint32_t elapsed_us = end.elapsed_us - start.elapsed_us;
+  uint32_t frames = end.tx_frames - start.tx_frames;
+  uint32_t frame_rate = (uint32_t)((uint64_t)frames * 1000000 / elapsed_us);
+  uint32_t max_frame_rate = x86_can_hw_max_frame_rate(8, false);
+  LOG_DEBUG("Sustained %u frames/s at 100%% bus load (max %u), %u TX rejected, %u RX dropped\n",
+            frame_rate, max_frame_rate, end.tx_dropped, end.rx_dropped);
+
+  // Never faster than the bitrate allows, and close to it. The lower bound leaves room for a
+  // loaded host that can't always keep the TX FIFO full.
+  TEST_ASSERT_TRUE(frame_rate <= max_frame_rate * 102 / 100);
+  TEST_ASSERT_TRUE(frame_rate >= max_frame_rate * 80 / 100);
+
+  // Everything sent is looped back once the TX FIFO drains
+  usleep(20000);
+  x86_can_hw_get_stats(&end);
+  TEST_ASSERT_EQUAL(end.tx_frames, s_msg_rx);
+  TEST_ASSERT_EQUAL(0, end.rx_dropped);
+}
+
+void test_x86_can_hw_filters(void) {
+  // 0x100-0x10F, plus 0x321
+  CanFilterBank banks[] = {
+    { .mode = CAN_FILTER_BANK_MODE_MASK, .filters = { { 0x100, 0x7F0 }, { 0x100, 0x7F0 } } },
+    { .mode = CAN_FILTER_BANK_MODE_LIST, .ids = { 0x321, 0x321, 0x321, 0x321 } },
+  };
+  TEST_ASSERT_OK(can_hw_set_filters(banks, SIZEOF_ARRAY(banks)));
+
+  const uint32_t ids[] = { 0x100, 0x10F, 0x110, 0x321, 0x322, 0x000 };
+  uint64_t data = 0;
+  for (size_t i = 0; i < SIZEOF_ARRAY(ids); i++) {
+    TEST_ASSERT_OK(can_hw_transmit(ids[i], false, (uint8_t *)&data, sizeof(data)));
+  }
+  // Extended frames never match standard banks
+  TEST_ASSERT_OK(can_hw_transmit(0x100, true, (uint8_t *)&data, sizeof(data)));
+  prv_wait_us(TEST_X86_CAN_HW_SETTLE_US);
+
+  X86CanHwStats stats = { 0 };
+  x86_can_hw_get_stats(&stats);
+  TEST_ASSERT_EQUAL(3, s_msg_rx);
+  TEST_ASSERT_EQUAL(4, stats.rx_filtered);
+
+  // No banks accept everything again
+  TEST_ASSERT_OK(can_hw_set_filters(NULL, 0));
+  TEST_ASSERT_OK(can_hw_transmit(0x000, false, (uint8_t *)&data, sizeof(data)));
+  prv_wait_us(TEST_X86_CAN_HW_SETTLE_US);
+  TEST_ASSERT_EQUAL(4, s_msg_rx);
+}
@@ -0,0 +1,127 @@
+#include "critical_section.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "fifo.h"
+#include "interrupt.h"
+#include "interrupt_def.h"
+#include "log.h"
+#include "objpool.h"
+#include "test_helpers.h"
+#include "unity.h"
+#include "x86_interrupt.h"
+
+// Benchmarks the data structures that take a critical section on every operation, and checks that
+// interrupts held by critical sections are never lost.
+
+#define TEST_CRITICAL_SECTION_BENCHMARK_OPS 200000
+#define TEST_CRITICAL_SECTION_FIFO_LEN 16
+#define TEST_CRITICAL_SECTION_POOL_SIZE 16
+#define TEST_CRITICAL_SECTION_STRESS_INTERRUPTS 2000
+
+static Fifo s_fifo;
+static uint32_t s_fifo_buffer[TEST_CRITICAL_SECTION_FIFO_LEN];
+static ObjectPool s_pool;
+static uint32_t s_pool_nodes[TEST_CRITICAL_SECTION_POOL_SIZE];
+
+static uint8_t s_interrupt_id;
+static volatile uint32_t s_interrupt_count;
+
+static uint64_t prv_now_ns(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static void prv_log_rate(const char *name, uint64_t start_ns) {
+  uint64_t elapsed_ns = prv_now_ns() - start_ns;
+  LOG_DEBUG("%s: %lu ops/s (%lu ns/op)\n", name,
+            (uint64_t)(TEST_CRITICAL_SECTION_BENCHMARK_OPS * 1000000000ULL / elapsed_ns),
+            elapsed_ns / TEST_CRITICAL_SECTION_BENCHMARK_OPS);
+}
+
+static void prv_handler(uint8_t interrupt_id) {
+  // Handlers take critical sections too
+  bool disabled = critical_section_start();
+  s_interrupt_count++;
+  critical_section_end(disabled);
+}
+
+static void *prv_trigger_thread(void *context) {
+  x86_interrupt_pthread_init();
+  for (uint32_t i = 0; i < TEST_CRITICAL_SECTION_STRESS_INTERRUPTS; i++) {
+    x86_interrupt_trigger(s_interrupt_id);
+  }
+  return NULL;
+}
+
+void setup_test(void) {
+  interrupt_init();
+  fifo_init(&s_fifo, s_fifo_buffer);
+  objpool_init(&s_pool, s_pool_nodes, NULL, NULL);
+  s_interrupt_count = 0;
+
+  uint8_t handler_id = 0;
+  InterruptSettings settings = {
+    .type = INTERRUPT_TYPE_INTERRUPT,
+    .priority = INTERRUPT_PRIORITY_NORMAL,
+  };
+  TEST_ASSERT_OK(x86_interrupt_register_handler(prv_handler, &handler_id));
+  TEST_ASSERT_OK(x86_interrupt_register_interrupt(handler_id, &settings, &s_interrupt_id));
+}
+
+void teardown_test(void) {
+  critical_section_end(true);
+}
+
+void test_x86_critical_section_benchmark(void) {
+  uint64_t start_ns = prv_now_ns();
+  for (uint32_t i = 0; i < TEST_CRITICAL_SECTION_BENCHMARK_OPS; i++) {
+    bool disabled = critical_section_start();
+    critical_section_end(disabled);
+  }
+  prv_log_rate("critical section", start_ns);
+
+  uint32_t value = 0;
+  start_ns = prv_now_ns();
+  for (uint32_t i = 0; i < TEST_CRITICAL_SECTION_BENCHMARK_OPS; i++) {
+    fifo_push(&s_fifo, &i);
+    fifo_pop(&s_fifo, &value);
+  }
+  prv_log_rate("fifo push + pop", start_ns);
+  TEST_ASSERT_EQUAL(TEST_CRITICAL_SECTION_BENCHMARK_OPS - 1, value);
+
+  start_ns = prv_now_ns();
+  for (uint32_t i = 0; i < TEST_CRITICAL_SECTION_BENCHMARK_OPS; i++) {
+    objpool_free_node(&s_pool, objpool_get_node(&s_pool));
+  }
+  prv_log_rate("objpool get + free", start_ns);
+}
+
+void test_x86_critical_section_holds_interrupts(void) {
+  bool disabled = critical_section_start();
+  TEST_ASSERT_OK(x86_interrupt_trigger(s_interrupt_id));
+  TEST_ASSERT_OK(x86_interrupt_trigger(s_interrupt_id));
+  TEST_ASSERT_EQUAL(0, s_interrupt_count);
+  critical_section_end(disabled);
+
+  TEST_ASSERT_EQUAL(2, s_interrupt_count);
+}
+
+void test_x86_critical_section_stress(void) {
+  // Interrupts from another thread keep arriving as critical sections start and end
+  pthread_t thread;
+  pthread_create(&thread, NULL, prv_trigger_thread, NULL);
+  uint32_t value = 0;
+  uint64_t timeout_ns = prv_now_ns() + 10000000000ULL;
+  while (s_interrupt_count < TEST_CRITICAL_SECTION_STRESS_INTERRUPTS && prv_now_ns() < timeout_ns) {
+    fifo_push(&s_fifo, &value);
+    fifo_pop(&s_fifo, &value);
+  }
+  pthread_join(thread, NULL);
+
+  TEST_ASSERT_EQUAL(TEST_CRITICAL_SECTION_STRESS_INTERRUPTS, s_interrupt_count);
+}
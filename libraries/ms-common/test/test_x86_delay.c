@@ -0,0 +1,65 @@
+#include "delay.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#include "interrupt.h"
+#include "log.h"
+#include "misc.h"
+#include "soft_timer.h"
+#include "unity.h"
+
+// Measures how accurately delays end, for the busy-wait path and the soft timer path that every
+// delay used to take.
+
+#define TEST_DELAY_RUNS 50
+
+static uint64_t prv_now_ns(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static void prv_delay_spin(uint32_t t) {
+  delay_spin_us(t);
+}
+
+static void prv_delay_sleep(uint32_t t) {
+  delay_sleep_us(t, NULL, NULL);
+}
+
+// Logs the average and worst overshoot of |delay| and checks it never ends early
+static void prv_benchmark(const char *name, void (*delay)(uint32_t t), uint32_t t) {
+  uint64_t total_late_ns = 0;
+  uint64_t max_late_ns = 0;
+  for (uint32_t i = 0; i < TEST_DELAY_RUNS; i++) {
+    uint64_t start_ns = prv_now_ns();
+    delay(t);
+    uint64_t elapsed_ns = prv_now_ns() - start_ns;
+
+    TEST_ASSERT_TRUE(elapsed_ns >= (uint64_t)t * 1000);
+    uint64_t late_ns = elapsed_ns - (uint64_t)t * 1000;
+    total_late_ns += late_ns;
+    if (late_ns > max_late_ns) {
+      max_late_ns = late_ns;
+    }
+  }
+  LOG_DEBUG("%s %u us: late by avg %lu ns, max %lu ns\n", name, t,
+            total_late_ns / TEST_DELAY_RUNS, max_late_ns);
+}
+
+void setup_test(void) {
+  interrupt_init();
+  soft_timer_init();
+}
+
+void teardown_test(void) {}
+
+void test_x86_delay_benchmark(void) {
+  const uint32_t spin_delays_us[] = { 10, 100, 300, 900 };
+  for (size_t i = 0; i < SIZEOF_ARRAY(spin_delays_us); i++) {
+    prv_benchmark("spin", prv_delay_spin, spin_delays_us[i]);
+    prv_benchmark("soft timer", prv_delay_sleep, spin_delays_us[i]);
+  }
+  prv_benchmark("delay_us", delay_us, 5000);
+}
@@ -0,0 +1,299 @@
+#include "uart.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "event_queue.h"
+#include "gpio.h"
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+#include "x86_uart.h"
+
+#define TEST_UART_PORT UART_PORT_2
+#define TEST_UART_TIMEOUT_US 500000
+// Long enough for the RX thread to read everything written
+#define TEST_UART_SETTLE_US 50000
+#define TEST_UART_MAX_LINES 16
+// Roughly a COBS-encoded CAN UART packet
+#define TEST_UART_PACKET_LEN 19
+#define TEST_UART_PACKETS_PER_BURST 13
+#define TEST_UART_NUM_BURSTS 200
+
+typedef enum {
+  TEST_UART_EVENT_OTHER = 0,
+  TEST_UART_EVENT_RX,
+} TestUartEvent;
+
+static UartStorage s_storage;
+static int s_fd = -1;
+
+static uint8_t s_lines[TEST_UART_MAX_LINES][UART_MAX_BUFFER_LEN];
+static size_t s_line_lens[TEST_UART_MAX_LINES];
+static size_t s_num_lines;
+static volatile size_t s_total_lines;
+// The next line's handler receives a whole ring of data before it returns
+static bool s_slow_handler;
+
+static void prv_write(const void *data, size_t len);
+static void prv_settle(void);
+
+static void prv_rx_handler(const uint8_t *rx_arr, size_t len, void *context) {
+  if (s_slow_handler) {
+    s_slow_handler = false;
+    uint8_t data[UART_RX_RING_LEN];
+    memset(data, 'z', sizeof(data));
+    prv_write(data, sizeof(data));
+    prv_settle();
+  }
+  if (s_num_lines < TEST_UART_MAX_LINES) {
+    memcpy(s_lines[s_num_lines], rx_arr, len);
+    s_line_lens[s_num_lines++] = len;
+  }
+  s_total_lines++;
+}
+
+static void prv_write(const void *data, size_t len) {
+  TEST_ASSERT_EQUAL(len, write(s_fd, data, len));
+}
+
+// Waits for the RX thread to read everything written
+static void prv_settle(void) {
+  uint32_t start_us = soft_timer_now_us();
+  while (soft_timer_now_us() - start_us < TEST_UART_SETTLE_US) {
+  }
+}
+
+// Processes events until |num_lines| have been handled in total
+static void prv_wait_for_lines(size_t num_lines) {
+  uint32_t start_us = soft_timer_now_us();
+  while (s_total_lines < num_lines && soft_timer_now_us() - start_us < TEST_UART_TIMEOUT_US) {
+    Event e = { 0 };
+    if (event_process(&e) == STATUS_CODE_OK) {
+      TEST_ASSERT_TRUE(uart_process_event(&e));
+    }
+  }
+  TEST_ASSERT_EQUAL(num_lines, s_total_lines);
+}
+
+static void prv_assert_line(size_t index, const char *expected) {
+  TEST_ASSERT_EQUAL(strlen(expected), s_line_lens[index]);
+  TEST_ASSERT_EQUAL_MEMORY(expected, s_lines[index], s_line_lens[index]);
+}
+
+void setup_test(void) {
+  interrupt_init();
+  soft_timer_init();
+  event_queue_init();
+  gpio_init();
+
+  s_num_lines = 0;
+  s_total_lines = 0;
+  s_slow_handler = false;
+
+  UartSettings settings = {
+    .baudrate = 115200,
+    .rx_handler = prv_rx_handler,
+    .rx_event = TEST_UART_EVENT_RX,
+    .tx = { GPIO_PORT_A, 2 },
+    .rx = { GPIO_PORT_A, 3 },
+    .alt_fn = GPIO_ALTFN_1,
+  };
+  TEST_ASSERT_OK(uart_init(TEST_UART_PORT, &settings, &s_storage));
+
+  const char *device = x86_uart_get_device(TEST_UART_PORT);
+  TEST_ASSERT_NOT_NULL(device);
+  s_fd = open(device, O_RDWR | O_NOCTTY);
+  TEST_ASSERT_TRUE(s_fd >= 0);
+}
+
+void teardown_test(void) {
+  close(s_fd);
+  s_fd = -1;
+}
+
+void test_x86_uart_lines(void) {
+  // Lines are split at the delimiter regardless of how they arrive
+  prv_write("hello\nwor", 9);
+  prv_wait_for_lines(1);
+  prv_write("ld\n", 3);
+  prv_wait_for_lines(2);
+  prv_assert_line(0, "hello\n");
+  prv_assert_line(1, "world\n");
+
+  TEST_ASSERT_OK(uart_set_delimiter(TEST_UART_PORT, 0));
+  prv_write("a\nb\0c\0", 6);
+  prv_wait_for_lines(4);
+  TEST_ASSERT_EQUAL(4, s_line_lens[2]);
+  TEST_ASSERT_EQUAL_MEMORY("a\nb\0", s_lines[2], 4);
+  TEST_ASSERT_EQUAL_MEMORY("c\0", s_lines[3], 2);
+
+  // Not an RX event
+  Event e = { .id = TEST_UART_EVENT_OTHER, .data = TEST_UART_PORT };
+  TEST_ASSERT_FALSE(uart_process_event(&e));
+}
+
+void test_x86_uart_wraps(void) {
+  // Lines that wrap around the end of the ring come out whole
+  char line[100];
+  memset(line, 'x', sizeof(line) - 1);
+  line[sizeof(line) - 1] = '\n';
+  size_t num_lines = UART_RX_RING_LEN / sizeof(line) + 2;
+  for (size_t i = 0; i < num_lines; i++) {
+    line[0] = (char)('a' + i);
+    prv_write(line, sizeof(line));
+    prv_wait_for_lines(i + 1);
+  }
+  for (size_t i = 0; i < num_lines; i++) {
+    line[0] = (char)('a' + i);
+    TEST_ASSERT_EQUAL(sizeof(line), s_line_lens[i]);
+    TEST_ASSERT_EQUAL_MEMORY(line, s_lines[i], sizeof(line));
+  }
+
+  UartStats stats = { 0 };
+  TEST_ASSERT_OK(uart_get_stats(TEST_UART_PORT, &stats));
+  TEST_ASSERT_EQUAL(num_lines * sizeof(line), stats.rx_bytes);
+  TEST_ASSERT_EQUAL(num_lines, stats.rx_lines);
+  TEST_ASSERT_EQUAL(0, stats.rx_overruns);
+}
+
+void test_x86_uart_full_line(void) {
+  // Without a delimiter, lines are cut at the buffer length
+  uint8_t data[UART_MAX_BUFFER_LEN];
+  memset(data, 'y', sizeof(data));
+  prv_write(data, sizeof(data));
+  prv_wait_for_lines(1);
+  prv_write("y\n", 2);
+  prv_wait_for_lines(2);
+  TEST_ASSERT_EQUAL(UART_MAX_BUFFER_LEN, s_line_lens[0]);
+  prv_assert_line(1, "y\n");
+
+  // A whole ring arriving before the main loop gets to it laps the line in progress
+  UartStats stats = { 0 };
+  prv_write("partial", 7);
+  prv_write(data, sizeof(data));
+  prv_write(data, sizeof(data));
+  prv_settle();
+  uint32_t start_us = soft_timer_now_us();
+  while (stats.rx_overruns == 0 && soft_timer_now_us() - start_us < TEST_UART_TIMEOUT_US) {
+    Event e = { 0 };
+    if (event_process(&e) == STATUS_CODE_OK) {
+      uart_process_event(&e);
+    }
+    TEST_ASSERT_OK(uart_get_stats(TEST_UART_PORT, &stats));
+  }
+  TEST_ASSERT_EQUAL(1, stats.rx_overruns);
+}
+
+void test_x86_uart_handler_overrun(void) {
+  // A line is handed over in place, so a whole ring arriving while it's handled overwrites it
+  s_slow_handler = true;
+  prv_write("slow\n", 5);
+  prv_wait_for_lines(1);
+  TEST_ASSERT_EQUAL(5, s_line_lens[0]);
+  TEST_ASSERT_EQUAL_MEMORY("zzzzz", s_lines[0], s_line_lens[0]);
+
+  // Which is reported, and the rest of the ring is dropped
+  UartStats stats = { 0 };
+  TEST_ASSERT_OK(uart_get_stats(TEST_UART_PORT, &stats));
+  TEST_ASSERT_EQUAL(1, stats.rx_overruns);
+  TEST_ASSERT_EQUAL(5 + UART_RX_RING_LEN, stats.rx_bytes);
+
+  // Then it picks up with the next line
+  prv_write("next\n", 5);
+  prv_wait_for_lines(2);
+  prv_assert_line(1, "next\n");
+}
+
+// Raises other events until the event queue is full
+static void prv_fill_event_queue(void) {
+  while (status_ok(event_raise(TEST_UART_EVENT_OTHER, 0))) {
+  }
+}
+
+void test_x86_uart_queue_full(void) {
+  // A line that arrives while the queue is full is still handled, even with nothing after it
+  prv_fill_event_queue();
+  prv_write("one\n", 4);
+  prv_settle();
+  TEST_ASSERT_EQUAL(0, s_total_lines);
+
+  UartStats stats = { 0 };
+  TEST_ASSERT_OK(uart_get_stats(TEST_UART_PORT, &stats));
+  TEST_ASSERT_EQUAL(1, stats.rx_delayed);
+
+  // Processing the other events raises it
+  uint32_t start_us = soft_timer_now_us();
+  while (s_total_lines < 1 && soft_timer_now_us() - start_us < TEST_UART_TIMEOUT_US) {
+    Event e = { 0 };
+    if (event_process(&e) == STATUS_CODE_OK) {
+      uart_process_event(&e);
+    }
+  }
+  TEST_ASSERT_EQUAL(1, s_total_lines);
+  prv_assert_line(0, "one\n");
+
+  // So does the retry timer once there's room, without uart_process_event() seeing other events
+  prv_fill_event_queue();
+  prv_write("two\n", 4);
+  prv_settle();
+  Event e = { 0 };
+  while (s_total_lines < 2 && event_process(&e) == STATUS_CODE_OK) {
+    // The timer may already have raised it in the room this made
+    if (e.id == TEST_UART_EVENT_RX) {
+      TEST_ASSERT_TRUE(uart_process_event(&e));
+    }
+  }
+  prv_wait_for_lines(2);
+  prv_assert_line(1, "two\n");
+
+  TEST_ASSERT_OK(uart_get_stats(TEST_UART_PORT, &stats));
+  TEST_ASSERT_EQUAL(2, stats.rx_delayed);
+}
+
+void test_x86_uart_tx(void) {
+  uint8_t data[] = "ping\n";
+  TEST_ASSERT_OK(uart_tx(TEST_UART_PORT, data, sizeof(data) - 1));
+
+  uint8_t rx_data[sizeof(data)] = { 0 };
+  size_t received = 0;
+  uint32_t start_us = soft_timer_now_us();
+  while (received < sizeof(data) - 1 && soft_timer_now_us() - start_us < TEST_UART_TIMEOUT_US) {
+    ssize_t len = read(s_fd, rx_data + received, sizeof(data) - 1 - received);
+    if (len > 0) {
+      received += (size_t)len;
+    }
+  }
+  TEST_ASSERT_EQUAL_MEMORY(data, rx_data, sizeof(data) - 1);
+}
+
+// Sends bursts of packet-sized lines like CAN UART traffic and checks the interrupts scale with the
+// bursts rather than the bytes
+void test_x86_uart_burst(void) {
+  uint8_t burst[TEST_UART_PACKET_LEN * TEST_UART_PACKETS_PER_BURST];
+  memset(burst, 0x55, sizeof(burst));
+  for (size_t i = 1; i <= TEST_UART_PACKETS_PER_BURST; i++) {
+    burst[i * TEST_UART_PACKET_LEN - 1] = '\n';
+  }
+
+  uint32_t start_us = soft_timer_now_us();
+  for (size_t i = 1; i <= TEST_UART_NUM_BURSTS; i++) {
+    prv_write(burst, sizeof(burst));
+    prv_wait_for_lines(i * TEST_UART_PACKETS_PER_BURST);
+  }
+  uint32_t elapsed_us = soft_timer_now_us() - start_us;
+
+  UartStats stats = { 0 };
+  TEST_ASSERT_OK(uart_get_stats(TEST_UART_PORT, &stats));
+  LOG_DEBUG("%lu lines, %lu bytes in %lu us with %lu RX interrupts\n",
+            (unsigned long)stats.rx_lines, (unsigned long)stats.rx_bytes,
+            (unsigned long)elapsed_us, (unsigned long)stats.rx_interrupts);
+  TEST_ASSERT_EQUAL(TEST_UART_NUM_BURSTS * sizeof(burst), stats.rx_bytes);
+  TEST_ASSERT_EQUAL(0, stats.rx_overruns);
+  // The pseudo-terminal may split a burst, but nowhere near once per byte
+  TEST_ASSERT_TRUE(stats.rx_interrupts < stats.rx_lines);
+}
@@ -45,12 +45,12 @@ typedef struct Ads1259Settings {
 } Ads1259Settings;
 
 // Static instance of Ads1259Storage must be declared
-// ads1259_get_data() reads 24-bit conversion data into 'reading'
+// ads1259_get_data() reads 24-bit conversion data into 'reading_uv' (microvolts)
 typedef struct Ads1259Storage {
   Ads1259RxData rx_data;
   SpiPort spi_port;
   Ads1259ConversionData conv_data;
-  double reading;
+  int32_t reading_uv;
   Ads1259ErrorHandlerCb handler;
   void *error_context;
 } Ads1259Storage;
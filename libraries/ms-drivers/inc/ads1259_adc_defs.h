@@ -1,7 +1,7 @@
 #pragma once
 
-// Voltage reference value
-#define EXTERNAL_VREF_V 2.5
+// Voltage reference value in microvolts
+#define EXTERNAL_VREF_UV 2500000
 
 // ADS1259 Configuration and control commands
 
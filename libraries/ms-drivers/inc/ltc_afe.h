@@ -27,6 +27,10 @@
 #define LTC_AFE_MAX_CELLS (LTC_AFE_MAX_DEVICES * LTC_AFE_MAX_CELLS_PER_DEVICE)
 #define LTC_AFE_MAX_THERMISTORS LTC_AFE_MAX_CELLS
 
+// Discharge timeout written to every device. The LTC6811 stops discharging on its own if this much
+// time passes without a config write.
+#define LTC_AFE_DISCHARGE_TIMEOUT_MS 30000
+
 #if defined(__GNUC__)
 #define _PACKED __attribute__((packed))
 #else
@@ -125,3 +129,7 @@ bool ltc_afe_process_event(LtcAfeStorage *afe, const Event *e);
 // Mark cell for discharging (takes effect after config is re-written)
 // |cell| should be [0, settings.num_cells)
 StatusCode ltc_afe_toggle_cell_discharge(LtcAfeStorage *afe, uint16_t cell, bool discharge);
+
+// Replaces the discharge state of every cell at once (takes effect after config is re-written)
+// |discharge| is indexed like the cell result array and must have |settings.num_cells| entries
+StatusCode ltc_afe_set_cell_discharge(LtcAfeStorage *afe, const bool *discharge, size_t num_cells);
@@ -30,3 +30,7 @@ StatusCode ltc_afe_impl_read_aux(LtcAfeStorage *afe, uint8_t device_cell);
 // Mark cell for discharging (takes effect after config is re-written)
 // |cell| should be [0, LTC_AFE_MAX_CELLS)
 StatusCode ltc_afe_impl_toggle_cell_discharge(LtcAfeStorage *afe, uint16_t cell, bool discharge);
+
+// Replaces the discharge state of every cell at once (takes effect after config is re-written)
+StatusCode ltc_afe_impl_set_cell_discharge(LtcAfeStorage *afe, const bool *discharge,
+                                           size_t num_cells);
@@ -4,8 +4,12 @@
 // Requires the event queue, interrupts, soft timers, and I2C to be initialized.
 // I2C must be initialized on the port used.
 
-// Once started, we continually request a conversion (in one-shot mode), wait at least 50 ms, then
-// read the conversion result and call the callback or fault if the conversion is not ready.
+// Once started, we alternate between the channels, requesting a conversion (in one-shot mode) or
+// switching channels (in continuous mode), then poll the ready bit until the result is in. The
+// first poll is at the conversion time learned from previous conversions, and the interval between
+// polls grows until the conversion takes longer than the datasheet allows, which is a fault.
+// Polls run from the event queue and never block the I2C bus, so several MCP3427s on one bus
+// convert at the same time.
 
 // The conversion result is scaled to the full 16 bits, regardless of what sample rate/precision is
 // used. If the sample rate is not MCP3427_SAMPLE_RATE_16_BIT, the least significant bits will be 0.
@@ -15,8 +19,8 @@
 // See section 4.9 of manual.
 
 #include "event_queue.h"
-#include "fsm.h"
 #include "i2c.h"
+#include "soft_timer.h"
 
 // States of the MCP3427 address pins, used for selecting I2C address.
 typedef enum {
@@ -65,6 +69,17 @@ typedef enum {
 typedef void (*Mcp3427Callback)(int16_t value_ch1, int16_t value_ch2, void *context);
 typedef void (*Mcp3427FaultCallback)(void *context);
 
+typedef struct Mcp3427Stats {
+  uint32_t conversions;
+  uint32_t faults;
+  // Polls that found the conversion still in progress
+  uint32_t early_polls;
+  // Waits that found no soft timer free and were retried from a later event
+  uint32_t timer_retries;
+  // Conversions completed over the last MCP3427_STATS_WINDOW_US, on either channel
+  uint32_t samples_per_sec;
+} Mcp3427Stats;
+
 typedef struct Mcp3427Settings {
   Mcp3427SampleRate sample_rate;
   Mcp3427PinState addr_pin_0;
@@ -90,8 +105,22 @@ typedef struct Mcp3427Storage {
   Mcp3427FaultCallback fault_callback;
   void *fault_context;
   Mcp3427SampleRate sample_rate;
-  Fsm fsm;
-  Mcp3427Channel current_channel;  // only used on x86
+  Mcp3427Channel current_channel;
+
+  // Timestamps are from soft_timer_now_us()
+  uint32_t conversion_start_us;
+  uint32_t expected_conversion_us;
+  uint32_t poll_backoff_us;
+  uint8_t conversion_polls;
+
+  // Wait for the next trigger or poll, kept until a soft timer is started for it
+  SoftTimerCallback wait_callback;
+  uint32_t wait_start_us;
+  uint32_t wait_us;
+
+  Mcp3427Stats stats;
+  uint32_t stats_window_start_us;
+  uint32_t stats_window_conversions;
 } Mcp3427Storage;
 
 // Initialize the ADC by configuring it with the selected settings.
@@ -101,8 +130,11 @@ StatusCode mcp3427_init(Mcp3427Storage *storage, Mcp3427Settings *settings);
 StatusCode mcp3427_register_callback(Mcp3427Storage *storage, Mcp3427Callback callback,
                                      void *context);
 
-// Register a callback to be run whenever there is a fault, i.e., a conversion is missed.
-// This will be called instead of the regular callback when the conversion takes too long.
+// Register a callback to be run whenever there is a fault, i.e., a conversion takes longer than the
+// datasheet allows. The conversion is dropped and the next one is started. It is also run when a
+// conversion can't be started, which is retried after the typical conversion time. Running out of
+// soft timers isn't a fault: the wait is counted in the stats and retried from the next event
+// passed to |mcp3427_process_event|.
 StatusCode mcp3427_register_fault_callback(Mcp3427Storage *storage, Mcp3427FaultCallback callback,
                                            void *context);
 
@@ -111,3 +143,6 @@ StatusCode mcp3427_start(Mcp3427Storage *storage);
 
 // Process an event. All projects using this driver must call this in the main event loop.
 StatusCode mcp3427_process_event(Event *e);
+
+// Get the conversion counts and the achieved sample rate.
+StatusCode mcp3427_get_stats(Mcp3427Storage *storage, Mcp3427Stats *stats);
@@ -17,4 +17,21 @@
 
 #define MCP3427_DATA_MASK_N_BIT(N) ((1 << N) - 1)
 
-#define MCP3427_MAX_CONV_TIME_MS 50
+// Typical conversion times at each sample rate, see page 1 of manual
+#define MCP3427_CONV_TIME_12_BIT_US 4167   // 240 samples/second
+#define MCP3427_CONV_TIME_14_BIT_US 16667  // 60 samples/second
+#define MCP3427_CONV_TIME_16_BIT_US 66667  // 15 samples/second
+
+// A conversion is a fault once it takes this much longer than typical - the slowest rates allowed
+// by the datasheet are 176, 44, and 11 samples/second
+#define MCP3427_CONV_TIMEOUT_NUM 3
+#define MCP3427_CONV_TIMEOUT_DEN 2
+
+// The first poll never comes earlier than this fraction of the typical conversion time, and polls
+// that find the conversion still in progress start at this fraction and double
+#define MCP3427_MIN_CONV_TIME_DIV 2
+#define MCP3427_POLL_BACKOFF_DIV 16
+// After a conversion is ready on the first poll, the next first poll comes this fraction sooner
+#define MCP3427_CONV_TIME_PROBE_DIV 128
+
+#define MCP3427_STATS_WINDOW_US 1000000
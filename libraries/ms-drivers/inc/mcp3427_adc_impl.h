@@ -0,0 +1,12 @@
+#pragma once
+// Chip access for the MCP3427 driver
+//
+// This module is only exposed for the driver. Do not use functions in this module directly.
+#include "mcp3427_adc.h"
+
+// Writes |storage->config|, which starts a conversion on the selected channel.
+StatusCode mcp3427_impl_write_config(Mcp3427Storage *storage);
+
+// Reads the latest conversion into |data| and the config/status byte, including the ready bit,
+// into |config|.
+StatusCode mcp3427_impl_read(Mcp3427Storage *storage, uint16_t *data, uint8_t *config);
@@ -15,6 +15,7 @@ $(T)_test_ads1259_adc_MOCKS := spi_exchange
 $(T)_test_adt7476a_fan_controller_MOCKS := i2c_write i2c_read_reg
 $(T)_test_bts7200_load_switch_MOCKS := adc_read_converted
 $(T)_test_bts7040_load_switch_MOCKS := adc_read_converted
+$(T)_test_mcp3427_adc_MOCKS := mcp3427_impl_write_config soft_timer_start
 endif
 
 $(T)_test_voltage_regulator_MOCKS := gpio_get_state
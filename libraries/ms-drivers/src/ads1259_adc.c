@@ -4,7 +4,6 @@
 #include "delay.h"
 #include "interrupt.h"
 #include "log.h"
-#include "math.h"
 #include "soft_timer.h"
 
 // Used to determine length of time needed between convert command sent and data collection
@@ -14,11 +13,28 @@ static const uint32_t s_conversion_time_ms_lookup[NUM_ADS1259_DATA_RATE] = {
   [ADS1259_DATA_RATE_3600] = 1, [ADS1259_DATA_RATE_14400] = 1,
 };
 
+typedef struct Ads1259Resolution {
+  uint8_t usable_bits;
+  // Microvolts per code of a positive result in Q32 fixed point
+  uint64_t uv_per_code_q32;
+} Ads1259Resolution;
+
+#define ADS1259_RESOLUTION(bits)                                                     \
+  {                                                                                  \
+    .usable_bits = (bits),                                                           \
+    .uv_per_code_q32 = ((uint64_t)EXTERNAL_VREF_UV << 32) / ((1 << ((bits)-1)) - 1), \
+  }
+
 // Number of noise free bits for each sampling rate
-static const uint8_t s_num_usable_bits[NUM_ADS1259_DATA_RATE] = {
-  [ADS1259_DATA_RATE_10] = 21,   [ADS1259_DATA_RATE_17] = 21,    [ADS1259_DATA_RATE_50] = 20,
-  [ADS1259_DATA_RATE_60] = 20,   [ADS1259_DATA_RATE_400] = 19,   [ADS1259_DATA_RATE_1200] = 18,
-  [ADS1259_DATA_RATE_3600] = 17, [ADS1259_DATA_RATE_14400] = 16,
+static const Ads1259Resolution s_resolution[NUM_ADS1259_DATA_RATE] = {
+  [ADS1259_DATA_RATE_10] = ADS1259_RESOLUTION(21),
+  [ADS1259_DATA_RATE_17] = ADS1259_RESOLUTION(21),
+  [ADS1259_DATA_RATE_50] = ADS1259_RESOLUTION(20),
+  [ADS1259_DATA_RATE_60] = ADS1259_RESOLUTION(20),
+  [ADS1259_DATA_RATE_400] = ADS1259_RESOLUTION(19),
+  [ADS1259_DATA_RATE_1200] = ADS1259_RESOLUTION(18),
+  [ADS1259_DATA_RATE_3600] = ADS1259_RESOLUTION(17),
+  [ADS1259_DATA_RATE_14400] = ADS1259_RESOLUTION(16),
 };
 
 // tx spi command to ads1259
@@ -70,15 +86,19 @@ static Ads1259StatusCode prv_checksum(Ads1259Storage *storage) {
 
 // using the amount of noise free bits based on the SPS and VREF calculate analog voltage value
 // 0x000000-0x7FFFFF positive range, 0xFFFFFF - 0x800000 neg range, rightmost is greatest magnitude
+// Integer only: the negative full scale is a power of two, the positive one uses a Q32 scale.
 static void prv_convert_data(Ads1259Storage *storage) {
-  double resolution = pow(2, s_num_usable_bits[ADS1259_DATA_RATE_SPS] - 1);
+  const Ads1259Resolution *resolution = &s_resolution[ADS1259_DATA_RATE_SPS];
+  uint8_t discarded_bits = 24 - resolution->usable_bits;
   if (storage->conv_data.raw & RX_NEG_VOLTAGE_BIT) {
-    storage->reading = 0 - ((RX_MAX_VALUE - storage->conv_data.raw) >>
-                            (24 - s_num_usable_bits[ADS1259_DATA_RATE_SPS])) *
-                               EXTERNAL_VREF_V / resolution;
+    uint64_t code = (RX_MAX_VALUE - storage->conv_data.raw) >> discarded_bits;
+    uint8_t shift = resolution->usable_bits - 1;
+    storage->reading_uv =
+        -(int32_t)((code * EXTERNAL_VREF_UV + ((uint64_t)1 << (shift - 1))) >> shift);
   } else {
-    storage->reading = (storage->conv_data.raw >> (24 - s_num_usable_bits[ADS1259_DATA_RATE_SPS])) *
-                       EXTERNAL_VREF_V / (resolution - 1);
+    uint64_t code = storage->conv_data.raw >> discarded_bits;
+    storage->reading_uv =
+        (int32_t)((code * resolution->uv_per_code_q32 + ((uint64_t)1 << 31)) >> 32);
   }
 }
 
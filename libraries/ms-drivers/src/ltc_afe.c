@@ -41,3 +41,7 @@ bool ltc_afe_process_event(LtcAfeStorage *afe, const Event *e) {
 StatusCode ltc_afe_toggle_cell_discharge(LtcAfeStorage *afe, uint16_t cell, bool discharge) {
   return ltc_afe_impl_toggle_cell_discharge(afe, cell, discharge);
 }
+
+StatusCode ltc_afe_set_cell_discharge(LtcAfeStorage *afe, const bool *discharge, size_t num_cells) {
+  return ltc_afe_impl_set_cell_discharge(afe, discharge, num_cells);
+}
@@ -37,7 +37,7 @@ static void prv_wakeup_idle(LtcAfeStorage *afe) {
     gpio_set_state(&settings->cs, GPIO_STATE_LOW);
     gpio_set_state(&settings->cs, GPIO_STATE_HIGH);
     // Wait for 300us - greater than tWAKE, less than tIDLE
-    delay_us(300);
+    delay_spin_us(300);
   }
 }
 
@@ -165,6 +165,7 @@ static StatusCode prv_write_config(LtcAfeStorage *afe, uint8_t gpio_enable_pins)
     uint16_t overvoltage = 0;
 
     config_packet.devices[curr_device].reg.discharge_bitset = afe->discharge_bitset[curr_device];
+    // Must match LTC_AFE_DISCHARGE_TIMEOUT_MS
     config_packet.devices[curr_device].reg.discharge_timeout = LTC_AFE_DISCHARGE_TIMEOUT_30_S;
 
     config_packet.devices[curr_device].reg.adcopt = ((settings->adc_mode + 1) > 3);
@@ -339,3 +340,23 @@ StatusCode ltc_afe_impl_toggle_cell_discharge(LtcAfeStorage *afe, uint16_t cell,
 
   return STATUS_CODE_OK;
 }
+
+StatusCode ltc_afe_impl_set_cell_discharge(LtcAfeStorage *afe, const bool *discharge,
+                                           size_t num_cells) {
+  if (discharge == NULL || num_cells != afe->settings.num_cells) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  // Cells left out are cleared, so the previous selection never lingers
+  uint16_t discharge_bitset[LTC_AFE_MAX_DEVICES] = { 0 };
+  for (size_t cell = 0; cell < num_cells; cell++) {
+    if (discharge[cell]) {
+      uint16_t actual_cell = afe->discharge_cell_lookup[cell];
+      discharge_bitset[actual_cell / LTC_AFE_MAX_CELLS_PER_DEVICE] |=
+          (1 << (actual_cell % LTC_AFE_MAX_CELLS_PER_DEVICE));
+    }
+  }
+  memcpy(afe->discharge_bitset, discharge_bitset, sizeof(afe->discharge_bitset));
+
+  return STATUS_CODE_OK;
+}
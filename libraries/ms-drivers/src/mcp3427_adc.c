@@ -0,0 +1,303 @@
+#include "mcp3427_adc.h"
+
+#include <stddef.h>
+
+#include "log.h"
+#include "mcp3427_adc_defs.h"
+#include "mcp3427_adc_impl.h"
+#include "soft_timer.h"
+
+// Note: we always read from both channels before reporting. If timing is an issue, an optimization
+// for boards (i.e. solar) using only one channel is to only read that channel.
+
+#define NUM_MCP3427_CHIP_IDS (1 << 4)
+
+// A lookup table of MCP3427 chip IDs (see |prv_get_chip_identifier|) to their storages,
+// used to automagically direct events to the correct storage in |mcp3427_process_event|.
+// This saves having to pass each event to every MCP3427.
+static Mcp3427Storage *s_id_to_storage_cache[NUM_MCP3427_CHIP_IDS] = { 0 };
+
+static const uint32_t s_conv_time_lookup[] = {
+  [MCP3427_SAMPLE_RATE_12_BIT] = MCP3427_CONV_TIME_12_BIT_US,  //
+  [MCP3427_SAMPLE_RATE_14_BIT] = MCP3427_CONV_TIME_14_BIT_US,  //
+  [MCP3427_SAMPLE_RATE_16_BIT] = MCP3427_CONV_TIME_16_BIT_US,  //
+};
+
+// Lookup table for selected address. See manual table 5-3.
+static uint8_t s_addr_lookup[NUM_MCP3427_PIN_STATES][NUM_MCP3427_PIN_STATES] = {
+  { 0x0, 0x1, 0x2 },
+  { 0x3, 0x0, 0x7 },
+  { 0x4, 0x5, 0x6 },
+};
+
+static uint8_t prv_get_chip_identifier(Mcp3427Storage *storage) {
+  // Used to gate events we raised to only this MCP3427.
+  // ID is 4 bits, with the "base address" (the 3 least significant bits of the I2C address) as the
+  // most significant bits and the I2C port encoded as the LSB.
+  uint8_t base_addr = storage->addr ^ (MCP3427_DEVICE_CODE << 3);
+  return (base_addr << 1) | (storage->port == I2C_PORT_1 ? 0 : 1);
+}
+
+static int16_t prv_normalize_conversion_result(Mcp3427Storage *storage, uint16_t raw) {
+  // shift it to the full 16 bits - this preserves the sign bit
+  uint16_t scaled;
+  switch (storage->sample_rate) {
+    case MCP3427_SAMPLE_RATE_12_BIT:
+      scaled = raw << 4;
+      break;
+    case MCP3427_SAMPLE_RATE_14_BIT:
+      scaled = raw << 2;
+      break;
+    case MCP3427_SAMPLE_RATE_16_BIT:
+    default:
+      scaled = raw;
+      break;
+  }
+  // convert to the signed value
+  return (int16_t)scaled;
+}
+
+static void prv_fault(Mcp3427Storage *storage) {
+  storage->stats.faults++;
+  if (storage->fault_callback != NULL) {
+    storage->fault_callback(storage->fault_context);
+  }
+}
+
+static void prv_raise_ready(SoftTimerId timer_id, void *context) {
+  Mcp3427Storage *storage = context;
+  event_raise(storage->data_ready_event, prv_get_chip_identifier(storage));
+}
+
+static void prv_raise_trigger(SoftTimerId timer_id, void *context) {
+  Mcp3427Storage *storage = context;
+  event_raise(storage->data_trigger_event, prv_get_chip_identifier(storage));
+}
+
+// Starts a soft timer for the remaining wait. Returns false if none is free.
+static bool prv_start_wait(Mcp3427Storage *storage) {
+  uint32_t waited_us = soft_timer_now_us() - storage->wait_start_us;
+  if (waited_us >= storage->wait_us) {
+    // Already waited long enough, so the soft timer would only add its minimum time
+    SoftTimerCallback callback = storage->wait_callback;
+    storage->wait_callback = NULL;
+    callback(SOFT_TIMER_INVALID_TIMER, storage);
+    return true;
+  }
+
+  uint32_t remaining_us = storage->wait_us - waited_us;
+  if (remaining_us < SOFT_TIMER_MIN_TIME_US) {
+    remaining_us = SOFT_TIMER_MIN_TIME_US;
+  }
+  if (!status_ok(soft_timer_start(remaining_us, storage->wait_callback, storage, NULL))) {
+    return false;
+  }
+  storage->wait_callback = NULL;
+  return true;
+}
+
+// Runs |callback| after |delay_us|. If there's no soft timer free, the wait is retried from the
+// next processed event rather than cutting it short, since polling early would only run out of
+// timers again.
+static void prv_schedule(Mcp3427Storage *storage, uint32_t delay_us, SoftTimerCallback callback) {
+  storage->wait_start_us = soft_timer_now_us();
+  storage->wait_us = delay_us;
+  storage->wait_callback = callback;
+  if (!prv_start_wait(storage)) {
+    LOG_WARN("MCP3427 ADC: Out of soft timers.\n");
+    storage->stats.timer_retries++;
+  }
+}
+
+static void prv_update_stats(Mcp3427Storage *storage, uint32_t now_us) {
+  storage->stats.conversions++;
+  storage->stats_window_conversions++;
+
+  uint32_t window_us = now_us - storage->stats_window_start_us;
+  if (window_us >= MCP3427_STATS_WINDOW_US) {
+    storage->stats.samples_per_sec =
+        (uint32_t)((uint64_t)storage->stats_window_conversions * 1000000 / window_us);
+    storage->stats_window_start_us = now_us;
+    storage->stats_window_conversions = 0;
+  }
+}
+
+// Learns when to first poll from when the conversion actually finished
+static void prv_update_expected_conversion(Mcp3427Storage *storage, uint32_t elapsed_us) {
+  uint32_t typical_us = s_conv_time_lookup[storage->sample_rate];
+  if (storage->conversion_polls == 0) {
+    // Ready on the first poll, so it may have been ready earlier - try polling a bit sooner
+    uint32_t probe_us = storage->expected_conversion_us / MCP3427_CONV_TIME_PROBE_DIV;
+    storage->expected_conversion_us -= probe_us;
+    if (storage->expected_conversion_us < typical_us / MCP3427_MIN_CONV_TIME_DIV) {
+      storage->expected_conversion_us = typical_us / MCP3427_MIN_CONV_TIME_DIV;
+    }
+  } else {
+    storage->expected_conversion_us = elapsed_us;
+  }
+}
+
+// Switches channels and starts a conversion, then schedules the first poll.
+static void prv_trigger(Mcp3427Storage *storage) {
+  // We want to trigger a read. So we set the ready bit.
+  // If operating in continuous conversion mode, setting this bit has no effect.
+  storage->config |= MCP3427_RDY_MASK;
+  // Setting the current channel we want to read from. We just flip it from the previous read.
+  Mcp3427Channel channel =
+      storage->current_channel == MCP3427_CHANNEL_1 ? MCP3427_CHANNEL_2 : MCP3427_CHANNEL_1;
+  storage->config &= (uint8_t)~(1 << MCP3427_CH_SEL_OFFSET);
+  storage->config |= channel << MCP3427_CH_SEL_OFFSET;
+
+  storage->conversion_start_us = soft_timer_now_us();
+  storage->conversion_polls = 0;
+  storage->poll_backoff_us = s_conv_time_lookup[storage->sample_rate] / MCP3427_POLL_BACKOFF_DIV;
+
+  if (mcp3427_impl_write_config(storage) != STATUS_CODE_OK) {
+    LOG_WARN("MCP3427 ADC: Failed to start a conversion.\n");
+    prv_fault(storage);
+    // Try the same channel again once a conversion would have finished
+    prv_schedule(storage, s_conv_time_lookup[storage->sample_rate], prv_raise_trigger);
+    return;
+  }
+
+  storage->current_channel = channel;
+  prv_schedule(storage, storage->expected_conversion_us, prv_raise_ready);
+}
+
+static void prv_poll(Mcp3427Storage *storage) {
+  uint16_t sensor_data = 0;
+  uint8_t config = MCP3427_RDY_MASK;
+  StatusCode status = mcp3427_impl_read(storage, &sensor_data, &config);
+  uint32_t elapsed_us = soft_timer_now_us() - storage->conversion_start_us;
+
+  // The ready bit is cleared once the latest conversion is in
+  if (status != STATUS_CODE_OK || (config & MCP3427_RDY_MASK)) {
+    uint32_t timeout_us = s_conv_time_lookup[storage->sample_rate] * MCP3427_CONV_TIMEOUT_NUM /
+                          MCP3427_CONV_TIMEOUT_DEN;
+    if (elapsed_us < timeout_us) {
+      storage->stats.early_polls++;
+      storage->conversion_polls++;
+      prv_schedule(storage, storage->poll_backoff_us, prv_raise_ready);
+      storage->poll_backoff_us *= 2;
+      return;
+    }
+
+    LOG_WARN("MCP3427 ADC: Conversion not ready after %lu us.\n", (unsigned long)elapsed_us);
+    // Start over from the typical time rather than what was learned
+    storage->expected_conversion_us = s_conv_time_lookup[storage->sample_rate];
+    prv_fault(storage);
+    prv_trigger(storage);
+    return;
+  }
+
+  prv_update_expected_conversion(storage, elapsed_us);
+  prv_update_stats(storage, storage->conversion_start_us + elapsed_us);
+
+  storage->sensor_data[storage->current_channel] = sensor_data;
+  if (storage->current_channel == MCP3427_CHANNEL_2 && storage->callback != NULL) {
+    // We have all the data ready.
+    int16_t normalized_0 = prv_normalize_conversion_result(storage, storage->sensor_data[0]);
+    int16_t normalized_1 = prv_normalize_conversion_result(storage, storage->sensor_data[1]);
+    storage->callback(normalized_0, normalized_1, storage->context);
+  }
+
+  // Go straight to the next conversion rather than through the event queue
+  prv_trigger(storage);
+}
+
+StatusCode mcp3427_init(Mcp3427Storage *storage, Mcp3427Settings *settings) {
+  if (storage == NULL || settings == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  storage->data_ready_event = settings->adc_data_ready_event;
+  storage->data_trigger_event = settings->adc_data_trigger_event;
+  storage->sample_rate = settings->sample_rate;
+  storage->port = settings->port;
+  storage->addr =
+      s_addr_lookup[settings->addr_pin_0][settings->addr_pin_1] | (MCP3427_DEVICE_CODE << 3);
+
+  // Cache the storage for lookup in |mcp3427_process_event|
+  s_id_to_storage_cache[prv_get_chip_identifier(storage)] = storage;
+
+  // Ready to switch to channel 1 on the first trigger
+  storage->current_channel = MCP3427_CHANNEL_2;
+  storage->expected_conversion_us = s_conv_time_lookup[storage->sample_rate];
+  storage->wait_callback = NULL;
+  storage->stats = (Mcp3427Stats){ 0 };
+  storage->stats_window_start_us = soft_timer_now_us();
+  storage->stats_window_conversions = 0;
+
+  // Writing configuration to the chip (see section 5.3.3 of manual).
+  // Note: Here, channel gets defaulted to 0.
+  uint8_t config = 0;
+  config |= (settings->conversion_mode << MCP3427_CONVERSION_MODE_OFFSET);
+  config |= (settings->sample_rate << MCP3427_SAMPLE_RATE_OFFSET);
+  config |= (settings->amplifier_gain << MCP3427_GAIN_SEL_OFFSET);
+  storage->config = config;
+
+  return mcp3427_impl_write_config(storage);
+}
+
+StatusCode mcp3427_register_callback(Mcp3427Storage *storage, Mcp3427Callback callback,
+                                     void *context) {
+  if (storage == NULL || callback == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  storage->callback = callback;
+  storage->context = context;
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp3427_register_fault_callback(Mcp3427Storage *storage, Mcp3427FaultCallback callback,
+                                           void *context) {
+  if (storage == NULL || callback == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  storage->fault_callback = callback;
+  storage->fault_context = context;
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp3427_start(Mcp3427Storage *storage) {
+  return event_raise(storage->data_trigger_event, prv_get_chip_identifier(storage));
+}
+
+StatusCode mcp3427_process_event(Event *e) {
+  if (e == NULL) {
+    return STATUS_CODE_INVALID_ARGS;
+  }
+  if (e->data >= NUM_MCP3427_CHIP_IDS) {
+    // not for us
+    return STATUS_CODE_OK;
+  }
+
+  // Waits that couldn't get a soft timer are retried on any event, since they won't raise one
+  for (size_t i = 0; i < NUM_MCP3427_CHIP_IDS; i++) {
+    if (s_id_to_storage_cache[i] != NULL && s_id_to_storage_cache[i]->wait_callback != NULL) {
+      prv_start_wait(s_id_to_storage_cache[i]);
+    }
+  }
+
+  // look up which storage to use
+  Mcp3427Storage *storage = s_id_to_storage_cache[e->data];
+  if (storage == NULL) {
+    // also not for us
+    return STATUS_CODE_OK;
+  }
+
+  if (e->id == storage->data_trigger_event) {
+    prv_trigger(storage);
+  } else if (e->id == storage->data_ready_event) {
+    prv_poll(storage);
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp3427_get_stats(Mcp3427Storage *storage, Mcp3427Stats *stats) {
+  if (storage == NULL || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  *stats = storage->stats;
+  return STATUS_CODE_OK;
+}
@@ -47,7 +47,7 @@ StatusCode pcf8523_get_time(Pcf8523Time *time) {
   if ((time->seconds) & (1 << 7)) {
     LOG_WARN("Clock integrity is not guaranteed; oscillator has stopped or been interrupted\n");
     // Disable 7th bit to ensure we get proper values when converting to decimal
-    time->seconds &= ~(1 << 7);
+    time->seconds &= (uint8_t)~(1 << 7);
   }
   // Store time
   time->seconds = bcd_to_dec(data[0]);
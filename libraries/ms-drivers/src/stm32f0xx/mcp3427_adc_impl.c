@@ -0,0 +1,26 @@
+#include "mcp3427_adc_impl.h"
+
+#include "mcp3427_adc_defs.h"
+
+static uint16_t s_data_mask_lookup[] = {
+  [MCP3427_SAMPLE_RATE_12_BIT] = MCP3427_DATA_MASK_12_BIT,  //
+  [MCP3427_SAMPLE_RATE_14_BIT] = MCP3427_DATA_MASK_14_BIT,  //
+  [MCP3427_SAMPLE_RATE_16_BIT] = MCP3427_DATA_MASK_16_BIT,  //
+};
+
+StatusCode mcp3427_impl_write_config(Mcp3427Storage *storage) {
+  return i2c_write(storage->port, storage->addr, &storage->config, MCP3427_NUM_CONFIG_BYTES);
+}
+
+StatusCode mcp3427_impl_read(Mcp3427Storage *storage, uint16_t *data, uint8_t *config) {
+  uint8_t read_data[MCP3427_NUM_DATA_BYTES] = { 0 };
+  status_ok_or_return(
+      i2c_read(storage->port, storage->addr, read_data, MCP3427_NUM_DATA_BYTES));
+
+  // The first and second bytes contain latest ADC value.
+  // The appropriate number of bits is taken, depending on the sample rate.
+  *data = ((read_data[0] << 8) | read_data[1]) & s_data_mask_lookup[storage->sample_rate];
+  // The third byte is the config/status byte. It contains the ready bit.
+  *config = read_data[2];
+  return STATUS_CODE_OK;
+}
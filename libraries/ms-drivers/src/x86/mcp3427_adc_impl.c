@@ -0,0 +1,32 @@
+#include "mcp3427_adc_impl.h"
+
+#include "mcp3427_adc_defs.h"
+#include "soft_timer.h"
+
+// x86 emulation of the MCP3427. Conversions take the typical time for the sample rate and return a
+// fixed value for both channels.
+// For a more advanced simulation we could probabilistically miss conversions, but that would be
+// hard to unit test.
+
+#define FIXED_RESULT 20
+
+static const uint32_t s_conv_time_lookup[] = {
+  [MCP3427_SAMPLE_RATE_12_BIT] = MCP3427_CONV_TIME_12_BIT_US,  //
+  [MCP3427_SAMPLE_RATE_14_BIT] = MCP3427_CONV_TIME_14_BIT_US,  //
+  [MCP3427_SAMPLE_RATE_16_BIT] = MCP3427_CONV_TIME_16_BIT_US,  //
+};
+
+StatusCode mcp3427_impl_write_config(Mcp3427Storage *storage) {
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp3427_impl_read(Mcp3427Storage *storage, uint16_t *data, uint8_t *config) {
+  *data = FIXED_RESULT;
+  *config = storage->config & (uint8_t)~MCP3427_RDY_MASK;
+  // The conversion started when the config was written
+  if (soft_timer_now_us() - storage->conversion_start_us <
+      s_conv_time_lookup[storage->sample_rate]) {
+    *config |= MCP3427_RDY_MASK;
+  }
+  return STATUS_CODE_OK;
+}
@@ -3,7 +3,6 @@
 #include "gpio.h"
 #include "interrupt.h"
 #include "log.h"
-#include "math.h"
 #include "soft_timer.h"
 #include "test_helpers.h"
 #include "unity.h"
@@ -213,35 +212,35 @@ void test_ads1259_get_conversion_data() {
   delay_ms(TEST_DATA_SETTLING_TIME_MS);
   TEST_ASSERT_EQUAL(0xFF, s_storage.conv_data.LSB | s_storage.conv_data.MID);
   TEST_ASSERT_EQUAL(0x7F, s_storage.conv_data.MSB);
-  // Math changed as a result of hardware testing, so assertions on s_storage.reading are wrong.
-  // TEST_ASSERT_EQUAL(test_raw, s_storage.conv_data.raw);
-  // TEST_ASSERT_EQUAL((test_raw >> 4) * EXTERNAL_VREF_V / (pow(2, 19) - 1), s_storage.reading);
-  // TEST_ASSERT_EQUAL(50, s_storage.reading);
+  TEST_ASSERT_EQUAL(test_raw, s_storage.conv_data.raw);
+  // 20 noise free bits at 60 SPS: full scale is exactly the reference
+  TEST_ASSERT_EQUAL_INT32(EXTERNAL_VREF_UV, s_storage.reading_uv);
 
   // test with max neg data
   s_test_mode = ADS1259_MODE_MAX_NEG_DATA;
   test_raw = 0x800000;
   ads1259_get_conversion_data(&s_storage);
   delay_ms(TEST_DATA_SETTLING_TIME_MS);
-  // TEST_ASSERT_EQUAL(-50, s_storage.reading);
+  TEST_ASSERT_EQUAL_INT32(-EXTERNAL_VREF_UV, s_storage.reading_uv);
 
   // test with min readable pos data
   s_test_mode = ADS1259_MODE_MIN_POS_DATA;
   ads1259_get_conversion_data(&s_storage);
   delay_ms(TEST_DATA_SETTLING_TIME_MS);
-  // TEST_ASSERT_EQUAL(0.000095, s_storage.reading);
+  // one code is 2.5 V / (2^19 - 1) = 4.77 uV
+  TEST_ASSERT_EQUAL_INT32(5, s_storage.reading_uv);
 
   // test with min readable neg data
   s_test_mode = ADS1259_MODE_MIN_NEG_DATA;
   ads1259_get_conversion_data(&s_storage);
   delay_ms(TEST_DATA_SETTLING_TIME_MS);
-  // TEST_ASSERT_EQUAL(-0.000095, s_storage.reading);
+  TEST_ASSERT_EQUAL_INT32(-5, s_storage.reading_uv);
 
   // test with zero data
   s_test_mode = ADS1259_MODE_ZERO_DATA;
   ads1259_get_conversion_data(&s_storage);
   delay_ms(TEST_DATA_SETTLING_TIME_MS);
-  // TEST_ASSERT_EQUAL(0, s_storage.reading);
+  TEST_ASSERT_EQUAL_INT32(0, s_storage.reading_uv);
 
   // test with a random data set
   s_test_mode = ADS1259_MODE_MIXED_DATA;
@@ -252,7 +251,8 @@ void test_ads1259_get_conversion_data() {
   TEST_ASSERT_EQUAL(0x20, s_storage.conv_data.MID);
   TEST_ASSERT_EQUAL(0x30, s_storage.conv_data.LSB);
   TEST_ASSERT_EQUAL(test_raw, s_storage.conv_data.raw);
-  // TEST_ASSERT_EQUAL(6.299126, s_storage.reading);
+  // 0x10203 * 2.5 V / (2^19 - 1) = 314956.3 uV
+  TEST_ASSERT_EQUAL_INT32(314956, s_storage.reading_uv);
 
   // test checksum fault triggered
   s_test_mode = ADS1259_MODE_CHECKSUM_FAULT;
@@ -213,3 +213,26 @@ void test_ltc_afe_toggle_discharge_cells_mapping(void) {
     TEST_ASSERT_EQUAL(1u, ((uint16_t)(s_afe.discharge_bitset[device] >> device_module)) & 1u);
   }
 }
+
+void test_ltc_afe_set_cell_discharge(void) {
+  bool discharge[TEST_LTC_AFE_NUM_CELLS] = { 0 };
+  uint16_t enable_modules[] = { 0u, 4u, 7u };
+
+  // Anything set before is replaced
+  TEST_ASSERT_OK(ltc_afe_toggle_cell_discharge(&s_afe, 2u, true));
+  for (size_t i = 0u; i < SIZEOF_ARRAY(enable_modules); ++i) {
+    discharge[enable_modules[i]] = true;
+  }
+  TEST_ASSERT_OK(ltc_afe_set_cell_discharge(&s_afe, discharge, TEST_LTC_AFE_NUM_CELLS));
+
+  for (uint16_t cell = 0u; cell < TEST_LTC_AFE_NUM_CELLS; ++cell) {
+    uint16_t physical_index = s_afe.discharge_cell_lookup[cell];
+    uint16_t device = physical_index / LTC_AFE_MAX_CELLS_PER_DEVICE;
+    uint16_t device_module = physical_index % LTC_AFE_MAX_CELLS_PER_DEVICE;
+    TEST_ASSERT_EQUAL(discharge[cell],
+                      ((uint16_t)(s_afe.discharge_bitset[device] >> device_module)) & 1u);
+  }
+
+  TEST_ASSERT_NOT_OK(ltc_afe_set_cell_discharge(&s_afe, discharge, TEST_LTC_AFE_NUM_CELLS - 1));
+  TEST_ASSERT_NOT_OK(ltc_afe_set_cell_discharge(&s_afe, NULL, TEST_LTC_AFE_NUM_CELLS));
+}
@@ -44,6 +44,30 @@ static void *s_callback_context = NULL;
 static uint16_t s_times_fault_callback_called = 0;
 static void *s_fault_callback_context = NULL;
 
+// How many config writes and soft timers fail before they work again
+static uint8_t s_write_failures = 0;
+static uint8_t s_timer_failures = 0;
+
+StatusCode TEST_MOCK(mcp3427_impl_write_config)(Mcp3427Storage *storage) {
+  if (s_write_failures > 0) {
+    s_write_failures--;
+    return status_code(STATUS_CODE_INTERNAL_ERROR);
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode __real_soft_timer_start(uint32_t duration_us, SoftTimerCallback callback,
+                                   void *context, SoftTimerId *timer_id);
+
+StatusCode TEST_MOCK(soft_timer_start)(uint32_t duration_us, SoftTimerCallback callback,
+                                       void *context, SoftTimerId *timer_id) {
+  if (s_timer_failures > 0) {
+    s_timer_failures--;
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  return __real_soft_timer_start(duration_us, callback, context, timer_id);
+}
+
 static void prv_callback(int16_t value_ch1, int16_t value_ch2, void *context) {
   LOG_DEBUG("Callback called: value_ch1=%d, value_ch2=%d\n", value_ch1, value_ch2);
   s_times_callback_called++;
@@ -72,243 +96,246 @@ void setup_test(void) {
   s_times_fault_callback_called = 0;
   s_callback_context = NULL;
   s_fault_callback_context = NULL;
+  s_write_failures = 0;
+  s_timer_failures = 0;
 }
 void teardown_test(void) {}
 
-// Test a single data fetching round (2 conversions) in the current MCP3427 settings.
-static void prv_test_data_round(Mcp3427Storage *storage, Event *e, void *callback_context) {
-  // triggering CH1 conversion, a data ready event should be raised in MCP3427_MAX_CONV_TIME_MS
-  TEST_ASSERT_OK(mcp3427_process_event(e));
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  delay_ms(MCP3427_MAX_CONV_TIME_MS);
-  TEST_ASSERT_EVENT_WITH_ID(*e, TEST_MCP3427_DATA_READY_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(0, s_times_callback_called);  // callback not called yet
+// Longest a round of both channels at 16 bits can take without faulting, plus some slack
+#define TEST_ROUND_TIMEOUT_US (4 * MCP3427_CONV_TIME_16_BIT_US)
+
+static Mcp3427Settings s_settings = {
+  .addr_pin_0 = TEST_ADDR_PIN_0,
+  .addr_pin_1 = TEST_ADDR_PIN_1,
+  .amplifier_gain = TEST_AMP_GAIN,
+  .port = TEST_I2C_PORT,
+  .adc_data_ready_event = TEST_MCP3427_DATA_READY_EVENT,
+  .adc_data_trigger_event = TEST_MCP3427_DATA_TRIGGER_EVENT,
+};
+
+// Processes events until the callback has been called |num_callbacks| times in total or
+// |timeout_us| passes. Returns how long it took.
+static uint32_t prv_run_until_callbacks(uint16_t num_callbacks, uint32_t timeout_us) {
+  uint32_t start_us = soft_timer_now_us();
+  Event e = { 0 };
+  while (s_times_callback_called < num_callbacks && soft_timer_now_us() - start_us < timeout_us) {
+    if (event_process(&e) == STATUS_CODE_OK) {
+      TEST_ASSERT_OK(mcp3427_process_event(&e));
+    }
+  }
+  return soft_timer_now_us() - start_us;
+}
 
-  // reading CH1 data, a data trigger event should be raised immediately
-  TEST_ASSERT_OK(mcp3427_process_event(e));
-  TEST_ASSERT_EVENT_WITH_ID(*e, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(0, s_times_callback_called);  // callback not called yet, only CH1 read
+// Test a single data fetching round (2 conversions) in the given settings.
+static void prv_test_data_round(Mcp3427SampleRate sample_rate, Mcp3427ConversionMode mode,
+                                uint32_t conv_time_us) {
+  s_settings.sample_rate = sample_rate;
+  s_settings.conversion_mode = mode;
+  Mcp3427Storage storage;
+  uint8_t callback_context, fault_context;
+  TEST_ASSERT_OK(mcp3427_init(&storage, &s_settings));
+  TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, &callback_context));
+  TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage, prv_fault_callback, &fault_context));
 
-  // triggering CH2 conversion, data ready event raised in MCP3427_MAX_CONV_TIME_MS
-  TEST_ASSERT_OK(mcp3427_process_event(e));
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  delay_ms(MCP3427_MAX_CONV_TIME_MS);
-  TEST_ASSERT_EVENT_WITH_ID(*e, TEST_MCP3427_DATA_READY_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(0, s_times_callback_called);  // callback not called yet
+  TEST_ASSERT_OK(mcp3427_start(&storage));
+  uint32_t elapsed_us = prv_run_until_callbacks(1, TEST_ROUND_TIMEOUT_US);
+  LOG_DEBUG("Round took %lu us\n", (unsigned long)elapsed_us);
 
-  // reading CH2 data, callback called and data trigger event raised
-  TEST_ASSERT_OK(mcp3427_process_event(e));
-  TEST_ASSERT_EVENT_WITH_ID(*e, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(1, s_times_callback_called);            // callback called since it's CH2
-  TEST_ASSERT_EQUAL(callback_context, s_callback_context);  // context was passed
+  TEST_ASSERT_EQUAL(1, s_times_callback_called);
+  TEST_ASSERT_EQUAL(&callback_context, s_callback_context);
+  TEST_ASSERT_TRUE(elapsed_us >= 2 * conv_time_us);
 
   // the fault callback shouldn't have been called ever
   TEST_ASSERT_EQUAL(0, s_times_fault_callback_called);
   TEST_ASSERT_EQUAL(NULL, s_fault_callback_context);
 }
 
-// Test initialization and that the callback is called when it's supposed to be without faults.
-// 12 bit/continuous is the fastest speed, so failure on STM32 means something's very wrong.
-// This also serves as a comprehensive happy-path test.
-void test_12_bit_continuous_sampling_and_multiple_rounds(void) {
+// Test the events raised over a round: each conversion is polled once its typical time has passed
+// and the next one starts right away, without going through a trigger event.
+void test_one_event_per_conversion(void) {
   Event e = { 0 };
-  Mcp3427Settings settings = {
-    .sample_rate = MCP3427_SAMPLE_RATE_12_BIT,
-    .conversion_mode = MCP3427_CONVERSION_MODE_CONTINUOUS,
-    .addr_pin_0 = TEST_ADDR_PIN_0,
-    .addr_pin_1 = TEST_ADDR_PIN_1,
-    .amplifier_gain = TEST_AMP_GAIN,
-    .port = TEST_I2C_PORT,
-    .adc_data_ready_event = TEST_MCP3427_DATA_READY_EVENT,
-    .adc_data_trigger_event = TEST_MCP3427_DATA_TRIGGER_EVENT,
-  };
+  s_settings.sample_rate = MCP3427_SAMPLE_RATE_14_BIT;
+  s_settings.conversion_mode = MCP3427_CONVERSION_MODE_ONE_SHOT;
   Mcp3427Storage storage;
-  TEST_ASSERT_OK(mcp3427_init(&storage, &settings));
-
-  // arbitrary variables to serve as contexts
-  uint8_t callback_context, fault_context;
-
-  TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, &callback_context));
-  TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage, prv_fault_callback, &fault_context));
+  TEST_ASSERT_OK(mcp3427_init(&storage, &s_settings));
+  TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, NULL));
 
   // start it and process the initial event
   TEST_ASSERT_OK(mcp3427_start(&storage));
   TEST_ASSERT_EVENT_WITH_ID(e, TEST_MCP3427_DATA_TRIGGER_EVENT);
+  TEST_ASSERT_OK(mcp3427_process_event(&e));
   MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
 
-  // test two rounds to make sure the loop succeeds
-  prv_test_data_round(&storage, &e, &callback_context);
-  LOG_DEBUG("Data round 1 succeeded\n");
-  s_callback_context = NULL;  // reset between rounds
-  s_times_callback_called = 0;
-  prv_test_data_round(&storage, &e, &callback_context);
-  LOG_DEBUG("Data round 2 succeeded\n");
+  // CH1 is polled once its conversion is done, then CH2 starts immediately
+  delay_us(MCP3427_CONV_TIME_14_BIT_US + 1000);
+  TEST_ASSERT_EVENT_WITH_ID(e, TEST_MCP3427_DATA_READY_EVENT);
+  TEST_ASSERT_OK(mcp3427_process_event(&e));
+  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
+  TEST_ASSERT_EQUAL(0, s_times_callback_called);
+
+  // CH2 polled, so the callback is called
+  delay_us(MCP3427_CONV_TIME_14_BIT_US + 1000);
+  TEST_ASSERT_EVENT_WITH_ID(e, TEST_MCP3427_DATA_READY_EVENT);
+  TEST_ASSERT_OK(mcp3427_process_event(&e));
+  TEST_ASSERT_EQUAL(1, s_times_callback_called);
+
+  Mcp3427Stats stats = { 0 };
+  TEST_ASSERT_OK(mcp3427_get_stats(&storage, &stats));
+  TEST_ASSERT_EQUAL(2, stats.conversions);
+  TEST_ASSERT_EQUAL(0, stats.early_polls);
+  TEST_ASSERT_EQUAL(0, stats.faults);
+}
+
+// Test initialization and that the callback is called when it's supposed to be without faults.
+// 12 bit/continuous is the fastest speed, so failure on STM32 means something's very wrong.
+void test_12_bit_continuous_sampling(void) {
+  prv_test_data_round(MCP3427_SAMPLE_RATE_12_BIT, MCP3427_CONVERSION_MODE_CONTINUOUS,
+                      MCP3427_CONV_TIME_12_BIT_US);
 }
 
 // Test a data conversion round with 16-bit continuous sampling.
 // This is the slowest continuous speed, so succeeding on STM32 means all continuous speeds work.
 void test_16_bit_continuous_sampling(void) {
-  Event e = { 0 };
-  Mcp3427Settings settings = {
-    .sample_rate = MCP3427_SAMPLE_RATE_16_BIT,
-    .conversion_mode = MCP3427_CONVERSION_MODE_CONTINUOUS,
-    .addr_pin_0 = TEST_ADDR_PIN_0,
-    .addr_pin_1 = TEST_ADDR_PIN_1,
-    .amplifier_gain = TEST_AMP_GAIN,
-    .port = TEST_I2C_PORT,
-    .adc_data_ready_event = TEST_MCP3427_DATA_READY_EVENT,
-    .adc_data_trigger_event = TEST_MCP3427_DATA_TRIGGER_EVENT,
-  };
-  Mcp3427Storage storage;
-  TEST_ASSERT_OK(mcp3427_init(&storage, &settings));
-
-  TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, NULL));
-  TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage, prv_fault_callback, NULL));
-
-  // start it and process the initial event
-  TEST_ASSERT_OK(mcp3427_start(&storage));
-  TEST_ASSERT_EVENT_WITH_ID(e, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-
-  prv_test_data_round(&storage, &e, NULL);
+  prv_test_data_round(MCP3427_SAMPLE_RATE_16_BIT, MCP3427_CONVERSION_MODE_CONTINUOUS,
+                      MCP3427_CONV_TIME_16_BIT_US);
 }
 
 // Test a data conversion round with 12-bit one-shot sampling.
 // This is the fastest one-shot speed, so failure on STM32 means no one-shot speed will work.
 void test_12_bit_one_shot_sampling(void) {
-  Event e = { 0 };
-  Mcp3427Settings settings = {
-    .sample_rate = MCP3427_SAMPLE_RATE_12_BIT,
-    .conversion_mode = MCP3427_CONVERSION_MODE_ONE_SHOT,
-    .addr_pin_0 = TEST_ADDR_PIN_0,
-    .addr_pin_1 = TEST_ADDR_PIN_1,
-    .amplifier_gain = TEST_AMP_GAIN,
-    .port = TEST_I2C_PORT,
-    .adc_data_ready_event = TEST_MCP3427_DATA_READY_EVENT,
-    .adc_data_trigger_event = TEST_MCP3427_DATA_TRIGGER_EVENT,
-  };
-  Mcp3427Storage storage;
-  TEST_ASSERT_OK(mcp3427_init(&storage, &settings));
-
-  TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, NULL));
-  TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage, prv_fault_callback, NULL));
-
-  // start it and process the initial event
-  TEST_ASSERT_OK(mcp3427_start(&storage));
-  TEST_ASSERT_EVENT_WITH_ID(e, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-
-  prv_test_data_round(&storage, &e, NULL);
+  prv_test_data_round(MCP3427_SAMPLE_RATE_12_BIT, MCP3427_CONVERSION_MODE_ONE_SHOT,
+                      MCP3427_CONV_TIME_12_BIT_US);
 }
 
 // Test a data conversion round with 16-bit one-shot sampling.
 // This is the slowest one-shot speed, so succeeding on STM32 means all one-shot speeds work.
 void test_16_bit_one_shot_sampling(void) {
-  Event e = { 0 };
-  Mcp3427Settings settings = {
-    .sample_rate = MCP3427_SAMPLE_RATE_16_BIT,
-    .conversion_mode = MCP3427_CONVERSION_MODE_ONE_SHOT,
-    .addr_pin_0 = TEST_ADDR_PIN_0,
-    .addr_pin_1 = TEST_ADDR_PIN_1,
-    .amplifier_gain = TEST_AMP_GAIN,
-    .port = TEST_I2C_PORT,
-    .adc_data_ready_event = TEST_MCP3427_DATA_READY_EVENT,
-    .adc_data_trigger_event = TEST_MCP3427_DATA_TRIGGER_EVENT,
-  };
-  Mcp3427Storage storage;
-  TEST_ASSERT_OK(mcp3427_init(&storage, &settings));
+  prv_test_data_round(MCP3427_SAMPLE_RATE_16_BIT, MCP3427_CONVERSION_MODE_ONE_SHOT,
+                      MCP3427_CONV_TIME_16_BIT_US);
+}
 
+// Test that the sample rate tracks the selected resolution rather than a fixed wait, and that
+// polling adapts to when conversions actually finish.
+void test_samples_per_sec(void) {
+  s_settings.sample_rate = MCP3427_SAMPLE_RATE_12_BIT;
+  s_settings.conversion_mode = MCP3427_CONVERSION_MODE_CONTINUOUS;
+  Mcp3427Storage storage;
+  TEST_ASSERT_OK(mcp3427_init(&storage, &s_settings));
   TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, NULL));
   TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage, prv_fault_callback, NULL));
 
-  // start it and process the initial event
+  // Run for a little over the stats window
   TEST_ASSERT_OK(mcp3427_start(&storage));
-  TEST_ASSERT_EVENT_WITH_ID(e, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-
-  prv_test_data_round(&storage, &e, NULL);
+  prv_run_until_callbacks(UINT16_MAX, MCP3427_STATS_WINDOW_US + 100000);
+
+  Mcp3427Stats stats = { 0 };
+  TEST_ASSERT_OK(mcp3427_get_stats(&storage, &stats));
+  LOG_DEBUG("%lu conversions, %lu early polls, %lu samples/sec\n",
+            (unsigned long)stats.conversions, (unsigned long)stats.early_polls,
+            (unsigned long)stats.samples_per_sec);
+  TEST_ASSERT_EQUAL(0, stats.faults);
+  TEST_ASSERT_EQUAL(0, s_times_fault_callback_called);
+  // Nominally 240 - the old fixed 50ms wait allowed 20
+  TEST_ASSERT_UINT32_WITHIN(90, 200, stats.samples_per_sec);
+  // Learning the conversion time keeps polls that come too early rare
+  TEST_ASSERT_TRUE(stats.early_polls < stats.conversions / 4);
 }
 
-// Test that we can have multiple chips simultaneously and neither interfere with each other.
+// Test that we can have multiple chips simultaneously and neither interfere with each other, and
+// that they convert at the same time rather than one after the other.
 void test_multiple_mcp3427s(void) {
-  Event e1 = { 0 }, e2 = { 0 };
-  Mcp3427Settings settings = {
-    .sample_rate = MCP3427_SAMPLE_RATE_16_BIT,
-    .conversion_mode = MCP3427_CONVERSION_MODE_ONE_SHOT,
-    .addr_pin_0 = TEST_ADDR_PIN_0,
-    .addr_pin_1 = TEST_ADDR_PIN_1,
-    .amplifier_gain = TEST_AMP_GAIN,
-    .port = TEST_I2C_PORT,
-    .adc_data_ready_event = TEST_MCP3427_DATA_READY_EVENT,
-    .adc_data_trigger_event = TEST_MCP3427_DATA_TRIGGER_EVENT,
-  };
+  s_settings.sample_rate = MCP3427_SAMPLE_RATE_16_BIT;
+  s_settings.conversion_mode = MCP3427_CONVERSION_MODE_ONE_SHOT;
   Mcp3427Storage storage1, storage2;
-  TEST_ASSERT_OK(mcp3427_init(&storage1, &settings));
+  TEST_ASSERT_OK(mcp3427_init(&storage1, &s_settings));
 
   // modify for the second MCP3427
-  settings.addr_pin_0 = TEST_SECONDARY_ADDR_PIN_0;
-  settings.addr_pin_1 = TEST_SECONDARY_ADDR_PIN_1;
-  settings.port = TEST_SECONDARY_I2C_PORT;
-  TEST_ASSERT_OK(mcp3427_init(&storage2, &settings));
-
-  TEST_ASSERT_OK(mcp3427_register_callback(&storage1, prv_callback, NULL));
-  TEST_ASSERT_OK(mcp3427_register_callback(&storage2, prv_callback, NULL));
+  Mcp3427Settings settings2 = s_settings;
+  settings2.addr_pin_0 = TEST_SECONDARY_ADDR_PIN_0;
+  settings2.addr_pin_1 = TEST_SECONDARY_ADDR_PIN_1;
+  settings2.port = TEST_SECONDARY_I2C_PORT;
+  TEST_ASSERT_OK(mcp3427_init(&storage2, &settings2));
+
+  uint8_t context1, context2;
+  TEST_ASSERT_OK(mcp3427_register_callback(&storage1, prv_callback, &context1));
+  TEST_ASSERT_OK(mcp3427_register_callback(&storage2, prv_callback, &context2));
   TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage1, prv_fault_callback, NULL));
   TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage2, prv_fault_callback, NULL));
 
   TEST_ASSERT_OK(mcp3427_start(&storage1));
   TEST_ASSERT_OK(mcp3427_start(&storage2));
 
-  // Process the start data trigger events
-  // Passing both events to |mcp3427_process_event| should process both for the appropriate storages
-  TEST_ASSERT_EVENT_WITH_ID(e1, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  TEST_ASSERT_EVENT_WITH_ID(e2, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
+  // Both rounds finish in about the time of one
+  uint32_t elapsed_us = prv_run_until_callbacks(2, TEST_ROUND_TIMEOUT_US);
+  TEST_ASSERT_EQUAL(2, s_times_callback_called);
+  TEST_ASSERT_TRUE(elapsed_us < 3 * MCP3427_CONV_TIME_16_BIT_US);
 
-  // CH1 trigger: wait for data ready event
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_OK(mcp3427_process_event(&e1));
-  TEST_ASSERT_OK(mcp3427_process_event(&e2));
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(0, s_times_callback_called);
-  delay_ms(MCP3427_MAX_CONV_TIME_MS);
-  TEST_ASSERT_EVENT_WITH_ID(e1, TEST_MCP3427_DATA_READY_EVENT);
-  TEST_ASSERT_EVENT_WITH_ID(e2, TEST_MCP3427_DATA_READY_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(0, s_times_callback_called);
+  Mcp3427Stats stats = { 0 };
+  TEST_ASSERT_OK(mcp3427_get_stats(&storage1, &stats));
+  TEST_ASSERT_EQUAL(2, stats.conversions);
+  TEST_ASSERT_OK(mcp3427_get_stats(&storage2, &stats));
+  TEST_ASSERT_EQUAL(2, stats.conversions);
 
-  // CH1 read: data trigger event raised immediately
-  TEST_ASSERT_OK(mcp3427_process_event(&e1));
-  TEST_ASSERT_OK(mcp3427_process_event(&e2));
-  TEST_ASSERT_EVENT_WITH_ID(e1, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  TEST_ASSERT_EVENT_WITH_ID(e2, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(0, s_times_callback_called);  // callback not called yet, only CH1 read
-
-  // CH2 trigger: wait for data ready event
-  TEST_ASSERT_OK(mcp3427_process_event(&e1));
-  TEST_ASSERT_OK(mcp3427_process_event(&e2));
-  delay_ms(MCP3427_MAX_CONV_TIME_MS);
-  TEST_ASSERT_EVENT_WITH_ID(e1, TEST_MCP3427_DATA_READY_EVENT);
-  TEST_ASSERT_EVENT_WITH_ID(e2, TEST_MCP3427_DATA_READY_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
-  TEST_ASSERT_EQUAL(0, s_times_callback_called);
+  // fault callback should have never been called
+  TEST_ASSERT_EQUAL(0, s_times_fault_callback_called);
+}
 
-  // CH2 read: data trigger event raised immediately, callbacks called
-  TEST_ASSERT_OK(mcp3427_process_event(&e1));
+// Test that a conversion that can't be started is reported and retried on the same channel.
+void test_write_config_failure(void) {
+  s_settings.sample_rate = MCP3427_SAMPLE_RATE_12_BIT;
+  s_settings.conversion_mode = MCP3427_CONVERSION_MODE_ONE_SHOT;
+  Mcp3427Storage storage;
+  uint8_t fault_context;
+  TEST_ASSERT_OK(mcp3427_init(&storage, &s_settings));
+  TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, NULL));
+  TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage, prv_fault_callback, &fault_context));
+
+  s_write_failures = 1;
+  TEST_ASSERT_OK(mcp3427_start(&storage));
+  prv_run_until_callbacks(1, TEST_ROUND_TIMEOUT_US);
   TEST_ASSERT_EQUAL(1, s_times_callback_called);
-  TEST_ASSERT_OK(mcp3427_process_event(&e2));
-  TEST_ASSERT_EQUAL(2, s_times_callback_called);  // now both callbacks have been called
-  TEST_ASSERT_EVENT_WITH_ID(e1, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  TEST_ASSERT_EVENT_WITH_ID(e2, TEST_MCP3427_DATA_TRIGGER_EVENT);
-  MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
+  TEST_ASSERT_EQUAL(1, s_times_fault_callback_called);
+  TEST_ASSERT_EQUAL(&fault_context, s_fault_callback_context);
+
+  // Both channels were still read once each
+  Mcp3427Stats stats = { 0 };
+  TEST_ASSERT_OK(mcp3427_get_stats(&storage, &stats));
+  TEST_ASSERT_EQUAL(2, stats.conversions);
+  TEST_ASSERT_EQUAL(1, stats.faults);
+}
 
-  // fault callback should have never been called
+// Test that running out of soft timers isn't a fault, and that the wait is retried from the next
+// event rather than polling right away.
+void test_out_of_soft_timers(void) {
+  s_settings.sample_rate = MCP3427_SAMPLE_RATE_12_BIT;
+  s_settings.conversion_mode = MCP3427_CONVERSION_MODE_ONE_SHOT;
+  Mcp3427Storage storage;
+  TEST_ASSERT_OK(mcp3427_init(&storage, &s_settings));
+  TEST_ASSERT_OK(mcp3427_register_callback(&storage, prv_callback, NULL));
+  TEST_ASSERT_OK(mcp3427_register_fault_callback(&storage, prv_fault_callback, NULL));
+
+  // Nothing happens while there are no other events
+  s_timer_failures = 1;
+  TEST_ASSERT_OK(mcp3427_start(&storage));
+  prv_run_until_callbacks(1, TEST_ROUND_TIMEOUT_US);
+  TEST_ASSERT_EQUAL(0, s_times_callback_called);
+
+  Mcp3427Stats stats = { 0 };
+  TEST_ASSERT_OK(mcp3427_get_stats(&storage, &stats));
+  TEST_ASSERT_EQUAL(0, stats.conversions);
+  TEST_ASSERT_EQUAL(1, stats.timer_retries);
+
+  // Any event retries the wait, which has long passed, so the conversion is polled next
+  TEST_ASSERT_OK(event_raise(NUM_MCP3427_TEST_EVENTS, 0));
+  prv_run_until_callbacks(1, TEST_ROUND_TIMEOUT_US);
+  TEST_ASSERT_EQUAL(1, s_times_callback_called);
   TEST_ASSERT_EQUAL(0, s_times_fault_callback_called);
+
+  TEST_ASSERT_OK(mcp3427_get_stats(&storage, &stats));
+  TEST_ASSERT_EQUAL(2, stats.conversions);
+  TEST_ASSERT_EQUAL(0, stats.faults);
+  TEST_ASSERT_EQUAL(1, stats.timer_retries);
+  TEST_ASSERT_EQUAL(0, stats.early_polls);
 }
 
 // Test that each function gives STATUS_CODE_INVALID_ARGS with NULL storage/settings.
@@ -339,6 +366,7 @@ void test_failure_on_null(void) {
   TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
                     mcp3427_register_fault_callback(&valid_storage, NULL, NULL));
   TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, mcp3427_process_event(NULL));
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, mcp3427_get_stats(NULL, NULL));
 }
 
 // Test that we can pass unrelated events into |mcp3427_process_event|.
@@ -366,6 +394,6 @@ void test_process_event_with_unrelated_events(void) {
   MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
 
   // make sure there's no effect by waiting for any soft timers to expire
-  delay_ms(MCP3427_MAX_CONV_TIME_MS * 2);
+  delay_us(MCP3427_CONV_TIME_16_BIT_US * 2);
   MS_TEST_HELPER_ASSERT_NO_EVENT_RAISED();
 }
@@ -1,9 +1,94 @@
 #pragma once
 
-// This file defines task related constants
+// This file defines task related constants and a small adapter for running ms-common style
+// callbacks as prioritized FreeRTOS tasks.
+//
+// An MsTask repeatedly runs a function, either every |period_ms| or each time it is notified.
+// Notified tasks block until there is work to do, so they can replace wait()-polling main loops:
+// - ms_task_event_queue_create() creates a task that is notified whenever an event is raised and
+//   drains the event queue. Passing events to can_process_event() from its handler runs CAN RX/TX
+//   processing at the task's priority.
+// - ms_task_soft_timer_callback() notifies a task from a soft timer so the work runs in the task
+//   instead of the timer interrupt.
+//
+// Every task keeps runtime statistics so that worst-case response times can be compared between
+// designs. All times are wall-clock times in microseconds and include time spent preempted.
+//
+// Projects using this library should depend on "ms-freertos FreeRTOS".
+// Requires interrupts to be initialized before ms_task_init(), and soft timers if they're used.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "event_queue.h"
+#include "soft_timer.h"
+#include "status.h"
+#include "task.h"
 
 // Constants for FreeRTOS task rates
 #define FREERTOS_TASK_RATE_1_HZ (1000U / 1U)
 #define FREERTOS_TASK_RATE_10_HZ (1000U / 10U)
 #define FREERTOS_TASK_RATE_100_HZ (1000U / 100U)
 #define FREERTOS_TASK_RATE_1000_HZ (1000U / 1000U)
+
+#define MS_TASK_STACK_SIZE (configMINIMAL_STACK_SIZE * 2)
+
+typedef void (*MsTaskFn)(void *context);
+
+typedef void (*MsTaskEventHandler)(const Event *e, void *context);
+
+typedef struct MsTaskStats {
+  uint32_t num_runs;
+  // From the release (notification or period start) until the task starts running
+  uint32_t max_latency_us;
+  // From the release until the task finishes running - the worst-case response time
+  uint32_t max_response_us;
+  uint32_t max_runtime_us;
+  uint32_t total_runtime_us;
+} MsTaskStats;
+
+typedef struct MsTaskSettings {
+  const char *name;
+  // FreeRTOS priority, 1 to configMAX_PRIORITIES - 1. Priority 0 is reserved for the idle task.
+  UBaseType_t priority;
+  MsTaskFn fn;
+  void *context;
+  // Run every |period_ms| if nonzero, otherwise run whenever the task is notified
+  uint32_t period_ms;
+} MsTaskSettings;
+
+typedef struct MsTask {
+  StaticTask_t tcb;
+  StackType_t stack[MS_TASK_STACK_SIZE];
+  TaskHandle_t handle;
+  MsTaskFn fn;
+  void *context;
+  uint32_t period_ms;
+  // Time of the oldest notification the task hasn't run for yet
+  volatile bool notify_pending;
+  volatile uint32_t notify_time_us;
+  MsTaskStats stats;
+} MsTask;
+
+// Initializes the adapter. Must be called before any other function.
+StatusCode ms_task_init(void);
+
+// Creates a task. |task| must stay valid for the lifetime of the task.
+StatusCode ms_task_create(MsTask *task, const MsTaskSettings *settings);
+
+// Creates a task that blocks until events are raised, then passes each event to |handler|.
+// Only one event queue task is supported since there is only one global event queue.
+StatusCode ms_task_event_queue_create(MsTask *task, UBaseType_t priority,
+                                      MsTaskEventHandler handler, void *context);
+
+// Wakes a notified task. Safe to call from tasks, interrupts and, on x86, helper threads.
+void ms_task_notify(MsTask *task);
+
+// Soft timer callback that notifies the MsTask passed as |context|.
+void ms_task_soft_timer_callback(SoftTimerId timer_id, void *context);
+
+// Copies out the statistics of a task.
+StatusCode ms_task_get_stats(MsTask *task, MsTaskStats *stats);
+
+// Clears the statistics of a task.
+StatusCode ms_task_reset_stats(MsTask *task);
@@ -0,0 +1,26 @@
+#pragma once
+
+// Platform-specific helpers for the ms_task adapter. Not intended to be used directly.
+#include <stdint.h>
+
+#include "ms_task.h"
+#include "status.h"
+
+typedef enum {
+  // FreeRTOS task or before the scheduler has started: the regular API can be used
+  MS_TASK_CONTEXT_TASK = 0,
+  // Interrupt handler: only the FromISR API can be used
+  MS_TASK_CONTEXT_ISR,
+  // Thread that FreeRTOS doesn't know about: no FreeRTOS API can be used
+  MS_TASK_CONTEXT_OTHER,
+} MsTaskContext;
+
+StatusCode ms_task_port_init(void);
+
+MsTaskContext ms_task_port_context(void);
+
+// Free-running microsecond clock.
+uint32_t ms_task_port_time_us(void);
+
+// Notifies |task| from an interrupt on behalf of a MS_TASK_CONTEXT_OTHER thread.
+StatusCode ms_task_port_defer_notify(MsTask *task);
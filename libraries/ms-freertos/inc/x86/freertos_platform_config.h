@@ -0,0 +1,19 @@
+#pragma once
+// FreeRTOS configuration specific to the Linux port
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Only used for informational purposes - the tick is driven by the host clock
+#define configCPU_CLOCK_HZ ((unsigned long)1000000000)
+
+// The idle hook sleeps until the next signal instead of spinning a host core
+#define configUSE_IDLE_HOOK 1
+
+// Fail loudly instead of hanging the test runner
+#define configASSERT(x)                                                     \
+  if ((x) == 0) {                                                           \
+    taskDISABLE_INTERRUPTS();                                               \
+    fprintf(stderr, "FreeRTOS assert failed: %s:%d\n", __FILE__, __LINE__); \
+    abort();                                                                \
+  }
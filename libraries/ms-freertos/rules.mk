@@ -6,8 +6,16 @@
 # $(T)_SRC: $(T)_DIR/src{/$(PLATFORM)}/*.{c,s}
 
 # Specify the libraries you want to include
-$(T)_DEPS :=
+# FreeRTOS depends on this library for its hooks, so it can't be listed here without creating a
+# cycle. Users of the task adapter should depend on both ms-freertos and FreeRTOS.
+$(T)_DEPS := ms-common
+
+# The tests need the kernel as well
+$(T)_TEST_DEPS := FreeRTOS
 
 # Specifies library specific build flags
+ifeq (stm32f0xx,$(PLATFORM))
+$(T)_EXCLUDE_TESTS := ms_task_helper_thread
 $(T)_CFLAGS += -ffreestanding -nostdlib
+endif
 
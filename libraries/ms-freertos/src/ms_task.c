@@ -0,0 +1,181 @@
+#include "ms_task.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "ms_task_port.h"
+
+typedef struct MsTaskEventQueue {
+  MsTaskEventHandler handler;
+  void *context;
+} MsTaskEventQueue;
+
+static MsTaskEventQueue s_event_queue;
+
+static void prv_update_stats(MsTask *task, uint32_t release_us, uint32_t start_us,
+                             uint32_t end_us) {
+  uint32_t latency_us = start_us - release_us;
+  uint32_t response_us = end_us - release_us;
+  uint32_t runtime_us = end_us - start_us;
+
+  taskENTER_CRITICAL();
+  MsTaskStats *stats = &task->stats;
+  stats->num_runs++;
+  stats->total_runtime_us += runtime_us;
+  if (latency_us > stats->max_latency_us) {
+    stats->max_latency_us = latency_us;
+  }
+  if (response_us > stats->max_response_us) {
+    stats->max_response_us = response_us;
+  }
+  if (runtime_us > stats->max_runtime_us) {
+    stats->max_runtime_us = runtime_us;
+  }
+  taskEXIT_CRITICAL();
+}
+
+// Blocks until the next release and returns the time it happened.
+static uint32_t prv_wait_for_release(MsTask *task, TickType_t *last_wake, uint32_t *next_us) {
+  if (task->period_ms != 0) {
+    vTaskDelayUntil(last_wake, pdMS_TO_TICKS(task->period_ms));
+    uint32_t release_us = *next_us;
+    *next_us += task->period_ms * 1000;
+    return release_us;
+  }
+
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  taskENTER_CRITICAL();
+  uint32_t release_us = task->notify_time_us;
+  task->notify_pending = false;
+  taskEXIT_CRITICAL();
+  return release_us;
+}
+
+static void prv_task(void *context) {
+  MsTask *task = context;
+
+  TickType_t last_wake = xTaskGetTickCount();
+  uint32_t next_us = ms_task_port_time_us() + task->period_ms * 1000;
+
+  for (;;) {
+    uint32_t release_us = prv_wait_for_release(task, &last_wake, &next_us);
+    uint32_t start_us = ms_task_port_time_us();
+    task->fn(task->context);
+    prv_update_stats(task, release_us, start_us, ms_task_port_time_us());
+  }
+}
+
+static void prv_event_queue_task(void *context) {
+  Event e = { 0 };
+  while (status_ok(event_process(&e))) {
+    s_event_queue.handler(&e, s_event_queue.context);
+  }
+}
+
+static void prv_event_raised(void *context) {
+  ms_task_notify(context);
+}
+
+StatusCode ms_task_init(void) {
+  memset(&s_event_queue, 0, sizeof(s_event_queue));
+  return ms_task_port_init();
+}
+
+StatusCode ms_task_create(MsTask *task, const MsTaskSettings *settings) {
+  if (task == NULL || settings == NULL || settings->fn == NULL || settings->priority == 0 ||
+      settings->priority >= configMAX_PRIORITIES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  memset(task, 0, sizeof(*task));
+  task->fn = settings->fn;
+  task->context = settings->context;
+  task->period_ms = settings->period_ms;
+
+  task->handle = xTaskCreateStatic(prv_task, settings->name, MS_TASK_STACK_SIZE, task,
+                                   settings->priority, task->stack, &task->tcb);
+  if (task->handle == NULL) {
+    return status_code(STATUS_CODE_INTERNAL_ERROR);
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode ms_task_event_queue_create(MsTask *task, UBaseType_t priority,
+                                      MsTaskEventHandler handler, void *context) {
+  if (handler == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  MsTaskSettings settings = {
+    .name = "event_queue",
+    .priority = priority,
+    .fn = prv_event_queue_task,
+    .context = NULL,
+  };
+  status_ok_or_return(ms_task_create(task, &settings));
+
+  s_event_queue.handler = handler;
+  s_event_queue.context = context;
+  event_queue_set_raise_callback(prv_event_raised, task);
+
+  // Process anything raised before the task was created
+  ms_task_notify(task);
+  return STATUS_CODE_OK;
+}
+
+void ms_task_notify(MsTask *task) {
+  switch (ms_task_port_context()) {
+    case MS_TASK_CONTEXT_TASK:
+      taskENTER_CRITICAL();
+      if (!task->notify_pending) {
+        task->notify_pending = true;
+        task->notify_time_us = ms_task_port_time_us();
+      }
+      taskEXIT_CRITICAL();
+      xTaskNotifyGive(task->handle);
+      break;
+    case MS_TASK_CONTEXT_ISR: {
+      UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+      if (!task->notify_pending) {
+        task->notify_pending = true;
+        task->notify_time_us = ms_task_port_time_us();
+      }
+      taskEXIT_CRITICAL_FROM_ISR(saved);
+
+      BaseType_t higher_priority_woken = pdFALSE;
+      vTaskNotifyGiveFromISR(task->handle, &higher_priority_woken);
+      portYIELD_FROM_ISR(higher_priority_woken);
+      break;
+    }
+    case MS_TASK_CONTEXT_OTHER:
+    default:
+      ms_task_port_defer_notify(task);
+      break;
+  }
+}
+
+void ms_task_soft_timer_callback(SoftTimerId timer_id, void *context) {
+  ms_task_notify(context);
+}
+
+StatusCode ms_task_get_stats(MsTask *task, MsTaskStats *stats) {
+  if (task == NULL || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  taskENTER_CRITICAL();
+  *stats = task->stats;
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
+
+StatusCode ms_task_reset_stats(MsTask *task) {
+  if (task == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  taskENTER_CRITICAL();
+  memset(&task->stats, 0, sizeof(task->stats));
+  taskEXIT_CRITICAL();
+  return STATUS_CODE_OK;
+}
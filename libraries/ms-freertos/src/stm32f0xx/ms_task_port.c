@@ -0,0 +1,35 @@
+#include "ms_task_port.h"
+
+#include "stm32f0xx.h"
+
+StatusCode ms_task_port_init(void) {
+  return STATUS_CODE_OK;
+}
+
+MsTaskContext ms_task_port_context(void) {
+  // IPSR holds the active exception number, or 0 in thread mode
+  return (__get_IPSR() != 0) ? MS_TASK_CONTEXT_ISR : MS_TASK_CONTEXT_TASK;
+}
+
+static TickType_t prv_tick_count(void) {
+  return (ms_task_port_context() == MS_TASK_CONTEXT_ISR) ? xTaskGetTickCountFromISR()
+                                                         : xTaskGetTickCount();
+}
+
+uint32_t ms_task_port_time_us(void) {
+  // The Cortex-M0 has no cycle counter, so combine the tick count with the SysTick countdown.
+  // Retry if a tick happened in between the two reads.
+  TickType_t ticks = 0;
+  uint32_t elapsed_cycles = 0;
+  do {
+    ticks = prv_tick_count();
+    elapsed_cycles = SysTick->LOAD - SysTick->VAL;
+  } while (ticks != prv_tick_count());
+
+  return ticks * portTICK_PERIOD_MS * 1000 + elapsed_cycles / (SystemCoreClock / 1000000);
+}
+
+StatusCode ms_task_port_defer_notify(MsTask *task) {
+  // Every context can call into FreeRTOS on the MCU
+  return status_code(STATUS_CODE_UNIMPLEMENTED);
+}
@@ -0,0 +1,76 @@
+#include "ms_task_port.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "interrupt_def.h"
+#include "x86_interrupt.h"
+
+// Helper threads such as the CAN RX/TX threads run concurrently with the running task, so they
+// can't call into FreeRTOS. Their notifications are passed through an interrupt instead, the same
+// way a peripheral would wake a task on the MCU.
+#define MS_TASK_PORT_MAX_DEFERRED 16
+
+static MsTask *s_deferred[MS_TASK_PORT_MAX_DEFERRED];
+static uint8_t s_interrupt_id;
+
+static void prv_deferred_handler(uint8_t interrupt_id) {
+  for (size_t i = 0; i < MS_TASK_PORT_MAX_DEFERRED; i++) {
+    MsTask *task = __atomic_exchange_n(&s_deferred[i], NULL, __ATOMIC_SEQ_CST);
+    if (task != NULL) {
+      ms_task_notify(task);
+    }
+  }
+}
+
+StatusCode ms_task_port_init(void) {
+  for (size_t i = 0; i < MS_TASK_PORT_MAX_DEFERRED; i++) {
+    s_deferred[i] = NULL;
+  }
+
+  InterruptSettings settings = {
+    .type = INTERRUPT_TYPE_INTERRUPT,
+    .priority = INTERRUPT_PRIORITY_NORMAL,
+  };
+  uint8_t handler_id = 0;
+  status_ok_or_return(x86_interrupt_register_handler(prv_deferred_handler, &handler_id));
+  return x86_interrupt_register_interrupt(handler_id, &settings, &s_interrupt_id);
+}
+
+MsTaskContext ms_task_port_context(void) {
+  // Helper threads block interrupts with x86_interrupt_pthread_init(), while the thread of the
+  // running task is the one that handles them
+  sigset_t mask;
+  pthread_sigmask(SIG_BLOCK, NULL, &mask);
+  if (sigismember(&mask, SIGRTMIN + NUM_INTERRUPT_PRIORITIES)) {
+    return MS_TASK_CONTEXT_OTHER;
+  }
+  return x86_interrupt_in_handler() ? MS_TASK_CONTEXT_ISR : MS_TASK_CONTEXT_TASK;
+}
+
+uint32_t ms_task_port_time_us(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)now.tv_sec * 1000000 + (uint32_t)now.tv_nsec / 1000;
+}
+
+StatusCode ms_task_port_defer_notify(MsTask *task) {
+  for (size_t i = 0; i < MS_TASK_PORT_MAX_DEFERRED; i++) {
+    MsTask *expected = NULL;
+    if (s_deferred[i] == task ||
+        __atomic_compare_exchange_n(&s_deferred[i], &expected, task, false, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_SEQ_CST)) {
+      return x86_interrupt_trigger(s_interrupt_id);
+    }
+  }
+  return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+}
+
+// Called by the idle task on every loop. Sleeps until the next tick or interrupt, like WFI.
+void vApplicationIdleHook(void) {
+  sigset_t mask;
+  pthread_sigmask(SIG_SETMASK, NULL, &mask);
+  sigsuspend(&mask);
+}
@@ -0,0 +1,158 @@
+#include "ms_task.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event_queue.h"
+#include "interrupt.h"
+#include "log.h"
+#include "ms_task_port.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+// The scheduler can only be started once per process, so everything that needs it is checked in a
+// single run.
+
+#define TEST_EVENT_PRIORITY 3
+#define TEST_NOTIFIED_PRIORITY 2
+#define TEST_BUSY_PRIORITY 1
+
+#define TEST_NUM_EVENTS 20
+#define TEST_EVENT_PERIOD_MS 3
+#define TEST_BUSY_PERIOD_MS 10
+#define TEST_BUSY_TIME_US 20000
+
+static MsTask s_event_task;
+static MsTask s_notified_task;
+static MsTask s_busy_task;
+
+static uint16_t s_events_raised;
+static uint16_t s_events_handled;
+static bool s_events_in_order;
+static uint16_t s_notified_runs;
+
+static void prv_event_timer_callback(SoftTimerId timer_id, void *context) {
+  event_raise(0, s_events_raised++);
+  if (s_events_raised < TEST_NUM_EVENTS) {
+    soft_timer_start_millis(TEST_EVENT_PERIOD_MS, prv_event_timer_callback, NULL, NULL);
+  }
+}
+
+static void prv_handle_event(const Event *e, void *context) {
+  if (e->data != s_events_handled) {
+    s_events_in_order = false;
+  }
+  s_events_handled++;
+
+  if (s_events_handled == TEST_NUM_EVENTS) {
+    // Returns control to the test
+    vTaskEndScheduler();
+  }
+}
+
+static void prv_notified(void *context) {
+  s_notified_runs++;
+}
+
+// Hogs the CPU so that the other tasks have to preempt it
+static void prv_busy(void *context) {
+  uint32_t start_us = ms_task_port_time_us();
+  while (ms_task_port_time_us() - start_us < TEST_BUSY_TIME_US) {
+  }
+}
+
+void setup_test(void) {
+  event_queue_init();
+  interrupt_init();
+  soft_timer_init();
+  TEST_ASSERT_OK(ms_task_init());
+
+  s_events_raised = 0;
+  s_events_handled = 0;
+  s_events_in_order = true;
+  s_notified_runs = 0;
+}
+
+void teardown_test(void) {}
+
+void test_ms_task_invalid_args(void) {
+  MsTaskSettings settings = {
+    .name = "invalid",
+    .priority = TEST_BUSY_PRIORITY,
+    .fn = NULL,
+  };
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, ms_task_create(&s_busy_task, &settings));
+
+  // Priority 0 belongs to the idle task
+  settings.fn = prv_busy;
+  settings.priority = 0;
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, ms_task_create(&s_busy_task, &settings));
+  settings.priority = configMAX_PRIORITIES;
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, ms_task_create(&s_busy_task, &settings));
+
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS,
+                    ms_task_event_queue_create(&s_event_task, TEST_EVENT_PRIORITY, NULL, NULL));
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, ms_task_create(&s_busy_task, NULL));
+}
+
+// Events raised from interrupts are handled by a high priority task that preempts a busy low
+// priority task, so its response time stays well below the busy task's runtime.
+void test_ms_task_scheduling(void) {
+  TEST_ASSERT_OK(
+      ms_task_event_queue_create(&s_event_task, TEST_EVENT_PRIORITY, prv_handle_event, NULL));
+
+  MsTaskSettings notified_settings = {
+    .name = "notified",
+    .priority = TEST_NOTIFIED_PRIORITY,
+    .fn = prv_notified,
+  };
+  TEST_ASSERT_OK(ms_task_create(&s_notified_task, &notified_settings));
+
+  MsTaskSettings busy_settings = {
+    .name = "busy",
+    .priority = TEST_BUSY_PRIORITY,
+    .fn = prv_busy,
+    .period_ms = TEST_BUSY_PERIOD_MS,
+  };
+  TEST_ASSERT_OK(ms_task_create(&s_busy_task, &busy_settings));
+
+  TEST_ASSERT_OK(
+      soft_timer_start_millis(TEST_EVENT_PERIOD_MS, prv_event_timer_callback, NULL, NULL));
+  TEST_ASSERT_OK(soft_timer_start_millis(TEST_EVENT_PERIOD_MS * 2, ms_task_soft_timer_callback,
+                                         &s_notified_task, NULL));
+
+  vTaskStartScheduler();
+
+  TEST_ASSERT_EQUAL(TEST_NUM_EVENTS, s_events_handled);
+  TEST_ASSERT_TRUE(s_events_in_order);
+  TEST_ASSERT_EQUAL(1, s_notified_runs);
+
+  MsTaskStats event_stats = { 0 };
+  MsTaskStats notified_stats = { 0 };
+  MsTaskStats busy_stats = { 0 };
+  TEST_ASSERT_OK(ms_task_get_stats(&s_event_task, &event_stats));
+  TEST_ASSERT_OK(ms_task_get_stats(&s_notified_task, &notified_stats));
+  TEST_ASSERT_OK(ms_task_get_stats(&s_busy_task, &busy_stats));
+
+  LOG_DEBUG("event task: %u runs, max latency %uus, max response %uus\n", event_stats.num_runs,
+            event_stats.max_latency_us, event_stats.max_response_us);
+  LOG_DEBUG("busy task: %u runs, max latency %uus, max response %uus\n", busy_stats.num_runs,
+            busy_stats.max_latency_us, busy_stats.max_response_us);
+
+  // The last run never finishes since it ends the scheduler
+  TEST_ASSERT_TRUE(event_stats.num_runs > 0);
+  TEST_ASSERT_TRUE(event_stats.max_latency_us <= event_stats.max_response_us);
+  // Compared against the busy task rather than a fixed bound since the host may be loaded
+  TEST_ASSERT_TRUE(event_stats.max_response_us < busy_stats.max_response_us);
+
+  TEST_ASSERT_EQUAL(1, notified_stats.num_runs);
+
+  TEST_ASSERT_TRUE(busy_stats.num_runs > 0);
+  TEST_ASSERT_TRUE(busy_stats.max_runtime_us >= TEST_BUSY_TIME_US);
+  TEST_ASSERT_TRUE(busy_stats.total_runtime_us >= busy_stats.num_runs * TEST_BUSY_TIME_US);
+
+  TEST_ASSERT_OK(ms_task_reset_stats(&s_busy_task));
+  TEST_ASSERT_OK(ms_task_get_stats(&s_busy_task, &busy_stats));
+  TEST_ASSERT_EQUAL(0, busy_stats.num_runs);
+}
@@ -0,0 +1,70 @@
+#include "ms_task.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "event_queue.h"
+#include "interrupt.h"
+#include "test_helpers.h"
+#include "unity.h"
+#include "x86_interrupt.h"
+
+// Helper threads like the x86 CAN RX/TX threads run alongside the running task, so events they
+// raise have to be passed to the event queue task through an interrupt.
+
+#define TEST_EVENT_PRIORITY 2
+#define TEST_NUM_EVENTS 10
+
+static MsTask s_event_task;
+static pthread_t s_thread;
+static uint16_t s_events_handled;
+static bool s_events_in_order;
+
+static void *prv_helper_thread(void *arg) {
+  x86_interrupt_pthread_init();
+  for (uint16_t i = 0; i < TEST_NUM_EVENTS; i++) {
+    event_raise(0, i);
+    usleep(1000);
+  }
+  return NULL;
+}
+
+static void prv_handle_event(const Event *e, void *context) {
+  if (e->data != s_events_handled) {
+    s_events_in_order = false;
+  }
+  s_events_handled++;
+
+  if (s_events_handled == TEST_NUM_EVENTS) {
+    vTaskEndScheduler();
+  }
+}
+
+void setup_test(void) {
+  event_queue_init();
+  interrupt_init();
+  TEST_ASSERT_OK(ms_task_init());
+
+  s_events_handled = 0;
+  s_events_in_order = true;
+}
+
+void teardown_test(void) {}
+
+void test_ms_task_helper_thread_events(void) {
+  TEST_ASSERT_OK(
+      ms_task_event_queue_create(&s_event_task, TEST_EVENT_PRIORITY, prv_handle_event, NULL));
+  pthread_create(&s_thread, NULL, prv_helper_thread, NULL);
+
+  vTaskStartScheduler();
+  pthread_join(s_thread, NULL);
+
+  TEST_ASSERT_EQUAL(TEST_NUM_EVENTS, s_events_handled);
+  TEST_ASSERT_TRUE(s_events_in_order);
+
+  MsTaskStats stats = { 0 };
+  TEST_ASSERT_OK(ms_task_get_stats(&s_event_task, &stats));
+  TEST_ASSERT_TRUE(stats.num_runs > 0);
+}
@@ -9,7 +9,10 @@
 #include "misc.h"
 #include "soft_timer.h"
 #include "status.h"
-// Requires soft timers, interrupts, GPIO, and ADC (ADC Mode Single)
+// Requires soft timers, interrupts, GPIO, and ADC (any mode)
+//
+// Each period, every reader gets its data from the same conversion sequence. In scan mode, that's
+// the scan started the period before, so the first period has nothing to report.
 
 typedef enum {
   PERIODIC_READER_ID_0 = 0,
@@ -1,7 +1,11 @@
 #pragma once
 // Module for periodically sending CAN messages.
 // Requires a generic can module, soft_timers and interrupts to be enabled.
+//
+// Every enabled interval runs off a single soft timer. Intervals that share a period are given
+// different phases within it, so their messages are spread out rather than sent together.
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "generic_can.h"
@@ -14,8 +18,10 @@
 typedef struct CanInterval {
   GenericCan *can;
   GenericCanMsg msg;
-  SoftTimerId timer_id;
   uint32_t period;
+  // When the message is next due, in soft_timer_now_us() time
+  uint32_t next_tx_us;
+  bool enabled;
 } CanInterval;
 
 // Initializes the can interval module.
@@ -31,7 +37,8 @@ StatusCode can_interval_factory(const GenericCan *can, const GenericCanMsg *msg,
 StatusCode can_interval_send_now(CanInterval *interval);
 
 // Sends a message periodically as specified by the settings in |interval|
-// (should use can_interval_factory to initialize).
+// (should use can_interval_factory to initialize). The first periodic send may come sooner than a
+// period after enabling, so that it falls in a free phase.
 StatusCode can_interval_enable(CanInterval *interval);
 
 // Stops sending a message periodically (|interval| should use
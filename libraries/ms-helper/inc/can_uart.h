@@ -2,7 +2,8 @@
 // Generic CAN HW <-> UART protocol
 // Requires CAN HW, UART to be initialized
 //
-// Uses COBS encoding to frame packets - 0x00 is used as a delimiter
+// Uses COBS encoding to frame packets - 0x00 is used as a delimiter. Received packets are handled
+// from uart_process_event() in the main loop.
 #include "can_hw.h"
 #include "status.h"
 #include "uart.h"
@@ -2,7 +2,7 @@
 // Module to abstract handling pedal output messages
 #include "event_queue.h"
 #include "exported_enums.h"
-#include "soft_timer.h"
+#include "watchdog.h"
 
 typedef uint32_t PedalTimeoutMs;
 
@@ -17,7 +17,7 @@ typedef struct PedalValues {
 } PedalValues;
 
 typedef struct PedalRxStorage {
-  SoftTimerId watchdog_id;
+  WatchdogStorage watchdog;
   PedalValues pedal_values;
   EventId timeout_event;
   PedalTimeoutMs timeout_ms;
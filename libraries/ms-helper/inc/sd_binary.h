@@ -10,6 +10,7 @@
 //
 #include <stdbool.h>
 #include <stdint.h>
+#include "event_queue.h"
 #include "gpio.h"
 #include "spi.h"
 #include "status.h"
@@ -17,19 +18,66 @@
 // The block size on the SD card
 #define SD_BLOCK_SIZE (512)
 
-// For SDHC and SDXC cards, the address provided to these functions should be
-// the block address
+// Blocks are addressed by their number on the card (LBA) rather than a byte
+// address, so cards larger than 4 GiB can be used in full
 
 // Initialize the SD card on a given SPI port
 StatusCode sd_card_init(SpiPort spi);
 
+// Called with the result of an asynchronous transfer
+typedef void (*SdAsyncCallback)(SpiPort spi, StatusCode status, void *context);
+
 // Read block from the SD card. |dest| is where the read blocks will be written
 // into. Make sure that this buffer is large enough for the content
-StatusCode sd_read_blocks(SpiPort spi, uint8_t *dest, uint32_t readAddr, uint32_t numberOfBlocks);
+// Multiple blocks are read with a single streaming read.
+StatusCode sd_read_blocks(SpiPort spi, uint8_t *dest, uint32_t readBlock, uint32_t numberOfBlocks);
 
 // Write blocks to the SD card from |src| to a location on the SD card specified
-// by |writeAddr|
-StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t writeAddr, uint32_t numberOfBlocks);
+// by |writeBlock|
+// Multiple blocks are written with a single streaming write.
+StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t writeBlock, uint32_t numberOfBlocks);
+
+// Streaming transfers address the card once and then move any number of
+// consecutive blocks, which is much faster than a command per block. While a
+// stream is open, every other call on the port fails.
+
+// Starts a streaming read (CMD18) from |readBlock|
+StatusCode sd_stream_read_begin(SpiPort spi, uint32_t readBlock);
+
+// Reads the next blocks of the stream into |dest|
+StatusCode sd_stream_read(SpiPort spi, uint8_t *dest, uint32_t numberOfBlocks);
+
+StatusCode sd_stream_read_end(SpiPort spi);
+
+// Starts a streaming write (CMD25) to |writeBlock|
+StatusCode sd_stream_write_begin(SpiPort spi, uint32_t writeBlock);
+
+// Writes the next blocks of the stream from |src|
+StatusCode sd_stream_write(SpiPort spi, uint8_t *src, uint32_t numberOfBlocks);
+
+StatusCode sd_stream_write_end(SpiPort spi);
+
+// Asynchronous transfers run as a stream, moving one block each time |event|
+// is passed to sd_process_event() so the event loop isn't blocked for the
+// whole transfer. The buffer must stay valid until |callback| is called with
+// the result. One transfer can be in progress per port.
+StatusCode sd_read_blocks_async(SpiPort spi, uint8_t *dest, uint32_t readBlock,
+                                uint32_t numberOfBlocks, EventId event, SdAsyncCallback callback,
+                                void *context);
+
+StatusCode sd_write_blocks_async(SpiPort spi, uint8_t *src, uint32_t writeBlock,
+                                 uint32_t numberOfBlocks, EventId event, SdAsyncCallback callback,
+                                 void *context);
+
+// Moves the next block of an asynchronous transfer. Returns whether the event
+// was processed.
+bool sd_process_event(const Event *e);
+
+// Whether an asynchronous transfer is in progress on the port
+bool sd_async_busy(SpiPort spi);
+
+// Reads the capacity of the card in blocks. Only SDHC and SDXC cards are supported
+StatusCode sd_get_num_blocks(SpiPort spi, uint32_t *num_blocks);
 
 // Determines whether the SD card is ready in on a given SPI port
 StatusCode sd_is_initialized(SpiPort spi);
@@ -0,0 +1,40 @@
+#pragma once
+// Small write-through cache of single SD card blocks
+//
+// FatFs reads and writes the FAT and directory entries one block at a time,
+// and keeps going back to the same few blocks, e.g. when following cluster
+// chains or updating a file's size. The most recently used of those blocks are
+// kept in RAM so repeated reads don't go to the card.
+//
+// Multi-block transfers are assumed to be file data - they bypass the cache,
+// though writes drop any cached blocks they overlap. Anything writing to the
+// card without going through this module must call sd_cache_invalidate() for
+// the blocks it wrote.
+#include <stdint.h>
+#include "sd_binary.h"
+#include "status.h"
+
+#ifndef SD_CACHE_NUM_BLOCKS
+#define SD_CACHE_NUM_BLOCKS 4
+#endif
+
+typedef struct SdCacheStats {
+  uint32_t hits;
+  uint32_t misses;
+} SdCacheStats;
+
+// Same as sd_read_blocks(), but single blocks come from the cache if possible
+StatusCode sd_cache_read_blocks(SpiPort spi, uint8_t *dest, uint32_t readBlock,
+                                uint32_t numberOfBlocks);
+
+// Same as sd_write_blocks(), keeping the cache up to date
+StatusCode sd_cache_write_blocks(SpiPort spi, uint8_t *src, uint32_t writeBlock,
+                                 uint32_t numberOfBlocks);
+
+// Drops any cached blocks in the given range
+void sd_cache_invalidate(SpiPort spi, uint32_t block, uint32_t numberOfBlocks);
+
+// Drops every cached block for the port, e.g. when a card is inserted
+void sd_cache_clear(SpiPort spi);
+
+void sd_cache_get_stats(SdCacheStats *stats);
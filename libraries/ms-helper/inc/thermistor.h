@@ -4,7 +4,9 @@
 //
 // The thermistor and its fixed resistor forms a voltage divider.
 // A temperature value ranging from 0~100 degrees is calculated from the voltage
-// divider.
+// divider, by binary searching a table of divider ratios built at compile time.
+#include <stddef.h>
+
 #include "adc.h"
 #include "gpio.h"
 
@@ -32,6 +34,18 @@ StatusCode thermistor_init(ThermistorStorage *storage, GpioAddress thermistor_gp
 // Note: "dc" (deciCelsius) is a tenth of a celsius (0.1C)
 StatusCode thermistor_get_temp(ThermistorStorage *storage, uint16_t *temperature_dc);
 
+// Fetch the temperatures of |num_thermistors| thermistors at once, reading VDDA only once.
+// Temperatures out of range are set to UINT16_MAX and the rest are still converted.
+StatusCode thermistor_get_temps(ThermistorStorage *storages, size_t num_thermistors,
+                                uint16_t *temperatures_dc);
+
+// Convert node voltages in millivolts from thermistors in the same |position|, all measured
+// against |vdda_mv|, to deciCelsius. Meant for readings that don't come from the MCU's ADC.
+// Temperatures out of range are set to UINT16_MAX and the rest are still converted.
+StatusCode thermistor_convert_readings(ThermistorPosition position, uint16_t vdda_mv,
+                                       const uint16_t *readings_mv, uint16_t *temperatures_dc,
+                                       size_t num_readings);
+
 // Calculate the temperature in deciCelsius from ohms
 StatusCode thermistor_calculate_temp(uint32_t thermistor_resistance_ohms, uint16_t *temperature_dc);
 
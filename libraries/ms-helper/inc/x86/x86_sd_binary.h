@@ -0,0 +1,32 @@
+#pragma once
+// x86-only extensions to the SD card driver
+//
+// The card is emulated by a disk image file named by the MIDSUN_X86_SD_IMAGE_FILE environment
+// variable, or x86_sd_card.img if it isn't set. All SPI ports share the same image. A missing image
+// is created blank with X86_SD_DEFAULT_NUM_BLOCKS blocks - format it with f_mkfs() before mounting.
+//
+// By default transfers take no time. x86_sd_set_latency() makes them as slow as a real card so the
+// cost of commands versus streamed blocks shows up in benchmarks.
+#include <stdint.h>
+
+#define X86_SD_IMAGE_VAR "MIDSUN_X86_SD_IMAGE_FILE"
+#define X86_SD_DEFAULT_IMAGE_FILE "x86_sd_card.img"
+
+// 16 MiB
+#define X86_SD_DEFAULT_NUM_BLOCKS 32768
+
+typedef struct X86SdStats {
+  uint32_t blocks_read;
+  uint32_t blocks_written;
+  // Calls to sd_write_blocks()
+  uint32_t write_calls;
+  // Commands that address the card, i.e. single block transfers and stream starts
+  uint32_t commands;
+} X86SdStats;
+
+// Counters since sd_card_init()
+void x86_sd_get_stats(X86SdStats *stats);
+
+// Every command addressing the card takes |command_us|, and every block transferred takes
+// |block_us| on top of that.
+void x86_sd_set_latency(uint32_t command_us, uint32_t block_us);
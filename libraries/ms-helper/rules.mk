@@ -10,6 +10,9 @@ $(T)_DEPS := ms-common
 
 ifeq (x86,$(PLATFORM))
 $(T)_EXCLUDE_TESTS := mcp2515 adc_periodic_reader
+else
+# Runs against an emulated card image
+$(T)_EXCLUDE_TESTS := sd_binary
 endif
 
 $(T)_test_thermistor_MOCKS := adc_read_converted adc_get_channel adc_set_channel
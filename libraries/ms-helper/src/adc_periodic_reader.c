@@ -13,17 +13,37 @@
 static AdcPeriodicReaderStorage s_storage[NUM_PERIODIC_READER_IDS];
 static uint32_t timer_interval_ms = 0;
 
-void prv_callback(SoftTimerId timer_id, void *context) {
+static void prv_report(const AdcSnapshot *snapshot) {
   for (size_t i = 0; i < NUM_PERIODIC_READER_IDS; i++) {
     uint16_t data = 0;
     AdcChannel channel;
-    if (s_storage[i].activated) {
-      adc_get_channel(s_storage[i].address, &channel);
-      adc_read_converted(channel, &data);
+    if (s_storage[i].activated && status_ok(adc_get_channel(s_storage[i].address, &channel)) &&
+        status_ok(adc_get_snapshot_converted(snapshot, channel, &data))) {
       s_storage[i].data = data;
       s_storage[i].callback(s_storage[i].data, i, s_storage[i].context);
     }
   }
+}
+
+void prv_callback(SoftTimerId timer_id, void *context) {
+  for (size_t i = 0; i < NUM_PERIODIC_READER_IDS; i++) {
+    AdcChannel channel;
+    if (s_storage[i].activated && status_ok(adc_get_channel(s_storage[i].address, &channel))) {
+      // Every reader takes its data from the same sequence. In scan mode that's the last scan,
+      // and this starts the next one. Otherwise a read converts a new sequence, or just takes the
+      // latest in continuous mode.
+      if (adc_scan_start() == STATUS_CODE_UNINITIALIZED) {
+        uint16_t reading = 0;
+        adc_read_raw(channel, &reading);
+      }
+
+      AdcSnapshot snapshot;
+      if (status_ok(adc_get_snapshot(&snapshot))) {
+        prv_report(&snapshot);
+      }
+      break;
+    }
+  }
   soft_timer_start_millis(timer_interval_ms, prv_callback, NULL, NULL);
 }
 
@@ -1,36 +1,150 @@
 #include "can_interval.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "can.h"
 #include "can_uart.h"
+#include "critical_section.h"
 #include "generic_can.h"
 #include "objpool.h"
 #include "soft_timer.h"
 #include "status.h"
 
+// Phases an interval can take within its period, relative to the others with the same period
+#define CAN_INTERVAL_PHASE_SLOTS CAN_INTERVAL_POOL_SIZE
+
 static ObjectPool s_can_interval_pool;
 static CanInterval s_can_interval_storage[CAN_INTERVAL_POOL_SIZE];
+// The one timer behind every interval, set for whichever is due next
+static SoftTimerId s_timer_id = SOFT_TIMER_INVALID_TIMER;
+
+static void prv_can_interval_timer_cb(SoftTimerId id, void *context);
+
+// Offset of |time_us| from |now_us|, wrapped into [0, period)
+static uint32_t prv_phase(uint32_t time_us, uint32_t now_us, uint32_t period) {
+  int64_t phase = (int32_t)(time_us - now_us) % (int64_t)period;
+  return (uint32_t)(phase < 0 ? phase + period : phase);
+}
+
+static bool prv_shares_period(const CanInterval *interval, const CanInterval *other) {
+  return other != interval && other->enabled && other->period == interval->period;
+}
+
+// Distance from |phase| to the closest of the other intervals sharing |interval|'s period
+static uint32_t prv_min_distance(const CanInterval *interval, uint32_t phase, uint32_t now_us) {
+  uint32_t min_distance = UINT32_MAX;
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE; i++) {
+    const CanInterval *other = &s_can_interval_storage[i];
+    if (prv_shares_period(interval, other)) {
+      uint32_t distance = prv_phase(other->next_tx_us, now_us + phase, interval->period);
+      if (interval->period - distance < distance) {
+        distance = interval->period - distance;
+      }
+      if (distance < min_distance) {
+        min_distance = distance;
+      }
+    }
+  }
+  return min_distance;
+}
+
+// Picks when |interval| is first due. Intervals sharing a period sit on a grid of slots anchored to
+// one of them, and this takes the slot furthest from the rest. Alone, it's due a period from now.
+static uint32_t prv_first_tx_us(const CanInterval *interval, uint32_t now_us) {
+  const CanInterval *anchor = NULL;
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE && anchor == NULL; i++) {
+    if (prv_shares_period(interval, &s_can_interval_storage[i])) {
+      anchor = &s_can_interval_storage[i];
+    }
+  }
+  if (anchor == NULL) {
+    return now_us + interval->period;
+  }
+
+  uint32_t slot_us = interval->period / CAN_INTERVAL_PHASE_SLOTS;
+  uint32_t anchor_phase = prv_phase(anchor->next_tx_us, now_us, interval->period);
+  uint32_t best_phase = anchor_phase;
+  uint32_t best_distance = 0;
+  for (uint32_t slot = 1; slot < CAN_INTERVAL_PHASE_SLOTS; slot++) {
+    uint32_t phase = (anchor_phase + slot * slot_us) % interval->period;
+    uint32_t distance = prv_min_distance(interval, phase, now_us);
+    if (distance > best_distance) {
+      best_phase = phase;
+      best_distance = distance;
+    }
+  }
+  return now_us + (best_phase == 0 ? interval->period : best_phase);
+}
+
+// Restarts the timer for the next interval due. Must be called in a critical section.
+static StatusCode prv_schedule(uint32_t now_us) {
+  if (s_timer_id != SOFT_TIMER_INVALID_TIMER) {
+    soft_timer_cancel(s_timer_id);
+    s_timer_id = SOFT_TIMER_INVALID_TIMER;
+  }
+
+  bool any_enabled = false;
+  uint32_t delay_us = UINT32_MAX;
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE; i++) {
+    const CanInterval *interval = &s_can_interval_storage[i];
+    if (interval->enabled) {
+      int32_t until_us = (int32_t)(interval->next_tx_us - now_us);
+      uint32_t interval_delay_us = until_us < 0 ? 0 : (uint32_t)until_us;
+      if (interval_delay_us < delay_us) {
+        delay_us = interval_delay_us;
+      }
+      any_enabled = true;
+    }
+  }
+  if (!any_enabled) {
+    return STATUS_CODE_OK;
+  }
+
+  if (delay_us < SOFT_TIMER_MIN_TIME_US) {
+    delay_us = SOFT_TIMER_MIN_TIME_US;
+  }
+  return soft_timer_start(delay_us, prv_can_interval_timer_cb, NULL, &s_timer_id);
+}
 
 static void prv_can_interval_timer_cb(SoftTimerId id, void *context) {
-  (void)id;
-  CanInterval *interval = context;
-  generic_can_tx(interval->can, &interval->msg);
-  soft_timer_start(interval->period, prv_can_interval_timer_cb, context, &interval->timer_id);
+  (void)context;
+  // A timer left over from before can_interval_init()
+  if (id != s_timer_id) {
+    return;
+  }
+  s_timer_id = SOFT_TIMER_INVALID_TIMER;
+
+  uint32_t now_us = soft_timer_now_us();
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE; i++) {
+    CanInterval *interval = &s_can_interval_storage[i];
+    if (interval->enabled && (int32_t)(now_us - interval->next_tx_us) >= 0) {
+      generic_can_tx(interval->can, &interval->msg);
+      interval->next_tx_us += interval->period;
+      // Keep the phase, but don't send a burst to catch up if we fell a whole period behind
+      if ((int32_t)(now_us - interval->next_tx_us) >= 0) {
+        interval->next_tx_us +=
+            ((now_us - interval->next_tx_us) / interval->period + 1) * interval->period;
+      }
+    }
+  }
+  prv_schedule(now_us);
 }
 
 static void prv_init_can_interval(void *object, void *context) {
   (void)context;
   CanInterval *interval = object;
   interval->period = 0;
-  interval->timer_id = SOFT_TIMER_INVALID_TIMER;
+  interval->next_tx_us = 0;
+  interval->enabled = false;
   memset(&interval->msg, 0, sizeof(GenericCanMsg));
   interval->can = NULL;
 }
 
 void can_interval_init(void) {
   objpool_init(&s_can_interval_pool, s_can_interval_storage, prv_init_can_interval, NULL);
+  s_timer_id = SOFT_TIMER_INVALID_TIMER;
 }
 
 StatusCode can_interval_factory(const GenericCan *can, const GenericCanMsg *msg, uint32_t period,
@@ -58,14 +172,20 @@ StatusCode can_interval_enable(CanInterval *interval) {
   }
 
   // Check if already active.
-  if (interval->timer_id == SOFT_TIMER_INVALID_TIMER) {
-    // Send now.
-    status_ok_or_return(generic_can_tx(interval->can, &interval->msg));
-    status_ok_or_return(soft_timer_start(interval->period, prv_can_interval_timer_cb,
-                                         (void *)interval, &interval->timer_id));
+  if (interval->enabled) {
+    return STATUS_CODE_OK;
   }
 
-  return STATUS_CODE_OK;
+  // Send now.
+  status_ok_or_return(generic_can_tx(interval->can, &interval->msg));
+
+  bool disabled = critical_section_start();
+  uint32_t now_us = soft_timer_now_us();
+  interval->next_tx_us = prv_first_tx_us(interval, now_us);
+  interval->enabled = true;
+  StatusCode status = prv_schedule(now_us);
+  critical_section_end(disabled);
+  return status;
 }
 
 StatusCode can_interval_disable(CanInterval *interval) {
@@ -73,9 +193,12 @@ StatusCode can_interval_disable(CanInterval *interval) {
     return status_code(STATUS_CODE_INVALID_ARGS);
   }
 
-  if (interval->timer_id != SOFT_TIMER_INVALID_TIMER) {
-    soft_timer_cancel(interval->timer_id);
-    interval->timer_id = SOFT_TIMER_INVALID_TIMER;
+  if (interval->enabled) {
+    bool disabled = critical_section_start();
+    interval->enabled = false;
+    StatusCode status = prv_schedule(soft_timer_now_us());
+    critical_section_end(disabled);
+    return status;
   }
   return STATUS_CODE_OK;
 }
@@ -0,0 +1,105 @@
+#include <stddef.h>
+
+#include "sd_binary.h"
+#include "sd_cache.h"
+
+typedef struct SdAsyncTransfer {
+  uint8_t *buffer;
+  uint32_t blocks_left;
+  bool write;
+  bool busy;
+  EventId event;
+  SdAsyncCallback callback;
+  void *context;
+} SdAsyncTransfer;
+
+static SdAsyncTransfer s_transfers[NUM_SPI_PORTS];
+
+static StatusCode prv_start(SpiPort spi, uint8_t *buffer, uint32_t block, uint32_t num_blocks,
+                            bool write, EventId event, SdAsyncCallback callback, void *context) {
+  if (spi >= NUM_SPI_PORTS || buffer == NULL || num_blocks == 0 || callback == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  SdAsyncTransfer *transfer = &s_transfers[spi];
+  if (transfer->busy) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "SD transfer already in progress\n");
+  }
+
+  if (write) {
+    status_ok_or_return(sd_stream_write_begin(spi, block));
+    sd_cache_invalidate(spi, block, num_blocks);
+  } else {
+    status_ok_or_return(sd_stream_read_begin(spi, block));
+  }
+
+  StatusCode status = event_raise(event, spi);
+  if (!status_ok(status)) {
+    if (write) {
+      sd_stream_write_end(spi);
+    } else {
+      sd_stream_read_end(spi);
+    }
+    return status;
+  }
+
+  *transfer = (SdAsyncTransfer){
+    .buffer = buffer,
+    .blocks_left = num_blocks,
+    .write = write,
+    .busy = true,
+    .event = event,
+    .callback = callback,
+    .context = context,
+  };
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_read_blocks_async(SpiPort spi, uint8_t *dest, uint32_t readBlock,
+                                uint32_t numberOfBlocks, EventId event, SdAsyncCallback callback,
+                                void *context) {
+  return prv_start(spi, dest, readBlock, numberOfBlocks, false, event, callback, context);
+}
+
+StatusCode sd_write_blocks_async(SpiPort spi, uint8_t *src, uint32_t writeBlock,
+                                 uint32_t numberOfBlocks, EventId event, SdAsyncCallback callback,
+                                 void *context) {
+  return prv_start(spi, src, writeBlock, numberOfBlocks, true, event, callback, context);
+}
+
+bool sd_process_event(const Event *e) {
+  if (e == NULL || e->data >= NUM_SPI_PORTS) {
+    return false;
+  }
+  SpiPort spi = (SpiPort)e->data;
+  SdAsyncTransfer *transfer = &s_transfers[spi];
+  if (!transfer->busy || e->id != transfer->event) {
+    return false;
+  }
+
+  StatusCode status = transfer->write ? sd_stream_write(spi, transfer->buffer, 1)
+                                      : sd_stream_read(spi, transfer->buffer, 1);
+  if (status_ok(status)) {
+    transfer->buffer += SD_BLOCK_SIZE;
+    transfer->blocks_left--;
+    if (transfer->blocks_left > 0) {
+      status = event_raise(transfer->event, spi);
+      if (status_ok(status)) {
+        return true;
+      }
+    }
+    // A failed transfer has already ended the stream
+    StatusCode end_status =
+        transfer->write ? sd_stream_write_end(spi) : sd_stream_read_end(spi);
+    if (status_ok(status)) {
+      status = end_status;
+    }
+  }
+
+  transfer->busy = false;
+  transfer->callback(spi, status, transfer->context);
+  return true;
+}
+
+bool sd_async_busy(SpiPort spi) {
+  return spi < NUM_SPI_PORTS && s_transfers[spi].busy;
+}
@@ -0,0 +1,101 @@
+#include "sd_cache.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef struct SdCacheEntry {
+  uint8_t data[SD_BLOCK_SIZE];
+  uint32_t block;
+  // Value of |s_use_count| when the entry was last used, for LRU eviction
+  uint32_t last_used;
+  SpiPort spi;
+  bool valid;
+} SdCacheEntry;
+
+static SdCacheEntry s_entries[SD_CACHE_NUM_BLOCKS];
+static uint32_t s_use_count = 0;
+static SdCacheStats s_stats = { 0 };
+
+static SdCacheEntry *prv_find(SpiPort spi, uint32_t block) {
+  for (size_t i = 0; i < SD_CACHE_NUM_BLOCKS; i++) {
+    if (s_entries[i].valid && s_entries[i].spi == spi && s_entries[i].block == block) {
+      return &s_entries[i];
+    }
+  }
+  return NULL;
+}
+
+// Stores the block, replacing the least recently used entry if it isn't cached yet
+static void prv_store(SpiPort spi, uint32_t block, const uint8_t *data) {
+  SdCacheEntry *entry = prv_find(spi, block);
+  for (size_t i = 0; entry == NULL && i < SD_CACHE_NUM_BLOCKS; i++) {
+    if (!s_entries[i].valid) {
+      entry = &s_entries[i];
+    }
+  }
+  if (entry == NULL) {
+    entry = &s_entries[0];
+    for (size_t i = 1; i < SD_CACHE_NUM_BLOCKS; i++) {
+      if (s_entries[i].last_used < entry->last_used) {
+        entry = &s_entries[i];
+      }
+    }
+  }
+
+  memcpy(entry->data, data, SD_BLOCK_SIZE);
+  entry->spi = spi;
+  entry->block = block;
+  entry->valid = true;
+  entry->last_used = ++s_use_count;
+}
+
+StatusCode sd_cache_read_blocks(SpiPort spi, uint8_t *dest, uint32_t readBlock,
+                                uint32_t numberOfBlocks) {
+  if (numberOfBlocks != 1) {
+    return sd_read_blocks(spi, dest, readBlock, numberOfBlocks);
+  }
+
+  SdCacheEntry *entry = prv_find(spi, readBlock);
+  if (entry != NULL) {
+    s_stats.hits++;
+    entry->last_used = ++s_use_count;
+    memcpy(dest, entry->data, SD_BLOCK_SIZE);
+    return STATUS_CODE_OK;
+  }
+
+  s_stats.misses++;
+  status_ok_or_return(sd_read_blocks(spi, dest, readBlock, 1));
+  prv_store(spi, readBlock, dest);
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_cache_write_blocks(SpiPort spi, uint8_t *src, uint32_t writeBlock,
+                                 uint32_t numberOfBlocks) {
+  sd_cache_invalidate(spi, writeBlock, numberOfBlocks);
+  status_ok_or_return(sd_write_blocks(spi, src, writeBlock, numberOfBlocks));
+  if (numberOfBlocks == 1) {
+    prv_store(spi, writeBlock, src);
+  }
+  return STATUS_CODE_OK;
+}
+
+void sd_cache_invalidate(SpiPort spi, uint32_t block, uint32_t numberOfBlocks) {
+  for (size_t i = 0; i < SD_CACHE_NUM_BLOCKS; i++) {
+    if (s_entries[i].spi == spi && s_entries[i].block - block < numberOfBlocks) {
+      s_entries[i].valid = false;
+    }
+  }
+}
+
+void sd_cache_clear(SpiPort spi) {
+  for (size_t i = 0; i < SD_CACHE_NUM_BLOCKS; i++) {
+    if (s_entries[i].spi == spi) {
+      s_entries[i].valid = false;
+    }
+  }
+}
+
+void sd_cache_get_stats(SdCacheStats *stats) {
+  *stats = s_stats;
+}
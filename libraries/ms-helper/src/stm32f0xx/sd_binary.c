@@ -47,6 +47,9 @@
 // Amount of times to retry when doing initialization
 #define SD_NUM_RETRIES 100
 
+// The size of the card-specific data register
+#define SD_CSD_SIZE 16
+
 // The default byte to send
 #define SD_DUMMY_BYTE (0xFF)
 
@@ -62,9 +65,12 @@
 
 #define SD_CMD_GO_IDLE_STATE (0)
 #define SD_CMD_SEND_IF_COND (8)
+#define SD_CMD_SEND_CSD (9)
+#define SD_CMD_STOP_TRANSMISSION (12)
 #define SD_CMD_STATUS (13)
 #define SD_CMD_SET_BLOCKLEN (16)
 #define SD_CMD_READ_SINGLE_BLOCK (17)
+#define SD_CMD_READ_MULTI_BLOCK (18)
 #define SD_CMD_WRITE_SINGLE_BLOCK (24)
 #define SD_CMD_WRITE_MULTI_BLOCK (25)
 #define SD_CMD_SD_APP_OP_COND (41)
@@ -86,6 +92,12 @@ typedef enum {
   NUM_SD_RESPONSES
 } SdResponseType;
 
+typedef enum {
+  SD_STREAM_NONE = 0,
+  SD_STREAM_READ,
+  SD_STREAM_WRITE,
+} SdStream;
+
 typedef struct SdResponse {
   uint8_t r1;
   uint8_t r2;
@@ -94,6 +106,9 @@ typedef struct SdResponse {
   uint8_t r5;
 } SdResponse;
 
+// Whether a multi-block transfer is in progress on each port
+static SdStream s_stream[NUM_SPI_PORTS];
+
 static uint8_t prv_read_byte(SpiPort spi) {
   uint8_t result = 0x00;
   spi_rx(spi, &result, 1, 0xFF);
@@ -294,76 +309,140 @@ StatusCode sd_wait_data(SpiPort spi, uint8_t data) {
   return STATUS_CODE_OK;
 }
 
-StatusCode sd_read_blocks(SpiPort spi, uint8_t *dest, uint32_t ReadAddr, uint32_t NumberOfBlocks) {
-  uint32_t offset = 0;
-  SdResponse response;
+static StatusCode prv_check_not_streaming(SpiPort spi) {
+  if (s_stream[spi] != SD_STREAM_NONE) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "SD card is busy streaming\n");
+  }
+  return STATUS_CODE_OK;
+}
 
+static StatusCode prv_set_block_len(SpiPort spi) {
   // Send CMD16 (SD_CMD_SET_BLOCKLEN) to set the size of the block and
   // Check if the SD acknowledged the set block length command: R1 response
   // (0x00: no errors)
-  response = prv_send_cmd(spi, SD_CMD_SET_BLOCKLEN, SD_BLOCK_SIZE, 0xFF, SD_RESPONSE_R1);
+  SdResponse response =
+      prv_send_cmd(spi, SD_CMD_SET_BLOCKLEN, SD_BLOCK_SIZE, 0xFF, SD_RESPONSE_R1);
   prv_pulse_idle(spi);
+  if (response.r1 != SD_R1_NO_ERROR) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card error\n");
+  }
+  return STATUS_CODE_OK;
+}
 
+// Reads the data token, the block and its CRC
+static StatusCode prv_read_data_block(SpiPort spi, uint8_t *dest) {
+  // Now look for the data token to signify the start of the data
+  if (!status_ok(sd_wait_data(spi, SD_TOKEN_START_DATA_SINGLE_BLOCK_READ))) {
+    return status_msg(STATUS_CODE_TIMEOUT, "SD card timeout\n");
+  }
+
+  // Read the SD block data : read 512 bytes of data
+  spi_rx(spi, dest, SD_BLOCK_SIZE, SD_DUMMY_BYTE);
+  // get CRC bytes (not really needed by us, but required by SD)
+  prv_write_dummy(spi, 2);
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_sd_read_block(SpiPort spi, uint8_t *dest, uint32_t ReadBlock) {
+  status_ok_or_return(prv_set_block_len(spi));
+
+  // Send CMD17 (SD_CMD_READ_SINGLE_BLOCK) to read one block
+  // Check if the SD acknowledged the read block command: R1 response (0x00:
+  // no errors)
+  SdResponse response =
+      prv_send_cmd(spi, SD_CMD_READ_SINGLE_BLOCK, ReadBlock, 0xFF, SD_RESPONSE_R1);
   if (response.r1 != SD_R1_NO_ERROR) {
     prv_pulse_idle(spi);
     return status_msg(STATUS_CODE_INTERNAL_ERROR,
                       "Failed to read because SD card responded with an error\n");
   }
 
-  // Data transfer
-  while (NumberOfBlocks--) {
-    // Send CMD17 (SD_CMD_READ_SINGLE_BLOCK) to read one block
-    // Check if the SD acknowledged the read block command: R1 response (0x00:
-    // no errors)
-    response = prv_send_cmd(spi, SD_CMD_READ_SINGLE_BLOCK, (ReadAddr + offset) / SD_BLOCK_SIZE,
-                            0xFF, SD_RESPONSE_R1);
-    if (response.r1 != SD_R1_NO_ERROR) {
-      prv_pulse_idle(spi);
-      return status_msg(STATUS_CODE_INTERNAL_ERROR,
-                        "Failed to read because SD card responded with an error\n");
-    }
+  StatusCode status = prv_read_data_block(spi, dest);
+  prv_pulse_idle(spi);
+  return status;
+}
 
-    // Now look for the data token to signify the start of the data
-    if (status_ok(sd_wait_data(spi, SD_TOKEN_START_DATA_SINGLE_BLOCK_READ))) {
-      // Read the SD block data : read 512 bytes of data
-      spi_rx(spi, dest + offset, SD_BLOCK_SIZE, 0xFF);
-
-      // Set next read address
-      offset += SD_BLOCK_SIZE;
-      // get CRC bytes (not really needed by us, but required by SD)
-      prv_write_dummy(spi, 3);
-    } else {
-      prv_pulse_idle(spi);
-      return status_msg(STATUS_CODE_TIMEOUT, "SD card timeout\n");
-    }
+StatusCode sd_stream_read_begin(SpiPort spi, uint32_t ReadBlock) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  status_ok_or_return(prv_set_block_len(spi));
 
-    // Sets the CS line to high to end the read transaction
-    spi_cs_set_state(spi, GPIO_STATE_HIGH);
-    prv_write_read_byte(spi, SD_DUMMY_BYTE);
+  // Send CMD18 (SD_CMD_READ_MULTI_BLOCK) - the card then sends consecutive
+  // blocks until it's told to stop
+  SdResponse response = prv_send_cmd(spi, SD_CMD_READ_MULTI_BLOCK, ReadBlock, 0xFF, SD_RESPONSE_R1);
+  if (response.r1 != SD_R1_NO_ERROR) {
+    prv_pulse_idle(spi);
+    return status_msg(STATUS_CODE_INTERNAL_ERROR,
+                      "Failed to read because SD card responded with an error\n");
   }
 
-  prv_pulse_idle(spi);
+  s_stream[spi] = SD_STREAM_READ;
   return STATUS_CODE_OK;
 }
 
-static StatusCode prv_sd_write_block(SpiPort spi, uint8_t *src, uint32_t WriteAddr) {
-  SdResponse response;
+StatusCode sd_stream_read(SpiPort spi, uint8_t *dest, uint32_t NumberOfBlocks) {
+  if (s_stream[spi] != SD_STREAM_READ) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD read stream\n");
+  }
+
+  for (uint32_t i = 0; i < NumberOfBlocks; i++) {
+    StatusCode status = prv_read_data_block(spi, dest + i * SD_BLOCK_SIZE);
+    if (!status_ok(status)) {
+      sd_stream_read_end(spi);
+      return status;
+    }
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_stream_read_end(SpiPort spi) {
+  if (s_stream[spi] != SD_STREAM_READ) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD read stream\n");
+  }
+  s_stream[spi] = SD_STREAM_NONE;
+
+  // Send CMD12 (SD_CMD_STOP_TRANSMISSION) straight away, since the card is
+  // still sending data. The byte after the command is junk, followed by the R1
+  // response and then busy until the card is ready again.
+  uint8_t frame[SD_SEND_SIZE] = { SD_CMD_STOP_TRANSMISSION | 0x40, 0, 0, 0, 0, 0xFF };
+  spi_tx(spi, frame, SD_SEND_SIZE);
+  prv_read_byte(spi);
+  uint8_t r1 = prv_wait_byte(spi);
+
+  uint16_t timeout = 0xFFFF;
+  while (prv_read_byte(spi) != SD_DUMMY_BYTE && timeout) {
+    timeout--;
+  }
 
-  // Send CMD16 (SD_CMD_SET_BLOCKLEN) to set the size of the block and
-  // Check if the SD acknowledged the set block length command: R1 response
-  // (0x00: no errors)
-  response = prv_send_cmd(spi, SD_CMD_SET_BLOCKLEN, SD_BLOCK_SIZE, 0xFF, SD_RESPONSE_R1);
   prv_pulse_idle(spi);
-  if (response.r1 != SD_R1_NO_ERROR) {
+  if (r1 != SD_R1_NO_ERROR) {
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card error\n");
   }
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_read_blocks(SpiPort spi, uint8_t *dest, uint32_t ReadBlock, uint32_t NumberOfBlocks) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  if (NumberOfBlocks == 0) {
+    return STATUS_CODE_OK;
+  }
+  if (NumberOfBlocks == 1) {
+    return prv_sd_read_block(spi, dest, ReadBlock);
+  }
+
+  status_ok_or_return(sd_stream_read_begin(spi, ReadBlock));
+  status_ok_or_return(sd_stream_read(spi, dest, NumberOfBlocks));
+  return sd_stream_read_end(spi);
+}
+
+static StatusCode prv_sd_write_block(SpiPort spi, uint8_t *src, uint32_t WriteBlock) {
+  status_ok_or_return(prv_set_block_len(spi));
 
   // Send CMD24 (SD_CMD_WRITE_SINGLE_BLOCK) to write blocks  and
   // Check if the SD acknowledged the write block command: R1 response (0x00: no
   // errors)
 
-  response =
-      prv_send_cmd(spi, SD_CMD_WRITE_SINGLE_BLOCK, WriteAddr / SD_BLOCK_SIZE, 0xFF, SD_RESPONSE_R1);
+  SdResponse response =
+      prv_send_cmd(spi, SD_CMD_WRITE_SINGLE_BLOCK, WriteBlock, 0xFF, SD_RESPONSE_R1);
   if (response.r1 != SD_R1_NO_ERROR) {
     prv_pulse_idle(spi);
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card error\n");
@@ -393,47 +472,36 @@ static StatusCode prv_sd_write_block(SpiPort spi, uint8_t *src, uint32_t WriteAd
   return STATUS_CODE_OK;
 }
 
-StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t WriteAddr, uint32_t NumberOfBlocks) {
-  if (!NumberOfBlocks) {
-    return prv_sd_write_block(spi, src, WriteAddr);
-  }
-
-  uint32_t offset = 0;
-  SdResponse response;
+StatusCode sd_stream_write_begin(SpiPort spi, uint32_t WriteBlock) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  status_ok_or_return(prv_set_block_len(spi));
 
-  // Send CMD16 (SD_CMD_SET_BLOCKLEN) to set the size of the block and
-  // Check if the SD acknowledged the set block length command: R1 response
-  // (0x00: no errors)
-  response = prv_send_cmd(spi, SD_CMD_SET_BLOCKLEN, SD_BLOCK_SIZE, 0xFF, SD_RESPONSE_R1);
-  prv_pulse_idle(spi);
-  if (response.r1 != SD_R1_NO_ERROR) {
-    return status_code(STATUS_CODE_INTERNAL_ERROR);
-  }
-
-  // Data transfer
-  response = prv_send_cmd(spi, SD_CMD_WRITE_MULTI_BLOCK, (WriteAddr + offset) / SD_BLOCK_SIZE, 0xFF,
-                          SD_RESPONSE_R1);
+  // Send CMD25 (SD_CMD_WRITE_MULTI_BLOCK) - the card then writes consecutive
+  // blocks until it gets the stop token
+  SdResponse response =
+      prv_send_cmd(spi, SD_CMD_WRITE_MULTI_BLOCK, WriteBlock, 0xFF, SD_RESPONSE_R1);
   if (response.r1 != SD_R1_NO_ERROR) {
     prv_pulse_idle(spi);
-    return status_code(STATUS_CODE_INTERNAL_ERROR);
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card error\n");
   }
 
   prv_write_dummy(spi, SD_DUMMY_COUNT_CONST);
+  s_stream[spi] = SD_STREAM_WRITE;
+  return STATUS_CODE_OK;
+}
 
-  while (NumberOfBlocks--) {
-    // Send CMD24 (SD_CMD_WRITE_SINGLE_BLOCK) to write blocks  and
-    // Check if the SD acknowledged the write block command: R1 response (0x00:
-    // no errors)
+StatusCode sd_stream_write(SpiPort spi, uint8_t *src, uint32_t NumberOfBlocks) {
+  if (s_stream[spi] != SD_STREAM_WRITE) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD write stream\n");
+  }
 
+  for (uint32_t i = 0; i < NumberOfBlocks; i++) {
     // Send the data token to signify the start of the data
     uint8_t dat = SD_TOKEN_START_DATA_MULTI_BLOCK_WRITE;
     spi_tx(spi, &dat, 1);
 
     // Write the block data to SD
-    spi_tx(spi, src + offset, SD_BLOCK_SIZE);
-
-    // Set next write address
-    offset += SD_BLOCK_SIZE;
+    spi_tx(spi, src + i * SD_BLOCK_SIZE, SD_BLOCK_SIZE);
 
     // Put CRC bytes (not really needed by us, but required by SD)
     uint8_t crc = 0x00;
@@ -442,12 +510,20 @@ StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t WriteAddr, uint32
 
     if (!status_ok(prv_sd_get_data_response(spi))) {
       // Quit and return failed status
-      prv_pulse_idle(spi);
-      return status_code(STATUS_CODE_INTERNAL_ERROR);
+      sd_stream_write_end(spi);
+      return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card error\n");
     }
   }
+  return STATUS_CODE_OK;
+}
 
-  // Write the block data to SD
+StatusCode sd_stream_write_end(SpiPort spi) {
+  if (s_stream[spi] != SD_STREAM_WRITE) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD write stream\n");
+  }
+  s_stream[spi] = SD_STREAM_NONE;
+
+  // Send the stop token to end the transfer
   uint8_t end_transmission = SD_TOKEN_STOP_DATA_MULTI_BLOCK_WRITE;
   spi_tx(spi, &end_transmission, 1);
 
@@ -464,7 +540,55 @@ StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t WriteAddr, uint32
   return STATUS_CODE_OK;
 }
 
+StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t WriteBlock, uint32_t NumberOfBlocks) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  if (NumberOfBlocks == 0) {
+    return STATUS_CODE_OK;
+  }
+  if (NumberOfBlocks == 1) {
+    return prv_sd_write_block(spi, src, WriteBlock);
+  }
+
+  status_ok_or_return(sd_stream_write_begin(spi, WriteBlock));
+  status_ok_or_return(sd_stream_write(spi, src, NumberOfBlocks));
+  return sd_stream_write_end(spi);
+}
+
+StatusCode sd_get_num_blocks(SpiPort spi, uint32_t *num_blocks) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+
+  // Send CMD9 (SD_CMD_SEND_CSD) to read the card-specific data register, which
+  // comes back like a data block
+  SdResponse response = prv_send_cmd(spi, SD_CMD_SEND_CSD, 0, 0xFF, SD_RESPONSE_R1);
+  if (response.r1 != SD_R1_NO_ERROR) {
+    prv_pulse_idle(spi);
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card error\n");
+  }
+
+  if (!status_ok(sd_wait_data(spi, SD_TOKEN_START_DATA_SINGLE_BLOCK_READ))) {
+    prv_pulse_idle(spi);
+    return status_msg(STATUS_CODE_TIMEOUT, "SD card timeout\n");
+  }
+
+  uint8_t csd[SD_CSD_SIZE] = { 0 };
+  spi_rx(spi, csd, SD_CSD_SIZE, SD_DUMMY_BYTE);
+  // get CRC bytes
+  prv_write_dummy(spi, 2);
+  prv_pulse_idle(spi);
+
+  // CSD version 2.0 is used by SDHC and SDXC cards
+  if ((csd[0] >> 6) != 1) {
+    return status_msg(STATUS_CODE_UNIMPLEMENTED, "Only SDHC and SDXC cards are supported\n");
+  }
+
+  // C_SIZE is bits 69:48, and the capacity is (C_SIZE + 1) * 512 KiB
+  uint32_t c_size = ((uint32_t)(csd[7] & 0x3F) << 16) | ((uint32_t)csd[8] << 8) | csd[9];
+  *num_blocks = (c_size + 1) * 1024;
+  return STATUS_CODE_OK;
+}
+
 StatusCode sd_is_initialized(SpiPort spi) {
+  status_ok_or_return(prv_check_not_streaming(spi));
   SdResponse res = prv_send_cmd(spi, SD_CMD_STATUS, 0, SD_DUMMY_BYTE, SD_RESPONSE_R2);
   prv_write_dummy(spi, 1);
 
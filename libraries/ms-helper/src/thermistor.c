@@ -1,5 +1,6 @@
 #include "thermistor.h"
 #include <limits.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include "log.h"
 
@@ -7,21 +8,41 @@
 // https://www.murata.com/en-global/products/productdata/8796836626462/NTHCG83.txt
 // Expected resistance in milliohms for a given temperature in celsius
 //
-// This table covers the range [0 C, 100 C] in 1 degree steps
-static const uint32_t s_resistance_lookup[] = {
-  27218600, 26076000, 24987700, 23950900, 22962900, 22021100, 21123000, 20266600, 19449500,
-  18669800, 17925500, 17213900, 16534400, 15885600, 15265800, 14673500, 14107500, 13566400,
-  13048900, 12554000, 12080500, 11628100, 11194700, 10779500, 10381500, 10000000, 9634200,
-  9283500,  8947000,  8624200,  8314500,  8018100,  7733700,  7460900,  7199100,  6947900,
-  6706700,  6475100,  6252600,  6039000,  5833600,  5635700,  5445400,  5262300,  5086300,
-  4916900,  4753900,  4597100,  4446100,  4300800,  4160900,  4026200,  3896400,  3771400,
-  3651000,  3535000,  3423100,  3315200,  3211300,  3111000,  3014300,  2922400,  2833700,
-  2748200,  2665700,  2586100,  2509300,  2435100,  2363500,  2294300,  2227500,  2162700,
-  2100100,  2039600,  1981100,  1924500,  1869800,  1817000,  1765800,  1716400,  1668500,
-  1622400,  1577700,  1534500,  1492700,  1452100,  1412900,  1374900,  1338100,  1302500,
-  1268000,  1234300,  1201600,  1170000,  1139300,  1109600,  1080700,  1052800,  1025600,
-  999300,   973800,
-};
+// This table covers the range [0 C, 100 C] in 1 degree steps. It is expanded into both lookup
+// tables below so they're generated at compile time from the same data.
+#define THERMISTOR_RESISTANCE_TABLE(X)                                                            \
+  X(27218600) X(26076000) X(24987700) X(23950900) X(22962900) X(22021100) X(21123000) X(20266600) \
+  X(19449500) X(18669800) X(17925500) X(17213900) X(16534400) X(15885600) X(15265800) X(14673500) \
+  X(14107500) X(13566400) X(13048900) X(12554000) X(12080500) X(11628100) X(11194700) X(10779500) \
+  X(10381500) X(10000000) X(9634200) X(9283500) X(8947000) X(8624200) X(8314500) X(8018100)       \
+  X(7733700) X(7460900) X(7199100) X(6947900) X(6706700) X(6475100) X(6252600) X(6039000)         \
+  X(5833600) X(5635700) X(5445400) X(5262300) X(5086300) X(4916900) X(4753900) X(4597100)         \
+  X(4446100) X(4300800) X(4160900) X(4026200) X(3896400) X(3771400) X(3651000) X(3535000)         \
+  X(3423100) X(3315200) X(3211300) X(3111000) X(3014300) X(2922400) X(2833700) X(2748200)         \
+  X(2665700) X(2586100) X(2509300) X(2435100) X(2363500) X(2294300) X(2227500) X(2162700)         \
+  X(2100100) X(2039600) X(1981100) X(1924500) X(1869800) X(1817000) X(1765800) X(1716400)         \
+  X(1668500) X(1622400) X(1577700) X(1534500) X(1492700) X(1452100) X(1412900) X(1374900)         \
+  X(1338100) X(1302500) X(1268000) X(1234300) X(1201600) X(1170000) X(1139300) X(1109600)         \
+  X(1080700) X(1052800) X(1025600) X(999300) X(973800)
+
+#define THERMISTOR_FIXED_RESISTANCE_MILLIOHMS ((uint64_t)THERMISTOR_FIXED_RESISTANCE_OHMS * 1000)
+
+// Divider ratios are fractions of VDDA scaled by 2^16
+#define THERMISTOR_RATIO_SHIFT 16
+
+#define THERMISTOR_RESISTANCE_ENTRY(milliohms) (milliohms),
+// Fraction of VDDA across the fixed resistor for a given thermistor resistance
+#define THERMISTOR_RATIO_ENTRY(milliohms)                                         \
+  (uint16_t)((THERMISTOR_FIXED_RESISTANCE_MILLIOHMS << THERMISTOR_RATIO_SHIFT) / \
+             ((milliohms) + THERMISTOR_FIXED_RESISTANCE_MILLIOHMS)),
+
+// Thermistor resistance in milliohms, decreasing with temperature
+static const uint32_t s_resistance_lookup[] = { THERMISTOR_RESISTANCE_TABLE(
+    THERMISTOR_RESISTANCE_ENTRY) };
+
+// Divider ratio, increasing with temperature. This turns a reading straight into a temperature
+// without first working out the thermistor's resistance.
+static const uint16_t s_ratio_lookup[] = { THERMISTOR_RESISTANCE_TABLE(THERMISTOR_RATIO_ENTRY) };
 
 // Used for converting the lookup table index with corresponding temperatures
 #define THERMISTOR_LOOKUP_RANGE (SIZEOF_ARRAY(s_resistance_lookup) - 1)
@@ -47,11 +68,47 @@ StatusCode thermistor_init(ThermistorStorage *storage, GpioAddress thermistor_gp
   return STATUS_CODE_OK;
 }
 
+// Converts a node voltage in millivolts to deciCelsius through the divider ratio table.
+// Returns false if it's out of the table's range.
+static bool prv_reading_to_temp(ThermistorPosition position, uint16_t vdda, uint16_t reading,
+                                uint16_t *temperature_dc) {
+  *temperature_dc = UINT16_MAX;
+  if (reading >= vdda) {
+    return false;
+  }
+
+  // The ratio is always taken across the fixed resistor
+  uint32_t fixed_mv = (position == THERMISTOR_POSITION_R1) ? reading : (uint32_t)(vdda - reading);
+  uint32_t ratio = (fixed_mv << THERMISTOR_RATIO_SHIFT) / vdda;
+  if (ratio < s_ratio_lookup[0] || ratio > s_ratio_lookup[THERMISTOR_LOOKUP_RANGE]) {
+    return false;
+  }
+
+  // Binary search for the last entry at or below the ratio
+  size_t low = 0;
+  size_t high = THERMISTOR_LOOKUP_RANGE - 1;
+  while (low < high) {
+    size_t mid = (low + high + 1) / 2;
+    if (s_ratio_lookup[mid] <= ratio) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  // Linearly interpolate within the degree, rounding to the nearest deciCelsius
+  uint32_t step = (uint32_t)(s_ratio_lookup[low + 1] - s_ratio_lookup[low]);
+  *temperature_dc = (uint16_t)(THERMISTOR_CELSIUS_TO_DECICELSIUS(low) +
+                               (THERMISTOR_CELSIUS_TO_DECICELSIUS(ratio - s_ratio_lookup[low]) +
+                                step / 2) /
+                                   step);
+  return true;
+}
+
 StatusCode thermistor_get_temp(ThermistorStorage *storage, uint16_t *temperature_dc) {
   // Fetch the voltage readings
-  uint16_t reading = 0;                     // the divided voltage in millivolts
-  uint32_t thermistor_resistance_ohms = 0;  // resistance in milliohms
-  uint16_t vdda = 0;                        // vdda voltage in millivolts
+  uint16_t reading = 0;  // the divided voltage in millivolts
+  uint16_t vdda = 0;     // vdda voltage in millivolts
 
   // Get source voltage and node voltage of the voltage divider
   status_ok_or_return(adc_read_converted(ADC_CHANNEL_REF, &vdda));
@@ -65,35 +122,88 @@ StatusCode thermistor_get_temp(ThermistorStorage *storage, uint16_t *temperature
     return status_msg(STATUS_CODE_INTERNAL_ERROR, "No node voltage detected.");
   }
 
-  // Calculates thermistor resistance in milliOhms based on the position of
-  // thermistor and the fixed resistor
-  if (storage->position == THERMISTOR_POSITION_R1) {
-    thermistor_resistance_ohms =
-        ((uint32_t)(vdda - reading)) * (uint32_t)THERMISTOR_FIXED_RESISTANCE_OHMS / reading;
-  } else {
-    thermistor_resistance_ohms =
-        ((uint32_t)THERMISTOR_FIXED_RESISTANCE_OHMS * reading) / (uint32_t)(vdda - reading);
+  if (!prv_reading_to_temp(storage->position, vdda, reading, temperature_dc)) {
+    return status_msg(STATUS_CODE_OUT_OF_RANGE, "Temperature out of lookup table range.");
   }
-  return thermistor_calculate_temp(thermistor_resistance_ohms, (uint16_t *)temperature_dc);
+  return STATUS_CODE_OK;
+}
+
+StatusCode thermistor_get_temps(ThermistorStorage *storages, size_t num_thermistors,
+                                uint16_t *temperatures_dc) {
+  if (storages == NULL || temperatures_dc == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  // VDDA is shared by every thermistor, so it only needs to be read once
+  uint16_t vdda = 0;
+  status_ok_or_return(adc_read_converted(ADC_CHANNEL_REF, &vdda));
+  if (vdda == 0) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "No source voltage detected.");
+  }
+
+  bool in_range = true;
+  for (size_t i = 0; i < num_thermistors; i++) {
+    uint16_t reading = 0;
+    status_ok_or_return(adc_read_converted(storages[i].adc_channel, &reading));
+    in_range &= prv_reading_to_temp(storages[i].position, vdda, reading, &temperatures_dc[i]);
+  }
+
+  if (!in_range) {
+    return status_msg(STATUS_CODE_OUT_OF_RANGE, "Temperature out of lookup table range.");
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode thermistor_convert_readings(ThermistorPosition position, uint16_t vdda_mv,
+                                       const uint16_t *readings_mv, uint16_t *temperatures_dc,
+                                       size_t num_readings) {
+  if (readings_mv == NULL || temperatures_dc == NULL || position >= NUM_THERMISTOR_POSITIONS ||
+      vdda_mv == 0) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  bool in_range = true;
+  for (size_t i = 0; i < num_readings; i++) {
+    in_range &= prv_reading_to_temp(position, vdda_mv, readings_mv[i], &temperatures_dc[i]);
+  }
+
+  if (!in_range) {
+    return status_msg(STATUS_CODE_OUT_OF_RANGE, "Temperature out of lookup table range.");
+  }
+  return STATUS_CODE_OK;
 }
 
 StatusCode thermistor_calculate_temp(uint32_t thermistor_resistance_ohms,
                                      uint16_t *temperature_dc) {
-  // Find the approximate target temperature from the arguments passed
-  for (uint16_t i = 0; i < SIZEOF_ARRAY(s_resistance_lookup) - 1; i++) {
-    if (thermistor_resistance_ohms * 1000 <= s_resistance_lookup[i] &&
-        thermistor_resistance_ohms * 1000 >= s_resistance_lookup[i + 1]) {
-      // Return the temperature with the linear approximation in deciCelsius
-      *temperature_dc = (uint16_t)(
-          ((uint32_t)i * 1000 + ((s_resistance_lookup[i] - thermistor_resistance_ohms * 1000) *
-                                 1000 / (s_resistance_lookup[i] - s_resistance_lookup[i + 1]))) /
-          100);
-      return STATUS_CODE_OK;
+  // Sets the returned temperature to be absurdly large if out of range
+  *temperature_dc = UINT16_MAX;
+  if (thermistor_resistance_ohms > THERMISTOR_MILLIOHMS_TO_OHMS(s_resistance_lookup[0])) {
+    return status_msg(STATUS_CODE_OUT_OF_RANGE, "Temperature out of lookup table range.");
+  }
+  uint32_t thermistor_resistance_milliohms = thermistor_resistance_ohms * 1000;
+  if (thermistor_resistance_milliohms < s_resistance_lookup[THERMISTOR_LOOKUP_RANGE]) {
+    return status_msg(STATUS_CODE_OUT_OF_RANGE, "Temperature out of lookup table range.");
+  }
+
+  // Binary search for the last entry at or above the resistance
+  size_t low = 0;
+  size_t high = THERMISTOR_LOOKUP_RANGE - 1;
+  while (low < high) {
+    size_t mid = (low + high + 1) / 2;
+    if (s_resistance_lookup[mid] >= thermistor_resistance_milliohms) {
+      low = mid;
+    } else {
+      high = mid - 1;
     }
   }
-  // Sets the returned temperature to be absurdly large
-  *temperature_dc = UINT16_MAX;
-  return status_msg(STATUS_CODE_OUT_OF_RANGE, "Temperature out of lookup table range.");
+
+  // Return the temperature with the linear approximation in deciCelsius
+  *temperature_dc =
+      (uint16_t)(((uint32_t)low * 1000 +
+                  ((s_resistance_lookup[low] - thermistor_resistance_milliohms) * 1000 /
+                   (s_resistance_lookup[low] - s_resistance_lookup[low + 1]))) /
+                 100);
+  return STATUS_CODE_OK;
 }
 
 StatusCode thermistor_calculate_resistance(uint16_t temperature_dc,
@@ -1,23 +1,224 @@
 #include "sd_binary.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
-#include "spi.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "delay.h"
+#include "log.h"
+#include "x86_sd_binary.h"
+
+typedef enum {
+  SD_STREAM_NONE = 0,
+  SD_STREAM_READ,
+  SD_STREAM_WRITE,
+} SdStream;
+
+typedef struct SdStreamState {
+  SdStream stream;
+  // Next block in the stream
+  uint32_t block;
+} SdStreamState;
+
+static int s_image_fd = -1;
+static uint32_t s_num_blocks = 0;
+static X86SdStats s_stats = { 0 };
+static SdStreamState s_streams[NUM_SPI_PORTS];
+
+static uint32_t s_command_latency_us = 0;
+static uint32_t s_block_latency_us = 0;
+
+static void prv_wait(uint32_t latency_us) {
+  if (latency_us > 0) {
+    delay_spin_us(latency_us);
+  }
+}
+
+static StatusCode prv_check_range(uint32_t block, uint32_t num_blocks) {
+  if (s_image_fd < 0) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+  if ((uint64_t)block + num_blocks > s_num_blocks) {
+    return status_code(STATUS_CODE_OUT_OF_RANGE);
+  }
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_check_not_streaming(SpiPort spi) {
+  if (s_streams[spi].stream != SD_STREAM_NONE) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "SD card is busy streaming\n");
+  }
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_read(uint8_t *dest, uint32_t block, uint32_t num_blocks) {
+  status_ok_or_return(prv_check_range(block, num_blocks));
+
+  prv_wait(s_block_latency_us * num_blocks);
+  size_t len = (size_t)num_blocks * SD_BLOCK_SIZE;
+  if (pread(s_image_fd, dest, len, (off_t)block * SD_BLOCK_SIZE) != (ssize_t)len) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card image read failed\n");
+  }
+  s_stats.blocks_read += num_blocks;
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_write(const uint8_t *src, uint32_t block, uint32_t num_blocks) {
+  status_ok_or_return(prv_check_range(block, num_blocks));
+
+  prv_wait(s_block_latency_us * num_blocks);
+  size_t len = (size_t)num_blocks * SD_BLOCK_SIZE;
+  if (pwrite(s_image_fd, src, len, (off_t)block * SD_BLOCK_SIZE) != (ssize_t)len) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "SD card image write failed\n");
+  }
+  s_stats.blocks_written += num_blocks;
+  return STATUS_CODE_OK;
+}
+
+static void prv_command(void) {
+  prv_wait(s_command_latency_us);
+  s_stats.commands++;
+}
 
 StatusCode sd_card_init(SpiPort spi) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+  if (s_image_fd >= 0) {
+    close(s_image_fd);
+  }
+
+  const char *filename = getenv(X86_SD_IMAGE_VAR);
+  if (filename == NULL) {
+    filename = X86_SD_DEFAULT_IMAGE_FILE;
+  }
+  LOG_DEBUG("Using SD card image: %s\n", filename);
+
+  s_image_fd = open(filename, O_RDWR | O_CREAT, 0644);
+  if (s_image_fd < 0) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "Could not open SD card image\n");
+  }
+
+  struct stat image_stat;
+  if (fstat(s_image_fd, &image_stat) != 0) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "Could not stat SD card image\n");
+  }
+  if (image_stat.st_size < SD_BLOCK_SIZE) {
+    LOG_DEBUG("Setting up new SD card image\n");
+    image_stat.st_size = (off_t)X86_SD_DEFAULT_NUM_BLOCKS * SD_BLOCK_SIZE;
+    if (ftruncate(s_image_fd, image_stat.st_size) != 0) {
+      return status_msg(STATUS_CODE_INTERNAL_ERROR, "Could not size SD card image\n");
+    }
+  }
+  s_num_blocks = (uint32_t)(image_stat.st_size / SD_BLOCK_SIZE);
+  memset(&s_stats, 0, sizeof(s_stats));
+  memset(s_streams, 0, sizeof(s_streams));
+
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_read_blocks(SpiPort spi, uint8_t *dest, uint32_t ReadBlock, uint32_t NumberOfBlocks) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  if (NumberOfBlocks == 0) {
+    return STATUS_CODE_OK;
+  }
+
+  prv_command();
+  return prv_read(dest, ReadBlock, NumberOfBlocks);
+}
+
+StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t WriteBlock, uint32_t NumberOfBlocks) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  if (NumberOfBlocks == 0) {
+    return STATUS_CODE_OK;
+  }
+
+  prv_command();
+  s_stats.write_calls++;
+  return prv_write(src, WriteBlock, NumberOfBlocks);
+}
+
+StatusCode sd_stream_read_begin(SpiPort spi, uint32_t ReadBlock) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  status_ok_or_return(prv_check_range(ReadBlock, 0));
+
+  prv_command();
+  s_streams[spi] = (SdStreamState){ .stream = SD_STREAM_READ, .block = ReadBlock };
+  return STATUS_CODE_OK;
 }
 
-StatusCode sd_wait_data(SpiPort spi, uint8_t data) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+StatusCode sd_stream_read(SpiPort spi, uint8_t *dest, uint32_t NumberOfBlocks) {
+  if (s_streams[spi].stream != SD_STREAM_READ) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD read stream\n");
+  }
+
+  StatusCode status = prv_read(dest, s_streams[spi].block, NumberOfBlocks);
+  if (!status_ok(status)) {
+    sd_stream_read_end(spi);
+    return status;
+  }
+  s_streams[spi].block += NumberOfBlocks;
+  return STATUS_CODE_OK;
 }
 
-StatusCode sd_read_blocks(SpiPort spi, uint8_t *dest, uint32_t ReadAddr, uint32_t NumberOfBlocks) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+StatusCode sd_stream_read_end(SpiPort spi) {
+  if (s_streams[spi].stream != SD_STREAM_READ) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD read stream\n");
+  }
+  s_streams[spi].stream = SD_STREAM_NONE;
+  return STATUS_CODE_OK;
 }
 
-StatusCode sd_write_blocks(SpiPort spi, uint8_t *src, uint32_t WriteAddr, uint32_t NumberOfBlocks) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+StatusCode sd_stream_write_begin(SpiPort spi, uint32_t WriteBlock) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  status_ok_or_return(prv_check_range(WriteBlock, 0));
+
+  prv_command();
+  s_streams[spi] = (SdStreamState){ .stream = SD_STREAM_WRITE, .block = WriteBlock };
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_stream_write(SpiPort spi, uint8_t *src, uint32_t NumberOfBlocks) {
+  if (s_streams[spi].stream != SD_STREAM_WRITE) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD write stream\n");
+  }
+
+  StatusCode status = prv_write(src, s_streams[spi].block, NumberOfBlocks);
+  if (!status_ok(status)) {
+    sd_stream_write_end(spi);
+    return status;
+  }
+  s_streams[spi].block += NumberOfBlocks;
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_stream_write_end(SpiPort spi) {
+  if (s_streams[spi].stream != SD_STREAM_WRITE) {
+    return status_msg(STATUS_CODE_UNINITIALIZED, "No SD write stream\n");
+  }
+  s_streams[spi].stream = SD_STREAM_NONE;
+  return STATUS_CODE_OK;
+}
+
+StatusCode sd_get_num_blocks(SpiPort spi, uint32_t *num_blocks) {
+  status_ok_or_return(prv_check_not_streaming(spi));
+  status_ok_or_return(prv_check_range(0, 0));
+  *num_blocks = s_num_blocks;
+  return STATUS_CODE_OK;
 }
 
 StatusCode sd_is_initialized(SpiPort spi) {
-  return status_code(STATUS_CODE_UNIMPLEMENTED);
+  status_ok_or_return(prv_check_not_streaming(spi));
+  if (s_image_fd < 0) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+  return STATUS_CODE_OK;
+}
+
+void x86_sd_get_stats(X86SdStats *stats) {
+  *stats = s_stats;
+}
+
+void x86_sd_set_latency(uint32_t command_us, uint32_t block_us) {
+  s_command_latency_us = command_us;
+  s_block_latency_us = block_us;
 }
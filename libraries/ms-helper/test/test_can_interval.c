@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "delay.h"
 #include "event_queue.h"
@@ -21,8 +22,66 @@
 #define TEST_CAN_INTERVAL_SEND_DELAY_US 100000
 #define TEST_CAN_INTERVAL_PERIOD_US 1000000
 
+// Messages sharing a period, recorded into a per-millisecond histogram folded over the period
+#define TEST_CAN_INTERVAL_SHARED_PERIOD_MS 20
+#define TEST_CAN_INTERVAL_RECORD_PERIODS 10
+
 static GenericCanHw s_can;
 
+static volatile bool s_recording;
+static uint32_t s_record_start_us;
+static volatile uint32_t s_histogram[TEST_CAN_INTERVAL_SHARED_PERIOD_MS];
+
+static const GenericCanMsg s_shared_msg = {
+  .id = 0x10,
+  .dlc = 1,
+};
+
+// Counts sends rather than transmitting them
+static StatusCode prv_record_tx(const GenericCan *can, const GenericCanMsg *msg) {
+  (void)can;
+  (void)msg;
+  if (s_recording) {
+    uint32_t elapsed_ms = (soft_timer_now_us() - s_record_start_us) / 1000;
+    s_histogram[elapsed_ms % TEST_CAN_INTERVAL_SHARED_PERIOD_MS]++;
+  }
+  return STATUS_CODE_OK;
+}
+
+static GenericCanInterface s_record_interface = { .tx = prv_record_tx };
+static GenericCan s_record_can = { .interface = &s_record_interface };
+
+// How can_interval used to send: a timer per message, so messages started together stay together
+static void prv_timer_per_msg_cb(SoftTimerId timer_id, void *context) {
+  SoftTimerId *id = context;
+  generic_can_tx(&s_record_can, &s_shared_msg);
+  soft_timer_start_millis(TEST_CAN_INTERVAL_SHARED_PERIOD_MS, prv_timer_per_msg_cb, id, id);
+}
+
+static void prv_noop_cb(SoftTimerId timer_id, void *context) {}
+
+// Records the sends over a few periods and returns the most in any one millisecond
+static uint32_t prv_record_histogram(const char *name) {
+  for (size_t i = 0; i < TEST_CAN_INTERVAL_SHARED_PERIOD_MS; i++) {
+    s_histogram[i] = 0;
+  }
+  s_record_start_us = soft_timer_now_us();
+  s_recording = true;
+  delay_ms(TEST_CAN_INTERVAL_SHARED_PERIOD_MS * TEST_CAN_INTERVAL_RECORD_PERIODS);
+  s_recording = false;
+
+  char line[4 * TEST_CAN_INTERVAL_SHARED_PERIOD_MS + 1] = { 0 };
+  uint32_t peak = 0;
+  for (size_t i = 0; i < TEST_CAN_INTERVAL_SHARED_PERIOD_MS; i++) {
+    snprintf(&line[4 * i], sizeof(line) - 4 * i, "%4lu", (unsigned long)s_histogram[i]);
+    if (s_histogram[i] > peak) {
+      peak = s_histogram[i];
+    }
+  }
+  LOG_DEBUG("%s, sends per ms: %s\n", name, line);
+  return peak;
+}
+
 // GenericCanRxCb
 static void prv_can_rx_callback(const GenericCanMsg *msg, void *context) {
   (void)msg;
@@ -90,3 +149,41 @@ void test_can_interval(void) {
   // Queue empty
   TEST_ASSERT_EQUAL(3, counter);
 }
+
+void test_can_interval_staggered(void) {
+  SoftTimerId timer_per_msg[CAN_INTERVAL_POOL_SIZE];
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE; i++) {
+    TEST_ASSERT_OK(soft_timer_start_millis(TEST_CAN_INTERVAL_SHARED_PERIOD_MS, prv_timer_per_msg_cb,
+                                           &timer_per_msg[i], &timer_per_msg[i]));
+  }
+  uint32_t timer_per_msg_peak = prv_record_histogram("Timer per message");
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE; i++) {
+    soft_timer_cancel(timer_per_msg[i]);
+  }
+
+  CanInterval *intervals[CAN_INTERVAL_POOL_SIZE] = { 0 };
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE; i++) {
+    TEST_ASSERT_OK(can_interval_factory(&s_record_can, &s_shared_msg,
+                                        TEST_CAN_INTERVAL_SHARED_PERIOD_MS * 1000, &intervals[i]));
+    TEST_ASSERT_OK(can_interval_enable(intervals[i]));
+  }
+
+  // The intervals only hold one timer between them
+  SoftTimerId others[SOFT_TIMER_MAX_TIMERS - 1];
+  for (size_t i = 0; i < SIZEOF_ARRAY(others); i++) {
+    TEST_ASSERT_OK(soft_timer_start_seconds(1, prv_noop_cb, NULL, &others[i]));
+  }
+  for (size_t i = 0; i < SIZEOF_ARRAY(others); i++) {
+    soft_timer_cancel(others[i]);
+  }
+
+  uint32_t staggered_peak = prv_record_histogram("Staggered");
+  for (size_t i = 0; i < CAN_INTERVAL_POOL_SIZE; i++) {
+    TEST_ASSERT_OK(can_interval_disable(intervals[i]));
+  }
+
+  // Each message gets its own slot in the period, rather than all landing in the same one or two
+  TEST_ASSERT_TRUE(staggered_peak <= TEST_CAN_INTERVAL_RECORD_PERIODS + 1);
+  TEST_ASSERT_TRUE(timer_per_msg_peak >=
+                   CAN_INTERVAL_POOL_SIZE * TEST_CAN_INTERVAL_RECORD_PERIODS / 2);
+}
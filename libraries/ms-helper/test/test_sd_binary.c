@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event_queue.h"
+#include "interrupt.h"
+#include "log.h"
+#include "sd_binary.h"
+#include "sd_cache.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+#include "x86_sd_binary.h"
+
+#define TEST_SPI_PORT SPI_PORT_2
+#define TEST_IMAGE_FILE "test_sd_binary.img"
+#define TEST_ASYNC_EVENT 0
+
+#define TEST_NUM_BLOCKS 8
+#define TEST_BLOCK 16
+
+// Roughly a card on a fast SPI bus: addressing it and waiting for it to get ready costs much more
+// than moving a block
+#define TEST_COMMAND_LATENCY_US 500
+#define TEST_BLOCK_LATENCY_US 100
+
+#define TEST_BENCHMARK_BLOCKS 64
+#define TEST_BENCHMARK_UPDATES 64
+// Blocks holding the "FAT", all of which fit in the cache
+#define TEST_METADATA_BLOCKS SD_CACHE_NUM_BLOCKS
+
+static uint8_t s_write_data[TEST_BENCHMARK_BLOCKS * SD_BLOCK_SIZE];
+static uint8_t s_read_data[TEST_BENCHMARK_BLOCKS * SD_BLOCK_SIZE];
+
+static StatusCode s_async_status;
+static uint32_t s_async_callbacks;
+
+static void prv_async_callback(SpiPort spi, StatusCode status, void *context) {
+  s_async_status = status;
+  s_async_callbacks++;
+}
+
+// Returns the number of events processed
+static uint32_t prv_process_events(void) {
+  uint32_t processed = 0;
+  Event e = { 0 };
+  while (status_ok(event_process(&e))) {
+    if (sd_process_event(&e)) {
+      processed++;
+    }
+  }
+  return processed;
+}
+
+static uint32_t prv_elapsed_us(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000);
+}
+
+void setup_test(void) {
+  interrupt_init();
+  soft_timer_init();
+  event_queue_init();
+
+  unlink(TEST_IMAGE_FILE);
+  setenv(X86_SD_IMAGE_VAR, TEST_IMAGE_FILE, 1);
+  x86_sd_set_latency(0, 0);
+  sd_cache_clear(TEST_SPI_PORT);
+  TEST_ASSERT_OK(sd_card_init(TEST_SPI_PORT));
+
+  for (size_t i = 0; i < sizeof(s_write_data); i++) {
+    s_write_data[i] = (uint8_t)(i * 7 + i / SD_BLOCK_SIZE);
+  }
+  memset(s_read_data, 0, sizeof(s_read_data));
+  s_async_callbacks = 0;
+}
+
+void teardown_test(void) {
+  unlink(TEST_IMAGE_FILE);
+}
+
+void test_sd_binary_read_write(void) {
+  uint32_t num_blocks = 0;
+  TEST_ASSERT_OK(sd_get_num_blocks(TEST_SPI_PORT, &num_blocks));
+  TEST_ASSERT_EQUAL(X86_SD_DEFAULT_NUM_BLOCKS, num_blocks);
+
+  TEST_ASSERT_OK(sd_write_blocks(TEST_SPI_PORT, s_write_data, TEST_BLOCK, TEST_NUM_BLOCKS));
+  TEST_ASSERT_OK(sd_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK, TEST_NUM_BLOCKS));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s_write_data, s_read_data, TEST_NUM_BLOCKS * SD_BLOCK_SIZE);
+
+  // Single blocks from the middle
+  TEST_ASSERT_OK(sd_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK + 3, 1));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s_write_data + 3 * SD_BLOCK_SIZE, s_read_data, SD_BLOCK_SIZE);
+
+  TEST_ASSERT_NOT_OK(sd_read_blocks(TEST_SPI_PORT, s_read_data, num_blocks, 1));
+}
+
+// A stream addresses the card once and moves blocks across several calls.
+void test_sd_binary_stream(void) {
+  X86SdStats stats = { 0 };
+  TEST_ASSERT_OK(sd_stream_write_begin(TEST_SPI_PORT, TEST_BLOCK));
+  TEST_ASSERT_OK(sd_stream_write(TEST_SPI_PORT, s_write_data, 3));
+  // Nothing else can use the card in the meantime
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED,
+                    sd_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK, 1));
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED,
+                    sd_stream_read_begin(TEST_SPI_PORT, TEST_BLOCK));
+  TEST_ASSERT_OK(sd_stream_write(TEST_SPI_PORT, s_write_data + 3 * SD_BLOCK_SIZE,
+                                 TEST_NUM_BLOCKS - 3));
+  TEST_ASSERT_OK(sd_stream_write_end(TEST_SPI_PORT));
+  TEST_ASSERT_NOT_OK(sd_stream_write(TEST_SPI_PORT, s_write_data, 1));
+
+  TEST_ASSERT_OK(sd_stream_read_begin(TEST_SPI_PORT, TEST_BLOCK));
+  for (size_t i = 0; i < TEST_NUM_BLOCKS; i++) {
+    TEST_ASSERT_OK(sd_stream_read(TEST_SPI_PORT, s_read_data + i * SD_BLOCK_SIZE, 1));
+  }
+  TEST_ASSERT_OK(sd_stream_read_end(TEST_SPI_PORT));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s_write_data, s_read_data, TEST_NUM_BLOCKS * SD_BLOCK_SIZE);
+
+  x86_sd_get_stats(&stats);
+  TEST_ASSERT_EQUAL(2, stats.commands);
+}
+
+// Asynchronous transfers move one block per event and report the result once.
+void test_sd_binary_async(void) {
+  TEST_ASSERT_OK(sd_write_blocks_async(TEST_SPI_PORT, s_write_data, TEST_BLOCK, TEST_NUM_BLOCKS,
+                                       TEST_ASYNC_EVENT, prv_async_callback, NULL));
+  TEST_ASSERT_TRUE(sd_async_busy(TEST_SPI_PORT));
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED,
+                    sd_read_blocks_async(TEST_SPI_PORT, s_read_data, TEST_BLOCK, 1,
+                                         TEST_ASYNC_EVENT, prv_async_callback, NULL));
+
+  TEST_ASSERT_EQUAL(TEST_NUM_BLOCKS, prv_process_events());
+  TEST_ASSERT_EQUAL(1, s_async_callbacks);
+  TEST_ASSERT_OK(s_async_status);
+  TEST_ASSERT_FALSE(sd_async_busy(TEST_SPI_PORT));
+
+  TEST_ASSERT_OK(sd_read_blocks_async(TEST_SPI_PORT, s_read_data, TEST_BLOCK, TEST_NUM_BLOCKS,
+                                      TEST_ASYNC_EVENT, prv_async_callback, NULL));
+  TEST_ASSERT_EQUAL(TEST_NUM_BLOCKS, prv_process_events());
+  TEST_ASSERT_EQUAL(2, s_async_callbacks);
+  TEST_ASSERT_OK(s_async_status);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s_write_data, s_read_data, TEST_NUM_BLOCKS * SD_BLOCK_SIZE);
+}
+
+// Transfer errors are reported through the callback.
+void test_sd_binary_async_error(void) {
+  uint32_t num_blocks = 0;
+  TEST_ASSERT_OK(sd_get_num_blocks(TEST_SPI_PORT, &num_blocks));
+  TEST_ASSERT_OK(sd_write_blocks_async(TEST_SPI_PORT, s_write_data,
+                                       num_blocks - 1, 2, TEST_ASYNC_EVENT,
+                                       prv_async_callback, NULL));
+  prv_process_events();
+  TEST_ASSERT_EQUAL(1, s_async_callbacks);
+  TEST_ASSERT_EQUAL(STATUS_CODE_OUT_OF_RANGE, s_async_status);
+  // The card is usable again
+  TEST_ASSERT_OK(sd_write_blocks(TEST_SPI_PORT, s_write_data, TEST_BLOCK, 1));
+}
+
+void test_sd_cache(void) {
+  SdCacheStats before = { 0 };
+  SdCacheStats after = { 0 };
+  sd_cache_get_stats(&before);
+
+  TEST_ASSERT_OK(sd_write_blocks(TEST_SPI_PORT, s_write_data, TEST_BLOCK, TEST_NUM_BLOCKS));
+  TEST_ASSERT_OK(sd_cache_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK, 1));
+  TEST_ASSERT_OK(sd_cache_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK, 1));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s_write_data, s_read_data, SD_BLOCK_SIZE);
+  sd_cache_get_stats(&after);
+  TEST_ASSERT_EQUAL(1, after.misses - before.misses);
+  TEST_ASSERT_EQUAL(1, after.hits - before.hits);
+
+  // Single block writes update the cache
+  TEST_ASSERT_OK(
+      sd_cache_write_blocks(TEST_SPI_PORT, s_write_data + SD_BLOCK_SIZE, TEST_BLOCK, 1));
+  TEST_ASSERT_OK(sd_cache_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK, 1));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s_write_data + SD_BLOCK_SIZE, s_read_data, SD_BLOCK_SIZE);
+
+  // Multi-block writes invalidate what they overlap
+  TEST_ASSERT_OK(sd_cache_write_blocks(TEST_SPI_PORT, s_write_data + 2 * SD_BLOCK_SIZE,
+                                       TEST_BLOCK - 1, 2));
+  sd_cache_get_stats(&before);
+  TEST_ASSERT_OK(sd_cache_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK, 1));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(s_write_data + 3 * SD_BLOCK_SIZE, s_read_data, SD_BLOCK_SIZE);
+  sd_cache_get_stats(&after);
+  TEST_ASSERT_EQUAL(1, after.misses - before.misses);
+
+  // The least recently used block is evicted
+  for (uint32_t i = 1; i <= SD_CACHE_NUM_BLOCKS; i++) {
+    TEST_ASSERT_OK(
+        sd_cache_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK + i, 1));
+  }
+  sd_cache_get_stats(&before);
+  TEST_ASSERT_OK(sd_cache_read_blocks(TEST_SPI_PORT, s_read_data, TEST_BLOCK, 1));
+  sd_cache_get_stats(&after);
+  TEST_ASSERT_EQUAL(1, after.misses - before.misses);
+}
+
+// Compares appending blocks one command at a time with streaming them, and read-modify-write
+// updates of a few metadata blocks with and without the cache.
+void test_sd_binary_benchmark(void) {
+  x86_sd_set_latency(TEST_COMMAND_LATENCY_US, TEST_BLOCK_LATENCY_US);
+  struct timespec start;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < TEST_BENCHMARK_BLOCKS; i++) {
+    TEST_ASSERT_OK(sd_write_blocks(TEST_SPI_PORT, s_write_data + i * SD_BLOCK_SIZE,
+                                   TEST_BLOCK + i, 1));
+  }
+  uint32_t single_us = prv_elapsed_us(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  TEST_ASSERT_OK(sd_stream_write_begin(TEST_SPI_PORT, TEST_BLOCK));
+  for (uint32_t i = 0; i < TEST_BENCHMARK_BLOCKS; i++) {
+    TEST_ASSERT_OK(sd_stream_write(TEST_SPI_PORT, s_write_data + i * SD_BLOCK_SIZE, 1));
+  }
+  TEST_ASSERT_OK(sd_stream_write_end(TEST_SPI_PORT));
+  uint32_t stream_us = prv_elapsed_us(&start);
+
+  LOG_DEBUG("Sequential append of %u blocks: %lu us one at a time, %lu us streamed\n",
+            TEST_BENCHMARK_BLOCKS, (unsigned long)single_us, (unsigned long)stream_us);
+  TEST_ASSERT_TRUE(stream_us < single_us);
+
+  uint8_t block[SD_BLOCK_SIZE];
+  srand(0);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < TEST_BENCHMARK_UPDATES; i++) {
+    uint32_t addr = TEST_BLOCK + (uint32_t)(rand() % TEST_METADATA_BLOCKS);
+    TEST_ASSERT_OK(sd_read_blocks(TEST_SPI_PORT, block, addr, 1));
+    block[i % SD_BLOCK_SIZE]++;
+    TEST_ASSERT_OK(sd_write_blocks(TEST_SPI_PORT, block, addr, 1));
+  }
+  uint32_t uncached_us = prv_elapsed_us(&start);
+
+  SdCacheStats before = { 0 };
+  SdCacheStats after = { 0 };
+  sd_cache_get_stats(&before);
+  srand(0);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < TEST_BENCHMARK_UPDATES; i++) {
+    uint32_t addr = TEST_BLOCK + (uint32_t)(rand() % TEST_METADATA_BLOCKS);
+    TEST_ASSERT_OK(sd_cache_read_blocks(TEST_SPI_PORT, block, addr, 1));
+    block[i % SD_BLOCK_SIZE]++;
+    TEST_ASSERT_OK(sd_cache_write_blocks(TEST_SPI_PORT, block, addr, 1));
+  }
+  uint32_t cached_us = prv_elapsed_us(&start);
+  sd_cache_get_stats(&after);
+
+  LOG_DEBUG("%u random metadata updates: %lu us uncached, %lu us cached (%lu hits, %lu misses)\n",
+            TEST_BENCHMARK_UPDATES, (unsigned long)uncached_us, (unsigned long)cached_us,
+            (unsigned long)(after.hits - before.hits),
+            (unsigned long)(after.misses - before.misses));
+  TEST_ASSERT_TRUE(cached_us < uncached_us);
+}
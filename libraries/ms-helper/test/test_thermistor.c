@@ -1,13 +1,20 @@
 #include <inttypes.h>
 #include "adc.h"
 #include "gpio.h"
+#include "interrupt.h"
 #include "log.h"
+#include "soft_timer.h"
 #include "test_helpers.h"
 #include "thermistor.h"
 #include "unity.h"
 
 #define THERMISTOR_TEMPERATURE_TOLERANCE_DECICELSIUS 5
 
+#define TEST_VDDA_MV 3000
+#define TEST_NUM_READINGS 60
+#define TEST_BENCHMARK_RUNS 200
+#define TEST_LOOKUP_SIZE 101
+
 // The tests cases return different voltage values depending on the inputted adc
 // channel inputs Each value is used for a different test case Channel 0~3 used
 // for thermistor = R1. Channel 4~6 used for thermistor = R2. Channel 7 & REF
@@ -57,7 +64,41 @@ StatusCode TEST_MOCK(adc_set_channel)(AdcChannel adc_channel, bool new_state) {
   return STATUS_CODE_OK;
 }
 
-void setup_test(void) {}
+// Resistance in milliohms at each degree, for the reference conversion
+static uint32_t s_reference_lookup[TEST_LOOKUP_SIZE];
+
+// The resistance-based linear scan thermistor_get_temp used before, kept as a reference
+static bool prv_reference_get_temp(ThermistorPosition position, uint16_t vdda, uint16_t reading,
+                                   uint16_t *temperature_dc) {
+  uint32_t resistance_ohms = 0;
+  if (position == THERMISTOR_POSITION_R1) {
+    resistance_ohms =
+        ((uint32_t)(vdda - reading)) * (uint32_t)THERMISTOR_FIXED_RESISTANCE_OHMS / reading;
+  } else {
+    resistance_ohms =
+        ((uint32_t)THERMISTOR_FIXED_RESISTANCE_OHMS * reading) / (uint32_t)(vdda - reading);
+  }
+  for (uint16_t i = 0; i < TEST_LOOKUP_SIZE - 1; i++) {
+    if (resistance_ohms * 1000 <= s_reference_lookup[i] &&
+        resistance_ohms * 1000 >= s_reference_lookup[i + 1]) {
+      *temperature_dc = (uint16_t)(
+          ((uint32_t)i * 1000 + ((s_reference_lookup[i] - resistance_ohms * 1000) * 1000 /
+                                 (s_reference_lookup[i] - s_reference_lookup[i + 1]))) /
+          100);
+      return true;
+    }
+  }
+  *temperature_dc = UINT16_MAX;
+  return false;
+}
+
+void setup_test(void) {
+  for (uint16_t i = 0; i < TEST_LOOKUP_SIZE; i++) {
+    uint16_t resistance_ohms = 0;
+    thermistor_calculate_resistance(i * 10, &resistance_ohms);
+    s_reference_lookup[i] = (uint32_t)resistance_ohms * 1000;
+  }
+}
 
 void teardown_test(void) {}
 
@@ -263,3 +304,95 @@ void test_resistance_lookup(void) {
   thermistor_calculate_resistance(755, &resistance);
   TEST_ASSERT_UINT16_WITHIN(1, 1897, resistance);
 }
+
+// Tests converting several thermistors at once
+void test_thermistor_get_temps(void) {
+  ThermistorStorage storages[3];
+  GpioAddress gpio_addr = { .port = GPIO_PORT_A, .pin = 1 };
+  TEST_ASSERT_OK(thermistor_init(&storages[0], gpio_addr, THERMISTOR_POSITION_R2));
+  gpio_addr.pin = 4;
+  TEST_ASSERT_OK(thermistor_init(&storages[1], gpio_addr, THERMISTOR_POSITION_R1));
+  gpio_addr.pin = 6;
+  TEST_ASSERT_OK(thermistor_init(&storages[2], gpio_addr, THERMISTOR_POSITION_R1));
+
+  uint16_t temperatures[3] = { 0 };
+  TEST_ASSERT_OK(thermistor_get_temps(storages, SIZEOF_ARRAY(storages), temperatures));
+  TEST_ASSERT_UINT16_WITHIN(THERMISTOR_TEMPERATURE_TOLERANCE_DECICELSIUS, 100, temperatures[0]);
+  TEST_ASSERT_UINT16_WITHIN(THERMISTOR_TEMPERATURE_TOLERANCE_DECICELSIUS, 100, temperatures[1]);
+  TEST_ASSERT_UINT16_WITHIN(THERMISTOR_TEMPERATURE_TOLERANCE_DECICELSIUS, 1000, temperatures[2]);
+
+  // One out of range doesn't stop the rest from being converted
+  gpio_addr.pin = 0;
+  TEST_ASSERT_OK(thermistor_init(&storages[1], gpio_addr, THERMISTOR_POSITION_R2));
+  TEST_ASSERT_NOT_OK(thermistor_get_temps(storages, SIZEOF_ARRAY(storages), temperatures));
+  TEST_ASSERT_UINT16_WITHIN(THERMISTOR_TEMPERATURE_TOLERANCE_DECICELSIUS, 100, temperatures[0]);
+  TEST_ASSERT_EQUAL(UINT16_MAX, temperatures[1]);
+  TEST_ASSERT_UINT16_WITHIN(THERMISTOR_TEMPERATURE_TOLERANCE_DECICELSIUS, 1000, temperatures[2]);
+
+  TEST_ASSERT_NOT_OK(thermistor_get_temps(NULL, 1, temperatures));
+  TEST_ASSERT_NOT_OK(thermistor_get_temps(storages, 1, NULL));
+}
+
+// Tests the ratio table against the resistance-based conversion over every reading
+void test_thermistor_convert_readings(void) {
+  for (ThermistorPosition position = 0; position < NUM_THERMISTOR_POSITIONS; position++) {
+    size_t num_in_range = 0;
+    for (uint16_t reading = 1; reading < TEST_VDDA_MV; reading++) {
+      uint16_t expected = 0;
+      uint16_t temperature = 0;
+      bool in_range = prv_reference_get_temp(position, TEST_VDDA_MV, reading, &expected);
+      StatusCode status =
+          thermistor_convert_readings(position, TEST_VDDA_MV, &reading, &temperature, 1);
+      if (in_range && status == STATUS_CODE_OK) {
+        TEST_ASSERT_UINT16_WITHIN(THERMISTOR_TEMPERATURE_TOLERANCE_DECICELSIUS, expected,
+                                  temperature);
+        num_in_range++;
+      } else if (status != STATUS_CODE_OK) {
+        TEST_ASSERT_EQUAL(UINT16_MAX, temperature);
+      }
+    }
+    // 0 to 100 degrees spans most of the divider's range
+    TEST_ASSERT_TRUE(num_in_range > TEST_VDDA_MV / 2);
+  }
+
+  uint16_t reading = 1000;
+  uint16_t temperature = 0;
+  TEST_ASSERT_NOT_OK(thermistor_convert_readings(THERMISTOR_POSITION_R1, 0, &reading,
+                                                 &temperature, 1));
+  TEST_ASSERT_NOT_OK(thermistor_convert_readings(NUM_THERMISTOR_POSITIONS, TEST_VDDA_MV, &reading,
+                                                 &temperature, 1));
+  TEST_ASSERT_NOT_OK(
+      thermistor_convert_readings(THERMISTOR_POSITION_R1, TEST_VDDA_MV, NULL, &temperature, 1));
+}
+
+// Times converting a BMS-sized sweep of readings against the reference. Timing on the host is only
+// indicative, so this just logs the results.
+void test_thermistor_benchmark(void) {
+  interrupt_init();
+  soft_timer_init();
+
+  uint16_t readings[TEST_NUM_READINGS];
+  uint16_t temperatures[TEST_NUM_READINGS];
+  for (size_t i = 0; i < TEST_NUM_READINGS; i++) {
+    // Spread over 0 to 100 degrees
+    readings[i] = (uint16_t)(900 + i * 30);
+  }
+
+  uint32_t start_us = soft_timer_now_us();
+  for (size_t run = 0; run < TEST_BENCHMARK_RUNS; run++) {
+    for (size_t i = 0; i < TEST_NUM_READINGS; i++) {
+      prv_reference_get_temp(THERMISTOR_POSITION_R1, TEST_VDDA_MV, readings[i], &temperatures[i]);
+    }
+  }
+  uint32_t reference_us = soft_timer_now_us() - start_us;
+
+  start_us = soft_timer_now_us();
+  for (size_t run = 0; run < TEST_BENCHMARK_RUNS; run++) {
+    TEST_ASSERT_OK(thermistor_convert_readings(THERMISTOR_POSITION_R1, TEST_VDDA_MV, readings,
+                                               temperatures, TEST_NUM_READINGS));
+  }
+  uint32_t table_us = soft_timer_now_us() - start_us;
+
+  LOG_DEBUG("%d readings x %d runs: linear scan %lu us, binary search %lu us\n", TEST_NUM_READINGS,
+            TEST_BENCHMARK_RUNS, (unsigned long)reference_us, (unsigned long)table_us);
+}
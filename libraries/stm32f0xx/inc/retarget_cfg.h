@@ -8,3 +8,9 @@
 #define RETARGET_CFG_UART_GPIO_RX 7
 #define RETARGET_CFG_UART_GPIO_ALTFN GPIO_AF_0
 #define RETARGET_CFG_UART_GPIO_ENABLE_CLK() RCC_AHBPeriphClockCmd(RCC_AHBPeriph_GPIOB, ENABLE)
+
+// Used to drain deferred log records - see log.h. The lowest priority, so logging never holds up
+// anything else.
+#define RETARGET_CFG_UART_IRQ USART1_IRQn
+#define RETARGET_CFG_UART_IRQ_HANDLER USART1_IRQHandler
+#define RETARGET_CFG_UART_IRQ_PRIORITY 3
@@ -1,6 +1,7 @@
 // Retargets STDOUT to UART
 #include "retarget.h"
 #include <stdio.h>
+#include "log.h"
 #include "retarget_cfg.h"
 #include "stm32f0xx.h"
 
@@ -23,6 +24,25 @@ static void prv_init_gpio(void) {
   GPIO_Init(RETARGET_CFG_UART_GPIO_PORT, &gpio_init);
 }
 
+#ifdef LOG_DEFERRED
+// The interrupt only stays enabled while there's something to send, otherwise it keeps firing
+static void prv_start_tx(void) {
+  USART_ITConfig(RETARGET_CFG_UART, USART_IT_TXE, ENABLE);
+}
+
+void RETARGET_CFG_UART_IRQ_HANDLER(void) {
+  if (USART_GetITStatus(RETARGET_CFG_UART, USART_IT_TXE) == SET) {
+    uint8_t data = 0;
+    if (log_deferred_read(&data, 1) == 1) {
+      USART_SendData(RETARGET_CFG_UART, data);
+    } else {
+      USART_ITConfig(RETARGET_CFG_UART, USART_IT_TXE, DISABLE);
+    }
+  }
+  USART_ClearITPendingBit(RETARGET_CFG_UART, USART_IT_ORE);
+}
+#endif
+
 void retarget_init(void) {
   RETARGET_CFG_UART_ENABLE_CLK();
   prv_init_gpio();
@@ -33,6 +53,13 @@ void retarget_init(void) {
   USART_Init(RETARGET_CFG_UART, &usart_init);
 
   USART_Cmd(RETARGET_CFG_UART, ENABLE);
+
+#ifdef LOG_DEFERRED
+  // Deferred log records are clocked out a byte at a time by the TXE interrupt
+  NVIC_SetPriority(RETARGET_CFG_UART_IRQ, RETARGET_CFG_UART_IRQ_PRIORITY);
+  NVIC_EnableIRQ(RETARGET_CFG_UART_IRQ);
+  log_deferred_set_ready_callback(prv_start_tx);
+#endif
 }
 
 int _write(int fd, char *ptr, int len) {
@@ -1,5 +1,16 @@
 #pragma once
+// Emulates interrupts on x86.
+//
+// By default, interrupts are realtime signals delivered to the process, so handlers preempt the
+// thread that receives them. Building with DEFINE=X86_INTERRUPT_QUEUE instead posts interrupts to
+// lock-free queues drained by a single CPU thread, the one that called x86_interrupt_init(). Every
+// handler runs on that thread, so like on the MCU, the main thread and any handler it preempted
+// are suspended until it returns. A handler starts right away if it has a higher priority than
+// whatever the CPU thread is running and interrupts are unmasked. Triggers from other threads
+// signal the CPU thread to check its queues, and masking from another thread waits for the
+// running handler to finish. The RTOS port needs the signal backend.
 
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <sys/types.h>
@@ -7,6 +18,11 @@
 #include "interrupt_def.h"
 #include "status.h"
 
+// Signal reserved for RTOS context switches, the x86 equivalent of PendSV. It behaves as the
+// lowest priority interrupt: it is held off while any interrupt handler runs and while interrupts
+// are masked by a critical section.
+#define X86_INTERRUPT_RTOS_SIGNAL (SIGRTMIN + NUM_INTERRUPT_PRIORITIES + 1)
+
 typedef void (*x86InterruptHandler)(uint8_t interrupt_id);
 
 // Initializes the interrupt internals. If called multiple times the subsequent
@@ -29,10 +45,23 @@ StatusCode x86_interrupt_trigger(uint8_t interrupt_id);
 // Wakes wait()
 void x86_interrupt_wake(void);
 
-// Configures the block mask on the signal handler for critical sections.
+// Blocks until an interrupt is handled or x86_interrupt_wake() is called.
+void x86_interrupt_wait(void);
+
+// Fills |event| so that a POSIX timer triggers |interrupt_id| when it expires.
+void x86_interrupt_init_sigevent(uint8_t interrupt_id, struct sigevent *event);
+
+// Masks interrupts for critical sections. Calls nest, and interrupts triggered while masked run
+// once the last unmask happens. With signals, masking never makes a system call: it only sets a
+// flag that the signal handler checks before running an interrupt.
 void x86_interrupt_mask(void);
 void x86_interrupt_unmask(void);
 
+// For handlers of X86_INTERRUPT_RTOS_SIGNAL. Returns true if interrupts are masked, in which case
+// the handler should return right away: the signal is raised on the calling thread again once
+// interrupts are unmasked. Signal backend only.
+bool x86_interrupt_defer_rtos_signal(void);
+
 // Inits the correct signal mask on a pthread.
 void x86_interrupt_pthread_init(void);
 
@@ -0,0 +1,14 @@
+#pragma once
+// Hooks into the in-process vehicle simulator (projects/vehicle_sim).
+//
+// The simulator links several boards into one process and runs them in virtual time, which only
+// advances once every board is idle. When the queue interrupt backend is built with
+// -DX86_SIM, it reports through these hooks whenever a board starts or stops doing work: each
+// pending interrupt and each main thread outside of wait() counts as busy. The simulator provides
+// the implementations.
+
+// Something on a board became runnable
+void x86_sim_busy(void);
+
+// Something on a board finished running. Balances a previous x86_sim_busy().
+void x86_sim_idle(void);
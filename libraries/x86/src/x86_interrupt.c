@@ -1,5 +1,8 @@
 #include "x86_interrupt.h"
 
+// Signal backend - see x86_interrupt_queue.c for the alternative
+#ifndef X86_INTERRUPT_QUEUE
+
 #include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -15,20 +18,27 @@
 #define NUM_X86_INTERRUPT_HANDLERS 64
 #define NUM_X86_INTERRUPT_INTERRUPTS 128
 
-typedef enum {
-  X86_INTERRUPT_STATE_NONE = 0,
-  X86_INTERRUPT_STATE_MASK,
-  X86_INTERRUPT_STATE_UNMASK,
-} X86InterruptState;
-
 typedef struct Interrupt {
   InterruptPriority priority;
   uint8_t handler_id;
   bool is_event;
 } Interrupt;
 
-static bool s_in_handler_flag = false;
-static X86InterruptState s_interrupt_state_update = X86_INTERRUPT_STATE_NONE;
+// Interrupts are masked lazily so critical sections never make a system call. Masking only bumps
+// |s_mask_depth|. A signal that arrives while it is set records its interrupt in |s_deferred| and
+// returns, and the last unmask queues the deferred interrupts again. Both sides check the other's
+// flag after setting their own, so a deferred interrupt is always replayed by one of them.
+static uint32_t s_mask_depth = 0;
+static bool s_deferred_any = false;
+// Deferred count per interrupt ID, plus one for wakes
+static uint32_t s_deferred[NUM_X86_INTERRUPT_INTERRUPTS + 1];
+// Thread to raise X86_INTERRUPT_RTOS_SIGNAL on once unmasked
+static bool s_rtos_deferred = false;
+static pthread_t s_rtos_deferred_thread;
+
+// Per thread, since other threads check it too: one that saw the main thread's flag could skip
+// half of a critical section
+static __thread bool s_in_handler_flag = false;
 
 static pid_t s_pid = 0;
 
@@ -38,6 +48,57 @@ static uint8_t s_x86_interrupt_next_handler_id = 0;
 static Interrupt s_x86_interrupt_interrupts_map[NUM_X86_INTERRUPT_INTERRUPTS];
 static x86InterruptHandler s_x86_interrupt_handlers[NUM_X86_INTERRUPT_HANDLERS];
 
+static bool prv_masked(void) {
+  return __atomic_load_n(&s_mask_depth, __ATOMIC_SEQ_CST) > 0;
+}
+
+static void prv_queue_signal(uint32_t sival, InterruptPriority priority) {
+  union sigval value = { .sival_int = (int)sival };
+  sigqueue(s_pid, SIGRTMIN + (int)priority, value);
+}
+
+// Queues every deferred interrupt again, highest priority first. Async-signal-safe.
+static void prv_replay_deferred(void) {
+  if (__atomic_exchange_n(&s_rtos_deferred, false, __ATOMIC_SEQ_CST)) {
+    pthread_kill(s_rtos_deferred_thread, X86_INTERRUPT_RTOS_SIGNAL);
+  }
+  if (!__atomic_exchange_n(&s_deferred_any, false, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+
+  for (uint32_t count = __atomic_exchange_n(&s_deferred[NUM_X86_INTERRUPT_INTERRUPTS], 0,
+                                            __ATOMIC_SEQ_CST);
+       count > 0; count--) {
+    prv_queue_signal(NUM_X86_INTERRUPT_INTERRUPTS, INTERRUPT_PRIORITY_HIGH);
+  }
+  for (size_t priority = 0; priority < NUM_INTERRUPT_PRIORITIES; priority++) {
+    for (uint8_t id = 0; id < s_x86_interrupt_next_interrupt_id; id++) {
+      if (s_x86_interrupt_interrupts_map[id].priority != priority) {
+        continue;
+      }
+      for (uint32_t count = __atomic_exchange_n(&s_deferred[id], 0, __ATOMIC_SEQ_CST);
+           count > 0; count--) {
+        prv_queue_signal(id, priority);
+      }
+    }
+  }
+}
+
+// Returns true if |sival| was deferred because interrupts are masked
+static bool prv_defer(uint32_t sival) {
+  if (!prv_masked()) {
+    return false;
+  }
+
+  __atomic_add_fetch(&s_deferred[sival], 1, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&s_deferred_any, true, __ATOMIC_SEQ_CST);
+  if (!prv_masked()) {
+    // Unmasked in the meantime, possibly before the unmask could see this interrupt
+    prv_replay_deferred();
+  }
+  return true;
+}
+
 // Signal handler for all interrupts. Prioritization is handled by the
 // implementation of signals and the init function. Signals of higher priority
 // interrupt the running of this function. All other signals are stored in a
@@ -46,8 +107,15 @@ static x86InterruptHandler s_x86_interrupt_handlers[NUM_X86_INTERRUPT_HANDLERS];
 static void prv_sig_handler(int signum, siginfo_t *info, void *ptr) {
   (void)signum;
   (void)ptr;
+  uint32_t sival = (uint32_t)info->si_value.sival_int;
+  if (sival > NUM_X86_INTERRUPT_INTERRUPTS || prv_defer(sival)) {
+    return;
+  }
+
+  // Restored rather than cleared on the way out, since this may have preempted another handler
+  bool was_in_handler = s_in_handler_flag;
   s_in_handler_flag = true;
-  if (info->si_value.sival_int < NUM_X86_INTERRUPT_INTERRUPTS) {
+  if (sival < NUM_X86_INTERRUPT_INTERRUPTS) {
     // If the interrupt is an event don't run the handler as it is just a wake
     // event.
     if (!s_x86_interrupt_interrupts_map[info->si_value.sival_int].is_event) {
@@ -57,34 +125,7 @@ static void prv_sig_handler(int signum, siginfo_t *info, void *ptr) {
           info->si_value.sival_int);
     }
   }
-  s_in_handler_flag = false;
-}
-
-// Blocks all interrupts (excluding signals to block/unblock interrupts) when
-// triggered. Should use signal number |SIGRTMIN + NUM_INTERRUPT_PRIORITIES| to
-// trigger. This has to be run as a signal handler since a thread can only
-// manipulate its own signal mask or its children up until the point they are
-// spawned. As a result the signal handling thread MUST be interrupted in order
-// to change its signal mask in the event of a critical section.
-static void prv_sig_state_handler(int signum, siginfo_t *info, void *ptr) {
-  (void)signum;
-  // We actually need to manipulate the block mask of the context that is
-  // restored for this thread. So we alter |ctx| rather than directly calling
-  // |pthread_sigmask| as this gets overridden on context switch after exiting
-  // the handler.
-  ucontext_t *ctx = ptr;
-
-  // Based on the sival_int change the state of interrupts. If invalid number
-  // silently ignore.
-  if (info->si_value.sival_int == X86_INTERRUPT_STATE_MASK) {
-    sigaddset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
-    sigaddset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_NORMAL);
-    sigaddset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_HIGH);
-  } else if (info->si_value.sival_int == X86_INTERRUPT_STATE_UNMASK) {
-    sigdelset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
-    sigdelset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_NORMAL);
-    sigdelset(&ctx->uc_sigmask, SIGRTMIN + INTERRUPT_PRIORITY_HIGH);
-  }
+  s_in_handler_flag = was_in_handler;
 }
 
 void x86_interrupt_init(void) {
@@ -104,6 +145,9 @@ void x86_interrupt_init(void) {
   sigset_t block_mask;
   sigemptyset(&block_mask);
 
+  // RTOS context switches never preempt an interrupt handler.
+  sigaddset(&block_mask, X86_INTERRUPT_RTOS_SIGNAL);
+
   // Add a rule for low priority interrupts which blocks only other low priority
   // signals.
   sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
@@ -122,14 +166,12 @@ void x86_interrupt_init(void) {
   act.sa_mask = block_mask;
   sigaction(SIGRTMIN + INTERRUPT_PRIORITY_HIGH, &act, NULL);
 
-  // Add a rule for the masking (critical sectioning) of the signals.
-  act.sa_mask = block_mask;
-  act.sa_sigaction = prv_sig_state_handler;
-  sigaction(SIGRTMIN + NUM_INTERRUPT_PRIORITIES, &act, NULL);
-
   // Clear statics.
-  s_interrupt_state_update = X86_INTERRUPT_STATE_NONE;
   s_in_handler_flag = false;
+  __atomic_store_n(&s_mask_depth, 0, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&s_deferred_any, false, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&s_rtos_deferred, false, __ATOMIC_SEQ_CST);
+  memset(s_deferred, 0, sizeof(s_deferred));
   s_x86_interrupt_next_interrupt_id = 0;
   s_x86_interrupt_next_handler_id = 0;
   memset(&s_x86_interrupt_interrupts_map, 0, sizeof(s_x86_interrupt_interrupts_map));
@@ -174,10 +216,7 @@ StatusCode x86_interrupt_trigger(uint8_t interrupt_id) {
 
   // Enqueue a new signal sent to this process that has a signal number
   // determined by the id for the callback it is going to run.
-  siginfo_t value_store;
-  value_store.si_value.sival_int = interrupt_id;
-  sigqueue(s_pid, SIGRTMIN + (int)s_x86_interrupt_interrupts_map[interrupt_id].priority,
-           value_store.si_value);
+  prv_queue_signal(interrupt_id, s_x86_interrupt_interrupts_map[interrupt_id].priority);
 
   return STATUS_CODE_OK;
 }
@@ -188,29 +227,57 @@ void x86_interrupt_pthread_init(void) {
   sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_LOW);
   sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_NORMAL);
   sigaddset(&block_mask, SIGRTMIN + INTERRUPT_PRIORITY_HIGH);
-  sigaddset(&block_mask, SIGRTMIN + NUM_INTERRUPT_PRIORITIES);
+  sigaddset(&block_mask, X86_INTERRUPT_RTOS_SIGNAL);
   pthread_sigmask(SIG_BLOCK, &block_mask, NULL);
 }
 
 void x86_interrupt_mask(void) {
-  siginfo_t value_store;
-  value_store.si_value.sival_int = X86_INTERRUPT_STATE_MASK;
-  sigqueue(s_pid, SIGRTMIN + NUM_INTERRUPT_PRIORITIES, value_store.si_value);
+  __atomic_add_fetch(&s_mask_depth, 1, __ATOMIC_SEQ_CST);
 }
 
 void x86_interrupt_unmask(void) {
-  siginfo_t value_store;
-  value_store.si_value.sival_int = X86_INTERRUPT_STATE_UNMASK;
-  sigqueue(s_pid, SIGRTMIN + NUM_INTERRUPT_PRIORITIES, value_store.si_value);
+  uint32_t depth = __atomic_load_n(&s_mask_depth, __ATOMIC_SEQ_CST);
+  while (depth > 0 && !__atomic_compare_exchange_n(&s_mask_depth, &depth, depth - 1, true,
+                                                   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+  }
+  if (depth == 1) {
+    // Anything that arrived while masked runs now
+    prv_replay_deferred();
+  }
+}
+
+bool x86_interrupt_defer_rtos_signal(void) {
+  if (!prv_masked()) {
+    return false;
+  }
+
+  s_rtos_deferred_thread = pthread_self();
+  __atomic_store_n(&s_rtos_deferred, true, __ATOMIC_SEQ_CST);
+  if (!prv_masked()) {
+    prv_replay_deferred();
+  }
+  return true;
 }
 
 void x86_interrupt_wake(void) {
-  siginfo_t value_store;
-  uint8_t interrupt_id = NUM_X86_INTERRUPT_INTERRUPTS;
-  value_store.si_value.sival_int = interrupt_id;
-  sigqueue(s_pid, SIGRTMIN + INTERRUPT_PRIORITY_HIGH, value_store.si_value);
+  prv_queue_signal(NUM_X86_INTERRUPT_INTERRUPTS, INTERRUPT_PRIORITY_HIGH);
+}
+
+void x86_interrupt_wait(void) {
+  sigset_t wait_sigset;
+  sigemptyset(&wait_sigset);
+  sigsuspend(&wait_sigset);
+}
+
+void x86_interrupt_init_sigevent(uint8_t interrupt_id, struct sigevent *event) {
+  memset(event, 0, sizeof(*event));
+  event->sigev_value.sival_int = interrupt_id;
+  event->sigev_notify = SIGEV_SIGNAL;
+  event->sigev_signo = SIGRTMIN + (int)s_x86_interrupt_interrupts_map[interrupt_id].priority;
 }
 
 bool x86_interrupt_in_handler(void) {
   return s_in_handler_flag;
 }
+
+#endif
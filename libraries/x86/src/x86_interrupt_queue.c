@@ -0,0 +1,415 @@
+#include "x86_interrupt.h"
+
+// Queue backend - enabled with DEFINE=X86_INTERRUPT_QUEUE
+#ifdef X86_INTERRUPT_QUEUE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "interrupt_def.h"
+#include "log.h"
+#include "status.h"
+
+#ifdef X86_SIM
+#include "x86_sim.h"
+#else
+// Only the simulator tracks whether a board is idle
+#define x86_sim_busy()
+#define x86_sim_idle()
+#endif
+
+#define NUM_X86_INTERRUPT_HANDLERS 64
+#define NUM_X86_INTERRUPT_INTERRUPTS 128
+// Must be a power of 2
+#define X86_INTERRUPT_QUEUE_SIZE 256
+// Sent to the CPU thread when it may have interrupts to run
+#define X86_INTERRUPT_KICK_SIGNAL SIGRTMIN
+
+typedef struct Interrupt {
+  InterruptPriority priority;
+  uint8_t handler_id;
+  bool is_event;
+} Interrupt;
+
+typedef struct InterruptSlot {
+  size_t sequence;
+  uint8_t interrupt_id;
+} InterruptSlot;
+
+// Bounded multi-producer single-consumer queue. Each slot's sequence number tells producers and
+// the consumer whose turn it is, so triggering never takes a lock and is safe from any thread.
+typedef struct InterruptQueue {
+  InterruptSlot slots[X86_INTERRUPT_QUEUE_SIZE];
+  size_t head;
+  size_t tail;
+} InterruptQueue;
+
+static InterruptQueue s_queues[NUM_INTERRUPT_PRIORITIES];
+static bool s_queues_initialized = false;
+
+// The thread that called x86_interrupt_init() plays the part of the CPU: every handler runs on it,
+// preempting whatever it was doing. Everything below except the counters shared with other threads
+// is only touched by the CPU thread.
+static pthread_t s_cpu_thread;
+// Priority of the running handler, or NUM_INTERRUPT_PRIORITIES outside of handlers
+static volatile size_t s_cpu_priority = NUM_INTERRUPT_PRIORITIES;
+// Set while the CPU thread picks the next interrupt to run. A kick that arrives meanwhile leaves it
+// to the dispatch loop it interrupted.
+static volatile bool s_dispatching = false;
+// Whether a kick is on its way to the CPU thread
+static bool s_kick_pending = false;
+// Number of handlers running, including preempted ones
+static uint32_t s_handler_depth = 0;
+// Number of masks held by all threads
+static uint32_t s_mask_depth = 0;
+// Bumped whenever wait() should return
+static uint32_t s_wake_count = 0;
+// Wake count as of the last time wait() returned, so wakes in between aren't lost
+static uint32_t s_wake_seen = 0;
+// Whether the main thread is blocked in wait()
+static bool s_waiting = false;
+
+static __thread bool s_in_handler_flag = false;
+
+static uint8_t s_x86_interrupt_next_interrupt_id = 0;
+static uint8_t s_x86_interrupt_next_handler_id = 0;
+
+static Interrupt s_x86_interrupt_interrupts_map[NUM_X86_INTERRUPT_INTERRUPTS];
+static x86InterruptHandler s_x86_interrupt_handlers[NUM_X86_INTERRUPT_HANDLERS];
+
+static bool prv_queue_push(InterruptQueue *queue, uint8_t interrupt_id) {
+  size_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  InterruptSlot *slot = NULL;
+  for (;;) {
+    slot = &queue->slots[pos & (X86_INTERRUPT_QUEUE_SIZE - 1)];
+    size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // Full
+      return false;
+    } else {
+      pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->interrupt_id = interrupt_id;
+  __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_SEQ_CST);
+  return true;
+}
+
+// Whether the oldest interrupt in |queue| has been written. A producer that claimed the slot but
+// hasn't written it yet kicks the CPU thread once it has.
+static bool prv_queue_ready(const InterruptQueue *queue) {
+  const InterruptSlot *slot = &queue->slots[queue->tail & (X86_INTERRUPT_QUEUE_SIZE - 1)];
+  return __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) == queue->tail + 1;
+}
+
+// Only called by the CPU thread once prv_queue_ready() says there is an interrupt
+static uint8_t prv_queue_pop(InterruptQueue *queue) {
+  InterruptSlot *slot = &queue->slots[queue->tail & (X86_INTERRUPT_QUEUE_SIZE - 1)];
+  uint8_t interrupt_id = slot->interrupt_id;
+  __atomic_store_n(&slot->sequence, queue->tail + X86_INTERRUPT_QUEUE_SIZE, __ATOMIC_RELEASE);
+  queue->tail++;
+  return interrupt_id;
+}
+
+static bool prv_on_cpu(void) {
+  return pthread_equal(pthread_self(), s_cpu_thread);
+}
+
+static bool prv_masked(void) {
+  return __atomic_load_n(&s_mask_depth, __ATOMIC_SEQ_CST) > 0;
+}
+
+// Returns the highest priority above |below| with an interrupt ready, or NUM_INTERRUPT_PRIORITIES
+// if there is none. Lower values are higher priorities.
+static size_t prv_next_priority(size_t below) {
+  for (size_t i = 0; i < below; i++) {
+    if (prv_queue_ready(&s_queues[i])) {
+      return i;
+    }
+  }
+  return NUM_INTERRUPT_PRIORITIES;
+}
+
+#ifdef X86_SIM
+// The simulator's hooks take a lock, so no handler may run on top of one on the CPU thread
+static void prv_report(void (*hook)(void)) {
+  bool on_cpu = prv_on_cpu();
+  if (on_cpu) {
+    x86_interrupt_mask();
+  }
+  hook();
+  if (on_cpu) {
+    x86_interrupt_unmask();
+  }
+}
+#define prv_report_busy() prv_report(x86_sim_busy)
+#define prv_report_idle() prv_report(x86_sim_idle)
+#else
+#define prv_report_busy()
+#define prv_report_idle()
+#endif
+
+static void prv_wake(void) {
+  __atomic_add_fetch(&s_wake_count, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_exchange_n(&s_waiting, false, __ATOMIC_SEQ_CST)) {
+    // The main thread is runnable from now on, before the handler that woke it finishes
+    prv_report_busy();
+  }
+}
+
+static void prv_run_interrupt(size_t priority, uint8_t interrupt_id) {
+  size_t preempted_priority = s_cpu_priority;
+  bool was_in_handler = s_in_handler_flag;
+  s_cpu_priority = priority;
+  s_in_handler_flag = true;
+  // Higher priority interrupts may preempt the handler from here on
+  s_dispatching = false;
+
+  // Interrupts may have been cleared by x86_interrupt_init() since this one was triggered
+  if (interrupt_id < s_x86_interrupt_next_interrupt_id &&
+      !s_x86_interrupt_interrupts_map[interrupt_id].is_event) {
+    s_x86_interrupt_handlers[s_x86_interrupt_interrupts_map[interrupt_id].handler_id](
+        interrupt_id);
+  }
+
+  s_dispatching = true;
+  s_cpu_priority = preempted_priority;
+  s_in_handler_flag = was_in_handler;
+}
+
+// Runs interrupts that preempt whatever the CPU thread is doing, highest priority first, until
+// none are left or interrupts get masked. Only called by the CPU thread.
+static void prv_dispatch(void) {
+  while (!s_dispatching && !prv_masked() &&
+         prv_next_priority(s_cpu_priority) < NUM_INTERRUPT_PRIORITIES) {
+    s_dispatching = true;
+    for (;;) {
+      size_t priority = prv_next_priority(s_cpu_priority);
+      if (priority == NUM_INTERRUPT_PRIORITIES) {
+        break;
+      }
+
+      // A thread masking interrupts waits for handlers to finish, and each side checks the other's
+      // counter after bumping its own, so a handler never starts once another thread has masked
+      __atomic_add_fetch(&s_handler_depth, 1, __ATOMIC_SEQ_CST);
+      if (prv_masked()) {
+        __atomic_sub_fetch(&s_handler_depth, 1, __ATOMIC_SEQ_CST);
+        break;
+      }
+      prv_run_interrupt(priority, prv_queue_pop(&s_queues[priority]));
+      __atomic_sub_fetch(&s_handler_depth, 1, __ATOMIC_SEQ_CST);
+
+      // Like WFE, wait() returns once any interrupt has been handled
+      prv_wake();
+      prv_report_idle();
+    }
+    // Anything that arrived after the last check is picked up by the next iteration
+    s_dispatching = false;
+  }
+}
+
+static void prv_kicked(void) {
+  __atomic_store_n(&s_kick_pending, false, __ATOMIC_SEQ_CST);
+  prv_dispatch();
+}
+
+// Makes the CPU thread check for interrupts, like the NVIC raising an exception
+static void prv_kick(void) {
+  if (!__atomic_exchange_n(&s_kick_pending, true, __ATOMIC_SEQ_CST)) {
+    union sigval value = { .sival_ptr = prv_kicked };
+    pthread_sigqueue(s_cpu_thread, X86_INTERRUPT_KICK_SIGNAL, value);
+  }
+}
+
+// The simulator links several copies of this file into one process but signal handlers are shared,
+// so each kick carries the function of the copy that sent it
+static void prv_kick_handler(int signum, siginfo_t *info, void *ptr) {
+  (void)signum;
+  (void)ptr;
+  int saved_errno = errno;
+  ((void (*)(void))info->si_value.sival_ptr)();
+  errno = saved_errno;
+}
+
+void x86_interrupt_init(void) {
+  // Log the main thread ID for debugging.
+  LOG_DEBUG("Main Thread (id:%ld)\n", pthread_self());
+
+  s_cpu_thread = pthread_self();
+
+  // Anything still queued from before is dropped once it is dispatched since its interrupt ID is no
+  // longer registered
+  if (!s_queues_initialized) {
+    for (size_t i = 0; i < NUM_INTERRUPT_PRIORITIES; i++) {
+      for (size_t j = 0; j < X86_INTERRUPT_QUEUE_SIZE; j++) {
+        s_queues[i].slots[j].sequence = j;
+      }
+      s_queues[i].head = 0;
+      s_queues[i].tail = 0;
+    }
+    s_queues_initialized = true;
+  }
+
+  // Kicks may nest so a higher priority interrupt can preempt a running handler
+  struct sigaction act;
+  memset(&act, 0, sizeof(act));
+  act.sa_sigaction = prv_kick_handler;
+  act.sa_flags = SA_SIGINFO | SA_RESTART | SA_NODEFER;
+  sigemptyset(&act.sa_mask);
+  sigaction(X86_INTERRUPT_KICK_SIGNAL, &act, NULL);
+
+  // Clear statics.
+  s_x86_interrupt_next_interrupt_id = 0;
+  s_x86_interrupt_next_handler_id = 0;
+  memset(&s_x86_interrupt_interrupts_map, 0, sizeof(s_x86_interrupt_interrupts_map));
+  memset(&s_x86_interrupt_handlers, 0, sizeof(s_x86_interrupt_handlers));
+}
+
+StatusCode x86_interrupt_register_handler(x86InterruptHandler handler, uint8_t *handler_id) {
+  if (s_x86_interrupt_next_handler_id >= NUM_X86_INTERRUPT_HANDLERS) {
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+
+  *handler_id = s_x86_interrupt_next_handler_id;
+  s_x86_interrupt_next_handler_id++;
+  s_x86_interrupt_handlers[*handler_id] = handler;
+
+  return STATUS_CODE_OK;
+}
+
+StatusCode x86_interrupt_register_interrupt(uint8_t handler_id, const InterruptSettings *settings,
+                                            uint8_t *interrupt_id) {
+  if (handler_id >= s_x86_interrupt_next_handler_id ||
+      settings->priority >= NUM_INTERRUPT_PRIORITIES || settings->type >= NUM_INTERRUPT_TYPES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  } else if (s_x86_interrupt_next_interrupt_id >= NUM_X86_INTERRUPT_INTERRUPTS) {
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+
+  Interrupt interrupt = {
+    .priority = settings->priority, .handler_id = handler_id, .is_event = (bool)settings->type
+  };
+  s_x86_interrupt_interrupts_map[s_x86_interrupt_next_interrupt_id] = interrupt;
+  // Publish the ID only once the interrupt can be dispatched
+  *interrupt_id = __atomic_fetch_add(&s_x86_interrupt_next_interrupt_id, 1, __ATOMIC_RELEASE);
+
+  return STATUS_CODE_OK;
+}
+
+StatusCode x86_interrupt_trigger(uint8_t interrupt_id) {
+  if (interrupt_id >= s_x86_interrupt_next_interrupt_id) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  InterruptPriority priority = s_x86_interrupt_interrupts_map[interrupt_id].priority;
+  bool on_cpu = prv_on_cpu();
+  prv_report_busy();
+  while (!prv_queue_push(&s_queues[priority], interrupt_id)) {
+    if (on_cpu) {
+      prv_report_idle();
+      return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+    }
+    // Other threads wait for the CPU thread to make room rather than lose the interrupt
+    prv_kick();
+    sched_yield();
+  }
+
+  // Like the MCU, an interrupt that preempts the CPU thread's caller runs before this returns
+  if (on_cpu) {
+    prv_dispatch();
+  } else {
+    prv_kick();
+  }
+
+  return STATUS_CODE_OK;
+}
+
+void x86_interrupt_pthread_init(void) {
+  // Interrupts only ever run on the CPU thread, so there is nothing to block
+}
+
+void x86_interrupt_mask(void) {
+  __atomic_add_fetch(&s_mask_depth, 1, __ATOMIC_SEQ_CST);
+  if (!prv_on_cpu()) {
+    // No handler starts from now on, but one may be running on the CPU thread. On the MCU this
+    // thread wouldn't be running until it finished.
+    while (__atomic_load_n(&s_handler_depth, __ATOMIC_SEQ_CST) > 0) {
+      sched_yield();
+    }
+  }
+}
+
+void x86_interrupt_unmask(void) {
+  if (__atomic_sub_fetch(&s_mask_depth, 1, __ATOMIC_SEQ_CST) > 0) {
+    return;
+  }
+
+  // Anything that became pending while masked runs now
+  if (prv_on_cpu()) {
+    prv_dispatch();
+  } else if (prv_next_priority(NUM_INTERRUPT_PRIORITIES) < NUM_INTERRUPT_PRIORITIES) {
+    prv_kick();
+  }
+}
+
+void x86_interrupt_wake(void) {
+  prv_wake();
+  if (!prv_on_cpu()) {
+    prv_kick();
+  }
+}
+
+void x86_interrupt_wait(void) {
+  // Kicks are held off until sigsuspend() so none slip in between checking and sleeping
+  sigset_t kick;
+  sigset_t prev;
+  sigemptyset(&kick);
+  sigaddset(&kick, X86_INTERRUPT_KICK_SIGNAL);
+  pthread_sigmask(SIG_BLOCK, &kick, &prev);
+
+  // Like WFE, returns right away if something happened since the last call
+  while (__atomic_load_n(&s_wake_count, __ATOMIC_SEQ_CST) == s_wake_seen) {
+    __atomic_store_n(&s_waiting, true, __ATOMIC_SEQ_CST);
+    x86_sim_idle();
+    if (__atomic_load_n(&s_wake_count, __ATOMIC_SEQ_CST) == s_wake_seen) {
+      sigsuspend(&prev);
+    }
+    // Whoever clears the flag reports the main thread busy again
+    if (__atomic_exchange_n(&s_waiting, false, __ATOMIC_SEQ_CST)) {
+      x86_sim_busy();
+    }
+  }
+  s_wake_seen = __atomic_load_n(&s_wake_count, __ATOMIC_SEQ_CST);
+
+  pthread_sigmask(SIG_SETMASK, &prev, NULL);
+}
+
+static void prv_sigevent_notify(union sigval value) {
+  x86_interrupt_trigger((uint8_t)value.sival_int);
+}
+
+void x86_interrupt_init_sigevent(uint8_t interrupt_id, struct sigevent *event) {
+  memset(event, 0, sizeof(*event));
+  event->sigev_value.sival_int = interrupt_id;
+  event->sigev_notify = SIGEV_THREAD;
+  event->sigev_notify_function = prv_sigevent_notify;
+}
+
+bool x86_interrupt_in_handler(void) {
+  return s_in_handler_flag;
+}
+
+#endif
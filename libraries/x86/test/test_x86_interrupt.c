@@ -0,0 +1,355 @@
+#include "x86_interrupt.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "interrupt_def.h"
+#include "log.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+// Run with DEFINE=X86_INTERRUPT_QUEUE to test and benchmark the queue backend
+
+#define TEST_X86_INTERRUPT_TIMEOUT_US 1000000
+#define TEST_X86_INTERRUPT_LATENCY_RUNS 1000
+#define TEST_X86_INTERRUPT_BURST_SIZE 200
+#define TEST_X86_INTERRUPT_BURSTS 20
+
+static uint8_t s_low_id;
+static uint8_t s_normal_id;
+static uint8_t s_high_id;
+
+static volatile uint32_t s_low_count;
+static volatile uint32_t s_normal_count;
+static volatile uint32_t s_high_count;
+
+static volatile bool s_high_preempted_low;
+static volatile bool s_normal_preempted_high;
+static volatile uint64_t s_handled_ns;
+
+// Handlers currently running, and whether two of one priority ever overlapped
+static volatile uint32_t s_running;
+static volatile bool s_overlapped;
+
+static volatile uint32_t s_started;
+static volatile bool s_release;
+static volatile bool s_wait_for_release;
+static volatile uint32_t s_ready;
+static volatile uint32_t s_low_progress;
+static volatile bool s_low_ran_during_high;
+static volatile uint32_t s_main_progress;
+static volatile bool s_main_ran_during_handler;
+static volatile uint32_t s_count_when_masked;
+
+static uint64_t prv_now_ns(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+// Spins until |*count| reaches |expected| or the timeout expires
+static bool prv_wait_for_count(volatile uint32_t *count, uint32_t expected) {
+  uint64_t timeout_ns = prv_now_ns() + TEST_X86_INTERRUPT_TIMEOUT_US * 1000ULL;
+  while (*count < expected) {
+    if (prv_now_ns() > timeout_ns) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void prv_low_handler(uint8_t interrupt_id) {
+  // A higher priority interrupt should run to completion before we finish
+  uint32_t high_count = s_high_count;
+  x86_interrupt_trigger(s_high_id);
+  s_high_preempted_low = prv_wait_for_count(&s_high_count, high_count + 1);
+  s_low_count++;
+}
+
+static void prv_normal_handler(uint8_t interrupt_id) {
+  s_handled_ns = prv_now_ns();
+  s_normal_count++;
+}
+
+static void prv_high_handler(uint8_t interrupt_id) {
+  s_high_count++;
+}
+
+static void prv_high_trigger_normal_handler(uint8_t interrupt_id) {
+  // A lower priority interrupt must wait for us
+  uint32_t normal_count = s_normal_count;
+  x86_interrupt_trigger(s_normal_id);
+  usleep(2000);
+  s_normal_preempted_high = (s_normal_count != normal_count);
+  s_high_count++;
+}
+
+static void prv_exclusive_handler(uint8_t interrupt_id) {
+  if (__atomic_fetch_add(&s_running, 1, __ATOMIC_SEQ_CST) != 0) {
+    s_overlapped = true;
+  }
+  usleep(100);
+  __atomic_fetch_sub(&s_running, 1, __ATOMIC_SEQ_CST);
+  __atomic_fetch_add(&s_normal_count, 1, __ATOMIC_SEQ_CST);
+}
+
+// Records whether the main thread made progress while this ran
+static void prv_progress_normal_handler(uint8_t interrupt_id) {
+  uint32_t progress = s_main_progress;
+  usleep(2000);
+  s_main_ran_during_handler = (s_main_progress != progress);
+  s_normal_count++;
+}
+
+// Spins until a high priority handler releases it
+static void prv_blocking_low_handler(uint8_t interrupt_id) {
+  uint64_t timeout_ns = prv_now_ns() + TEST_X86_INTERRUPT_TIMEOUT_US * 1000ULL;
+  s_started++;
+  while (!s_release && prv_now_ns() < timeout_ns) {
+    s_low_progress++;
+  }
+  s_low_count++;
+}
+
+static void prv_releasing_high_handler(uint8_t interrupt_id) {
+  uint32_t progress = s_low_progress;
+  usleep(2000);
+  s_low_ran_during_high = (s_low_progress != progress);
+  s_release = true;
+  s_high_count++;
+}
+
+#ifdef X86_INTERRUPT_QUEUE
+static void prv_slow_normal_handler(uint8_t interrupt_id) {
+  s_started++;
+  usleep(2000);
+  s_normal_count++;
+}
+
+// Masks interrupts once a handler has started, and records how many had finished by then
+static void *prv_mask_thread(void *arg) {
+  prv_wait_for_count(&s_started, 1);
+  x86_interrupt_mask();
+  s_count_when_masked = s_normal_count;
+  x86_interrupt_unmask();
+  return NULL;
+}
+#endif
+
+// Triggers the interrupt id pointed to by |arg| from outside the main thread, once |s_release| is
+// set if |s_ready| is being counted
+static void *prv_trigger_thread(void *arg) {
+  x86_interrupt_pthread_init();
+  __atomic_fetch_add(&s_ready, 1, __ATOMIC_SEQ_CST);
+  while (s_wait_for_release && !s_release) {
+  }
+  x86_interrupt_trigger(*(uint8_t *)arg);
+  return NULL;
+}
+
+// Triggers the interrupt id pointed to by |arg| once a handler has started
+static void *prv_trigger_started_thread(void *arg) {
+  x86_interrupt_pthread_init();
+  __atomic_fetch_add(&s_ready, 1, __ATOMIC_SEQ_CST);
+  prv_wait_for_count(&s_started, 1);
+  x86_interrupt_trigger(*(uint8_t *)arg);
+  return NULL;
+}
+
+static uint8_t prv_register(x86InterruptHandler handler, InterruptPriority priority) {
+  uint8_t handler_id = 0;
+  uint8_t interrupt_id = 0;
+  InterruptSettings settings = {
+    .type = INTERRUPT_TYPE_INTERRUPT,
+    .priority = priority,
+  };
+  TEST_ASSERT_OK(x86_interrupt_register_handler(handler, &handler_id));
+  TEST_ASSERT_OK(x86_interrupt_register_interrupt(handler_id, &settings, &interrupt_id));
+  return interrupt_id;
+}
+
+void setup_test(void) {
+  x86_interrupt_init();
+  s_low_count = 0;
+  s_normal_count = 0;
+  s_high_count = 0;
+  s_high_preempted_low = false;
+  s_normal_preempted_high = false;
+  s_handled_ns = 0;
+  s_running = 0;
+  s_overlapped = false;
+  s_started = 0;
+  s_release = false;
+  s_wait_for_release = false;
+  s_ready = 0;
+  s_low_progress = 0;
+  s_low_ran_during_high = false;
+  s_main_progress = 0;
+  s_main_ran_during_handler = false;
+  s_count_when_masked = 0;
+}
+
+void teardown_test(void) {}
+
+void test_x86_interrupt_priority(void) {
+  s_low_id = prv_register(prv_low_handler, INTERRUPT_PRIORITY_LOW);
+  s_normal_id = prv_register(prv_normal_handler, INTERRUPT_PRIORITY_NORMAL);
+  s_high_id = prv_register(prv_high_handler, INTERRUPT_PRIORITY_HIGH);
+
+  TEST_ASSERT_OK(x86_interrupt_trigger(s_low_id));
+  TEST_ASSERT_TRUE(prv_wait_for_count(&s_low_count, 1));
+  TEST_ASSERT_TRUE(s_high_preempted_low);
+  TEST_ASSERT_EQUAL(1, s_high_count);
+
+  // Same interrupts, but the high priority handler now raises a normal one
+  setup_test();
+  s_normal_id = prv_register(prv_normal_handler, INTERRUPT_PRIORITY_NORMAL);
+  s_high_id = prv_register(prv_high_trigger_normal_handler, INTERRUPT_PRIORITY_HIGH);
+
+  TEST_ASSERT_OK(x86_interrupt_trigger(s_high_id));
+  TEST_ASSERT_TRUE(prv_wait_for_count(&s_normal_count, 1));
+  TEST_ASSERT_FALSE(s_normal_preempted_high);
+  TEST_ASSERT_EQUAL(1, s_high_count);
+}
+
+void test_x86_interrupt_mask(void) {
+  s_normal_id = prv_register(prv_normal_handler, INTERRUPT_PRIORITY_NORMAL);
+
+  // Interrupts stay pending while masked
+  x86_interrupt_mask();
+  TEST_ASSERT_OK(x86_interrupt_trigger(s_normal_id));
+  TEST_ASSERT_OK(x86_interrupt_trigger(s_normal_id));
+  usleep(5000);
+  TEST_ASSERT_EQUAL(0, s_normal_count);
+  x86_interrupt_unmask();
+
+  TEST_ASSERT_TRUE(prv_wait_for_count(&s_normal_count, 2));
+  TEST_ASSERT_EQUAL(2, s_normal_count);
+}
+
+void test_x86_interrupt_same_priority_exclusive(void) {
+  // Handlers of the same priority run one at a time, even when triggered from several threads
+  s_normal_id = prv_register(prv_exclusive_handler, INTERRUPT_PRIORITY_NORMAL);
+  uint8_t other_id = prv_register(prv_exclusive_handler, INTERRUPT_PRIORITY_NORMAL);
+
+  // With signals, a thread could take an interrupt before it blocks them, so none are triggered
+  // until every thread is ready
+  s_wait_for_release = true;
+  pthread_t threads[10];
+  for (size_t i = 0; i < 10; i++) {
+    pthread_create(&threads[i], NULL, prv_trigger_thread, (i % 2) ? &s_normal_id : &other_id);
+  }
+  TEST_ASSERT_TRUE(prv_wait_for_count(&s_ready, 10));
+  s_release = true;
+  for (size_t i = 0; i < 10; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  TEST_ASSERT_TRUE(prv_wait_for_count(&s_normal_count, 10));
+  TEST_ASSERT_FALSE(s_overlapped);
+}
+
+void test_x86_interrupt_suspends_main(void) {
+  // The main thread makes no progress while a handler runs
+  s_normal_id = prv_register(prv_progress_normal_handler, INTERRUPT_PRIORITY_NORMAL);
+  pthread_t thread;
+  pthread_create(&thread, NULL, prv_trigger_thread, &s_normal_id);
+
+  uint64_t timeout_ns = prv_now_ns() + TEST_X86_INTERRUPT_TIMEOUT_US * 1000ULL;
+  while (s_normal_count == 0 && prv_now_ns() < timeout_ns) {
+    s_main_progress++;
+  }
+  pthread_join(thread, NULL);
+
+  TEST_ASSERT_EQUAL(1, s_normal_count);
+  TEST_ASSERT_FALSE(s_main_ran_during_handler);
+}
+
+void test_x86_interrupt_suspends_lower_priority(void) {
+  // A low priority handler makes no progress while a higher priority one preempts it, even when
+  // both are triggered from other threads
+  s_low_id = prv_register(prv_blocking_low_handler, INTERRUPT_PRIORITY_LOW);
+  s_high_id = prv_register(prv_releasing_high_handler, INTERRUPT_PRIORITY_HIGH);
+  pthread_t low_thread;
+  pthread_t high_thread;
+  pthread_create(&high_thread, NULL, prv_trigger_started_thread, &s_high_id);
+  // With signals, the interrupt could otherwise land on the thread before it blocks them
+  TEST_ASSERT_TRUE(prv_wait_for_count(&s_ready, 1));
+  pthread_create(&low_thread, NULL, prv_trigger_thread, &s_low_id);
+
+  pthread_join(low_thread, NULL);
+  pthread_join(high_thread, NULL);
+  TEST_ASSERT_TRUE(prv_wait_for_count(&s_low_count, 1));
+
+  TEST_ASSERT_EQUAL(1, s_high_count);
+  TEST_ASSERT_TRUE(s_release);
+  TEST_ASSERT_FALSE(s_low_ran_during_high);
+}
+
+void test_x86_interrupt_mask_waits_for_handler(void) {
+#ifdef X86_INTERRUPT_QUEUE
+  // Another thread masking interrupts waits for the running handler to finish, since it couldn't
+  // have run until then on the MCU. With signals, masking only holds off new interrupts.
+  s_normal_id = prv_register(prv_slow_normal_handler, INTERRUPT_PRIORITY_NORMAL);
+  pthread_t thread;
+  pthread_create(&thread, NULL, prv_mask_thread, NULL);
+  TEST_ASSERT_OK(x86_interrupt_trigger(s_normal_id));
+  pthread_join(thread, NULL);
+
+  TEST_ASSERT_EQUAL(1, s_normal_count);
+  TEST_ASSERT_EQUAL(1, s_count_when_masked);
+#endif
+}
+
+void test_x86_interrupt_invalid_args(void) {
+  TEST_ASSERT_NOT_OK(x86_interrupt_trigger(0));
+
+  uint8_t handler_id = 0;
+  uint8_t interrupt_id = 0;
+  InterruptSettings settings = {
+    .type = INTERRUPT_TYPE_INTERRUPT,
+    .priority = NUM_INTERRUPT_PRIORITIES,
+  };
+  TEST_ASSERT_OK(x86_interrupt_register_handler(prv_normal_handler, &handler_id));
+  TEST_ASSERT_NOT_OK(x86_interrupt_register_interrupt(handler_id, &settings, &interrupt_id));
+}
+
+void test_x86_interrupt_benchmark(void) {
+  s_normal_id = prv_register(prv_normal_handler, INTERRUPT_PRIORITY_NORMAL);
+
+  // Latency from trigger to the start of the handler, one interrupt at a time
+  uint64_t total_latency_ns = 0;
+  uint64_t max_latency_ns = 0;
+  for (uint32_t i = 0; i < TEST_X86_INTERRUPT_LATENCY_RUNS; i++) {
+    uint64_t trigger_ns = prv_now_ns();
+    TEST_ASSERT_OK(x86_interrupt_trigger(s_normal_id));
+    TEST_ASSERT_TRUE(prv_wait_for_count(&s_normal_count, i + 1));
+
+    uint64_t latency_ns = s_handled_ns - trigger_ns;
+    total_latency_ns += latency_ns;
+    if (latency_ns > max_latency_ns) {
+      max_latency_ns = latency_ns;
+    }
+  }
+
+  // Throughput of bursts of interrupts
+  s_normal_count = 0;
+  uint64_t start_ns = prv_now_ns();
+  for (uint32_t i = 0; i < TEST_X86_INTERRUPT_BURSTS; i++) {
+    for (uint32_t j = 0; j < TEST_X86_INTERRUPT_BURST_SIZE; j++) {
+      TEST_ASSERT_OK(x86_interrupt_trigger(s_normal_id));
+    }
+    TEST_ASSERT_TRUE(
+        prv_wait_for_count(&s_normal_count, (i + 1) * TEST_X86_INTERRUPT_BURST_SIZE));
+  }
+  uint64_t elapsed_ns = prv_now_ns() - start_ns;
+
+  LOG_DEBUG("Latency: avg %lu ns, max %lu ns\n",
+            total_latency_ns / TEST_X86_INTERRUPT_LATENCY_RUNS, max_latency_ns);
+  LOG_DEBUG("Throughput: %lu interrupts/s\n",
+            (uint64_t)TEST_X86_INTERRUPT_BURSTS * TEST_X86_INTERRUPT_BURST_SIZE * 1000000000ULL /
+                elapsed_ns);
+}
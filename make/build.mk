@@ -58,6 +58,10 @@ $(BIN_DIR)/$(T)$(PLATFORM_EXT): $($(T)_OBJ) $(call dep_to_lib,$($(T)_DEPS)) $(DE
 		$($(firstword $|)_LDFLAGS) $(addprefix -I,$($(firstword $|)_INC_DIRS))
 	@$(OBJDUMP) -St $@ >$(basename $@).lst
 	@$(SIZE) $@
+ifneq (,$(filter LOG_TOKENIZED,$(DEFINE)))
+	@$(OBJCPY) --dump-section log_sites=$(basename $@).log_sites $@ 2>/dev/null || \
+		echo "No log sites in $(notdir $@)"
+endif
 
 # Object target - use first order-only dependency to expand the library name for subshells
 $($(T)_OBJ_ROOT)/%.o: $($(T)_SRC_ROOT)/%.c $(DEP_VARS) | $(T) $(dir $($(T)_OBJ))
@@ -10,7 +10,8 @@ $(T)_TEST_BIN_DIR := $(BIN_DIR)/test/$(T)
 $(T)_TEST_OBJ_DIR := $($(T)_OBJ_ROOT)/test
 $(T)_TEST_ROOT := $($(T)_DIR)/test
 
-$(T)_TEST_DEPS := unity $(T)
+# Targets can add test-only dependencies by defining $(T)_TEST_DEPS in their rules.mk
+$(T)_TEST_DEPS := unity $(T) $($(T)_TEST_DEPS)
 
 # Find all test_*.c files - these are our unit tests
 $(T)_TEST_SRC := $(wildcard $($(T)_TEST_ROOT)/test_*.c)
@@ -62,8 +62,9 @@ else
   ENV_VARS := $(FLASH_VAR)=$(BIN_DIR)/$(PROJECT)$(LIBRARY)_flash
 endif
 
-# Default CAN channel for Babydriver
+# Default CAN channel for Babydriver and x86 CAN HW
 CHANNEL ?= vcan0
+ENV_VARS += MIDSUN_X86_CAN_DEVICE=$(CHANNEL)
 
 # Platform targets
 .PHONY: run gdb babydriver
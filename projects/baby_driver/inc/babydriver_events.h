@@ -0,0 +1,13 @@
+#pragma once
+
+typedef enum {
+  BABYDRIVER_CAN_EVENT_RX = 0,
+  BABYDRIVER_CAN_EVENT_TX,
+  BABYDRIVER_CAN_EVENT_FAULT,
+  NUM_BABYDRIVER_CAN_EVENTS,
+} BabydriverCanEvent;
+
+typedef enum {
+  BABYDRIVER_STREAM_SAMPLE_EVENT_FLUSH = NUM_BABYDRIVER_CAN_EVENTS,
+  NUM_BABYDRIVER_STREAM_SAMPLE_EVENTS,
+} BabydriverStreamSampleEvent;
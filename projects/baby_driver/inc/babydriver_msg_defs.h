@@ -66,5 +66,31 @@ typedef enum {
   // Message data: uint8 id, uint8 port, uint8 pin, uint8 edge
   BABYDRIVER_MESSAGE_GPIO_IT_INTERRUPT = 16,
 
+  // The stream start command message, received when the Python stream_sample function is called to
+  // start periodically sampling an ADC or GPIO pin. No status message is sent on success; the
+  // stream is instead terminated by a single stream end message.
+  // Message data: uint8 id, uint8 source, uint8 port, uint8 pin, uint16 period (in units of
+  // STREAM_SAMPLE_PERIOD_UNIT_US), uint16 num_samples (0 to stream until stopped)
+  BABYDRIVER_MESSAGE_STREAM_START_COMMAND = 17,
+
+  // The stream stop command message, received to end a running stream early.
+  // Message data: uint8 id
+  BABYDRIVER_MESSAGE_STREAM_STOP_COMMAND = 18,
+
+  // The stream data message, sent from firmware whenever a frame of samples is ready and the
+  // transfer window has room. ADC frames hold 3 samples, GPIO frames hold 48 bit-packed samples.
+  // Message data: uint8 id, uint8 seq, 6 * uint8 packed samples (little endian)
+  BABYDRIVER_MESSAGE_STREAM_DATA = 19,
+
+  // The stream ack message, received from Python to open the transfer window. |seq| is the
+  // sequence number of the next data frame the host expects.
+  // Message data: uint8 id, uint8 seq
+  BABYDRIVER_MESSAGE_STREAM_ACK = 20,
+
+  // The stream end message, sent once when a stream finishes, is stopped, or fails. |status| is
+  // not OK if a sample couldn't be read or the sampling timer couldn't be restarted.
+  // Message data: uint8 id, uint8 status, uint16 samples_sent, uint16 samples_dropped
+  BABYDRIVER_MESSAGE_STREAM_END = 21,
+
   NUM_BABYDRIVER_MESSAGES,
 } BabydriverMessageId;
@@ -0,0 +1,41 @@
+#pragma once
+
+// This module streams periodic ADC or GPIO samples back to Python for bench data acquisition.
+// Samples are taken from a soft timer at the requested rate and packed into babydriver stream data
+// messages, which are sent from the main loop using a sliding window: at most |window| data messages may be unacknowledged
+// at once, and Python opens the window by sending stream ack messages. Samples taken while the
+// window is closed are buffered, and counted as dropped if the buffer overflows.
+// Requires dispatcher, interrupts, soft timers, gpio, ADC, the event queue, and CAN to be
+// initialized.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event_queue.h"
+#include "status.h"
+
+// The sampling period in the stream start command is in units of this many microseconds.
+#define STREAM_SAMPLE_PERIOD_UNIT_US 100
+
+// Number of packed data frames buffered while waiting for the transfer window to open.
+#define STREAM_SAMPLE_BUFFER_FRAMES 16
+
+// Default number of unacknowledged data messages allowed in flight.
+#define STREAM_SAMPLE_DEFAULT_WINDOW 8
+
+// Payload bytes per stream data message after the ID and sequence number.
+#define STREAM_SAMPLE_FRAME_BYTES 6
+
+typedef enum {
+  STREAM_SAMPLE_SOURCE_ADC_RAW = 0,
+  STREAM_SAMPLE_SOURCE_ADC_CONVERTED,
+  STREAM_SAMPLE_SOURCE_GPIO,
+  NUM_STREAM_SAMPLE_SOURCES,
+} StreamSampleSource;
+
+// Initialize the module. |window| must be between 1 and STREAM_SAMPLE_BUFFER_FRAMES.
+StatusCode stream_sample_init(uint8_t window);
+
+// Sends the buffered stream data from the main loop. Every event should be passed in, since a frame
+// that couldn't be sent is retried on the next one. Returns whether the event was for this module.
+bool stream_sample_process_event(const Event *e);
@@ -13,3 +13,4 @@ $(T)_test_gpio_get_MOCKS := gpio_get_state
 $(T)_test_i2c_write_MOCKS := i2c_write i2c_write_reg
 $(T)_test_gpio_interrupts_MOCKS := gpio_get_state
 $(T)_test_spi_exchange_MOCKS := spi_exchange spi_init
+$(T)_test_stream_sample_MOCKS := adc_read_raw_pin gpio_get_state soft_timer_start
@@ -30,3 +30,11 @@ class BabydriverMessageId:
     SPI_EXCHANGE_METADATA_2 = 11
     SPI_EXCHANGE_TX_DATA = 12
     SPI_EXCHANGE_RX_DATA = 13
+    GPIO_IT_REGISTER_COMMAND = 14
+    GPIO_IT_UNREGISTER_COMMAND = 15
+    GPIO_IT_INTERRUPT = 16
+    STREAM_START_COMMAND = 17
+    STREAM_STOP_COMMAND = 18
+    STREAM_DATA = 19
+    STREAM_ACK = 20
+    STREAM_END = 21
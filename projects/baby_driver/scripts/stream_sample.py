@@ -0,0 +1,146 @@
+"""Python implementation of the stream_sample function for Babydriver."""
+
+import time
+from collections import namedtuple
+
+import can_util
+from gpio_port import GpioPort
+from message_defs import BabydriverMessageId
+
+NUM_PINS_PER_PORT = 16
+OK_STATUS = 0
+
+# Should be kept up to date with stream_sample.h
+PERIOD_UNIT_US = 100
+DEFAULT_WINDOW = 8
+FRAME_BYTES = 6
+
+
+class StreamSource:
+    """
+    An enumeration of sample sources. This is the Python equivalent of StreamSampleSource in
+    stream_sample.h and should be kept up to date with it.
+    """
+    # pylint: disable=too-few-public-methods
+
+    ADC_RAW = 0
+    ADC_CONVERTED = 1
+    GPIO = 2
+
+
+# The result of a stream: the samples in order, the number of samples the firmware had to drop
+# because we weren't acking fast enough, and the measured sample throughput in samples/second.
+StreamResult = namedtuple("StreamResult", ["samples", "dropped", "samples_per_sec"])
+
+# pylint: disable=too-many-arguments
+# pylint: disable=too-many-locals
+
+
+def _unpack_frame(source, payload, num_samples):
+    """Returns up to num_samples samples from a stream data message payload."""
+    if source == StreamSource.GPIO:
+        bits = [(payload[i // 8] >> (i % 8)) & 1 for i in range(FRAME_BYTES * 8)]
+        return bits[:num_samples]
+    values = [payload[i] | (payload[i + 1] << 8) for i in range(0, FRAME_BYTES, 2)]
+    return values[:num_samples]
+
+
+def stream_sample(port, pin, num_samples, period_us=1000, source=StreamSource.ADC_RAW,
+                  window=DEFAULT_WINDOW, timeout=1):
+    """
+    Samples an ADC or GPIO pin periodically and streams the readings back.
+
+    Readings are packed several to a CAN message and sent using a sliding window. We ack every
+    half-window of messages so the firmware never stalls waiting for us.
+
+    Args:
+        port: The port of the GPIO pin to sample (an int or a string like 'A').
+        pin: The pin number of the GPIO pin to sample.
+        num_samples: Number of samples to take, between 1 and 65535.
+        period_us: Sampling period in microseconds, a multiple of 100 up to 6553500.
+        source: One of the StreamSource values.
+        window: The window the firmware was initialized with.
+        timeout: Seconds to wait for each message before giving up.
+
+    Returns:
+        A StreamResult.
+
+    Raises:
+        ValueError: if the range of the input args is invalid.
+        Exception: if we receive a nonzero status code.
+    """
+
+    if isinstance(port, str):
+        port = getattr(GpioPort, port.capitalize())
+
+    if port < 0 or port >= GpioPort.NUM_GPIO_PORTS:
+        raise ValueError("ERROR: invalid GPIO port")
+    if pin < 0 or pin >= NUM_PINS_PER_PORT:
+        raise ValueError("ERROR: invalid GPIO pin number")
+    if source not in (StreamSource.ADC_RAW, StreamSource.ADC_CONVERTED, StreamSource.GPIO):
+        raise ValueError("ERROR: invalid stream source")
+    if num_samples < 1 or num_samples > 0xFFFF:
+        raise ValueError("ERROR: num_samples must be between 1 and 65535")
+    period = period_us // PERIOD_UNIT_US
+    if period < 1 or period > 0xFFFF or period_us % PERIOD_UNIT_US != 0:
+        raise ValueError("ERROR: period_us must be a multiple of {} up to {}".format(
+            PERIOD_UNIT_US, PERIOD_UNIT_US * 0xFFFF))
+    if window < 1:
+        raise ValueError("ERROR: window must be positive")
+
+    samples_per_frame = FRAME_BYTES * 8 if source == StreamSource.GPIO else FRAME_BYTES // 2
+    ack_every = max(1, window // 2)
+
+    data = can_util.can_pack([
+        (source, 1),
+        (port, 1),
+        (pin, 1),
+        (period, 2),
+        (num_samples, 2),
+    ])
+    can_util.send_message(babydriver_id=BabydriverMessageId.STREAM_START_COMMAND, data=data)
+    start_time = time.time()
+
+    samples = []
+    next_seq = 0
+    unacked = 0
+    while True:
+        msg = can_util.next_message(
+            babydriver_id=(
+                BabydriverMessageId.STREAM_DATA,
+                BabydriverMessageId.STREAM_END,
+                BabydriverMessageId.STATUS,
+            ),
+            timeout=timeout,
+        )
+
+        if msg.data[0] == BabydriverMessageId.STATUS:
+            # Only sent if the stream couldn't be started
+            raise Exception("ERROR: received a nonzero STATUS_CODE: {}".format(msg.data[1]))
+
+        if msg.data[0] == BabydriverMessageId.STREAM_END:
+            status = msg.data[1]
+            dropped = msg.data[4] | (msg.data[5] << 8)
+            break
+
+        if msg.data[1] != next_seq:
+            raise Exception("ERROR: expected stream sequence {} but got {}".format(
+                next_seq, msg.data[1]))
+        next_seq = (next_seq + 1) & 0xFF
+
+        remaining = num_samples - len(samples)
+        samples += _unpack_frame(source, msg.data[2:], min(samples_per_frame, remaining))
+
+        unacked += 1
+        if unacked >= ack_every:
+            can_util.send_message(babydriver_id=BabydriverMessageId.STREAM_ACK,
+                                  data=[next_seq])
+            unacked = 0
+
+    elapsed = time.time() - start_time
+
+    if status != OK_STATUS:
+        raise Exception("ERROR: received a nonzero STATUS_CODE: {}".format(status))
+
+    samples_per_sec = len(samples) / elapsed if elapsed > 0 else 0.0
+    return StreamResult(samples, dropped, samples_per_sec)
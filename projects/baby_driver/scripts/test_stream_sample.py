@@ -0,0 +1,84 @@
+"""This Module Tests methods in stream_sample.py"""
+import unittest
+from unittest.mock import patch
+
+from can_util import Message
+from gpio_port import GpioPort
+from message_defs import BabydriverMessageId
+from stream_sample import stream_sample, StreamSource, NUM_PINS_PER_PORT
+
+OK_STATUS = 0
+
+
+def _data_msg(seq, payload):
+    return Message(data=[BabydriverMessageId.STREAM_DATA, seq] + payload)
+
+
+def _end_msg(status, sent, dropped):
+    return Message(data=[BabydriverMessageId.STREAM_END, status,
+                         sent & 0xFF, sent >> 8, dropped & 0xFF, dropped >> 8])
+
+
+class TestStreamSample(unittest.TestCase):
+    """Test Babydriver's stream_sample function"""
+
+    @patch('can_util.send_message')
+    @patch('can_util.next_message')
+    def test_adc_stream(self, mock_next_message, mock_send_message):
+        """Tests that ADC frames are unpacked and acked every half window"""
+
+        mock_next_message.side_effect = (
+            _data_msg(0, [1, 0, 2, 0, 3, 0]),
+            _data_msg(1, [4, 0, 5, 0, 0x10, 0x27]),
+            _data_msg(2, [7, 0, 0, 0, 0, 0]),
+            _end_msg(OK_STATUS, 7, 0),
+        )
+
+        result = stream_sample(GpioPort.A, 0, 7, period_us=500, window=4)
+        self.assertEqual(result.samples, [1, 2, 3, 4, 5, 10000, 7])
+        self.assertEqual(result.dropped, 0)
+        self.assertGreater(result.samples_per_sec, 0)
+
+        # Start command, then one ack after the second frame
+        start_call, ack_call = mock_send_message.call_args_list
+        self.assertEqual(start_call[1]['babydriver_id'], BabydriverMessageId.STREAM_START_COMMAND)
+        self.assertEqual(start_call[1]['data'], [StreamSource.ADC_RAW, GpioPort.A, 0, 5, 0, 7, 0])
+        self.assertEqual(ack_call[1]['babydriver_id'], BabydriverMessageId.STREAM_ACK)
+        self.assertEqual(ack_call[1]['data'], [2])
+
+    @patch('can_util.send_message')
+    @patch('can_util.next_message')
+    def test_gpio_stream(self, mock_next_message, mock_send_message):
+        """Tests that GPIO frames are unpacked bit by bit"""
+
+        mock_next_message.side_effect = (
+            _data_msg(0, [0x05, 0, 0, 0, 0, 0]),
+            _end_msg(OK_STATUS, 4, 0),
+        )
+
+        result = stream_sample('a', 1, 4, source=StreamSource.GPIO)
+        self.assertEqual(result.samples, [1, 0, 1, 0])
+
+    @patch('can_util.send_message')
+    @patch('can_util.next_message')
+    def test_fail_conditions(self, mock_next_message, mock_send_message):
+        """Tests fail conditions"""
+
+        self.assertRaises(ValueError, stream_sample, GpioPort.NUM_GPIO_PORTS, 0, 1)
+        self.assertRaises(ValueError, stream_sample, GpioPort.A, NUM_PINS_PER_PORT, 1)
+        self.assertRaises(ValueError, stream_sample, GpioPort.A, 0, 0)
+        self.assertRaises(ValueError, stream_sample, GpioPort.A, 0, 1 << 16)
+        self.assertRaises(ValueError, stream_sample, GpioPort.A, 0, 1, period_us=150)
+        self.assertRaises(ValueError, stream_sample, GpioPort.A, 0, 1, source=3)
+
+        # Rejected by the firmware
+        mock_next_message.side_effect = (Message(data=[BabydriverMessageId.STATUS, 1]),)
+        self.assertRaises(Exception, stream_sample, GpioPort.A, 0, 1)
+
+        # Out of order frames
+        mock_next_message.side_effect = (_data_msg(1, [0] * 6),)
+        self.assertRaises(Exception, stream_sample, GpioPort.A, 0, 3)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -127,7 +127,7 @@ static StatusCode prv_i2c_write_command_callback(uint8_t data[8], void *context,
 
 StatusCode i2c_write_init(uint32_t timeout_ms) {
   // For timeout test the the timeout period is adjusted otherwise 750ms is the default timeout
-  watchdog_start(&s_watchdog, timeout_ms, prv_expiry_callback, NULL);
+  status_ok_or_return(watchdog_start(&s_watchdog, timeout_ms, prv_expiry_callback, NULL));
   status_ok_or_return(dispatcher_register_callback(BABYDRIVER_MESSAGE_I2C_WRITE_COMMAND,
                                                    prv_i2c_write_command_callback, NULL));
   return dispatcher_register_callback(BABYDRIVER_MESSAGE_I2C_WRITE_DATA,
@@ -10,6 +10,7 @@
 
 #include "adc.h"
 #include "adc_read.h"
+#include "babydriver_events.h"
 #include "can.h"
 #include "can_msg_defs.h"
 #include "dispatcher.h"
@@ -24,22 +25,16 @@
 #include "log.h"
 #include "soft_timer.h"
 #include "spi_exchange.h"
+#include "stream_sample.h"
 #include "wait.h"
 
-typedef enum {
-  CAN_EVENT_RX = 0,
-  CAN_EVENT_TX,
-  CAN_EVENT_FAULT,
-  NUM_CAN_EVENTS,
-} CanEvent;
-
 static CanStorage s_can_storage;
 static CanSettings s_can_settings = {
   .device_id = SYSTEM_CAN_DEVICE_BABYDRIVER,
   .bitrate = CAN_HW_BITRATE_500KBPS,
-  .rx_event = CAN_EVENT_RX,
-  .tx_event = CAN_EVENT_TX,
-  .fault_event = CAN_EVENT_FAULT,
+  .rx_event = BABYDRIVER_CAN_EVENT_RX,
+  .tx_event = BABYDRIVER_CAN_EVENT_TX,
+  .fault_event = BABYDRIVER_CAN_EVENT_FAULT,
   .tx = { GPIO_PORT_A, 12 },
   .rx = { GPIO_PORT_A, 11 },
   .loopback = false,
@@ -63,11 +58,13 @@ int main() {
   gpio_interrupts_init();
   i2c_write_init(I2C_WRITE_DEFAULT_TIMEOUT_MS);
   spi_exchange_init(DEFAULT_SPI_EXCHANGE_TIMEOUT_MS, DEFAULT_SPI_EXCHANGE_TX_DELAY);
+  stream_sample_init(STREAM_SAMPLE_DEFAULT_WINDOW);
 
   Event e = { 0 };
   while (true) {
     while (event_process(&e) == STATUS_CODE_OK) {
       can_process_event(&e);
+      stream_sample_process_event(&e);
     }
     wait();
   }
@@ -233,7 +233,8 @@ StatusCode spi_exchange_init(uint32_t spi_exchange_timeout, uint32_t tx_delay) {
 
   s_timeout_ms = spi_exchange_timeout;
   s_soft_timer_delay = tx_delay;
-  watchdog_start(&s_watchdog_storage, s_timeout_ms, prv_timeout_callback, NULL);
+  status_ok_or_return(
+      watchdog_start(&s_watchdog_storage, s_timeout_ms, prv_timeout_callback, NULL));
 
   status_ok_or_return(dispatcher_register_callback(BABYDRIVER_MESSAGE_SPI_EXCHANGE_METADATA_1,
                                                    prv_callback_spi_exchange_metadata1, NULL));
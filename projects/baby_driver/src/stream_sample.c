@@ -0,0 +1,342 @@
+#include "stream_sample.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "adc.h"
+#include "babydriver_events.h"
+#include "babydriver_msg_defs.h"
+#include "can_transmit.h"
+#include "critical_section.h"
+#include "dispatcher.h"
+#include "event_queue.h"
+#include "gpio.h"
+#include "soft_timer.h"
+
+#define ADC_SAMPLES_PER_FRAME (STREAM_SAMPLE_FRAME_BYTES / sizeof(uint16_t))
+#define GPIO_SAMPLES_PER_FRAME (STREAM_SAMPLE_FRAME_BYTES * 8)
+
+typedef struct StreamSampleFrame {
+  uint8_t data[STREAM_SAMPLE_FRAME_BYTES];
+  uint8_t num_samples;
+} StreamSampleFrame;
+
+typedef struct StreamSampleState {
+  StreamSampleSource source;
+  GpioAddress address;
+  uint32_t period_us;
+  // Samples left to take, only used if |bounded| is set
+  uint16_t samples_remaining;
+  bool bounded;
+  // Set while the sampling timer is running
+  bool sampling;
+  // Set once sampling is done but buffered frames still need to be sent
+  bool draining;
+  // Set when a read fails, so that the main loop drops the buffered frames instead of sending them
+  bool discard;
+  // Set when the buffered frames couldn't be sent, so that the next event retries them
+  bool flush_pending;
+  // Reported in the stream end message once the buffered frames are sent
+  StatusCode end_status;
+  SoftTimerId timer_id;
+
+  // Frame currently being filled by the sampling timer
+  StreamSampleFrame current;
+
+  // Ring buffer of completed frames waiting for the transfer window to open
+  StreamSampleFrame frames[STREAM_SAMPLE_BUFFER_FRAMES];
+  uint8_t head;
+  uint8_t num_frames;
+
+  // Sequence number of the next frame to send and the next frame Python expects
+  uint8_t next_seq;
+  uint8_t acked_seq;
+
+  uint16_t samples_sent;
+  uint16_t samples_dropped;
+} StreamSampleState;
+
+static StreamSampleState s_state;
+static uint8_t s_window = STREAM_SAMPLE_DEFAULT_WINDOW;
+
+static uint8_t prv_samples_per_frame(void) {
+  return (s_state.source == STREAM_SAMPLE_SOURCE_GPIO) ? GPIO_SAMPLES_PER_FRAME
+                                                       : ADC_SAMPLES_PER_FRAME;
+}
+
+// Returns whether a frame was added to the buffer.
+static bool prv_commit_frame(void) {
+  if (s_state.current.num_samples == 0) {
+    return false;
+  }
+
+  bool committed = false;
+  if (s_state.num_frames >= STREAM_SAMPLE_BUFFER_FRAMES) {
+    // Python isn't keeping up with the sampling rate, so the newest frame is lost
+    s_state.samples_dropped += s_state.current.num_samples;
+  } else {
+    uint8_t tail = (s_state.head + s_state.num_frames) % STREAM_SAMPLE_BUFFER_FRAMES;
+    s_state.frames[tail] = s_state.current;
+    s_state.num_frames++;
+    committed = true;
+  }
+  memset(&s_state.current, 0, sizeof(s_state.current));
+  return committed;
+}
+
+static void prv_drop_buffered_frames(void) {
+  for (uint8_t i = 0; i < s_state.num_frames; i++) {
+    s_state.samples_dropped +=
+        s_state.frames[(s_state.head + i) % STREAM_SAMPLE_BUFFER_FRAMES].num_samples;
+  }
+  s_state.num_frames = 0;
+}
+
+static void prv_raise_flush(void) {
+  if (event_raise(BABYDRIVER_STREAM_SAMPLE_EVENT_FLUSH, 0) != STATUS_CODE_OK) {
+    // The event queue is full - flush on whichever event comes next
+    s_state.flush_pending = true;
+  }
+}
+
+static void prv_send_end(StatusCode status) {
+  CAN_TRANSMIT_BABYDRIVER(BABYDRIVER_MESSAGE_STREAM_END, status, s_state.samples_sent & 0xff,
+                          s_state.samples_sent >> 8, s_state.samples_dropped & 0xff,
+                          s_state.samples_dropped >> 8, 0, 0);
+}
+
+// Sends as many buffered frames as the transfer window allows. Only called from the main loop:
+// the sampling timer only ever appends frames, so the head frame can be sent outside of a
+// critical section.
+static void prv_flush(void) {
+  bool disabled = critical_section_start();
+  s_state.flush_pending = false;
+  if (s_state.discard) {
+    s_state.discard = false;
+    prv_drop_buffered_frames();
+  }
+  critical_section_end(disabled);
+
+  while (s_state.num_frames > 0 && (uint8_t)(s_state.next_seq - s_state.acked_seq) < s_window) {
+    StreamSampleFrame *frame = &s_state.frames[s_state.head];
+    StatusCode status = CAN_TRANSMIT_BABYDRIVER(
+        BABYDRIVER_MESSAGE_STREAM_DATA, s_state.next_seq, frame->data[0], frame->data[1],
+        frame->data[2], frame->data[3], frame->data[4], frame->data[5]);
+    if (status != STATUS_CODE_OK) {
+      // The CAN TX queue is full - try again on the next event
+      s_state.flush_pending = true;
+      return;
+    }
+
+    s_state.samples_sent += frame->num_samples;
+    s_state.next_seq++;
+    s_state.head = (s_state.head + 1) % STREAM_SAMPLE_BUFFER_FRAMES;
+
+    disabled = critical_section_start();
+    s_state.num_frames--;
+    critical_section_end(disabled);
+  }
+
+  // Nothing else is buffered once sampling is done
+  disabled = critical_section_start();
+  bool done = s_state.draining && s_state.num_frames == 0;
+  if (done) {
+    s_state.draining = false;
+  }
+  critical_section_end(disabled);
+
+  if (done) {
+    prv_send_end(s_state.end_status);
+  }
+}
+
+static StatusCode prv_read_sample(uint16_t *sample) {
+  switch (s_state.source) {
+    case STREAM_SAMPLE_SOURCE_ADC_RAW:
+      return adc_read_raw_pin(s_state.address, sample);
+    case STREAM_SAMPLE_SOURCE_ADC_CONVERTED:
+      return adc_read_converted_pin(s_state.address, sample);
+    case STREAM_SAMPLE_SOURCE_GPIO: {
+      GpioState state = GPIO_STATE_LOW;
+      status_ok_or_return(gpio_get_state(&s_state.address, &state));
+      *sample = (state == GPIO_STATE_HIGH);
+      return STATUS_CODE_OK;
+    }
+    default:
+      return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+}
+
+// Returns whether a full frame was added to the buffer.
+static bool prv_pack_sample(uint16_t sample) {
+  StreamSampleFrame *frame = &s_state.current;
+  if (s_state.source == STREAM_SAMPLE_SOURCE_GPIO) {
+    frame->data[frame->num_samples / 8] |= (uint8_t)(sample << (frame->num_samples % 8));
+  } else {
+    frame->data[frame->num_samples * 2] = sample & 0xff;
+    frame->data[frame->num_samples * 2 + 1] = (sample >> 8) & 0xff;
+  }
+  frame->num_samples++;
+
+  if (frame->num_samples == prv_samples_per_frame()) {
+    return prv_commit_frame();
+  }
+  return false;
+}
+
+static void prv_sample_timer_callback(SoftTimerId timer_id, void *context) {
+  // Restart first so the sampling period doesn't include the read and TX time
+  if (s_state.bounded && s_state.samples_remaining <= 1) {
+    s_state.sampling = false;
+    s_state.timer_id = SOFT_TIMER_INVALID_TIMER;
+  } else {
+    StatusCode status =
+        soft_timer_start(s_state.period_us, prv_sample_timer_callback, NULL, &s_state.timer_id);
+    if (status != STATUS_CODE_OK) {
+      // Out of timers: this is the last sample, and the end message says why
+      s_state.sampling = false;
+      s_state.timer_id = SOFT_TIMER_INVALID_TIMER;
+      s_state.end_status = status;
+    }
+  }
+
+  uint16_t sample = 0;
+  StatusCode status = prv_read_sample(&sample);
+  if (status != STATUS_CODE_OK) {
+    soft_timer_cancel(s_state.timer_id);
+    s_state.sampling = false;
+    s_state.timer_id = SOFT_TIMER_INVALID_TIMER;
+    // Everything taken so far is dropped, and the end message reports the error
+    s_state.samples_dropped += s_state.current.num_samples;
+    memset(&s_state.current, 0, sizeof(s_state.current));
+    s_state.discard = true;
+    s_state.draining = true;
+    s_state.end_status = status;
+    prv_raise_flush();
+    return;
+  }
+
+  bool committed = prv_pack_sample(sample);
+  if (s_state.bounded) {
+    s_state.samples_remaining--;
+  }
+
+  if (!s_state.sampling) {
+    // Last sample: send whatever is left in the partially filled frame
+    prv_commit_frame();
+    s_state.draining = true;
+  }
+
+  // Frames are sent from the main loop to keep CAN transmits out of the timer interrupt
+  if (committed || s_state.draining) {
+    prv_raise_flush();
+  }
+}
+
+static StatusCode prv_stream_start_callback(uint8_t data[8], void *context, bool *tx_result) {
+  StreamSampleSource source = data[1];
+  GpioAddress address = { .port = data[2], .pin = data[3] };
+  uint16_t period = (uint16_t)(data[4] | (data[5] << 8));
+  uint16_t num_samples = (uint16_t)(data[6] | (data[7] << 8));
+
+  if (s_state.sampling || s_state.draining) {
+    return STATUS_CODE_RESOURCE_EXHAUSTED;
+  }
+  if (source >= NUM_STREAM_SAMPLE_SOURCES || address.port >= NUM_GPIO_PORTS ||
+      address.pin >= GPIO_PINS_PER_PORT || period == 0) {
+    return STATUS_CODE_INVALID_ARGS;
+  }
+
+  GpioSettings settings = {
+    .direction = GPIO_DIR_IN,
+    .state = GPIO_STATE_LOW,
+    .resistor = GPIO_RES_NONE,
+    .alt_function =
+        (source == STREAM_SAMPLE_SOURCE_GPIO) ? GPIO_ALTFN_NONE : GPIO_ALTFN_ANALOG,
+  };
+  status_ok_or_return(gpio_init_pin(&address, &settings));
+  if (source != STREAM_SAMPLE_SOURCE_GPIO) {
+    status_ok_or_return(adc_set_channel_pin(address, true));
+  }
+
+  memset(&s_state, 0, sizeof(s_state));
+  s_state.source = source;
+  s_state.address = address;
+  s_state.period_us = (uint32_t)period * STREAM_SAMPLE_PERIOD_UNIT_US;
+  s_state.samples_remaining = num_samples;
+  s_state.bounded = (num_samples != 0);
+  s_state.sampling = true;
+
+  StatusCode status =
+      soft_timer_start(s_state.period_us, prv_sample_timer_callback, NULL, &s_state.timer_id);
+  if (status != STATUS_CODE_OK) {
+    s_state.sampling = false;
+    return status;
+  }
+
+  // The stream end message replaces the status message on success
+  *tx_result = false;
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_stream_stop_callback(uint8_t data[8], void *context, bool *tx_result) {
+  *tx_result = false;
+
+  bool disabled = critical_section_start();
+  bool active = s_state.sampling || s_state.draining;
+  if (s_state.sampling) {
+    soft_timer_cancel(s_state.timer_id);
+    s_state.sampling = false;
+  }
+  // Anything not yet sent is reported as dropped so that Python isn't left waiting on acks
+  prv_drop_buffered_frames();
+  s_state.samples_dropped += s_state.current.num_samples;
+  memset(&s_state.current, 0, sizeof(s_state.current));
+  s_state.draining = false;
+  s_state.discard = false;
+  critical_section_end(disabled);
+
+  if (active) {
+    prv_send_end(STATUS_CODE_OK);
+  }
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_stream_ack_callback(uint8_t data[8], void *context, bool *tx_result) {
+  *tx_result = false;
+
+  uint8_t seq = data[1];
+  // Ignore stale or bogus acks for frames that were never sent
+  if ((uint8_t)(seq - s_state.acked_seq) <= (uint8_t)(s_state.next_seq - s_state.acked_seq)) {
+    s_state.acked_seq = seq;
+  }
+
+  prv_flush();
+  return STATUS_CODE_OK;
+}
+
+StatusCode stream_sample_init(uint8_t window) {
+  if (window == 0 || window > STREAM_SAMPLE_BUFFER_FRAMES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  if (s_state.sampling) {
+    soft_timer_cancel(s_state.timer_id);
+  }
+  memset(&s_state, 0, sizeof(s_state));
+  s_window = window;
+
+  status_ok_or_return(dispatcher_register_callback(BABYDRIVER_MESSAGE_STREAM_START_COMMAND,
+                                                   prv_stream_start_callback, NULL));
+  status_ok_or_return(dispatcher_register_callback(BABYDRIVER_MESSAGE_STREAM_STOP_COMMAND,
+                                                   prv_stream_stop_callback, NULL));
+  return dispatcher_register_callback(BABYDRIVER_MESSAGE_STREAM_ACK, prv_stream_ack_callback,
+                                      NULL);
+}
+
+bool stream_sample_process_event(const Event *e) {
+  if (e->id == BABYDRIVER_STREAM_SAMPLE_EVENT_FLUSH || s_state.flush_pending) {
+    prv_flush();
+  }
+  return e->id == BABYDRIVER_STREAM_SAMPLE_EVENT_FLUSH;
+}
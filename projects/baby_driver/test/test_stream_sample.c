@@ -0,0 +1,292 @@
+#include "stream_sample.h"
+
+#include <string.h>
+
+#include "adc.h"
+#include "babydriver_msg_defs.h"
+#include "can.h"
+#include "can_msg_defs.h"
+#include "can_transmit.h"
+#include "dispatcher.h"
+#include "gpio.h"
+#include "log.h"
+#include "ms_test_helper_can.h"
+#include "ms_test_helpers.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TEST_WINDOW 2
+#define TEST_PERIOD_UNITS 10  // 1ms
+#define TEST_MAX_SAMPLES 64
+#define TEST_TIMEOUT_MS 500
+
+typedef enum {
+  TEST_CAN_EVENT_TX = 0,
+  TEST_CAN_EVENT_RX,
+  TEST_CAN_EVENT_FAULT,
+  NUM_TEST_CAN_EVENTS,
+} TestCanEvent;
+
+static CanStorage s_can_storage;
+
+static uint16_t s_next_reading;
+// ADC reads fail once |s_next_reading| gets here
+static uint16_t s_fail_reading;
+
+static bool s_auto_ack;
+static uint8_t s_num_data_msgs;
+static uint8_t s_expected_seq;
+static uint8_t s_data[TEST_MAX_SAMPLES][8];
+
+static uint8_t s_num_status_msgs;
+static uint8_t s_status;
+static volatile bool s_status_received;
+
+// Set to make the sampling timer fail to start, and whether to set it on the next data message
+static volatile bool s_out_of_timers;
+static bool s_out_of_timers_on_data;
+
+static volatile bool s_end_received;
+static uint8_t s_end_data[8];
+
+static volatile bool s_timed_out;
+
+StatusCode TEST_MOCK(adc_read_raw_pin)(GpioAddress address, uint16_t *reading) {
+  if (s_next_reading == s_fail_reading) {
+    return status_code(STATUS_CODE_INTERNAL_ERROR);
+  }
+  *reading = s_next_reading++;
+  return STATUS_CODE_OK;
+}
+
+StatusCode TEST_MOCK(gpio_get_state)(const GpioAddress *address, GpioState *state) {
+  // Alternate high and low so the bit packing is visible
+  *state = (s_next_reading++ % 2 == 0) ? GPIO_STATE_HIGH : GPIO_STATE_LOW;
+  return STATUS_CODE_OK;
+}
+
+static void prv_timeout_callback(SoftTimerId timer_id, void *context) {
+  s_timed_out = true;
+}
+
+StatusCode __real_soft_timer_start(uint32_t duration_us, SoftTimerCallback callback,
+                                   void *context, SoftTimerId *timer_id);
+
+// Only the timeout below keeps working while |s_out_of_timers| is set
+StatusCode TEST_MOCK(soft_timer_start)(uint32_t duration_us, SoftTimerCallback callback,
+                                       void *context, SoftTimerId *timer_id) {
+  if (s_out_of_timers && callback != prv_timeout_callback) {
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  return __real_soft_timer_start(duration_us, callback, context, timer_id);
+}
+
+static StatusCode prv_data_callback(uint8_t data[8], void *context, bool *tx_result) {
+  *tx_result = false;
+  TEST_ASSERT_EQUAL(s_expected_seq, data[1]);
+  s_expected_seq++;
+  memcpy(s_data[s_num_data_msgs++], data, 8);
+
+  if (s_out_of_timers_on_data) {
+    s_out_of_timers = true;
+  }
+
+  if (s_auto_ack) {
+    CAN_TRANSMIT_BABYDRIVER(BABYDRIVER_MESSAGE_STREAM_ACK, s_expected_seq, 0, 0, 0, 0, 0, 0);
+  }
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_end_callback(uint8_t data[8], void *context, bool *tx_result) {
+  *tx_result = false;
+  s_end_received = true;
+  memcpy(s_end_data, data, 8);
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_status_callback(uint8_t data[8], void *context, bool *tx_result) {
+  *tx_result = false;
+  s_num_status_msgs++;
+  s_status = data[1];
+  s_status_received = true;
+  return STATUS_CODE_OK;
+}
+
+// Runs the CAN event loop until |done| is set or |timeout_ms| elapses.
+static void prv_process_until(volatile bool *done, uint32_t timeout_ms) {
+  s_timed_out = false;
+  SoftTimerId timer_id = SOFT_TIMER_INVALID_TIMER;
+  soft_timer_start_millis(timeout_ms, prv_timeout_callback, NULL, &timer_id);
+
+  Event e = { 0 };
+  while (!*done && !s_timed_out) {
+    if (event_process(&e) == STATUS_CODE_OK) {
+      can_process_event(&e);
+      stream_sample_process_event(&e);
+    }
+  }
+  soft_timer_cancel(timer_id);
+}
+
+static void prv_start_stream(StreamSampleSource source, uint16_t period, uint16_t num_samples) {
+  CAN_TRANSMIT_BABYDRIVER(BABYDRIVER_MESSAGE_STREAM_START_COMMAND, source, GPIO_PORT_A, 0,
+                          period & 0xff, period >> 8, num_samples & 0xff, num_samples >> 8);
+}
+
+static uint16_t prv_end_samples_sent(void) {
+  return (uint16_t)(s_end_data[2] | (s_end_data[3] << 8));
+}
+
+static uint16_t prv_end_samples_dropped(void) {
+  return (uint16_t)(s_end_data[4] | (s_end_data[5] << 8));
+}
+
+void setup_test(void) {
+  TEST_ASSERT_OK(initialize_can_and_dependencies(&s_can_storage, SYSTEM_CAN_DEVICE_BABYDRIVER,
+                                                 TEST_CAN_EVENT_TX, TEST_CAN_EVENT_RX,
+                                                 TEST_CAN_EVENT_FAULT));
+  adc_init(ADC_MODE_SINGLE);
+  TEST_ASSERT_OK(dispatcher_init());
+  TEST_ASSERT_OK(stream_sample_init(TEST_WINDOW));
+
+  TEST_ASSERT_OK(
+      dispatcher_register_callback(BABYDRIVER_MESSAGE_STREAM_DATA, prv_data_callback, NULL));
+  TEST_ASSERT_OK(
+      dispatcher_register_callback(BABYDRIVER_MESSAGE_STREAM_END, prv_end_callback, NULL));
+  TEST_ASSERT_OK(
+      dispatcher_register_callback(BABYDRIVER_MESSAGE_STATUS, prv_status_callback, NULL));
+
+  s_next_reading = 0;
+  s_fail_reading = UINT16_MAX;
+  s_auto_ack = true;
+  s_num_data_msgs = 0;
+  s_expected_seq = 0;
+  s_num_status_msgs = 0;
+  s_status = NUM_STATUS_CODES;
+  s_status_received = false;
+  s_out_of_timers = false;
+  s_out_of_timers_on_data = false;
+  s_end_received = false;
+  memset(s_data, 0, sizeof(s_data));
+  memset(s_end_data, 0, sizeof(s_end_data));
+}
+
+void teardown_test(void) {}
+
+// ADC samples are packed three to a frame and terminated by one end message with no status.
+void test_stream_adc(void) {
+  prv_start_stream(STREAM_SAMPLE_SOURCE_ADC_RAW, TEST_PERIOD_UNITS, 7);
+  prv_process_until(&s_end_received, TEST_TIMEOUT_MS);
+
+  TEST_ASSERT_TRUE(s_end_received);
+  TEST_ASSERT_EQUAL(STATUS_CODE_OK, s_end_data[1]);
+  TEST_ASSERT_EQUAL(7, prv_end_samples_sent());
+  TEST_ASSERT_EQUAL(0, prv_end_samples_dropped());
+  TEST_ASSERT_EQUAL(0, s_num_status_msgs);
+
+  TEST_ASSERT_EQUAL(3, s_num_data_msgs);
+  for (uint16_t i = 0; i < 7; i++) {
+    uint8_t *frame = s_data[i / 3];
+    uint8_t offset = 2 + 2 * (i % 3);
+    TEST_ASSERT_EQUAL(i, frame[offset] | (frame[offset + 1] << 8));
+  }
+}
+
+// GPIO samples are bit-packed 48 to a frame.
+void test_stream_gpio(void) {
+  prv_start_stream(STREAM_SAMPLE_SOURCE_GPIO, TEST_PERIOD_UNITS, 50);
+  prv_process_until(&s_end_received, TEST_TIMEOUT_MS);
+
+  TEST_ASSERT_TRUE(s_end_received);
+  TEST_ASSERT_EQUAL(50, prv_end_samples_sent());
+  TEST_ASSERT_EQUAL(2, s_num_data_msgs);
+  for (uint8_t i = 2; i < 8; i++) {
+    TEST_ASSERT_EQUAL(0x55, s_data[0][i]);
+  }
+  TEST_ASSERT_EQUAL(0x01, s_data[1][2]);
+}
+
+// Without acks only |window| frames go out; stopping reports everything else as dropped.
+void test_stream_window_and_stop(void) {
+  s_auto_ack = false;
+  prv_start_stream(STREAM_SAMPLE_SOURCE_ADC_RAW, TEST_PERIOD_UNITS, 30);
+
+  // The stream can't finish without acks
+  prv_process_until(&s_end_received, 100);
+  TEST_ASSERT_FALSE(s_end_received);
+  TEST_ASSERT_EQUAL(TEST_WINDOW, s_num_data_msgs);
+
+  CAN_TRANSMIT_BABYDRIVER(BABYDRIVER_MESSAGE_STREAM_STOP_COMMAND, 0, 0, 0, 0, 0, 0, 0);
+  prv_process_until(&s_end_received, TEST_TIMEOUT_MS);
+
+  TEST_ASSERT_TRUE(s_end_received);
+  TEST_ASSERT_EQUAL(TEST_WINDOW * 3, prv_end_samples_sent());
+  // Every sample taken before the stop is accounted for
+  TEST_ASSERT_EQUAL(s_next_reading - TEST_WINDOW * 3, prv_end_samples_dropped());
+  TEST_ASSERT_EQUAL(TEST_WINDOW, s_num_data_msgs);
+}
+
+// A failed read ends the stream with the error, and the frames that weren't sent are dropped.
+void test_stream_read_error(void) {
+  s_auto_ack = false;
+  s_fail_reading = 4 * 3;
+  prv_start_stream(STREAM_SAMPLE_SOURCE_ADC_RAW, TEST_PERIOD_UNITS, 30);
+  prv_process_until(&s_end_received, TEST_TIMEOUT_MS);
+
+  TEST_ASSERT_TRUE(s_end_received);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INTERNAL_ERROR, s_end_data[1]);
+  TEST_ASSERT_EQUAL(TEST_WINDOW, s_num_data_msgs);
+  TEST_ASSERT_EQUAL(TEST_WINDOW * 3, prv_end_samples_sent());
+  TEST_ASSERT_EQUAL(s_fail_reading - TEST_WINDOW * 3, prv_end_samples_dropped());
+}
+
+// Invalid commands are rejected with a status message.
+void test_stream_invalid_args(void) {
+  volatile bool status_received = false;
+
+  prv_start_stream(NUM_STREAM_SAMPLE_SOURCES, TEST_PERIOD_UNITS, 1);
+  prv_process_until(&status_received, 50);
+  TEST_ASSERT_EQUAL(1, s_num_status_msgs);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, s_status);
+
+  // Zero period
+  prv_start_stream(STREAM_SAMPLE_SOURCE_ADC_RAW, 0, 1);
+  prv_process_until(&status_received, 50);
+  TEST_ASSERT_EQUAL(2, s_num_status_msgs);
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, s_status);
+
+  TEST_ASSERT_FALSE(s_end_received);
+  TEST_ASSERT_EQUAL(0, s_num_data_msgs);
+  TEST_ASSERT_NOT_OK(stream_sample_init(0));
+  TEST_ASSERT_NOT_OK(stream_sample_init(STREAM_SAMPLE_BUFFER_FRAMES + 1));
+}
+
+// A stream that can't get a sampling timer isn't left running, so the next one can start.
+void test_stream_start_out_of_timers(void) {
+  s_out_of_timers = true;
+  prv_start_stream(STREAM_SAMPLE_SOURCE_ADC_RAW, TEST_PERIOD_UNITS, 1);
+  prv_process_until(&s_status_received, TEST_TIMEOUT_MS);
+  TEST_ASSERT_EQUAL(1, s_num_status_msgs);
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, s_status);
+  TEST_ASSERT_FALSE(s_end_received);
+
+  s_out_of_timers = false;
+  prv_start_stream(STREAM_SAMPLE_SOURCE_ADC_RAW, TEST_PERIOD_UNITS, 1);
+  prv_process_until(&s_end_received, TEST_TIMEOUT_MS);
+  TEST_ASSERT_TRUE(s_end_received);
+  TEST_ASSERT_EQUAL(STATUS_CODE_OK, s_end_data[1]);
+  TEST_ASSERT_EQUAL(1, prv_end_samples_sent());
+}
+
+// Running out of timers mid-stream ends it early with the error and the samples taken so far.
+void test_stream_restart_out_of_timers(void) {
+  // Unbounded, so only running out of timers ends it
+  s_out_of_timers_on_data = true;
+  prv_start_stream(STREAM_SAMPLE_SOURCE_ADC_RAW, TEST_PERIOD_UNITS, 0);
+  prv_process_until(&s_end_received, TEST_TIMEOUT_MS);
+
+  TEST_ASSERT_TRUE(s_end_received);
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, s_end_data[1]);
+  TEST_ASSERT_EQUAL(s_next_reading, prv_end_samples_sent() + prv_end_samples_dropped());
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+// Records every CAN frame and selected data points to an SD card for post-mortem analysis.
+// Requires the event queue, soft timers, interrupts and the SD card to be initialized, and
+// pcf8523_init() if RTC timestamps are used.
+//
+// Each session gets a new file, BBOXnnnn.BIN, which is preallocated contiguously up front. Records
+// then go straight to the file's blocks with multi-block writes, without going through FatFs.
+// Records are appended to one of two buffers while the other is being written, and a buffer is
+// written once it fills up or every BLACK_BOX_SYNC_PERIOD_MS, whichever comes first. If both
+// buffers are full, new records are dropped and counted.
+//
+// File format (all fields little-endian):
+// Every SD_BLOCK_SIZE block starts with a BlackBoxBlockHeader. Since the file is preallocated, it
+// may hold stale data past the end of the log - the log ends at the first block whose header
+// doesn't match the first block's session and its own index in the file.
+// Records follow the header and never cross a block. Each starts with a type byte and the
+// soft_timer_now_us() timestamp when it was logged (uint32), followed by:
+// - BLACK_BOX_RECORD_CAN_STD | dlc: uint16 ID, dlc data bytes
+// - BLACK_BOX_RECORD_CAN_EXT | dlc: uint32 ID, dlc data bytes
+// - BLACK_BOX_RECORD_DATA: uint16 data point ID, int32 value
+// - BLACK_BOX_RECORD_TIME: RTC seconds, minutes, hours, days, months, years (1 byte each)
+// - BLACK_BOX_RECORD_END: nothing - the rest of the block is unused
+// TIME records are logged at the start of the session and on every sync to tie the microsecond
+// timestamps to the wall clock.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event_queue.h"
+#include "sd_binary.h"
+#include "spi.h"
+#include "status.h"
+
+// Blocks in each of the two buffers, written with a single multi-block write when full
+#define BLACK_BOX_BUFFER_BLOCKS 4
+#define BLACK_BOX_BUFFER_SIZE (BLACK_BOX_BUFFER_BLOCKS * SD_BLOCK_SIZE)
+
+// Longest time a record waits in a buffer, so a power loss costs at most this much data
+#define BLACK_BOX_SYNC_PERIOD_MS 1000
+
+#define BLACK_BOX_BLOCK_MAGIC 0xB10C
+#define BLACK_BOX_MAX_SESSIONS 10000
+
+#define BLACK_BOX_RECORD_HEADER_SIZE 5
+#define BLACK_BOX_MAX_RECORD_SIZE (BLACK_BOX_RECORD_HEADER_SIZE + 4 + 8)
+
+typedef enum {
+  BLACK_BOX_RECORD_END = 0x00,
+  BLACK_BOX_RECORD_CAN_STD = 0x10,
+  BLACK_BOX_RECORD_CAN_EXT = 0x20,
+  BLACK_BOX_RECORD_DATA = 0x30,
+  BLACK_BOX_RECORD_TIME = 0x40,
+} BlackBoxRecordType;
+
+typedef struct BlackBoxBlockHeader {
+  uint16_t magic;  // BLACK_BOX_BLOCK_MAGIC
+  uint16_t session;
+  uint32_t index;  // Index of the block in the file
+} BlackBoxBlockHeader;
+
+#define BLACK_BOX_BLOCK_HEADER_SIZE 8
+
+typedef struct BlackBoxSettings {
+  // The SD card must already be initialized on this port
+  SpiPort spi_port;
+  // Size of the preallocated log file
+  uint32_t file_blocks;
+  // Log TIME records from the PCF8523
+  bool use_rtc;
+  EventId flush_event;
+} BlackBoxSettings;
+
+typedef struct BlackBoxStats {
+  uint32_t records;
+  // Records lost because both buffers were full or the file was full
+  uint32_t dropped;
+  uint32_t blocks_written;
+  uint32_t write_errors;
+  // Most bytes buffered at once, counting a full buffer waiting to be written
+  uint32_t max_buffered_bytes;
+} BlackBoxStats;
+
+// Mounts the card, and creates and preallocates the next session's file.
+StatusCode black_box_init(const BlackBoxSettings *settings);
+
+// Logs a CAN frame. Safe to call from an ISR.
+StatusCode black_box_log_can(uint32_t id, bool extended, const uint8_t *data, size_t dlc);
+
+// Logs a data point. Safe to call from an ISR.
+StatusCode black_box_log_data(uint16_t data_id, int32_t value);
+
+// Writes everything buffered so far to the card.
+StatusCode black_box_flush(void);
+
+// Writes out full buffers and handles periodic syncs. Returns whether the event was processed.
+bool black_box_process_event(const Event *e);
+
+// Session number of the current file, i.e. nnnn in BBOXnnnn.BIN
+uint16_t black_box_get_session(void);
+
+StatusCode black_box_get_stats(BlackBoxStats *stats);
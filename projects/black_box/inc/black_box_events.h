@@ -0,0 +1,6 @@
+#pragma once
+
+typedef enum {
+  BLACK_BOX_EVENT_FLUSH = 0,
+  NUM_BLACK_BOX_EVENTS,
+} BlackBoxEvent;
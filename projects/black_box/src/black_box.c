@@ -0,0 +1,270 @@
+#include "black_box.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "critical_section.h"
+#include "ff.h"
+#include "log.h"
+#include "pcf8523_rtc.h"
+#include "sd_cache.h"
+#include "soft_timer.h"
+
+// Event data for the periodic sync, as opposed to a full buffer
+#define BLACK_BOX_FLUSH_SYNC 1
+
+// "1:BBOXnnnn.BIN"
+#define BLACK_BOX_PATH_LEN 20
+
+typedef struct BlackBoxBuffer {
+  uint8_t data[BLACK_BOX_BUFFER_SIZE];
+  size_t fill;
+  // Index in the file of the buffer's first block
+  uint32_t first_block;
+} BlackBoxBuffer;
+
+static BlackBoxSettings s_settings;
+static FATFS s_fs;
+static uint16_t s_session;
+// Card block of the start of the file
+static uint32_t s_start_block;
+// Index in the file of the next block to be started
+static uint32_t s_next_block;
+
+static BlackBoxBuffer s_buffers[2];
+// Records are appended to the active buffer, while the pending buffer is waiting to be written
+static BlackBoxBuffer *volatile s_active;
+static BlackBoxBuffer *volatile s_pending;
+
+static BlackBoxStats s_stats;
+static SoftTimerId s_sync_timer = SOFT_TIMER_INVALID_TIMER;
+
+static uint8_t *prv_put_u16(uint8_t *dest, uint16_t value) {
+  dest[0] = (uint8_t)value;
+  dest[1] = (uint8_t)(value >> 8);
+  return dest + 2;
+}
+
+static uint8_t *prv_put_u32(uint8_t *dest, uint32_t value) {
+  dest = prv_put_u16(dest, (uint16_t)value);
+  return prv_put_u16(dest, (uint16_t)(value >> 16));
+}
+
+static uint8_t *prv_put_record_header(uint8_t *dest, uint8_t type) {
+  dest[0] = type;
+  return prv_put_u32(dest + 1, soft_timer_now_us());
+}
+
+// Copies the record into the active buffer, swapping buffers when it fills up.
+static StatusCode prv_append(const uint8_t *record, size_t len) {
+  bool disabled = critical_section_start();
+  BlackBoxBuffer *buffer = s_active;
+  size_t offset = buffer->fill;
+
+  if (offset % SD_BLOCK_SIZE == 0 || offset % SD_BLOCK_SIZE + len > SD_BLOCK_SIZE) {
+    // Records don't cross blocks, so start a new one
+    offset = (offset + SD_BLOCK_SIZE - 1) / SD_BLOCK_SIZE * SD_BLOCK_SIZE;
+    if (offset == BLACK_BOX_BUFFER_SIZE) {
+      if (s_pending != NULL) {
+        s_stats.dropped++;
+        critical_section_end(disabled);
+        return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+      }
+      s_pending = buffer;
+      buffer = (buffer == &s_buffers[0]) ? &s_buffers[1] : &s_buffers[0];
+      s_active = buffer;
+      offset = 0;
+      event_raise(s_settings.flush_event, 0);
+    }
+    if (s_next_block >= s_settings.file_blocks) {
+      s_stats.dropped++;
+      critical_section_end(disabled);
+      return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+    }
+
+    if (offset == 0) {
+      buffer->first_block = s_next_block;
+    }
+    uint8_t *header = prv_put_u16(buffer->data + offset, BLACK_BOX_BLOCK_MAGIC);
+    header = prv_put_u16(header, s_session);
+    prv_put_u32(header, s_next_block);
+    s_next_block++;
+    offset += BLACK_BOX_BLOCK_HEADER_SIZE;
+  }
+
+  memcpy(buffer->data + offset, record, len);
+  buffer->fill = offset + len;
+  s_stats.records++;
+
+  uint32_t buffered = buffer->fill + ((s_pending != NULL) ? BLACK_BOX_BUFFER_SIZE : 0);
+  if (buffered > s_stats.max_buffered_bytes) {
+    s_stats.max_buffered_bytes = buffered;
+  }
+  critical_section_end(disabled);
+  return STATUS_CODE_OK;
+}
+
+// Writes the pending buffer with a single multi-block write, then hands it back for appending.
+static StatusCode prv_write_pending(void) {
+  BlackBoxBuffer *buffer = s_pending;
+  if (buffer == NULL) {
+    return STATUS_CODE_OK;
+  }
+
+  uint32_t num_blocks = (buffer->fill + SD_BLOCK_SIZE - 1) / SD_BLOCK_SIZE;
+  uint32_t block = s_start_block + buffer->first_block;
+  StatusCode status = sd_write_blocks(s_settings.spi_port, buffer->data, block, num_blocks);
+  // FatFs may have cached these blocks if the file was read
+  sd_cache_invalidate(s_settings.spi_port, block, num_blocks);
+  if (status_ok(status)) {
+    s_stats.blocks_written += num_blocks;
+  } else {
+    s_stats.write_errors++;
+  }
+
+  // The unused space must be zeroed to read as BLACK_BOX_RECORD_END
+  memset(buffer->data, 0, sizeof(buffer->data));
+  buffer->fill = 0;
+  s_pending = NULL;
+  return status;
+}
+
+static StatusCode prv_log_time(void) {
+  Pcf8523Time time = { 0 };
+  status_ok_or_return(pcf8523_get_time(&time));
+
+  uint8_t record[BLACK_BOX_MAX_RECORD_SIZE];
+  uint8_t *end = prv_put_record_header(record, BLACK_BOX_RECORD_TIME);
+  *end++ = time.seconds;
+  *end++ = time.minutes;
+  *end++ = time.hours;
+  *end++ = time.days;
+  *end++ = time.months;
+  *end++ = time.years;
+  return prv_append(record, (size_t)(end - record));
+}
+
+static void prv_sync_timeout(SoftTimerId timer_id, void *context) {
+  event_raise(s_settings.flush_event, BLACK_BOX_FLUSH_SYNC);
+  soft_timer_start_millis(BLACK_BOX_SYNC_PERIOD_MS, prv_sync_timeout, NULL, &s_sync_timer);
+}
+
+StatusCode black_box_init(const BlackBoxSettings *settings) {
+  if (settings == NULL || settings->file_blocks == 0) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  soft_timer_cancel(s_sync_timer);
+  s_settings = *settings;
+
+  char path[BLACK_BOX_PATH_LEN];
+  snprintf(path, sizeof(path), "%u:", (unsigned int)settings->spi_port);
+  if (f_mount(&s_fs, path, 1) != FR_OK) {
+    return status_msg(STATUS_CODE_INTERNAL_ERROR, "Could not mount SD card\n");
+  }
+
+  // Find the first unused session
+  FIL file = { 0 };
+  FRESULT fr = FR_EXIST;
+  for (s_session = 0; s_session < BLACK_BOX_MAX_SESSIONS && fr == FR_EXIST; s_session++) {
+    snprintf(path, sizeof(path), "%u:BBOX%04u.BIN", (unsigned int)settings->spi_port,
+             (unsigned int)s_session);
+    fr = f_open(&file, path, FA_WRITE | FA_CREATE_NEW);
+  }
+  s_session--;
+  if (fr != FR_OK) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "Could not create black box file\n");
+  }
+
+  // Allocate the file contiguously so it can be written a block at a time without FatFs
+  fr = f_expand(&file, (FSIZE_t)settings->file_blocks * SD_BLOCK_SIZE, 1);
+  s_start_block = s_fs.database + s_fs.csize * (file.obj.sclust - 2);
+  if (f_close(&file) != FR_OK || fr != FR_OK) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "Could not preallocate black box file\n");
+  }
+  LOG_DEBUG("Logging to %s at block %lu\n", path, (unsigned long)s_start_block);
+
+  memset(s_buffers, 0, sizeof(s_buffers));
+  s_active = &s_buffers[0];
+  s_pending = NULL;
+  s_next_block = 0;
+  memset(&s_stats, 0, sizeof(s_stats));
+
+  if (s_settings.use_rtc) {
+    prv_log_time();
+  }
+  return soft_timer_start_millis(BLACK_BOX_SYNC_PERIOD_MS, prv_sync_timeout, NULL,
+                                 &s_sync_timer);
+}
+
+StatusCode black_box_log_can(uint32_t id, bool extended, const uint8_t *data, size_t dlc) {
+  if ((data == NULL && dlc != 0) || dlc > 8) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  uint8_t record[BLACK_BOX_MAX_RECORD_SIZE];
+  uint8_t *end;
+  if (extended) {
+    end = prv_put_record_header(record, (uint8_t)(BLACK_BOX_RECORD_CAN_EXT | dlc));
+    end = prv_put_u32(end, id);
+  } else {
+    end = prv_put_record_header(record, (uint8_t)(BLACK_BOX_RECORD_CAN_STD | dlc));
+    end = prv_put_u16(end, (uint16_t)id);
+  }
+  if (dlc > 0) {
+    memcpy(end, data, dlc);
+  }
+  return prv_append(record, (size_t)(end - record) + dlc);
+}
+
+StatusCode black_box_log_data(uint16_t data_id, int32_t value) {
+  uint8_t record[BLACK_BOX_MAX_RECORD_SIZE];
+  uint8_t *end = prv_put_record_header(record, BLACK_BOX_RECORD_DATA);
+  end = prv_put_u16(end, data_id);
+  end = prv_put_u32(end, (uint32_t)value);
+  return prv_append(record, (size_t)(end - record));
+}
+
+StatusCode black_box_flush(void) {
+  status_ok_or_return(prv_write_pending());
+
+  // Hand over the partially filled buffer - the next record starts a new block
+  bool disabled = critical_section_start();
+  // If the active buffer filled up in the meantime, it's already pending
+  if (s_pending == NULL && s_active->fill > 0) {
+    s_pending = s_active;
+    s_active = (s_active == &s_buffers[0]) ? &s_buffers[1] : &s_buffers[0];
+  }
+  critical_section_end(disabled);
+
+  return prv_write_pending();
+}
+
+bool black_box_process_event(const Event *e) {
+  if (e == NULL || e->id != s_settings.flush_event) {
+    return false;
+  }
+
+  if (e->data == BLACK_BOX_FLUSH_SYNC) {
+    if (s_settings.use_rtc) {
+      prv_log_time();
+    }
+    black_box_flush();
+  } else {
+    prv_write_pending();
+  }
+  return true;
+}
+
+uint16_t black_box_get_session(void) {
+  return s_session;
+}
+
+StatusCode black_box_get_stats(BlackBoxStats *stats) {
+  if (stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  bool disabled = critical_section_start();
+  *stats = s_stats;
+  critical_section_end(disabled);
+  return STATUS_CODE_OK;
+}
@@ -0,0 +1,122 @@
+#include "black_box.h"
+#include "black_box_events.h"
+#include "can_hw.h"
+#include "controller_board_pins.h"
+#include "delay.h"
+#include "event_queue.h"
+#include "gpio.h"
+#include "i2c.h"
+#include "interrupt.h"
+#include "log.h"
+#include "pcf8523_rtc.h"
+#include "sd_binary.h"
+#include "soft_timer.h"
+#include "spi.h"
+#include "wait.h"
+
+#define BLACK_BOX_SPI_PORT SPI_PORT_2
+#define BLACK_BOX_I2C_PORT I2C_PORT_2
+
+// 1 GiB, about 5 hours of a fully loaded 500 kbps bus
+#define BLACK_BOX_FILE_BLOCKS (2 * 1024 * 1024)
+
+#define BLACK_BOX_STATUS_PERIOD_MS 1000
+
+// Data points logged by the board itself, alongside the CAN frames
+typedef enum {
+  BLACK_BOX_DATA_BUS_STATUS = 0,
+  BLACK_BOX_DATA_DROPPED_RECORDS,
+  BLACK_BOX_DATA_WRITE_ERRORS,
+  BLACK_BOX_DATA_MAX_BUFFERED_BYTES,
+  NUM_BLACK_BOX_DATA,
+} BlackBoxData;
+
+static const SpiSettings s_spi_settings = {
+  .baudrate = 1200000,
+  .mode = SPI_MODE_0,
+  .mosi = CONTROLLER_BOARD_ADDR_SPI2_MOSI,
+  .miso = CONTROLLER_BOARD_ADDR_SPI2_MISO,
+  .sclk = CONTROLLER_BOARD_ADDR_SPI2_SCK,
+  .cs = CONTROLLER_BOARD_ADDR_SPI2_NSS,
+};
+
+static const I2CSettings s_i2c_settings = {
+  .speed = I2C_SPEED_FAST,
+  .scl = CONTROLLER_BOARD_ADDR_I2C2_SCL,
+  .sda = CONTROLLER_BOARD_ADDR_I2C2_SDA,
+};
+
+static const CanHwSettings s_can_hw_settings = {
+  .bitrate = CAN_HW_BITRATE_500KBPS,
+  .tx = CONTROLLER_BOARD_ADDR_CAN_TX,
+  .rx = CONTROLLER_BOARD_ADDR_CAN_RX,
+  .loopback = false,
+};
+
+// Runs in the CAN RX ISR. We listen to the raw bus rather than through the CAN network layer so
+// every frame is logged, including ACKs, and we never ACK anything ourselves.
+static void prv_can_rx(void *context) {
+  uint32_t id = 0;
+  bool extended = false;
+  uint64_t data = 0;
+  size_t len = 0;
+  while (can_hw_receive(&id, &extended, &data, &len)) {
+    black_box_log_can(id, extended, (uint8_t *)&data, len);
+  }
+}
+
+static void prv_log_status(SoftTimerId timer_id, void *context) {
+  BlackBoxStats stats = { 0 };
+  black_box_get_stats(&stats);
+  black_box_log_data(BLACK_BOX_DATA_BUS_STATUS, (int32_t)can_hw_bus_status());
+  black_box_log_data(BLACK_BOX_DATA_DROPPED_RECORDS, (int32_t)stats.dropped);
+  black_box_log_data(BLACK_BOX_DATA_WRITE_ERRORS, (int32_t)stats.write_errors);
+  black_box_log_data(BLACK_BOX_DATA_MAX_BUFFERED_BYTES, (int32_t)stats.max_buffered_bytes);
+
+  soft_timer_start_millis(BLACK_BOX_STATUS_PERIOD_MS, prv_log_status, NULL, NULL);
+}
+
+int main(void) {
+  gpio_init();
+  interrupt_init();
+  soft_timer_init();
+  event_queue_init();
+
+  i2c_init(BLACK_BOX_I2C_PORT, &s_i2c_settings);
+  Pcf8523Settings rtc_settings = {
+    .cap = TWELVE_POINT_FIVE_PF,
+    .power = BATTERY_SWITCH_OVER_STANDARD,
+  };
+  pcf8523_init(BLACK_BOX_I2C_PORT, &rtc_settings);
+
+  // Give the SD card time to power up
+  delay_s(1);
+  spi_init(BLACK_BOX_SPI_PORT, &s_spi_settings);
+  if (!status_ok(sd_card_init(BLACK_BOX_SPI_PORT))) {
+    LOG_CRITICAL("Black box: could not initialize SD card\n");
+  }
+
+  BlackBoxSettings settings = {
+    .spi_port = BLACK_BOX_SPI_PORT,
+    .file_blocks = BLACK_BOX_FILE_BLOCKS,
+    .use_rtc = true,
+    .flush_event = BLACK_BOX_EVENT_FLUSH,
+  };
+  if (!status_ok(black_box_init(&settings))) {
+    LOG_CRITICAL("Black box: could not create log file\n");
+  }
+
+  can_hw_init(&s_can_hw_settings);
+  can_hw_register_callback(CAN_HW_EVENT_MSG_RX, prv_can_rx, NULL);
+  prv_log_status(SOFT_TIMER_INVALID_TIMER, NULL);
+
+  Event e = { 0 };
+  while (true) {
+    while (event_process(&e) == STATUS_CODE_OK) {
+      black_box_process_event(&e);
+    }
+    wait();
+  }
+
+  return 0;
+}
@@ -0,0 +1,334 @@
+#include "black_box.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "black_box_events.h"
+#include "event_queue.h"
+#include "ff.h"
+#include "interrupt.h"
+#include "log.h"
+#include "sd_binary.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+#include "x86_sd_binary.h"
+
+#define TEST_SPI_PORT SPI_PORT_2
+#define TEST_DRIVE "1:"
+#define TEST_IMAGE_FILE "test_black_box.img"
+#define TEST_FILE_BLOCKS 8192
+
+// About a fully loaded 500 kbps bus - 8 byte frames are 130 bits with worst-case stuffing
+#define TEST_FRAME_PERIOD_US 250
+#define TEST_SUSTAINED_DURATION_US 2000000
+
+#define TEST_THROUGHPUT_FRAMES 100000
+
+static BlackBoxSettings s_settings = {
+  .spi_port = TEST_SPI_PORT,
+  .file_blocks = TEST_FILE_BLOCKS,
+  .use_rtc = false,
+  .flush_event = BLACK_BOX_EVENT_FLUSH,
+};
+
+static FATFS s_fs;
+static uint8_t s_block[SD_BLOCK_SIZE];
+static volatile uint32_t s_frames_sent;
+
+static uint16_t prv_get_u16(const uint8_t *src) {
+  return (uint16_t)(src[0] | (src[1] << 8));
+}
+
+static uint32_t prv_get_u32(const uint8_t *src) {
+  return prv_get_u16(src) | ((uint32_t)prv_get_u16(src + 2) << 16);
+}
+
+static void prv_process_events(void) {
+  Event e = { 0 };
+  while (status_ok(event_process(&e))) {
+    black_box_process_event(&e);
+  }
+}
+
+// Reads back a session's file through FatFs, checking each block's header. Calls |record_cb| with
+// every record and returns the number of valid blocks. The last valid block is left in |s_block|.
+typedef void (*TestRecordCallback)(const uint8_t *record, void *context);
+
+static size_t prv_record_size(uint8_t type) {
+  size_t dlc = type & 0x0F;
+  switch (type & 0xF0) {
+    case BLACK_BOX_RECORD_CAN_STD:
+      return BLACK_BOX_RECORD_HEADER_SIZE + 2 + dlc;
+    case BLACK_BOX_RECORD_CAN_EXT:
+      return BLACK_BOX_RECORD_HEADER_SIZE + 4 + dlc;
+    case BLACK_BOX_RECORD_DATA:
+      return BLACK_BOX_RECORD_HEADER_SIZE + 2 + 4;
+    case BLACK_BOX_RECORD_TIME:
+      return BLACK_BOX_RECORD_HEADER_SIZE + 6;
+    default:
+      TEST_FAIL_MESSAGE("Unknown record type");
+      return 0;
+  }
+}
+
+static uint32_t prv_read_session(uint16_t session, TestRecordCallback record_cb, void *context) {
+  char path[20];
+  snprintf(path, sizeof(path), TEST_DRIVE "BBOX%04u.BIN", (unsigned int)session);
+  FIL file = { 0 };
+  TEST_ASSERT_EQUAL(FR_OK, f_open(&file, path, FA_READ));
+  TEST_ASSERT_EQUAL((FSIZE_t)TEST_FILE_BLOCKS * SD_BLOCK_SIZE, f_size(&file));
+
+  uint32_t num_blocks = 0;
+  uint8_t block[SD_BLOCK_SIZE];
+  UINT read = 0;
+  while (f_read(&file, block, SD_BLOCK_SIZE, &read) == FR_OK && read == SD_BLOCK_SIZE) {
+    if (prv_get_u16(block) != BLACK_BOX_BLOCK_MAGIC || prv_get_u16(block + 2) != session ||
+        prv_get_u32(block + 4) != num_blocks) {
+      break;
+    }
+    memcpy(s_block, block, SD_BLOCK_SIZE);
+    size_t offset = BLACK_BOX_BLOCK_HEADER_SIZE;
+    while (offset < SD_BLOCK_SIZE && s_block[offset] != BLACK_BOX_RECORD_END) {
+      if (record_cb != NULL) {
+        record_cb(s_block + offset, context);
+      }
+      offset += prv_record_size(s_block[offset]);
+      TEST_ASSERT_TRUE(offset <= SD_BLOCK_SIZE);
+    }
+    num_blocks++;
+  }
+  f_close(&file);
+  return num_blocks;
+}
+
+static void prv_count_record(const uint8_t *record, void *context) {
+  uint32_t *count = context;
+  (*count)++;
+}
+
+static void prv_send_frame(SoftTimerId timer_id, void *context) {
+  uint64_t data = s_frames_sent;
+  black_box_log_can(s_frames_sent % 0x800, false, (uint8_t *)&data, sizeof(data));
+  s_frames_sent++;
+  soft_timer_start(TEST_FRAME_PERIOD_US, prv_send_frame, NULL, NULL);
+}
+
+void setup_test(void) {
+  interrupt_init();
+  soft_timer_init();
+  event_queue_init();
+
+  unlink(TEST_IMAGE_FILE);
+  setenv(X86_SD_IMAGE_VAR, TEST_IMAGE_FILE, 1);
+  TEST_ASSERT_OK(sd_card_init(TEST_SPI_PORT));
+
+  uint8_t work[FF_MAX_SS];
+  TEST_ASSERT_EQUAL(FR_OK, f_mkfs(TEST_DRIVE, FM_ANY, 0, work, sizeof(work)));
+  TEST_ASSERT_EQUAL(FR_OK, f_mount(&s_fs, TEST_DRIVE, 1));
+
+  TEST_ASSERT_OK(black_box_init(&s_settings));
+}
+
+void teardown_test(void) {
+  unlink(TEST_IMAGE_FILE);
+}
+
+// Records come back exactly as they were logged.
+void test_black_box_records(void) {
+  uint8_t std_data[] = { 0xAB, 0xCD };
+  uint8_t ext_data[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  uint32_t start_us = soft_timer_now_us();
+  TEST_ASSERT_OK(black_box_log_can(0x123, false, std_data, sizeof(std_data)));
+  TEST_ASSERT_OK(black_box_log_can(0x1ABCDEF, true, ext_data, sizeof(ext_data)));
+  TEST_ASSERT_OK(black_box_log_can(0x7FF, false, NULL, 0));
+  TEST_ASSERT_OK(black_box_log_data(7, -42));
+  TEST_ASSERT_OK(black_box_flush());
+
+  TEST_ASSERT_EQUAL(1, prv_read_session(0, NULL, NULL));
+  uint8_t *record = s_block + BLACK_BOX_BLOCK_HEADER_SIZE;
+
+  TEST_ASSERT_EQUAL(BLACK_BOX_RECORD_CAN_STD | 2, record[0]);
+  TEST_ASSERT_TRUE(prv_get_u32(record + 1) - start_us < 1000000);
+  TEST_ASSERT_EQUAL(0x123, prv_get_u16(record + 5));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(std_data, record + 7, sizeof(std_data));
+  record += prv_record_size(record[0]);
+
+  TEST_ASSERT_EQUAL(BLACK_BOX_RECORD_CAN_EXT | 8, record[0]);
+  TEST_ASSERT_EQUAL(0x1ABCDEF, prv_get_u32(record + 5));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(ext_data, record + 9, sizeof(ext_data));
+  record += prv_record_size(record[0]);
+
+  TEST_ASSERT_EQUAL(BLACK_BOX_RECORD_CAN_STD | 0, record[0]);
+  TEST_ASSERT_EQUAL(0x7FF, prv_get_u16(record + 5));
+  record += prv_record_size(record[0]);
+
+  TEST_ASSERT_EQUAL(BLACK_BOX_RECORD_DATA, record[0]);
+  TEST_ASSERT_EQUAL(7, prv_get_u16(record + 5));
+  TEST_ASSERT_EQUAL(-42, (int32_t)prv_get_u32(record + 7));
+  record += prv_record_size(record[0]);
+
+  TEST_ASSERT_EQUAL(BLACK_BOX_RECORD_END, record[0]);
+}
+
+// The session starts with the RTC time when enabled.
+void test_black_box_rtc_time(void) {
+  BlackBoxSettings settings = s_settings;
+  settings.use_rtc = true;
+  TEST_ASSERT_OK(black_box_init(&settings));
+  TEST_ASSERT_OK(black_box_flush());
+
+  TEST_ASSERT_EQUAL(1, prv_read_session(black_box_get_session(), NULL, NULL));
+  TEST_ASSERT_EQUAL(BLACK_BOX_RECORD_TIME, s_block[BLACK_BOX_BLOCK_HEADER_SIZE]);
+}
+
+// Every init starts a new file.
+void test_black_box_new_session(void) {
+  TEST_ASSERT_EQUAL(0, black_box_get_session());
+  TEST_ASSERT_OK(black_box_log_data(0, 0));
+  TEST_ASSERT_OK(black_box_flush());
+
+  TEST_ASSERT_OK(black_box_init(&s_settings));
+  TEST_ASSERT_EQUAL(1, black_box_get_session());
+  TEST_ASSERT_OK(black_box_log_data(1, 1));
+  TEST_ASSERT_OK(black_box_log_data(1, 1));
+  TEST_ASSERT_OK(black_box_flush());
+
+  uint32_t count = 0;
+  TEST_ASSERT_EQUAL(1, prv_read_session(0, prv_count_record, &count));
+  TEST_ASSERT_EQUAL(1, count);
+  count = 0;
+  TEST_ASSERT_EQUAL(1, prv_read_session(1, prv_count_record, &count));
+  TEST_ASSERT_EQUAL(2, count);
+}
+
+// Records never cross blocks, and full buffers are written with one multi-block write.
+void test_black_box_multi_block_writes(void) {
+  X86SdStats sd_stats_before = { 0 };
+  x86_sd_get_stats(&sd_stats_before);
+
+  uint8_t data[8] = { 0 };
+  const uint32_t num_records = 1000;
+  for (uint32_t i = 0; i < num_records; i++) {
+    TEST_ASSERT_OK(black_box_log_can(i, true, data, sizeof(data)));
+    prv_process_events();
+  }
+  TEST_ASSERT_OK(black_box_flush());
+
+  uint32_t count = 0;
+  uint32_t num_blocks = prv_read_session(0, prv_count_record, &count);
+  TEST_ASSERT_EQUAL(num_records, count);
+
+  BlackBoxStats stats = { 0 };
+  TEST_ASSERT_OK(black_box_get_stats(&stats));
+  TEST_ASSERT_EQUAL(num_blocks, stats.blocks_written);
+  TEST_ASSERT_EQUAL(0, stats.dropped);
+
+  X86SdStats sd_stats = { 0 };
+  x86_sd_get_stats(&sd_stats);
+  // All but the final flush were full buffers
+  TEST_ASSERT_EQUAL(num_blocks / BLACK_BOX_BUFFER_BLOCKS + 1,
+                    sd_stats.write_calls - sd_stats_before.write_calls);
+}
+
+// Records are dropped while both buffers are full, and logging resumes once one is written.
+void test_black_box_drops_when_full(void) {
+  StatusCode status = STATUS_CODE_OK;
+  uint32_t logged = 0;
+  while (status_ok(status = black_box_log_data(0, 0))) {
+    logged++;
+  }
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, status);
+
+  BlackBoxStats stats = { 0 };
+  TEST_ASSERT_OK(black_box_get_stats(&stats));
+  TEST_ASSERT_EQUAL(logged, stats.records);
+  TEST_ASSERT_EQUAL(1, stats.dropped);
+  TEST_ASSERT_TRUE(stats.max_buffered_bytes > BLACK_BOX_BUFFER_SIZE * 2 - SD_BLOCK_SIZE);
+
+  prv_process_events();
+  TEST_ASSERT_OK(black_box_log_data(0, 0));
+  TEST_ASSERT_OK(black_box_flush());
+
+  uint32_t count = 0;
+  prv_read_session(0, prv_count_record, &count);
+  TEST_ASSERT_EQUAL(logged + 1, count);
+}
+
+// Nothing is written past the end of the preallocated file.
+void test_black_box_file_full(void) {
+  BlackBoxSettings settings = s_settings;
+  settings.file_blocks = 2;
+  TEST_ASSERT_OK(black_box_init(&settings));
+
+  uint32_t logged = 0;
+  while (status_ok(black_box_log_data(0, 0))) {
+    logged++;
+  }
+  TEST_ASSERT_OK(black_box_flush());
+  TEST_ASSERT_NOT_OK(black_box_log_data(0, 0));
+
+  BlackBoxStats stats = { 0 };
+  TEST_ASSERT_OK(black_box_get_stats(&stats));
+  TEST_ASSERT_EQUAL(2, stats.blocks_written);
+  TEST_ASSERT_EQUAL(logged, stats.records);
+}
+
+// Buffered records are written within a sync period even if the buffer isn't full.
+void test_black_box_periodic_sync(void) {
+  TEST_ASSERT_OK(black_box_log_data(0, 0));
+
+  BlackBoxStats stats = { 0 };
+  uint32_t start_us = soft_timer_now_us();
+  while (stats.blocks_written == 0 &&
+         soft_timer_now_us() - start_us < 2 * BLACK_BOX_SYNC_PERIOD_MS * 1000) {
+    prv_process_events();
+    TEST_ASSERT_OK(black_box_get_stats(&stats));
+  }
+  TEST_ASSERT_EQUAL(1, stats.blocks_written);
+}
+
+// Logs frames from a timer interrupt at full bus load while the main loop writes to the card, and
+// reports the worst-case buffer occupancy.
+void test_black_box_sustained_bus_load(void) {
+  s_frames_sent = 0;
+  soft_timer_start(TEST_FRAME_PERIOD_US, prv_send_frame, NULL, NULL);
+  uint32_t start_us = soft_timer_now_us();
+  while (soft_timer_now_us() - start_us < TEST_SUSTAINED_DURATION_US) {
+    prv_process_events();
+  }
+
+  BlackBoxStats stats = { 0 };
+  TEST_ASSERT_OK(black_box_get_stats(&stats));
+  LOG_DEBUG("%lu frames, %lu dropped, %lu bytes buffered at most (of %u)\n",
+            (unsigned long)stats.records, (unsigned long)stats.dropped,
+            (unsigned long)stats.max_buffered_bytes, 2 * BLACK_BOX_BUFFER_SIZE);
+  TEST_ASSERT_EQUAL(0, stats.dropped);
+  TEST_ASSERT_TRUE(stats.records > 0);
+}
+
+// Reports how fast records can be written to the card image.
+void test_black_box_throughput(void) {
+  uint8_t data[8] = { 0 };
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint32_t i = 0; i < TEST_THROUGHPUT_FRAMES; i++) {
+    TEST_ASSERT_OK(black_box_log_can(i, false, data, sizeof(data)));
+    prv_process_events();
+  }
+  TEST_ASSERT_OK(black_box_flush());
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  BlackBoxStats stats = { 0 };
+  TEST_ASSERT_OK(black_box_get_stats(&stats));
+  uint64_t elapsed_us = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000 +
+                        (uint64_t)(end.tv_nsec - start.tv_nsec) / 1000;
+  LOG_DEBUG("%u frames in %lu us: %lu frames/s, %lu KiB/s\n", TEST_THROUGHPUT_FRAMES,
+            (unsigned long)elapsed_us,
+            (unsigned long)((uint64_t)TEST_THROUGHPUT_FRAMES * 1000000 / (elapsed_us + 1)),
+            (unsigned long)((uint64_t)stats.blocks_written * SD_BLOCK_SIZE * 1000000 /
+                            1024 / (elapsed_us + 1)));
+  TEST_ASSERT_EQUAL(0, stats.dropped);
+}
@@ -26,6 +26,9 @@
 #define BMS_FAN_CTRL_2_I2C_ADDR 0x5F
 #define NUM_BMS_FAN_CTRLS 2
 
+// Capacity of a full pack, which the state of charge is counted down from at startup
+#define BMS_PACK_CAPACITY_MAH 40000
+
 typedef struct BmsStorage {
   RelayStorage relay_storage;
   CurrentStorage current_storage;
@@ -16,3 +16,8 @@ typedef enum {
   BMS_AFE_EVENT_FAULT,
   BMS_AFE_EVENT_END
 } BmsAfeEvent;
+
+typedef enum {
+  BMS_RELAY_EVENT_IO_INT = BMS_AFE_EVENT_END + 1,
+  BMS_RELAY_EVENT_END
+} BmsRelayEvent;
@@ -1,7 +1,7 @@
 #pragma once
 
-// Once initialized, txes cell voltages, temperatures, avg current, avg voltage, relay states and
-// fan states periodically (every 150 ms)
+// Once initialized, txes cell voltages, temperatures, avg current, avg voltage, current
+// statistics, relay states and fan states periodically (every 150 ms)
 // Requires CAN, event_queue, soft_timers and interrupts to be initialized
 
 #include "status.h"
@@ -11,10 +11,12 @@
 #define TIME_BETWEEN_TX_IN_MILLIS 85
 #define WAIT_BEFORE_FIRST_TX_IN_MILLIS 1000
 #define NUM_AGGREGATE_VC_MSGS 1
+#define NUM_CURRENT_STATS_MSGS 1
 #define NUM_BATTERY_VT_MSGS NUM_TOTAL_CELLS
 #define NUM_BATTERY_RELAY_STATE_MSGS 1
 #define NUM_FAN_STATE_MSGS 1
-#define NUM_TOTAL_MESSAGES \
-  (NUM_AGGREGATE_VC_MSGS + NUM_BATTERY_VT_MSGS + NUM_BATTERY_RELAY_STATE_MSGS + NUM_FAN_STATE_MSGS)
+#define NUM_TOTAL_MESSAGES                                                \
+  (NUM_AGGREGATE_VC_MSGS + NUM_CURRENT_STATS_MSGS + NUM_BATTERY_VT_MSGS + \
+   NUM_BATTERY_RELAY_STATE_MSGS + NUM_FAN_STATE_MSGS)
 
 StatusCode can_handler_init(BmsStorage *storage, uint32_t period_in_ms);
@@ -0,0 +1,34 @@
+#pragma once
+
+// Single pass analysis of AFE readings. Copies the readings out of the AFE while finding their
+// min, max and sum and flagging the ones outside the fault limits, so the data is only walked once.
+// Flags are collected into bitmaps without branching on each reading.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ltc_afe.h"
+#include "status.h"
+
+#define CELL_ANALYSIS_BITMAP_BITS 32
+#define CELL_ANALYSIS_BITMAP_WORDS \
+  ((LTC_AFE_MAX_CELLS + CELL_ANALYSIS_BITMAP_BITS - 1) / CELL_ANALYSIS_BITMAP_BITS)
+
+typedef struct CellAnalysis {
+  uint16_t min;
+  uint16_t max;
+  uint32_t sum;
+  // Bit (i % 32) of word (i / 32) is set if reading i is below the low limit
+  uint32_t low_bitmap[CELL_ANALYSIS_BITMAP_WORDS];
+  // Likewise if reading i is above the high limit
+  uint32_t high_bitmap[CELL_ANALYSIS_BITMAP_WORDS];
+} CellAnalysis;
+
+// Copies |len| readings from |readings| to |copy| and analyzes them against |low| and |high|.
+// |copy| may be NULL to only analyze. |len| must be at most LTC_AFE_MAX_CELLS.
+StatusCode cell_analysis_run(const uint16_t *readings, uint16_t *copy, size_t len, uint16_t low,
+                             uint16_t high, CellAnalysis *result);
+
+// Whether any reading was outside the limits
+bool cell_analysis_has_fault(const CellAnalysis *result);
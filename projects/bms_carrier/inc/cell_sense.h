@@ -31,10 +31,19 @@ typedef struct CellSenseSettings {
   uint16_t discharge_overtemp_dmv;
 } CellSenseSettings;
 
+#define NUM_AFE_READING_BANKS 2
+
+// Readings are double buffered: cell sense fills the bank that isn't published, then publishes it
+// by swapping a pointer. Readers in interrupts always see a whole set of readings, without cell
+// sense having to disable interrupts to update them.
 typedef struct AfeReadings {
   // TODO(SOFT-9): total_voltage used to be stored here as well
-  uint16_t voltages[NUM_TOTAL_CELLS];
-  uint16_t temps[NUM_THERMISTORS];
+  // The latest readings. Only cell sense should write through these.
+  uint16_t *voltages;
+  uint16_t *temps;
+
+  uint16_t voltage_banks[NUM_AFE_READING_BANKS][NUM_TOTAL_CELLS];
+  uint16_t temp_banks[NUM_AFE_READING_BANKS][NUM_THERMISTORS];
 } AfeReadings;
 
 typedef struct CellSenseStorage {
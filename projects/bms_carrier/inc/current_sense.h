@@ -1,6 +1,7 @@
 #pragma once
 
-// Stores current readings from the ADS1259 in a ring buffer.
+// Stores current readings from the ADS1259 in a ring buffer and keeps running statistics on them.
+// Every statistic is updated in constant time per reading.
 // Requires interrupts and soft timers to be initialized.
 
 #include <stdbool.h>
@@ -19,14 +20,65 @@
 #define DISCHARGE_OVERCURRENT_CA (13000)  // 130 Amps
 #define CHARGE_OVERCURRENT_CA (-8160)     // -81.6 Amps
 
+// Default window the min, max and peak currents are taken over
+#define CURRENT_SENSE_PEAK_WINDOW_MS 1000
+
+// State of charge is in hundredths of a percent
+#define CURRENT_SENSE_SOC_FULL 10000
+
+// 1 mAh = 3.6 As = 360 centiamp-seconds
+#define CURRENT_SENSE_CA_US_PER_MAH 360000000LL
+
+typedef struct CurrentStats {
+  int16_t average;  // over the readings ring, in centiamps
+  uint16_t rms;     // over the readings ring, in centiamps
+  // Taken over the last complete peak window, in centiamps
+  int16_t min;
+  int16_t max;
+  uint16_t peak;  // largest magnitude
+  // Net charge drawn from the pack since the last reset - negative while charging
+  int32_t charge_mah;
+  uint16_t state_of_charge;
+} CurrentStats;
+
 typedef struct CurrentStorage {
   int16_t readings_ring[NUM_STORED_CURRENT_READINGS];
   uint16_t ring_idx;
   int16_t average;
   uint32_t conv_period_ms;
+
+  // Running sums over the readings ring
+  int32_t ring_sum;
+  uint64_t ring_sum_squares;
+
+  // The peak window in progress
+  uint32_t peak_window_ms;
+  uint32_t peak_window_start_us;
+  int16_t window_min;
+  int16_t window_max;
+
+  // Coulomb counter, in centiamp-microseconds
+  int64_t charge_ca_us;
+  uint32_t last_reading_us;
+  uint32_t capacity_mah;
+  uint16_t initial_soc;
+
+  CurrentStats stats;
 } CurrentStorage;
 
 bool current_sense_is_charging();
 
+// Counts the state of charge down from a full pack of |capacity_mah| until
+// current_sense_reset_charge() says otherwise.
 StatusCode current_sense_init(CurrentStorage *readings, SpiSettings *settings,
-                              uint32_t conv_period_ms);
+                              uint32_t conv_period_ms, uint32_t capacity_mah);
+
+// Sets the window the min, max and peak currents are taken over. Starts a new window.
+StatusCode current_sense_set_peak_window(CurrentStorage *storage, uint32_t window_ms);
+
+// Restarts coulomb counting from a known state of charge, in hundredths of a percent.
+StatusCode current_sense_reset_charge(CurrentStorage *storage, uint32_t capacity_mah,
+                                      uint16_t state_of_charge);
+
+// Fills |stats| with the latest statistics. RMS is only calculated here.
+StatusCode current_sense_get_stats(CurrentStorage *storage, CurrentStats *stats);
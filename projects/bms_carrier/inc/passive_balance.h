@@ -1,9 +1,17 @@
 #pragma once
 
-// Passive balancing module for AFE cells.  Periodically checks for differences in voltages between
-// cells and calls ltc_afe_toggle_cell_discharge on the cell with the highest voltage
-// to mark the cell for discharge, depending on whether the difference between the highest and
-// lowest cell voltages meets the threshold for discharging.
+// Passive balancing module for AFE cells. After every cell conversion, every cell more than the
+// threshold above the lowest cell is marked for discharge, and the whole selection is handed to the
+// AFE at once so it goes out with the next config write.
+//
+// A cell keeps discharging until it's within half the threshold of the lowest cell, to avoid
+// toggling every cycle. Each device is limited in how many cells it discharges at once and stops
+// discharging while its thermistors read hot, since the bleed resistors share its board. A cell
+// that has discharged for the AFE's discharge timeout rests for a cycle before it's selected again.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "status.h"
 
@@ -13,6 +21,50 @@
 // Min voltage difference between highest and lowest cell values for balancing to be required.
 #define PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV 25
 
-// Iterate through all cells and call ltc_afe_toggle_cell_discharge, passing in whether the
-// difference in voltages meets the threshold.
-StatusCode passive_balance(uint16_t *result_arr, size_t len, LtcAfeStorage *afe);
+// Most cells each device discharges at once
+#define PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE 4
+
+// Longest a cell discharges before resting for a cycle
+#define PASSIVE_BALANCE_MAX_DISCHARGE_MS LTC_AFE_DISCHARGE_TIMEOUT_MS
+
+// Thermistor reading above which a device stops discharging, in the same units as the readings.
+// Roughly 60C on a 10k NTC divided against 10k from the AFE's 3V reference.
+#define PASSIVE_BALANCE_OVERTEMP_DMV 23100
+
+typedef struct PassiveBalanceSettings {
+  // Same units as the cell voltages
+  uint16_t threshold;
+  uint8_t max_cells_per_device;
+  // Devices with any thermistor above this stop discharging. 0 disables the check.
+  uint16_t overtemp_dmv;
+} PassiveBalanceSettings;
+
+typedef struct PassiveBalanceStorage {
+  PassiveBalanceSettings settings;
+  bool discharge[LTC_AFE_MAX_CELLS];
+  // How long each discharging cell has been discharging for
+  uint32_t discharge_ms[LTC_AFE_MAX_CELLS];
+  bool device_hot[LTC_AFE_MAX_DEVICES];
+  size_t num_discharging;
+} PassiveBalanceStorage;
+
+// Sets up the balancing used by passive_balance(). Defaults to the thresholds above.
+StatusCode passive_balance_init(const PassiveBalanceSettings *settings);
+
+// Selects the cells to discharge from the latest voltages and passes them to the AFE.
+// |min_voltage| is the lowest of |voltages|, which the caller already has from cell_analysis.
+StatusCode passive_balance(const uint16_t *voltages, size_t len, uint16_t min_voltage,
+                           LtcAfeStorage *afe);
+
+// Updates which devices are too hot to discharge from the latest thermistor readings.
+StatusCode passive_balance_update_temps(const uint16_t *temps, size_t len, LtcAfeStorage *afe);
+
+// Returns how many cells the last call to passive_balance() selected.
+size_t passive_balance_num_discharging(void);
+
+// The scheduler itself: fills |storage->discharge| for |len| cells split evenly and in order
+// between |num_devices| devices, |elapsed_ms| after the last selection. Doesn't touch the AFE, so
+// it can be run against a simulated pack.
+StatusCode passive_balance_select(PassiveBalanceStorage *storage, const uint16_t *voltages,
+                                  size_t len, uint16_t min_voltage, size_t num_devices,
+                                  uint32_t elapsed_ms);
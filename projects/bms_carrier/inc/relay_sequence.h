@@ -2,6 +2,7 @@
 
 // Module for opening and closing the relays
 // Requires interrupts, soft timers, CAN, and the MCP23008 to be initialized
+// The relay states are read from the main loop - gpio_it_deferred_process_event() must be called
 
 #include <stdbool.h>
 
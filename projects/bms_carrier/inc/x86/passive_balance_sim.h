@@ -0,0 +1,40 @@
+#pragma once
+// x86-only projection of how long passive balancing takes
+//
+// Runs the real balancing scheduler against a modelled pack on a virtual clock: every cycle, each
+// discharging cell loses |bleed_current_ma| for |cycle_ms|, and its voltage drops linearly with the
+// charge removed. Thermal limits aren't modelled.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "passive_balance.h"
+#include "status.h"
+
+typedef struct PassiveBalanceSimSettings {
+  PassiveBalanceSettings balance;
+  size_t num_devices;
+  // Time between cell conversions
+  uint32_t cycle_ms;
+  // Through each discharge resistor
+  uint16_t bleed_current_ma;
+  // Slope of a cell's voltage against the charge removed from it
+  uint32_t uv_per_mah;
+  // Gives up after this long
+  uint32_t max_time_s;
+} PassiveBalanceSimSettings;
+
+typedef struct PassiveBalanceSimResult {
+  bool balanced;
+  uint32_t time_to_balance_s;
+  uint32_t cycles;
+  // Most cells discharging in any one cycle
+  size_t max_discharging;
+  // Difference between the highest and lowest cell at the end, same units as the voltages
+  uint16_t final_spread;
+} PassiveBalanceSimResult;
+
+// Balances |len| cells starting at |voltages| (in 100 uV) until no cell needs discharging.
+StatusCode passive_balance_simulate(const uint16_t *voltages, size_t len,
+                                    const PassiveBalanceSimSettings *settings,
+                                    PassiveBalanceSimResult *result);
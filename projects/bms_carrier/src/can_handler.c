@@ -22,6 +22,17 @@ static void prv_current_tx(BmsStorage *storage) {
   soft_timer_start_millis(time_between_tx_in_millis, prv_periodic_tx, storage, NULL);
 }
 
+// Tx the running current statistics used for charge estimation: state of charge (hundredths of a
+// percent), then RMS, min and max current over their windows (centiamps, min and max signed)
+static void prv_current_stats_tx(BmsStorage *storage) {
+  CurrentStats stats = { 0 };
+  current_sense_get_stats(&storage->current_storage, &stats);
+  CAN_TRANSMIT_CURRENT_STATS(stats.state_of_charge, stats.rms, (uint16_t)stats.min,
+                             (uint16_t)stats.max);
+  s_msgs_txed++;
+  soft_timer_start_millis(time_between_tx_in_millis, prv_periodic_tx, storage, NULL);
+}
+
 // Tx cell voltage and its higher temperature reading
 static void prv_cell_voltage_and_temp_tx(BmsStorage *storage) {
   uint16_t cell_temp = storage->afe_readings.temps[s_msgs_txed * 2] >
@@ -61,8 +72,10 @@ static void prv_periodic_tx(SoftTimerId timer_id, void *context) {
     prv_cell_voltage_and_temp_tx(storage);
   } else if (s_msgs_txed < NUM_BATTERY_VT_MSGS + NUM_AGGREGATE_VC_MSGS) {
     prv_current_tx(storage);
-  } else if (s_msgs_txed <
-             NUM_BATTERY_VT_MSGS + NUM_AGGREGATE_VC_MSGS + NUM_BATTERY_RELAY_STATE_MSGS) {
+  } else if (s_msgs_txed < NUM_BATTERY_VT_MSGS + NUM_AGGREGATE_VC_MSGS + NUM_CURRENT_STATS_MSGS) {
+    prv_current_stats_tx(storage);
+  } else if (s_msgs_txed < NUM_BATTERY_VT_MSGS + NUM_AGGREGATE_VC_MSGS + NUM_CURRENT_STATS_MSGS +
+                               NUM_BATTERY_RELAY_STATE_MSGS) {
     prv_relay_state_tx(storage);
   } else if (s_msgs_txed < NUM_TOTAL_MESSAGES) {
     prv_fan_status_tx(storage);
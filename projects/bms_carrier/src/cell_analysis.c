@@ -0,0 +1,52 @@
+#include "cell_analysis.h"
+
+#include <string.h>
+
+StatusCode cell_analysis_run(const uint16_t *readings, uint16_t *copy, size_t len, uint16_t low,
+                             uint16_t high, CellAnalysis *result) {
+  if (readings == NULL || result == NULL || len == 0 || len > LTC_AFE_MAX_CELLS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  uint16_t min = UINT16_MAX;
+  uint16_t max = 0;
+  uint32_t sum = 0;
+  memset(result, 0, sizeof(*result));
+
+  // A word of flags at a time, so each flag is a 32-bit shift even on the M0
+  for (size_t word = 0; word * CELL_ANALYSIS_BITMAP_BITS < len; word++) {
+    size_t first = word * CELL_ANALYSIS_BITMAP_BITS;
+    size_t count = len - first;
+    if (count > CELL_ANALYSIS_BITMAP_BITS) {
+      count = CELL_ANALYSIS_BITMAP_BITS;
+    }
+    uint32_t low_bits = 0;
+    uint32_t high_bits = 0;
+    for (size_t bit = 0; bit < count; bit++) {
+      uint16_t reading = readings[first + bit];
+      if (copy != NULL) {
+        copy[first + bit] = reading;
+      }
+      min = reading < min ? reading : min;
+      max = reading > max ? reading : max;
+      sum += reading;
+      low_bits |= (uint32_t)(reading < low) << bit;
+      high_bits |= (uint32_t)(reading > high) << bit;
+    }
+    result->low_bitmap[word] = low_bits;
+    result->high_bitmap[word] = high_bits;
+  }
+
+  result->min = min;
+  result->max = max;
+  result->sum = sum;
+  return STATUS_CODE_OK;
+}
+
+bool cell_analysis_has_fault(const CellAnalysis *result) {
+  uint32_t any = 0;
+  for (size_t word = 0; word < CELL_ANALYSIS_BITMAP_WORDS; word++) {
+    any |= result->low_bitmap[word] | result->high_bitmap[word];
+  }
+  return any != 0;
+}
@@ -4,7 +4,7 @@
 
 #include "bms.h"
 #include "bms_events.h"
-#include "critical_section.h"
+#include "cell_analysis.h"
 #include "current_sense.h"
 #include "exported_enums.h"
 #include "fault_bps.h"
@@ -15,26 +15,31 @@
 
 static CellSenseStorage s_storage = { 0 };
 
+// The bank of |banks| that isn't |published|
+static uint16_t *prv_back_bank(uint16_t *banks, size_t bank_len, const uint16_t *published) {
+  return published == banks ? banks + bank_len : banks;
+}
+
 static void prv_extract_cell_result(uint16_t *result_arr, size_t len, void *context) {
   ltc_afe_request_aux_conversion(s_storage.afe);
 
-  bool disabled = critical_section_start();
-  memcpy(s_storage.readings->voltages, result_arr, sizeof(s_storage.readings->voltages));
-  critical_section_end(disabled);
-
-  bool fault = false;
-  for (size_t i = 0; i < len; i++) {
-    // s_storage.total_voltage += s_storage.readings->voltages[i];
-    if (s_storage.readings->voltages[i] < s_storage.settings.undervoltage_dmv ||
-        s_storage.readings->voltages[i] > s_storage.settings.overvoltage_dmv) {
-      fault = true;
-    }
+  // Copy into the unpublished bank and analyze in the same pass, then publish
+  AfeReadings *readings = s_storage.readings;
+  uint16_t *voltages =
+      prv_back_bank(readings->voltage_banks[0], NUM_TOTAL_CELLS, readings->voltages);
+  CellAnalysis analysis = { 0 };
+  if (len > NUM_TOTAL_CELLS ||
+      !status_ok(cell_analysis_run(result_arr, voltages, len, s_storage.settings.undervoltage_dmv,
+                                   s_storage.settings.overvoltage_dmv, &analysis))) {
+    fault_bps_set(EE_BPS_STATE_FAULT_AFE_CELL);
+    return;
   }
+  readings->voltages = voltages;
 
   // Balance cells if needed
-  passive_balance(s_storage.readings->voltages, len, s_storage.afe);
+  passive_balance(voltages, len, analysis.min, s_storage.afe);
 
-  if (fault) {
+  if (cell_analysis_has_fault(&analysis)) {
     fault_bps_set(EE_BPS_STATE_FAULT_AFE_CELL);
   } else {
     fault_bps_clear(EE_BPS_STATE_FAULT_AFE_CELL);
@@ -44,21 +49,27 @@ static void prv_extract_cell_result(uint16_t *result_arr, size_t len, void *cont
 static void prv_extract_aux_result(uint16_t *result_arr, size_t len, void *context) {
   ltc_afe_request_cell_conversion(s_storage.afe);
 
-  bool disabled = critical_section_start();
-  memcpy(s_storage.readings->temps, result_arr, sizeof(s_storage.readings->temps));
-  critical_section_end(disabled);
-
   uint16_t threshold = s_storage.settings.discharge_overtemp_dmv;
   if (current_sense_is_charging()) threshold = s_storage.settings.charge_overtemp_dmv;
 
-  for (size_t i = 0; i < len; ++i) {
-    if (s_storage.readings->temps[i] > threshold) {
-      fault_bps_set(EE_BPS_STATE_FAULT_AFE_TEMP);
-      return;
-    }
+  AfeReadings *readings = s_storage.readings;
+  uint16_t *temps = prv_back_bank(readings->temp_banks[0], NUM_THERMISTORS, readings->temps);
+  CellAnalysis analysis = { 0 };
+  if (len > NUM_THERMISTORS ||
+      !status_ok(cell_analysis_run(result_arr, temps, len, 0, threshold, &analysis))) {
+    fault_bps_set(EE_BPS_STATE_FAULT_AFE_TEMP);
+    return;
   }
+  readings->temps = temps;
 
-  fault_bps_clear(EE_BPS_STATE_FAULT_AFE_TEMP);
+  // Stop balancing on hot devices
+  passive_balance_update_temps(temps, len, s_storage.afe);
+
+  if (cell_analysis_has_fault(&analysis)) {
+    fault_bps_set(EE_BPS_STATE_FAULT_AFE_TEMP);
+  } else {
+    fault_bps_clear(EE_BPS_STATE_FAULT_AFE_TEMP);
+  }
 }
 
 StatusCode cell_sense_init(const CellSenseSettings *settings, AfeReadings *afe_readings,
@@ -66,6 +77,8 @@ StatusCode cell_sense_init(const CellSenseSettings *settings, AfeReadings *afe_r
   s_storage.afe = afe;
   s_storage.readings = afe_readings;
   memset(afe_readings, 0, sizeof(AfeReadings));
+  afe_readings->voltages = afe_readings->voltage_banks[0];
+  afe_readings->temps = afe_readings->temp_banks[0];
   memcpy(&s_storage.settings, settings, sizeof(CellSenseSettings));
   ltc_afe_set_result_cbs(afe, prv_extract_cell_result, prv_extract_aux_result, NULL);
   return ltc_afe_request_cell_conversion(afe);
@@ -27,26 +27,78 @@ static void prv_ads_error_cb(Ads1259StatusCode code, void *context) {
 }
 
 // returns value in centiamps
-static int16_t prv_voltage_to_current(double reading) {
+static int16_t prv_voltage_to_current(int32_t reading_uv) {
   // current = voltage * 100, see confluence
-  return (int16_t)(100 * 100 * reading);
+  return (int16_t)(reading_uv / 100);
+}
+
+static uint16_t prv_isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = (uint32_t)1 << 30;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint16_t)root;
+}
+
+static void prv_start_peak_window(CurrentStorage *storage, uint32_t now_us) {
+  storage->peak_window_start_us = now_us;
+  storage->window_min = INT16_MAX;
+  storage->window_max = INT16_MIN;
+}
+
+// Replaces the oldest reading in the ring, adjusting the running sums instead of re-summing
+static void prv_update_ring(CurrentStorage *storage, int16_t current) {
+  int16_t oldest = storage->readings_ring[storage->ring_idx];
+  storage->readings_ring[storage->ring_idx] = current;
+  storage->ring_idx = (storage->ring_idx + 1) % NUM_STORED_CURRENT_READINGS;
+
+  storage->ring_sum += current - oldest;
+  storage->ring_sum_squares -= (uint32_t)(oldest * oldest);
+  storage->ring_sum_squares += (uint32_t)(current * current);
+  storage->average = storage->ring_sum / NUM_STORED_CURRENT_READINGS;
+}
+
+static void prv_update_peak_window(CurrentStorage *storage, int16_t current, uint32_t now_us) {
+  if (current < storage->window_min) {
+    storage->window_min = current;
+  }
+  if (current > storage->window_max) {
+    storage->window_max = current;
+  }
+
+  if (now_us - storage->peak_window_start_us >= storage->peak_window_ms * 1000) {
+    storage->stats.min = storage->window_min;
+    storage->stats.max = storage->window_max;
+    int32_t min_magnitude = -(int32_t)storage->window_min;
+    storage->stats.peak =
+        (uint16_t)(min_magnitude > storage->window_max ? min_magnitude : storage->window_max);
+    prv_start_peak_window(storage, now_us);
+  }
 }
 
 static void prv_periodic_ads_read(SoftTimerId id, void *context) {
-  double reading = s_ads1259_storage.reading;
-  int16_t val = prv_voltage_to_current(reading);
   CurrentStorage *storage = context;
-  storage->readings_ring[storage->ring_idx] = val;
-  storage->ring_idx = (storage->ring_idx + 1) % NUM_STORED_CURRENT_READINGS;
+  int16_t val = prv_voltage_to_current(s_ads1259_storage.reading_uv);
+  uint32_t now_us = soft_timer_now_us();
   ads1259_get_conversion_data(&s_ads1259_storage);
   soft_timer_start_millis(storage->conv_period_ms, prv_periodic_ads_read, context, NULL);
 
-  // update average
-  int32_t sum = 0;
-  for (uint16_t i = 0; i < NUM_STORED_CURRENT_READINGS; i++) {
-    sum += storage->readings_ring[i];
-  }
-  storage->average = sum / NUM_STORED_CURRENT_READINGS;
+  prv_update_ring(storage, val);
+  prv_update_peak_window(storage, val, now_us);
+
+  // coulomb counting - integrate the current over the time since the last reading
+  storage->charge_ca_us += (int64_t)val * (now_us - storage->last_reading_us);
+  storage->last_reading_us = now_us;
 
   // update s_is_charging
   // note that a negative value indicates the battery is charging
@@ -65,7 +117,10 @@ bool current_sense_is_charging() {
 }
 
 StatusCode current_sense_init(CurrentStorage *storage, SpiSettings *settings,
-                              uint32_t conv_period_ms) {
+                              uint32_t conv_period_ms, uint32_t capacity_mah) {
+  if (capacity_mah == 0) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
   memset(storage, 0, sizeof(CurrentStorage));
   const Ads1259Settings ads_settings = {
     .spi_port = CURRENT_SENSE_SPI_PORT,
@@ -78,8 +133,59 @@ StatusCode current_sense_init(CurrentStorage *storage, SpiSettings *settings,
     .error_context = NULL,
   };
   storage->conv_period_ms = conv_period_ms;
+  storage->peak_window_ms = CURRENT_SENSE_PEAK_WINDOW_MS;
+  // Assume a full pack until told otherwise
+  storage->capacity_mah = capacity_mah;
+  storage->initial_soc = CURRENT_SENSE_SOC_FULL;
+  storage->last_reading_us = soft_timer_now_us();
+  prv_start_peak_window(storage, storage->last_reading_us);
   status_ok_or_return(ads1259_init(&s_ads1259_storage, &ads_settings));
   ads1259_get_conversion_data(&s_ads1259_storage);
   soft_timer_start_millis(storage->conv_period_ms, prv_periodic_ads_read, storage, NULL);
   return STATUS_CODE_OK;
 }
+
+StatusCode current_sense_set_peak_window(CurrentStorage *storage, uint32_t window_ms) {
+  if (storage == NULL || window_ms == 0) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  storage->peak_window_ms = window_ms;
+  prv_start_peak_window(storage, soft_timer_now_us());
+  return STATUS_CODE_OK;
+}
+
+StatusCode current_sense_reset_charge(CurrentStorage *storage, uint32_t capacity_mah,
+                                      uint16_t state_of_charge) {
+  if (storage == NULL || capacity_mah == 0 || state_of_charge > CURRENT_SENSE_SOC_FULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  storage->capacity_mah = capacity_mah;
+  storage->initial_soc = state_of_charge;
+  storage->charge_ca_us = 0;
+  return STATUS_CODE_OK;
+}
+
+StatusCode current_sense_get_stats(CurrentStorage *storage, CurrentStats *stats) {
+  if (storage == NULL || stats == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  storage->stats.average = storage->average;
+  storage->stats.rms =
+      prv_isqrt((uint32_t)(storage->ring_sum_squares / NUM_STORED_CURRENT_READINGS));
+  storage->stats.charge_mah = (int32_t)(storage->charge_ca_us / CURRENT_SENSE_CA_US_PER_MAH);
+
+  // divide the per-mAh scale down first so the charge can't overflow
+  int64_t used_soc =
+      storage->charge_ca_us /
+      ((int64_t)storage->capacity_mah * (CURRENT_SENSE_CA_US_PER_MAH / CURRENT_SENSE_SOC_FULL));
+  int64_t soc = storage->initial_soc - used_soc;
+  if (soc < 0) {
+    soc = 0;
+  } else if (soc > CURRENT_SENSE_SOC_FULL) {
+    soc = CURRENT_SENSE_SOC_FULL;
+  }
+  storage->stats.state_of_charge = (uint16_t)soc;
+
+  *stats = storage->stats;
+  return STATUS_CODE_OK;
+}
@@ -5,9 +5,11 @@
 #include "can_msg_defs.h"
 #include "event_queue.h"
 #include "fault_bps.h"
+#include "gpio_it_deferred.h"
 #include "interrupt.h"
 #include "killswitch.h"
 #include "mcp23008_gpio_expander.h"
+#include "passive_balance.h"
 #include "soft_timer.h"
 #include "wait.h"
 
@@ -45,6 +47,9 @@ int main(void) {
   i2c_init(BMS_PERIPH_I2C_PORT, &i2c_settings);
 
   // initialize modules
+  // The centre console acks heartbeats - without any expected devices none would be sent
+  s_bms_storage.bps_storage.ack_devices =
+      CAN_ACK_EXPECTED_DEVICES(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE);
   bps_heartbeat_init(&s_bms_storage.bps_storage, BPS_HB_FREQ_MS);
   can_handler_init(&s_bms_storage, TIME_BETWEEN_TX_IN_MILLIS);
   LtcAfeSettings afe_settings = {
@@ -88,6 +93,12 @@ int main(void) {
     .discharge_overtemp_dmv = 0,
   };
   cell_sense_init(&cell_settings, &s_bms_storage.afe_readings, &s_bms_storage.ltc_afe_storage);
+  PassiveBalanceSettings balance_settings = {
+    .threshold = PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV,
+    .max_cells_per_device = PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE,
+    .overtemp_dmv = PASSIVE_BALANCE_OVERTEMP_DMV,
+  };
+  passive_balance_init(&balance_settings);
   SpiSettings spi_settings = {
     .baudrate = 6000000,
     .mosi = { .port = GPIO_PORT_B, 15 },
@@ -95,7 +106,8 @@ int main(void) {
     .sclk = { .port = GPIO_PORT_B, 13 },
     .cs = { .port = GPIO_PORT_B, 12 },
   };
-  current_sense_init(&s_bms_storage.current_storage, &spi_settings, CONVERSION_TIME_MS);
+  current_sense_init(&s_bms_storage.current_storage, &spi_settings, CONVERSION_TIME_MS,
+                     BMS_PACK_CAPACITY_MAH);
   FanControlSettings fan_settings = {
     .callback = NULL,
     .callback_context = NULL,
@@ -103,7 +115,9 @@ int main(void) {
     .i2c_write_addr = BMS_FAN_CTRL_1_I2C_ADDR,
     .i2c_read_addr = BMS_FAN_CTRL_1_I2C_ADDR,
   };
-  // We have two fan controllers
+  // We have two fan controllers, both driven by the AFE's thermistor readings
+  s_bms_storage.fan_storage_1.readings = &s_bms_storage.afe_readings;
+  s_bms_storage.fan_storage_2.readings = &s_bms_storage.afe_readings;
   fan_control_init(&fan_settings, &s_bms_storage.fan_storage_1);
   fan_settings.i2c_write_addr = BMS_FAN_CTRL_2_I2C_ADDR;
   fan_settings.i2c_read_addr = BMS_FAN_CTRL_2_I2C_ADDR;
@@ -119,6 +133,7 @@ int main(void) {
       can_process_event(&e);
       ltc_afe_process_event(&s_bms_storage.ltc_afe_storage, &e);
       cell_sense_process_event(&e);
+      gpio_it_deferred_process_event(&e);
     }
     wait();
   }
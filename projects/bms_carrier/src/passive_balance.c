@@ -1,25 +1,139 @@
 #include "passive_balance.h"
+
+#include <string.h>
+
 #include "log.h"
+#include "soft_timer.h"
+
+static PassiveBalanceStorage s_storage = {
+  .settings =
+      {
+          .threshold = PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV,
+          .max_cells_per_device = PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE,
+          .overtemp_dmv = PASSIVE_BALANCE_OVERTEMP_DMV,
+      },
+};
+static uint32_t s_last_balance_us = 0;
+static bool s_balanced = false;
+
+// Whether |cell| may discharge this cycle, ignoring the per-device limit
+static bool prv_is_eligible(PassiveBalanceStorage *storage, const uint16_t *voltages, size_t cell,
+                            uint16_t min_voltage, bool device_hot) {
+  if (device_hot) {
+    return false;
+  }
+
+  // Discharging cells keep going until they're within half the threshold
+  uint16_t threshold = storage->settings.threshold;
+  if (storage->discharge[cell]) {
+    if (storage->discharge_ms[cell] >= PASSIVE_BALANCE_MAX_DISCHARGE_MS) {
+      return false;
+    }
+    threshold /= 2;
+  }
+  return voltages[cell] - min_voltage >= threshold;
+}
 
-StatusCode passive_balance(uint16_t *result_arr, size_t len, LtcAfeStorage *afe) {
-  // Storage for max + min voltage values as well as the cell # with the max voltage.
-  uint16_t cell_voltage_max = 0;
-  uint16_t cell_voltage_min = 0;
-  uint16_t max_voltage_cell_num = 0;
-
-  cell_voltage_max = cell_voltage_min = result_arr[0];
-
-  // Iterate through all cells in storage, updating values.
-  for (uint8_t i = 0; i < len; i++) {
-    if (result_arr[i] > cell_voltage_max) {
-      cell_voltage_max = result_arr[i];
-      max_voltage_cell_num = i;
-    } else if (result_arr[i] < cell_voltage_min) {
-      cell_voltage_min = result_arr[i];
+StatusCode passive_balance_select(PassiveBalanceStorage *storage, const uint16_t *voltages,
+                                  size_t len, uint16_t min_voltage, size_t num_devices,
+                                  uint32_t elapsed_ms) {
+  if (storage == NULL || voltages == NULL || len == 0 || len > LTC_AFE_MAX_CELLS ||
+      num_devices == 0 || num_devices > LTC_AFE_MAX_DEVICES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  bool eligible[LTC_AFE_MAX_CELLS] = { 0 };
+  for (size_t cell = 0; cell < len; cell++) {
+    if (storage->discharge[cell]) {
+      storage->discharge_ms[cell] += elapsed_ms;
     }
   }
-  // Balance cell, pass in whether difference meets threshold.
-  return ltc_afe_toggle_cell_discharge(
-      afe, max_voltage_cell_num,
-      (cell_voltage_max - cell_voltage_min >= PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV));
+
+  // Each device discharges its highest eligible cells, up to its limit
+  bool selected[LTC_AFE_MAX_CELLS] = { 0 };
+  size_t cells_per_device = (len + num_devices - 1) / num_devices;
+  storage->num_discharging = 0;
+  for (size_t device = 0; device < num_devices; device++) {
+    size_t first = device * cells_per_device;
+    size_t end = first + cells_per_device < len ? first + cells_per_device : len;
+    for (size_t cell = first; cell < end; cell++) {
+      eligible[cell] =
+          prv_is_eligible(storage, voltages, cell, min_voltage, storage->device_hot[device]);
+    }
+
+    for (uint8_t i = 0; i < storage->settings.max_cells_per_device; i++) {
+      size_t highest = end;
+      for (size_t cell = first; cell < end; cell++) {
+        if (eligible[cell] && !selected[cell] &&
+            (highest == end || voltages[cell] > voltages[highest])) {
+          highest = cell;
+        }
+      }
+      if (highest == end) {
+        break;
+      }
+      selected[highest] = true;
+      storage->num_discharging++;
+    }
+  }
+
+  for (size_t cell = 0; cell < len; cell++) {
+    if (!selected[cell] || !storage->discharge[cell]) {
+      storage->discharge_ms[cell] = 0;
+    }
+    storage->discharge[cell] = selected[cell];
+  }
+
+  return STATUS_CODE_OK;
+}
+
+StatusCode passive_balance_init(const PassiveBalanceSettings *settings) {
+  if (settings == NULL || settings->max_cells_per_device == 0) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  memset(&s_storage, 0, sizeof(s_storage));
+  s_storage.settings = *settings;
+  s_balanced = false;
+  return STATUS_CODE_OK;
+}
+
+StatusCode passive_balance(const uint16_t *voltages, size_t len, uint16_t min_voltage,
+                           LtcAfeStorage *afe) {
+  // Carry the sub-millisecond remainder over to the next cycle
+  uint32_t now_us = soft_timer_now_us();
+  uint32_t elapsed_ms = s_balanced ? (now_us - s_last_balance_us) / 1000 : 0;
+  s_last_balance_us = s_balanced ? s_last_balance_us + elapsed_ms * 1000 : now_us;
+  s_balanced = true;
+
+  status_ok_or_return(passive_balance_select(&s_storage, voltages, len, min_voltage,
+                                             afe->settings.num_devices, elapsed_ms));
+  // All cells go to the AFE together, to be sent with the next config write
+  return ltc_afe_set_cell_discharge(afe, s_storage.discharge, len);
+}
+
+StatusCode passive_balance_update_temps(const uint16_t *temps, size_t len, LtcAfeStorage *afe) {
+  size_t num_devices = afe->settings.num_devices;
+  if (temps == NULL || num_devices == 0 || num_devices > LTC_AFE_MAX_DEVICES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  size_t temps_per_device = (len + num_devices - 1) / num_devices;
+  for (size_t device = 0; device < num_devices; device++) {
+    s_storage.device_hot[device] = false;
+    if (s_storage.settings.overtemp_dmv == 0) {
+      continue;
+    }
+    for (size_t i = device * temps_per_device; i < (device + 1) * temps_per_device && i < len;
+         i++) {
+      if (temps[i] > s_storage.settings.overtemp_dmv) {
+        s_storage.device_hot[device] = true;
+        break;
+      }
+    }
+  }
+  return STATUS_CODE_OK;
+}
+
+size_t passive_balance_num_discharging(void) {
+  return s_storage.num_discharging;
 }
@@ -1,12 +1,13 @@
 #include "relay_sequence.h"
 
 #include "bms.h"
+#include "bms_events.h"
 #include "can_transmit.h"
 #include "can_unpack.h"
 #include "exported_enums.h"
 #include "fault_bps.h"
 #include "gpio.h"
-#include "gpio_it.h"
+#include "gpio_it_deferred.h"
 #include "mcp23008_gpio_expander.h"
 
 static GpioAddress s_hv_relay_en = BMS_HV_RELAY_EN_PIN;
@@ -15,15 +16,25 @@ static GpioAddress s_io_expander_int = BMS_IO_EXPANDER_INT_PIN;
 static Mcp23008GpioAddress s_mcp23008_hv = BMS_IO_EXPANDER_HV_SENSE_ADDR;
 static Mcp23008GpioAddress s_mcp23008_gnd = BMS_IO_EXPANDER_GND_SENSE_ADDR;
 
+// Only cancels timers that are still running, since their IDs are reused once they fire
+static void prv_cancel_timers(RelayStorage *storage) {
+  if (storage->assertion_timer_id != SOFT_TIMER_INVALID_TIMER) {
+    soft_timer_cancel(storage->assertion_timer_id);
+    storage->assertion_timer_id = SOFT_TIMER_INVALID_TIMER;
+  }
+  if (storage->next_step_timer_id != SOFT_TIMER_INVALID_TIMER) {
+    soft_timer_cancel(storage->next_step_timer_id);
+    storage->next_step_timer_id = SOFT_TIMER_INVALID_TIMER;
+  }
+}
+
 void prv_relay_fault(RelayStorage *storage, bool internal) {
   // cancel timers
-  soft_timer_cancel(storage->assertion_timer_id);
-  soft_timer_cancel(storage->next_step_timer_id);
+  prv_cancel_timers(storage);
   // open relays
   relay_open_sequence(storage);
   // skip assertion, we're already faulted
-  soft_timer_cancel(storage->assertion_timer_id);
-  soft_timer_cancel(storage->next_step_timer_id);
+  prv_cancel_timers(storage);
   if (internal) {
     // fault bps
     fault_bps_set(EE_BPS_STATE_FAULT_RELAY);
@@ -33,6 +44,7 @@ void prv_relay_fault(RelayStorage *storage, bool internal) {
 
 void prv_assert_state(SoftTimerId timer_id, void *context) {
   RelayStorage *storage = context;
+  storage->assertion_timer_id = SOFT_TIMER_INVALID_TIMER;
   if (storage->hv_enabled != storage->hv_expected_state) {
     prv_relay_fault(storage, true);
   } else if (storage->gnd_enabled != storage->gnd_expected_state) {
@@ -40,6 +52,7 @@ void prv_assert_state(SoftTimerId timer_id, void *context) {
   }
 }
 
+// Runs from the main loop, since reading the expander blocks on I2C
 void prv_io_int_callback(const GpioAddress *address, void *context) {
   RelayStorage *storage = context;
   Mcp23008GpioState hv_state = NUM_MCP23008_GPIO_STATES;
@@ -72,7 +85,27 @@ StatusCode prv_power_on_rx(const CanMessage *msg, void *context, CanAckStatus *a
   return STATUS_CODE_OK;
 }
 
+// The centre console closes the battery relays with SET_RELAY_STATES during the main sequence
+StatusCode prv_set_relay_states_rx(const CanMessage *msg, void *context, CanAckStatus *ack) {
+  RelayStorage *storage = context;
+  uint16_t relay_mask = 0;
+  uint16_t relay_state = 0;
+  CAN_UNPACK_SET_RELAY_STATES(msg, &relay_mask, &relay_state);
+  if ((relay_mask & (1 << EE_RELAY_ID_BATTERY)) != 0) {
+    if ((relay_state & (1 << EE_RELAY_ID_BATTERY)) >> EE_RELAY_ID_BATTERY == EE_RELAY_STATE_CLOSE) {
+      relay_close_sequence(storage);
+    } else {
+      relay_open_sequence(storage);
+    }
+  }
+  *ack = CAN_ACK_STATUS_OK;
+  return STATUS_CODE_OK;
+}
+
 StatusCode relay_sequence_init(RelayStorage *storage) {
+  storage->assertion_timer_id = SOFT_TIMER_INVALID_TIMER;
+  storage->next_step_timer_id = SOFT_TIMER_INVALID_TIMER;
+
   // register interrupt on GPIO expander
   GpioSettings io_expander_pin_settings = {
     .state = GPIO_STATE_LOW,         //
@@ -86,8 +119,9 @@ StatusCode relay_sequence_init(RelayStorage *storage) {
   };
   gpio_init_pin(&s_io_expander_int, &io_expander_pin_settings);
   // from the data sheet, the MCP23008 interrupt is active-low by default
-  gpio_it_register_interrupt(&s_io_expander_int, &io_expander_int_settings, INTERRUPT_EDGE_FALLING,
-                             prv_io_int_callback, storage);
+  status_ok_or_return(gpio_it_deferred_register(&s_io_expander_int, &io_expander_int_settings,
+                                                INTERRUPT_EDGE_FALLING, BMS_RELAY_EVENT_IO_INT,
+                                                prv_io_int_callback, storage));
 
   // init appropriate pins
   GpioSettings relay_en_pin_settings = {
@@ -102,11 +136,13 @@ StatusCode relay_sequence_init(RelayStorage *storage) {
   // register callbacks
   can_register_rx_handler(SYSTEM_CAN_MESSAGE_POWER_OFF_SEQUENCE, prv_power_off_rx, storage);
   can_register_rx_handler(SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE, prv_power_on_rx, storage);
+  can_register_rx_handler(SYSTEM_CAN_MESSAGE_SET_RELAY_STATES, prv_set_relay_states_rx, storage);
   return STATUS_CODE_OK;
 }
 
 void prv_relay_open_done(SoftTimerId timer_id, void *context) {
   RelayStorage *storage = context;
+  storage->next_step_timer_id = SOFT_TIMER_INVALID_TIMER;
   CAN_TRANSMIT_BATTERY_RELAY_STATE(storage->hv_enabled, storage->gnd_enabled);
 }
 
@@ -123,11 +159,14 @@ StatusCode relay_open_sequence(RelayStorage *storage) {
 }
 
 void prv_relay_close_done(SoftTimerId timer_id, void *context) {
+  RelayStorage *storage = context;
+  storage->next_step_timer_id = SOFT_TIMER_INVALID_TIMER;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(NULL, EE_POWER_MAIN_SEQUENCE_CONFIRM_BATTERY_STATUS);
 }
 
 void prv_relay_close_hv(SoftTimerId timer_id, void *context) {
   RelayStorage *storage = context;
+  storage->next_step_timer_id = SOFT_TIMER_INVALID_TIMER;
   gpio_set_state(&s_hv_relay_en, GPIO_STATE_HIGH);
   storage->gnd_expected_state = true;
   storage->hv_expected_state = true;
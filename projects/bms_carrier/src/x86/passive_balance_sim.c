@@ -0,0 +1,74 @@
+#include "passive_balance_sim.h"
+
+#include <string.h>
+
+// 1 mAh = 3600000 mA ms
+#define MA_MS_PER_MAH 3600000ULL
+#define UV_PER_VOLTAGE_UNIT 100
+
+static uint16_t prv_spread(const uint16_t *voltages, size_t len, uint16_t *min_voltage) {
+  uint16_t min = voltages[0];
+  uint16_t max = voltages[0];
+  for (size_t cell = 1; cell < len; cell++) {
+    if (voltages[cell] < min) {
+      min = voltages[cell];
+    } else if (voltages[cell] > max) {
+      max = voltages[cell];
+    }
+  }
+  if (min_voltage != NULL) {
+    *min_voltage = min;
+  }
+  return max - min;
+}
+
+StatusCode passive_balance_simulate(const uint16_t *voltages, size_t len,
+                                    const PassiveBalanceSimSettings *settings,
+                                    PassiveBalanceSimResult *result) {
+  if (voltages == NULL || settings == NULL || result == NULL || len == 0 ||
+      len > LTC_AFE_MAX_CELLS || settings->cycle_ms == 0) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  PassiveBalanceStorage storage = { .settings = settings->balance };
+  uint16_t present[LTC_AFE_MAX_CELLS] = { 0 };
+  uint64_t removed_ma_ms[LTC_AFE_MAX_CELLS] = { 0 };
+  memcpy(present, voltages, len * sizeof(uint16_t));
+  memset(result, 0, sizeof(*result));
+
+  uint64_t max_time_ms = (uint64_t)settings->max_time_s * 1000;
+  uint64_t time_ms = 0;
+  while (true) {
+    uint16_t min_voltage = 0;
+    uint16_t spread = prv_spread(present, len, &min_voltage);
+    status_ok_or_return(passive_balance_select(&storage, present, len, min_voltage,
+                                               settings->num_devices,
+                                               time_ms == 0 ? 0 : settings->cycle_ms));
+    if (storage.num_discharging > result->max_discharging) {
+      result->max_discharging = storage.num_discharging;
+    }
+    if (storage.num_discharging == 0 && spread < settings->balance.threshold) {
+      result->balanced = true;
+      break;
+    }
+    if (time_ms >= max_time_ms) {
+      break;
+    }
+
+    // Bleed the selected cells until the next conversion
+    for (size_t cell = 0; cell < len; cell++) {
+      if (storage.discharge[cell]) {
+        removed_ma_ms[cell] += (uint64_t)settings->bleed_current_ma * settings->cycle_ms;
+        uint64_t drop_uv = removed_ma_ms[cell] * settings->uv_per_mah / MA_MS_PER_MAH;
+        uint64_t drop = drop_uv / UV_PER_VOLTAGE_UNIT;
+        present[cell] = drop >= voltages[cell] ? 0 : (uint16_t)(voltages[cell] - drop);
+      }
+    }
+    time_ms += settings->cycle_ms;
+    result->cycles++;
+  }
+
+  result->time_to_balance_s = (uint32_t)(time_ms / 1000);
+  result->final_spread = prv_spread(present, len, NULL);
+  return STATUS_CODE_OK;
+}
@@ -20,6 +20,7 @@
 #define TEST_AVG_CURRENT 6
 #define TEST_RELAY_STATE 1
 #define TEST_FAN_STATUS STATUS_CODE_INTERNAL_ERROR
+#define TEST_STATE_OF_CHARGE 5000
 
 static uint16_t s_can_msg_count;
 static uint16_t s_can_msg_voltage_values[NUM_TOTAL_CELLS];
@@ -40,6 +41,20 @@ static StatusCode prv_test_can_handler_current_tx_callback_handler(const CanMess
   return STATUS_CODE_OK;
 }
 
+static StatusCode prv_test_can_handler_current_stats_tx_callback_handler(const CanMessage *msg,
+                                                                         void *context,
+                                                                         CanAckStatus *ack_reply) {
+  TEST_ASSERT_EQUAL(SYSTEM_CAN_MESSAGE_CURRENT_STATS, msg->msg_id);
+  uint16_t state_of_charge = 0;
+  uint16_t rms = 0;
+  uint16_t min = 0;
+  uint16_t max = 0;
+  CAN_UNPACK_CURRENT_STATS(msg, &state_of_charge, &rms, &min, &max);
+  TEST_ASSERT_EQUAL(TEST_STATE_OF_CHARGE, state_of_charge);
+  s_can_msg_count++;
+  return STATUS_CODE_OK;
+}
+
 static StatusCode prv_test_can_handler_voltage_and_tx_callback_handler(const CanMessage *msg,
                                                                        void *context,
                                                                        CanAckStatus *ack_reply) {
@@ -86,6 +101,8 @@ static StatusCode prv_test_can_handler_fan_status_tx_callback_handler(const CanM
 
 static void prv_set_bms_storage(void) {
   s_bms_storage.current_storage.average = TEST_AVG_CURRENT;
+  current_sense_reset_charge(&s_bms_storage.current_storage, BMS_PACK_CAPACITY_MAH,
+                             TEST_STATE_OF_CHARGE);
   s_bms_storage.relay_storage.gnd_enabled = TEST_RELAY_STATE;
   s_bms_storage.relay_storage.hv_enabled = TEST_RELAY_STATE;
 
@@ -94,6 +111,8 @@ static void prv_set_bms_storage(void) {
     s_bms_storage.fan_storage_2.statuses[fan] = TEST_FAN_STATUS;
   }
 
+  s_bms_storage.afe_readings.voltages = s_bms_storage.afe_readings.voltage_banks[0];
+  s_bms_storage.afe_readings.temps = s_bms_storage.afe_readings.temp_banks[0];
   for (uint8_t cell = 0; cell < NUM_TOTAL_CELLS; cell++) {
     s_bms_storage.afe_readings.voltages[cell] = TEST_CELL_VOLTAGE;
   }
@@ -117,6 +136,9 @@ void setup_test(void) {
                                                  BMS_CAN_EVENT_FAULT));
   TEST_ASSERT_OK(can_register_rx_handler(SYSTEM_CAN_MESSAGE_BATTERY_AGGREGATE_VC,
                                          prv_test_can_handler_current_tx_callback_handler, NULL));
+  TEST_ASSERT_OK(can_register_rx_handler(SYSTEM_CAN_MESSAGE_CURRENT_STATS,
+                                         prv_test_can_handler_current_stats_tx_callback_handler,
+                                         NULL));
   TEST_ASSERT_OK(can_register_rx_handler(
       SYSTEM_CAN_MESSAGE_BATTERY_VT, prv_test_can_handler_voltage_and_tx_callback_handler, NULL));
   TEST_ASSERT_OK(can_register_rx_handler(SYSTEM_CAN_MESSAGE_BATTERY_RELAY_STATE,
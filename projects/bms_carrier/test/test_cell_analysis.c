@@ -0,0 +1,156 @@
+#include "cell_analysis.h"
+
+#include <string.h>
+
+#include "interrupt.h"
+#include "log.h"
+#include "soft_timer.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TEST_LOW 25000
+#define TEST_HIGH 42000
+#define TEST_BENCHMARK_RUNS 2000
+
+static uint16_t s_readings[LTC_AFE_MAX_CELLS];
+static uint16_t s_copy[LTC_AFE_MAX_CELLS];
+
+// A spread of readings with a few out of range
+static void prv_fill_readings(void) {
+  for (size_t i = 0; i < LTC_AFE_MAX_CELLS; i++) {
+    s_readings[i] = 36000 + (uint16_t)((i * 7919) % 4000);
+  }
+  s_readings[3] = TEST_LOW - 1;
+  s_readings[40] = TEST_HIGH + 1;
+  s_readings[LTC_AFE_MAX_CELLS - 1] = TEST_LOW - 100;
+}
+
+// The separate copy and scans cell sense used before, kept as a reference
+static bool prv_reference(const uint16_t *readings, uint16_t *copy, size_t len, uint16_t *min,
+                          uint16_t *max, uint32_t *sum) {
+  memcpy(copy, readings, len * sizeof(readings[0]));
+
+  bool fault = false;
+  for (size_t i = 0; i < len; i++) {
+    if (copy[i] < TEST_LOW || copy[i] > TEST_HIGH) {
+      fault = true;
+    }
+  }
+
+  *min = UINT16_MAX;
+  *max = 0;
+  *sum = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (copy[i] < *min) {
+      *min = copy[i];
+    }
+    if (copy[i] > *max) {
+      *max = copy[i];
+    }
+    *sum += copy[i];
+  }
+  return fault;
+}
+
+static bool prv_flagged(const uint32_t *bitmap, size_t index) {
+  return (bitmap[index / CELL_ANALYSIS_BITMAP_BITS] >> (index % CELL_ANALYSIS_BITMAP_BITS)) & 1;
+}
+
+void setup_test(void) {
+  interrupt_init();
+  soft_timer_init();
+  prv_fill_readings();
+  memset(s_copy, 0, sizeof(s_copy));
+}
+
+void teardown_test(void) {}
+
+void test_cell_analysis_matches_reference(void) {
+  uint16_t copy[LTC_AFE_MAX_CELLS] = { 0 };
+  uint16_t min = 0;
+  uint16_t max = 0;
+  uint32_t sum = 0;
+  bool fault = prv_reference(s_readings, copy, LTC_AFE_MAX_CELLS, &min, &max, &sum);
+
+  CellAnalysis analysis = { 0 };
+  TEST_ASSERT_OK(
+      cell_analysis_run(s_readings, s_copy, LTC_AFE_MAX_CELLS, TEST_LOW, TEST_HIGH, &analysis));
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(copy, s_copy, LTC_AFE_MAX_CELLS);
+  TEST_ASSERT_EQUAL(min, analysis.min);
+  TEST_ASSERT_EQUAL(max, analysis.max);
+  TEST_ASSERT_EQUAL(sum, analysis.sum);
+  TEST_ASSERT_EQUAL(fault, cell_analysis_has_fault(&analysis));
+}
+
+void test_cell_analysis_bitmaps(void) {
+  CellAnalysis analysis = { 0 };
+  TEST_ASSERT_OK(
+      cell_analysis_run(s_readings, NULL, LTC_AFE_MAX_CELLS, TEST_LOW, TEST_HIGH, &analysis));
+
+  // Flags land in the right word, including the last partial one
+  for (size_t i = 0; i < LTC_AFE_MAX_CELLS; i++) {
+    TEST_ASSERT_EQUAL(i == 3 || i == LTC_AFE_MAX_CELLS - 1, prv_flagged(analysis.low_bitmap, i));
+    TEST_ASSERT_EQUAL(i == 40, prv_flagged(analysis.high_bitmap, i));
+  }
+
+  // Readings on the limits aren't faults
+  s_readings[3] = TEST_LOW;
+  s_readings[40] = TEST_HIGH;
+  s_readings[LTC_AFE_MAX_CELLS - 1] = TEST_LOW;
+  TEST_ASSERT_OK(
+      cell_analysis_run(s_readings, NULL, LTC_AFE_MAX_CELLS, TEST_LOW, TEST_HIGH, &analysis));
+  TEST_ASSERT_FALSE(cell_analysis_has_fault(&analysis));
+}
+
+void test_cell_analysis_partial(void) {
+  // Only the first |len| readings are copied and analyzed
+  CellAnalysis analysis = { 0 };
+  TEST_ASSERT_OK(cell_analysis_run(s_readings, s_copy, 3, TEST_LOW, TEST_HIGH, &analysis));
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(s_readings, s_copy, 3);
+  TEST_ASSERT_EQUAL(0, s_copy[3]);
+  TEST_ASSERT_FALSE(cell_analysis_has_fault(&analysis));
+  TEST_ASSERT_EQUAL((uint32_t)s_readings[0] + s_readings[1] + s_readings[2], analysis.sum);
+}
+
+void test_cell_analysis_invalid_args(void) {
+  CellAnalysis analysis = { 0 };
+  TEST_ASSERT_NOT_OK(cell_analysis_run(NULL, s_copy, 1, TEST_LOW, TEST_HIGH, &analysis));
+  TEST_ASSERT_NOT_OK(cell_analysis_run(s_readings, s_copy, 1, TEST_LOW, TEST_HIGH, NULL));
+  TEST_ASSERT_NOT_OK(cell_analysis_run(s_readings, s_copy, 0, TEST_LOW, TEST_HIGH, &analysis));
+  TEST_ASSERT_NOT_OK(cell_analysis_run(s_readings, s_copy, LTC_AFE_MAX_CELLS + 1, TEST_LOW,
+                                       TEST_HIGH, &analysis));
+}
+
+// Times the kernel against the reference over a full set of cells. Timing on the host is only
+// indicative, so this just logs the results.
+void test_cell_analysis_benchmark(void) {
+  uint16_t min = 0;
+  uint16_t max = 0;
+  uint32_t sum = 0;
+  bool fault = false;
+  uint32_t start_us = soft_timer_now_us();
+  for (size_t run = 0; run < TEST_BENCHMARK_RUNS; run++) {
+    s_readings[run % LTC_AFE_MAX_CELLS]++;
+    fault |= prv_reference(s_readings, s_copy, LTC_AFE_MAX_CELLS, &min, &max, &sum);
+  }
+  uint32_t reference_us = soft_timer_now_us() - start_us;
+
+  prv_fill_readings();
+  CellAnalysis analysis = { 0 };
+  bool kernel_fault = false;
+  start_us = soft_timer_now_us();
+  for (size_t run = 0; run < TEST_BENCHMARK_RUNS; run++) {
+    s_readings[run % LTC_AFE_MAX_CELLS]++;
+    TEST_ASSERT_OK(
+        cell_analysis_run(s_readings, s_copy, LTC_AFE_MAX_CELLS, TEST_LOW, TEST_HIGH, &analysis));
+    kernel_fault |= cell_analysis_has_fault(&analysis);
+  }
+  uint32_t kernel_us = soft_timer_now_us() - start_us;
+
+  LOG_DEBUG("%d cells x %d runs: reference %lu us, single pass %lu us\n", LTC_AFE_MAX_CELLS,
+            TEST_BENCHMARK_RUNS, (unsigned long)reference_us, (unsigned long)kernel_us);
+  TEST_ASSERT_EQUAL(fault, kernel_fault);
+  TEST_ASSERT_EQUAL(min, analysis.min);
+  TEST_ASSERT_EQUAL(max, analysis.max);
+  TEST_ASSERT_EQUAL(sum, analysis.sum);
+}
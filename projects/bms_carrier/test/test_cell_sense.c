@@ -22,10 +22,8 @@
 #define VOLTAGE_READING_MIN 42
 #define TEMP_READING_MAX 1337
 #define TEMP_READING_MIN 42
-static AfeReadings s_raw_readings = {
-  .voltages = { 42, 69, 420, 1337 },
-  .temps = { 42, 69, 420, 1337 },
-};
+static uint16_t s_raw_voltages[NUM_TOTAL_CELLS] = { 42, 69, 420, 1337 };
+static uint16_t s_raw_temps[NUM_THERMISTORS] = { 42, 69, 420, 1337 };
 static AfeReadings s_readings;
 
 static bool s_is_charging;
@@ -49,10 +47,10 @@ bool TEST_MOCK(ltc_afe_process_event)(LtcAfeStorage *afe, const Event *e) {
   uint16_t *result_arr;
   if (e->id == BMS_AFE_EVENT_TRIGGER_AUX_CONV) {
     cb = afe->settings.aux_result_cb;
-    result_arr = s_raw_readings.temps;
+    result_arr = s_raw_temps;
   } else if (e->id == BMS_AFE_EVENT_TRIGGER_CELL_CONV) {
     cb = afe->settings.cell_result_cb;
-    result_arr = s_raw_readings.voltages;
+    result_arr = s_raw_voltages;
   } else {
     return false;
   }
@@ -10,6 +10,7 @@
 #include "test_helpers.h"
 
 #define TEST_CS_CONV_DELAY 10
+#define TEST_CAPACITY_MAH 4
 
 static SpiSettings s_spi_settings = {
   .baudrate = 6000000,
@@ -23,7 +24,9 @@ static CurrentStorage s_storage;
 static uint8_t s_fault_bps_bitmask = 0;
 static bool s_fault_bps_clear = false;
 
-static double s_ads_read = 0.0;
+static int32_t s_ads_read_uv = 0;
+static int32_t s_ads_step_uv = 0;
+static bool s_ads_alternate = false;
 static Ads1259ErrorHandlerCb s_ads_cb = NULL;
 
 StatusCode TEST_MOCK(fault_bps_set)(uint8_t fault_bitmask) {
@@ -39,7 +42,11 @@ StatusCode TEST_MOCK(fault_bps_clear)(uint8_t fault_bitmask) {
 }
 
 StatusCode TEST_MOCK(ads1259_get_conversion_data)(Ads1259Storage *storage) {
-  storage->reading = s_ads_read;
+  storage->reading_uv = s_ads_read_uv;
+  s_ads_read_uv += s_ads_step_uv;
+  if (s_ads_alternate) {
+    s_ads_read_uv = -s_ads_read_uv;
+  }
   return STATUS_CODE_OK;
 }
 
@@ -55,21 +62,24 @@ void setup_test(void) {
   s_fault_bps_bitmask = 0;
   s_fault_bps_clear = false;
 
-  s_ads_read = 0.0;
+  s_ads_read_uv = 0;
+  s_ads_step_uv = 0;
+  s_ads_alternate = false;
   s_ads_cb = NULL;
 }
 
 void teardown_test(void) {}
 
 void test_is_charging(void) {
-  s_ads_read = 0.5;
-  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY));
+  s_ads_read_uv = 500000;
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
   delay_ms(TEST_CS_CONV_DELAY * NUM_STORED_CURRENT_READINGS);
   TEST_ASSERT_FALSE(current_sense_is_charging());
   TEST_ASSERT_EQUAL(EE_BPS_STATE_FAULT_CURRENT_SENSE, s_fault_bps_bitmask);
   TEST_ASSERT(s_fault_bps_clear);
 
-  s_ads_read = -0.5;
+  s_ads_read_uv = -500000;
   delay_ms(TEST_CS_CONV_DELAY * NUM_STORED_CURRENT_READINGS);
   TEST_ASSERT_TRUE(current_sense_is_charging());
   TEST_ASSERT_EQUAL(EE_BPS_STATE_FAULT_CURRENT_SENSE, s_fault_bps_bitmask);
@@ -77,27 +87,30 @@ void test_is_charging(void) {
 }
 
 void test_oc_discharging(void) {
-  s_ads_read = 1.5;
-  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY));
+  s_ads_read_uv = 1500000;
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
   delay_ms(TEST_CS_CONV_DELAY * NUM_STORED_CURRENT_READINGS);
   TEST_ASSERT_EQUAL(EE_BPS_STATE_FAULT_CURRENT_SENSE, s_fault_bps_bitmask);
   TEST_ASSERT_FALSE(s_fault_bps_clear);
 }
 
 void test_oc_charging(void) {
-  s_ads_read = -0.9;
+  s_ads_read_uv = -900000;
   s_fault_bps_clear = true;
-  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY));
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
   delay_ms(TEST_CS_CONV_DELAY * NUM_STORED_CURRENT_READINGS);
   TEST_ASSERT_EQUAL(EE_BPS_STATE_FAULT_CURRENT_SENSE, s_fault_bps_bitmask);
   TEST_ASSERT_FALSE(s_fault_bps_clear);
 }
 
 void test_ring_no_segfault(void) {
-  s_ads_read = 0.03;
-  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY));
+  s_ads_read_uv = 30000;
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
   delay_ms(TEST_CS_CONV_DELAY * 5);
-  s_ads_read = 0.01;
+  s_ads_read_uv = 10000;
   delay_ms(TEST_CS_CONV_DELAY * (NUM_STORED_CURRENT_READINGS + 3));  // would segfault if incorrect
   // assert it's the calculated value based on 0.01, not 0.03
   TEST_ASSERT_EQUAL(100, s_storage.average);
@@ -105,8 +118,82 @@ void test_ring_no_segfault(void) {
 
 void test_error_cb(void) {
   s_fault_bps_clear = true;
-  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY));
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
   s_ads_cb(ADS1259_STATUS_CODE_CHECKSUM_FAULT, NULL);
   TEST_ASSERT_EQUAL(EE_BPS_STATE_FAULT_CURRENT_SENSE, s_fault_bps_bitmask);
   TEST_ASSERT_FALSE(s_fault_bps_clear);
 }
+
+void test_running_average(void) {
+  // a ramp so every reading in the ring is different
+  s_ads_read_uv = -100000;
+  s_ads_step_uv = 1234;
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
+  delay_ms(TEST_CS_CONV_DELAY * (NUM_STORED_CURRENT_READINGS * 2 + 7));
+
+  int32_t sum = 0;
+  for (uint16_t i = 0; i < NUM_STORED_CURRENT_READINGS; i++) {
+    sum += s_storage.readings_ring[i];
+  }
+  TEST_ASSERT_EQUAL(sum, s_storage.ring_sum);
+  TEST_ASSERT_EQUAL(sum / NUM_STORED_CURRENT_READINGS, s_storage.average);
+}
+
+void test_rms_and_peak(void) {
+  // alternates between +10 A and -10 A
+  s_ads_read_uv = 100000;
+  s_ads_alternate = true;
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
+  TEST_ASSERT_OK(current_sense_set_peak_window(&s_storage, TEST_CS_CONV_DELAY * 5));
+  delay_ms(TEST_CS_CONV_DELAY * (NUM_STORED_CURRENT_READINGS + 5));
+
+  CurrentStats stats = { 0 };
+  TEST_ASSERT_OK(current_sense_get_stats(&s_storage, &stats));
+  TEST_ASSERT_INT_WITHIN(1000 / NUM_STORED_CURRENT_READINGS, 0, stats.average);
+  TEST_ASSERT_EQUAL(1000, stats.rms);
+  TEST_ASSERT_EQUAL(-1000, stats.min);
+  TEST_ASSERT_EQUAL(1000, stats.max);
+  TEST_ASSERT_EQUAL(1000, stats.peak);
+}
+
+void test_coulomb_counting(void) {
+  // 10 A discharging for 720 ms is 2 mAh, half of a 4 mAh pack
+  s_ads_read_uv = 100000;
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
+  delay_ms(720);
+
+  CurrentStats stats = { 0 };
+  TEST_ASSERT_OK(current_sense_get_stats(&s_storage, &stats));
+  TEST_ASSERT_INT_WITHIN(1, 2, stats.charge_mah);
+  TEST_ASSERT_INT_WITHIN(500, CURRENT_SENSE_SOC_FULL / 2, stats.state_of_charge);
+
+  // charging brings it back up, but never past full
+  s_ads_read_uv = -200000;
+  delay_ms(720);
+  TEST_ASSERT_OK(current_sense_get_stats(&s_storage, &stats));
+  TEST_ASSERT_TRUE(stats.charge_mah < 0);
+  TEST_ASSERT_EQUAL(CURRENT_SENSE_SOC_FULL, stats.state_of_charge);
+
+  // resetting to half of a 2 mAh pack, then 2 mAh more empties it
+  TEST_ASSERT_OK(current_sense_reset_charge(&s_storage, 2, CURRENT_SENSE_SOC_FULL / 2));
+  s_ads_read_uv = 100000;
+  delay_ms(720);
+  TEST_ASSERT_OK(current_sense_get_stats(&s_storage, &stats));
+  TEST_ASSERT_EQUAL(0, stats.state_of_charge);
+}
+
+void test_stats_invalid_args(void) {
+  CurrentStats stats = { 0 };
+  TEST_ASSERT_NOT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY, 0));
+  TEST_ASSERT_OK(current_sense_init(&s_storage, &s_spi_settings, TEST_CS_CONV_DELAY,
+                                    TEST_CAPACITY_MAH));
+  TEST_ASSERT_NOT_OK(current_sense_set_peak_window(&s_storage, 0));
+  TEST_ASSERT_NOT_OK(current_sense_reset_charge(&s_storage, 0, CURRENT_SENSE_SOC_FULL));
+  TEST_ASSERT_NOT_OK(current_sense_reset_charge(&s_storage, 4, CURRENT_SENSE_SOC_FULL + 1));
+  TEST_ASSERT_NOT_OK(current_sense_get_stats(NULL, &stats));
+  TEST_ASSERT_NOT_OK(current_sense_get_stats(&s_storage, NULL));
+}
@@ -63,6 +63,7 @@ void test_fan_control_init(void) {
   s_fan_storage.i2c_read_addr = I2C_WRITE_ADDR;
   s_fan_storage.i2c_write_addr = I2C_READ_ADDR;
 
+  s_readings.temps = s_readings.temp_banks[0];
   for (int i = 0; i < NUM_THERMISTORS; i++) {
     s_readings.temps[i] = VALID_TEMP;
   }
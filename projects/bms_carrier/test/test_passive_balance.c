@@ -1,19 +1,26 @@
 // Test sequence for passive balancing module
 #include "passive_balance.h"
 
+#include <string.h>
+
 #include "cell_sense.h"
 #include "ltc_afe.h"
 #include "ms_test_helpers.h"
 
 #include "log.h"
 
-static uint16_t s_cell_balanced = 0;
-static bool s_cell_discharge = false;
+#define TEST_NUM_DEVICES NUM_AFES
+// About room temperature
+#define TEST_COOL_DMV 15000
+
+static bool s_cell_discharge[NUM_TOTAL_CELLS];
+static uint16_t s_num_set_calls = 0;
 
-StatusCode TEST_MOCK(ltc_afe_toggle_cell_discharge)(LtcAfeStorage *afe, uint16_t cell,
-                                                    bool discharge) {
-  s_cell_balanced = cell;
-  s_cell_discharge = discharge;
+StatusCode TEST_MOCK(ltc_afe_set_cell_discharge)(LtcAfeStorage *afe, const bool *discharge,
+                                                 size_t num_cells) {
+  TEST_ASSERT_EQUAL(NUM_TOTAL_CELLS, num_cells);
+  memcpy(s_cell_discharge, discharge, sizeof(s_cell_discharge));
+  s_num_set_calls++;
   return STATUS_CODE_OK;
 }
 
@@ -22,70 +29,97 @@ static uint16_t s_test_voltages[NUM_TOTAL_CELLS];
 
 static LtcAfeStorage s_test_afe_storage;
 
+static const PassiveBalanceSettings s_settings = {
+  .threshold = PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV,
+  .max_cells_per_device = PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE,
+  .overtemp_dmv = PASSIVE_BALANCE_OVERTEMP_DMV,
+};
+
+static size_t prv_num_discharging(void) {
+  size_t count = 0;
+  for (uint8_t i = 0; i < NUM_TOTAL_CELLS; i++) {
+    count += s_cell_discharge[i];
+  }
+  return count;
+}
+
+static StatusCode prv_balance(void) {
+  uint16_t min_voltage = s_test_voltages[0];
+  for (uint8_t i = 1; i < NUM_TOTAL_CELLS; i++) {
+    if (s_test_voltages[i] < min_voltage) {
+      min_voltage = s_test_voltages[i];
+    }
+  }
+  return passive_balance(s_test_voltages, NUM_TOTAL_CELLS, min_voltage, &s_test_afe_storage);
+}
+
 // Set all voltages to 1010.  Indices 0-3 only used in most tests for simplicity
 void setup_test(void) {
   for (uint8_t i = 0; i < NUM_TOTAL_CELLS; i++) {
     s_test_voltages[i] = 1010;
   }
+  memset(s_cell_discharge, 0, sizeof(s_cell_discharge));
+  s_num_set_calls = 0;
+  s_test_afe_storage.settings.num_devices = TEST_NUM_DEVICES;
+  TEST_ASSERT_OK(passive_balance_init(&s_settings));
 }
 
 void teardown_test(void) {}
 
-// Balance a few values, ensure cell bitset is set properly.
+// Balance a few values, ensure every cell above the threshold is set in one call.
 void test_normal_operation(void) {
   LOG_DEBUG("Testing passive balancing normal operation\n");
-  // Stores cell and device that should be balanced
-  uint8_t balance_cell = 2;
 
-  // Only cell 2 should be balanced
+  // Cells 1 and 2 should be balanced
   s_test_voltages[0] = 1000;
   s_test_voltages[1] = 1025;
-  s_test_voltages[balance_cell] = 1030;
+  s_test_voltages[2] = 1030;
   s_test_voltages[3] = 1010;
 
   // Verify
-  passive_balance(s_test_voltages, NUM_TOTAL_CELLS, &s_test_afe_storage);
-  TEST_ASSERT_EQUAL(s_cell_balanced, balance_cell);
-  TEST_ASSERT_EQUAL(s_cell_discharge, true);
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_EQUAL(1, s_num_set_calls);
+  TEST_ASSERT_FALSE(s_cell_discharge[0]);
+  TEST_ASSERT_TRUE(s_cell_discharge[1]);
+  TEST_ASSERT_TRUE(s_cell_discharge[2]);
+  TEST_ASSERT_FALSE(s_cell_discharge[3]);
+  TEST_ASSERT_EQUAL(2, prv_num_discharging());
+  TEST_ASSERT_EQUAL(2, passive_balance_num_discharging());
 }
 
 // First cell in range
 void test_balance_first_cell(void) {
   LOG_DEBUG("Testing balancing first cell in range\n");
   uint8_t balance_cell = 0;
-  s_cell_balanced = 1;
-  s_cell_discharge = false;
 
   // Only cell 0 should be balanced
   s_test_voltages[balance_cell] = 1040;
-  s_test_voltages[1] = 1025;
+  s_test_voltages[1] = 1015;
   s_test_voltages[2] = 1010;
   s_test_voltages[3] = 1010;
 
   // Verify
-  passive_balance(s_test_voltages, NUM_TOTAL_CELLS, &s_test_afe_storage);
-  TEST_ASSERT_EQUAL(s_cell_balanced, balance_cell);
-  TEST_ASSERT_EQUAL(s_cell_discharge, true);
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_TRUE(s_cell_discharge[balance_cell]);
+  TEST_ASSERT_EQUAL(1, prv_num_discharging());
 }
 
 // Last cell in range
 void test_balance_last_cell(void) {
   LOG_DEBUG("Testing balancing last cell in range\n");
   uint8_t balance_cell = NUM_TOTAL_CELLS - 1;
-  s_cell_balanced = 0;
-  s_cell_discharge = false;
 
   // Only last cell should be balanced
   s_test_voltages[0] = 1000;
-  s_test_voltages[1] = 1025;
-  s_test_voltages[2] = 1030;
+  s_test_voltages[1] = 1015;
+  s_test_voltages[2] = 1020;
   s_test_voltages[3] = 1010;
   s_test_voltages[balance_cell] = 1040;
 
   // Verify
-  passive_balance(s_test_voltages, NUM_TOTAL_CELLS, &s_test_afe_storage);
-  TEST_ASSERT_EQUAL(s_cell_balanced, balance_cell);
-  TEST_ASSERT_EQUAL(s_cell_discharge, true);
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_TRUE(s_cell_discharge[balance_cell]);
+  TEST_ASSERT_EQUAL(1, prv_num_discharging());
 }
 
 // Test cell 2 at edge of PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV
@@ -93,28 +127,131 @@ void test_balance_range(void) {
   // Same general procedures as in tests above
   LOG_DEBUG("Testing balancing around edge of range\n");
 
-  uint8_t balance_cell = 0;
-  s_cell_discharge = false;
+  uint8_t balance_cell = 2;
 
   // No cell should be balanced
   s_test_voltages[0] = 1000;
   s_test_voltages[1] = 1024;
-  s_test_voltages[2] = 1000 + PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV - 1;
+  s_test_voltages[balance_cell] = 1000 + PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV - 1;
   s_test_voltages[3] = 1010;
 
   // Verify
-  passive_balance(s_test_voltages, NUM_TOTAL_CELLS, &s_test_afe_storage);
-  TEST_ASSERT_EQUAL(s_cell_discharge, false);
-
-  balance_cell = 2;
-  s_cell_balanced = 0;
-  s_cell_discharge = false;
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_EQUAL(0, prv_num_discharging());
 
   // Increment cell 2 voltage, should be balanced now
   s_test_voltages[balance_cell]++;
 
   // Verify
-  passive_balance(s_test_voltages, NUM_TOTAL_CELLS, &s_test_afe_storage);
-  TEST_ASSERT_EQUAL(s_cell_balanced, balance_cell);
-  TEST_ASSERT_EQUAL(s_cell_discharge, true);
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_TRUE(s_cell_discharge[balance_cell]);
+  TEST_ASSERT_EQUAL(1, prv_num_discharging());
+}
+
+// A discharging cell keeps going until it's within half the threshold
+void test_balance_hysteresis(void) {
+  s_test_voltages[0] = 1000;
+  s_test_voltages[1] = 1000 + PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV;
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_TRUE(s_cell_discharge[1]);
+
+  s_test_voltages[1] = 1000 + PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV / 2;
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_TRUE(s_cell_discharge[1]);
+
+  s_test_voltages[1]--;
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_FALSE(s_cell_discharge[1]);
+}
+
+// Each device discharges at most its limit, picking its highest cells
+void test_balance_device_limit(void) {
+  size_t cells_per_device = NUM_TOTAL_CELLS / TEST_NUM_DEVICES;
+  // Every cell on the first device is high, rising with the index
+  s_test_voltages[NUM_TOTAL_CELLS - 1] = 1000;
+  for (size_t cell = 0; cell < cells_per_device; cell++) {
+    s_test_voltages[cell] = 1100 + cell;
+  }
+
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_EQUAL(PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE, prv_num_discharging());
+  for (size_t cell = 0; cell < cells_per_device; cell++) {
+    TEST_ASSERT_EQUAL(cell >= cells_per_device - PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE,
+                      s_cell_discharge[cell]);
+  }
+}
+
+// Hot devices stop discharging, others carry on
+void test_balance_overtemp(void) {
+  size_t cells_per_device = NUM_TOTAL_CELLS / TEST_NUM_DEVICES;
+  uint16_t temps[NUM_THERMISTORS] = { 0 };
+  s_test_voltages[0] = 1000;
+  s_test_voltages[1] = 1050;
+  s_test_voltages[cells_per_device] = 1050;
+
+  // One of the first device's thermistors is hot
+  temps[1] = PASSIVE_BALANCE_OVERTEMP_DMV + 1;
+  TEST_ASSERT_OK(passive_balance_update_temps(temps, NUM_THERMISTORS, &s_test_afe_storage));
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_FALSE(s_cell_discharge[1]);
+  TEST_ASSERT_TRUE(s_cell_discharge[cells_per_device]);
+
+  temps[1] = PASSIVE_BALANCE_OVERTEMP_DMV;
+  TEST_ASSERT_OK(passive_balance_update_temps(temps, NUM_THERMISTORS, &s_test_afe_storage));
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_TRUE(s_cell_discharge[1]);
+}
+
+// Discharging cells stop as soon as their device heats up past the limit main sets up
+void test_balance_overtemp_stops_discharge(void) {
+  uint16_t temps[NUM_THERMISTORS] = { 0 };
+  for (size_t i = 0; i < NUM_THERMISTORS; i++) {
+    temps[i] = TEST_COOL_DMV;
+  }
+  s_test_voltages[0] = 1000;
+  s_test_voltages[1] = 1050;
+  TEST_ASSERT_OK(passive_balance_update_temps(temps, NUM_THERMISTORS, &s_test_afe_storage));
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_TRUE(s_cell_discharge[1]);
+
+  // The bleed resistors heat the first device's last thermistor
+  temps[NUM_THERMISTORS / TEST_NUM_DEVICES - 1] = PASSIVE_BALANCE_OVERTEMP_DMV + 1;
+  TEST_ASSERT_OK(passive_balance_update_temps(temps, NUM_THERMISTORS, &s_test_afe_storage));
+  TEST_ASSERT_OK(prv_balance());
+  TEST_ASSERT_EQUAL(0, prv_num_discharging());
+  TEST_ASSERT_EQUAL(0, passive_balance_num_discharging());
+}
+
+// Cells rest for a cycle once they've discharged for the AFE's discharge timeout
+void test_balance_discharge_timeout(void) {
+  PassiveBalanceStorage storage = { .settings = s_settings };
+  s_test_voltages[0] = 1000;
+  s_test_voltages[1] = 1050;
+
+  TEST_ASSERT_OK(passive_balance_select(&storage, s_test_voltages, NUM_TOTAL_CELLS, 1000,
+                                        TEST_NUM_DEVICES, 0));
+  TEST_ASSERT_TRUE(storage.discharge[1]);
+  TEST_ASSERT_OK(passive_balance_select(&storage, s_test_voltages, NUM_TOTAL_CELLS, 1000,
+                                        TEST_NUM_DEVICES, PASSIVE_BALANCE_MAX_DISCHARGE_MS - 1));
+  TEST_ASSERT_TRUE(storage.discharge[1]);
+  TEST_ASSERT_OK(passive_balance_select(&storage, s_test_voltages, NUM_TOTAL_CELLS, 1000,
+                                        TEST_NUM_DEVICES, 1));
+  TEST_ASSERT_FALSE(storage.discharge[1]);
+  TEST_ASSERT_OK(passive_balance_select(&storage, s_test_voltages, NUM_TOTAL_CELLS, 1000,
+                                        TEST_NUM_DEVICES, 1));
+  TEST_ASSERT_TRUE(storage.discharge[1]);
+  TEST_ASSERT_EQUAL(0, storage.discharge_ms[1]);
+}
+
+void test_balance_invalid_args(void) {
+  PassiveBalanceStorage storage = { .settings = s_settings };
+  PassiveBalanceSettings settings = s_settings;
+  settings.max_cells_per_device = 0;
+  TEST_ASSERT_NOT_OK(passive_balance_init(&settings));
+  TEST_ASSERT_NOT_OK(
+      passive_balance_select(&storage, s_test_voltages, 0, 1010, TEST_NUM_DEVICES, 0));
+  TEST_ASSERT_NOT_OK(
+      passive_balance_select(&storage, s_test_voltages, NUM_TOTAL_CELLS, 1010, 0, 0));
+  TEST_ASSERT_NOT_OK(passive_balance_select(&storage, s_test_voltages, LTC_AFE_MAX_CELLS + 1,
+                                            1010, TEST_NUM_DEVICES, 0));
 }
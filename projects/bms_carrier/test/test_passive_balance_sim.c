@@ -0,0 +1,81 @@
+#include "passive_balance_sim.h"
+
+#include "cell_sense.h"
+#include "log.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+// Roughly a 3 Ah cell over its usable range
+#define TEST_UV_PER_MAH 230
+#define TEST_BLEED_CURRENT_MA 100
+#define TEST_CYCLE_MS 1000
+#define TEST_MAX_TIME_S (48 * 60 * 60)
+
+static uint16_t s_voltages[NUM_TOTAL_CELLS];
+
+static PassiveBalanceSimSettings s_sim_settings;
+
+void setup_test(void) {
+  // A spread pack: cells 0 to 50 mV above the lowest
+  for (uint8_t cell = 0; cell < NUM_TOTAL_CELLS; cell++) {
+    s_voltages[cell] = 38000 + (cell * 500) / (NUM_TOTAL_CELLS - 1);
+  }
+
+  s_sim_settings = (PassiveBalanceSimSettings){
+    .balance =
+        {
+            .threshold = PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV,
+            .max_cells_per_device = PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE,
+        },
+    .num_devices = NUM_AFES,
+    .cycle_ms = TEST_CYCLE_MS,
+    .bleed_current_ma = TEST_BLEED_CURRENT_MA,
+    .uv_per_mah = TEST_UV_PER_MAH,
+    .max_time_s = TEST_MAX_TIME_S,
+  };
+}
+
+void teardown_test(void) {}
+
+void test_passive_balance_sim_balances(void) {
+  PassiveBalanceSimResult result = { 0 };
+  TEST_ASSERT_OK(passive_balance_simulate(s_voltages, NUM_TOTAL_CELLS, &s_sim_settings, &result));
+  TEST_ASSERT_TRUE(result.balanced);
+  TEST_ASSERT_TRUE(result.final_spread < PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV);
+  TEST_ASSERT_TRUE(result.max_discharging <= NUM_AFES * PASSIVE_BALANCE_MAX_CELLS_PER_DEVICE);
+
+  // The highest cell needs 50 mV less, so nothing can beat draining it non-stop
+  uint32_t lower_bound_s =
+      (uint32_t)((500 - PASSIVE_BALANCE_MIN_VOLTAGE_DIFF_MV) * 100ULL * 3600 /
+                 ((uint64_t)TEST_UV_PER_MAH * TEST_BLEED_CURRENT_MA));
+  TEST_ASSERT_TRUE(result.time_to_balance_s >= lower_bound_s);
+  LOG_DEBUG("Balanced %d cells in %lu s (at least %lu s), up to %d at once\n", NUM_TOTAL_CELLS,
+            (unsigned long)result.time_to_balance_s, (unsigned long)lower_bound_s,
+            (int)result.max_discharging);
+}
+
+void test_passive_balance_sim_faster_than_one_cell(void) {
+  PassiveBalanceSimResult multi = { 0 };
+  TEST_ASSERT_OK(passive_balance_simulate(s_voltages, NUM_TOTAL_CELLS, &s_sim_settings, &multi));
+
+  // The previous behaviour: only the single highest cell in the pack at a time
+  PassiveBalanceSimResult single = { 0 };
+  s_sim_settings.num_devices = 1;
+  s_sim_settings.balance.max_cells_per_device = 1;
+  TEST_ASSERT_OK(passive_balance_simulate(s_voltages, NUM_TOTAL_CELLS, &s_sim_settings, &single));
+
+  TEST_ASSERT_TRUE(multi.balanced);
+  TEST_ASSERT_TRUE(single.balanced);
+  LOG_DEBUG("Time to balance: %lu s one cell at a time, %lu s scheduled\n",
+            (unsigned long)single.time_to_balance_s, (unsigned long)multi.time_to_balance_s);
+  TEST_ASSERT_TRUE(multi.time_to_balance_s * 3 < single.time_to_balance_s);
+}
+
+void test_passive_balance_sim_gives_up(void) {
+  PassiveBalanceSimResult result = { 0 };
+  s_sim_settings.max_time_s = 60;
+  TEST_ASSERT_OK(passive_balance_simulate(s_voltages, NUM_TOTAL_CELLS, &s_sim_settings, &result));
+  TEST_ASSERT_FALSE(result.balanced);
+  TEST_ASSERT_EQUAL(60, result.time_to_balance_s);
+  TEST_ASSERT_NOT_OK(passive_balance_simulate(s_voltages, NUM_TOTAL_CELLS, NULL, &result));
+}
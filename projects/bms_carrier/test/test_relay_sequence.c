@@ -7,6 +7,7 @@
 #include "delay.h"
 #include "exported_enums.h"
 #include "gpio_it.h"
+#include "gpio_it_deferred.h"
 #include "interrupt.h"
 #include "mcp23008_gpio_expander.h"
 #include "ms_test_helpers.h"
@@ -67,6 +68,15 @@ void TEST_MOCK(fault_bps_clear)(uint8_t bitmask) {
 
 static RelayStorage s_storage = { 0 };
 
+// The expander is read from the main loop after the interrupt
+static void prv_trigger_io_int(void) {
+  TEST_ASSERT_OK(gpio_it_trigger_interrupt(&s_io_expander_int));
+  Event e = { 0 };
+  MS_TEST_HELPER_AWAIT_EVENT(e);
+  TEST_ASSERT_EQUAL(BMS_RELAY_EVENT_IO_INT, e.id);
+  TEST_ASSERT_TRUE(gpio_it_deferred_process_event(&e));
+}
+
 void setup_test(void) {
   s_23008_state_0 = NUM_MCP23008_GPIO_STATES;
   s_23008_state_1 = NUM_MCP23008_GPIO_STATES;
@@ -92,7 +102,7 @@ void test_io_int(void) {
   TEST_ASSERT_FALSE(s_storage.hv_enabled);
   s_23008_state_0 = MCP23008_GPIO_STATE_HIGH;
   s_23008_state_1 = MCP23008_GPIO_STATE_HIGH;
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   TEST_ASSERT_TRUE(s_storage.gnd_enabled);
   TEST_ASSERT_TRUE(s_storage.hv_enabled);
 }
@@ -112,7 +122,7 @@ void test_open_good(void) {
   s_23008_state_1 = MCP23008_GPIO_STATE_LOW;
   TEST_ASSERT_EQUAL(s_hv_state, GPIO_STATE_LOW);
   TEST_ASSERT_EQUAL(s_gnd_state, GPIO_STATE_LOW);
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   delay_ms(RELAY_SEQUENCE_ASSERTION_DELAY_MS + 5);
   // no faults should have occured
   TEST_ASSERT_EQUAL(0, s_fault_bps_calls);
@@ -139,7 +149,7 @@ void test_open_bad(void) {
   // set the state to what would happen in hardware in the bad case
   s_23008_state_0 = MCP23008_GPIO_STATE_HIGH;
   s_23008_state_1 = MCP23008_GPIO_STATE_LOW;
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   delay_ms(RELAY_SEQUENCE_ASSERTION_DELAY_MS + 5);
   // relay fault should have occured
   TEST_ASSERT_EQUAL(1, s_fault_bps_calls);
@@ -160,7 +170,7 @@ void test_close_good(void) {
   // set the state to what would happen in hardware in the good case
   s_23008_state_0 = MCP23008_GPIO_STATE_HIGH;
   s_23008_state_1 = MCP23008_GPIO_STATE_LOW;
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   // no faults should have occured
   TEST_ASSERT_EQUAL(0, s_fault_bps_calls);
   TEST_ASSERT_EQUAL(0, s_fault_bps_bitmask);
@@ -172,7 +182,7 @@ void test_close_good(void) {
   // set the state to what would happen in hardware in the good case
   s_23008_state_0 = MCP23008_GPIO_STATE_HIGH;
   s_23008_state_1 = MCP23008_GPIO_STATE_HIGH;
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   delay_ms(RELAY_SEQUENCE_ASSERTION_DELAY_MS + 5);
   // no faults should have occured
   TEST_ASSERT_EQUAL(0, s_fault_bps_calls);
@@ -198,7 +208,7 @@ void test_close_gnd_bad(void) {
   // set the state to what would happen in hardware in the bad case
   s_23008_state_0 = MCP23008_GPIO_STATE_LOW;
   s_23008_state_1 = MCP23008_GPIO_STATE_LOW;
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   delay_ms(RELAY_SEQUENCE_ASSERTION_DELAY_MS + 5);
   // fault should have occured
   TEST_ASSERT_EQUAL(1, s_fault_bps_calls);
@@ -216,12 +226,12 @@ void test_close_hv_bad(void) {
   // set the state to what would happen in hardware in the good case (gnd)
   s_23008_state_0 = MCP23008_GPIO_STATE_HIGH;
   s_23008_state_1 = MCP23008_GPIO_STATE_LOW;
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   delay_ms(RELAY_SEQUENCE_NEXT_STEP_DELAY_MS + 5);
   // set the state to what would happen in hardware in the bad case (hv)
   s_23008_state_0 = MCP23008_GPIO_STATE_HIGH;
   s_23008_state_1 = MCP23008_GPIO_STATE_LOW;
-  gpio_it_trigger_interrupt(&s_io_expander_int);
+  prv_trigger_io_int();
   delay_ms(RELAY_SEQUENCE_ASSERTION_DELAY_MS + 5);
   // fault should have occured
   TEST_ASSERT_EQUAL(1, s_fault_bps_calls);
@@ -246,3 +256,25 @@ void test_centre_console_rx(void) {
   delay_ms(RELAY_SEQUENCE_ASSERTION_DELAY_MS + 5);
   TEST_ASSERT_EQUAL(2, s_fault_bps_calls);
 }
+
+void test_set_relay_states_rx(void) {
+  TEST_ASSERT_OK(relay_sequence_init(&s_storage));
+  // closing the battery relay starts the close sequence
+  CAN_TRANSMIT_SET_RELAY_STATES(NULL, 1 << EE_RELAY_ID_BATTERY,
+                                EE_RELAY_STATE_CLOSE << EE_RELAY_ID_BATTERY);
+  MS_TEST_HELPER_CAN_TX_RX_WITH_ACK(BMS_CAN_EVENT_TX, BMS_CAN_EVENT_RX);
+  TEST_ASSERT_EQUAL(GPIO_STATE_HIGH, s_gnd_state);
+  TEST_ASSERT_TRUE(s_storage.gnd_expected_state);
+  TEST_ASSERT_FALSE(s_storage.hv_expected_state);
+  // the battery relay isn't touched if it's masked out
+  s_storage.gnd_expected_state = false;
+  CAN_TRANSMIT_SET_RELAY_STATES(NULL, 0, EE_RELAY_STATE_CLOSE << EE_RELAY_ID_BATTERY);
+  MS_TEST_HELPER_CAN_TX_RX_WITH_ACK(BMS_CAN_EVENT_TX, BMS_CAN_EVENT_RX);
+  TEST_ASSERT_FALSE(s_storage.gnd_expected_state);
+  // opening it opens both relays
+  CAN_TRANSMIT_SET_RELAY_STATES(NULL, 1 << EE_RELAY_ID_BATTERY,
+                                EE_RELAY_STATE_OPEN << EE_RELAY_ID_BATTERY);
+  MS_TEST_HELPER_CAN_TX_RX_WITH_ACK(BMS_CAN_EVENT_TX, BMS_CAN_EVENT_RX);
+  TEST_ASSERT_EQUAL(GPIO_STATE_LOW, s_hv_state);
+  TEST_ASSERT_EQUAL(GPIO_STATE_LOW, s_gnd_state);
+}
@@ -35,7 +35,8 @@ StatusCode speed_monitor_init(WatchdogTimeout timeout) {
   s_storage = (SpeedMonitorStorage){ .timeout = timeout };
   status_ok_or_return(
       can_register_rx_handler(SYSTEM_CAN_MESSAGE_MOTOR_VELOCITY, prv_receive_velocity, NULL));
-  watchdog_start(&s_storage.watchdog_storage, timeout, prv_did_not_receive_speed_message, NULL);
+  status_ok_or_return(watchdog_start(&s_storage.watchdog_storage, timeout,
+                                     prv_did_not_receive_speed_message, NULL));
   return STATUS_CODE_OK;
 }
 
@@ -11,6 +11,7 @@
 #include "interrupt.h"
 #include "soft_timer.h"
 #include "stop_sequence.h"
+#include "wait.h"
 
 static CanStorage s_can_storage;
 static CanSettings s_can_settings = {
@@ -32,6 +33,7 @@ int main(void) {
   event_queue_init();
   can_init(&s_can_storage, &s_can_settings);
 
+  charger_controller_init();
   begin_sequence_init();
   battery_monitor_init();
   connection_sense_init();
@@ -43,6 +45,7 @@ int main(void) {
       begin_sequence_process_event(&e);
       stop_sequence_process_event(&e);
     }
+    wait();
   }
 
   return 0;
@@ -7,6 +7,7 @@
 #include "interrupt.h"
 #include "pedal_rx.h"
 #include "soft_timer.h"
+#include "wait.h"
 
 #include "cruise_rx.h"
 #include "drive_fsm.h"
@@ -89,9 +90,10 @@ int main(void) {
 
   Event e = { 0 };
   while (true) {
-    while (event_process(&e) != STATUS_CODE_OK) {
+    while (event_process(&e) == STATUS_CODE_OK) {
       can_process_event(&e);
     }
+    wait();
   }
 
   return 0;
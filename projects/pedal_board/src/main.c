@@ -15,6 +15,7 @@
 #include "status.h"
 #include "test_helpers.h"
 #include "unity.h"
+#include "wait.h"
 
 #define CAN_DEVICE_ID 0x1
 
@@ -64,8 +65,10 @@ int main() {
   LOG_DEBUG("Starting...\n");
   Event e = { 0 };
   while (true) {
-    event_process(&e);
-    can_process_event(&e);
+    while (event_process(&e) == STATUS_CODE_OK) {
+      can_process_event(&e);
+    }
+    wait();
   }
   return 0;
 }
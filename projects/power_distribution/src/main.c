@@ -21,6 +21,7 @@
 #include "publish_data.h"
 #include "publish_data_config.h"
 #include "rear_strobe_blinker.h"
+#include "wait.h"
 
 #define CURRENT_MEASUREMENT_INTERVAL_US 500000  // 0.5s between current measurements
 #define SIGNAL_BLINK_INTERVAL_US 500000         // 0.5s between blinks of the signal lights
@@ -178,6 +179,7 @@ int main(void) {
         rear_power_distribution_strobe_blinker_process_event(&e);
       }
     }
+    wait();
   }
 
   return 0;
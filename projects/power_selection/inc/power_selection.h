@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
+
+#include "event_queue.h"
 #include "status.h"
 
 #define TIMER_TIMEOUT_MS 1000
@@ -15,3 +18,6 @@
 #define temp_to_res(r) 33000.0 / (double)((r) / 1000.0) - 10000
 
 StatusCode aux_dcdc_monitor_init();
+
+// Checks and transmits the readings of each scan. Returns whether the event was for this module.
+bool aux_dcdc_monitor_process_event(const Event *e);
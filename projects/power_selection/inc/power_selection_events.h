@@ -4,8 +4,13 @@ typedef enum {
   POWER_SELECTION_CAN_EVENT_RX = 0,
   POWER_SELECTION_CAN_EVENT_TX,
   POWER_SELECTION_CAN_EVENT_FAULT,
+  POWER_SELECTION_CAN_EVENT_END,
 } PowerSelectionCanEvent;
 
+typedef enum {
+  POWER_SELECTION_ADC_EVENT_SCAN_DONE = POWER_SELECTION_CAN_EVENT_END + 1,
+} PowerSelectionAdcEvent;
+
 typedef enum {
   AUX_ADC_VOLT_CHANNEL = 0,
   AUX_ADC_TEMP_CHANNEL,
@@ -7,5 +7,3 @@
 
 # Specify the libraries you want to include
 $(T)_DEPS := ms-helper ms-common codegen-tooling
-
-$(T)_test_power_selection_MOCKS := adc_read_raw
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include "adc.h"
 #include "can.h"
 #include "event_queue.h"
 #include "gpio.h"
@@ -27,6 +28,7 @@ int main() {
   event_queue_init();
   interrupt_init();
   soft_timer_init();
+  adc_init(ADC_MODE_SCAN);
 
   can_init(&s_can_storage, &s_can_settings);
   aux_dcdc_monitor_init();
@@ -37,6 +39,7 @@ int main() {
     while (event_process(&e) != STATUS_CODE_OK) {
     }
     can_process_event(&e);
+    aux_dcdc_monitor_process_event(&e);
   }
 
   return 0;
@@ -3,6 +3,7 @@
 #include "can.h"
 #include "can_transmit.h"
 #include "can_unpack.h"
+#include "critical_section.h"
 #include "event_queue.h"
 #include "exported_enums.h"
 #include "gpio.h"
@@ -48,9 +49,15 @@ void smoke_test(uint16_t s_aux_volt, uint16_t s_aux_temp, double resistance, uin
   LOG_DEBUG("AUX Temp Data in C: %d\n", s_aux_tempC);
 }
 
-uint16_t prv_status_checker() {
-  adc_read_raw(aux_channels[AUX_ADC_VOLT_CHANNEL], &s_aux_volt);
-  adc_read_raw(aux_channels[AUX_ADC_TEMP_CHANNEL], &s_aux_temp);
+// Written by the ADC interrupt once each scan is done
+static AdcSnapshot s_scan_snapshot;
+
+// Both readings come from |snapshot|, or the previous ones are kept if it's NULL
+uint16_t prv_status_checker(const AdcSnapshot *snapshot) {
+  if (snapshot != NULL) {
+    s_aux_volt = snapshot->raw[aux_channels[AUX_ADC_VOLT_CHANNEL]];
+    s_aux_temp = snapshot->raw[aux_channels[AUX_ADC_TEMP_CHANNEL]];
+  }
 
   double resistance = temp_to_res(s_aux_temp);
 
@@ -84,16 +91,24 @@ uint16_t prv_status_checker() {
   return s_status;
 }
 
+// Runs in the ADC interrupt once each scan is done, so the readings are checked and sent from the
+// main loop
+static void prv_scan_callback(const AdcSnapshot *snapshot, void *context) {
+  s_scan_snapshot = *snapshot;
+  event_raise(POWER_SELECTION_ADC_EVENT_SCAN_DONE, 0);
+}
+
 static void prv_power_selection_callback(SoftTimerId timer_id, void *context) {
-  uint16_t status = prv_status_checker();
-  // SENDING AUX BATTERY DATA
-  CAN_TRANSMIT_AUX_BATTERY_STATUS(s_aux_volt - AUX_VOLT_DEFAULT, s_aux_temp - AUX_TEMP_DEFAULT,
-                                  status);
+  // If the last scan is somehow still running, its results are sent when it's done instead
+  adc_scan_start();
   soft_timer_start_millis(TIMER_TIMEOUT_MS, prv_power_selection_callback, context, NULL);
 }
 
 static StatusCode prv_rx_callback(const CanMessage *msg, void *context, CanAckStatus *ack_reply) {
-  uint16_t status = prv_status_checker();
+  // Checks the latest scan
+  AdcSnapshot snapshot = { 0 };
+  uint16_t status =
+      prv_status_checker(status_ok(adc_get_snapshot(&snapshot)) ? &snapshot : NULL);
   uint16_t sequence = 0;
   CAN_UNPACK_POWER_ON_MAIN_SEQUENCE(msg, &sequence);
 
@@ -122,6 +137,7 @@ StatusCode aux_dcdc_monitor_init() {
     adc_get_channel(s_aux_status_addresses[i], &aux_channels[i]);
     adc_set_channel(aux_channels[i], true);
   }
+  adc_register_sequence_callback(prv_scan_callback, NULL);
 
   status_ok_or_return(
       can_register_rx_handler(SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE, prv_rx_callback, NULL));
@@ -130,3 +146,19 @@ StatusCode aux_dcdc_monitor_init() {
       soft_timer_start_millis(TIMER_TIMEOUT_MS, prv_power_selection_callback, NULL, NULL));
   return STATUS_CODE_OK;
 }
+
+bool aux_dcdc_monitor_process_event(const Event *e) {
+  if (e->id != POWER_SELECTION_ADC_EVENT_SCAN_DONE) {
+    return false;
+  }
+
+  bool disabled = critical_section_start();
+  AdcSnapshot snapshot = s_scan_snapshot;
+  critical_section_end(disabled);
+
+  uint16_t status = prv_status_checker(&snapshot);
+  // SENDING AUX BATTERY DATA
+  CAN_TRANSMIT_AUX_BATTERY_STATUS(s_aux_volt - AUX_VOLT_DEFAULT, s_aux_temp - AUX_TEMP_DEFAULT,
+                                  status);
+  return true;
+}
@@ -16,6 +16,7 @@
 #include "resistance_to_temp.h"
 #include "soft_timer.h"
 #include "test_helpers.h"
+#include "x86_adc.h"
 
 #define TEST_CAN_DEVICE_ID 0x1
 #undef TIMER_TIMEOUT_MS
@@ -45,13 +46,13 @@ static AdcChannel s_aux_channels[AUX_ADC_CURRENT_CHANNEL] = {
 
 static uint16_t s_aux_volt_value = 0;
 static uint16_t s_aux_temp_value = 0;
-StatusCode TEST_MOCK(adc_read_raw)(AdcChannel adc_channel, uint16_t *reading) {
-  if (adc_channel == s_aux_channels[AUX_ADC_VOLT_CHANNEL]) {
-    *reading = s_aux_volt_value;
-  } else if (adc_channel == s_aux_channels[AUX_ADC_TEMP_CHANNEL]) {
-    *reading = s_aux_temp_value;
-  }
-  return STATUS_CODE_OK;
+
+// The ADC converts these from the next sequence on
+static void prv_set_readings(uint16_t aux_volt_value, uint16_t aux_temp_value) {
+  s_aux_volt_value = aux_volt_value;
+  s_aux_temp_value = aux_temp_value;
+  x86_adc_set_reading(s_aux_channels[AUX_ADC_VOLT_CHANNEL], s_aux_volt_value);
+  x86_adc_set_reading(s_aux_channels[AUX_ADC_TEMP_CHANNEL], s_aux_temp_value);
 }
 
 int counter = 0;
@@ -77,11 +78,23 @@ static StatusCode prv_can_simple_ack(CanMessageId msg_id, uint16_t device, CanAc
   return STATUS_CODE_OK;
 }
 
+// Checks the next scan in the main loop, which sends its readings
+static void prv_process_scan(void) {
+  Event e = { 0 };
+  MS_TEST_HELPER_AWAIT_EVENT(e);
+  TEST_ASSERT_EQUAL(POWER_SELECTION_ADC_EVENT_SCAN_DONE, e.id);
+  TEST_ASSERT_TRUE(aux_dcdc_monitor_process_event(&e));
+  MS_TEST_HELPER_CAN_TX_RX(POWER_SELECTION_CAN_EVENT_TX, POWER_SELECTION_CAN_EVENT_RX);
+}
+
 void setup_test(void) {
   gpio_init();
   interrupt_init();
   soft_timer_init();
   event_queue_init();
+  adc_init(ADC_MODE_SCAN);
+  prv_set_readings(0, 0);
+  counter = 0;
 
   can_init(&s_can_storage, &s_can_settings);
   can_register_rx_handler(SYSTEM_CAN_MESSAGE_AUX_BATTERY_STATUS,
@@ -94,43 +107,52 @@ void setup_test(void) {
 
 void teardown_test(void) {}
 
+void test_power_selection_scan_in_main_loop(void) {
+  // Nothing is sent until the main loop processes the scan
+  Event e = { 0 };
+  MS_TEST_HELPER_AWAIT_EVENT(e);
+  TEST_ASSERT_EQUAL(POWER_SELECTION_ADC_EVENT_SCAN_DONE, e.id);
+  TEST_ASSERT_NOT_OK(event_process(&e));
+  TEST_ASSERT_EQUAL(0, counter);
+
+  // Other events aren't for it
+  e.id = POWER_SELECTION_CAN_EVENT_RX;
+  TEST_ASSERT_FALSE(aux_dcdc_monitor_process_event(&e));
+}
+
 void test_power_selection_tx(void) {
   // should transmit immediately
-  MS_TEST_HELPER_CAN_TX_RX(POWER_SELECTION_CAN_EVENT_TX, POWER_SELECTION_CAN_EVENT_RX);
+  prv_process_scan();
   TEST_ASSERT_EQUAL(counter, 1);
-  s_aux_volt_value = 10;
-  s_aux_temp_value = 520;
+  prv_set_readings(10, 520);
   double resistance = 0;
 
   delay_ms(10);
-  MS_TEST_HELPER_CAN_TX_RX(POWER_SELECTION_CAN_EVENT_TX, POWER_SELECTION_CAN_EVENT_RX);
+  prv_process_scan();
   TEST_ASSERT_EQUAL(counter, 2);
   TEST_ASSERT_EQUAL(aux_volt, (uint16_t)(s_aux_volt_value - AUX_VOLT_DEFAULT));
   resistance = temp_to_res(s_aux_temp_value);
   s_aux_temp_value = resistance_to_temp(resistance);
   TEST_ASSERT_EQUAL(aux_temp, (uint16_t)(s_aux_temp_value - AUX_TEMP_DEFAULT));
-  s_aux_volt_value = 16;
-  s_aux_temp_value = 320;
+  prv_set_readings(16, 320);
 
   delay_ms(10);
-  MS_TEST_HELPER_CAN_TX_RX(POWER_SELECTION_CAN_EVENT_TX, POWER_SELECTION_CAN_EVENT_RX);
+  prv_process_scan();
   TEST_ASSERT_EQUAL(counter, 3);
   TEST_ASSERT_EQUAL(aux_volt, (uint16_t)(s_aux_volt_value - AUX_VOLT_DEFAULT));
   resistance = temp_to_res(s_aux_temp_value);
   s_aux_temp_value = resistance_to_temp(resistance);
   TEST_ASSERT_EQUAL(aux_temp, (uint16_t)(s_aux_temp_value - AUX_TEMP_DEFAULT));
-  s_aux_volt_value = 5;
-  s_aux_temp_value = 200;
+  prv_set_readings(5, 200);
 
   delay_ms(1);
   TEST_ASSERT_NOT_EQUAL(counter, 4);
   TEST_ASSERT_NOT_EQUAL(aux_volt, (uint16_t)(s_aux_volt_value - AUX_VOLT_DEFAULT));
   resistance = temp_to_res(s_aux_temp_value);
-  s_aux_temp_value = resistance_to_temp(resistance);
-  TEST_ASSERT_NOT_EQUAL(aux_temp, (uint16_t)(s_aux_temp_value - AUX_TEMP_DEFAULT));
+  TEST_ASSERT_NOT_EQUAL(aux_temp, (uint16_t)(resistance_to_temp(resistance) - AUX_TEMP_DEFAULT));
 
   delay_ms(9);
-  MS_TEST_HELPER_CAN_TX_RX(POWER_SELECTION_CAN_EVENT_TX, POWER_SELECTION_CAN_EVENT_RX);
+  prv_process_scan();
   TEST_ASSERT_EQUAL(counter, 4);
   TEST_ASSERT_EQUAL(aux_volt, (uint16_t)(s_aux_volt_value - AUX_VOLT_DEFAULT));
   resistance = temp_to_res(s_aux_temp_value);
@@ -141,7 +163,7 @@ void test_power_selection_tx(void) {
 void test_power_selection_rx(void) {
   CanAckRequest ack_req = { 0 };
   ack_req.callback = prv_can_simple_ack;
-  MS_TEST_HELPER_CAN_TX_RX(POWER_SELECTION_CAN_EVENT_TX, POWER_SELECTION_CAN_EVENT_RX);
+  prv_process_scan();
 
   // FOR DCDC CHECK
   gpio_set_state(&s_dcdc_address, GPIO_STATE_HIGH);
@@ -153,38 +175,31 @@ void test_power_selection_rx(void) {
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_DCDC);
 
   // FOR AUX CHECK
-  s_aux_volt_value = 5;
-  s_aux_temp_value = 492;  // UV and UT
+  prv_set_readings(5, 492);  // UV and UT
   supposed_to_fail = true;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_AUX_STATUS);
 
-  s_aux_volt_value = 20;
-  s_aux_temp_value = 2467;  // OV and OT
+  prv_set_readings(20, 2467);  // OV and OT
   supposed_to_fail = true;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_AUX_STATUS);
 
-  s_aux_volt_value = 11;
-  s_aux_temp_value = 492;  // Voltage is ok but UT
+  prv_set_readings(11, 492);  // Voltage is ok but UT
   supposed_to_fail = true;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_AUX_STATUS);
 
-  s_aux_volt_value = 12;
-  s_aux_temp_value = 2467;  // Voltage is ok but OT
+  prv_set_readings(12, 2467);  // Voltage is ok but OT
   supposed_to_fail = true;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_AUX_STATUS);
 
-  s_aux_volt_value = 25;
-  s_aux_temp_value = 62;  // OV but temperature is ok
+  prv_set_readings(25, 62);  // OV but temperature is ok
   supposed_to_fail = true;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_AUX_STATUS);
 
-  s_aux_volt_value = 3;
-  s_aux_temp_value = 82;  // UV but temperature is ok
+  prv_set_readings(3, 82);  // UV but temperature is ok
   supposed_to_fail = true;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_AUX_STATUS);
 
-  s_aux_volt_value = 12;
-  s_aux_temp_value = 75;  // everything ok
+  prv_set_readings(12, 75);  // everything ok
   supposed_to_fail = false;
   CAN_TRANSMIT_POWER_ON_MAIN_SEQUENCE(&ack_req, EE_POWER_MAIN_SEQUENCE_CONFIRM_AUX_STATUS);
 }
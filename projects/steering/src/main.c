@@ -11,16 +11,18 @@
 #include "steering_control_stalk.h"
 #include "steering_digital_input.h"
 #include "steering_events.h"
+#include "wait.h"
 #define TIMER_INTERVAL_MS 50
 static CanStorage s_can_storage;
 
 int main() {
-  adc_init(ADC_MODE_SINGLE);
   gpio_init();
   interrupt_init();
   event_queue_init();
   gpio_it_init();
   soft_timer_init();
+  // The periodic reader starts each scan, so reading the stalk never waits on the ADC
+  adc_init(ADC_MODE_SCAN);
   steering_digital_input_init();
   adc_periodic_reader_init(TIMER_INTERVAL_MS);
   control_stalk_init();
@@ -40,10 +42,11 @@ int main() {
   Event e = { 0 };
 
   while (true) {
-    while (event_process(&e)) {
+    while (event_process(&e) == STATUS_CODE_OK) {
       can_process_event(&e);
       steering_can_process_event(&e);
     }
+    wait();
   }
 
   return 0;
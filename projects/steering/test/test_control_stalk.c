@@ -42,12 +42,12 @@ StatusCode prv_test_signal_rx_cb_handler(const CanMessage *msg, void *context,
 }
 
 void setup_test(void) {
-  adc_init(ADC_MODE_SINGLE);
   gpio_init();
   interrupt_init();
   event_queue_init();
   gpio_it_init();
   soft_timer_init();
+  adc_init(ADC_MODE_SCAN);
   TEST_ASSERT_OK(steering_digital_input_init());
   TEST_ASSERT_OK(can_init(&s_can_storage, &can_settings));
   TEST_ASSERT_OK(adc_periodic_reader_init(TIMER_INTERVAL_MS));
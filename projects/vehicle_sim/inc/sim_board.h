@@ -0,0 +1,41 @@
+#pragma once
+// Boards linked into the simulator.
+//
+// Each board is its project and all its libraries linked into a single object with every symbol
+// made local except a few entry points, renamed to <board>_<symbol> (see rules.mk). Every board
+// therefore gets its own copy of ms-common and the rest, and they only interact through the sim
+// clock and CAN bus.
+#include <pthread.h>
+#include <stddef.h>
+
+#include "gpio.h"
+#include "status.h"
+
+// Declares the entry points exported from a board
+#define SIM_BOARD_DECLARE(board) \
+  int board##_main(void);        \
+  StatusCode board##_gpio_it_trigger_interrupt(const GpioAddress *address)
+
+#define SIM_BOARD(board)                                              \
+  {                                                                   \
+    .name = #board, .main = board##_main,                             \
+    .gpio_it_trigger_interrupt = board##_gpio_it_trigger_interrupt,   \
+  }
+
+typedef struct SimBoard {
+  const char *name;
+  int (*main)(void);
+  StatusCode (*gpio_it_trigger_interrupt)(const GpioAddress *address);
+} SimBoard;
+
+typedef struct SimBoardConfig {
+  const SimBoard *boards;
+  size_t num_boards;
+} SimBoardConfig;
+
+// Starts each board's main() on its own thread, one at a time, waiting for each to go idle before
+// starting the next. Boards run until the process exits.
+StatusCode sim_board_start_all(const SimBoardConfig *config);
+
+// Returns NULL if there is no board named |name|
+const SimBoard *sim_board_find(const SimBoardConfig *config, const char *name);
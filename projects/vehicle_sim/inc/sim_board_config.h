@@ -0,0 +1,6 @@
+#pragma once
+// Boards that make up the simulated car. Must match the boards built in rules.mk.
+
+#include "sim_board.h"
+
+extern const SimBoardConfig VEHICLE_SIM_BOARD_CONFIG;
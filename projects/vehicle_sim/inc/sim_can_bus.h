@@ -0,0 +1,59 @@
+#pragma once
+// In-memory CAN bus shared by the simulated boards.
+//
+// Frames take their real time on the bus in virtual time. Whenever the bus goes idle, the queued
+// frames arbitrate like they would on the wire: the lowest ID wins, and a standard frame beats an
+// extended frame with the same base ID. Each node sends its own frames in order. Callbacks run on
+// the thread running the sim clock.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim_clock.h"
+#include "status.h"
+
+#define SIM_CAN_BUS_MAX_NODES 16
+#define SIM_CAN_BUS_TX_QUEUE_LEN 32
+
+typedef struct SimCanFrame {
+  uint32_t id;
+  bool extended;
+  size_t dlc;
+  uint64_t data;
+} SimCanFrame;
+
+// Called with every frame another node sent, and with the node's own frames if |loopback| is set
+typedef void (*SimCanRxCallback)(const SimCanFrame *frame, void *context);
+// Called once a frame from the node has finished transmitting
+typedef void (*SimCanTxCallback)(void *context);
+
+typedef struct SimCanNode {
+  SimCanRxCallback rx_callback;
+  SimCanTxCallback tx_callback;
+  void *context;
+  bool loopback;
+  // Managed by the bus
+  SimCanFrame tx_queue[SIM_CAN_BUS_TX_QUEUE_LEN];
+  size_t tx_head;
+  size_t tx_len;
+} SimCanNode;
+
+typedef struct SimCanBusStats {
+  uint64_t frames;
+  // Virtual time spent transmitting
+  uint64_t busy_us;
+} SimCanBusStats;
+
+// Detaches all nodes. Should be called before the clock runs.
+void sim_can_bus_init(uint32_t bitrate);
+
+// The callbacks and |loopback| must be set. Attaching a node again resets its queue.
+StatusCode sim_can_bus_attach(SimCanNode *node);
+
+// Queues a frame, returning STATUS_CODE_RESOURCE_EXHAUSTED if the node's queue is full
+StatusCode sim_can_bus_transmit(SimCanNode *node, const SimCanFrame *frame);
+
+// Virtual time a frame occupies the bus for
+uint32_t sim_can_bus_frame_time_us(const SimCanFrame *frame);
+
+void sim_can_bus_get_stats(SimCanBusStats *stats);
@@ -0,0 +1,42 @@
+#pragma once
+// Virtual time for the simulated boards.
+//
+// Time only moves when every board is idle, i.e. all main threads are blocked in wait() and no
+// interrupts are pending (see x86_sim.h). It then jumps straight to the earliest scheduled event,
+// so an idle car covers hours of simulated time in a fraction of a second. Event callbacks run on
+// the thread calling sim_clock_run_until() and are how timers and the CAN bus reach the boards.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "status.h"
+
+#define SIM_CLOCK_MAX_EVENTS 64
+
+typedef void (*SimClockCallback)(void *context);
+
+// Owned by the caller and must stay valid while scheduled
+typedef struct SimClockEvent {
+  SimClockCallback callback;
+  void *context;
+  uint64_t deadline_us;
+  // Breaks ties between events with the same deadline so runs are repeatable
+  uint64_t sequence;
+  bool scheduled;
+} SimClockEvent;
+
+// Resets virtual time to 0 and drops all events
+void sim_clock_init(void);
+
+uint64_t sim_clock_now_us(void);
+
+// Schedules |event| at |deadline_us|, moving it if it was already scheduled. Deadlines in the past
+// run at the current time.
+StatusCode sim_clock_schedule(SimClockEvent *event, uint64_t deadline_us);
+
+// Returns whether |event| was scheduled
+bool sim_clock_cancel(SimClockEvent *event);
+
+// Runs events in order until virtual time reaches |end_us| or |*done| becomes true. |done| may be
+// NULL, and is checked every time the boards go idle.
+void sim_clock_run_until(uint64_t end_us, volatile bool *done);
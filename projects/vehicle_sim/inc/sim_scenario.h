@@ -0,0 +1,80 @@
+#pragma once
+// Scripted scenarios for the simulated car.
+//
+// A scenario is a list of steps run from the harness: pressing buttons wired to a board's GPIO
+// interrupts, sending CAN messages from a harness node on the bus, and waiting for the boards to
+// respond. All scenarios share the same car, so each one starts where the previous one left off.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "can_msg.h"
+#include "gpio.h"
+#include "sim_board.h"
+#include "status.h"
+
+// Matches messages from any board in SIM_STEP_EXPECT_CAN
+#define SIM_SCENARIO_ANY_SOURCE CAN_MSG_INVALID_DEVICE
+
+typedef enum {
+  SIM_STEP_RUN = 0,
+  SIM_STEP_PRESS,
+  SIM_STEP_SEND_CAN,
+  SIM_STEP_EXPECT_CAN,
+  NUM_SIM_STEP_TYPES,
+} SimStepType;
+
+typedef struct SimStep {
+  SimStepType type;
+  // SIM_STEP_PRESS: triggers the GPIO interrupt on |address| of |board|
+  const char *board;
+  GpioAddress address;
+  // SIM_STEP_SEND_CAN: sent from the harness node as is
+  // SIM_STEP_EXPECT_CAN: matches the message ID, type and source - data is ignored
+  CanMessage msg;
+  // SIM_STEP_RUN: how long to run the car for
+  // SIM_STEP_EXPECT_CAN: how long to wait for the message
+  uint32_t duration_ms;
+} SimStep;
+
+#define SIM_STEP_RUN_MS(ms) \
+  { .type = SIM_STEP_RUN, .duration_ms = (ms) }
+
+#define SIM_STEP_PRESS_PIN(board_name, gpio_port, gpio_pin) \
+  { .type = SIM_STEP_PRESS, .board = (board_name), .address = { (gpio_port), (gpio_pin) } }
+
+#define SIM_STEP_SEND(source, id, u64)                                         \
+  {                                                                            \
+    .type = SIM_STEP_SEND_CAN,                                                 \
+    .msg = { .source_id = (source), .msg_id = (id), .type = CAN_MSG_TYPE_DATA, \
+             .data = (u64), .dlc = sizeof(uint64_t) },                         \
+  }
+
+#define SIM_STEP_EXPECT(source, id, msg_type, timeout_ms)                 \
+  {                                                                       \
+    .type = SIM_STEP_EXPECT_CAN,                                          \
+    .msg = { .source_id = (source), .msg_id = (id), .type = (msg_type) }, \
+    .duration_ms = (timeout_ms),                                          \
+  }
+
+typedef struct SimScenario {
+  const char *name;
+  const SimStep *steps;
+  size_t num_steps;
+} SimScenario;
+
+typedef struct SimScenarioConfig {
+  const SimScenario *scenarios;
+  size_t num_scenarios;
+} SimScenarioConfig;
+
+// Attaches the harness node to the bus, so it must be called after sim_can_bus_init(). If |trace|
+// is set, every frame on the bus is printed.
+StatusCode sim_scenario_init(const SimBoardConfig *boards, bool trace);
+
+// Runs the steps in order, printing how long the boards took to respond. Stops at the first step
+// that fails, returning STATUS_CODE_TIMEOUT if an expected message never showed up.
+StatusCode sim_scenario_run(const SimScenario *scenario);
+
+// Returns NULL if there is no scenario named |name|
+const SimScenario *sim_scenario_find(const SimScenarioConfig *config, const char *name);
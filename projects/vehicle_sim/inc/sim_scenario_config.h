@@ -0,0 +1,6 @@
+#pragma once
+// Scenarios the simulator can run, in the order they run by default.
+
+#include "sim_scenario.h"
+
+extern const SimScenarioConfig VEHICLE_SIM_SCENARIO_CONFIG;
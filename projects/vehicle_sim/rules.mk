@@ -0,0 +1,85 @@
+# Defines $(T)_SRC, $(T)_INC, $(T)_DEPS, and $(T)_CFLAGS for the build makefile.
+# Tests can be excluded by defining $(T)_EXCLUDE_TESTS.
+# Pre-defined:
+# $(T)_SRC_ROOT: $(T)_DIR/src
+# $(T)_INC_DIRS: $(T)_DIR/inc{/$(PLATFORM)}
+# $(T)_SRC: $(T)_DIR/src{/$(PLATFORM)}/*.{c,s}
+
+# Specify the libraries you want to include
+$(T)_DEPS := libcore
+
+ifneq (x86,$(PLATFORM))
+# The simulator only runs on x86
+EXCLUDED_PROJECTS += $(T)
+$(T)_EXCLUDE_TESTS := sim_clock sim_can_bus
+else ifeq (vehicle_sim,$(T))
+# Every board is linked into a single relocatable object, then all of its symbols except the ones
+# below are made local so the boards don't clash. The exported symbols are renamed to
+# <board>_<symbol> for the harness - see sim_board.h.
+VEHICLE_SIM_EXPORTS := main gpio_it_trigger_interrupt
+
+# Boards as <board>:<project> - must match sim_board_config.c
+VEHICLE_SIM_BOARDS := bms_carrier:bms_carrier centre_console:centre_console charger:charger \
+                      mci:mci pedal_board:pedal_board \
+                      power_distribution_front:power_distribution \
+                      power_distribution_rear:power_distribution solar:solar steering:steering
+
+VEHICLE_SIM_BOARD_DIR := $($(T)_OBJ_ROOT)/boards
+
+# Replacements for the x86 HAL that run on the simulator's clock and CAN bus, and for the drivers
+# of chips that aren't simulated behind SPI. Since they come before the libraries when linking a
+# board, the library versions are never pulled in.
+VEHICLE_SIM_HAL_OBJ := $(patsubst $($(T)_SRC_ROOT)/%.c,$($(T)_OBJ_ROOT)/%.o, \
+                         $(wildcard $($(T)_SRC_ROOT)/hal/*.c)) \
+                       $($(T)_OBJ_ROOT)/hal/x86_interrupt_queue.o
+
+# Boards need the queue interrupt backend, which interrupts each board's own main thread instead of
+# whichever thread of the process takes a signal
+VEHICLE_SIM_HAL_CFLAGS := -DX86_INTERRUPT_QUEUE -DX86_SIM
+
+$($(T)_OBJ_ROOT)/hal/%.o: $($(T)_SRC_ROOT)/hal/%.c $(DEP_VARS) | $(T)
+	@mkdir -p $(@D)
+	@echo "$(firstword $|): $(notdir $<) -> $(notdir $@)"
+	@$(CC) -MD -MP -c -o $@ $< $($(firstword $|)_CFLAGS) $(VEHICLE_SIM_HAL_CFLAGS) \
+		$(addprefix -I,$($(firstword $|)_INC_DIRS))
+
+$($(T)_OBJ_ROOT)/hal/x86_interrupt_queue.o: \
+    $(LIB_DIR)/x86/src/x86_interrupt_queue.c $(DEP_VARS) | $(T)
+	@mkdir -p $(@D)
+	@echo "$(firstword $|): $(notdir $<) -> $(notdir $@)"
+	@$(CC) -MD -MP -c -o $@ $< $($(firstword $|)_CFLAGS) $(VEHICLE_SIM_HAL_CFLAGS) \
+		$(addprefix -I,$($(firstword $|)_INC_DIRS))
+
+# Both power distribution boards run the same project, so the rear one gets its own main()
+VEHICLE_SIM_power_distribution_rear_MAIN := $(VEHICLE_SIM_BOARD_DIR)/power_distribution_rear_main.o
+
+$(VEHICLE_SIM_power_distribution_rear_MAIN): \
+    $(PROJ_DIR)/power_distribution/src/main.c $(DEP_VARS) | power_distribution
+	@mkdir -p $(@D)
+	@echo "$(firstword $|): $(notdir $<) -> $(notdir $@)"
+	@$(CC) -MD -MP -c -o $@ $< $($(firstword $|)_CFLAGS) -DFORCE_REAR_POWER_DISTRIBUTION \
+		$(addprefix -I,$($(firstword $|)_INC_DIRS))
+
+-include $(VEHICLE_SIM_HAL_OBJ:.o=.d) $(VEHICLE_SIM_power_distribution_rear_MAIN:.o=.d)
+
+# Boards can replace their project's main() by setting VEHICLE_SIM_<board>_MAIN
+# $(call vehicle_sim_board,board,project)
+define vehicle_sim_board
+$(VEHICLE_SIM_BOARD_DIR)/$(1).o: $(VEHICLE_SIM_HAL_OBJ) $(VEHICLE_SIM_$(1)_MAIN) \
+                                 $(STATIC_LIB_DIR)/lib$(2).a | $(2)
+	@mkdir -p $$(@D)
+	@echo "Linking simulated board $(1)"
+	@$(CC) -r -nostdlib -Wl,-u,main -o $$(@:.o=_full.o) $$(filter %.o,$$^) \
+		-L$(STATIC_LIB_DIR) -l$(2) $$(addprefix -l,$$($(2)_DEPS))
+	@$(OBJCPY) $(foreach sym,$(VEHICLE_SIM_EXPORTS),--redefine-sym $(sym)=$(1)_$(sym) \
+		--keep-global-symbol=$(1)_$(sym)) $$(@:.o=_full.o) $$@
+endef
+
+$(foreach board,$(VEHICLE_SIM_BOARDS), \
+  $(eval $(call vehicle_sim_board,$(word 1,$(subst :, ,$(board))),$(word 2,$(subst :, ,$(board))))))
+
+VEHICLE_SIM_BOARD_OBJ := $(foreach board,$(VEHICLE_SIM_BOARDS), \
+                           $(VEHICLE_SIM_BOARD_DIR)/$(word 1,$(subst :, ,$(board))).o)
+
+$(BIN_DIR)/$(T)$(PLATFORM_EXT): $(VEHICLE_SIM_BOARD_OBJ)
+endif
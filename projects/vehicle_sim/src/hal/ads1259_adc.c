@@ -0,0 +1,26 @@
+#include "ads1259_adc.h"
+
+#include "soft_timer.h"
+
+// The ADS1259 isn't simulated and would only read back checksum faults from the simulated SPI bus.
+// Each conversion instead completes after a millisecond with no current through the shunt.
+#define SIM_ADS1259_CONVERSION_MS 1
+
+static void prv_conversion_callback(SoftTimerId timer_id, void *context) {
+  Ads1259Storage *storage = context;
+  storage->reading_uv = 0;
+  storage->handler(ADS1259_STATUS_CODE_OK, storage->error_context);
+}
+
+StatusCode ads1259_init(Ads1259Storage *storage, Ads1259Settings *settings) {
+  storage->spi_port = settings->spi_port;
+  storage->handler = settings->handler;
+  storage->error_context = settings->error_context;
+  storage->reading_uv = 0;
+  return STATUS_CODE_OK;
+}
+
+StatusCode ads1259_get_conversion_data(Ads1259Storage *storage) {
+  return soft_timer_start_millis(SIM_ADS1259_CONVERSION_MS, prv_conversion_callback, storage,
+                                 NULL);
+}
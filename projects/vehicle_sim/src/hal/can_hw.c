@@ -0,0 +1,199 @@
+#include "can_hw.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "critical_section.h"
+#include "fifo.h"
+#include "interrupt_def.h"
+#include "log.h"
+#include "sim_can_bus.h"
+#include "x86_interrupt.h"
+
+// CAN HW on the simulator's in-memory bus. Frames from the bus go through acceptance filters like
+// the MCU's, then raise the CAN interrupt, which runs the registered handlers. The bus bitrate is
+// set by the simulator, so the configured bitrate is ignored.
+
+#define CAN_HW_MAX_FILTERS 14
+#define CAN_HW_RX_FIFO_LEN 32
+#define CAN_HW_STD_ID_MASK 0x7FF
+#define CAN_HW_EXT_ID_MASK 0x1FFFFFFF
+
+typedef enum {
+  CAN_HW_PENDING_TX_READY = 1 << 0,
+  CAN_HW_PENDING_MSG_RX = 1 << 1,
+} CanHwPending;
+
+typedef struct CanHwEventHandler {
+  CanHwEventHandlerCb callback;
+  void *context;
+} CanHwEventHandler;
+
+typedef struct CanHwFilter {
+  uint32_t mask;
+  uint32_t filter;
+  bool extended;
+} CanHwFilter;
+
+static SimCanNode s_node;
+static CanHwEventHandler s_handlers[NUM_CAN_HW_EVENTS];
+static CanHwFilter s_filters[CAN_HW_MAX_FILTERS];
+static size_t s_num_filters = 0;
+static CanFilterBank s_banks[CAN_FILTER_NUM_BANKS];
+static size_t s_num_banks = 0;
+static Fifo s_rx_fifo;
+static SimCanFrame s_rx_frames[CAN_HW_RX_FIFO_LEN];
+static uint8_t s_interrupt_id;
+static uint8_t s_pending = 0;
+
+static bool prv_accept(const SimCanFrame *frame) {
+  if (s_num_filters == 0 && s_num_banks == 0) {
+    return true;
+  }
+
+  for (size_t i = 0; i < s_num_filters; i++) {
+    if (s_filters[i].extended == frame->extended &&
+        (frame->id & s_filters[i].mask) == (s_filters[i].filter & s_filters[i].mask)) {
+      return true;
+    }
+  }
+  return s_num_banks > 0 && !frame->extended &&
+         can_filter_match(s_banks, s_num_banks, (uint16_t)frame->id);
+}
+
+static void prv_raise(CanHwPending pending) {
+  __atomic_or_fetch(&s_pending, pending, __ATOMIC_SEQ_CST);
+  x86_interrupt_trigger(s_interrupt_id);
+}
+
+static void prv_rx(const SimCanFrame *frame, void *context) {
+  if (!prv_accept(frame)) {
+    return;
+  }
+  if (fifo_push(&s_rx_fifo, frame) != STATUS_CODE_OK) {
+    LOG_WARN("CAN HW: RX FIFO full, dropped 0x%x\n", frame->id);
+    return;
+  }
+  prv_raise(CAN_HW_PENDING_MSG_RX);
+}
+
+static void prv_tx(void *context) {
+  prv_raise(CAN_HW_PENDING_TX_READY);
+}
+
+static void prv_run_handler(CanHwEvent event) {
+  if (s_handlers[event].callback != NULL) {
+    s_handlers[event].callback(s_handlers[event].context);
+  }
+}
+
+static void prv_can_interrupt(uint8_t interrupt_id) {
+  uint8_t pending = __atomic_exchange_n(&s_pending, 0, __ATOMIC_SEQ_CST);
+  if (pending & CAN_HW_PENDING_TX_READY) {
+    prv_run_handler(CAN_HW_EVENT_TX_READY);
+  }
+  if (pending & CAN_HW_PENDING_MSG_RX) {
+    prv_run_handler(CAN_HW_EVENT_MSG_RX);
+  }
+}
+
+StatusCode can_hw_init(const CanHwSettings *settings) {
+  memset(s_handlers, 0, sizeof(s_handlers));
+  s_num_filters = 0;
+  s_num_banks = 0;
+  s_pending = 0;
+  fifo_init(&s_rx_fifo, s_rx_frames);
+
+  uint8_t handler_id = 0;
+  status_ok_or_return(x86_interrupt_register_handler(prv_can_interrupt, &handler_id));
+  InterruptSettings it_settings = {
+    .type = INTERRUPT_TYPE_INTERRUPT,
+    .priority = INTERRUPT_PRIORITY_NORMAL,
+  };
+  status_ok_or_return(x86_interrupt_register_interrupt(handler_id, &it_settings, &s_interrupt_id));
+
+  s_node.rx_callback = prv_rx;
+  s_node.tx_callback = prv_tx;
+  s_node.context = NULL;
+  s_node.loopback = settings->loopback;
+  return sim_can_bus_attach(&s_node);
+}
+
+StatusCode can_hw_register_callback(CanHwEvent event, CanHwEventHandlerCb callback, void *context) {
+  if (event >= NUM_CAN_HW_EVENTS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  s_handlers[event] = (CanHwEventHandler){
+    .callback = callback,
+    .context = context,
+  };
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_hw_add_filter(uint32_t mask, uint32_t filter, bool extended) {
+  if (s_num_filters + s_num_banks >= CAN_HW_MAX_FILTERS) {
+    return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "CAN HW: Ran out of filters.");
+  }
+
+  uint32_t id_mask = extended ? CAN_HW_EXT_ID_MASK : CAN_HW_STD_ID_MASK;
+  s_filters[s_num_filters] = (CanHwFilter){
+    .mask = mask & id_mask,
+    .filter = filter & id_mask,
+    .extended = extended,
+  };
+  s_num_filters++;
+  return STATUS_CODE_OK;
+}
+
+StatusCode can_hw_set_filters(const CanFilterBank *banks, size_t num_banks) {
+  if (num_banks > CAN_FILTER_NUM_BANKS || (banks == NULL && num_banks > 0)) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "CAN HW: Too many filter banks.");
+  }
+
+  if (num_banks > 0) {
+    memcpy(s_banks, banks, sizeof(banks[0]) * num_banks);
+  }
+  s_num_banks = num_banks;
+  s_num_filters = 0;
+  return STATUS_CODE_OK;
+}
+
+CanHwBusStatus can_hw_bus_status(void) {
+  return CAN_HW_BUS_STATUS_OK;
+}
+
+StatusCode can_hw_transmit(uint32_t id, bool extended, const uint8_t *data, size_t len) {
+  if (len > sizeof(uint64_t)) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  SimCanFrame frame = {
+    .id = id & (extended ? CAN_HW_EXT_ID_MASK : CAN_HW_STD_ID_MASK),
+    .extended = extended,
+    .dlc = len,
+  };
+  if (data != NULL) {
+    memcpy(&frame.data, data, len);
+  }
+
+  // The bus takes a lock, which a handler on the same thread must not preempt
+  const bool critical = critical_section_start();
+  StatusCode status = sim_can_bus_transmit(&s_node, &frame);
+  critical_section_end(critical);
+  return status;
+}
+
+bool can_hw_receive(uint32_t *id, bool *extended, uint64_t *data, size_t *len) {
+  SimCanFrame frame = { 0 };
+  if (fifo_pop(&s_rx_fifo, &frame) != STATUS_CODE_OK) {
+    return false;
+  }
+
+  *id = frame.id;
+  *extended = frame.extended;
+  *data = frame.data;
+  *len = frame.dlc;
+  return true;
+}
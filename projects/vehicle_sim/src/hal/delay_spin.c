@@ -0,0 +1,26 @@
+#include "delay.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "soft_timer.h"
+#include "status.h"
+#include "wait.h"
+
+// Busy-waiting in wall time would stop the virtual clock, so short delays sleep on a soft timer
+// like long ones. Virtual time has no wake-up latency, so they still end on time.
+
+static void prv_delay_it(SoftTimerId timer_id, void *context) {
+  volatile bool *block = context;
+  *block = false;
+}
+
+void delay_spin_us(uint32_t t) {
+  volatile bool block = true;
+  if (soft_timer_start(t, prv_delay_it, (void *)&block, NULL) != STATUS_CODE_OK) {
+    return;
+  }
+  while (block) {
+    wait();
+  }
+}
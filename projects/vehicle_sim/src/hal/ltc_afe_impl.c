@@ -0,0 +1,73 @@
+#include "ltc_afe_impl.h"
+
+#include <string.h>
+
+// The AFEs aren't simulated, and the LTC6811 commands would only read back PEC failures from the
+// simulated SPI bus. Every cell reads a healthy 3.7V instead. Every thermistor reads 0, since the
+// BMS overtemperature thresholds are still 0 and any reading above them would fault.
+#define SIM_AFE_CELL_DMV 37000
+#define SIM_AFE_THERMISTOR_DMV 0
+
+StatusCode ltc_afe_impl_init(LtcAfeStorage *afe, const LtcAfeSettings *settings) {
+  if (settings->num_devices > LTC_AFE_MAX_DEVICES || settings->num_cells > LTC_AFE_MAX_CELLS ||
+      settings->num_thermistors > LTC_AFE_MAX_THERMISTORS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+  memset(afe, 0, sizeof(*afe));
+  memcpy(&afe->settings, settings, sizeof(afe->settings));
+
+  return STATUS_CODE_OK;
+}
+
+StatusCode ltc_afe_impl_trigger_cell_conv(LtcAfeStorage *afe) {
+  return STATUS_CODE_OK;
+}
+
+StatusCode ltc_afe_impl_trigger_aux_conv(LtcAfeStorage *afe, uint8_t device_cell) {
+  return STATUS_CODE_OK;
+}
+
+StatusCode ltc_afe_impl_read_cells(LtcAfeStorage *afe) {
+  for (size_t cell = 0; cell < afe->settings.num_cells; cell++) {
+    afe->cell_voltages[cell] = SIM_AFE_CELL_DMV;
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode ltc_afe_impl_read_aux(LtcAfeStorage *afe, uint8_t device_cell) {
+  for (size_t thermistor = 0; thermistor < afe->settings.num_thermistors; thermistor++) {
+    afe->aux_voltages[thermistor] = SIM_AFE_THERMISTOR_DMV;
+  }
+  return STATUS_CODE_OK;
+}
+
+// Cells are numbered in order across the devices, since the simulated AFEs have no gaps
+StatusCode ltc_afe_impl_toggle_cell_discharge(LtcAfeStorage *afe, uint16_t cell, bool discharge) {
+  if (cell >= afe->settings.num_cells) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  uint16_t device = cell / LTC_AFE_MAX_CELLS_PER_DEVICE;
+  uint16_t device_cell = cell % LTC_AFE_MAX_CELLS_PER_DEVICE;
+  if (discharge) {
+    afe->discharge_bitset[device] |= (1 << device_cell);
+  } else {
+    afe->discharge_bitset[device] &= ~(1 << device_cell);
+  }
+
+  return STATUS_CODE_OK;
+}
+
+StatusCode ltc_afe_impl_set_cell_discharge(LtcAfeStorage *afe, const bool *discharge,
+                                           size_t num_cells) {
+  if (discharge == NULL || num_cells != afe->settings.num_cells) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  memset(afe->discharge_bitset, 0, sizeof(afe->discharge_bitset));
+  for (uint16_t cell = 0; cell < num_cells; cell++) {
+    ltc_afe_impl_toggle_cell_discharge(afe, cell, discharge[cell]);
+  }
+
+  return STATUS_CODE_OK;
+}
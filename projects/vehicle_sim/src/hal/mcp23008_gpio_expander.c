@@ -0,0 +1,125 @@
+#include "mcp23008_gpio_expander.h"
+
+#include "gpio.h"
+#include "gpio_it.h"
+#include "soft_timer.h"
+
+// Same in-memory expander as the x86 driver, except that the BMS carrier's expander also senses
+// its relays. Nothing drives those sense lines in the simulator, so they follow the relay enable
+// pins instead and the expander's interrupt fires whenever they change, as it would once the
+// relays switched. The addresses and pins must match bms_carrier's relay_sequence.h.
+#define SIM_MCP23008_BMS_I2C_ADDR 0x40
+#define SIM_MCP23008_BMS_HV_SENSE_PIN 1
+#define SIM_MCP23008_BMS_GND_SENSE_PIN 0
+#define SIM_MCP23008_RELAY_POLL_MS 5
+
+// There's only 256 I2C addresses so it's ok to keep all the settings in memory.
+#define MAX_I2C_ADDRESSES 256
+
+static I2CPort s_i2c_port = NUM_I2C_PORTS;
+
+static Mcp23008GpioSettings s_pin_settings[MAX_I2C_ADDRESSES][NUM_MCP23008_GPIO_PINS];
+
+static GpioAddress s_hv_relay_en = { GPIO_PORT_A, 0 };
+static GpioAddress s_gnd_relay_en = { GPIO_PORT_A, 1 };
+static GpioAddress s_int_pin = { GPIO_PORT_A, 10 };
+
+static bool prv_follow_relay(const GpioAddress *relay_en, Mcp23008PinAddress sense_pin) {
+  GpioState relay_state = GPIO_STATE_LOW;
+  gpio_get_state(relay_en, &relay_state);
+  Mcp23008GpioState sense_state =
+      (relay_state == GPIO_STATE_HIGH) ? MCP23008_GPIO_STATE_HIGH : MCP23008_GPIO_STATE_LOW;
+  Mcp23008GpioSettings *settings = &s_pin_settings[SIM_MCP23008_BMS_I2C_ADDR][sense_pin];
+  if (settings->state == sense_state) {
+    return false;
+  }
+  settings->state = sense_state;
+  return true;
+}
+
+static void prv_poll_relays(SoftTimerId timer_id, void *context) {
+  // Both lines are always updated, so no short-circuiting
+  bool hv_changed = prv_follow_relay(&s_hv_relay_en, SIM_MCP23008_BMS_HV_SENSE_PIN);
+  bool gnd_changed = prv_follow_relay(&s_gnd_relay_en, SIM_MCP23008_BMS_GND_SENSE_PIN);
+  if (hv_changed || gnd_changed) {
+    gpio_it_trigger_interrupt(&s_int_pin);
+  }
+  soft_timer_start_millis(SIM_MCP23008_RELAY_POLL_MS, prv_poll_relays, NULL, NULL);
+}
+
+StatusCode mcp23008_gpio_init(const I2CPort i2c_port, const I2CAddress i2c_address) {
+  s_i2c_port = i2c_port;
+
+  Mcp23008GpioSettings default_settings = {
+    .direction = MCP23008_GPIO_DIR_IN,
+    .state = MCP23008_GPIO_STATE_LOW,
+  };
+  for (Mcp23008PinAddress i = 0; i < NUM_MCP23008_GPIO_PINS; i++) {
+    s_pin_settings[i2c_address][i] = default_settings;
+  }
+
+  if (i2c_address == SIM_MCP23008_BMS_I2C_ADDR) {
+    return soft_timer_start_millis(SIM_MCP23008_RELAY_POLL_MS, prv_poll_relays, NULL, NULL);
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp23008_gpio_init_pin(const Mcp23008GpioAddress *address,
+                                  const Mcp23008GpioSettings *settings) {
+  if (s_i2c_port >= NUM_I2C_PORTS) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  if (address->pin >= NUM_MCP23008_GPIO_PINS || settings->direction >= NUM_MCP23008_GPIO_DIRS ||
+      settings->state >= NUM_MCP23008_GPIO_STATES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  s_pin_settings[address->i2c_address][address->pin] = *settings;
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp23008_gpio_set_state(const Mcp23008GpioAddress *address,
+                                   const Mcp23008GpioState state) {
+  if (s_i2c_port >= NUM_I2C_PORTS) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  if (address->pin >= NUM_MCP23008_GPIO_PINS || state >= NUM_MCP23008_GPIO_STATES) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  s_pin_settings[address->i2c_address][address->pin].state = state;
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp23008_gpio_toggle_state(const Mcp23008GpioAddress *address) {
+  if (s_i2c_port >= NUM_I2C_PORTS) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  if (address->pin >= NUM_MCP23008_GPIO_PINS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  if (s_pin_settings[address->i2c_address][address->pin].state == MCP23008_GPIO_STATE_HIGH) {
+    s_pin_settings[address->i2c_address][address->pin].state = MCP23008_GPIO_STATE_LOW;
+  } else {
+    s_pin_settings[address->i2c_address][address->pin].state = MCP23008_GPIO_STATE_HIGH;
+  }
+  return STATUS_CODE_OK;
+}
+
+StatusCode mcp23008_gpio_get_state(const Mcp23008GpioAddress *address,
+                                   Mcp23008GpioState *input_state) {
+  if (s_i2c_port >= NUM_I2C_PORTS) {
+    return status_code(STATUS_CODE_UNINITIALIZED);
+  }
+
+  if (address->pin >= NUM_MCP23008_GPIO_PINS) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  *input_state = s_pin_settings[address->i2c_address][address->pin].state;
+  return STATUS_CODE_OK;
+}
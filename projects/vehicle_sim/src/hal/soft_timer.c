@@ -0,0 +1,143 @@
+#include "soft_timer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "critical_section.h"
+#include "interrupt_def.h"
+#include "sim_clock.h"
+#include "status.h"
+#include "x86_interrupt.h"
+
+// Soft timers in virtual time. Like the hardware timer on the MCU, a single clock event is set for
+// the earliest deadline and raises an interrupt that runs every expired timer.
+
+typedef struct SimSoftTimer {
+  uint64_t deadline_us;
+  SoftTimerCallback callback;
+  void *context;
+  bool inuse;
+} SimSoftTimer;
+
+static SimSoftTimer s_timers[SOFT_TIMER_MAX_TIMERS];
+static volatile uint8_t s_active_timers = 0;
+static SimClockEvent s_clock_event;
+static uint8_t s_interrupt_id;
+
+// Must be called in a critical section
+static void prv_update_clock_event(void) {
+  SimSoftTimer *earliest = NULL;
+  for (size_t i = 0; i < SOFT_TIMER_MAX_TIMERS; i++) {
+    if (!s_timers[i].inuse) {
+      continue;
+    }
+    if (earliest == NULL || s_timers[i].deadline_us < earliest->deadline_us) {
+      earliest = &s_timers[i];
+    }
+  }
+
+  if (earliest == NULL) {
+    sim_clock_cancel(&s_clock_event);
+  } else {
+    sim_clock_schedule(&s_clock_event, earliest->deadline_us);
+  }
+}
+
+static void prv_clock_event(void *context) {
+  x86_interrupt_trigger(s_interrupt_id);
+}
+
+static void prv_soft_timer_handler(uint8_t interrupt_id) {
+  const bool critical = critical_section_start();
+  uint64_t now_us = sim_clock_now_us();
+  for (uint16_t i = 0; i < SOFT_TIMER_MAX_TIMERS; i++) {
+    if (s_timers[i].inuse && s_timers[i].deadline_us <= now_us) {
+      // Mark as no longer inuse in case a timer is cancelled within its callback
+      s_timers[i].inuse = false;
+      s_active_timers--;
+      s_timers[i].callback(i, s_timers[i].context);
+    }
+  }
+  prv_update_clock_event();
+  critical_section_end(critical);
+}
+
+void soft_timer_init(void) {
+  uint8_t handler_id;
+  x86_interrupt_register_handler(prv_soft_timer_handler, &handler_id);
+  InterruptSettings it_settings = {
+    .type = INTERRUPT_TYPE_INTERRUPT,       //
+    .priority = INTERRUPT_PRIORITY_NORMAL,  //
+  };
+  x86_interrupt_register_interrupt(handler_id, &it_settings, &s_interrupt_id);
+
+  sim_clock_cancel(&s_clock_event);
+  s_clock_event.callback = prv_clock_event;
+  s_clock_event.context = NULL;
+
+  s_active_timers = 0;
+  for (uint32_t i = 0; i < SOFT_TIMER_MAX_TIMERS; i++) {
+    s_timers[i].inuse = false;
+  }
+}
+
+StatusCode soft_timer_start(uint32_t duration_us, SoftTimerCallback callback, void *context,
+                            SoftTimerId *timer_id) {
+  if (duration_us < SOFT_TIMER_MIN_TIME_US) {
+    return status_msg(STATUS_CODE_INVALID_ARGS, "Soft timer too short!");
+  }
+
+  const bool critical = critical_section_start();
+  for (uint32_t i = 0; i < SOFT_TIMER_MAX_TIMERS; i++) {
+    if (!s_timers[i].inuse) {
+      s_timers[i].deadline_us = sim_clock_now_us() + duration_us;
+      s_timers[i].callback = callback;
+      s_timers[i].context = context;
+      s_timers[i].inuse = true;
+      if (timer_id != NULL) {
+        *timer_id = i;
+      }
+      s_active_timers++;
+      prv_update_clock_event();
+      critical_section_end(critical);
+      return STATUS_CODE_OK;
+    }
+  }
+
+  critical_section_end(critical);
+  return status_msg(STATUS_CODE_RESOURCE_EXHAUSTED, "Out of software timers.");
+}
+
+bool soft_timer_inuse(void) {
+  return s_active_timers > 0;
+}
+
+bool soft_timer_cancel(SoftTimerId timer_id) {
+  const bool critical = critical_section_start();
+  if (timer_id < SOFT_TIMER_MAX_TIMERS && s_timers[timer_id].inuse) {
+    s_timers[timer_id].inuse = false;
+    s_active_timers--;
+    prv_update_clock_event();
+    critical_section_end(critical);
+    return true;
+  }
+  critical_section_end(critical);
+  return false;
+}
+
+uint32_t soft_timer_remaining_time(SoftTimerId timer_id) {
+  if (timer_id >= SOFT_TIMER_MAX_TIMERS || !s_timers[timer_id].inuse) {
+    return 0;
+  }
+
+  uint64_t now_us = sim_clock_now_us();
+  if (s_timers[timer_id].deadline_us <= now_us) {
+    return 0;
+  }
+  return (uint32_t)(s_timers[timer_id].deadline_us - now_us);
+}
+
+uint32_t soft_timer_now_us(void) {
+  return (uint32_t)sim_clock_now_us();
+}
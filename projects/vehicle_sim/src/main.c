@@ -0,0 +1,56 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim_board.h"
+#include "sim_board_config.h"
+#include "sim_can_bus.h"
+#include "sim_clock.h"
+#include "sim_scenario.h"
+#include "sim_scenario_config.h"
+#include "status.h"
+
+// Runs every board of the car on a virtual clock and shared CAN bus, then plays scenarios against
+// them.
+//
+// Usage: vehicle_sim [-t] [scenario...]
+//   -t: print every CAN frame
+// Runs every scenario in VEHICLE_SIM_SCENARIO_CONFIG if none are given. Exits with 1 if any fail.
+
+#define VEHICLE_SIM_BITRATE 500000
+
+int main(int argc, char *argv[]) {
+  bool trace = false;
+  int first_scenario = 1;
+  if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+    trace = true;
+    first_scenario++;
+  }
+
+  sim_clock_init();
+  sim_can_bus_init(VEHICLE_SIM_BITRATE);
+  if (sim_scenario_init(&VEHICLE_SIM_BOARD_CONFIG, trace) != STATUS_CODE_OK ||
+      sim_board_start_all(&VEHICLE_SIM_BOARD_CONFIG) != STATUS_CODE_OK) {
+    printf("Failed to start the simulator\n");
+    return 1;
+  }
+
+  int failed = 0;
+  if (first_scenario >= argc) {
+    for (size_t i = 0; i < VEHICLE_SIM_SCENARIO_CONFIG.num_scenarios; i++) {
+      failed += sim_scenario_run(&VEHICLE_SIM_SCENARIO_CONFIG.scenarios[i]) != STATUS_CODE_OK;
+    }
+  }
+  for (int i = first_scenario; i < argc; i++) {
+    const SimScenario *scenario = sim_scenario_find(&VEHICLE_SIM_SCENARIO_CONFIG, argv[i]);
+    if (scenario == NULL) {
+      printf("No scenario named %s\n", argv[i]);
+      failed++;
+      continue;
+    }
+    failed += sim_scenario_run(scenario) != STATUS_CODE_OK;
+  }
+
+  printf("%d scenario(s) failed\n", failed);
+  return failed > 0;
+}
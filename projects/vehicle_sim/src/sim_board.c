@@ -0,0 +1,42 @@
+#include "sim_board.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "sim_clock.h"
+#include "x86_sim.h"
+
+static void *prv_board_thread(void *context) {
+  const SimBoard *board = context;
+  board->main();
+  LOG_WARN("Sim: %s returned from main\n", board->name);
+  return NULL;
+}
+
+StatusCode sim_board_start_all(const SimBoardConfig *config) {
+  for (size_t i = 0; i < config->num_boards; i++) {
+    const SimBoard *board = &config->boards[i];
+
+    // The main thread is runnable until it first waits
+    x86_sim_busy();
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, prv_board_thread, (void *)board) != 0) {
+      x86_sim_idle();
+      return status_msg(STATUS_CODE_INTERNAL_ERROR, "Sim: failed to start board");
+    }
+    pthread_setname_np(thread, board->name);
+    pthread_detach(thread);
+
+    sim_clock_run_until(sim_clock_now_us(), NULL);
+  }
+  return STATUS_CODE_OK;
+}
+
+const SimBoard *sim_board_find(const SimBoardConfig *config, const char *name) {
+  for (size_t i = 0; i < config->num_boards; i++) {
+    if (strcmp(config->boards[i].name, name) == 0) {
+      return &config->boards[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,30 @@
+#include "sim_board_config.h"
+
+#include "misc.h"
+
+SIM_BOARD_DECLARE(bms_carrier);
+SIM_BOARD_DECLARE(centre_console);
+SIM_BOARD_DECLARE(charger);
+SIM_BOARD_DECLARE(mci);
+SIM_BOARD_DECLARE(pedal_board);
+SIM_BOARD_DECLARE(power_distribution_front);
+SIM_BOARD_DECLARE(power_distribution_rear);
+SIM_BOARD_DECLARE(solar);
+SIM_BOARD_DECLARE(steering);
+
+static const SimBoard s_boards[] = {
+  SIM_BOARD(bms_carrier),
+  SIM_BOARD(centre_console),
+  SIM_BOARD(charger),
+  SIM_BOARD(mci),
+  SIM_BOARD(pedal_board),
+  SIM_BOARD(power_distribution_front),
+  SIM_BOARD(power_distribution_rear),
+  SIM_BOARD(solar),
+  SIM_BOARD(steering),
+};
+
+const SimBoardConfig VEHICLE_SIM_BOARD_CONFIG = {
+  .boards = s_boards,
+  .num_boards = SIZEOF_ARRAY(s_boards),
+};
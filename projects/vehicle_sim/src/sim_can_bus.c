@@ -0,0 +1,164 @@
+#include "sim_can_bus.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// Frame lengths without bit stuffing: SOF, arbitration, control, CRC, ACK, EOF and interframe
+// space, plus 8 bits per data byte
+#define SIM_CAN_BUS_STD_FRAME_BITS 47
+#define SIM_CAN_BUS_EXT_FRAME_BITS 67
+
+#define SIM_CAN_BUS_STD_ID_BITS 11
+#define SIM_CAN_BUS_EXT_ID_BITS 29
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SimCanNode *s_nodes[SIM_CAN_BUS_MAX_NODES];
+static size_t s_num_nodes = 0;
+static uint32_t s_bitrate = 0;
+
+static SimClockEvent s_bus_event;
+// Node whose head frame is on the bus, if any
+static SimCanNode *s_sender = NULL;
+// Whether |s_bus_event| will start arbitration on an idle bus
+static bool s_arbitration_pending = false;
+static SimCanBusStats s_stats;
+
+// Lower keys win arbitration. Standard IDs line up with the base ID of extended frames, and the
+// dominant IDE bit of a standard frame breaks the tie.
+static uint64_t prv_arbitration_key(const SimCanFrame *frame) {
+  const uint32_t ext_only_bits = SIM_CAN_BUS_EXT_ID_BITS - SIM_CAN_BUS_STD_ID_BITS;
+  if (frame->extended) {
+    uint64_t base_id = frame->id >> ext_only_bits;
+    uint64_t ext_id = frame->id & ((1u << ext_only_bits) - 1);
+    return (base_id << (ext_only_bits + 1)) | (1u << ext_only_bits) | ext_id;
+  }
+  return (uint64_t)frame->id << (ext_only_bits + 1);
+}
+
+// Must be called with |s_mutex| held. Puts the winning frame on the bus if any are queued.
+static void prv_arbitrate(void) {
+  s_sender = NULL;
+  for (size_t i = 0; i < s_num_nodes; i++) {
+    SimCanNode *node = s_nodes[i];
+    if (node->tx_len == 0) {
+      continue;
+    }
+    if (s_sender == NULL || prv_arbitration_key(&node->tx_queue[node->tx_head]) <
+                                prv_arbitration_key(&s_sender->tx_queue[s_sender->tx_head])) {
+      s_sender = node;
+    }
+  }
+
+  if (s_sender != NULL) {
+    uint32_t frame_time_us = sim_can_bus_frame_time_us(&s_sender->tx_queue[s_sender->tx_head]);
+    s_stats.busy_us += frame_time_us;
+    sim_clock_schedule(&s_bus_event, sim_clock_now_us() + frame_time_us);
+  }
+}
+
+static void prv_bus_event(void *context) {
+  pthread_mutex_lock(&s_mutex);
+  if (s_sender == NULL) {
+    // The bus was idle - start the first frame
+    s_arbitration_pending = false;
+    prv_arbitrate();
+    pthread_mutex_unlock(&s_mutex);
+    return;
+  }
+
+  // The frame on the bus just finished
+  SimCanNode *sender = s_sender;
+  SimCanFrame frame = sender->tx_queue[sender->tx_head];
+  sender->tx_head = (sender->tx_head + 1) % SIM_CAN_BUS_TX_QUEUE_LEN;
+  sender->tx_len--;
+  s_stats.frames++;
+
+  SimCanNode *receivers[SIM_CAN_BUS_MAX_NODES];
+  size_t num_receivers = 0;
+  for (size_t i = 0; i < s_num_nodes; i++) {
+    if (s_nodes[i] != sender || sender->loopback) {
+      receivers[num_receivers++] = s_nodes[i];
+    }
+  }
+
+  // The next frame starts right away, so anything the receivers queue in response waits for it
+  prv_arbitrate();
+  pthread_mutex_unlock(&s_mutex);
+
+  for (size_t i = 0; i < num_receivers; i++) {
+    receivers[i]->rx_callback(&frame, receivers[i]->context);
+  }
+  sender->tx_callback(sender->context);
+}
+
+void sim_can_bus_init(uint32_t bitrate) {
+  pthread_mutex_lock(&s_mutex);
+  s_num_nodes = 0;
+  s_bitrate = bitrate;
+  s_sender = NULL;
+  s_arbitration_pending = false;
+  memset(&s_stats, 0, sizeof(s_stats));
+  sim_clock_cancel(&s_bus_event);
+  s_bus_event.callback = prv_bus_event;
+  s_bus_event.context = NULL;
+  pthread_mutex_unlock(&s_mutex);
+}
+
+StatusCode sim_can_bus_attach(SimCanNode *node) {
+  if (node == NULL || node->rx_callback == NULL || node->tx_callback == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  pthread_mutex_lock(&s_mutex);
+  node->tx_head = 0;
+  node->tx_len = 0;
+  for (size_t i = 0; i < s_num_nodes; i++) {
+    if (s_nodes[i] == node) {
+      pthread_mutex_unlock(&s_mutex);
+      return STATUS_CODE_OK;
+    }
+  }
+
+  if (s_num_nodes >= SIM_CAN_BUS_MAX_NODES) {
+    pthread_mutex_unlock(&s_mutex);
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  s_nodes[s_num_nodes++] = node;
+  pthread_mutex_unlock(&s_mutex);
+  return STATUS_CODE_OK;
+}
+
+StatusCode sim_can_bus_transmit(SimCanNode *node, const SimCanFrame *frame) {
+  if (node == NULL || frame == NULL || frame->dlc > 8) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  pthread_mutex_lock(&s_mutex);
+  if (node->tx_len >= SIM_CAN_BUS_TX_QUEUE_LEN) {
+    pthread_mutex_unlock(&s_mutex);
+    return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+  }
+  node->tx_queue[(node->tx_head + node->tx_len) % SIM_CAN_BUS_TX_QUEUE_LEN] = *frame;
+  node->tx_len++;
+
+  // Arbitration happens once everything sent at this instant has been queued
+  if (s_sender == NULL && !s_arbitration_pending) {
+    s_arbitration_pending = true;
+    sim_clock_schedule(&s_bus_event, sim_clock_now_us());
+  }
+  pthread_mutex_unlock(&s_mutex);
+  return STATUS_CODE_OK;
+}
+
+uint32_t sim_can_bus_frame_time_us(const SimCanFrame *frame) {
+  uint64_t bits = (frame->extended ? SIM_CAN_BUS_EXT_FRAME_BITS : SIM_CAN_BUS_STD_FRAME_BITS) +
+                  8 * frame->dlc;
+  // Round up so back-to-back frames never overlap
+  return (uint32_t)((bits * 1000000 + s_bitrate - 1) / s_bitrate);
+}
+
+void sim_can_bus_get_stats(SimCanBusStats *stats) {
+  pthread_mutex_lock(&s_mutex);
+  *stats = s_stats;
+  pthread_mutex_unlock(&s_mutex);
+}
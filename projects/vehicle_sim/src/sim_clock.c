@@ -0,0 +1,152 @@
+#include "sim_clock.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "log.h"
+#include "x86_sim.h"
+
+// Warn if the boards stay busy this long in real time, since virtual time is stuck until then
+#define SIM_CLOCK_STUCK_TIMEOUT_S 5
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_idle_cond = PTHREAD_COND_INITIALIZER;
+
+static SimClockEvent *s_events[SIM_CLOCK_MAX_EVENTS];
+static size_t s_num_events = 0;
+static uint64_t s_next_sequence = 0;
+static uint64_t s_now_us = 0;
+// Number of runnable main threads and pending interrupts across all boards
+static uint32_t s_busy = 0;
+
+void x86_sim_busy(void) {
+  pthread_mutex_lock(&s_mutex);
+  s_busy++;
+  pthread_mutex_unlock(&s_mutex);
+}
+
+void x86_sim_idle(void) {
+  pthread_mutex_lock(&s_mutex);
+  if (--s_busy == 0) {
+    pthread_cond_broadcast(&s_idle_cond);
+  }
+  pthread_mutex_unlock(&s_mutex);
+}
+
+// Must be called with |s_mutex| held
+static void prv_remove(size_t index) {
+  s_events[index]->scheduled = false;
+  s_events[index] = s_events[--s_num_events];
+}
+
+// Must be called with |s_mutex| held. Returns the index of the next event to run.
+static size_t prv_earliest(void) {
+  size_t earliest = 0;
+  for (size_t i = 1; i < s_num_events; i++) {
+    const SimClockEvent *event = s_events[i];
+    const SimClockEvent *best = s_events[earliest];
+    if (event->deadline_us < best->deadline_us ||
+        (event->deadline_us == best->deadline_us && event->sequence < best->sequence)) {
+      earliest = i;
+    }
+  }
+  return earliest;
+}
+
+// Must be called with |s_mutex| held
+static void prv_wait_for_idle(void) {
+  bool warned = false;
+  while (s_busy > 0) {
+    struct timespec timeout = { 0 };
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += SIM_CLOCK_STUCK_TIMEOUT_S;
+    if (pthread_cond_timedwait(&s_idle_cond, &s_mutex, &timeout) == ETIMEDOUT && !warned) {
+      LOG_WARN("Sim clock: boards busy for %ds at %lu us - is a main loop spinning?\n",
+               SIM_CLOCK_STUCK_TIMEOUT_S, s_now_us);
+      warned = true;
+    }
+  }
+}
+
+void sim_clock_init(void) {
+  pthread_mutex_lock(&s_mutex);
+  for (size_t i = 0; i < s_num_events; i++) {
+    s_events[i]->scheduled = false;
+  }
+  s_num_events = 0;
+  s_next_sequence = 0;
+  __atomic_store_n(&s_now_us, 0, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&s_mutex);
+}
+
+uint64_t sim_clock_now_us(void) {
+  // Lock-free since a handler may call it after preempting a call on the same thread
+  return __atomic_load_n(&s_now_us, __ATOMIC_ACQUIRE);
+}
+
+StatusCode sim_clock_schedule(SimClockEvent *event, uint64_t deadline_us) {
+  if (event == NULL || event->callback == NULL) {
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  pthread_mutex_lock(&s_mutex);
+  if (!event->scheduled) {
+    if (s_num_events >= SIM_CLOCK_MAX_EVENTS) {
+      pthread_mutex_unlock(&s_mutex);
+      return status_code(STATUS_CODE_RESOURCE_EXHAUSTED);
+    }
+    s_events[s_num_events++] = event;
+    event->scheduled = true;
+  }
+  event->deadline_us = (deadline_us < s_now_us) ? s_now_us : deadline_us;
+  event->sequence = s_next_sequence++;
+  pthread_mutex_unlock(&s_mutex);
+
+  return STATUS_CODE_OK;
+}
+
+bool sim_clock_cancel(SimClockEvent *event) {
+  bool cancelled = false;
+  pthread_mutex_lock(&s_mutex);
+  for (size_t i = 0; i < s_num_events; i++) {
+    if (s_events[i] == event) {
+      prv_remove(i);
+      cancelled = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&s_mutex);
+  return cancelled;
+}
+
+void sim_clock_run_until(uint64_t end_us, volatile bool *done) {
+  pthread_mutex_lock(&s_mutex);
+  for (;;) {
+    // Everything that happens at the current time must settle before time moves on
+    prv_wait_for_idle();
+    if (done != NULL && *done) {
+      break;
+    }
+
+    size_t index = prv_earliest();
+    if (s_num_events == 0 || s_events[index]->deadline_us > end_us) {
+      if (end_us > s_now_us) {
+        __atomic_store_n(&s_now_us, end_us, __ATOMIC_RELEASE);
+      }
+      break;
+    }
+
+    SimClockEvent *event = s_events[index];
+    prv_remove(index);
+    if (event->deadline_us > s_now_us) {
+      __atomic_store_n(&s_now_us, event->deadline_us, __ATOMIC_RELEASE);
+    }
+
+    // Callbacks call into the boards, which may schedule more events
+    pthread_mutex_unlock(&s_mutex);
+    event->callback(event->context);
+    pthread_mutex_lock(&s_mutex);
+  }
+  pthread_mutex_unlock(&s_mutex);
+}
@@ -0,0 +1,162 @@
+#include "sim_scenario.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim_can_bus.h"
+#include "sim_clock.h"
+
+#define SIM_SCENARIO_US_PER_MS 1000
+
+static const SimBoardConfig *s_boards = NULL;
+static SimCanNode s_node;
+static bool s_trace = false;
+
+// Only touched from the thread running the clock
+static const CanMessage *s_expected = NULL;
+static volatile bool s_expect_done = false;
+static uint64_t s_expect_time_us = 0;
+
+static double prv_now_s(void) {
+  return (double)sim_clock_now_us() / (1000 * SIM_SCENARIO_US_PER_MS);
+}
+
+static double prv_wall_s(void) {
+  struct timespec now = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void prv_rx(const SimCanFrame *frame, void *context) {
+  if (s_trace) {
+    printf("[%10.6f] CAN 0x%03" PRIx32 "%s [%zu] 0x%016" PRIx64 "\n", prv_now_s(), frame->id,
+           frame->extended ? "x" : "", frame->dlc, frame->data);
+  }
+  if (s_expected == NULL || s_expect_done || frame->extended) {
+    return;
+  }
+
+  CanId id = { .raw = (uint16_t)frame->id };
+  if (id.msg_id == s_expected->msg_id && id.type == s_expected->type &&
+      (s_expected->source_id == SIM_SCENARIO_ANY_SOURCE ||
+       id.source_id == s_expected->source_id)) {
+    s_expect_time_us = sim_clock_now_us();
+    s_expect_done = true;
+  }
+}
+
+static void prv_tx(void *context) {}
+
+static StatusCode prv_press(const SimStep *step) {
+  const SimBoard *board = sim_board_find(s_boards, step->board);
+  if (board == NULL) {
+    printf("  no board named %s\n", step->board);
+    return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+
+  printf("[%10.6f] press %s %c%u\n", prv_now_s(), board->name, 'A' + step->address.port,
+         step->address.pin);
+  return board->gpio_it_trigger_interrupt(&step->address);
+}
+
+static StatusCode prv_send(const SimStep *step) {
+  CanId id = {
+    .source_id = step->msg.source_id,
+    .type = step->msg.type,
+    .msg_id = step->msg.msg_id,
+  };
+  SimCanFrame frame = {
+    .id = id.raw,
+    .extended = false,
+    .dlc = step->msg.dlc,
+    .data = step->msg.data,
+  };
+
+  printf("[%10.6f] send msg %u from %u\n", prv_now_s(), step->msg.msg_id, step->msg.source_id);
+  return sim_can_bus_transmit(&s_node, &frame);
+}
+
+static StatusCode prv_expect(const SimStep *step) {
+  uint64_t start_us = sim_clock_now_us();
+  s_expect_done = false;
+  s_expected = &step->msg;
+  sim_clock_run_until(start_us + (uint64_t)step->duration_ms * SIM_SCENARIO_US_PER_MS,
+                      &s_expect_done);
+  s_expected = NULL;
+
+  if (!s_expect_done) {
+    printf("[%10.6f] FAIL: no %s %u within %" PRIu32 " ms\n", prv_now_s(),
+           step->msg.type == CAN_MSG_TYPE_ACK ? "ACK for msg" : "msg", step->msg.msg_id,
+           step->duration_ms);
+    return status_code(STATUS_CODE_TIMEOUT);
+  }
+
+  printf("[%10.6f] got %s %u after %.3f ms\n", prv_now_s(),
+         step->msg.type == CAN_MSG_TYPE_ACK ? "ACK for msg" : "msg", step->msg.msg_id,
+         (double)(s_expect_time_us - start_us) / SIM_SCENARIO_US_PER_MS);
+  return STATUS_CODE_OK;
+}
+
+static StatusCode prv_run_step(const SimStep *step) {
+  switch (step->type) {
+    case SIM_STEP_RUN:
+      sim_clock_run_until(sim_clock_now_us() + (uint64_t)step->duration_ms * SIM_SCENARIO_US_PER_MS,
+                          NULL);
+      return STATUS_CODE_OK;
+    case SIM_STEP_PRESS:
+      return prv_press(step);
+    case SIM_STEP_SEND_CAN:
+      return prv_send(step);
+    case SIM_STEP_EXPECT_CAN:
+      return prv_expect(step);
+    default:
+      return status_code(STATUS_CODE_INVALID_ARGS);
+  }
+}
+
+StatusCode sim_scenario_init(const SimBoardConfig *boards, bool trace) {
+  s_boards = boards;
+  s_trace = trace;
+  s_node.rx_callback = prv_rx;
+  s_node.tx_callback = prv_tx;
+  s_node.context = NULL;
+  s_node.loopback = false;
+  return sim_can_bus_attach(&s_node);
+}
+
+StatusCode sim_scenario_run(const SimScenario *scenario) {
+  printf("Scenario %s\n", scenario->name);
+
+  SimCanBusStats start_stats = { 0 };
+  sim_can_bus_get_stats(&start_stats);
+  uint64_t start_us = sim_clock_now_us();
+  double start_wall_s = prv_wall_s();
+
+  StatusCode status = STATUS_CODE_OK;
+  for (size_t i = 0; i < scenario->num_steps && status == STATUS_CODE_OK; i++) {
+    status = prv_run_step(&scenario->steps[i]);
+  }
+
+  SimCanBusStats stats = { 0 };
+  sim_can_bus_get_stats(&stats);
+  uint64_t elapsed_us = sim_clock_now_us() - start_us;
+  double elapsed_s = (double)elapsed_us / (1000 * SIM_SCENARIO_US_PER_MS);
+  double wall_s = prv_wall_s() - start_wall_s;
+  printf("Scenario %s %s: %.3f s simulated in %.3f s (%.0fx), %" PRIu64
+         " frames, %.1f%% bus load\n",
+         scenario->name, status == STATUS_CODE_OK ? "passed" : "FAILED", elapsed_s, wall_s,
+         wall_s > 0 ? elapsed_s / wall_s : 0, stats.frames - start_stats.frames,
+         elapsed_us > 0 ? 100.0 * (double)(stats.busy_us - start_stats.busy_us) / elapsed_us : 0);
+  return status;
+}
+
+const SimScenario *sim_scenario_find(const SimScenarioConfig *config, const char *name) {
+  for (size_t i = 0; i < config->num_scenarios; i++) {
+    if (strcmp(config->scenarios[i].name, name) == 0) {
+      return &config->scenarios[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,93 @@
+#include "sim_scenario_config.h"
+
+#include "can_msg_defs.h"
+#include "exported_enums.h"
+#include "misc.h"
+
+// Nothing happens: the boards only send their periodic messages
+static const SimStep s_idle_steps[] = {
+  SIM_STEP_RUN_MS(5000),
+};
+
+// Power button with the brake released turns on aux power
+static const SimStep s_power_aux_steps[] = {
+  SIM_STEP_PRESS_PIN("centre_console", GPIO_PORT_A, 8),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_POWER_ON_AUX_SEQUENCE,
+                  CAN_MSG_TYPE_DATA, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_POWER_DISTRIBUTION_FRONT,
+                  SYSTEM_CAN_MESSAGE_POWER_ON_AUX_SEQUENCE, CAN_MSG_TYPE_ACK, 100),
+  SIM_STEP_RUN_MS(2000),
+};
+
+// A full brake reading, as the pedal board would send it
+#define SIM_BRAKE_PRESSED ((uint64_t)(100 * EE_PEDAL_VALUE_DENOMINATOR) << 32)
+
+// Power button with the brake pressed runs the main power sequence. The centre console only
+// samples the brake every 100 ms, while the pedal board sends a released brake just as often, so
+// a pressed one goes out right after each of the pedal board's for a whole period first. The
+// sequence then runs to completion, with each step acked by the boards it concerns.
+static const SimStep s_power_main_steps[] = {
+  SIM_STEP_EXPECT(SIM_SCENARIO_ANY_SOURCE, SYSTEM_CAN_MESSAGE_PEDAL_OUTPUT, CAN_MSG_TYPE_DATA,
+                  100),
+  SIM_STEP_SEND(SYSTEM_CAN_DEVICE_PEDAL, SYSTEM_CAN_MESSAGE_PEDAL_OUTPUT, SIM_BRAKE_PRESSED),
+  SIM_STEP_EXPECT(SIM_SCENARIO_ANY_SOURCE, SYSTEM_CAN_MESSAGE_PEDAL_OUTPUT, CAN_MSG_TYPE_DATA,
+                  100),
+  SIM_STEP_SEND(SYSTEM_CAN_DEVICE_PEDAL, SYSTEM_CAN_MESSAGE_PEDAL_OUTPUT, SIM_BRAKE_PRESSED),
+  SIM_STEP_PRESS_PIN("centre_console", GPIO_PORT_A, 8),
+  // Confirm aux status
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE,
+                  CAN_MSG_TYPE_DATA, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_POWER_DISTRIBUTION_REAR,
+                  SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE, CAN_MSG_TYPE_ACK, 100),
+  // Turn on the driver display and BMS
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE,
+                  CAN_MSG_TYPE_DATA, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_POWER_DISTRIBUTION_REAR,
+                  SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE, CAN_MSG_TYPE_ACK, 100),
+  // Confirm battery status
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE,
+                  CAN_MSG_TYPE_DATA, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_BMS_CARRIER, SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE,
+                  CAN_MSG_TYPE_ACK, 100),
+  // Close the battery relays
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_SET_RELAY_STATES,
+                  CAN_MSG_TYPE_DATA, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_BMS_CARRIER, SYSTEM_CAN_MESSAGE_SET_RELAY_STATES,
+                  CAN_MSG_TYPE_ACK, 100),
+  // Confirm the DC-DC
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE,
+                  CAN_MSG_TYPE_DATA, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_POWER_DISTRIBUTION_REAR,
+                  SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE, CAN_MSG_TYPE_ACK, 100),
+  // Turn on everything. Both power distribution boards ack at once, and the rear one's lower ID
+  // wins arbitration.
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE,
+                  CAN_MSG_TYPE_DATA, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_POWER_DISTRIBUTION_REAR,
+                  SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE, CAN_MSG_TYPE_ACK, 100),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_POWER_DISTRIBUTION_FRONT,
+                  SYSTEM_CAN_MESSAGE_POWER_ON_MAIN_SEQUENCE, CAN_MSG_TYPE_ACK, 100),
+  SIM_STEP_RUN_MS(2000),
+};
+
+// The centre console faults on a BPS heartbeat with a fault set and acks it
+static const SimStep s_bps_fault_steps[] = {
+  SIM_STEP_SEND(SYSTEM_CAN_DEVICE_BMS_CARRIER, SYSTEM_CAN_MESSAGE_BPS_HEARTBEAT, 1),
+  SIM_STEP_EXPECT(SYSTEM_CAN_DEVICE_CENTRE_CONSOLE, SYSTEM_CAN_MESSAGE_BPS_HEARTBEAT,
+                  CAN_MSG_TYPE_ACK, 100),
+  SIM_STEP_RUN_MS(2000),
+};
+
+static const SimScenario s_scenarios[] = {
+  { .name = "idle", .steps = s_idle_steps, .num_steps = SIZEOF_ARRAY(s_idle_steps) },
+  { .name = "power_aux", .steps = s_power_aux_steps, .num_steps = SIZEOF_ARRAY(s_power_aux_steps) },
+  { .name = "power_main",
+    .steps = s_power_main_steps,
+    .num_steps = SIZEOF_ARRAY(s_power_main_steps) },
+  { .name = "bps_fault", .steps = s_bps_fault_steps, .num_steps = SIZEOF_ARRAY(s_bps_fault_steps) },
+};
+
+const SimScenarioConfig VEHICLE_SIM_SCENARIO_CONFIG = {
+  .scenarios = s_scenarios,
+  .num_scenarios = SIZEOF_ARRAY(s_scenarios),
+};
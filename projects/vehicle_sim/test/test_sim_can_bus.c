@@ -0,0 +1,126 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim_can_bus.h"
+#include "sim_clock.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TEST_SIM_CAN_BUS_BITRATE 500000
+#define TEST_SIM_CAN_BUS_NUM_NODES 3
+#define TEST_SIM_CAN_BUS_MAX_RX 8
+
+typedef struct TestNode {
+  SimCanNode node;
+  SimCanFrame rx[TEST_SIM_CAN_BUS_MAX_RX];
+  uint64_t rx_times_us[TEST_SIM_CAN_BUS_MAX_RX];
+  size_t num_rx;
+  size_t num_tx;
+} TestNode;
+
+static TestNode s_nodes[TEST_SIM_CAN_BUS_NUM_NODES];
+
+static void prv_rx(const SimCanFrame *frame, void *context) {
+  TestNode *node = context;
+  if (node->num_rx < TEST_SIM_CAN_BUS_MAX_RX) {
+    node->rx[node->num_rx] = *frame;
+    node->rx_times_us[node->num_rx] = sim_clock_now_us();
+  }
+  node->num_rx++;
+}
+
+static void prv_tx(void *context) {
+  TestNode *node = context;
+  node->num_tx++;
+}
+
+static void prv_transmit(size_t node, uint32_t id, bool extended) {
+  SimCanFrame frame = { .id = id, .extended = extended, .dlc = 8, .data = id };
+  TEST_ASSERT_OK(sim_can_bus_transmit(&s_nodes[node].node, &frame));
+}
+
+void setup_test(void) {
+  sim_clock_init();
+  sim_can_bus_init(TEST_SIM_CAN_BUS_BITRATE);
+  for (size_t i = 0; i < TEST_SIM_CAN_BUS_NUM_NODES; i++) {
+    s_nodes[i] = (TestNode){ .node = { .rx_callback = prv_rx,
+                                       .tx_callback = prv_tx,
+                                       .context = &s_nodes[i] } };
+    TEST_ASSERT_OK(sim_can_bus_attach(&s_nodes[i].node));
+  }
+}
+
+void teardown_test(void) {}
+
+void test_sim_can_bus_frame_time(void) {
+  SimCanFrame frame = { .id = 0x123, .extended = false, .dlc = 8 };
+  // 47 + 64 bits at 2 us each
+  TEST_ASSERT_EQUAL_UINT32(222, sim_can_bus_frame_time_us(&frame));
+  frame.extended = true;
+  frame.dlc = 0;
+  TEST_ASSERT_EQUAL_UINT32(134, sim_can_bus_frame_time_us(&frame));
+}
+
+void test_sim_can_bus_delivers_to_other_nodes(void) {
+  prv_transmit(0, 0x100, false);
+  sim_clock_run_until(1000, NULL);
+
+  TEST_ASSERT_EQUAL(0, s_nodes[0].num_rx);
+  TEST_ASSERT_EQUAL(1, s_nodes[0].num_tx);
+  for (size_t i = 1; i < TEST_SIM_CAN_BUS_NUM_NODES; i++) {
+    TEST_ASSERT_EQUAL(1, s_nodes[i].num_rx);
+    TEST_ASSERT_EQUAL_UINT32(0x100, s_nodes[i].rx[0].id);
+    TEST_ASSERT_EQUAL_UINT64(0x100, s_nodes[i].rx[0].data);
+    // Received once the whole frame is on the bus
+    TEST_ASSERT_EQUAL_UINT64(222, s_nodes[i].rx_times_us[0]);
+  }
+}
+
+void test_sim_can_bus_loopback(void) {
+  s_nodes[0].node.loopback = true;
+  prv_transmit(0, 0x100, false);
+  sim_clock_run_until(1000, NULL);
+
+  TEST_ASSERT_EQUAL(1, s_nodes[0].num_rx);
+}
+
+void test_sim_can_bus_arbitration(void) {
+  // Everything queued at once goes out in ID order, and a standard frame beats an extended frame
+  // with the same base ID
+  prv_transmit(0, 0x300, false);
+  prv_transmit(1, 0x100 << 18, true);
+  prv_transmit(2, 0x100, false);
+  prv_transmit(0, 0x050, false);
+  sim_clock_run_until(10000, NULL);
+
+  // Node 0 can't send its second frame until the first one is out
+  const uint32_t expected_ids[] = { 0x100, 0x100 << 18, 0x300, 0x050 };
+  TestNode *monitor = &s_nodes[1];
+  TEST_ASSERT_EQUAL(3, monitor->num_rx);
+  TEST_ASSERT_EQUAL_UINT32(expected_ids[0], monitor->rx[0].id);
+  TEST_ASSERT_EQUAL_UINT32(expected_ids[2], monitor->rx[1].id);
+  TEST_ASSERT_EQUAL_UINT32(expected_ids[3], monitor->rx[2].id);
+  TEST_ASSERT_EQUAL(3, s_nodes[2].num_rx);
+  TEST_ASSERT_EQUAL_UINT32(expected_ids[1], s_nodes[2].rx[0].id);
+  TEST_ASSERT_TRUE(s_nodes[2].rx[0].extended);
+
+  // Frames go back to back
+  TEST_ASSERT_EQUAL_UINT64(222, s_nodes[0].rx_times_us[0]);
+  TEST_ASSERT_EQUAL_UINT64(222 + 262, s_nodes[0].rx_times_us[1]);
+
+  SimCanBusStats stats = { 0 };
+  sim_can_bus_get_stats(&stats);
+  TEST_ASSERT_EQUAL_UINT64(4, stats.frames);
+  TEST_ASSERT_EQUAL_UINT64(3 * 222 + 262, stats.busy_us);
+}
+
+void test_sim_can_bus_queue_full(void) {
+  for (size_t i = 0; i < SIM_CAN_BUS_TX_QUEUE_LEN; i++) {
+    prv_transmit(0, 0x100, false);
+  }
+  SimCanFrame frame = { .id = 0x100, .dlc = 8 };
+  TEST_ASSERT_EQUAL(STATUS_CODE_RESOURCE_EXHAUSTED, sim_can_bus_transmit(&s_nodes[0].node, &frame));
+
+  frame.dlc = 9;
+  TEST_ASSERT_EQUAL(STATUS_CODE_INVALID_ARGS, sim_can_bus_transmit(&s_nodes[1].node, &frame));
+}
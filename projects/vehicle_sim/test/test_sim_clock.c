@@ -0,0 +1,118 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim_clock.h"
+#include "test_helpers.h"
+#include "unity.h"
+
+#define TEST_SIM_CLOCK_MAX_CALLS 8
+
+static SimClockEvent s_events[3];
+static SimClockEvent *s_calls[TEST_SIM_CLOCK_MAX_CALLS];
+static uint64_t s_call_times_us[TEST_SIM_CLOCK_MAX_CALLS];
+static size_t s_num_calls = 0;
+static volatile bool s_done = false;
+
+static void prv_record(void *context) {
+  if (s_num_calls < TEST_SIM_CLOCK_MAX_CALLS) {
+    s_calls[s_num_calls] = context;
+    s_call_times_us[s_num_calls] = sim_clock_now_us();
+  }
+  s_num_calls++;
+}
+
+static void prv_record_and_finish(void *context) {
+  prv_record(context);
+  s_done = true;
+}
+
+void setup_test(void) {
+  sim_clock_init();
+  for (size_t i = 0; i < SIZEOF_ARRAY(s_events); i++) {
+    s_events[i] = (SimClockEvent){ .callback = prv_record, .context = &s_events[i] };
+  }
+  s_num_calls = 0;
+  s_done = false;
+}
+
+void teardown_test(void) {}
+
+void test_sim_clock_runs_events_in_order(void) {
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[0], 300));
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[1], 100));
+  // Same deadline as the previous event, so it runs after it
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[2], 100));
+
+  sim_clock_run_until(1000, NULL);
+
+  TEST_ASSERT_EQUAL(3, s_num_calls);
+  TEST_ASSERT_EQUAL_PTR(&s_events[1], s_calls[0]);
+  TEST_ASSERT_EQUAL_PTR(&s_events[2], s_calls[1]);
+  TEST_ASSERT_EQUAL_PTR(&s_events[0], s_calls[2]);
+  TEST_ASSERT_EQUAL_UINT64(100, s_call_times_us[0]);
+  TEST_ASSERT_EQUAL_UINT64(300, s_call_times_us[2]);
+  TEST_ASSERT_EQUAL_UINT64(1000, sim_clock_now_us());
+}
+
+void test_sim_clock_stops_at_end(void) {
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[0], 500));
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[1], 1500));
+
+  sim_clock_run_until(1000, NULL);
+  TEST_ASSERT_EQUAL(1, s_num_calls);
+  TEST_ASSERT_EQUAL_UINT64(1000, sim_clock_now_us());
+  TEST_ASSERT_TRUE(s_events[1].scheduled);
+
+  sim_clock_run_until(2000, NULL);
+  TEST_ASSERT_EQUAL(2, s_num_calls);
+  TEST_ASSERT_EQUAL_UINT64(1500, s_call_times_us[1]);
+}
+
+void test_sim_clock_reschedule_and_cancel(void) {
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[0], 100));
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[1], 200));
+  // Moving an event doesn't schedule it twice
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[0], 300));
+  TEST_ASSERT_TRUE(sim_clock_cancel(&s_events[1]));
+  TEST_ASSERT_FALSE(sim_clock_cancel(&s_events[1]));
+
+  sim_clock_run_until(1000, NULL);
+
+  TEST_ASSERT_EQUAL(1, s_num_calls);
+  TEST_ASSERT_EQUAL_PTR(&s_events[0], s_calls[0]);
+  TEST_ASSERT_EQUAL_UINT64(300, s_call_times_us[0]);
+}
+
+void test_sim_clock_past_deadline_runs_now(void) {
+  sim_clock_run_until(1000, NULL);
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[0], 10));
+
+  sim_clock_run_until(2000, NULL);
+
+  TEST_ASSERT_EQUAL(1, s_num_calls);
+  TEST_ASSERT_EQUAL_UINT64(1000, s_call_times_us[0]);
+}
+
+void test_sim_clock_done_stops_early(void) {
+  s_events[0].callback = prv_record_and_finish;
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[0], 100));
+  TEST_ASSERT_OK(sim_clock_schedule(&s_events[1], 200));
+
+  sim_clock_run_until(1000, &s_done);
+
+  TEST_ASSERT_EQUAL(1, s_num_calls);
+  TEST_ASSERT_EQUAL_UINT64(100, sim_clock_now_us());
+}
+
+void test_sim_clock_out_of_events(void) {
+  SimClockEvent events[SIM_CLOCK_MAX_EVENTS + 1] = { 0 };
+  for (size_t i = 0; i < SIM_CLOCK_MAX_EVENTS; i++) {
+    events[i].callback = prv_record;
+    TEST_ASSERT_OK(sim_clock_schedule(&events[i], 100));
+  }
+  events[SIM_CLOCK_MAX_EVENTS].callback = prv_record;
+  TEST_ASSERT_NOT_OK(sim_clock_schedule(&events[SIM_CLOCK_MAX_EVENTS], 100));
+
+  sim_clock_run_until(1000, NULL);
+  TEST_ASSERT_EQUAL(SIM_CLOCK_MAX_EVENTS, s_num_calls);
+}